@@ -48,6 +48,10 @@ const UserDef U_default = {
     .pythondir = "",
     .sounddir = "//",
     .i18ndir = "",
+    .vr_network_width = 320,
+    .vr_network_height = 240,
+    .vr_network_fps = 30,
+    .vr_network_codec = 0,
     .image_editor = "",
     .anim_player = "",
     .anim_player_preset = 0,
@@ -736,6 +736,7 @@ class USERPREF_PT_system_memory(PreferencePanel, Panel):
         flow.prop(edit, "undo_steps", text="Undo Steps")
         flow.prop(edit, "undo_memory_limit", text="Undo Memory Limit")
         flow.prop(edit, "use_global_undo")
+        flow.prop(edit, "use_global_undo_skip_unchanged")
 
         layout.separator()
 
@@ -1347,6 +1348,15 @@ class USERPREF_PT_vr_network(VRPanel, Panel):
 
         col = self.layout.column()
         col.prop(paths, "vr_network_ip_address", text="IP Address")
+        col.prop(paths, "vr_network_codec", text="Codec")
+
+        col = self.layout.column(align=True)
+        col.prop(paths, "vr_network_width", text="Resolution X")
+        col.prop(paths, "vr_network_height", text="Y")
+        col.prop(paths, "vr_network_fps", text="Frame Rate")
+
+        col = self.layout.column()
+        col.prop(paths, "vr_network_spectators", text="Spectators")
 
 
 class USERPREF_PT_vr_experimental(VRPanel, Panel):
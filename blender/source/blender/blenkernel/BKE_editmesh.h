@@ -94,10 +94,20 @@ typedef struct BMEditMesh {
    */
   char needs_flush_to_id;
 
+#if WITH_VR
+  /**
+   * Changes whenever the tessellation or the vertex positions may have changed,
+   * unique over all edit-meshes (for caches keyed on the geometry, see #BKE_editmesh_geom_changed).
+   */
+  unsigned int geom_version;
+#endif
 } BMEditMesh;
 
 /* editmesh.c */
 void BKE_editmesh_looptri_calc(BMEditMesh *em);
+#if WITH_VR
+void BKE_editmesh_geom_changed(BMEditMesh *em);
+#endif
 BMEditMesh *BKE_editmesh_create(BMesh *bm, const bool do_tessellate);
 BMEditMesh *BKE_editmesh_copy(BMEditMesh *em);
 BMEditMesh *BKE_editmesh_from_object(struct Object *ob);
@@ -63,6 +63,7 @@ BMBVHTree *BKE_bmbvh_new(struct BMesh *bm,
                          const float (*cos_cage)[3],
                          const bool cos_cage_free);
 void BKE_bmbvh_free(BMBVHTree *tree);
+void BKE_bmbvh_refit(BMBVHTree *tree, struct BMLoop *(*looptris)[3], int flag);
 struct BVHTree *BKE_bmbvh_tree_get(BMBVHTree *tree);
 
 struct BMFace *BKE_bmbvh_ray_cast(BMBVHTree *tree,
@@ -35,6 +35,11 @@
 #include "BKE_mesh.h"
 #include "BKE_object.h"
 
+#if WITH_VR
+/* Last geometry version of any edit-mesh. */
+static unsigned int editmesh_geom_version = 0;
+#endif
+
 BMEditMesh *BKE_editmesh_create(BMesh *bm, const bool do_tessellate)
 {
   BMEditMesh *em = MEM_callocN(sizeof(BMEditMesh), __func__);
@@ -43,6 +48,11 @@ BMEditMesh *BKE_editmesh_create(BMesh *bm, const bool do_tessellate)
   if (do_tessellate) {
     BKE_editmesh_looptri_calc(em);
   }
+#if WITH_VR
+  else {
+    BKE_editmesh_geom_changed(em);
+  }
+#endif
 
   return em;
 }
@@ -70,6 +80,10 @@ BMEditMesh *BKE_editmesh_copy(BMEditMesh *em)
    * tessellation only when/if that copy ends up getting used. */
   em_copy->looptris = NULL;
 
+#if WITH_VR
+  BKE_editmesh_geom_changed(em_copy);
+#endif
+
   return em_copy;
 }
 
@@ -132,6 +146,9 @@ static void editmesh_tessface_calc_intern(BMEditMesh *em)
 void BKE_editmesh_looptri_calc(BMEditMesh *em)
 {
   editmesh_tessface_calc_intern(em);
+#if WITH_VR
+  BKE_editmesh_geom_changed(em);
+#endif
 
   /* commented because editbmesh_build_data() ensures we get tessfaces */
 #if 0
@@ -145,6 +162,17 @@ void BKE_editmesh_looptri_calc(BMEditMesh *em)
 #endif
 }
 
+#if WITH_VR
+/**
+ * Give the edit-mesh a new geometry version, call after changing the vertex positions
+ * (changing the topology requires #BKE_editmesh_looptri_calc, which does this already).
+ */
+void BKE_editmesh_geom_changed(BMEditMesh *em)
+{
+  em->geom_version = ++editmesh_geom_version;
+}
+#endif
+
 void BKE_editmesh_free_derivedmesh(BMEditMesh *em)
 {
   if (em->mesh_eval_cage) {
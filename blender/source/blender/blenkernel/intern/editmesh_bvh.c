@@ -159,6 +159,19 @@ static bool bm_face_is_not_hidden(BMFace *f, void *UNUSED(user_data))
   return (BM_elem_flag_test(f, BM_ELEM_HIDDEN) == 0);
 }
 
+typedef bool (*BMBVHTestFn)(BMFace *, void *user_data);
+
+static BMBVHTestFn bmbvh_test_fn_from_flag(int flag)
+{
+  if (flag & BMBVH_RESPECT_SELECT) {
+    return bm_face_is_select;
+  }
+  else if (flag & BMBVH_RESPECT_HIDDEN) {
+    return bm_face_is_not_hidden;
+  }
+  return NULL;
+}
+
 BMBVHTree *BKE_bmbvh_new(BMesh *bm,
                          BMLoop *(*looptris)[3],
                          int looptris_tot,
@@ -166,17 +179,7 @@ BMBVHTree *BKE_bmbvh_new(BMesh *bm,
                          const float (*cos_cage)[3],
                          const bool cos_cage_free)
 {
-  bool (*test_fn)(BMFace *, void *user_data);
-
-  if (flag & BMBVH_RESPECT_SELECT) {
-    test_fn = bm_face_is_select;
-  }
-  else if (flag & BMBVH_RESPECT_HIDDEN) {
-    test_fn = bm_face_is_not_hidden;
-  }
-  else {
-    test_fn = NULL;
-  }
+  BMBVHTestFn test_fn = bmbvh_test_fn_from_flag(flag);
 
   flag &= ~(BMBVH_RESPECT_SELECT | BMBVH_RESPECT_HIDDEN);
 
@@ -195,6 +198,47 @@ void BKE_bmbvh_free(BMBVHTree *bmtree)
   MEM_freeN(bmtree);
 }
 
+/**
+ * Update the bounds of a tree after its vertices moved, which is much faster than building a new one.
+ * The triangles and the faces included by \a flag must be the same as when the tree was built by
+ * #BKE_bmbvh_new (without cage coordinates), only \a looptris may have been reallocated.
+ */
+void BKE_bmbvh_refit(BMBVHTree *bmtree, BMLoop *(*looptris)[3], int flag)
+{
+  BMBVHTestFn test_fn = bmbvh_test_fn_from_flag(flag);
+  BMFace *f_test, *f_test_prev = NULL;
+  bool test_fn_ret = false;
+  int node_index = 0;
+
+  BLI_assert(bmtree->cos_cage == NULL);
+
+  bmtree->looptris = looptris;
+
+  for (int i = 0; i < bmtree->looptris_tot; i++) {
+    /* Same order and test as BKE_bmbvh_new_ex(), so leafs are updated in the order they were inserted. */
+    if (test_fn) {
+      f_test = looptris[i][0]->f;
+      if (f_test != f_test_prev) {
+        test_fn_ret = test_fn(f_test, NULL);
+        f_test_prev = f_test;
+      }
+
+      if (!test_fn_ret) {
+        continue;
+      }
+    }
+
+    const float cos[3][3] = {
+        {UNPACK3(looptris[i][0]->v->co)},
+        {UNPACK3(looptris[i][1]->v->co)},
+        {UNPACK3(looptris[i][2]->v->co)},
+    };
+    BLI_bvhtree_update_node(bmtree->tree, node_index++, (const float *)cos, NULL, 3);
+  }
+
+  BLI_bvhtree_update_tree(bmtree->tree);
+}
+
 BVHTree *BKE_bmbvh_tree_get(BMBVHTree *bmtree)
 {
   return bmtree->tree;
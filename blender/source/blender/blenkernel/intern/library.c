@@ -1232,6 +1232,8 @@ void *BKE_libblock_alloc(Main *bmain, short type, const char *name, const int fl
     }
 
     id->icon_id = 0;
+    /* New data-blocks are always written to the next global undo step. */
+    id->recalc_undo_accumulated = ID_RECALC_ALL;
     *((short *)id->name) = type;
     if ((flag & LIB_ID_CREATE_NO_USER_REFCOUNT) == 0) {
       id->us = 1;
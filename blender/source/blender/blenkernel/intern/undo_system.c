@@ -96,6 +96,7 @@ static bool g_undo_callback_running = false;
  */
 const UndoType *BKE_UNDOSYS_TYPE_IMAGE = NULL;
 const UndoType *BKE_UNDOSYS_TYPE_MEMFILE = NULL;
+const UndoType *BKE_UNDOSYS_TYPE_MESH_SELECT = NULL;
 const UndoType *BKE_UNDOSYS_TYPE_PAINTCURVE = NULL;
 const UndoType *BKE_UNDOSYS_TYPE_PARTICLE = NULL;
 const UndoType *BKE_UNDOSYS_TYPE_SCULPT = NULL;
@@ -108,5 +108,11 @@ void BLI_bitmap_flip_all(BLI_bitmap *bitmap, size_t bits);
 void BLI_bitmap_copy_all(BLI_bitmap *dst, const BLI_bitmap *src, size_t bits);
 void BLI_bitmap_and_all(BLI_bitmap *dst, const BLI_bitmap *src, size_t bits);
 void BLI_bitmap_or_all(BLI_bitmap *dst, const BLI_bitmap *src, size_t bits);
+void BLI_bitmap_xor_all(BLI_bitmap *dst, const BLI_bitmap *src, size_t bits);
+
+unsigned int *BLI_bitmap_rle_encode(const BLI_bitmap *bitmap,
+                                    size_t bits,
+                                    unsigned int *r_runs_len);
+void BLI_bitmap_rle_xor(BLI_bitmap *dst, const unsigned int *runs, unsigned int runs_len);
 
 #endif
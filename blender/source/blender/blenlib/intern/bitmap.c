@@ -26,8 +26,11 @@
 #include <string.h>
 #include <limits.h>
 
+#include "MEM_guardedalloc.h"
+
 #include "BLI_utildefines.h"
 #include "BLI_bitmap.h"
+#include "BLI_math_bits.h"
 
 /** Set or clear all bits in the bitmap. */
 void BLI_bitmap_set_all(BLI_bitmap *bitmap, bool set, size_t bits)
@@ -67,3 +70,104 @@ void BLI_bitmap_or_all(BLI_bitmap *dst, const BLI_bitmap *src, size_t bits)
     dst[i] |= src[i];
   }
 }
+
+/** Combine two bitmaps with boolean XOR. */
+void BLI_bitmap_xor_all(BLI_bitmap *dst, const BLI_bitmap *src, size_t bits)
+{
+  size_t num_blocks = _BITMAP_NUM_BLOCKS(bits);
+  for (size_t i = 0; i < num_blocks; i++) {
+    dst[i] ^= src[i];
+  }
+}
+
+/**
+ * Run lengths of the bitmap, alternating between unset and set bits (starting with unset bits).
+ * Whole blocks that continue the current run are skipped, so sparse bitmaps are fast to scan.
+ * Only counts the runs when \a runs is NULL.
+ */
+static size_t bitmap_rle_runs(const BLI_bitmap *bitmap, size_t bits, unsigned int *runs)
+{
+  const size_t num_blocks = (bits + _BITMAP_MASK) >> _BITMAP_POWER;
+  size_t runs_len = 0;
+  unsigned int run = 0;
+  BLI_bitmap state = 0;
+
+  for (size_t i = 0; i < num_blocks; i++) {
+    const unsigned int block_bits = (i == num_blocks - 1 && (bits & _BITMAP_MASK)) ?
+                                        (unsigned int)(bits & _BITMAP_MASK) :
+                                        32u;
+    const BLI_bitmap mask = (block_bits == 32) ? ~(BLI_bitmap)0 : ((1u << block_bits) - 1);
+    /* Bits that differ from the current run. */
+    BLI_bitmap diff = (bitmap[i] ^ state) & mask;
+    unsigned int offset = 0;
+    while (diff) {
+      const unsigned int index = bitscan_forward_uint(diff);
+      run += index - offset;
+      if (runs) {
+        runs[runs_len] = run;
+      }
+      runs_len++;
+      run = 0;
+      offset = index;
+      state = ~state;
+      /* The bits from here on are compared against the new state. */
+      diff = ~diff & (~(BLI_bitmap)0 << index) & mask;
+    }
+    run += block_bits - offset;
+  }
+
+  if (runs) {
+    runs[runs_len] = run;
+  }
+  return runs_len + 1;
+}
+
+/**
+ * Run-length encode the bitmap, for compact storage of sparse or clustered bitmaps
+ * (typically the difference between two states, see #BLI_bitmap_xor_all).
+ *
+ * \return the lengths of the alternating runs of unset and set bits (the first run is a run of
+ * unset bits, possibly zero long), free with MEM_freeN().
+ */
+unsigned int *BLI_bitmap_rle_encode(const BLI_bitmap *bitmap,
+                                    size_t bits,
+                                    unsigned int *r_runs_len)
+{
+  const size_t runs_len = bitmap_rle_runs(bitmap, bits, NULL);
+  unsigned int *runs = MEM_mallocN(sizeof(*runs) * runs_len, __func__);
+  bitmap_rle_runs(bitmap, bits, runs);
+  *r_runs_len = (unsigned int)runs_len;
+  return runs;
+}
+
+/**
+ * Flip the bits of \a dst that are set in a run-length encoded bitmap
+ * (as returned by #BLI_bitmap_rle_encode).
+ * Decode into a cleared bitmap to get the original bitmap back.
+ */
+void BLI_bitmap_rle_xor(BLI_bitmap *dst, const unsigned int *runs, unsigned int runs_len)
+{
+  size_t index = 0;
+  for (unsigned int i = 0; i < runs_len; i++) {
+    size_t len = runs[i];
+    if ((i & 1) == 0) {
+      index += len;
+      continue;
+    }
+    /* Leading partial block. */
+    while (len && (index & _BITMAP_MASK)) {
+      BLI_BITMAP_FLIP(dst, index);
+      index++;
+      len--;
+    }
+    /* Whole blocks. */
+    for (; len >= 32; len -= 32, index += 32) {
+      dst[index >> _BITMAP_POWER] ^= ~(BLI_bitmap)0;
+    }
+    /* Trailing partial block. */
+    if (len) {
+      dst[index >> _BITMAP_POWER] ^= (1u << len) - 1;
+      index += len;
+    }
+  }
+}
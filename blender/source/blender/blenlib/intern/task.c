@@ -45,18 +45,22 @@
  */
 #define MEMPOOL_SIZE 256
 
-/* Number of tasks which are pushed directly to local thread queue.
- *
- * This allows thread to fetch next task without locking the whole queue.
+/* Initial number of tasks a thread's deque can hold, grows as needed.
+ * Must be a power of two.
  */
-#define LOCAL_QUEUE_SIZE 1
+#define DEQUE_INITIAL_SIZE 256
 
-/* Number of tasks which are allowed to be scheduled in a delayed manner.
+/* Number of times an idle worker looks for work before going to sleep.
  *
- * This allows to use less locks per graph node children schedule. More details
- * could be found at TaskThreadLocalStorage::do_delayed_push.
+ * Going to sleep and being woken up again costs a couple of system calls,
+ * which is way more than the time between fine-grained task pushes.
+ */
+#define IDLE_SPIN_COUNT 64
+
+/* Used to keep data which is modified by different threads on different
+ * cache lines.
  */
-#define DELAYED_QUEUE_SIZE 4096
+#define CACHELINE_SIZE 64
 
 #ifndef NDEBUG
 #  define ASSERT_THREAD_ID(scheduler, thread_id) \
@@ -86,6 +90,10 @@ typedef struct Task {
   bool free_taskdata;
   TaskFreeFunction freedata;
   TaskPool *pool;
+  /* Priority the task was pushed with, kept when it's moved to an inject
+   * queue.
+   */
+  TaskPriority priority;
 } Task;
 
 /* This is a per-thread storage of pre-allocated tasks.
@@ -138,37 +146,37 @@ typedef struct TaskThreadLocalStorage {
    */
   TaskMemPool task_mempool;
 
-  /* Local queue keeps thread alive by keeping small amount of tasks ready
-   * to be picked up without causing global thread locks for synchronization.
-   */
-  int num_local_queue;
-  Task *local_queue[LOCAL_QUEUE_SIZE];
-
   /* Thread can be marked for delayed tasks push. This is helpful when it's
    * know that lots of subsequent task pushed will happen from the same thread
    * without "interrupting" for task execution.
    *
-   * We try to accumulate as much tasks as possible in a local queue without
-   * any locks first, and then we push all of them into a schedulers queue
-   * from within a single mutex lock.
+   * Tasks are still pushed to the thread's deque right away, but sleeping
+   * threads are only woken up once, for all of them, when the push ends.
    */
   bool do_delayed_push;
-  int num_delayed_queue;
-  Task *delayed_queue[DELAYED_QUEUE_SIZE];
+  int num_delayed_push;
 } TaskThreadLocalStorage;
 
 struct TaskPool {
   TaskScheduler *scheduler;
 
+  /* Number of tasks which are pushed and not finished yet. */
   volatile size_t num;
+  /* Used to sleep in work_and_wait() and cancel() until there might be
+   * something to do for the pool, or all its tasks are done.
+   */
   ThreadMutex num_mutex;
   ThreadCondition num_cond;
+  volatile uint32_t num_sleeping;
+  volatile uint32_t wake_epoch;
+
+  /* Number of the pool's tasks in the scheduler's inject queues. */
+  volatile size_t num_injected;
 
   void *userdata;
   ThreadMutex user_mutex;
 
   volatile bool do_cancel;
-  volatile bool do_work;
 
   volatile bool is_suspended;
   bool start_suspended;
@@ -201,15 +209,79 @@ struct TaskPool {
 #endif
 };
 
+/* Work-stealing deque (Chase and Lev, "Dynamic Circular Work-Stealing Deque").
+ *
+ * Every thread known to the scheduler (main thread and workers) owns one, and
+ * pushes the tasks it creates to its bottom. Only the owner pushes and pops at
+ * the bottom, without any lock; other threads steal the oldest tasks from the
+ * top with a single compare-and-swap.
+ *
+ * Items keep a copy of the task's pool, so a thread which only wants tasks of
+ * a particular pool can look at the top of the deque without touching the task
+ * itself (which might be taken, run and freed by another thread meanwhile).
+ */
+typedef struct TaskDequeItem {
+  Task *task;
+  TaskPool *pool;
+} TaskDequeItem;
+
+typedef struct TaskDequeBuffer {
+  /* Size of the buffer minus one, the size is a power of two. */
+  int64_t mask;
+  /* Buffer which was replaced when this one was allocated. It's kept until the
+   * deque is freed, since thieves might still be reading from it.
+   */
+  struct TaskDequeBuffer *prev;
+  TaskDequeItem items[];
+} TaskDequeBuffer;
+
+typedef struct TaskDeque {
+  /* Index of the oldest task, advanced by thieves. */
+  volatile int64_t top;
+  char _pad[CACHELINE_SIZE - sizeof(int64_t)];
+  /* Index after the newest task, only modified by the owner. */
+  volatile int64_t bottom;
+  TaskDequeBuffer *volatile buffer;
+} TaskDeque;
+
+/* Lists of tasks pushed from threads which don't have a deque, and of tasks
+ * which were taken from a deque by a thread which can't run them.
+ */
+typedef enum eTaskInjectQueue {
+  TASK_INJECT_HIGH = 0,
+  TASK_INJECT_LOW,
+  /* Tasks of background pools when there is only the fallback thread. */
+  TASK_INJECT_BACKGROUND,
+
+  TASK_INJECT_NUM,
+} eTaskInjectQueue;
+
+typedef struct TaskInjectQueue {
+  /* Tasks (linked with Task.next and Task.prev), oldest first. */
+  ListBase tasks;
+  /* Number of tasks. Only modified with the inject lock held, but read
+   * without it to skip empty queues.
+   */
+  volatile size_t num;
+} TaskInjectQueue;
+
 struct TaskScheduler {
   pthread_t *threads;
   struct TaskThread *task_threads;
   int num_threads;
   bool background_thread_only;
 
-  ListBase queue;
-  ThreadMutex queue_mutex;
-  ThreadCondition queue_cond;
+  /* Workers take the inject queues as a whole, but threads which wait for a
+   * pool pick out the pool's tasks and leave the others where they are, so
+   * the queues are locked rather than lock-free.
+   */
+  ThreadMutex inject_mutex;
+  TaskInjectQueue inject[TASK_INJECT_NUM];
+
+  /* Idle workers sleep on this condition. */
+  ThreadMutex sleep_mutex;
+  ThreadCondition sleep_cond;
+  volatile uint32_t num_sleeping;
 
   ThreadMutex startup_mutex;
   ThreadCondition startup_cond;
@@ -224,6 +296,9 @@ struct TaskScheduler {
 typedef struct TaskThread {
   TaskScheduler *scheduler;
   int id;
+  /* State of the random victim selection for stealing. */
+  uint32_t steal_seed;
+  TaskDeque deque;
   TaskThreadLocalStorage tls;
 } TaskThread;
 
@@ -326,101 +401,542 @@ static void task_free(TaskPool *pool, Task *task, const int thread_id)
   }
 }
 
+/* Task Deque */
+
+/* Read with a full memory barrier, so the read can't be reordered with other
+ * reads and writes around it.
+ */
+BLI_INLINE int64_t task_deque_load(volatile int64_t *value)
+{
+  return atomic_fetch_and_add_int64((int64_t *)value, 0);
+}
+
+static TaskDequeBuffer *task_deque_buffer_alloc(int64_t size)
+{
+  BLI_assert(is_power_of_2_i((int)size));
+  TaskDequeBuffer *buffer = MEM_mallocN(sizeof(TaskDequeBuffer) + sizeof(TaskDequeItem) * size,
+                                        "TaskDequeBuffer");
+  buffer->mask = size - 1;
+  buffer->prev = NULL;
+  return buffer;
+}
+
+static void task_deque_init(TaskDeque *deque)
+{
+  deque->top = 0;
+  deque->bottom = 0;
+  deque->buffer = task_deque_buffer_alloc(DEQUE_INITIAL_SIZE);
+}
+
+/* Frees the deque and the tasks which are still in it. */
+static void task_deque_free(TaskDeque *deque)
+{
+  TaskDequeBuffer *buffer = deque->buffer;
+  for (int64_t i = deque->top; i < deque->bottom; i++) {
+    Task *task = buffer->items[i & buffer->mask].task;
+    task_data_free(task, 0);
+    MEM_freeN(task);
+  }
+  while (buffer) {
+    TaskDequeBuffer *prev = buffer->prev;
+    MEM_freeN(buffer);
+    buffer = prev;
+  }
+  deque->buffer = NULL;
+}
+
+BLI_INLINE bool task_deque_is_empty(const TaskDeque *deque)
+{
+  return deque->top >= deque->bottom;
+}
+
+/* Owner only. */
+static void task_deque_push(TaskDeque *deque, Task *task)
+{
+  const int64_t bottom = deque->bottom;
+  const int64_t top = deque->top;
+  TaskDequeBuffer *buffer = deque->buffer;
+  if (bottom - top > buffer->mask) {
+    /* Full, copy the tasks to a twice bigger buffer. */
+    TaskDequeBuffer *new_buffer = task_deque_buffer_alloc((buffer->mask + 1) * 2);
+    for (int64_t i = top; i < bottom; i++) {
+      new_buffer->items[i & new_buffer->mask] = buffer->items[i & buffer->mask];
+    }
+    new_buffer->prev = buffer;
+    atomic_cas_ptr((void **)&deque->buffer, buffer, new_buffer);
+    buffer = new_buffer;
+  }
+  TaskDequeItem *item = &buffer->items[bottom & buffer->mask];
+  item->task = task;
+  item->pool = task->pool;
+  /* Publish the task. */
+  atomic_add_and_fetch_int64((int64_t *)&deque->bottom, 1);
+}
+
+/* Owner only, takes the newest task. */
+static Task *task_deque_pop(TaskDeque *deque)
+{
+  if (task_deque_is_empty(deque)) {
+    return NULL;
+  }
+  const int64_t bottom = atomic_sub_and_fetch_int64((int64_t *)&deque->bottom, 1);
+  const int64_t top = deque->top;
+  if (top > bottom) {
+    /* Thieves took everything meanwhile. */
+    atomic_add_and_fetch_int64((int64_t *)&deque->bottom, 1);
+    return NULL;
+  }
+  TaskDequeBuffer *buffer = deque->buffer;
+  Task *task = buffer->items[bottom & buffer->mask].task;
+  if (top == bottom) {
+    /* Last task, race against the thieves for it. */
+    if (atomic_cas_int64((int64_t *)&deque->top, top, top + 1) != top) {
+      task = NULL;
+    }
+    atomic_add_and_fetch_int64((int64_t *)&deque->bottom, 1);
+  }
+  return task;
+}
+
+/* Takes the oldest task, if it belongs to the given pool (any pool if NULL).
+ *
+ * Returns NULL if the deque is empty, the task belongs to another pool or
+ * another thread was faster.
+ */
+static Task *task_deque_steal(TaskDeque *deque, TaskPool *pool)
+{
+  if (task_deque_is_empty(deque)) {
+    return NULL;
+  }
+  const int64_t top = task_deque_load(&deque->top);
+  const int64_t bottom = task_deque_load(&deque->bottom);
+  if (top >= bottom) {
+    return NULL;
+  }
+  /* NOTE: The item might be overwritten by the owner as soon as the top moved
+   * past it, but then the compare-and-swap below fails.
+   */
+  TaskDequeBuffer *buffer = deque->buffer;
+  volatile TaskDequeItem *item = &buffer->items[top & buffer->mask];
+  Task *task = item->task;
+  if (pool != NULL && item->pool != pool) {
+    return NULL;
+  }
+  if (atomic_cas_int64((int64_t *)&deque->top, top, top + 1) != top) {
+    return NULL;
+  }
+  return task;
+}
+
 /* Task Scheduler */
 
-static void task_pool_num_decrease(TaskPool *pool, size_t done)
+/* Scheduler thread of the calling thread, NULL for threads which are not
+ * managed by the scheduler (they have no deque).
+ */
+BLI_INLINE TaskThread *task_scheduler_current_thread(TaskScheduler *scheduler)
 {
+  if (BLI_thread_is_main()) {
+    return &scheduler->task_threads[0];
+  }
+  return pthread_getspecific(scheduler->tls_id_key);
+}
+
+/* Same, from the thread ID which was passed to a task or pool function. */
+BLI_INLINE TaskThread *task_scheduler_thread_from_id(TaskPool *pool, const int thread_id)
+{
+  if (thread_id == -1) {
+    return task_scheduler_current_thread(pool->scheduler);
+  }
+  ASSERT_THREAD_ID(pool->scheduler, thread_id);
+  if (thread_id == 0 && pool->use_local_tls) {
+    return NULL;
+  }
+  return &pool->scheduler->task_threads[thread_id];
+}
+
+/* Wakes up a pool's thread which sleeps in work_and_wait() or cancel(), if any.
+ *
+ * Must be called after the task it is woken up for was published, or the
+ * number of pool's tasks changed.
+ */
+static void task_pool_wake(TaskPool *pool)
+{
+  if (pool->num_sleeping == 0) {
+    return;
+  }
   BLI_mutex_lock(&pool->num_mutex);
+  pool->wake_epoch++;
+  BLI_condition_notify_all(&pool->num_cond);
+  BLI_mutex_unlock(&pool->num_mutex);
+}
 
-  BLI_assert(pool->num >= done);
+static void task_pool_num_decrease(TaskPool *pool, size_t done)
+{
+  size_t num = pool->num;
 
-  pool->num -= done;
+  BLI_assert(num >= done);
 
-  if (pool->num == 0) {
-    BLI_condition_notify_all(&pool->num_cond);
+  /* Pool might be freed as soon as the thread which waits for it sees that
+   * all tasks are done, so the last ones are only marked as done with the
+   * lock held, which that thread takes before returning.
+   */
+  while (num > done) {
+    const size_t old_num = atomic_cas_z((size_t *)&pool->num, num, num - done);
+    if (old_num == num) {
+      return;
+    }
+    num = old_num;
   }
 
+  BLI_mutex_lock(&pool->num_mutex);
+  atomic_sub_and_fetch_z((size_t *)&pool->num, done);
+  BLI_condition_notify_all(&pool->num_cond);
   BLI_mutex_unlock(&pool->num_mutex);
 }
 
 static void task_pool_num_increase(TaskPool *pool, size_t new)
 {
-  BLI_mutex_lock(&pool->num_mutex);
+  atomic_add_and_fetch_z((size_t *)&pool->num, new);
+}
 
-  pool->num += new;
-  BLI_condition_notify_all(&pool->num_cond);
+/* Wakes up to the given number of sleeping workers.
+ *
+ * Must be called after the tasks they are woken up for were published.
+ */
+static void task_scheduler_wake(TaskScheduler *scheduler, int num)
+{
+  if (scheduler->num_sleeping == 0 || num <= 0) {
+    return;
+  }
+  BLI_mutex_lock(&scheduler->sleep_mutex);
+  if (num >= (int)scheduler->num_sleeping) {
+    BLI_condition_notify_all(&scheduler->sleep_cond);
+  }
+  else {
+    for (int i = 0; i < num; i++) {
+      BLI_condition_notify_one(&scheduler->sleep_cond);
+    }
+  }
+  BLI_mutex_unlock(&scheduler->sleep_mutex);
+}
 
-  BLI_mutex_unlock(&pool->num_mutex);
+/* Inject queue for a task which can't be pushed to a deque. */
+BLI_INLINE eTaskInjectQueue task_scheduler_inject_queue(TaskScheduler *scheduler, Task *task)
+{
+  if (scheduler->background_thread_only && task->pool->run_in_background) {
+    return TASK_INJECT_BACKGROUND;
+  }
+  return (task->priority == TASK_PRIORITY_HIGH) ? TASK_INJECT_HIGH : TASK_INJECT_LOW;
 }
 
-static bool task_scheduler_thread_wait_pop(TaskScheduler *scheduler, Task **task)
+/* Appends tasks (oldest first) to an inject queue, and wakes up to the given
+ * number of workers for them.
+ */
+static void task_scheduler_inject(TaskScheduler *scheduler,
+                                  eTaskInjectQueue queue,
+                                  ListBase *tasks,
+                                  int num_wake)
 {
-  bool found_task = false;
-  BLI_mutex_lock(&scheduler->queue_mutex);
+  TaskInjectQueue *inject = &scheduler->inject[queue];
+  size_t num_tasks = 0;
+
+  BLI_mutex_lock(&scheduler->inject_mutex);
+  for (Task *task = tasks->first; task; task = task->next) {
+    atomic_add_and_fetch_z((size_t *)&task->pool->num_injected, 1);
+    num_tasks++;
+  }
+  BLI_movelisttolist(&inject->tasks, tasks);
+  /* Atomic for the memory barrier: threads which go to sleep look at the
+   * number of tasks after announcing the sleep, and we look at the number of
+   * sleeping threads after this.
+   */
+  atomic_add_and_fetch_z((size_t *)&inject->num, num_tasks);
+  BLI_mutex_unlock(&scheduler->inject_mutex);
 
-  while (!scheduler->queue.first && !scheduler->do_exit) {
-    BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+  if (queue != TASK_INJECT_BACKGROUND && scheduler->background_thread_only) {
+    /* The fallback thread doesn't run these. */
+    return;
   }
+  task_scheduler_wake(scheduler, num_wake);
+}
 
-  do {
-    Task *current_task;
+/* Takes all the tasks of an inject queue, oldest first. */
+static bool task_scheduler_take_injected(TaskScheduler *scheduler,
+                                         eTaskInjectQueue queue,
+                                         ListBase *r_tasks)
+{
+  TaskInjectQueue *inject = &scheduler->inject[queue];
+  if (inject->num == 0) {
+    return false;
+  }
 
-    /* Assuming we can only have a void queue in 'exit' case here seems logical
-     * (we should only be here after our worker thread has been woken up from a
-     * condition_wait(), which only happens after a new task was added to the queue),
-     * but it is wrong.
-     * Waiting on condition may wake up the thread even if condition is not signaled
-     * (spurious wake-ups), and some race condition may also empty the queue **after**
-     * condition has been signaled, but **before** awoken thread reaches this point...
-     * See http://stackoverflow.com/questions/8594591
-     *
-     * So we only abort here if do_exit is set.
-     */
-    if (scheduler->do_exit) {
-      BLI_mutex_unlock(&scheduler->queue_mutex);
-      return false;
-    }
+  BLI_mutex_lock(&scheduler->inject_mutex);
+  *r_tasks = inject->tasks;
+  BLI_listbase_clear(&inject->tasks);
+  inject->num = 0;
+  for (Task *task = r_tasks->first; task; task = task->next) {
+    atomic_sub_and_fetch_z((size_t *)&task->pool->num_injected, 1);
+  }
+  BLI_mutex_unlock(&scheduler->inject_mutex);
 
-    for (current_task = scheduler->queue.first; current_task != NULL;
-         current_task = current_task->next) {
-      TaskPool *pool = current_task->pool;
+  return r_tasks->first != NULL;
+}
 
-      if (scheduler->background_thread_only && !pool->run_in_background) {
-        continue;
-      }
+/* Takes the oldest task of the pool from an inject queue, the tasks of other
+ * pools stay where they are.
+ */
+static Task *task_scheduler_take_injected_pool_task(TaskScheduler *scheduler,
+                                                    eTaskInjectQueue queue,
+                                                    TaskPool *pool)
+{
+  TaskInjectQueue *inject = &scheduler->inject[queue];
+  Task *task;
+  if (inject->num == 0) {
+    return NULL;
+  }
 
-      *task = current_task;
-      found_task = true;
-      BLI_remlink(&scheduler->queue, *task);
+  BLI_mutex_lock(&scheduler->inject_mutex);
+  for (task = inject->tasks.first; task; task = task->next) {
+    if (task->pool == pool) {
+      BLI_remlink(&inject->tasks, task);
+      inject->num--;
+      atomic_sub_and_fetch_z((size_t *)&pool->num_injected, 1);
       break;
     }
-    if (!found_task) {
-      BLI_condition_wait(&scheduler->queue_cond, &scheduler->queue_mutex);
+  }
+  BLI_mutex_unlock(&scheduler->inject_mutex);
+
+  return task;
+}
+
+/* Puts tasks (oldest first) which the calling thread can't run to the inject
+ * queues of their priority, where any thread can pick them up.
+ */
+static void task_scheduler_reinject(TaskScheduler *scheduler, ListBase *tasks)
+{
+  while (tasks->first) {
+    /* Consecutive tasks of the same pool and queue are moved at once. */
+    Task *first = tasks->first, *last = first;
+    TaskPool *pool = first->pool;
+    const eTaskInjectQueue queue = task_scheduler_inject_queue(scheduler, first);
+    int num_tasks = 1;
+    while (last->next && last->next->pool == pool &&
+           task_scheduler_inject_queue(scheduler, last->next) == queue) {
+      last = last->next;
+      num_tasks++;
+    }
+    tasks->first = last->next;
+    if (last->next) {
+      last->next->prev = NULL;
+    }
+    else {
+      tasks->last = NULL;
     }
-  } while (!found_task);
+    last->next = NULL;
+    ListBase run = {first, last};
 
-  BLI_mutex_unlock(&scheduler->queue_mutex);
+    /* Keep the pool alive until its thread is woken up, the tasks might be
+     * done by then already.
+     */
+    task_pool_num_increase(pool, 1);
+    task_scheduler_inject(scheduler, queue, &run, num_tasks);
+    /* The pool's thread might have been looking for them while we had them. */
+    task_pool_wake(pool);
+    task_pool_num_decrease(pool, 1);
+  }
+}
 
-  return true;
+static void task_scheduler_push(TaskScheduler *scheduler,
+                                Task *task,
+                                TaskThread *thread,
+                                bool do_wake)
+{
+  TaskPool *pool = task->pool;
+
+  /* When waking up the pool's thread, keep the pool alive until it's woken
+   * up, the task might be done by then already.
+   */
+  task_pool_num_increase(pool, do_wake ? 2 : 1);
+
+  if (thread == NULL || (scheduler->background_thread_only && pool->run_in_background)) {
+    /* Threads without a deque inject their tasks, and so do background pools
+     * when there is only the fallback thread: it's the only one guaranteed to
+     * run them, and it doesn't steal from other threads.
+     */
+    ListBase tasks = {task, task};
+    task->next = task->prev = NULL;
+    task_scheduler_inject(scheduler, task_scheduler_inject_queue(scheduler, task), &tasks, 1);
+  }
+  else {
+    /* The newest task of a deque is popped first by its owner, so there is no
+     * need to prioritize in here.
+     */
+    task_deque_push(&thread->deque, task);
+    if (do_wake && !scheduler->background_thread_only) {
+      task_scheduler_wake(scheduler, 1);
+    }
+  }
+
+  if (do_wake) {
+    task_pool_wake(pool);
+    task_pool_num_decrease(pool, 1);
+  }
 }
 
-BLI_INLINE void handle_local_queue(TaskThreadLocalStorage *tls, const int thread_id)
+/* Looks for a task of the pool for a thread which waits for the pool.
+ *
+ * Tasks of other pools must not be run here: the pool might be waited for
+ * from within their task, which would deadlock. Tasks of other pools which
+ * are popped from the thread's own deque are handed to other threads.
+ */
+static Task *task_scheduler_find_pool_task(TaskScheduler *scheduler,
+                                           TaskPool *pool,
+                                           TaskThread *thread)
 {
-  BLI_assert(!tls->do_delayed_push);
-  while (tls->num_local_queue > 0) {
-    /* We pop task from queue before handling it so handler of the task can
-     * push next job to the local queue.
+  Task *task = NULL;
+
+  if (thread != NULL) {
+    /* Tasks of other pools which are newer than the pool's task are handed to
+     * other threads, in their order.
      */
-    tls->num_local_queue--;
-    Task *local_task = tls->local_queue[tls->num_local_queue];
-    /* TODO(sergey): Double-check work_and_wait() doesn't handle other's
-     * pool tasks.
+    ListBase others = {NULL, NULL};
+    while ((task = task_deque_pop(&thread->deque)) && task->pool != pool) {
+      BLI_addhead(&others, task);
+    }
+    task_scheduler_reinject(scheduler, &others);
+    if (task) {
+      return task;
+    }
+  }
+
+  if (pool->num_injected != 0) {
+    for (int queue = 0; queue < TASK_INJECT_NUM; queue++) {
+      if ((task = task_scheduler_take_injected_pool_task(scheduler, queue, pool))) {
+        return task;
+      }
+    }
+  }
+
+  for (int i = 0; i <= scheduler->num_threads; i++) {
+    TaskThread *victim = &scheduler->task_threads[i];
+    if (victim != thread && (task = task_deque_steal(&victim->deque, pool))) {
+      return task;
+    }
+  }
+
+  return NULL;
+}
+
+/* Looks for any task for a worker thread. */
+static Task *task_scheduler_thread_find_task(TaskScheduler *scheduler, TaskThread *thread)
+{
+  Task *task = task_deque_pop(&thread->deque);
+  if (task) {
+    return task;
+  }
+
+  for (int queue = 0; queue < TASK_INJECT_NUM; queue++) {
+    if ((queue == TASK_INJECT_BACKGROUND) != scheduler->background_thread_only) {
+      continue;
+    }
+    ListBase tasks;
+    if (!task_scheduler_take_injected(scheduler, queue, &tasks)) {
+      continue;
+    }
+    /* Run the oldest one and make the others available for stealing, newest
+     * first so we pop them in their order.
      */
-    TaskPool *local_pool = local_task->pool;
-    local_task->run(local_pool, local_task->taskdata, thread_id);
-    task_free(local_pool, local_task, thread_id);
+    Task *oldest = tasks.first;
+    int num_tasks = 0;
+    for (Task *task_push = tasks.last, *prev; task_push != oldest; task_push = prev) {
+      prev = task_push->prev;
+      task_deque_push(&thread->deque, task_push);
+      num_tasks++;
+    }
+    if (!scheduler->background_thread_only) {
+      task_scheduler_wake(scheduler, num_tasks);
+    }
+    return oldest;
   }
-  BLI_assert(!tls->do_delayed_push);
+
+  if (scheduler->background_thread_only) {
+    /* The only worker, only runs tasks of background pools. */
+    return NULL;
+  }
+
+  /* Steal from the other threads, starting at a random one so thieves don't
+   * all fight over the same deque. Xorshift is good enough for that.
+   */
+  uint32_t seed = thread->steal_seed;
+  seed ^= seed << 13;
+  seed ^= seed >> 17;
+  seed ^= seed << 5;
+  thread->steal_seed = seed;
+
+  const int num_task_threads = scheduler->num_threads + 1;
+  const int start = (int)(seed % (uint32_t)num_task_threads);
+  for (int i = 0; i < num_task_threads; i++) {
+    TaskThread *victim = &scheduler->task_threads[(start + i) % num_task_threads];
+    if (victim != thread && (task = task_deque_steal(&victim->deque, NULL))) {
+      return task;
+    }
+  }
+
+  return NULL;
+}
+
+static bool task_scheduler_thread_has_work(TaskScheduler *scheduler, TaskThread *thread)
+{
+  if (!task_deque_is_empty(&thread->deque)) {
+    return true;
+  }
+  if (scheduler->background_thread_only) {
+    return scheduler->inject[TASK_INJECT_BACKGROUND].num != 0;
+  }
+  if (scheduler->inject[TASK_INJECT_HIGH].num != 0 || scheduler->inject[TASK_INJECT_LOW].num != 0) {
+    return true;
+  }
+  for (int i = 0; i <= scheduler->num_threads; i++) {
+    if (!task_deque_is_empty(&scheduler->task_threads[i].deque)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void task_scheduler_thread_sleep(TaskScheduler *scheduler, TaskThread *thread)
+{
+  BLI_mutex_lock(&scheduler->sleep_mutex);
+
+  /* Announce the sleep before looking for work a last time: threads which
+   * push tasks look at the number of sleeping threads after publishing their
+   * tasks, so either they wake us up or we see their tasks.
+   */
+  atomic_add_and_fetch_uint32((uint32_t *)&scheduler->num_sleeping, 1);
+
+  /* Spurious wake-ups are fine, the caller looks for work again anyway. */
+  if (!scheduler->do_exit && !task_scheduler_thread_has_work(scheduler, thread)) {
+    BLI_condition_wait(&scheduler->sleep_cond, &scheduler->sleep_mutex);
+  }
+
+  atomic_sub_and_fetch_uint32((uint32_t *)&scheduler->num_sleeping, 1);
+
+  BLI_mutex_unlock(&scheduler->sleep_mutex);
+}
+
+/* Runs the task, or only frees it when its pool got canceled. */
+BLI_INLINE void task_execute(Task *task, const int thread_id)
+{
+  TaskPool *pool = task->pool;
+
+  if (!pool->do_cancel) {
+    task->run(pool, task->taskdata, thread_id);
+  }
+
+  task_free(pool, task, thread_id);
+
+  /* notify pool task was done */
+  task_pool_num_decrease(pool, 1);
 }
 
 static void *task_scheduler_thread_run(void *thread_p)
@@ -429,7 +945,7 @@ static void *task_scheduler_thread_run(void *thread_p)
   TaskThreadLocalStorage *tls = &thread->tls;
   TaskScheduler *scheduler = thread->scheduler;
   int thread_id = thread->id;
-  Task *task;
+  int num_idle = 0;
 
   pthread_setspecific(scheduler->tls_id_key, thread);
 
@@ -442,23 +958,23 @@ static void *task_scheduler_thread_run(void *thread_p)
   BLI_mutex_unlock(&scheduler->startup_mutex);
 
   /* keep popping off tasks */
-  while (task_scheduler_thread_wait_pop(scheduler, &task)) {
-    TaskPool *pool = task->pool;
+  while (!scheduler->do_exit) {
+    Task *task = task_scheduler_thread_find_task(scheduler, thread);
+
+    if (task == NULL) {
+      if (++num_idle >= IDLE_SPIN_COUNT) {
+        task_scheduler_thread_sleep(scheduler, thread);
+        num_idle = 0;
+      }
+      continue;
+    }
+    num_idle = 0;
 
-    /* run task */
     BLI_assert(!tls->do_delayed_push);
-    task->run(pool, task->taskdata, thread_id);
+    task_execute(task, thread_id);
     BLI_assert(!tls->do_delayed_push);
-
-    /* delete task */
-    task_free(pool, task, thread_id);
-
-    /* Handle all tasks from local queue. */
-    handle_local_queue(tls, thread_id);
-
-    /* notify pool task was done */
-    task_pool_num_decrease(pool, 1);
   }
+  UNUSED_VARS_NDEBUG(tls);
 
   return NULL;
 }
@@ -471,9 +987,11 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
    * threads, so we keep track of the number of users. */
   scheduler->do_exit = false;
 
-  BLI_listbase_clear(&scheduler->queue);
-  BLI_mutex_init(&scheduler->queue_mutex);
-  BLI_condition_init(&scheduler->queue_cond);
+  BLI_mutex_init(&scheduler->sleep_mutex);
+  BLI_condition_init(&scheduler->sleep_cond);
+  scheduler->num_sleeping = 0;
+
+  BLI_mutex_init(&scheduler->inject_mutex);
 
   BLI_mutex_init(&scheduler->startup_mutex);
   BLI_condition_init(&scheduler->startup_cond);
@@ -496,8 +1014,17 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
   scheduler->task_threads = MEM_mallocN(sizeof(TaskThread) * (num_threads + 1),
                                         "TaskScheduler task threads");
 
-  /* Initialize TLS for main thread. */
-  initialize_task_tls(&scheduler->task_threads[0].tls);
+  /* Initialize deques and TLS of all threads (including the main thread)
+   * before any of them starts stealing.
+   */
+  for (int i = 0; i < num_threads + 1; i++) {
+    TaskThread *thread = &scheduler->task_threads[i];
+    thread->scheduler = scheduler;
+    thread->id = i;
+    thread->steal_seed = 0x9E3779B9u * (uint32_t)(i + 1);
+    task_deque_init(&thread->deque);
+    initialize_task_tls(&thread->tls);
+  }
 
   pthread_key_create(&scheduler->tls_id_key, NULL);
 
@@ -510,9 +1037,6 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 
     for (i = 0; i < num_threads; i++) {
       TaskThread *thread = &scheduler->task_threads[i + 1];
-      thread->scheduler = scheduler;
-      thread->id = i + 1;
-      initialize_task_tls(&thread->tls);
 
       if (pthread_create(&scheduler->threads[i], NULL, task_scheduler_thread_run, thread) != 0) {
         fprintf(stderr, "TaskScheduler failed to launch thread %d/%d\n", i, num_threads);
@@ -536,13 +1060,11 @@ TaskScheduler *BLI_task_scheduler_create(int num_threads)
 
 void BLI_task_scheduler_free(TaskScheduler *scheduler)
 {
-  Task *task;
-
   /* stop all waiting threads */
-  BLI_mutex_lock(&scheduler->queue_mutex);
+  BLI_mutex_lock(&scheduler->sleep_mutex);
   scheduler->do_exit = true;
-  BLI_condition_notify_all(&scheduler->queue_cond);
-  BLI_mutex_unlock(&scheduler->queue_mutex);
+  BLI_condition_notify_all(&scheduler->sleep_cond);
+  BLI_mutex_unlock(&scheduler->sleep_mutex);
 
   pthread_key_delete(scheduler->tls_id_key);
 
@@ -559,25 +1081,31 @@ void BLI_task_scheduler_free(TaskScheduler *scheduler)
     MEM_freeN(scheduler->threads);
   }
 
-  /* Delete task thread data */
+  /* Delete task thread data, and leftover tasks */
   if (scheduler->task_threads) {
     for (int i = 0; i < scheduler->num_threads + 1; i++) {
-      TaskThreadLocalStorage *tls = &scheduler->task_threads[i].tls;
-      free_task_tls(tls);
+      TaskThread *thread = &scheduler->task_threads[i];
+      task_deque_free(&thread->deque);
+      free_task_tls(&thread->tls);
     }
 
     MEM_freeN(scheduler->task_threads);
   }
 
-  /* delete leftover tasks */
-  for (task = scheduler->queue.first; task; task = task->next) {
-    task_data_free(task, 0);
+  for (int queue = 0; queue < TASK_INJECT_NUM; queue++) {
+    Task *task = scheduler->inject[queue].tasks.first;
+    while (task) {
+      Task *next = task->next;
+      task_data_free(task, 0);
+      MEM_freeN(task);
+      task = next;
+    }
   }
-  BLI_freelistN(&scheduler->queue);
 
   /* delete mutex/condition */
-  BLI_mutex_end(&scheduler->queue_mutex);
-  BLI_condition_end(&scheduler->queue_cond);
+  BLI_mutex_end(&scheduler->inject_mutex);
+  BLI_mutex_end(&scheduler->sleep_mutex);
+  BLI_condition_end(&scheduler->sleep_cond);
   BLI_mutex_end(&scheduler->startup_mutex);
   BLI_condition_end(&scheduler->startup_cond);
 
@@ -589,70 +1117,6 @@ int BLI_task_scheduler_num_threads(TaskScheduler *scheduler)
   return scheduler->num_threads + 1;
 }
 
-static void task_scheduler_push(TaskScheduler *scheduler, Task *task, TaskPriority priority)
-{
-  task_pool_num_increase(task->pool, 1);
-
-  /* add task to queue */
-  BLI_mutex_lock(&scheduler->queue_mutex);
-
-  if (priority == TASK_PRIORITY_HIGH) {
-    BLI_addhead(&scheduler->queue, task);
-  }
-  else {
-    BLI_addtail(&scheduler->queue, task);
-  }
-
-  BLI_condition_notify_one(&scheduler->queue_cond);
-  BLI_mutex_unlock(&scheduler->queue_mutex);
-}
-
-static void task_scheduler_push_all(TaskScheduler *scheduler,
-                                    TaskPool *pool,
-                                    Task **tasks,
-                                    int num_tasks)
-{
-  if (num_tasks == 0) {
-    return;
-  }
-
-  task_pool_num_increase(pool, num_tasks);
-
-  BLI_mutex_lock(&scheduler->queue_mutex);
-
-  for (int i = 0; i < num_tasks; i++) {
-    BLI_addhead(&scheduler->queue, tasks[i]);
-  }
-
-  BLI_condition_notify_all(&scheduler->queue_cond);
-  BLI_mutex_unlock(&scheduler->queue_mutex);
-}
-
-static void task_scheduler_clear(TaskScheduler *scheduler, TaskPool *pool)
-{
-  Task *task, *nexttask;
-  size_t done = 0;
-
-  BLI_mutex_lock(&scheduler->queue_mutex);
-
-  /* free all tasks from this pool from the queue */
-  for (task = scheduler->queue.first; task; task = nexttask) {
-    nexttask = task->next;
-
-    if (task->pool == pool) {
-      task_data_free(task, pool->thread_id);
-      BLI_freelinkN(&scheduler->queue, task);
-
-      done++;
-    }
-  }
-
-  BLI_mutex_unlock(&scheduler->queue_mutex);
-
-  /* notify done */
-  task_pool_num_decrease(pool, done);
-}
-
 /* Task Pool */
 
 static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
@@ -677,8 +1141,10 @@ static TaskPool *task_pool_create_ex(TaskScheduler *scheduler,
 
   pool->scheduler = scheduler;
   pool->num = 0;
+  pool->num_sleeping = 0;
+  pool->wake_epoch = 0;
+  pool->num_injected = 0;
   pool->do_cancel = false;
-  pool->do_work = false;
   pool->is_suspended = is_suspended;
   pool->start_suspended = is_suspended;
   pool->num_suspended = 0;
@@ -796,11 +1262,6 @@ void BLI_task_pool_free(TaskPool *pool)
   BLI_threaded_malloc_end();
 }
 
-BLI_INLINE bool task_can_use_local_queues(TaskPool *pool, int thread_id)
-{
-  return (thread_id != -1 && (thread_id != pool->thread_id || pool->do_work));
-}
-
 static void task_pool_push(TaskPool *pool,
                            TaskRunFunction run,
                            void *taskdata,
@@ -816,6 +1277,7 @@ static void task_pool_push(TaskPool *pool,
   task->free_taskdata = free_taskdata;
   task->freedata = freedata;
   task->pool = pool;
+  task->priority = priority;
   /* For suspended pools we put everything yo a global queue first
    * and exit as soon as possible.
    *
@@ -827,32 +1289,19 @@ static void task_pool_push(TaskPool *pool,
     atomic_fetch_and_add_z(&pool->num_suspended, 1);
     return;
   }
-  /* Populate to any local queue first, this is cheapest push ever. */
-  if (task_can_use_local_queues(pool, thread_id)) {
-    ASSERT_THREAD_ID(pool->scheduler, thread_id);
+  /* In the delayed tasks push mode the other threads are woken up once all
+   * the tasks are pushed.
+   */
+  bool do_wake = true;
+  if (thread_id != -1) {
     TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
-    /* Try to push to a local execution queue.
-     * These tasks will be picked up next.
-     */
-    if (tls->num_local_queue < LOCAL_QUEUE_SIZE) {
-      tls->local_queue[tls->num_local_queue] = task;
-      tls->num_local_queue++;
-      return;
-    }
-    /* If we are in the delayed tasks push mode, we push tasks to a
-     * temporary local queue first without any locks, and then move them
-     * to global execution queue with a single lock.
-     */
-    if (tls->do_delayed_push && tls->num_delayed_queue < DELAYED_QUEUE_SIZE) {
-      tls->delayed_queue[tls->num_delayed_queue] = task;
-      tls->num_delayed_queue++;
-      return;
+    if (tls->do_delayed_push) {
+      tls->num_delayed_push++;
+      do_wake = false;
     }
   }
-  /* Do push to a global execution pool, slowest possible method,
-   * causes quite reasonable amount of threading overhead.
-   */
-  task_scheduler_push(pool->scheduler, task, priority);
+  task_scheduler_push(
+      pool->scheduler, task, task_scheduler_thread_from_id(pool, thread_id), do_wake);
 }
 
 void BLI_task_pool_push_ex(TaskPool *pool,
@@ -881,92 +1330,127 @@ void BLI_task_pool_push_from_thread(TaskPool *pool,
   task_pool_push(pool, run, taskdata, free_taskdata, NULL, priority, thread_id);
 }
 
-void BLI_task_pool_work_and_wait(TaskPool *pool)
+/* Moves the tasks of a suspended pool to actual execution. */
+static void task_pool_resume(TaskPool *pool, TaskThread *thread)
 {
-  TaskThreadLocalStorage *tls = get_task_tls(pool, pool->thread_id);
   TaskScheduler *scheduler = pool->scheduler;
+  Task *tasks = pool->suspended_queue.first;
+  const size_t num_tasks = pool->num_suspended;
 
-  if (atomic_fetch_and_and_uint8((uint8_t *)&pool->is_suspended, 0)) {
-    if (pool->num_suspended) {
-      task_pool_num_increase(pool, pool->num_suspended);
-      BLI_mutex_lock(&scheduler->queue_mutex);
-
-      BLI_movelisttolist(&scheduler->queue, &pool->suspended_queue);
+  if (num_tasks == 0) {
+    return;
+  }
 
-      BLI_condition_notify_all(&scheduler->queue_cond);
-      BLI_mutex_unlock(&scheduler->queue_mutex);
+  task_pool_num_increase(pool, num_tasks);
 
-      pool->num_suspended = 0;
+  if (thread != NULL) {
+    /* Suspended queue is in reverse order of pushes, so the owner pops the
+     * first pushed task first.
+     */
+    for (Task *task = tasks, *next; task; task = next) {
+      next = task->next;
+      task_deque_push(&thread->deque, task);
+    }
+    if (!scheduler->background_thread_only) {
+      task_scheduler_wake(scheduler, (int)min_zz(num_tasks, scheduler->num_threads));
     }
   }
+  else {
+    ListBase queue = {NULL, NULL};
+    for (Task *task = pool->suspended_queue.last, *prev; task; task = prev) {
+      prev = task->prev;
+      BLI_addtail(&queue, task);
+    }
+    task_scheduler_reinject(scheduler, &queue);
+  }
 
-  pool->do_work = true;
-
-  ASSERT_THREAD_ID(pool->scheduler, pool->thread_id);
-
-  handle_local_queue(tls, pool->thread_id);
-
-  BLI_mutex_lock(&pool->num_mutex);
-
-  while (pool->num != 0) {
-    Task *task, *work_task = NULL;
-    bool found_task = false;
-
-    BLI_mutex_unlock(&pool->num_mutex);
+  BLI_listbase_clear(&pool->suspended_queue);
+  pool->num_suspended = 0;
+}
 
-    BLI_mutex_lock(&scheduler->queue_mutex);
+/* Helps running (or discarding, for canceled pools) the tasks of the pool
+ * until all of them are done.
+ */
+static void task_pool_wait(TaskPool *pool, TaskThread *thread, const int thread_id)
+{
+  TaskScheduler *scheduler = pool->scheduler;
 
-    /* find task from this pool. if we get a task from another pool,
-     * we can get into deadlock */
+  for (;;) {
+    const uint32_t wake_epoch = pool->wake_epoch;
 
-    for (task = scheduler->queue.first; task; task = task->next) {
-      if (task->pool == pool) {
-        work_task = task;
-        found_task = true;
-        BLI_remlink(&scheduler->queue, task);
+    if (pool->num == 0) {
+      /* NOTE: Only checking for done tasks with the lock held, see
+       * task_pool_num_decrease(). */
+      BLI_mutex_lock(&pool->num_mutex);
+      const bool is_done = (pool->num == 0);
+      BLI_mutex_unlock(&pool->num_mutex);
+      if (is_done) {
         break;
       }
     }
 
-    BLI_mutex_unlock(&scheduler->queue_mutex);
-
-    /* if found task, do it, otherwise wait until other tasks are done */
-    if (found_task) {
-      /* run task */
-      BLI_assert(!tls->do_delayed_push);
-      work_task->run(pool, work_task->taskdata, pool->thread_id);
-      BLI_assert(!tls->do_delayed_push);
-
-      /* delete task */
-      task_free(pool, task, pool->thread_id);
-
-      /* Handle all tasks from local queue. */
-      handle_local_queue(tls, pool->thread_id);
+    Task *task = task_scheduler_find_pool_task(scheduler, pool, thread);
+    if (task == NULL) {
+      /* Announce the sleep and look again: threads which push tasks to the
+       * pool check for sleeping threads after publishing them.
+       */
+      atomic_add_and_fetch_uint32((uint32_t *)&pool->num_sleeping, 1);
+      task = task_scheduler_find_pool_task(scheduler, pool, thread);
+      bool is_done = false;
+      if (task == NULL) {
+        /* NOTE: Only checking for done tasks with the lock held, see
+         * task_pool_num_decrease(). */
+        BLI_mutex_lock(&pool->num_mutex);
+        while (pool->num != 0 && pool->wake_epoch == wake_epoch) {
+          BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
+        }
+        is_done = (pool->num == 0);
+        BLI_mutex_unlock(&pool->num_mutex);
+      }
+      atomic_sub_and_fetch_uint32((uint32_t *)&pool->num_sleeping, 1);
 
-      /* notify pool task was done */
-      task_pool_num_decrease(pool, 1);
+      if (is_done) {
+        break;
+      }
+      if (task == NULL) {
+        continue;
+      }
     }
 
-    BLI_mutex_lock(&pool->num_mutex);
-    if (pool->num == 0) {
-      break;
+    if (thread_id == -1) {
+      /* Canceling from a thread which might not own the pool's TLS. */
+      BLI_assert(pool->do_cancel);
+      task_data_free(task, pool->thread_id);
+      MEM_freeN(task);
+      task_pool_num_decrease(pool, 1);
     }
-
-    if (!found_task) {
-      BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
+    else {
+      task_execute(task, thread_id);
     }
   }
+}
 
-  BLI_mutex_unlock(&pool->num_mutex);
+void BLI_task_pool_work_and_wait(TaskPool *pool)
+{
+  TaskThreadLocalStorage *tls = get_task_tls(pool, pool->thread_id);
+  TaskThread *thread = task_scheduler_thread_from_id(pool, pool->thread_id);
+
+  ASSERT_THREAD_ID(pool->scheduler, pool->thread_id);
+
+  if (atomic_fetch_and_and_uint8((uint8_t *)&pool->is_suspended, 0)) {
+    task_pool_resume(pool, thread);
+  }
 
-  BLI_assert(tls->num_local_queue == 0);
+  BLI_assert(!tls->do_delayed_push);
+  task_pool_wait(pool, thread, pool->thread_id);
+  BLI_assert(!tls->do_delayed_push);
+  UNUSED_VARS_NDEBUG(tls);
 }
 
 void BLI_task_pool_work_wait_and_reset(TaskPool *pool)
 {
   BLI_task_pool_work_and_wait(pool);
 
-  pool->do_work = false;
   pool->is_suspended = pool->start_suspended;
 }
 
@@ -974,14 +1458,10 @@ void BLI_task_pool_cancel(TaskPool *pool)
 {
   pool->do_cancel = true;
 
-  task_scheduler_clear(pool->scheduler, pool);
-
-  /* wait until all entries are cleared */
-  BLI_mutex_lock(&pool->num_mutex);
-  while (pool->num) {
-    BLI_condition_wait(&pool->num_cond, &pool->num_mutex);
-  }
-  BLI_mutex_unlock(&pool->num_mutex);
+  /* Free all tasks of this pool which didn't start yet, and wait until the
+   * running ones are done.
+   */
+  task_pool_wait(pool, task_scheduler_current_thread(pool->scheduler), -1);
 
   pool->do_cancel = false;
 }
@@ -1003,22 +1483,31 @@ ThreadMutex *BLI_task_pool_user_mutex(TaskPool *pool)
 
 void BLI_task_pool_delayed_push_begin(TaskPool *pool, int thread_id)
 {
-  if (task_can_use_local_queues(pool, thread_id)) {
+  if (thread_id != -1) {
     ASSERT_THREAD_ID(pool->scheduler, thread_id);
     TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
+    BLI_assert(!tls->do_delayed_push);
     tls->do_delayed_push = true;
+    /* Keeps the pool alive until the pool's thread is woken up at the end. */
+    task_pool_num_increase(pool, 1);
   }
 }
 
 void BLI_task_pool_delayed_push_end(TaskPool *pool, int thread_id)
 {
-  if (task_can_use_local_queues(pool, thread_id)) {
+  if (thread_id != -1) {
     ASSERT_THREAD_ID(pool->scheduler, thread_id);
     TaskThreadLocalStorage *tls = get_task_tls(pool, thread_id);
     BLI_assert(tls->do_delayed_push);
-    task_scheduler_push_all(pool->scheduler, pool, tls->delayed_queue, tls->num_delayed_queue);
+    if (tls->num_delayed_push > 0) {
+      if (!pool->scheduler->background_thread_only) {
+        task_scheduler_wake(pool->scheduler, tls->num_delayed_push);
+      }
+      task_pool_wake(pool);
+    }
     tls->do_delayed_push = false;
-    tls->num_delayed_queue = 0;
+    tls->num_delayed_push = 0;
+    task_pool_num_decrease(pool, 1);
   }
 }
 
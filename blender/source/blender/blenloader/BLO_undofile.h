@@ -25,15 +25,25 @@
  * \ingroup blenloader
  */
 
+struct GHash;
+struct GSet;
 struct Scene;
 
 typedef struct {
   void *next, *prev;
+  /** Reference counted, may be shared with chunks of other undo steps. */
   const char *buf;
   /** Size in bytes. */
   unsigned int size;
+  /** Hash of the contents of #buf. */
+  unsigned int hash;
   /** When true, this chunk doesn't own the memory, it's shared with a previous #MemFileChunk */
   bool is_identical;
+  /**
+   * Address of the ID this chunk holds data of (NULL for other data).
+   * Only compared, the ID may not exist anymore.
+   */
+  const void *id;
 } MemFileChunk;
 
 typedef struct MemFile {
@@ -47,11 +57,30 @@ typedef struct MemFileUndoData {
   size_t undo_size;
 } MemFileUndoData;
 
+/** State used while writing a #MemFile. */
+typedef struct MemFileWriteData {
+  MemFile *written_memfile;
+  /** The memfile of the previous undo step (can be NULL). */
+  MemFile *reference_memfile;
+  /** Most likely match for the next chunk, checked before looking up #reference_chunks. */
+  MemFileChunk *reference_current_chunk;
+  /** Chunks of #reference_memfile, by contents. */
+  struct GSet *reference_chunks;
+  /** First chunk of each ID of #reference_memfile, by ID address (can be NULL). */
+  struct GHash *reference_ids;
+  /** ID the written data belongs to, see #MemFileChunk.id. */
+  const void *current_id;
+} MemFileWriteData;
+
 /* actually only used writefile.c */
-extern void memfile_chunk_add(MemFile *memfile,
-                              const char *buf,
-                              unsigned int size,
-                              MemFileChunk **compchunk_step);
+extern void memfile_write_init(MemFileWriteData *mem_data,
+                               MemFile *written_memfile,
+                               MemFile *reference_memfile,
+                               const bool use_reference_ids);
+extern void memfile_write_finalize(MemFileWriteData *mem_data);
+extern void memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, unsigned int size);
+extern MemFileChunk *memfile_id_chunk_find(MemFileWriteData *mem_data, const void *id);
+extern void memfile_id_chunks_reuse(MemFileWriteData *mem_data, MemFileChunk *chunk);
 
 /* exports */
 extern void BLO_memfile_free(MemFile *memfile);
@@ -144,6 +144,11 @@ LinkNode *BLO_blendhandle_get_datablock_names(BlendHandle *bh, int ofblocktype,
   BHead *bhead;
   int tot = 0;
 
+  if (fd->bhead_index) {
+    /* Avoid reading all blocks of files which have an index. */
+    return blo_bhead_index_get_datablock_names(fd, ofblocktype, tot_names);
+  }
+
   for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
     if (bhead->code == ofblocktype) {
       const char *idname = blo_bhead_id_name(fd, bhead);
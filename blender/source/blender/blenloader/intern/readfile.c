@@ -97,9 +97,11 @@
 #include "BLI_endian_switch.h"
 #include "BLI_blenlib.h"
 #include "BLI_math.h"
+#include "BLI_task.h"
 #include "BLI_threads.h"
 #include "BLI_mempool.h"
 #include "BLI_ghash.h"
+#include "BLI_linklist.h"
 
 #include "BLT_translation.h"
 
@@ -154,6 +156,7 @@
 #include "RE_engine.h"
 
 #include "readfile.h"
+#include "zframes.h"
 
 #include <errno.h>
 
@@ -222,6 +225,21 @@
 /* Use GHash for restoring pointers by name */
 #define USE_GHASH_RESTORE_POINTER
 
+/**
+ * Reconstruct the structs which changed layout since the file was written in parallel,
+ * see #read_data_reconstruct_begin.
+ */
+#define USE_PARALLEL_RECONSTRUCT
+
+/**
+ * With this #G.debug_value, reconstruct all the structs as if their layout changed since
+ * the file was written (to test reconstruction, see `tests/python/bl_blendfile_load.py`).
+ */
+#define DEBUG_VALUE_RECONSTRUCT_ALL 1841
+
+/** Decompress gzip files on a separate thread, see #fd_gzip_read_ahead_begin. */
+#define USE_GZIP_READ_AHEAD
+
 /* Define this to have verbose debug prints. */
 //#define USE_DEBUG_PRINT
 
@@ -237,6 +255,7 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname);
 static void direct_link_modifiers(FileData *fd, ListBase *lb);
 static BHead *find_bhead_from_code_name(FileData *fd, const short idcode, const char *name);
 static BHead *find_bhead_from_idname(FileData *fd, const char *idname);
+static BHead *blo_bhead_first_global(FileData *fd);
 
 #ifdef USE_COLLECTION_COMPAT_28
 static void expand_scene_collection(FileData *fd, Main *mainvar, SceneCollection *sc);
@@ -580,7 +599,7 @@ static void read_file_version(FileData *fd, Main *main)
 {
   BHead *bhead;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first_global(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
     if (bhead->code == GLOB) {
       FileGlobal *fg = read_struct(fd, bhead, "Global");
       if (fg) {
@@ -610,6 +629,11 @@ static void read_file_bhead_idname_map_create(FileData *fd)
   int code_prev = ENDB;
   uint reserve = 0;
 
+  if (fd->bhead_index) {
+    /* Names are looked up in the index, see #bhead_index_find_bhead_from_idname. */
+    return;
+  }
+
   for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
     if (code_prev != bhead->code) {
       code_prev = bhead->code;
@@ -895,11 +919,330 @@ static BHeadN *get_bhead(FileData *fd)
   return new_bhead;
 }
 
+/* -------------------------------------------------------------------- */
+/** \name Block Index
+ *
+ * Files written with a #BHeadIndexFooter can be read lazily: the ID names and the
+ * pointers to the ID blocks are looked up in the index and only the blocks found are read
+ * (with the #DATA blocks following them), so linking a few data-blocks from a large
+ * library doesn't read all the blocks of the file.
+ *
+ * The blocks read are kept in #FileData.bhead_list in file order,
+ * iterating over all blocks with #blo_bhead_first reads the remaining blocks.
+ * \{ */
+
+typedef struct BHeadIndexSegment {
+  /** The blocks of the entry once read, see #bhead_index_load. */
+  BHeadN *first, *last;
+} BHeadIndexSegment;
+
+typedef struct BHeadIndex {
+  BHeadIndexEntry *entries;
+  BHeadIndexSegment *segments;
+  int entries_len;
+  /** Entries of ID blocks (and link placeholders) sorted by #BHeadIndexEntry.old. */
+  BHeadIndexEntry **entries_by_old;
+  int entries_by_old_len;
+  /** #ID.name of linkable ID blocks to #BHeadIndexEntry. */
+  GHash *entries_by_idname;
+} BHeadIndex;
+
+static int bhead_index_entry_old_cmp(const void *a, const void *b)
+{
+  const BHeadIndexEntry *entry_a = *(const BHeadIndexEntry **)a;
+  const BHeadIndexEntry *entry_b = *(const BHeadIndexEntry **)b;
+
+  if (entry_a->old > entry_b->old) {
+    return 1;
+  }
+  else if (entry_a->old < entry_b->old) {
+    return -1;
+  }
+  return 0;
+}
+
+static bool bhead_index_entries_validate(const BHeadIndexEntry *entries,
+                                         const int entries_len,
+                                         const uint64_t endb_offset)
+{
+  uint64_t offset_prev = SIZEOFBLENDERHEADER;
+  for (int i = 0; i < entries_len; i++) {
+    const BHeadIndexEntry *entry = &entries[i];
+    if ((entry->offset < offset_prev) || (entry->blocks_len < 1) || (entry->code == DATA) ||
+        (entry->name[sizeof(entry->name) - 1] != '\0')) {
+      return false;
+    }
+    offset_prev = entry->offset + sizeof(BHead);
+  }
+  const BHeadIndexEntry *entry_last = &entries[entries_len - 1];
+  return (entry_last->code == ENDB) && (entry_last->offset == endb_offset);
+}
+
+static void bhead_index_free(BHeadIndex *bi)
+{
+  BLI_ghash_free(bi->entries_by_idname, NULL, NULL);
+  MEM_freeN(bi->entries_by_old);
+  MEM_freeN(bi->segments);
+  MEM_freeN(bi->entries);
+  MEM_freeN(bi);
+}
+
+/**
+ * Read the index at the end of the file (when there is one),
+ * after this blocks are only read when looked up.
+ */
+static void bhead_index_read(FileData *fd)
+{
+  /* The index uses the pointer size and endian of the file,
+   * files from other platforms are read without it. */
+  if ((fd->seek == NULL) ||
+      (fd->flags & (FD_FLAGS_SWITCH_ENDIAN | FD_FLAGS_POINTSIZE_DIFFERS))) {
+    return;
+  }
+
+  const off64_t file_offset = fd->file_offset;
+  BHeadIndexEntry *entries = NULL;
+  BHeadIndexFooter footer;
+  BHead bhead;
+  bool ok = false;
+
+  const off64_t footer_offset = fd->seek(fd, -(off64_t)(sizeof(footer) + sizeof(bhead)), SEEK_END);
+  if ((footer_offset != -1) && (fd->read(fd, &footer, sizeof(footer)) == sizeof(footer)) &&
+      (fd->read(fd, &bhead, sizeof(bhead)) == sizeof(bhead)) && (bhead.code == ENDB) &&
+      (memcmp(footer.magic, BHEAD_INDEX_MAGIC, sizeof(footer.magic)) == 0) &&
+      (footer.entries_len != 0) && (footer.entries_len < INT_MAX / sizeof(*entries)) &&
+      (footer.offset < (uint64_t)footer_offset)) {
+    const size_t entries_size = sizeof(*entries) * footer.entries_len;
+    if ((fd->seek(fd, (off64_t)footer.offset, SEEK_SET) != -1) &&
+        (fd->read(fd, &bhead, sizeof(bhead)) == sizeof(bhead)) && (bhead.code == DATA) &&
+        ((size_t)bhead.len == entries_size + sizeof(footer))) {
+      entries = MEM_mallocN(entries_size, __func__);
+      ok = (fd->read(fd, entries, (uint)entries_size) == (int)entries_size) &&
+           bhead_index_entries_validate(entries,
+                                        (int)footer.entries_len,
+                                        (uint64_t)footer_offset + sizeof(footer));
+    }
+  }
+
+  if (!ok) {
+    if (entries) {
+      MEM_freeN(entries);
+    }
+    fd->seek(fd, file_offset, SEEK_SET);
+    return;
+  }
+
+  BHeadIndex *bi = MEM_callocN(sizeof(*bi), __func__);
+  bi->entries = entries;
+  bi->entries_len = (int)footer.entries_len;
+  bi->segments = MEM_calloc_arrayN(bi->entries_len, sizeof(*bi->segments), __func__);
+  bi->entries_by_old = MEM_malloc_arrayN(bi->entries_len, sizeof(*bi->entries_by_old), __func__);
+  bi->entries_by_idname = BLI_ghash_str_new(__func__);
+
+  for (int i = 0; i < bi->entries_len; i++) {
+    BHeadIndexEntry *entry = &entries[i];
+    if (entry->name[0] == '\0') {
+      continue;
+    }
+    bi->entries_by_old[bi->entries_by_old_len++] = entry;
+    if (BKE_idcode_is_valid(entry->code) && BKE_idcode_is_linkable(entry->code)) {
+      BLI_ghash_insert(bi->entries_by_idname, entry->name, entry);
+    }
+  }
+  qsort(bi->entries_by_old,
+        bi->entries_by_old_len,
+        sizeof(*bi->entries_by_old),
+        bhead_index_entry_old_cmp);
+
+  fd->bhead_index = bi;
+  /* Blocks are only read by #bhead_index_load from now on. */
+  fd->is_eof = true;
+}
+
+/**
+ * Read the blocks of an entry (when not read yet).
+ * \return The first block, NULL when the file can't be read.
+ */
+static BHead *bhead_index_load(FileData *fd, const BHeadIndexEntry *entry)
+{
+  BHeadIndex *bi = fd->bhead_index;
+  const int index = (int)(entry - bi->entries);
+  BHeadIndexSegment *segment = &bi->segments[index];
+
+  if (segment->first) {
+    return &segment->first->bhead;
+  }
+
+  /* Read the blocks in a list of their own (#get_bhead adds to #FileData.bhead_list). */
+  ListBase bhead_list = fd->bhead_list;
+  BLI_listbase_clear(&fd->bhead_list);
+
+  int blocks_len = 0;
+  fd->is_eof = false;
+  if (fd->seek(fd, (off64_t)entry->offset, SEEK_SET) != -1) {
+    while ((blocks_len < entry->blocks_len) && get_bhead(fd)) {
+      blocks_len++;
+    }
+  }
+  fd->is_eof = true;
+
+  ListBase segment_list = fd->bhead_list;
+  fd->bhead_list = bhead_list;
+
+  BHeadN *first = segment_list.first, *last = segment_list.last;
+  if ((blocks_len != entry->blocks_len) || (first->bhead.code != entry->code) ||
+      ((uint64_t)(uintptr_t)first->bhead.old != entry->old)) {
+    BLI_freelistN(&segment_list);
+    return NULL;
+  }
+
+  /* Keep the list in file order, after the blocks of the previous entry read. */
+  BHeadN *prev = NULL;
+  for (int i = index - 1; i >= 0; i--) {
+    if (bi->segments[i].last) {
+      prev = bi->segments[i].last;
+      break;
+    }
+  }
+  BHeadN *next = prev ? prev->next : fd->bhead_list.first;
+
+  first->prev = prev;
+  last->next = next;
+  if (prev) {
+    prev->next = first;
+  }
+  else {
+    fd->bhead_list.first = first;
+  }
+  if (next) {
+    next->prev = last;
+  }
+  else {
+    fd->bhead_list.last = last;
+  }
+
+  segment->first = first;
+  segment->last = last;
+
+  return &first->bhead;
+}
+
+/**
+ * Read all the blocks, after this the file is read as if it had no index.
+ */
+static void bhead_index_load_all(FileData *fd)
+{
+  BHeadIndex *bi = fd->bhead_index;
+  for (int i = 0; i < bi->entries_len; i++) {
+    bhead_index_load(fd, &bi->entries[i]);
+  }
+  bhead_index_free(bi);
+  fd->bhead_index = NULL;
+}
+
+/**
+ * Like #blo_bhead_first, to look for the #GLOB and #DNA1 blocks (needed before reading
+ * data-blocks), only these blocks are read in files which have an index.
+ */
+static BHead *blo_bhead_first_global(FileData *fd)
+{
+  BHeadIndex *bi = fd->bhead_index;
+  if (bi == NULL) {
+    return blo_bhead_first(fd);
+  }
+
+  for (int i = 0; i < bi->entries_len; i++) {
+    if (ELEM(bi->entries[i].code, GLOB, DNA1)) {
+      bhead_index_load(fd, &bi->entries[i]);
+    }
+  }
+  BHeadN *new_bhead = fd->bhead_list.first;
+  return new_bhead ? &new_bhead->bhead : NULL;
+}
+
+static BHeadIndexEntry *bhead_index_find_old(FileData *fd, const void *old)
+{
+  BHeadIndex *bi = fd->bhead_index;
+  const BHeadIndexEntry entry_key = {.old = (uint64_t)(uintptr_t)old};
+  const BHeadIndexEntry *entry_key_p = &entry_key;
+
+  BHeadIndexEntry **entry_p = bsearch(&entry_key_p,
+                                      bi->entries_by_old,
+                                      bi->entries_by_old_len,
+                                      sizeof(*bi->entries_by_old),
+                                      bhead_index_entry_old_cmp);
+  return entry_p ? *entry_p : NULL;
+}
+
+/** Lookup an ID block by its old pointer, see #find_bhead. */
+static BHead *bhead_index_find_bhead(FileData *fd, const void *old)
+{
+  BHeadIndexEntry *entry = bhead_index_find_old(fd, old);
+  return entry ? bhead_index_load(fd, entry) : NULL;
+}
+
+/** Lookup a linkable ID block by its name, see #find_bhead_from_idname. */
+static BHead *bhead_index_find_bhead_from_idname(FileData *fd, const char *idname)
+{
+  BHeadIndexEntry *entry = BLI_ghash_lookup(fd->bhead_index->entries_by_idname, idname);
+  return entry ? bhead_index_load(fd, entry) : NULL;
+}
+
+/** Lookup the library of a link placeholder, see #find_previous_lib. */
+static BHead *bhead_index_find_previous_lib(FileData *fd, BHead *bhead)
+{
+  BHeadIndex *bi = fd->bhead_index;
+  const BHeadIndexEntry *entry = bhead_index_find_old(fd, bhead->old);
+  if (entry == NULL) {
+    return NULL;
+  }
+
+  const int index = (int)(entry - bi->entries);
+  if (bi->segments[index].first != BHEADN_FROM_BHEAD(bhead)) {
+    return NULL;
+  }
+
+  for (int i = index; i >= 0; i--) {
+    if (bi->entries[i].code == ID_LI) {
+      return bhead_index_load(fd, &bi->entries[i]);
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Names of the ID blocks of a type, without reading the blocks,
+ * see #BLO_blendhandle_get_datablock_names.
+ */
+LinkNode *blo_bhead_index_get_datablock_names(FileData *fd, int code, int *r_tot)
+{
+  BHeadIndex *bi = fd->bhead_index;
+  LinkNode *names = NULL;
+  int tot = 0;
+
+  for (int i = 0; i < bi->entries_len; i++) {
+    const BHeadIndexEntry *entry = &bi->entries[i];
+    if (entry->code == code) {
+      BLI_linklist_prepend(&names, strdup(entry->name + 2));
+      tot++;
+    }
+  }
+
+  *r_tot = tot;
+  return names;
+}
+
+/** \} */
+
 BHead *blo_bhead_first(FileData *fd)
 {
   BHeadN *new_bhead;
   BHead *bhead = NULL;
 
+  if (fd->bhead_index) {
+    bhead_index_load_all(fd);
+  }
+
   /* Rewind the file
    * Read in a new block if necessary
    */
@@ -1039,7 +1382,7 @@ static bool read_file_dna(FileData *fd, const char **r_error_message)
   BHead *bhead;
   int subversion = 0;
 
-  for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
+  for (bhead = blo_bhead_first_global(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
     if (bhead->code == GLOB) {
       /* Before this, the subversion didn't exist in 'FileGlobal' so the subversion
        * value isn't accessible for the purpose of DNA versioning in this case. */
@@ -1063,6 +1406,15 @@ static bool read_file_dna(FileData *fd, const char **r_error_message)
       if (fd->filesdna) {
         blo_do_versions_dna(fd->filesdna, fd->fileversion, subversion);
         fd->compflags = DNA_struct_get_compareflags(fd->filesdna, fd->memsdna);
+        if (UNLIKELY(G.debug_value == DEBUG_VALUE_RECONSTRUCT_ALL)) {
+          /* Skipping #Link, also used for raw data, see #DNA_struct_get_compareflags. */
+          char *compflags = (char *)fd->compflags;
+          for (int i = 1; i < fd->filesdna->structs_len; i++) {
+            if (compflags[i] == SDNA_CMP_EQUAL) {
+              compflags[i] = SDNA_CMP_NOT_EQUAL;
+            }
+          }
+        }
         /* used to retrieve ID names from (bhead+1) */
         fd->id_name_offs = DNA_elem_offset(fd->filesdna, "ID", "char", "name[]");
 
@@ -1165,6 +1517,171 @@ static int fd_read_gzip_from_file(FileData *filedata, void *buffer, uint size)
   return (readsize);
 }
 
+/* Frame compressed file reading, see #ZFramesReader. */
+
+static int fd_read_zframes_from_file(FileData *filedata, void *buffer, uint size)
+{
+  int readsize = blo_zframes_reader_read(filedata->zframes, buffer, size);
+
+  if (readsize < 0) {
+    readsize = EOF;
+  }
+  else {
+    filedata->file_offset += readsize;
+  }
+
+  return (readsize);
+}
+
+static off64_t fd_seek_zframes_from_file(FileData *filedata, off64_t offset, int whence)
+{
+  filedata->file_offset = blo_zframes_reader_seek(filedata->zframes, offset, whence);
+  return filedata->file_offset;
+}
+
+/* GZip file reading, decompressing ahead on another thread. */
+
+#ifdef USE_GZIP_READ_AHEAD
+
+/* Size and number of decompressed blocks kept ahead of the reading. */
+#  define GZIP_READ_AHEAD_BLOCK_SIZE (1 << 20)
+#  define GZIP_READ_AHEAD_BLOCKS_NUM 4
+
+typedef struct GzipReadAhead {
+  gzFile gzfile;
+  ListBase threads;
+  ThreadMutex mutex;
+  ThreadCondition cond;
+
+  char *blocks[GZIP_READ_AHEAD_BLOCKS_NUM];
+  /** Size of the decompressed data, zero at the end of the file and negative on errors. */
+  int blocks_len[GZIP_READ_AHEAD_BLOCKS_NUM];
+  /** Number of blocks decompressed and read since the start (used as a ring buffer). */
+  uint64_t blocks_written, blocks_read;
+  /** Reading position in the current block. */
+  int block_offset;
+
+  bool do_exit;
+} GzipReadAhead;
+
+static void *gzip_read_ahead_thread(void *data)
+{
+  GzipReadAhead *ra = data;
+  int len;
+
+  do {
+    BLI_mutex_lock(&ra->mutex);
+    while (!ra->do_exit &&
+           (ra->blocks_written - ra->blocks_read == GZIP_READ_AHEAD_BLOCKS_NUM)) {
+      BLI_condition_wait(&ra->cond, &ra->mutex);
+    }
+    const bool do_exit = ra->do_exit;
+    const int index = (int)(ra->blocks_written % GZIP_READ_AHEAD_BLOCKS_NUM);
+    BLI_mutex_unlock(&ra->mutex);
+
+    if (do_exit) {
+      break;
+    }
+
+    len = gzread(ra->gzfile, ra->blocks[index], GZIP_READ_AHEAD_BLOCK_SIZE);
+
+    BLI_mutex_lock(&ra->mutex);
+    ra->blocks_len[index] = len;
+    ra->blocks_written++;
+    BLI_condition_notify_all(&ra->cond);
+    BLI_mutex_unlock(&ra->mutex);
+  } while (len > 0);
+
+  return NULL;
+}
+
+static int fd_read_gzip_read_ahead(FileData *filedata, void *buffer, uint size)
+{
+  GzipReadAhead *ra = filedata->gzip_read_ahead;
+  int readsize = 0;
+
+  while (size > 0) {
+    BLI_mutex_lock(&ra->mutex);
+    while (ra->blocks_read == ra->blocks_written) {
+      BLI_condition_wait(&ra->cond, &ra->mutex);
+    }
+    const int index = (int)(ra->blocks_read % GZIP_READ_AHEAD_BLOCKS_NUM);
+    BLI_mutex_unlock(&ra->mutex);
+
+    const int len = ra->blocks_len[index];
+    if (len <= 0) {
+      /* The end of the file, or an error (stays the last block). */
+      if (len < 0 && readsize == 0) {
+        return EOF;
+      }
+      break;
+    }
+
+    const int copy_len = MIN2((int)size, len - ra->block_offset);
+    memcpy(POINTER_OFFSET(buffer, readsize), ra->blocks[index] + ra->block_offset, copy_len);
+    readsize += copy_len;
+    size -= (uint)copy_len;
+    ra->block_offset += copy_len;
+
+    if (ra->block_offset == len) {
+      ra->block_offset = 0;
+      BLI_mutex_lock(&ra->mutex);
+      ra->blocks_read++;
+      BLI_condition_notify_all(&ra->cond);
+      BLI_mutex_unlock(&ra->mutex);
+    }
+  }
+
+  filedata->file_offset += readsize;
+  return readsize;
+}
+
+/**
+ * Decompress on a separate thread, so decompressing and reading the data-blocks overlap.
+ * The data read is the same as with #fd_read_gzip_from_file.
+ */
+static void fd_gzip_read_ahead_begin(FileData *fd)
+{
+  if (BLI_system_thread_count() < 2) {
+    return;
+  }
+
+  GzipReadAhead *ra = MEM_callocN(sizeof(*ra), __func__);
+  ra->gzfile = fd->gzfiledes;
+  for (int i = 0; i < GZIP_READ_AHEAD_BLOCKS_NUM; i++) {
+    ra->blocks[i] = MEM_mallocN(GZIP_READ_AHEAD_BLOCK_SIZE, __func__);
+  }
+  BLI_mutex_init(&ra->mutex);
+  BLI_condition_init(&ra->cond);
+
+  fd->gzip_read_ahead = ra;
+  fd->read = fd_read_gzip_read_ahead;
+
+  BLI_threadpool_init(&ra->threads, gzip_read_ahead_thread, 1);
+  BLI_threadpool_insert(&ra->threads, ra);
+}
+
+static void fd_gzip_read_ahead_end(FileData *fd)
+{
+  GzipReadAhead *ra = fd->gzip_read_ahead;
+
+  BLI_mutex_lock(&ra->mutex);
+  ra->do_exit = true;
+  BLI_condition_notify_all(&ra->cond);
+  BLI_mutex_unlock(&ra->mutex);
+  BLI_threadpool_end(&ra->threads);
+
+  BLI_condition_end(&ra->cond);
+  BLI_mutex_end(&ra->mutex);
+  for (int i = 0; i < GZIP_READ_AHEAD_BLOCKS_NUM; i++) {
+    MEM_freeN(ra->blocks[i]);
+  }
+  MEM_freeN(ra);
+  fd->gzip_read_ahead = NULL;
+}
+
+#endif /* USE_GZIP_READ_AHEAD */
+
 /* Memory reading. */
 
 static int fd_read_from_memory(FileData *filedata, void *buffer, uint size)
@@ -1266,6 +1783,7 @@ static FileData *blo_decode_and_check(FileData *fd, ReportList *reports)
 
   if (fd->flags & FD_FLAGS_FILE_OK) {
     const char *error_message = NULL;
+    bhead_index_read(fd);
     if (read_file_dna(fd, &error_message) == false) {
       BKE_reportf(
           reports, RPT_ERROR, "Failed to read blend file '%s': %s", fd->relabase, error_message);
@@ -1291,6 +1809,7 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
   FileDataSeekFn *seek_fn = NULL; /* Optional. */
 
   gzFile gzfile = (gzFile)Z_NULL;
+  ZFramesReader *zframes = NULL;
 
   char header[7];
 
@@ -1336,6 +1855,17 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
     }
   }
 
+  /* Frame compressed file. */
+  if ((read_fn == NULL) && blo_zframes_is_header(header, sizeof(header))) {
+    zframes = blo_zframes_reader_open(file);
+    if (zframes == NULL) {
+      BKE_reportf(reports, RPT_WARNING, "Unable to read '%s': %s", filepath, TIP_("corrupt file"));
+      return NULL;
+    }
+    read_fn = fd_read_zframes_from_file;
+    seek_fn = fd_seek_zframes_from_file;
+  }
+
   if (read_fn == NULL) {
     BKE_reportf(reports, RPT_WARNING, "Unrecognized file format '%s'", filepath);
     return NULL;
@@ -1345,6 +1875,7 @@ static FileData *blo_filedata_from_file_descriptor(const char *filepath,
 
   fd->filedes = file;
   fd->gzfiledes = gzfile;
+  fd->zframes = zframes;
 
   fd->read = read_fn;
   fd->seek = seek_fn;
@@ -1380,6 +1911,12 @@ FileData *blo_filedata_from_file(const char *filepath, ReportList *reports)
     /* needed for library_append and read_libraries */
     BLI_strncpy(fd->relabase, filepath, sizeof(fd->relabase));
 
+#ifdef USE_GZIP_READ_AHEAD
+    if (fd->gzfiledes != NULL) {
+      fd_gzip_read_ahead_begin(fd);
+    }
+#endif
+
     return blo_decode_and_check(fd, reports);
   }
   return NULL;
@@ -1493,10 +2030,20 @@ FileData *blo_filedata_from_memfile(MemFile *memfile, ReportList *reports)
 void blo_filedata_free(FileData *fd)
 {
   if (fd) {
+    if (fd->zframes != NULL) {
+      blo_zframes_reader_close(fd->zframes);
+    }
+
     if (fd->filedes != -1) {
       close(fd->filedes);
     }
 
+#ifdef USE_GZIP_READ_AHEAD
+    if (fd->gzip_read_ahead != NULL) {
+      fd_gzip_read_ahead_end(fd);
+    }
+#endif
+
     if (fd->gzfiledes != NULL) {
       gzclose(fd->gzfiledes);
     }
@@ -1559,6 +2106,9 @@ void blo_filedata_free(FileData *fd)
     if (fd->bheadmap) {
       MEM_freeN(fd->bheadmap);
     }
+    if (fd->bhead_index) {
+      bhead_index_free(fd->bhead_index);
+    }
 
 #ifdef USE_GHASH_BHEAD
     if (fd->bhead_idname_hash) {
@@ -2252,6 +2802,7 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
 #endif
         temp = DNA_struct_reconstruct(
             fd->memsdna, fd->filesdna, fd->compflags, bh->SDNAnr, bh->nr, (bh + 1));
+        fd->reconstruct_len++;
       }
       else {
         /* SDNA_CMP_EQUAL */
@@ -2284,6 +2835,177 @@ static void *read_struct(FileData *fd, BHead *bh, const char *blockname)
   return temp;
 }
 
+#ifdef USE_PARALLEL_RECONSTRUCT
+
+/* Only use threads for at least this much data to reconstruct (in bytes of the file). */
+#  define RECONSTRUCT_PARALLEL_MIN_LEN (1 << 16)
+/* Big arrays are split in slices of about this size (in bytes of the file). */
+#  define RECONSTRUCT_SLICE_LEN (1 << 15)
+
+typedef struct ReconstructBlock {
+  /** The block as returned by #blo_bhead_next. */
+  BHead *bhead;
+  /** The block with its data loaded, see #USE_BHEAD_READ_ON_DEMAND. */
+  BHead *bhead_data;
+  /** The reconstructed struct, as #read_struct would return it. */
+  void *data;
+} ReconstructBlock;
+
+typedef struct ReconstructSlice {
+  const ReconstructBlock *block;
+  int first, num;
+} ReconstructSlice;
+
+typedef struct ReconstructData {
+  FileData *fd;
+  ReconstructBlock *blocks;
+  int blocks_len;
+  /** Index of the next block to be used by #read_data_into_oldnewmap. */
+  int block_next;
+  ReconstructSlice *slices;
+} ReconstructData;
+
+/* Number of array elements converted by each task. */
+static int read_data_reconstruct_slice_num(const BHead *bhead)
+{
+  const int oldlen = bhead->len / bhead->nr;
+  return max_ii(1, RECONSTRUCT_SLICE_LEN / max_ii(1, oldlen));
+}
+
+static void read_data_reconstruct_cb(void *__restrict userdata,
+                                     const int iter,
+                                     const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  const ReconstructData *rd = userdata;
+  const ReconstructSlice *slice = &rd->slices[iter];
+  const BHead *bhead = slice->block->bhead_data;
+  DNA_struct_reconstruct_range(rd->fd->memsdna,
+                               rd->fd->filesdna,
+                               rd->fd->compflags,
+                               bhead->SDNAnr,
+                               slice->first,
+                               slice->num,
+                               bhead + 1,
+                               slice->block->data);
+}
+
+/**
+ * Reconstruct the structs of the DATA blocks starting at \a bhead which changed layout
+ * since the file was written, using threads.
+ * The results are the same as calling #read_struct on every block in order.
+ *
+ * \return NULL when there isn't enough data to reconstruct or threads to use
+ * for threading to be worth it.
+ */
+static ReconstructData *read_data_reconstruct_begin(FileData *fd, BHead *bhead)
+{
+  if ((fd->flags & FD_FLAGS_SWITCH_ENDIAN) || (BLI_system_thread_count() < 2)) {
+    return NULL;
+  }
+
+  int blocks_len = 0, slices_len = 0;
+  size_t len = 0;
+  for (BHead *bh = bhead; bh && bh->code == DATA; bh = blo_bhead_next(fd, bh)) {
+    if (bh->len && bh->nr > 0 && fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL) {
+      blocks_len++;
+      const int slice_num = read_data_reconstruct_slice_num(bh);
+      slices_len += (bh->nr + slice_num - 1) / slice_num;
+      len += (size_t)bh->len;
+    }
+  }
+  if (len < RECONSTRUCT_PARALLEL_MIN_LEN) {
+    return NULL;
+  }
+
+  ReconstructData *rd = MEM_callocN(sizeof(*rd), __func__);
+  rd->fd = fd;
+  rd->blocks = MEM_mallocN(sizeof(*rd->blocks) * (size_t)blocks_len, __func__);
+  rd->slices = MEM_mallocN(sizeof(*rd->slices) * (size_t)slices_len, __func__);
+
+  /* Read the data and allocate the results in order. */
+  int slice_index = 0;
+  for (BHead *bh = bhead; bh && bh->code == DATA; bh = blo_bhead_next(fd, bh)) {
+    if (!(bh->len && bh->nr > 0 && fd->compflags[bh->SDNAnr] == SDNA_CMP_NOT_EQUAL)) {
+      continue;
+    }
+    ReconstructBlock *block = &rd->blocks[rd->blocks_len];
+    block->bhead = bh;
+    block->bhead_data = bh;
+    block->data = NULL;
+#  ifdef USE_BHEAD_READ_ON_DEMAND
+    if (BHEADN_FROM_BHEAD(bh)->has_data == false) {
+      block->bhead_data = blo_bhead_read_full(fd, bh);
+      if (UNLIKELY(block->bhead_data == NULL)) {
+        fd->flags &= ~FD_FLAGS_FILE_OK;
+        break;
+      }
+    }
+#  endif
+    rd->blocks_len++;
+
+    const int curlen = DNA_struct_reconstruct_size(fd->memsdna, fd->filesdna, bh->SDNAnr);
+    if (curlen == 0) {
+      continue;
+    }
+    block->data = MEM_callocN((size_t)bh->nr * (size_t)curlen, "reconstruct");
+
+    const int slice_num = read_data_reconstruct_slice_num(bh);
+    for (int first = 0; first < bh->nr; first += slice_num) {
+      BLI_assert(slice_index < slices_len);
+      ReconstructSlice *slice = &rd->slices[slice_index++];
+      slice->block = block;
+      slice->first = first;
+      slice->num = min_ii(slice_num, bh->nr - first);
+    }
+  }
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  settings.scheduling_mode = TASK_SCHEDULING_DYNAMIC;
+  BLI_task_parallel_range(0, slice_index, rd, read_data_reconstruct_cb, &settings);
+
+  for (int i = 0; i < rd->blocks_len; i++) {
+    ReconstructBlock *block = &rd->blocks[i];
+    if (block->bhead_data != block->bhead) {
+      MEM_freeN(BHEADN_FROM_BHEAD(block->bhead_data));
+    }
+    block->bhead_data = NULL;
+  }
+  MEM_freeN(rd->slices);
+  rd->slices = NULL;
+
+  return rd;
+}
+
+/**
+ * \return The reconstructed struct of \a bhead, when it was done by
+ * #read_data_reconstruct_begin.
+ */
+static bool read_data_reconstruct_take(ReconstructData *rd, BHead *bhead, void **r_data)
+{
+  if (rd->block_next < rd->blocks_len && rd->blocks[rd->block_next].bhead == bhead) {
+    *r_data = rd->blocks[rd->block_next++].data;
+    rd->fd->reconstruct_len++;
+    rd->fd->reconstruct_threaded_len++;
+    return true;
+  }
+  return false;
+}
+
+static void read_data_reconstruct_end(ReconstructData *rd)
+{
+  /* Normally all blocks are used, unless reading stopped early. */
+  for (int i = rd->block_next; i < rd->blocks_len; i++) {
+    if (rd->blocks[i].data) {
+      MEM_freeN(rd->blocks[i].data);
+    }
+  }
+  MEM_freeN(rd->blocks);
+  MEM_freeN(rd);
+}
+
+#endif /* USE_PARALLEL_RECONSTRUCT */
+
 typedef void (*link_list_cb)(FileData *fd, void *data);
 
 static void link_list_ex(FileData *fd, ListBase *lb, link_list_cb callback) /* only direct data */
@@ -2661,6 +3383,8 @@ static void direct_link_id(FileData *fd, ID *id)
    * (glowering at certain nodetree fake data-lock here...). */
   id->tag = 0;
   id->flag &= ~LIB_INDIRECT_WEAK_LINK;
+  /* Addresses changed, nothing can be reused from previous global undo steps. */
+  id->recalc_undo_accumulated = ID_RECALC_ALL;
 
   /* Link direct data of overrides. */
   if (id->override_library) {
@@ -9111,18 +9835,29 @@ static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *a
 {
   bhead = blo_bhead_next(fd, bhead);
 
+#ifdef USE_PARALLEL_RECONSTRUCT
+  ReconstructData *rd = read_data_reconstruct_begin(fd, bhead);
+#endif
+
   while (bhead && bhead->code == DATA) {
-    void *data;
+    void *data = NULL;
+#ifdef USE_PARALLEL_RECONSTRUCT
+    const bool is_reconstructed = rd && read_data_reconstruct_take(rd, bhead, &data);
+#else
+    const bool is_reconstructed = false;
+#endif
+    if (!is_reconstructed) {
 #if 0
-    /* XXX DUMB DEBUGGING OPTION TO GIVE NAMES for guarded malloc errors */
-    short *sp = fd->filesdna->structs[bhead->SDNAnr];
-    char *tmp = malloc(100);
-    allocname = fd->filesdna->types[sp[0]];
-    strcpy(tmp, allocname);
-    data = read_struct(fd, bhead, tmp);
+      /* XXX DUMB DEBUGGING OPTION TO GIVE NAMES for guarded malloc errors */
+      short *sp = fd->filesdna->structs[bhead->SDNAnr];
+      char *tmp = malloc(100);
+      allocname = fd->filesdna->types[sp[0]];
+      strcpy(tmp, allocname);
+      data = read_struct(fd, bhead, tmp);
 #else
-    data = read_struct(fd, bhead, allocname);
+      data = read_struct(fd, bhead, allocname);
 #endif
+    }
 
     if (data) {
       oldnewmap_insert(fd->datamap, bhead->old, data, 0);
@@ -9131,6 +9866,12 @@ static BHead *read_data_into_oldnewmap(FileData *fd, BHead *bhead, const char *a
     bhead = blo_bhead_next(fd, bhead);
   }
 
+#ifdef USE_PARALLEL_RECONSTRUCT
+  if (rd) {
+    read_data_reconstruct_end(rd);
+  }
+#endif
+
   return bhead;
 }
 
@@ -9900,6 +10641,14 @@ BlendFileData *blo_read_file_internal(FileData *fd, const char *filepath)
     link_global(fd, bfd); /* as last */
   }
 
+  if ((G.debug & G_DEBUG_IO) && (fd->memfile == NULL)) {
+    printf("%s: '%s', %d blocks reconstructed, %d on threads\n",
+           __func__,
+           filepath,
+           fd->reconstruct_len,
+           fd->reconstruct_threaded_len);
+  }
+
   fd->mainlist = NULL; /* Safety, this is local variable, shall not be used afterward. */
 
   return bfd;
@@ -9963,6 +10712,10 @@ static BHead *find_previous_lib(FileData *fd, BHead *bhead)
     return NULL;
   }
 
+  if (fd->bhead_index) {
+    return bhead_index_find_previous_lib(fd, bhead);
+  }
+
   for (; bhead; bhead = blo_bhead_prev(fd, bhead)) {
     if (bhead->code == ID_LI) {
       break;
@@ -9983,6 +10736,10 @@ static BHead *find_bhead(FileData *fd, void *old)
     return NULL;
   }
 
+  if (fd->bhead_index) {
+    return bhead_index_find_bhead(fd, old);
+  }
+
   if (fd->bheadmap == NULL) {
     sort_bhead_old_map(fd);
   }
@@ -10014,11 +10771,20 @@ static BHead *find_bhead_from_code_name(FileData *fd, const short idcode, const
   *((short *)idname_full) = idcode;
   BLI_strncpy(idname_full + 2, name, sizeof(idname_full) - 2);
 
-  return BLI_ghash_lookup(fd->bhead_idname_hash, idname_full);
+  return find_bhead_from_idname(fd, idname_full);
 
 #else
   BHead *bhead;
 
+  if (fd->bhead_index) {
+    char idname_full[MAX_ID_NAME];
+
+    *((short *)idname_full) = idcode;
+    BLI_strncpy(idname_full + 2, name, sizeof(idname_full) - 2);
+
+    return bhead_index_find_bhead_from_idname(fd, idname_full);
+  }
+
   for (bhead = blo_bhead_first(fd); bhead; bhead = blo_bhead_next(fd, bhead)) {
     if (bhead->code == idcode) {
       const char *idname_test = blo_bhead_id_name(fd, bhead);
@@ -10037,7 +10803,15 @@ static BHead *find_bhead_from_code_name(FileData *fd, const short idcode, const
 
 static BHead *find_bhead_from_idname(FileData *fd, const char *idname)
 {
+  if (fd->bhead_index) {
+    return bhead_index_find_bhead_from_idname(fd, idname);
+  }
+
 #ifdef USE_GHASH_BHEAD
+  if (fd->bhead_idname_hash == NULL) {
+    /* All blocks were read after the index was used, see #blo_bhead_first. */
+    read_file_bhead_idname_map_create(fd);
+  }
   return BLI_ghash_lookup(fd->bhead_idname_hash, idname);
 #else
   return find_bhead_from_code_name(fd, GS(idname), idname + 2);
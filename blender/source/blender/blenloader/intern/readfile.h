@@ -31,6 +31,7 @@
 #include "DNA_windowmanager_types.h" /* for ReportType */
 
 struct Key;
+struct LinkNode;
 struct MemFile;
 struct Object;
 struct OldNewMap;
@@ -81,6 +82,10 @@ typedef struct FileData {
 
   /** Variables needed for reading from file. */
   gzFile gzfiledes;
+  /** Decompressing #gzfiledes on another thread (optional). */
+  struct GzipReadAhead *gzip_read_ahead;
+  /** Frame compressed file reading (uses #filedes). */
+  struct ZFramesReader *zframes;
   /** Gzip stream for memory decompression. */
   z_stream strm;
 
@@ -92,6 +97,9 @@ typedef struct FileData {
   const struct SDNA *memsdna;
   /** Array of #eSDNA_StructCompare. */
   const char *compflags;
+  /** Number of blocks reconstructed because their struct changed, and of those, on threads
+   * (statistics printed with `--debug-io`). */
+  int reconstruct_len, reconstruct_threaded_len;
 
   int fileversion;
   /** Used to retrieve ID names from (bhead+1). */
@@ -117,6 +125,12 @@ typedef struct FileData {
   /** See: #USE_GHASH_BHEAD. */
   struct GHash *bhead_idname_hash;
 
+  /**
+   * When the file has a #BHeadIndexFooter, only the blocks looked up are read,
+   * see #bhead_index_read (NULL once all blocks are read).
+   */
+  struct BHeadIndex *bhead_index;
+
   ListBase *mainlist;
   /** Used for undo. */
   ListBase *old_mainlist;
@@ -126,6 +140,37 @@ typedef struct FileData {
 
 #define SIZEOFBLENDERHEADER 12
 
+/**
+ * Index of the blocks of a file, so linking can read only the blocks it needs.
+ *
+ * Written as the last #DATA block (before #ENDB), which ends with a #BHeadIndexFooter.
+ * There is one entry for each block which isn't #DATA, in file order,
+ * the #DATA blocks which follow it are part of the entry.
+ * Uses the pointer size and endian of the file.
+ */
+#define BHEAD_INDEX_MAGIC "BIDX"
+
+typedef struct BHeadIndexEntry {
+  /** Offset of the #BHead in the file. */
+  uint64_t offset;
+  /** #BHead.old of the block. */
+  uint64_t old;
+  /** #BHead.code of the block. */
+  int code;
+  /** Number of blocks, this block and the #DATA blocks following it. */
+  int blocks_len;
+  /** #ID.name for ID blocks, empty otherwise. */
+  char name[MAX_ID_NAME];
+  char _pad[6];
+} BHeadIndexEntry;
+
+typedef struct BHeadIndexFooter {
+  /** Offset of the #BHead of the index block in the file. */
+  uint64_t offset;
+  uint32_t entries_len;
+  char magic[4];
+} BHeadIndexFooter;
+
 /***/
 struct Main;
 void blo_join_main(ListBase *mainlist);
@@ -158,6 +203,8 @@ BHead *blo_bhead_prev(FileData *fd, BHead *thisblock);
 
 const char *blo_bhead_id_name(const FileData *fd, const BHead *bhead);
 
+struct LinkNode *blo_bhead_index_get_datablock_names(FileData *fd, int code, int *r_tot);
+
 /* do versions stuff */
 
 void blo_reportf_wrap(struct ReportList *reports, ReportType type, const char *format, ...)
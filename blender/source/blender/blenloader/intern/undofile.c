@@ -41,6 +41,8 @@
 #include "DNA_listBase.h"
 
 #include "BLI_blenlib.h"
+#include "BLI_ghash.h"
+#include "BLI_hash_mm2a.h"
 
 #include "BLO_undofile.h"
 #include "BLO_readfile.h"
@@ -52,15 +54,40 @@
 
 /* **************** support for memory-write, for undo buffers *************** */
 
+/**
+ * Chunk buffers are shared between undo steps (and within one when the data is duplicated),
+ * the number of chunks using a buffer is stored in front of it.
+ */
+typedef struct MemFileChunkBuffer {
+  uint users;
+  uint _pad;
+} MemFileChunkBuffer;
+
+#define CHUNK_BUFFER(buf) (((MemFileChunkBuffer *)(buf)) - 1)
+
+static char *memfile_chunk_buffer_alloc(uint size)
+{
+  MemFileChunkBuffer *buffer = MEM_mallocN(sizeof(*buffer) + size, "Chunk buffer");
+  buffer->users = 1;
+  return (char *)(buffer + 1);
+}
+
+static void memfile_chunk_buffer_free(const char *buf)
+{
+  MemFileChunkBuffer *buffer = CHUNK_BUFFER(buf);
+  BLI_assert(buffer->users != 0);
+  if (--buffer->users == 0) {
+    MEM_freeN(buffer);
+  }
+}
+
 /* not memfile itself */
 void BLO_memfile_free(MemFile *memfile)
 {
   MemFileChunk *chunk;
 
   while ((chunk = BLI_pophead(&memfile->chunks))) {
-    if (chunk->is_identical == false) {
-      MEM_freeN((void *)chunk->buf);
-    }
+    memfile_chunk_buffer_free(chunk->buf);
     MEM_freeN(chunk);
   }
   memfile->size = 0;
@@ -70,54 +97,160 @@ void BLO_memfile_free(MemFile *memfile)
 /* result is that 'first' is being freed */
 void BLO_memfile_merge(MemFile *first, MemFile *second)
 {
-  MemFileChunk *fc, *sc;
-
-  fc = first->chunks.first;
-  sc = second->chunks.first;
-  while (fc || sc) {
-    if (fc && sc) {
-      if (sc->is_identical) {
-        sc->is_identical = false;
-        fc->is_identical = true;
-      }
-    }
-    if (fc) {
-      fc = fc->next;
-    }
-    if (sc) {
-      sc = sc->next;
+  /* Buffers are reference counted, only the sizes need to be updated:
+   * chunks which were only shared with 'first' are owned by 'second' now. */
+  BLO_memfile_free(first);
+
+  for (MemFileChunk *sc = second->chunks.first; sc; sc = sc->next) {
+    if (sc->is_identical && CHUNK_BUFFER(sc->buf)->users == 1) {
+      sc->is_identical = false;
+      second->size += sc->size;
     }
   }
+}
 
-  BLO_memfile_free(first);
+static uint memfile_chunk_hash(const void *key)
+{
+  return ((const MemFileChunk *)key)->hash;
 }
 
-void memfile_chunk_add(MemFile *memfile, const char *buf, uint size, MemFileChunk **compchunk_step)
+static bool memfile_chunk_cmp(const void *a, const void *b)
+{
+  const MemFileChunk *chunk_a = a;
+  const MemFileChunk *chunk_b = b;
+  return (chunk_a->hash != chunk_b->hash) || (chunk_a->size != chunk_b->size) ||
+         (memcmp(chunk_a->buf, chunk_b->buf, chunk_a->size) != 0);
+}
+
+/**
+ * \param use_reference_ids: Also index the chunks of the reference memfile by ID,
+ * see #memfile_id_chunk_find.
+ */
+void memfile_write_init(MemFileWriteData *mem_data,
+                        MemFile *written_memfile,
+                        MemFile *reference_memfile,
+                        const bool use_reference_ids)
 {
-  MemFileChunk *curchunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
-  curchunk->size = size;
-  curchunk->buf = NULL;
-  curchunk->is_identical = false;
-  BLI_addtail(&memfile->chunks, curchunk);
-
-  /* we compare compchunk with buf */
-  if (*compchunk_step != NULL) {
-    MemFileChunk *compchunk = *compchunk_step;
-    if (compchunk->size == curchunk->size) {
-      if (memcmp(compchunk->buf, buf, size) == 0) {
-        curchunk->buf = compchunk->buf;
-        curchunk->is_identical = true;
+  memset(mem_data, 0, sizeof(*mem_data));
+  mem_data->written_memfile = written_memfile;
+  mem_data->reference_memfile = reference_memfile;
+
+  if (reference_memfile == NULL) {
+    return;
+  }
+
+  /* Chunks are matched by contents rather than by position,
+   * so adding or removing data doesn't cause all following chunks to be duplicated. */
+  const uint num_chunks = (uint)BLI_listbase_count(&reference_memfile->chunks);
+  mem_data->reference_current_chunk = reference_memfile->chunks.first;
+  mem_data->reference_chunks = BLI_gset_new_ex(
+      memfile_chunk_hash, memfile_chunk_cmp, __func__, num_chunks);
+  if (use_reference_ids) {
+    mem_data->reference_ids = BLI_ghash_ptr_new(__func__);
+  }
+
+  for (MemFileChunk *chunk = reference_memfile->chunks.first; chunk; chunk = chunk->next) {
+    BLI_gset_add(mem_data->reference_chunks, chunk);
+    if (mem_data->reference_ids && chunk->id) {
+      MemFileChunk *chunk_prev = chunk->prev;
+      if (chunk_prev == NULL || chunk_prev->id != chunk->id) {
+        BLI_ghash_insert(mem_data->reference_ids, (void *)chunk->id, chunk);
       }
     }
-    *compchunk_step = compchunk->next;
+  }
+}
+
+void memfile_write_finalize(MemFileWriteData *mem_data)
+{
+  if (mem_data->reference_chunks) {
+    BLI_gset_free(mem_data->reference_chunks, NULL);
+  }
+  if (mem_data->reference_ids) {
+    BLI_ghash_free(mem_data->reference_ids, NULL, NULL);
+  }
+}
+
+static MemFileChunk *memfile_chunk_new(MemFileWriteData *mem_data, uint size)
+{
+  MemFileChunk *chunk = MEM_mallocN(sizeof(MemFileChunk), "MemFileChunk");
+  chunk->buf = NULL;
+  chunk->size = size;
+  chunk->hash = 0;
+  chunk->is_identical = false;
+  chunk->id = mem_data->current_id;
+  BLI_addtail(&mem_data->written_memfile->chunks, chunk);
+  return chunk;
+}
+
+static void memfile_chunk_share(MemFileWriteData *mem_data,
+                                MemFileChunk *chunk,
+                                const MemFileChunk *chunk_ref)
+{
+  CHUNK_BUFFER(chunk_ref->buf)->users++;
+  chunk->buf = chunk_ref->buf;
+  chunk->hash = chunk_ref->hash;
+  chunk->is_identical = true;
+  mem_data->reference_current_chunk = chunk_ref->next;
+}
+
+void memfile_chunk_add(MemFileWriteData *mem_data, const char *buf, uint size)
+{
+  MemFileChunk *curchunk = memfile_chunk_new(mem_data, size);
+
+  /* Compare with the chunk following the previous match first, this is the common case
+   * and avoids hashing the data. */
+  const MemFileChunk *compchunk = mem_data->reference_current_chunk;
+  if (compchunk != NULL) {
+    if (compchunk->size == size && memcmp(compchunk->buf, buf, size) == 0) {
+      memfile_chunk_share(mem_data, curchunk, compchunk);
+      return;
+    }
+    mem_data->reference_current_chunk = compchunk->next;
+  }
+
+  curchunk->hash = BLI_hash_mm2((const uchar *)buf, size, 0);
+
+  if (mem_data->reference_chunks != NULL) {
+    const MemFileChunk key = {.buf = buf, .size = size, .hash = curchunk->hash};
+    compchunk = BLI_gset_lookup(mem_data->reference_chunks, &key);
+    if (compchunk != NULL) {
+      memfile_chunk_share(mem_data, curchunk, compchunk);
+      return;
+    }
   }
 
   /* not equal... */
-  if (curchunk->buf == NULL) {
-    char *buf_new = MEM_mallocN(size, "Chunk buffer");
-    memcpy(buf_new, buf, size);
-    curchunk->buf = buf_new;
-    memfile->size += size;
+  char *buf_new = memfile_chunk_buffer_alloc(size);
+  memcpy(buf_new, buf, size);
+  curchunk->buf = buf_new;
+  mem_data->written_memfile->size += size;
+}
+
+/**
+ * \return The first chunk of the data of \a id in the reference memfile,
+ * when it has been indexed by ID (see #memfile_write_init).
+ */
+MemFileChunk *memfile_id_chunk_find(MemFileWriteData *mem_data, const void *id)
+{
+  if (mem_data->reference_ids == NULL) {
+    return NULL;
+  }
+  return BLI_ghash_lookup(mem_data->reference_ids, id);
+}
+
+/**
+ * Add all chunks of the ID starting with \a chunk to the written memfile,
+ * used instead of writing data which didn't change since the reference memfile.
+ */
+void memfile_id_chunks_reuse(MemFileWriteData *mem_data, MemFileChunk *chunk)
+{
+  const void *id = chunk->id;
+  BLI_assert(id != NULL);
+
+  for (; chunk && chunk->id == id; chunk = chunk->next) {
+    MemFileChunk *curchunk = memfile_chunk_new(mem_data, chunk->size);
+    curchunk->id = id;
+    memfile_chunk_share(mem_data, curchunk, chunk);
   }
 }
 
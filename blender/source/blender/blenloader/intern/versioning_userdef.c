@@ -550,7 +550,8 @@ void BLO_version_defaults_userpref_blend(Main *bmain, UserDef *userdef)
 
     userdef->flag &= ~(USER_FLAG_UNUSED_4);
 
-    userdef->uiflag &= ~(USER_HEADER_FROM_PREF | USER_UIFLAG_UNUSED_12 | USER_UIFLAG_UNUSED_22);
+    userdef->uiflag &= ~(USER_HEADER_FROM_PREF | USER_GLOBALUNDO_SKIP_UNCHANGED |
+                         USER_UIFLAG_UNUSED_22);
   }
 
   if (!USER_VERSION_ATLEAST(280, 41)) {
@@ -664,7 +665,11 @@ void BLO_version_defaults_userpref_blend(Main *bmain, UserDef *userdef)
    * Include next version bump.
    */
   {
-    /* pass */
+    if (userdef->vr_network_fps == 0) {
+      userdef->vr_network_width = U_default.vr_network_width;
+      userdef->vr_network_height = U_default.vr_network_height;
+      userdef->vr_network_fps = U_default.vr_network_fps;
+    }
   }
 
   if (userdef->pixelsize == 0.0f) {
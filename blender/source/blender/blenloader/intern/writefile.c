@@ -69,6 +69,7 @@
  * - write #TEST (#RenderInfo struct. 128x128 blend file preview is optional).
  * - write #GLOB (#FileGlobal struct) (some global vars).
  * - write #DNA1 (#SDNA struct)
+ * - write the block index, see #BHeadIndexEntry (not for undo).
  * - write #USER (#UserDef struct) if filename is ``~/.config/blender/X.XX/config/startup.blend``.
  */
 
@@ -174,6 +175,7 @@
 #include "BLO_writefile.h"
 
 #include "readfile.h"
+#include "zframes.h"
 
 /* for SDNA_TYPE_FROM_STRUCT() macro */
 #include "dna_type_offsets.h"
@@ -186,9 +188,6 @@
 #define MYWRITE_BUFFER_SIZE (MEM_SIZE_OPTIMAL(1 << 17)) /* 128kb */
 #define MYWRITE_MAX_CHUNK (MEM_SIZE_OPTIMAL(1 << 15))   /* ~32kb */
 
-/** Use if we want to store how many bytes have been written to the file. */
-// #define USE_WRITE_DATA_LEN
-
 /* -------------------------------------------------------------------- */
 /** \name Internal Write Wrapper's (Abstracts Compression)
  * \{ */
@@ -196,6 +195,7 @@
 typedef enum {
   WW_WRAP_NONE = 1,
   WW_WRAP_ZLIB,
+  WW_WRAP_ZFRAMES,
 } eWriteWrapType;
 
 typedef struct WriteWrap WriteWrap;
@@ -212,6 +212,7 @@ struct WriteWrap {
   union {
     int file_handle;
     gzFile gz_handle;
+    ZFramesWriter *zframes_handle;
   } _user_data;
 };
 
@@ -269,6 +270,24 @@ static size_t ww_write_zlib(WriteWrap *ww, const char *buf, size_t buf_len)
 }
 #undef FILE_HANDLE
 
+/* zlib frames */
+#define FILE_HANDLE(ww) (ww)->_user_data.zframes_handle
+
+static bool ww_open_zframes(WriteWrap *ww, const char *filepath)
+{
+  FILE_HANDLE(ww) = blo_zframes_writer_open(filepath);
+  return (FILE_HANDLE(ww) != NULL);
+}
+static bool ww_close_zframes(WriteWrap *ww)
+{
+  return blo_zframes_writer_close(FILE_HANDLE(ww));
+}
+static size_t ww_write_zframes(WriteWrap *ww, const char *buf, size_t buf_len)
+{
+  return blo_zframes_writer_write(FILE_HANDLE(ww), buf, buf_len) ? buf_len : 0;
+}
+#undef FILE_HANDLE
+
 /* --- end compression types --- */
 
 static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
@@ -283,6 +302,14 @@ static void ww_handle_init(eWriteWrapType ww_type, WriteWrap *r_ww)
       r_ww->use_buf = false;
       break;
     }
+    case WW_WRAP_ZFRAMES: {
+      r_ww->open = ww_open_zframes;
+      r_ww->close = ww_close_zframes;
+      r_ww->write = ww_write_zframes;
+      /* Buffered by the frames. */
+      r_ww->use_buf = false;
+      break;
+    }
     default: {
       r_ww->open = ww_open_none;
       r_ww->close = ww_close_none;
@@ -307,21 +334,14 @@ typedef struct {
   /** Number of bytes used in #WriteData.buf (flushed when exceeded). */
   int buf_used_len;
 
-#ifdef USE_WRITE_DATA_LEN
-  /** Total number of bytes written. */
+  /** Total number of bytes written (the offset in the file of the next write). */
   size_t write_len;
-#endif
 
   /** Set on unlikely case of an error (ignores further file writing).  */
   bool error;
 
   /** #MemFile writing (used for undo). */
-  struct {
-    MemFile *current;
-    MemFile *compare;
-    /** Use to de-duplicate chunks when writing. */
-    MemFileChunk *compare_chunk;
-  } mem;
+  MemFileWriteData mem;
   /** When true, write to #WriteData.current, could also call 'is_undo'. */
   bool use_memfile;
 
@@ -331,6 +351,10 @@ typedef struct {
    * Will be NULL for UNDO.
    */
   WriteWrap *ww;
+
+  /** Index of the blocks written, see #BHeadIndexEntry (NULL for UNDO). */
+  BHeadIndexEntry *index;
+  int index_len, index_len_alloc;
 } WriteData;
 
 static WriteData *writedata_new(WriteWrap *ww)
@@ -360,7 +384,7 @@ static void writedata_do_write(WriteData *wd, const void *mem, int memlen)
 
   /* memory based save */
   if (wd->use_memfile) {
-    memfile_chunk_add(wd->mem.current, mem, memlen, &wd->mem.compare_chunk);
+    memfile_chunk_add(&wd->mem, mem, memlen);
   }
   else {
     if (wd->ww->write(wd->ww, mem, memlen) != memlen) {
@@ -374,6 +398,9 @@ static void writedata_free(WriteData *wd)
   if (wd->buf) {
     MEM_freeN(wd->buf);
   }
+  if (wd->index) {
+    MEM_freeN(wd->index);
+  }
   MEM_freeN(wd);
 }
 
@@ -411,9 +438,7 @@ static void mywrite(WriteData *wd, const void *adr, int len)
     return;
   }
 
-#ifdef USE_WRITE_DATA_LEN
   wd->write_len += len;
-#endif
 
   if (wd->buf == NULL) {
     writedata_do_write(wd, adr, len);
@@ -461,11 +486,14 @@ static WriteData *mywrite_begin(WriteWrap *ww, MemFile *compare, MemFile *curren
   WriteData *wd = writedata_new(ww);
 
   if (current != NULL) {
-    wd->mem.current = current;
-    wd->mem.compare = compare;
-    wd->mem.compare_chunk = compare ? compare->chunks.first : NULL;
+    const bool use_reference_ids = (U.uiflag & USER_GLOBALUNDO_SKIP_UNCHANGED) != 0;
+    memfile_write_init(&wd->mem, current, compare, use_reference_ids);
     wd->use_memfile = true;
   }
+  else {
+    wd->index_len_alloc = 1024;
+    wd->index = MEM_malloc_arrayN(wd->index_len_alloc, sizeof(*wd->index), "wd->index");
+  }
 
   return wd;
 }
@@ -483,18 +511,170 @@ static bool mywrite_end(WriteData *wd)
     wd->buf_used_len = 0;
   }
 
+  if (wd->use_memfile) {
+    memfile_write_finalize(&wd->mem);
+  }
+
   const bool err = wd->error;
   writedata_free(wd);
 
   return err;
 }
 
+/**
+ * Whether edits to data-blocks of this type are reliably tracked by
+ * #ID.recalc_undo_accumulated.
+ */
+static bool mywrite_id_type_is_tracked(const short id_type)
+{
+  return ELEM(id_type, ID_OB, ID_ME, ID_CU, ID_MB, ID_LT, ID_MA, ID_LA, ID_CA, ID_WO, ID_LP);
+}
+
+/**
+ * Add the chunks of \a id from the previous undo step to the memfile,
+ * when it wasn't modified since.
+ */
+static bool mywrite_id_reuse(WriteData *wd, ID *id)
+{
+  if (!mywrite_id_type_is_tracked(GS(id->name)) || (id->recalc_undo_accumulated != 0)) {
+    return false;
+  }
+  bNodeTree *ntree = ntreeFromID(id);
+  if (ntree && (ntree->id.recalc_undo_accumulated != 0)) {
+    return false;
+  }
+
+  MemFileChunk *chunk = memfile_id_chunk_find(&wd->mem, id);
+  if (chunk == NULL || chunk->size < sizeof(BHead) + sizeof(ID)) {
+    return false;
+  }
+
+  /* The ID's own struct is written first, check the address wasn't reused by another ID
+   * and that changes to other data-blocks didn't modify it (its users for example). */
+  const BHead *bhead = (const BHead *)chunk->buf;
+  const ID *id_ref = (const ID *)(bhead + 1);
+  if ((bhead->old != id) || (bhead->code != GS(id->name)) || !STREQ(id_ref->name, id->name) ||
+      (id_ref->lib != id->lib) || (id_ref->us != id->us) || (id_ref->flag != id->flag) ||
+      (id_ref->properties != id->properties) ||
+      (id_ref->override_library != id->override_library)) {
+    return false;
+  }
+
+  memfile_id_chunks_reuse(&wd->mem, chunk);
+  return true;
+}
+
+/**
+ * Start writing the data of \a id.
+ *
+ * \return false when nothing should be written,
+ * because the data of the previous undo step is reused.
+ */
+static bool mywrite_id_begin(WriteData *wd, ID *id)
+{
+  if (wd->use_memfile) {
+    /* Write each data-block in its own chunks for undo, so data which is added or removed
+     * doesn't shift the data of the following data-blocks, which can then be de-duplicated. */
+    mywrite_flush(wd);
+
+    if (wd->mem.reference_ids && mywrite_id_reuse(wd, id)) {
+      return false;
+    }
+    wd->mem.current_id = id;
+  }
+  return true;
+}
+
+static void mywrite_id_end(WriteData *wd, ID *id)
+{
+  if (wd->use_memfile) {
+    mywrite_flush(wd);
+    wd->mem.current_id = NULL;
+
+    /* Edits after this are tracked for the next undo step. */
+    id->recalc_undo_accumulated = 0;
+    bNodeTree *ntree = ntreeFromID(id);
+    if (ntree) {
+      ntree->id.recalc_undo_accumulated = 0;
+    }
+  }
+}
+
 /** \} */
 
 /* -------------------------------------------------------------------- */
 /** \name Generic DNA File Writing
  * \{ */
 
+/**
+ * Add the block about to be written to the index, see #BHeadIndexEntry.
+ * \param data: The data written after \a bh.
+ */
+static void mywrite_bhead_index(WriteData *wd, const BHead *bh, const void *data)
+{
+  if (wd->index == NULL) {
+    return;
+  }
+
+  if (bh->code == DATA) {
+    if (wd->index_len != 0) {
+      wd->index[wd->index_len - 1].blocks_len += 1;
+    }
+    return;
+  }
+
+  if (wd->index_len == wd->index_len_alloc) {
+    wd->index_len_alloc *= 2;
+    wd->index = MEM_reallocN(wd->index, sizeof(*wd->index) * (size_t)wd->index_len_alloc);
+  }
+
+  BHeadIndexEntry *entry = &wd->index[wd->index_len++];
+  memset(entry, 0, sizeof(*entry));
+  entry->offset = wd->write_len;
+  entry->old = (uint64_t)(uintptr_t)bh->old;
+  entry->code = bh->code;
+  entry->blocks_len = 1;
+  if (BKE_idcode_is_valid(bh->code) || (bh->code == ID_LINK_PLACEHOLDER)) {
+    BLI_strncpy(entry->name, ((const ID *)data)->name, sizeof(entry->name));
+  }
+}
+
+/**
+ * Write the index as the last #DATA block, followed by #ENDB (included in the index).
+ */
+static void write_bhead_index(WriteData *wd)
+{
+  if (wd->index == NULL) {
+    return;
+  }
+
+  const int entries_len = wd->index_len + 1;
+  BHead bh = {
+      .code = DATA,
+      .len = (int)(sizeof(BHeadIndexEntry) * (size_t)entries_len + sizeof(BHeadIndexFooter)),
+      .old = wd->index,
+      .SDNAnr = 0,
+      .nr = 1,
+  };
+
+  BHeadIndexEntry entry_endb = {
+      .offset = wd->write_len + sizeof(BHead) + (size_t)bh.len,
+      .code = ENDB,
+      .blocks_len = 1,
+  };
+
+  BHeadIndexFooter footer = {
+      .offset = wd->write_len,
+      .entries_len = (uint32_t)entries_len,
+  };
+  memcpy(footer.magic, BHEAD_INDEX_MAGIC, sizeof(footer.magic));
+
+  mywrite(wd, &bh, sizeof(BHead));
+  mywrite(wd, wd->index, (int)(sizeof(BHeadIndexEntry) * (size_t)wd->index_len));
+  mywrite(wd, &entry_endb, sizeof(entry_endb));
+  mywrite(wd, &footer, sizeof(footer));
+}
+
 static void writestruct_at_address_nr(
     WriteData *wd, int filecode, const int struct_nr, int nr, const void *adr, const void *data)
 {
@@ -521,6 +701,7 @@ static void writestruct_at_address_nr(
     return;
   }
 
+  mywrite_bhead_index(wd, &bh, data);
   mywrite(wd, &bh, sizeof(BHead));
   mywrite(wd, data, bh.len);
 }
@@ -572,6 +753,7 @@ static void writedata(WriteData *wd, int filecode, int len, const void *adr)
   bh.SDNAnr = 0;
   bh.len = len;
 
+  mywrite_bhead_index(wd, &bh, adr);
   mywrite(wd, &bh, sizeof(BHead));
   mywrite(wd, adr, len);
 }
@@ -3788,6 +3970,19 @@ static bool write_file_handle(Main *mainvar,
   OverrideLibraryStorage *override_storage =
       wd->use_memfile ? NULL : BKE_override_library_operations_store_initialize();
 
+  if (wd->mem.reference_ids) {
+    /* Data edited in edit and paint modes isn't always tagged,
+     * never reuse the data of the previous undo step for it. */
+    for (Object *ob = mainvar->objects.first; ob; ob = ob->id.next) {
+      if (ob->mode != OB_MODE_OBJECT) {
+        ob->id.recalc_undo_accumulated = ID_RECALC_ALL;
+        if (ob->data) {
+          ((ID *)ob->data)->recalc_undo_accumulated = ID_RECALC_ALL;
+        }
+      }
+    }
+  }
+
   /* This outer loop allows to save first data-blocks from real mainvar,
    * then the temp ones from override process,
    * if needed, without duplicating whole code. */
@@ -3810,6 +4005,10 @@ static bool write_file_handle(Main *mainvar,
 
         const bool do_override = !ELEM(override_storage, NULL, bmain) && id->override_library;
 
+        if (!mywrite_id_begin(wd, id)) {
+          continue;
+        }
+
         if (do_override) {
           BKE_override_library_operations_store_start(bmain, override_storage, id);
         }
@@ -3933,6 +4132,8 @@ static bool write_file_handle(Main *mainvar,
         if (do_override) {
           BKE_override_library_operations_store_end(override_storage, id);
         }
+
+        mywrite_id_end(wd, id);
       }
 
       mywrite_flush(wd);
@@ -3960,6 +4161,9 @@ static bool write_file_handle(Main *mainvar,
    * so writing each time uses the same address and doesn't cause unnecessary undo overhead. */
   writedata(wd, DNA1, wd->sdna->data_len, wd->sdna->data);
 
+  /* So linking can read the blocks it needs without reading the whole file. */
+  write_bhead_index(wd);
+
   /* end of file */
   memset(&bhead, 0, sizeof(BHead));
   bhead.code = ENDB;
@@ -4045,7 +4249,7 @@ bool BLO_write_file(Main *mainvar,
   BLI_snprintf(tempname, sizeof(tempname), "%s@", filepath);
 
   if (write_flags & G_FILE_COMPRESS) {
-    ww_type = WW_WRAP_ZLIB;
+    ww_type = (write_flags & G_FILE_COMPRESS_FRAMES) ? WW_WRAP_ZFRAMES : WW_WRAP_ZLIB;
   }
   else {
     ww_type = WW_WRAP_NONE;
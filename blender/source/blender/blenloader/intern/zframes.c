@@ -0,0 +1,559 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup blenloader
+ *
+ * File layout, all numbers are little endian:
+ *
+ * - #ZFrameHeader: magic and the size of the uncompressed frames.
+ * - The frames: each a zlib stream of #ZFrameHeader.frame_size bytes (less for the last one),
+ *   or the uncompressed bytes when compressing doesn't make it smaller.
+ * - #ZFrameIndex for every frame.
+ * - #ZFrameFooter: where the index starts and the number of frames.
+ *
+ * Frames are compressed with the same settings regardless of the number of threads,
+ * so the same data always gives the same file.
+ */
+
+#include "zlib.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h> /* for open flags (O_BINARY, O_RDONLY). */
+#include <errno.h>
+
+#ifndef WIN32
+#  include <unistd.h> /* for read close */
+#else
+#  include <io.h> /* for open close read */
+#  include "BLI_winstuff.h"
+#endif
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_utildefines.h"
+#include "BLI_endian_switch.h"
+#include "BLI_fileops.h"
+#include "BLI_math_base.h"
+#include "BLI_task.h"
+
+#include "BKE_global.h" /* for ENDIAN_ORDER */
+
+#include "zframes.h"
+
+/* Disallow since it's 32bit on ms-windows. */
+#ifdef __GNUC__
+#  pragma GCC poison off_t
+#endif
+
+/* Uncompressed size of the frames, the unit of seeking. */
+#define ZFRAMES_FRAME_SIZE (1 << 18)
+/* Same as #BLI_gzopen used for regular compressed files, favor speed. */
+#define ZFRAMES_LEVEL 1
+/* Frames written (compressed in parallel) at once. */
+#define ZFRAMES_WRITE_BATCH 16
+/* Maximum frames decompressed in parallel when reading in order. */
+#define ZFRAMES_READ_BATCH 16
+/* Decompressed frames kept (enough for reading a block again after skipping it). */
+#define ZFRAMES_READ_CACHE (ZFRAMES_READ_BATCH * 2)
+
+typedef struct ZFrameHeader {
+  char magic[4];
+  uint32_t frame_size;
+} ZFrameHeader;
+
+typedef struct ZFrameIndex {
+  /** Offset of the frame in the file. */
+  uint64_t offset;
+  /** Size of the frame in the file, stored uncompressed when the same as #raw_len. */
+  uint32_t len;
+  uint32_t raw_len;
+} ZFrameIndex;
+
+typedef struct ZFrameFooter {
+  uint64_t index_offset;
+  uint32_t frames_len;
+  char magic[4];
+} ZFrameFooter;
+
+BLI_STATIC_ASSERT(sizeof(ZFrameHeader) == 8, "Size of file header")
+BLI_STATIC_ASSERT(sizeof(ZFrameIndex) == 16, "Size of file index")
+BLI_STATIC_ASSERT(sizeof(ZFrameFooter) == 16, "Size of file footer")
+
+static void zframes_index_endian_switch(ZFrameIndex *index, int index_len)
+{
+  if (ENDIAN_ORDER == B_ENDIAN) {
+    for (int i = 0; i < index_len; i++) {
+      BLI_endian_switch_uint64(&index[i].offset);
+      BLI_endian_switch_uint32(&index[i].len);
+      BLI_endian_switch_uint32(&index[i].raw_len);
+    }
+  }
+}
+
+bool blo_zframes_is_header(const char *header, size_t header_len)
+{
+  return (header_len >= 4) && (memcmp(header, ZFRAMES_MAGIC, 4) == 0);
+}
+
+static bool zframes_file_write(int file, const void *buf, size_t buf_len)
+{
+  return (size_t)write(file, buf, buf_len) == buf_len;
+}
+
+static bool zframes_file_read(int file, void *buf, size_t buf_len)
+{
+  return (size_t)read(file, buf, buf_len) == buf_len;
+}
+
+/* -------------------------------------------------------------------- */
+/** \name Writing
+ * \{ */
+
+struct ZFramesWriter {
+  int file;
+  /** Size of the file written so far. */
+  uint64_t file_len;
+  bool error;
+
+  /** Uncompressed data of the next #ZFRAMES_WRITE_BATCH frames. */
+  char *batch;
+  size_t batch_len;
+  /** Compressed frames of the batch, #compressBound of the frame size each. */
+  char *batch_compressed;
+  size_t frame_compressed_size;
+  uint32_t batch_compressed_len[ZFRAMES_WRITE_BATCH];
+
+  ZFrameIndex *index;
+  uint32_t index_len, index_alloc;
+};
+
+ZFramesWriter *blo_zframes_writer_open(const char *filepath)
+{
+  const int file = BLI_open(filepath, O_BINARY + O_WRONLY + O_CREAT + O_TRUNC, 0666);
+  if (file == -1) {
+    return NULL;
+  }
+
+  ZFramesWriter *zw = MEM_callocN(sizeof(*zw), __func__);
+  zw->file = file;
+  zw->batch = MEM_mallocN(ZFRAMES_FRAME_SIZE * ZFRAMES_WRITE_BATCH, __func__);
+  zw->frame_compressed_size = compressBound(ZFRAMES_FRAME_SIZE);
+  zw->batch_compressed = MEM_mallocN(zw->frame_compressed_size * ZFRAMES_WRITE_BATCH, __func__);
+
+  ZFrameHeader header;
+  memcpy(header.magic, ZFRAMES_MAGIC, sizeof(header.magic));
+  header.frame_size = ZFRAMES_FRAME_SIZE;
+  if (ENDIAN_ORDER == B_ENDIAN) {
+    BLI_endian_switch_uint32(&header.frame_size);
+  }
+  zw->error = !zframes_file_write(file, &header, sizeof(header));
+  zw->file_len = sizeof(header);
+
+  return zw;
+}
+
+static void zframes_compress_cb(void *__restrict userdata,
+                                const int iter,
+                                const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ZFramesWriter *zw = userdata;
+  const size_t offset = (size_t)iter * ZFRAMES_FRAME_SIZE;
+  const size_t raw_len = MIN2(zw->batch_len - offset, ZFRAMES_FRAME_SIZE);
+
+  uLongf len = (uLongf)zw->frame_compressed_size;
+  if ((compress2((Bytef *)zw->batch_compressed + (size_t)iter * zw->frame_compressed_size,
+                 &len,
+                 (const Bytef *)zw->batch + offset,
+                 (uLong)raw_len,
+                 ZFRAMES_LEVEL) != Z_OK) ||
+      (len >= raw_len)) {
+    /* Store uncompressed. */
+    len = (uLongf)raw_len;
+  }
+  zw->batch_compressed_len[iter] = (uint32_t)len;
+}
+
+static void zframes_writer_flush(ZFramesWriter *zw)
+{
+  if (zw->batch_len == 0 || zw->error) {
+    return;
+  }
+
+  const int frames_len = (int)((zw->batch_len + ZFRAMES_FRAME_SIZE - 1) / ZFRAMES_FRAME_SIZE);
+
+  TaskParallelSettings settings;
+  BLI_parallel_range_settings_defaults(&settings);
+  BLI_task_parallel_range(0, frames_len, zw, zframes_compress_cb, &settings);
+
+  if (zw->index_len + (uint32_t)frames_len > zw->index_alloc) {
+    zw->index_alloc = MAX2(zw->index_alloc * 2, zw->index_len + (uint32_t)frames_len);
+    zw->index = MEM_reallocN(zw->index, sizeof(*zw->index) * zw->index_alloc);
+  }
+
+  for (int i = 0; i < frames_len && !zw->error; i++) {
+    const size_t offset = (size_t)i * ZFRAMES_FRAME_SIZE;
+    ZFrameIndex *frame = &zw->index[zw->index_len++];
+    frame->offset = zw->file_len;
+    frame->len = zw->batch_compressed_len[i];
+    frame->raw_len = (uint32_t)MIN2(zw->batch_len - offset, ZFRAMES_FRAME_SIZE);
+
+    const char *data = (frame->len == frame->raw_len) ?
+                           zw->batch + offset :
+                           zw->batch_compressed + (size_t)i * zw->frame_compressed_size;
+    zw->error = !zframes_file_write(zw->file, data, frame->len);
+    zw->file_len += frame->len;
+  }
+
+  zw->batch_len = 0;
+}
+
+bool blo_zframes_writer_write(ZFramesWriter *zw, const char *buf, size_t buf_len)
+{
+  const size_t batch_size = ZFRAMES_FRAME_SIZE * ZFRAMES_WRITE_BATCH;
+
+  while (buf_len > 0 && !zw->error) {
+    const size_t len = MIN2(buf_len, batch_size - zw->batch_len);
+    memcpy(zw->batch + zw->batch_len, buf, len);
+    zw->batch_len += len;
+    buf += len;
+    buf_len -= len;
+
+    if (zw->batch_len == batch_size) {
+      zframes_writer_flush(zw);
+    }
+  }
+
+  return !zw->error;
+}
+
+/**
+ * Write the remaining data and the index, and close the file.
+ * \return Success.
+ */
+bool blo_zframes_writer_close(ZFramesWriter *zw)
+{
+  zframes_writer_flush(zw);
+
+  if (!zw->error) {
+    ZFrameFooter footer;
+    footer.index_offset = zw->file_len;
+    footer.frames_len = zw->index_len;
+    memcpy(footer.magic, ZFRAMES_MAGIC, sizeof(footer.magic));
+    if (ENDIAN_ORDER == B_ENDIAN) {
+      BLI_endian_switch_uint64(&footer.index_offset);
+      BLI_endian_switch_uint32(&footer.frames_len);
+    }
+    zframes_index_endian_switch(zw->index, (int)zw->index_len);
+
+    if ((zw->index_len && !zframes_file_write(
+                              zw->file, zw->index, sizeof(*zw->index) * zw->index_len)) ||
+        !zframes_file_write(zw->file, &footer, sizeof(footer))) {
+      zw->error = true;
+    }
+  }
+
+  const bool ok = (close(zw->file) != -1) && !zw->error;
+
+  MEM_SAFE_FREE(zw->index);
+  MEM_freeN(zw->batch);
+  MEM_freeN(zw->batch_compressed);
+  MEM_freeN(zw);
+
+  return ok;
+}
+
+/** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Reading
+ * \{ */
+
+typedef struct ZFramesCache {
+  /** Index of the frame, -1 when unused. */
+  int frame;
+  char *data;
+} ZFramesCache;
+
+struct ZFramesReader {
+  int file;
+
+  ZFrameIndex *index;
+  /** Uncompressed offset of each frame, with the total size at the end. */
+  uint64_t *raw_offset;
+  int index_len;
+  uint32_t frame_size;
+
+  /** Uncompressed reading position. */
+  uint64_t pos;
+
+  ZFramesCache cache[ZFRAMES_READ_CACHE];
+  /** Next cache entry to replace. */
+  int cache_next;
+  /** Last frame decompressed and number of frames decompressed with it, see #zframes_load. */
+  int frame_last, batch_len;
+
+  /** Compressed data of a batch of frames (read in one go, they are contiguous). */
+  char *compressed;
+  size_t compressed_alloc;
+  /** Frames being decompressed by #zframes_decompress_cb. */
+  ZFramesCache *batch[ZFRAMES_READ_BATCH];
+  bool batch_error[ZFRAMES_READ_BATCH];
+};
+
+/**
+ * Read the index of a frame compressed file.
+ * \param file: The file, owned by the caller.
+ * \return NULL when the file isn't valid.
+ */
+ZFramesReader *blo_zframes_reader_open(int file)
+{
+  ZFrameHeader header;
+  ZFrameFooter footer;
+
+  if ((lseek(file, 0, SEEK_SET) == -1) || !zframes_file_read(file, &header, sizeof(header)) ||
+      !blo_zframes_is_header(header.magic, sizeof(header.magic))) {
+    return NULL;
+  }
+  const int64_t file_len = lseek(file, -(int64_t)sizeof(footer), SEEK_END);
+  if ((file_len == -1) || !zframes_file_read(file, &footer, sizeof(footer)) ||
+      !blo_zframes_is_header(footer.magic, sizeof(footer.magic))) {
+    return NULL;
+  }
+  if (ENDIAN_ORDER == B_ENDIAN) {
+    BLI_endian_switch_uint32(&header.frame_size);
+    BLI_endian_switch_uint64(&footer.index_offset);
+    BLI_endian_switch_uint32(&footer.frames_len);
+  }
+  if ((header.frame_size == 0) || (footer.frames_len > INT_MAX / sizeof(ZFrameIndex)) ||
+      (footer.index_offset + (uint64_t)footer.frames_len * sizeof(ZFrameIndex) !=
+       (uint64_t)file_len)) {
+    return NULL;
+  }
+
+  ZFramesReader *zr = MEM_callocN(sizeof(*zr), __func__);
+  zr->file = file;
+  zr->index_len = (int)footer.frames_len;
+  zr->frame_size = header.frame_size;
+  zr->index = MEM_mallocN(sizeof(*zr->index) * (size_t)max_ii(zr->index_len, 1), __func__);
+  zr->raw_offset = MEM_mallocN(sizeof(*zr->raw_offset) * (size_t)(zr->index_len + 1), __func__);
+
+  bool ok = (lseek(file, (int64_t)footer.index_offset, SEEK_SET) != -1) &&
+            zframes_file_read(file, zr->index, sizeof(*zr->index) * (size_t)zr->index_len);
+  if (ok) {
+    zframes_index_endian_switch(zr->index, zr->index_len);
+    uint64_t raw_offset = 0;
+    for (int i = 0; i < zr->index_len && ok; i++) {
+      const ZFrameIndex *frame = &zr->index[i];
+      ok = (frame->raw_len <= zr->frame_size) && (frame->len <= compressBound(zr->frame_size)) &&
+           (frame->offset + frame->len <= footer.index_offset) &&
+           ((i == 0) || (frame->offset == zr->index[i - 1].offset + zr->index[i - 1].len));
+      zr->raw_offset[i] = raw_offset;
+      raw_offset += frame->raw_len;
+    }
+    zr->raw_offset[zr->index_len] = raw_offset;
+  }
+  if (!ok) {
+    blo_zframes_reader_close(zr);
+    return NULL;
+  }
+
+  for (int i = 0; i < ZFRAMES_READ_CACHE; i++) {
+    zr->cache[i].frame = -1;
+  }
+  zr->frame_last = -1;
+
+  return zr;
+}
+
+void blo_zframes_reader_close(ZFramesReader *zr)
+{
+  for (int i = 0; i < ZFRAMES_READ_CACHE; i++) {
+    MEM_SAFE_FREE(zr->cache[i].data);
+  }
+  MEM_SAFE_FREE(zr->compressed);
+  MEM_freeN(zr->index);
+  MEM_freeN(zr->raw_offset);
+  MEM_freeN(zr);
+}
+
+static void zframes_decompress_cb(void *__restrict userdata,
+                                  const int iter,
+                                  const TaskParallelTLS *__restrict UNUSED(tls))
+{
+  ZFramesReader *zr = userdata;
+  ZFramesCache *cache = zr->batch[iter];
+  const ZFrameIndex *frame = &zr->index[cache->frame];
+  const uint64_t batch_offset = zr->index[zr->batch[0]->frame].offset;
+  const char *compressed = zr->compressed + (frame->offset - batch_offset);
+
+  if (frame->len == frame->raw_len) {
+    memcpy(cache->data, compressed, frame->raw_len);
+    zr->batch_error[iter] = false;
+  }
+  else {
+    uLongf len = frame->raw_len;
+    zr->batch_error[iter] = (uncompress((Bytef *)cache->data, &len, (Bytef *)compressed,
+                                        frame->len) != Z_OK) ||
+                            (len != frame->raw_len);
+  }
+}
+
+static ZFramesCache *zframes_cache_find(ZFramesReader *zr, int frame)
+{
+  for (int i = 0; i < ZFRAMES_READ_CACHE; i++) {
+    if (zr->cache[i].frame == frame) {
+      return &zr->cache[i];
+    }
+  }
+  return NULL;
+}
+
+/**
+ * Decompress \a frame and the frames following it,
+ * doubling their number while the frames are read in order (like read-ahead of files)
+ * so jumping over data (the data of skipped blocks) doesn't decompress it.
+ */
+static ZFramesCache *zframes_load(ZFramesReader *zr, int frame)
+{
+  zr->batch_len = (frame == zr->frame_last + 1) ? min_ii(zr->batch_len * 2, ZFRAMES_READ_BATCH) :
+                                                  1;
+  zr->batch_len = max_ii(zr->batch_len, 1);
+
+  int batch_len = 0;
+  for (int i = frame; i < zr->index_len && batch_len < zr->batch_len; i++) {
+    if (zframes_cache_find(zr, i)) {
+      break;
+    }
+    ZFramesCache *cache = &zr->cache[zr->cache_next];
+    zr->cache_next = (zr->cache_next + 1) % ZFRAMES_READ_CACHE;
+    if (cache->data == NULL) {
+      cache->data = MEM_mallocN(zr->frame_size, __func__);
+    }
+    cache->frame = i;
+    zr->batch[batch_len++] = cache;
+  }
+  BLI_assert(batch_len > 0);
+
+  /* The frames are contiguous, read them at once. */
+  const ZFrameIndex *first = &zr->index[frame], *last = &zr->index[frame + batch_len - 1];
+  const size_t compressed_len = (size_t)(last->offset + last->len - first->offset);
+  if (compressed_len > zr->compressed_alloc) {
+    MEM_SAFE_FREE(zr->compressed);
+    zr->compressed = MEM_mallocN(compressed_len, __func__);
+    zr->compressed_alloc = compressed_len;
+  }
+
+  bool error = (lseek(zr->file, (int64_t)first->offset, SEEK_SET) == -1) ||
+               !zframes_file_read(zr->file, zr->compressed, compressed_len);
+  if (!error) {
+    TaskParallelSettings settings;
+    BLI_parallel_range_settings_defaults(&settings);
+    settings.use_threading = (batch_len > 1);
+    BLI_task_parallel_range(0, batch_len, zr, zframes_decompress_cb, &settings);
+
+    for (int i = 0; i < batch_len; i++) {
+      error |= zr->batch_error[i];
+    }
+  }
+
+  if (error) {
+    for (int i = 0; i < batch_len; i++) {
+      zr->batch[i]->frame = -1;
+    }
+    zr->frame_last = -1;
+    return NULL;
+  }
+
+  zr->frame_last = frame + batch_len - 1;
+  return zr->batch[0];
+}
+
+/* Frame containing the uncompressed position \a pos. */
+static int zframes_find(const ZFramesReader *zr, uint64_t pos)
+{
+  int low = 0, high = zr->index_len - 1;
+  while (low < high) {
+    const int mid = (low + high + 1) / 2;
+    if (zr->raw_offset[mid] <= pos) {
+      low = mid;
+    }
+    else {
+      high = mid - 1;
+    }
+  }
+  return low;
+}
+
+/**
+ * \return The number of bytes read, less than \a size at the end of the file, -1 on errors.
+ */
+int blo_zframes_reader_read(ZFramesReader *zr, void *buffer, uint size)
+{
+  int readsize = 0;
+
+  while (size > 0 && zr->pos < zr->raw_offset[zr->index_len]) {
+    const int frame = zframes_find(zr, zr->pos);
+    ZFramesCache *cache = zframes_cache_find(zr, frame);
+    if (cache == NULL) {
+      cache = zframes_load(zr, frame);
+      if (cache == NULL) {
+        return -1;
+      }
+    }
+
+    const size_t offset = (size_t)(zr->pos - zr->raw_offset[frame]);
+    const uint len = (uint)MIN2((size_t)size, zr->index[frame].raw_len - offset);
+    memcpy(POINTER_OFFSET(buffer, readsize), cache->data + offset, len);
+    readsize += (int)len;
+    size -= len;
+    zr->pos += len;
+  }
+
+  return readsize;
+}
+
+/**
+ * Same as `lseek` on the uncompressed data.
+ */
+int64_t blo_zframes_reader_seek(ZFramesReader *zr, int64_t offset, int whence)
+{
+  int64_t pos;
+  switch (whence) {
+    case SEEK_SET:
+      pos = offset;
+      break;
+    case SEEK_CUR:
+      pos = (int64_t)zr->pos + offset;
+      break;
+    case SEEK_END:
+      pos = (int64_t)zr->raw_offset[zr->index_len] + offset;
+      break;
+    default:
+      errno = EINVAL;
+      return -1;
+  }
+  if (pos < 0) {
+    errno = EINVAL;
+    return -1;
+  }
+  zr->pos = (uint64_t)pos;
+  return pos;
+}
+
+/** \} */
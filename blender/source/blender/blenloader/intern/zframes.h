@@ -0,0 +1,44 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software Foundation,
+ * Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+/** \file
+ * \ingroup blenloader
+ *
+ * Frame compressed files: the data is split in frames compressed independently,
+ * followed by an index of the frames, so reading can seek and decompress in parallel.
+ */
+
+#ifndef __ZFRAMES_H__
+#define __ZFRAMES_H__
+
+/** Magic at the start (and end) of frame compressed files. */
+#define ZFRAMES_MAGIC "BLZF"
+
+typedef struct ZFramesReader ZFramesReader;
+typedef struct ZFramesWriter ZFramesWriter;
+
+bool blo_zframes_is_header(const char *header, size_t header_len);
+
+ZFramesWriter *blo_zframes_writer_open(const char *filepath);
+bool blo_zframes_writer_write(ZFramesWriter *zw, const char *buf, size_t buf_len);
+bool blo_zframes_writer_close(ZFramesWriter *zw);
+
+ZFramesReader *blo_zframes_reader_open(int file);
+int blo_zframes_reader_read(ZFramesReader *zr, void *buffer, uint size);
+int64_t blo_zframes_reader_seek(ZFramesReader *zr, int64_t offset, int whence);
+void blo_zframes_reader_close(ZFramesReader *zr);
+
+#endif /* __ZFRAMES_H__ */
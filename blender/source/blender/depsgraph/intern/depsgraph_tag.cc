@@ -656,6 +656,7 @@ void graph_id_tag_update(
    * changes). */
   if (update_source == DEG_UPDATE_SOURCE_USER_EDIT) {
     id->recalc |= deg_recalc_flags_effective(graph, flag);
+    id->recalc_undo_accumulated |= deg_recalc_flags_effective(graph, flag);
   }
   int current_flag = flag;
   while (current_flag != 0) {
@@ -149,6 +149,8 @@ void EDBM_automerge_and_split(struct Object *ob,
 
 /* editmesh_undo.c */
 void ED_mesh_undosys_type(struct UndoType *ut);
+void ED_mesh_select_undosys_type(struct UndoType *ut);
+void ED_mesh_undo_push_select(struct bContext *C, const char *str);
 
 /* editmesh_select.c */
 void EDBM_select_mirrored(
@@ -34,6 +34,7 @@ extern "C"
 struct CLG_LogRef;
 struct Object;
 struct UndoStack;
+struct UndoType;
 struct ViewLayer;
 struct bContext;
 struct wmOperator;
@@ -41,6 +42,7 @@ struct wmOperatorType;
 
 /* undo.c */
 void ED_undo_push(struct bContext *C, const char *str);
+bool ED_undo_push_with_type(struct bContext *C, const char *str, const struct UndoType *ut);
 void ED_undo_push_op(struct bContext *C, struct wmOperator *op);
 void ED_undo_grouped_push(struct bContext *C, const char *str);
 void ED_undo_grouped_push_op(struct bContext *C, struct wmOperator *op);
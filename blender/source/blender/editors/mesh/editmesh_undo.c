@@ -30,6 +30,7 @@
 
 #include "BLI_listbase.h"
 #include "BLI_array_utils.h"
+#include "BLI_bitmap.h"
 
 #include "BKE_context.h"
 #include "BKE_key.h"
@@ -822,3 +823,400 @@ void ED_mesh_undosys_type(UndoType *ut)
 }
 
 /** \} */
+
+/* -------------------------------------------------------------------- */
+/** \name Implements ED Undo System (Selection)
+ *
+ * Selection changes only store the select flags of the elements, as the changes to the previous
+ * step (run-length encoded), instead of a copy of the mesh.
+ *
+ * A run of selection steps always follows an edit-mesh step of the same objects and geometry
+ * (its base), which is loaded when undoing into the run from elsewhere.
+ * \{ */
+
+/**
+ * Every n-th step of a run stores the select flags instead of their changes,
+ * this bounds the steps to apply and keeps steps usable once the undo limits free the start of
+ * the run.
+ */
+#define MESH_SELECT_UNDO_ABSOLUTE_INTERVAL 16
+
+typedef struct MeshSelectUndoStep_Elem {
+  UndoRefID_Object obedit_ref;
+  /** Number of vertices, edges and faces. */
+  int totelem[3];
+  /** Run-length encoded select flags of vertices, edges and faces (or their changes). */
+  uint *runs[3];
+  uint runs_len[3];
+} MeshSelectUndoStep_Elem;
+
+typedef struct MeshSelectUndoStep {
+  UndoStep step;
+  MeshSelectUndoStep_Elem *elems;
+  uint elems_len;
+  int selectmode;
+  /** Number of steps since the last step that stores the select flags (zero for this step). */
+  uint delta_index;
+} MeshSelectUndoStep;
+
+static const char mesh_select_iter_types[3] = {
+    BM_VERTS_OF_MESH,
+    BM_EDGES_OF_MESH,
+    BM_FACES_OF_MESH,
+};
+
+static void mesh_select_totelem_from_bmesh(const BMesh *bm, int r_totelem[3])
+{
+  r_totelem[0] = bm->totvert;
+  r_totelem[1] = bm->totedge;
+  r_totelem[2] = bm->totface;
+}
+
+static bool mesh_select_totelem_matches_bmesh(const int totelem[3], const BMesh *bm)
+{
+  return totelem[0] == bm->totvert && totelem[1] == bm->totedge && totelem[2] == bm->totface;
+}
+
+static BLI_bitmap *mesh_select_bitmap_from_bmesh(BMesh *bm, const char itype, const int totelem)
+{
+  BLI_bitmap *bitmap = BLI_BITMAP_NEW(totelem, __func__);
+  BMIter iter;
+  BMElem *ele;
+  int i;
+  BM_ITER_MESH_INDEX (ele, &iter, bm, itype, i) {
+    if (BM_elem_flag_test(ele, BM_ELEM_SELECT)) {
+      BLI_BITMAP_ENABLE(bitmap, i);
+    }
+  }
+  return bitmap;
+}
+
+/** Only writes the flags that differ, returns the change in the number of selected elements. */
+static int mesh_select_bitmap_to_bmesh(BMesh *bm, const char itype, const BLI_bitmap *bitmap)
+{
+  int totsel_delta = 0;
+  BMIter iter;
+  BMElem *ele;
+  int i;
+  BM_ITER_MESH_INDEX (ele, &iter, bm, itype, i) {
+    const bool select = BLI_BITMAP_TEST_BOOL(bitmap, i);
+    if (BM_elem_flag_test_bool(ele, BM_ELEM_SELECT) != select) {
+      BM_elem_flag_set(ele, BM_ELEM_SELECT, select);
+      totsel_delta += select ? 1 : -1;
+    }
+  }
+  return totsel_delta;
+}
+
+static bool mesh_undosys_step_is_mesh(const UndoStep *us)
+{
+  return us && us->type->step_encode == mesh_undosys_step_encode;
+}
+
+static bool mesh_undosys_step_is_select(const UndoStep *us)
+{
+  return us && us->type == BKE_UNDOSYS_TYPE_MESH_SELECT;
+}
+
+/** Check the step has the same objects in edit-mode with the same geometry. */
+static bool mesh_select_undosys_step_matches(const UndoStep *us_p,
+                                             Object **objects,
+                                             uint objects_len)
+{
+  for (uint i = 0; i < objects_len; i++) {
+    const Object *ob = objects[i];
+    const BMesh *bm = ((Mesh *)ob->data)->edit_mesh->bm;
+
+    if (mesh_undosys_step_is_select(us_p)) {
+      const MeshSelectUndoStep *us = (const MeshSelectUndoStep *)us_p;
+      if (us->elems_len != objects_len) {
+        return false;
+      }
+      const MeshSelectUndoStep_Elem *elem = &us->elems[i];
+      if (elem->obedit_ref.ptr != ob || !mesh_select_totelem_matches_bmesh(elem->totelem, bm)) {
+        return false;
+      }
+    }
+    else if (mesh_undosys_step_is_mesh(us_p)) {
+      const MeshUndoStep *us = (const MeshUndoStep *)us_p;
+      if (us->elems_len != objects_len) {
+        return false;
+      }
+      const MeshUndoStep_Elem *elem = &us->elems[i];
+      if (elem->obedit_ref.ptr != ob || elem->data.me.totvert != bm->totvert ||
+          elem->data.me.totedge != bm->totedge || elem->data.me.totpoly != bm->totface) {
+        return false;
+      }
+    }
+    else {
+      return false;
+    }
+  }
+  return objects_len != 0;
+}
+
+/** First step of the run (the base is the step before it, when it's still in the stack). */
+static const MeshSelectUndoStep *mesh_select_undosys_run_first(const MeshSelectUndoStep *us)
+{
+  while (mesh_undosys_step_is_select(us->step.prev)) {
+    us = (const MeshSelectUndoStep *)us->step.prev;
+  }
+  return us;
+}
+
+/** Last step that stores the select flags (not their changes), NULL when it was freed. */
+static const MeshSelectUndoStep *mesh_select_undosys_step_absolute(const MeshSelectUndoStep *us)
+{
+  while (us->delta_index != 0) {
+    if (!mesh_undosys_step_is_select(us->step.prev)) {
+      return NULL;
+    }
+    us = (const MeshSelectUndoStep *)us->step.prev;
+  }
+  return us;
+}
+
+/**
+ * Select flags of an element of the step, from the last step that stores them and the changes
+ * since, free with MEM_freeN(). Returns false when that step was freed.
+ */
+static bool mesh_select_undosys_step_bitmaps(const MeshSelectUndoStep *us,
+                                             const uint elem_index,
+                                             BLI_bitmap *r_bitmaps[3])
+{
+  const MeshSelectUndoStep *us_first = mesh_select_undosys_step_absolute(us);
+  if (us_first == NULL) {
+    return false;
+  }
+
+  const MeshSelectUndoStep_Elem *elem = &us->elems[elem_index];
+  for (int t = 0; t < 3; t++) {
+    r_bitmaps[t] = BLI_BITMAP_NEW(elem->totelem[t], __func__);
+  }
+  for (const MeshSelectUndoStep *us_iter = us_first;;
+       us_iter = (const MeshSelectUndoStep *)us_iter->step.next) {
+    const MeshSelectUndoStep_Elem *elem_iter = &us_iter->elems[elem_index];
+    for (int t = 0; t < 3; t++) {
+      BLI_bitmap_rle_xor(r_bitmaps[t], elem_iter->runs[t], elem_iter->runs_len[t]);
+    }
+    if (us_iter == us) {
+      break;
+    }
+  }
+  return true;
+}
+
+static bool mesh_select_undosys_step_encode(struct bContext *C,
+                                            struct Main *bmain,
+                                            UndoStep *us_p)
+{
+  MeshSelectUndoStep *us = (MeshSelectUndoStep *)us_p;
+  const UndoStep *us_prev = ED_undo_stack_get()->step_active;
+
+  ViewLayer *view_layer = CTX_data_view_layer(C);
+  uint objects_len = 0;
+  Object **objects = BKE_view_layer_array_from_objects_in_edit_mode_unique_data(
+      view_layer, NULL, &objects_len);
+
+  /* Otherwise the caller pushes a regular edit-mesh step. */
+  if (!mesh_select_undosys_step_matches(us_prev, objects, objects_len)) {
+    MEM_freeN(objects);
+    return false;
+  }
+
+  /* Store the changes to the previous step, unless its flags can't be restored either. */
+  if (mesh_undosys_step_is_select(us_prev) &&
+      mesh_select_undosys_step_absolute((const MeshSelectUndoStep *)us_prev)) {
+    us->delta_index = (((const MeshSelectUndoStep *)us_prev)->delta_index + 1) %
+                      MESH_SELECT_UNDO_ABSOLUTE_INTERVAL;
+  }
+
+  us->elems = MEM_callocN(sizeof(*us->elems) * objects_len, __func__);
+  us->elems_len = objects_len;
+
+  for (uint i = 0; i < objects_len; i++) {
+    Object *ob = objects[i];
+    MeshSelectUndoStep_Elem *elem = &us->elems[i];
+    BMEditMesh *em = ((Mesh *)ob->data)->edit_mesh;
+
+    elem->obedit_ref.ptr = ob;
+    mesh_select_totelem_from_bmesh(em->bm, elem->totelem);
+
+    BLI_bitmap *bitmaps_prev[3] = {NULL};
+    if (us->delta_index != 0) {
+      mesh_select_undosys_step_bitmaps((const MeshSelectUndoStep *)us_prev, i, bitmaps_prev);
+    }
+
+    for (int t = 0; t < 3; t++) {
+      BLI_bitmap *bitmap = mesh_select_bitmap_from_bmesh(
+          em->bm, mesh_select_iter_types[t], elem->totelem[t]);
+      if (us->delta_index != 0) {
+        BLI_bitmap_xor_all(bitmap, bitmaps_prev[t], elem->totelem[t]);
+        MEM_freeN(bitmaps_prev[t]);
+      }
+      elem->runs[t] = BLI_bitmap_rle_encode(bitmap, elem->totelem[t], &elem->runs_len[t]);
+      us->step.data_size += sizeof(*elem->runs[t]) * elem->runs_len[t];
+      MEM_freeN(bitmap);
+    }
+    em->needs_flush_to_id = 1;
+  }
+  MEM_freeN(objects);
+
+  us->selectmode = CTX_data_tool_settings(C)->selectmode;
+
+  bmain->is_memfile_undo_flush_needed = true;
+
+  return true;
+}
+
+static void mesh_select_undosys_step_decode(
+    struct bContext *C, struct Main *bmain, UndoStep *us_p, int dir, bool UNUSED(is_final))
+{
+  MeshSelectUndoStep *us = (MeshSelectUndoStep *)us_p;
+  UndoStep *us_active = ED_undo_stack_get()->step_active;
+
+  if (us_active == us_p) {
+    return;
+  }
+
+  /* The geometry is loaded when coming from the base or from another step of the run,
+   * otherwise load the base first. */
+  const MeshSelectUndoStep *us_first = mesh_select_undosys_run_first(us);
+  UndoStep *us_base = mesh_undosys_step_is_mesh(us_first->step.prev) ? us_first->step.prev :
+                                                                       NULL;
+  bool use_base = true;
+  if (us_active && us_active == us_base) {
+    use_base = false;
+  }
+  else if (mesh_undosys_step_is_select(us_active) &&
+           mesh_select_undosys_run_first((MeshSelectUndoStep *)us_active) == us_first) {
+    use_base = false;
+  }
+
+  if (use_base) {
+    if (us_base == NULL) {
+      CLOG_ERROR(&LOG, "name='%s', edit-mesh undo step of the selection was freed", us_p->name);
+      return;
+    }
+    /* Same objects as this step (see #mesh_select_undosys_step_matches),
+     * which are resolved already. */
+    MeshUndoStep *us_mesh = (MeshUndoStep *)us_base;
+    for (uint i = 0; i < us->elems_len; i++) {
+      us_mesh->elems[i].obedit_ref.ptr = us->elems[i].obedit_ref.ptr;
+    }
+    us_base->type->step_decode(C, bmain, us_base, dir, false);
+  }
+
+  for (uint i = 0; i < us->elems_len; i++) {
+    MeshSelectUndoStep_Elem *elem = &us->elems[i];
+    Object *obedit = elem->obedit_ref.ptr;
+    Mesh *me = obedit->data;
+    if (me->edit_mesh == NULL ||
+        !mesh_select_totelem_matches_bmesh(elem->totelem, me->edit_mesh->bm)) {
+      CLOG_ERROR(&LOG,
+                 "name='%s', geometry of object '%s' doesn't match, undo state invalid",
+                 us_p->name,
+                 obedit->id.name);
+      continue;
+    }
+
+    BLI_bitmap *bitmaps[3];
+    if (!mesh_select_undosys_step_bitmaps(us, i, bitmaps)) {
+      CLOG_ERROR(&LOG, "name='%s', selection undo steps were freed", us_p->name);
+      continue;
+    }
+
+    BMEditMesh *em = me->edit_mesh;
+    BMesh *bm = em->bm;
+    bm->totvertsel += mesh_select_bitmap_to_bmesh(bm, BM_VERTS_OF_MESH, bitmaps[0]);
+    bm->totedgesel += mesh_select_bitmap_to_bmesh(bm, BM_EDGES_OF_MESH, bitmaps[1]);
+    bm->totfacesel += mesh_select_bitmap_to_bmesh(bm, BM_FACES_OF_MESH, bitmaps[2]);
+    for (int t = 0; t < 3; t++) {
+      MEM_freeN(bitmaps[t]);
+    }
+    BM_select_history_validate(bm);
+
+    em->selectmode = us->selectmode;
+    bm->selectmode = us->selectmode;
+    em->needs_flush_to_id = 1;
+    DEG_id_tag_update(&me->id, ID_RECALC_SELECT);
+  }
+
+  /* The first element is always active */
+  ED_undo_object_set_active_or_warn(
+      CTX_data_view_layer(C), us->elems[0].obedit_ref.ptr, us_p->name, &LOG);
+
+  Scene *scene = CTX_data_scene(C);
+  scene->toolsettings->selectmode = us->selectmode;
+
+  bmain->is_memfile_undo_flush_needed = true;
+
+  WM_event_add_notifier(C, NC_GEOM | ND_SELECT, NULL);
+}
+
+static void mesh_select_undosys_step_free(UndoStep *us_p)
+{
+  MeshSelectUndoStep *us = (MeshSelectUndoStep *)us_p;
+
+  for (uint i = 0; i < us->elems_len; i++) {
+    MeshSelectUndoStep_Elem *elem = &us->elems[i];
+    for (int t = 0; t < 3; t++) {
+      MEM_SAFE_FREE(elem->runs[t]);
+    }
+  }
+  MEM_SAFE_FREE(us->elems);
+}
+
+static void mesh_select_undosys_foreach_ID_ref(UndoStep *us_p,
+                                               UndoTypeForEachIDRefFn foreach_ID_ref_fn,
+                                               void *user_data)
+{
+  MeshSelectUndoStep *us = (MeshSelectUndoStep *)us_p;
+
+  for (uint i = 0; i < us->elems_len; i++) {
+    MeshSelectUndoStep_Elem *elem = &us->elems[i];
+    foreach_ID_ref_fn(user_data, ((UndoRefID *)&elem->obedit_ref));
+  }
+}
+
+/* Export for ED_undo_sys. */
+void ED_mesh_select_undosys_type(UndoType *ut)
+{
+  ut->name = "Edit Mesh Selection";
+  /* Only pushed explicitly, see #ED_mesh_undo_push_select. */
+  ut->poll = NULL;
+  ut->step_encode = mesh_select_undosys_step_encode;
+  ut->step_decode = mesh_select_undosys_step_decode;
+  ut->step_free = mesh_select_undosys_step_free;
+
+  ut->step_foreach_ID_ref = mesh_select_undosys_foreach_ID_ref;
+
+  ut->use_context = true;
+
+  ut->step_size = sizeof(MeshSelectUndoStep);
+}
+
+/**
+ * Undo push for a change of the selection only: stores just the select flags when the previous
+ * step has the same edit-mesh geometry, otherwise pushes a regular undo step.
+ */
+void ED_mesh_undo_push_select(bContext *C, const char *str)
+{
+  /* Check before pushing, a failed push can still have added a global undo step. */
+  bool use_select = false;
+  if (editmesh_object_from_context(C)) {
+    ViewLayer *view_layer = CTX_data_view_layer(C);
+    uint objects_len = 0;
+    Object **objects = BKE_view_layer_array_from_objects_in_edit_mode_unique_data(
+        view_layer, NULL, &objects_len);
+    use_select = mesh_select_undosys_step_matches(
+        ED_undo_stack_get()->step_active, objects, objects_len);
+    MEM_freeN(objects);
+  }
+
+  if (!(use_select && ED_undo_push_with_type(C, str, BKE_UNDOSYS_TYPE_MESH_SELECT))) {
+    ED_undo_push(C, str);
+  }
+}
+
+/** \} */
@@ -1356,6 +1356,10 @@ bool EDBM_mesh_reveal(BMEditMesh *em, bool select)
 void EDBM_mesh_normals_update(BMEditMesh *em)
 {
   BM_mesh_normals_update(em->bm);
+#if WITH_VR
+  /* Normals are updated after moving vertices. */
+  BKE_editmesh_geom_changed(em);
+#endif
 }
 
 void EDBM_stats_update(BMEditMesh *em)
@@ -1399,6 +1403,11 @@ void EDBM_update_generic(BMEditMesh *em, const bool do_tessellation, const bool
   if (do_tessellation) {
     BKE_editmesh_looptri_calc(em);
   }
+#if WITH_VR
+  else {
+    BKE_editmesh_geom_changed(em);
+  }
+#endif
 
   if (is_destructive) {
     /* TODO. we may be able to remove this now! - Campbell */
@@ -1381,7 +1381,7 @@ void VIEW3D_OT_select_lasso(wmOperatorType *ot)
   ot->cancel = WM_gesture_lasso_cancel;
 
   /* flags */
-  ot->flag = OPTYPE_UNDO;
+  ot->flag = OPTYPE_UNDO | OPTYPE_UNDO_SELECT;
 
   /* properties */
   WM_operator_properties_gesture_lasso(ot);
@@ -2475,7 +2475,7 @@ void VIEW3D_OT_select(wmOperatorType *ot)
   ot->poll = ED_operator_view3d_active;
 
   /* flags */
-  ot->flag = OPTYPE_UNDO;
+  ot->flag = OPTYPE_UNDO | OPTYPE_UNDO_SELECT;
 
   /* properties */
   WM_operator_properties_mouse_select(ot);
@@ -3332,7 +3332,7 @@ void VIEW3D_OT_select_box(wmOperatorType *ot)
   ot->cancel = WM_gesture_box_cancel;
 
   /* flags */
-  ot->flag = OPTYPE_UNDO;
+  ot->flag = OPTYPE_UNDO | OPTYPE_UNDO_SELECT;
 
   /* rna */
   WM_operator_properties_gesture_box(ot);
@@ -4105,7 +4105,7 @@ void VIEW3D_OT_select_circle(wmOperatorType *ot)
   ot->cancel = WM_gesture_circle_cancel;
 
   /* flags */
-  ot->flag = OPTYPE_UNDO;
+  ot->flag = OPTYPE_UNDO | OPTYPE_UNDO_SELECT;
 
   /* properties */
   WM_operator_properties_gesture_circle(ot);
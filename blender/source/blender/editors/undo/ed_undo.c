@@ -51,6 +51,7 @@
 #include "BLO_blend_validate.h"
 
 #include "ED_gpencil.h"
+#include "ED_mesh.h"
 #include "ED_render.h"
 #include "ED_object.h"
 #include "ED_outliner.h"
@@ -76,14 +77,17 @@ static CLG_LogRef LOG = {"ed.undo"};
  * Non-operator undo editor functions.
  * \{ */
 
-void ED_undo_push(bContext *C, const char *str)
+/**
+ * \param ut: The undo type of the step, NULL to use the undo type of the context.
+ */
+static bool ed_undo_push_impl(bContext *C, const char *str, const UndoType *ut)
 {
   CLOG_INFO(&LOG, 1, "name='%s'", str);
 
   const int steps = U.undosteps;
 
   if (steps <= 0) {
-    return;
+    return false;
   }
 
   wmWindowManager *wm = CTX_wm_manager(C);
@@ -93,7 +97,12 @@ void ED_undo_push(bContext *C, const char *str)
     BKE_undosys_stack_limit_steps_and_memory(wm->undo_stack, steps - 1, 0);
   }
 
-  BKE_undosys_step_push(wm->undo_stack, C, str);
+  if (ut == NULL) {
+    BKE_undosys_step_push(wm->undo_stack, C, str);
+  }
+  else if (!BKE_undosys_step_push_with_type(wm->undo_stack, C, str, ut)) {
+    return false;
+  }
 
   if (U.undomemory != 0) {
     const size_t memory_limit = (size_t)U.undomemory * 1024 * 1024;
@@ -105,6 +114,23 @@ void ED_undo_push(bContext *C, const char *str)
   }
 
   WM_file_tag_modified();
+  return true;
+}
+
+void ED_undo_push(bContext *C, const char *str)
+{
+  ed_undo_push_impl(C, str, NULL);
+}
+
+/**
+ * Push a step of a specific undo type, for tools that can store their changes in a lighter
+ * form than the undo type of the context (see #ED_mesh_undo_push_select).
+ *
+ * \return false when the step can't be stored as this type (nothing is pushed then).
+ */
+bool ED_undo_push_with_type(bContext *C, const char *str, const UndoType *ut)
+{
+  return ed_undo_push_impl(C, str, ut);
 }
 
 /**
@@ -288,7 +314,12 @@ void ED_undo_redo(bContext *C)
 void ED_undo_push_op(bContext *C, wmOperator *op)
 {
   /* in future, get undo string info? */
-  ED_undo_push(C, op->type->name);
+  if (op->type->flag & OPTYPE_UNDO_SELECT) {
+    ED_mesh_undo_push_select(C, op->type->name);
+  }
+  else {
+    ED_undo_push(C, op->type->name);
+  }
 }
 
 void ED_undo_grouped_push_op(bContext *C, wmOperator *op)
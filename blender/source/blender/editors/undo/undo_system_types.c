@@ -46,6 +46,7 @@ void ED_undosys_type_init(void)
   BKE_undosys_type_append(ED_lattice_undosys_type);
   BKE_undosys_type_append(ED_mball_undosys_type);
   BKE_undosys_type_append(ED_mesh_undosys_type);
+  BKE_UNDOSYS_TYPE_MESH_SELECT = BKE_undosys_type_append(ED_mesh_select_undosys_type);
 
   /* Paint Modes */
   BKE_UNDOSYS_TYPE_IMAGE = BKE_undosys_type_append(ED_image_undosys_type);
@@ -255,7 +255,11 @@ typedef struct ID {
   int us;
   int icon_id;
   int recalc;
-  char _pad[4];
+  /**
+   * Recalc flags of user edits since the last global undo step was written,
+   * data-blocks without any are not written again when possible.
+   */
+  int recalc_undo_accumulated;
   IDProperty *properties;
 
   /** Reference linked ID which this one overrides. */
@@ -100,6 +100,17 @@ void *DNA_struct_reconstruct(const struct SDNA *newsdna,
                              int oldSDNAnr,
                              int blocks,
                              const void *data);
+int DNA_struct_reconstruct_size(const struct SDNA *newsdna,
+                                const struct SDNA *oldsdna,
+                                int oldSDNAnr);
+void DNA_struct_reconstruct_range(const struct SDNA *newsdna,
+                                  const struct SDNA *oldsdna,
+                                  const char *compflags,
+                                  int oldSDNAnr,
+                                  int first,
+                                  int blocks,
+                                  const void *data,
+                                  void *cur);
 
 int DNA_elem_offset(struct SDNA *sdna, const char *stype, const char *vartype, const char *name);
 
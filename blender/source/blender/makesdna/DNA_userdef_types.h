@@ -629,6 +629,14 @@ typedef struct UserDef {
   char vr_network_ipaddr[62];
   /* Experimental */
   char vr_openxr;
+  /* Network stream */
+  short vr_network_width;
+  short vr_network_height;
+  short vr_network_fps;
+  /** #VR_Network_Encoder::Type. */
+  char vr_network_codec;
+  /** Accept spectators (see #VR_NETWORK_SPECTATOR_PORT_NUM), off by default. */
+  char vr_network_spectators;
   
   /** 1024 = FILE_MAX. */
   char image_editor[1024];
@@ -988,7 +996,8 @@ typedef enum eUserpref_UI_Flag {
   USER_MENUOPENAUTO = (1 << 9),
   USER_DEPTH_CURSOR = (1 << 10),
   USER_AUTOPERSP = (1 << 11),
-  USER_UIFLAG_UNUSED_12 = (1 << 12), /* cleared */
+  /** Don't write data-blocks again for global undo when they weren't edited. */
+  USER_GLOBALUNDO_SKIP_UNCHANGED = (1 << 12),
   USER_GLOBALUNDO = (1 << 13),
   USER_ORBIT_SELECTION = (1 << 14),
   USER_DEPTH_NAVIGATE = (1 << 15),
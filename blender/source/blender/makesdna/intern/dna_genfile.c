@@ -1409,37 +1409,63 @@ void *DNA_struct_reconstruct(const SDNA *newsdna,
                              int blocks,
                              const void *data)
 {
-  int a, curSDNAnr, curlen = 0, oldlen;
-  const short *spo, *spc;
-  char *cur, *cpc;
-  const char *cpo;
-  const char *type;
-
-  /* oldSDNAnr == structnr, we're looking for the corresponding 'cur' number */
-  spo = oldsdna->structs[oldSDNAnr];
-  type = oldsdna->types[spo[0]];
-  oldlen = oldsdna->types_size[spo[0]];
-  curSDNAnr = DNA_struct_find_nr(newsdna, type);
-
-  /* init data and alloc */
-  if (curSDNAnr != -1) {
-    spc = newsdna->structs[curSDNAnr];
-    curlen = newsdna->types_size[spc[0]];
-  }
+  const int curlen = DNA_struct_reconstruct_size(newsdna, oldsdna, oldSDNAnr);
   if (curlen == 0) {
     return NULL;
   }
 
-  cur = MEM_callocN(blocks * curlen, "reconstruct");
-  cpc = cur;
-  cpo = data;
-  for (a = 0; a < blocks; a++) {
+  char *cur = MEM_callocN(blocks * curlen, "reconstruct");
+  DNA_struct_reconstruct_range(newsdna, oldsdna, compflags, oldSDNAnr, 0, blocks, data, cur);
+
+  return cur;
+}
+
+/**
+ * \return The size of a struct of \a oldsdna reconstructed for \a newsdna,
+ * zero when the struct doesn't exist anymore.
+ */
+int DNA_struct_reconstruct_size(const SDNA *newsdna, const SDNA *oldsdna, int oldSDNAnr)
+{
+  /* oldSDNAnr == structnr, we're looking for the corresponding 'cur' number */
+  const short *spo = oldsdna->structs[oldSDNAnr];
+  const int curSDNAnr = DNA_struct_find_nr(newsdna, oldsdna->types[spo[0]]);
+  if (curSDNAnr == -1) {
+    return 0;
+  }
+  return newsdna->types_size[newsdna->structs[curSDNAnr][0]];
+}
+
+/**
+ * Same as #DNA_struct_reconstruct, for the array elements [first, first + blocks).
+ *
+ * Different ranges can be converted from multiple threads at once.
+ *
+ * \param data: Array of struct data (including the elements before \a first).
+ * \param cur: Array to reconstruct into, allocated and zero initialized by the caller,
+ * see #DNA_struct_reconstruct_size.
+ */
+void DNA_struct_reconstruct_range(const SDNA *newsdna,
+                                  const SDNA *oldsdna,
+                                  const char *compflags,
+                                  int oldSDNAnr,
+                                  int first,
+                                  int blocks,
+                                  const void *data,
+                                  void *cur)
+{
+  const short *spo = oldsdna->structs[oldSDNAnr];
+  const int oldlen = oldsdna->types_size[spo[0]];
+  const int curSDNAnr = DNA_struct_find_nr(newsdna, oldsdna->types[spo[0]]);
+  BLI_assert(curSDNAnr != -1);
+  const int curlen = newsdna->types_size[newsdna->structs[curSDNAnr][0]];
+
+  char *cpc = (char *)cur + (size_t)first * curlen;
+  const char *cpo = (const char *)data + (size_t)first * oldlen;
+  for (int a = 0; a < blocks; a++) {
     reconstruct_struct(newsdna, oldsdna, compflags, oldSDNAnr, cpo, curSDNAnr, cpc);
     cpc += curlen;
     cpo += oldlen;
   }
-
-  return cur;
 }
 
 /**
@@ -4613,6 +4613,14 @@ static void rna_def_userdef_edit(BlenderRNA *brna)
       "Global undo works by keeping a full copy of the file itself in memory, "
       "so takes extra memory");
 
+  prop = RNA_def_property(srna, "use_global_undo_skip_unchanged", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "uiflag", USER_GLOBALUNDO_SKIP_UNCHANGED);
+  RNA_def_property_ui_text(prop,
+                           "Skip Unchanged Data",
+                           "Reuse the global undo data of objects, meshes and materials "
+                           "which were not edited since the previous undo step, "
+                           "instead of writing them again (faster undo pushes on big scenes)");
+
   /* auto keyframing */
   prop = RNA_def_property(srna, "use_auto_keying", PROP_BOOLEAN, PROP_NONE);
   RNA_def_property_boolean_sdna(prop, NULL, "autokey_mode", AUTOKEY_ON);
@@ -5772,6 +5780,14 @@ static void rna_def_userdef_vr(BlenderRNA *brna)
     {0, NULL, 0, NULL, NULL},
   };
 
+  static const EnumPropertyItem vr_network_codecs[] = {
+    {0, "ZLIB", 0, "Zlib", "Compress every frame independently with zlib"},
+    {1, "DELTA_RLE", 0, "Delta RLE", "Run-length encode the difference to the previous frame"},
+    {2, "H264", 0, "H.264", "H.264 software encode (requires FFmpeg)"},
+    {3, "HEVC", 0, "HEVC", "HEVC software encode (requires FFmpeg)"},
+    {0, NULL, 0, NULL, NULL},
+  };
+
   srna = RNA_def_struct(brna, "PreferencesVR", NULL);
   RNA_def_struct_sdna(srna, "UserDef");
   RNA_def_struct_nested(brna, srna, "Preferences");
@@ -5791,6 +5807,35 @@ static void rna_def_userdef_vr(BlenderRNA *brna)
   RNA_def_property_string_sdna(prop, NULL, "vr_network_ipaddr");
   RNA_def_property_ui_text(prop, "IP Address", "IPv4 address for VR remote streaming");
 
+  prop = RNA_def_property(srna, "vr_network_codec", PROP_ENUM, PROP_NONE);
+  RNA_def_property_enum_sdna(prop, NULL, "vr_network_codec");
+  RNA_def_property_enum_items(prop, vr_network_codecs);
+  RNA_def_property_ui_text(prop, "Codec", "Codec used for streaming the eye images");
+
+  prop = RNA_def_property(srna, "vr_network_width", PROP_INT, PROP_PIXEL);
+  RNA_def_property_int_sdna(prop, NULL, "vr_network_width");
+  RNA_def_property_range(prop, 16, 4096);
+  RNA_def_property_ui_text(prop, "Width", "Width of the streamed eye images");
+
+  prop = RNA_def_property(srna, "vr_network_height", PROP_INT, PROP_PIXEL);
+  RNA_def_property_int_sdna(prop, NULL, "vr_network_height");
+  RNA_def_property_range(prop, 16, 4096);
+  RNA_def_property_ui_text(prop, "Height", "Height of the streamed eye images");
+
+  prop = RNA_def_property(srna, "vr_network_fps", PROP_INT, PROP_NONE);
+  RNA_def_property_int_sdna(prop, NULL, "vr_network_fps");
+  RNA_def_property_range(prop, 1, 240);
+  RNA_def_property_ui_text(
+      prop, "Frame Rate", "Maximum number of frames per second sent to the client");
+
+  prop = RNA_def_property(srna, "vr_network_spectators", PROP_BOOLEAN, PROP_NONE);
+  RNA_def_property_boolean_sdna(prop, NULL, "vr_network_spectators", 0);
+  RNA_def_property_boolean_default(prop, false);
+  RNA_def_property_ui_text(prop,
+                           "Spectators",
+                           "Stream the eye images to spectators connecting to port 27012 of the IP "
+                           "address, without authentication (applies when the stream starts)");
+
   /* Experimental */
 
   prop = RNA_def_property(srna, "vr_openxr", PROP_BOOLEAN, PROP_NONE);
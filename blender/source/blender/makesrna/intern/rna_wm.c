@@ -443,6 +443,11 @@ static const EnumPropertyItem operator_flag_items[] = {
      0,
      "Grouped Undo",
      "Push a single undo event for repetead instances of this operator"},
+    {OPTYPE_UNDO_SELECT,
+     "UNDO_SELECT",
+     0,
+     "Selection Undo",
+     "The operator only changes the selection, push a lighter undo event in mesh edit-mode"},
     {OPTYPE_BLOCKING, "BLOCKING", 0, "Blocking", "Block anything else from using the cursor"},
     {OPTYPE_MACRO, "MACRO", 0, "Macro", "Use to check if an operator is a macro"},
     {OPTYPE_GRAB_CURSOR_XY,
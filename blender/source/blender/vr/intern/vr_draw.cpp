@@ -43,11 +43,20 @@
 #include <GL/gl.h>
 
 #include "vr_draw.h"
+#include "vr_draw_atlas.h"
+#include "vr_draw_batch.h"
+#include "vr_draw_list.h"
 #include "vr_math.h"
 #include "vr_ui.h"
 
 #include "png.h"
 
+extern "C" {
+#include "BLI_path_util.h"
+
+#include "BKE_appdir.h"
+}
+
 /* Controller models and textures */
 #include "ui_oculus_controller_left.obj.h"
 #include "ui_oculus_controller_right.obj.h"
@@ -307,6 +316,81 @@ Mat44f VR_Draw::modelview_matrix;
 Mat44f VR_Draw::modelview_matrix_inv;
 float VR_Draw::color_vector[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
 
+/* OpenGL backend of the UI batch.
+ * Vertices are written into a persistently mapped buffer (GL_ARB_buffer_storage) split into
+ * segments that are used round-robin, each guarded by a fence, so the CPU never waits on
+ * a buffer the GPU is still reading. Falls back to an orphaned GL_STREAM_DRAW buffer. */
+class VR_Draw::BatchBackend : public VR_Draw_Batch::Backend, public VR_Draw::BufferBackend
+{
+public:
+	static const uint segments = 3;	/* Number of buffer segments. */
+	static const uint segment_verts = 16384;	/* Capacity of a segment (in vertices). */
+
+	BatchBackend();	/* Constructor. */
+	virtual ~BatchBackend();	/* Destructor. */
+
+	virtual bool begin(const VR_Draw_Batch::Vertex *verts, uint num_verts, const float projection[4][4]);	/* Upload the vertices and set up the common state. */
+	virtual void set_depth(const VR_Draw_Batch::DepthState& depth);	/* Apply a depth state. */
+	virtual void set_texture(const void *texture);	/* Bind a texture. */
+	virtual void draw(VR_Draw_Batch::Primitive prim, uint first, uint count);	/* Draw a range of the uploaded vertices. */
+	virtual void end();	/* Restore the state saved in begin(). */
+
+	bool create();	/* Create the OpenGL objects (if not done yet). */
+	void release();	/* Release the OpenGL objects. */
+protected:
+	bool	created;	/* Whether create() has been called. */
+	bool	valid;	/* Whether the OpenGL objects have been created successfully. */
+	Shader	shader;	/* Batch shader. */
+	GLuint	buffer;	/* Vertex buffer. */
+	VR_Draw_Batch::Vertex	*mapped;	/* Persistently mapped vertex buffer (if supported). */
+	GLsync	fences[segments];	/* Fences of the segments. */
+	uint	segment;	/* Current segment. */
+	uint	base;	/* First vertex of the current upload in the buffer. */
+
+	static const char* const shader_vsource;	/* Vertex shader source code. */
+	static const char* const shader_fsource;	/* Fragment shader source code. */
+};
+
+/* OpenGL backend of the display lists.
+ * Each list has its own static vertex buffer; all lists share the shader and the vertex array
+ * (the attribute pointers are set for the list's buffer in begin()). */
+class VR_Draw::ListBackend : public VR_Draw_List::Backend, public VR_Draw::BufferBackend
+{
+public:
+	ListBackend();	/* Constructor. */
+	virtual ~ListBackend();	/* Destructor. */
+
+	virtual bool upload(uint& buffer, const VR_Draw_List::Vertex *verts, uint num_verts);	/* Upload the vertices of a rebuilt list (creating the buffer if it is 0). */
+	virtual bool begin(uint buffer, const float modelview[4][4], const float modelview_inv[4][4], const float projection[4][4]);	/* Set up the common state for replaying a list. */
+	virtual void set_texture(const void *texture);	/* Bind a texture. */
+	virtual void draw(uint first, uint count);	/* Draw a range of the uploaded vertices. */
+	virtual void end();	/* Restore the state saved in begin(). */
+
+	bool create();	/* Create the OpenGL objects (if not done yet). */
+	void release();	/* Release the OpenGL objects (including the buffers of all lists). */
+protected:
+	bool	created;	/* Whether create() has been called. */
+	bool	valid;	/* Whether the OpenGL objects have been created successfully. */
+	Shader	shader;	/* List shader. */
+
+	static const char* const shader_vsource;	/* Vertex shader source code. */
+	static const char* const shader_fsource;	/* Fragment shader source code. */
+};
+
+VR_Draw::Texture *VR_Draw::atlas_members(0);
+VR_Draw::Texture **VR_Draw::atlas_pages(0);
+uint VR_Draw::num_atlas_pages(0);
+bool VR_Draw::atlas_resolved(false);
+
+VR_Draw_Batch *VR_Draw::batch(0);
+VR_Draw::BatchBackend *VR_Draw::batch_backend(0);
+int VR_Draw::batch_level(0);
+bool VR_Draw::batch_enabled(true);
+
+VR_Draw::ListBackend *VR_Draw::list_backend(0);
+VR_Draw_List *VR_Draw::list(0);
+Mat44f VR_Draw::list_view_matrix;
+
 VR_Draw::VR_Draw()
 {
 	//
@@ -344,114 +428,118 @@ int VR_Draw::init(void* display, void* drawable, void* context)
 		return -1;
 	}
 
+	/* Icon, menu and string textures are packed into the UI atlas on first use (see resolve_atlas()). */
+	atlas_members = NULL;
+	atlas_resolved = false;
+
 	/* Create cursor model. */
 	vr_cursor_model = Model::create(ui_cursor_obj_verts, ui_cursor_obj_nrmls, ui_cursor_obj_uvs, ui_cursor_obj_numverts);
 	vr_cursor_tex = new Texture(ui_cursor_png);
 	if (vr_cursor_model) {
 		vr_cursor_model->texture = vr_cursor_tex;
 	}
-	cursor_tex = new Texture(icon_cursor_png);
-	mouse_cursor_tex = new Texture(icon_mouse_cursor_png);
+	cursor_tex = new Texture(icon_cursor_png, true);
+	mouse_cursor_tex = new Texture(icon_mouse_cursor_png, true);
 
 	/* Create image textures. */
-	nav_grabair_tex = new Texture(icon_nav_grabair_png);
-	nav_joystick_tex = new Texture(icon_nav_joystick_png);
-	nav_teleport_tex = new Texture(icon_nav_teleport_png);
-	nav_locktrans_tex = new Texture(icon_nav_locktrans_png);
-	nav_locktransup_tex = new Texture(icon_nav_locktransup_png);
-	nav_lockrot_tex = new Texture(icon_nav_lockrot_png);
-	nav_lockrotup_tex = new Texture(icon_nav_lockrotup_png);
-	nav_lockscale_tex = new Texture(icon_nav_lockscale_png);
-	nav_lockscalereal_tex = new Texture(icon_nav_lockscalereal_png);
-	ctrl_tex = new Texture(icon_ctrl_png);
-	shift_tex = new Texture(icon_shift_png);
-	alt_tex = new Texture(icon_alt_png);
-	select_tex = new Texture(icon_select_png);
-	select_raycast_tex = new Texture(icon_select_raycast_png);
-	select_proximity_tex = new Texture(icon_select_proximity_png);
-	cursor_teleport_tex = new Texture(icon_cursor_teleport_png);
-	cursor_worldorigin_tex = new Texture(icon_cursor_worldorigin_png);
-	cursor_objorigin_tex = new Texture(icon_cursor_objorigin_png);
-	transform_tex = new Texture(icon_transform_png);
-	move_tex = new Texture(icon_move_png);
-	rotate_tex = new Texture(icon_rotate_png);
-	scale_tex = new Texture(icon_scale_png);
-	annotate_tex = new Texture(icon_annotate_png);
-	measure_tex = new Texture(icon_measure_png);
-	mesh_tex = new Texture(icon_mesh_png);
-	mesh_plane_tex = new Texture(icon_mesh_plane_png);
-	mesh_cube_tex = new Texture(icon_mesh_cube_png);
-	mesh_circle_tex = new Texture(icon_mesh_circle_png);
-	mesh_cylinder_tex = new Texture(icon_mesh_cylinder_png);
-	mesh_cone_tex = new Texture(icon_mesh_cone_png);
-	mesh_grid_tex = new Texture(icon_mesh_grid_png);
-	mesh_monkey_tex = new Texture(icon_mesh_monkey_png);
-	mesh_uvsphere_tex = new Texture(icon_mesh_uvsphere_png);
-	mesh_icosphere_tex = new Texture(icon_mesh_icosphere_png);
-	extrude_tex = new Texture(icon_extrude_png);
-	extrude_individual_tex = new Texture(icon_extrude_individual_png);
-	extrude_normals_tex = new Texture(icon_extrude_normals_png);
-	insetfaces_tex = new Texture(icon_insetfaces_png);
-	bevel_tex = new Texture(icon_bevel_png);
-	loopcut_tex = new Texture(icon_loopcut_png);
-	knife_tex = new Texture(icon_knife_png);
-	sculpt_tex = new Texture(icon_sculpt_png);
-	sculpt_draw_tex = new Texture(icon_sculpt_draw_png);
-	sculpt_clay_tex = new Texture(icon_sculpt_clay_png);
-	sculpt_claystrips_tex = new Texture(icon_sculpt_claystrips_png);
-	sculpt_layer_tex = new Texture(icon_sculpt_layer_png);
-	sculpt_inflate_tex = new Texture(icon_sculpt_inflate_png);
-	sculpt_blob_tex = new Texture(icon_sculpt_blob_png);
-	sculpt_crease_tex = new Texture(icon_sculpt_crease_png);
-	sculpt_smooth_tex = new Texture(icon_sculpt_smooth_png);
-	sculpt_flatten_tex = new Texture(icon_sculpt_flatten_png);
-	sculpt_fill_tex = new Texture(icon_sculpt_fill_png);
-	sculpt_scrape_tex = new Texture(icon_sculpt_scrape_png);
-	sculpt_pinch_tex = new Texture(icon_sculpt_pinch_png);
-	sculpt_grab_tex = new Texture(icon_sculpt_grab_png);
-	sculpt_snakehook_tex = new Texture(icon_sculpt_snakehook_png);
-	sculpt_thumb_tex = new Texture(icon_sculpt_thumb_png);
-	sculpt_nudge_tex = new Texture(icon_sculpt_nudge_png);
-	sculpt_rotate_tex = new Texture(icon_sculpt_rotate_png);
-	sculpt_mask_tex = new Texture(icon_sculpt_mask_png);
-	sculpt_simplify_tex = new Texture(icon_sculpt_simplify_png);
-	animation_tex = new Texture(icon_animation_png);
-	delete_tex = new Texture(icon_delete_png);
-	duplicate_tex = new Texture(icon_duplicate_png);
-	join_tex = new Texture(icon_join_png);
-	separate_tex = new Texture(icon_separate_png);
-	undo_tex = new Texture(icon_undo_png);
-	redo_tex = new Texture(icon_redo_png);
-	manip_global_tex = new Texture(icon_manip_global_png);
-	manip_local_tex = new Texture(icon_manip_local_png);
-	manip_normal_tex = new Texture(icon_manip_normal_png);
-	manip_plus_tex = new Texture(icon_manip_plus_png);
-	manip_minus_tex = new Texture(icon_manip_minus_png);
-	objectmode_tex = new Texture(icon_objectmode_png);
-	editmode_tex = new Texture(icon_editmode_png);
-	object_tex = new Texture(icon_object_png);
-	vertex_tex = new Texture(icon_vertex_png);
-	edge_tex = new Texture(icon_edge_png);
-	face_tex = new Texture(icon_face_png);
-	toolsettings_tex = new Texture(icon_toolsettings_png);
-	box_empty_tex = new Texture(icon_box_empty_png);
-	box_filled_tex = new Texture(icon_box_filled_png);
-	plus_tex = new Texture(icon_plus_png);
-	minus_tex = new Texture(icon_minus_png);
-	reset_tex = new Texture(icon_reset_png);
-
-	background_menu_tex = new Texture(menu_background_png);
-	colorwheel_menu_tex = new Texture(menu_colorwheel_png);
-
-	ascii_tex = new Texture(ascii_png);
-	on_str_tex = new Texture(str_on_png);
-	off_str_tex = new Texture(str_off_png);
-	x_str_tex = new Texture(str_x_png);
-	y_str_tex = new Texture(str_y_png);
-	z_str_tex = new Texture(str_z_png);
-	xy_str_tex = new Texture(str_xy_png);
-	yz_str_tex = new Texture(str_yz_png);
-	zx_str_tex = new Texture(str_zx_png);
+	nav_grabair_tex = new Texture(icon_nav_grabair_png, true);
+	nav_joystick_tex = new Texture(icon_nav_joystick_png, true);
+	nav_teleport_tex = new Texture(icon_nav_teleport_png, true);
+	nav_locktrans_tex = new Texture(icon_nav_locktrans_png, true);
+	nav_locktransup_tex = new Texture(icon_nav_locktransup_png, true);
+	nav_lockrot_tex = new Texture(icon_nav_lockrot_png, true);
+	nav_lockrotup_tex = new Texture(icon_nav_lockrotup_png, true);
+	nav_lockscale_tex = new Texture(icon_nav_lockscale_png, true);
+	nav_lockscalereal_tex = new Texture(icon_nav_lockscalereal_png, true);
+	ctrl_tex = new Texture(icon_ctrl_png, true);
+	shift_tex = new Texture(icon_shift_png, true);
+	alt_tex = new Texture(icon_alt_png, true);
+	select_tex = new Texture(icon_select_png, true);
+	select_raycast_tex = new Texture(icon_select_raycast_png, true);
+	select_proximity_tex = new Texture(icon_select_proximity_png, true);
+	cursor_teleport_tex = new Texture(icon_cursor_teleport_png, true);
+	cursor_worldorigin_tex = new Texture(icon_cursor_worldorigin_png, true);
+	cursor_objorigin_tex = new Texture(icon_cursor_objorigin_png, true);
+	transform_tex = new Texture(icon_transform_png, true);
+	move_tex = new Texture(icon_move_png, true);
+	rotate_tex = new Texture(icon_rotate_png, true);
+	scale_tex = new Texture(icon_scale_png, true);
+	annotate_tex = new Texture(icon_annotate_png, true);
+	measure_tex = new Texture(icon_measure_png, true);
+	mesh_tex = new Texture(icon_mesh_png, true);
+	mesh_plane_tex = new Texture(icon_mesh_plane_png, true);
+	mesh_cube_tex = new Texture(icon_mesh_cube_png, true);
+	mesh_circle_tex = new Texture(icon_mesh_circle_png, true);
+	mesh_cylinder_tex = new Texture(icon_mesh_cylinder_png, true);
+	mesh_cone_tex = new Texture(icon_mesh_cone_png, true);
+	mesh_grid_tex = new Texture(icon_mesh_grid_png, true);
+	mesh_monkey_tex = new Texture(icon_mesh_monkey_png, true);
+	mesh_uvsphere_tex = new Texture(icon_mesh_uvsphere_png, true);
+	mesh_icosphere_tex = new Texture(icon_mesh_icosphere_png, true);
+	extrude_tex = new Texture(icon_extrude_png, true);
+	extrude_individual_tex = new Texture(icon_extrude_individual_png, true);
+	extrude_normals_tex = new Texture(icon_extrude_normals_png, true);
+	insetfaces_tex = new Texture(icon_insetfaces_png, true);
+	bevel_tex = new Texture(icon_bevel_png, true);
+	loopcut_tex = new Texture(icon_loopcut_png, true);
+	knife_tex = new Texture(icon_knife_png, true);
+	sculpt_tex = new Texture(icon_sculpt_png, true);
+	sculpt_draw_tex = new Texture(icon_sculpt_draw_png, true);
+	sculpt_clay_tex = new Texture(icon_sculpt_clay_png, true);
+	sculpt_claystrips_tex = new Texture(icon_sculpt_claystrips_png, true);
+	sculpt_layer_tex = new Texture(icon_sculpt_layer_png, true);
+	sculpt_inflate_tex = new Texture(icon_sculpt_inflate_png, true);
+	sculpt_blob_tex = new Texture(icon_sculpt_blob_png, true);
+	sculpt_crease_tex = new Texture(icon_sculpt_crease_png, true);
+	sculpt_smooth_tex = new Texture(icon_sculpt_smooth_png, true);
+	sculpt_flatten_tex = new Texture(icon_sculpt_flatten_png, true);
+	sculpt_fill_tex = new Texture(icon_sculpt_fill_png, true);
+	sculpt_scrape_tex = new Texture(icon_sculpt_scrape_png, true);
+	sculpt_pinch_tex = new Texture(icon_sculpt_pinch_png, true);
+	sculpt_grab_tex = new Texture(icon_sculpt_grab_png, true);
+	sculpt_snakehook_tex = new Texture(icon_sculpt_snakehook_png, true);
+	sculpt_thumb_tex = new Texture(icon_sculpt_thumb_png, true);
+	sculpt_nudge_tex = new Texture(icon_sculpt_nudge_png, true);
+	sculpt_rotate_tex = new Texture(icon_sculpt_rotate_png, true);
+	sculpt_mask_tex = new Texture(icon_sculpt_mask_png, true);
+	sculpt_simplify_tex = new Texture(icon_sculpt_simplify_png, true);
+	animation_tex = new Texture(icon_animation_png, true);
+	delete_tex = new Texture(icon_delete_png, true);
+	duplicate_tex = new Texture(icon_duplicate_png, true);
+	join_tex = new Texture(icon_join_png, true);
+	separate_tex = new Texture(icon_separate_png, true);
+	undo_tex = new Texture(icon_undo_png, true);
+	redo_tex = new Texture(icon_redo_png, true);
+	manip_global_tex = new Texture(icon_manip_global_png, true);
+	manip_local_tex = new Texture(icon_manip_local_png, true);
+	manip_normal_tex = new Texture(icon_manip_normal_png, true);
+	manip_plus_tex = new Texture(icon_manip_plus_png, true);
+	manip_minus_tex = new Texture(icon_manip_minus_png, true);
+	objectmode_tex = new Texture(icon_objectmode_png, true);
+	editmode_tex = new Texture(icon_editmode_png, true);
+	object_tex = new Texture(icon_object_png, true);
+	vertex_tex = new Texture(icon_vertex_png, true);
+	edge_tex = new Texture(icon_edge_png, true);
+	face_tex = new Texture(icon_face_png, true);
+	toolsettings_tex = new Texture(icon_toolsettings_png, true);
+	box_empty_tex = new Texture(icon_box_empty_png, true);
+	box_filled_tex = new Texture(icon_box_filled_png, true);
+	plus_tex = new Texture(icon_plus_png, true);
+	minus_tex = new Texture(icon_minus_png, true);
+	reset_tex = new Texture(icon_reset_png, true);
+
+	background_menu_tex = new Texture(menu_background_png, true);
+	colorwheel_menu_tex = new Texture(menu_colorwheel_png, true);
+
+	ascii_tex = new Texture(ascii_png, true);
+	on_str_tex = new Texture(str_on_png, true);
+	off_str_tex = new Texture(str_off_png, true);
+	x_str_tex = new Texture(str_x_png, true);
+	y_str_tex = new Texture(str_y_png, true);
+	z_str_tex = new Texture(str_z_png, true);
+	xy_str_tex = new Texture(str_xy_png, true);
+	yz_str_tex = new Texture(str_yz_png, true);
+	zx_str_tex = new Texture(str_zx_png, true);
 
 	model_matrix.set_to_identity();
 	view_matrix.set_to_identity();
@@ -459,6 +547,15 @@ int VR_Draw::init(void* display, void* drawable, void* context)
 	modelview_matrix.set_to_identity();
 	modelview_matrix_inv.set_to_identity();
 
+	/* The backend creates its OpenGL objects on first use. */
+	batch = new VR_Draw_Batch();
+	batch_backend = new BatchBackend();
+	batch->set_backend(batch_backend);
+	batch->set_capacity(BatchBackend::segment_verts);
+	batch_level = 0;
+	list_backend = new ListBackend();
+	list = 0;
+
 	VR_Draw::initialized = true;
 
 	return 0;
@@ -881,6 +978,34 @@ void VR_Draw::uninit()
 		delete zx_str_tex;
 		zx_str_tex = NULL;
 	}
+
+	atlas_members = NULL;
+	if (atlas_pages) {
+		for (uint i = 0; i < num_atlas_pages; ++i) {
+			delete atlas_pages[i];
+		}
+		delete[] atlas_pages;
+		atlas_pages = NULL;
+	}
+	num_atlas_pages = 0;
+	atlas_resolved = false;
+
+	if (batch) {
+		delete batch;
+		batch = NULL;
+	}
+	if (batch_backend) {
+		delete batch_backend;
+		batch_backend = NULL;
+	}
+	batch_level = 0;
+
+	/* The lists forget their buffers when they get the next backend. */
+	if (list_backend) {
+		delete list_backend;
+		list_backend = NULL;
+	}
+	list = 0;
 }
 
 int VR_Draw::create_controller_models(VR_Device_Type type)
@@ -976,6 +1101,9 @@ void VR_Draw::update_view_matrix(const float _view[4][4])
 void VR_Draw::update_projection_matrix(const float _projection[4][4])
 {
 	projection_matrix = _projection;
+	if (batch_level > 0) {
+		batch->set_projection(projection_matrix.m);
+	}
 }
 
 void VR_Draw::update_modelview_matrix(const Mat44f* _model, const Mat44f* _view)
@@ -1048,82 +1176,102 @@ void VR_Draw::set_depth_test(bool on_off, bool write_depth)
 			glDepthMask(GL_FALSE); /* If flag is GL_FALSE, depth buffer writing is disabled */
 		}
 	}
+
+	if (batch_level > 0) {
+		VR_Draw_Batch::DepthState depth;
+		depth.test = true;
+		depth.func = on_off ? GL_LESS : GL_ALWAYS;
+		depth.write = write_depth;
+		batch->set_depth(depth);
+	}
 }
 
-static void Util_Image_decodePNGRGBA_readData(png_structp png_ptr, png_bytep data, png_uint_32 length)
+static void createTextureFromRGBA(const uchar* imgbuf, uint& texture_id, uint w, uint h)
 {
-	uchar** b = (uchar**)png_get_io_ptr(png_ptr);
-	std::memcpy(data, *b, length);
-	*b += length;
+	/* Turn it into an OpenGL texture. */
+	glEnable(GL_TEXTURE_2D);
+	glGenTextures(1, &texture_id);
+	glBindTexture(GL_TEXTURE_2D, texture_id);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)imgbuf);
+
+	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-static bool decodePNGRGBA(const uchar* png_data, uchar*& img, uint& w, uint& h)
+static bool createTextureFromPNG(const uchar* data, uint& texture_id, uint& w, uint& h)
 {
-	png_structp png_ptr;
-	png_infop info_ptr;
-	uint sig_read = 0;
-	png_uint_32 width, height;
-	int bit_depth, color_type, interlace_type;
-
-	png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-	if (png_ptr == NULL) {
+	if (!data)
 		return false;
-	}
 
-	info_ptr = png_create_info_struct(png_ptr);
-	if (info_ptr == NULL) {
-		png_destroy_read_struct(&png_ptr, 0, 0);
+	uchar* imgbuf;
+	if (!VR_Draw_Atlas::decode_png(data, imgbuf, w, h)) {
 		return false;
 	}
 
-	png_set_read_fn(png_ptr, &png_data, (png_rw_ptr)Util_Image_decodePNGRGBA_readData);
-	png_read_info(png_ptr, info_ptr);
-	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, &interlace_type, NULL, NULL);
-
-	w = width;
-	h = height;
-
-	img = (uchar*)malloc(sizeof(uchar)*w*h * 4);
-
-	png_set_sig_bytes(png_ptr, sig_read);
-	png_set_strip_16(png_ptr);
-	png_set_packing(png_ptr);
-	png_set_filler(png_ptr, 0xff, PNG_FILLER_AFTER);
-
-	for (uint y = 0; y < height; y++) {
-		png_read_row(png_ptr, img + (y*w * 4), 0);
-	}
+	createTextureFromRGBA(imgbuf, texture_id, w, h);
 
-	png_read_end(png_ptr, info_ptr);
-	png_destroy_read_struct(&png_ptr, &info_ptr, 0);
+	free(imgbuf);
 
 	return true;
 }
 
-static bool createTextureFromPNG(const uchar* data, uint& texture_id, uint& w, uint& h)
+bool VR_Draw::resolve_atlas()
 {
-	if (!data)
-		return false;
+	if (atlas_resolved) {
+		return (num_atlas_pages > 0);
+	}
+	atlas_resolved = true;
 
-	uchar* imgbuf;
-	if (!decodePNGRGBA(data, imgbuf, w, h)) {
+	std::vector<Texture*> members;
+	std::vector<const uchar*> pngs;
+	for (Texture* t = atlas_members; t; t = t->atlas_next) {
+		members.push_back(t);
+		pngs.push_back(t->png_blob);
+	}
+	if (members.empty()) {
 		return false;
 	}
 
-	/* Now turn it into an OpenGL texture. */
-	glEnable(GL_TEXTURE_2D);
-	glGenTextures(1, &texture_id);
-	glBindTexture(GL_TEXTURE_2D, texture_id);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, (GLvoid*)imgbuf);
+	/* Try the cache first, so the PNGs only have to be decoded once. */
+	char path[FILE_MAX] = "";
+	const char* dir = BKE_appdir_folder_id_create(BLENDER_USER_DATAFILES, "vr");
+	if (dir) {
+		BLI_join_dirfile(path, sizeof(path), dir, "ui_atlas.cache");
+	}
 
-	glBindTexture(GL_TEXTURE_2D, 0);
+	VR_Draw_Atlas atlas;
+	const ui64 key = VR_Draw_Atlas::fingerprint(&pngs[0], (uint)pngs.size());
+	if (!path[0] || !atlas.load(path, key, (uint)pngs.size())) {
+		if (!atlas.build(&pngs[0], (uint)pngs.size())) {
+			/* Fall back to separate textures. */
+			for (size_t i = 0; i < members.size(); ++i) {
+				members[i]->atlas = false;
+			}
+			return false;
+		}
+		if (path[0]) {
+			atlas.save(path);
+		}
+	}
 
-	free(imgbuf);
+	num_atlas_pages = (uint)atlas.pages.size();
+	atlas_pages = new Texture*[num_atlas_pages];
+	for (uint i = 0; i < num_atlas_pages; ++i) {
+		const VR_Draw_Atlas::Page& page = atlas.pages[i];
+		atlas_pages[i] = new Texture(new Texture::TextureImplementation(&page.pixels[0], page.w, page.h));
+	}
+	for (size_t i = 0; i < members.size(); ++i) {
+		const VR_Draw_Atlas::Region& region = atlas.regions[i];
+		Texture* t = members[i];
+		t->atlas_page = atlas_pages[region.page];
+		memcpy(t->atlas_uv, region.uv, sizeof(t->atlas_uv));
+		t->atlas_size[0] = region.w;
+		t->atlas_size[1] = region.h;
+	}
 
 	return true;
 }
@@ -1281,9 +1429,26 @@ void main()
 }
 ));
 
-VR_Draw::Texture::Texture(const uchar* png_blob)
+VR_Draw::Texture::Texture(const uchar* png_blob, bool atlas)
 	: png_blob(png_blob)
 	, implementation(0)
+	, atlas(atlas && png_blob)
+	, atlas_next(0)
+	, atlas_page(0)
+{
+	if (this->atlas) {
+		/* Register for packing; nothing is decoded until the atlas is first used. */
+		this->atlas_next = VR_Draw::atlas_members;
+		VR_Draw::atlas_members = this;
+	}
+}
+
+VR_Draw::Texture::Texture(TextureImplementation* implementation)
+	: png_blob(0)
+	, implementation(implementation)
+	, atlas(false)
+	, atlas_next(0)
+	, atlas_page(0)
 {
 	//
 }
@@ -1292,6 +1457,11 @@ VR_Draw::Texture::Texture(const Texture& cpy)
 {
 	this->png_blob = cpy.png_blob;
 	this->implementation = cpy.implementation;
+	this->atlas = false;
+	this->atlas_next = 0;
+	this->atlas_page = cpy.atlas_page;
+	memcpy(this->atlas_uv, cpy.atlas_uv, sizeof(this->atlas_uv));
+	memcpy(this->atlas_size, cpy.atlas_size, sizeof(this->atlas_size));
 }
 
 VR_Draw::Texture::~Texture()
@@ -1305,12 +1475,21 @@ VR_Draw::Texture& VR_Draw::Texture::operator= (const Texture& o)
 {
 	this->png_blob = o.png_blob;
 	this->implementation = o.implementation;
+	this->atlas_page = o.atlas_page;
+	memcpy(this->atlas_uv, o.atlas_uv, sizeof(this->atlas_uv));
+	memcpy(this->atlas_size, o.atlas_size, sizeof(this->atlas_size));
 
 	return *this;
 }
 
 void VR_Draw::Texture::bind()
 {
+	Texture* target = this->resolve();
+	if (target != this) {
+		target->bind();
+		return;
+	}
+
 	if (!this->implementation) {
 		if (!this->create_implementation()) {
 			return;
@@ -1329,6 +1508,9 @@ void VR_Draw::Texture::unbind()
 
 uint VR_Draw::Texture::width()
 {
+	if (this->resolve() != this) {
+		return this->atlas_size[0];
+	}
 	if (!this->implementation) {
 		this->create_implementation();
 	}
@@ -1337,12 +1519,31 @@ uint VR_Draw::Texture::width()
 
 uint VR_Draw::Texture::height()
 {
+	if (this->resolve() != this) {
+		return this->atlas_size[1];
+	}
 	if (!this->implementation) {
 		this->create_implementation();
 	}
 	return this->implementation->height;
 }
 
+VR_Draw::Texture* VR_Draw::Texture::resolve()
+{
+	if (this->atlas && !VR_Draw::atlas_resolved) {
+		VR_Draw::resolve_atlas();
+	}
+	return this->atlas_page ? this->atlas_page : this;
+}
+
+void VR_Draw::Texture::map_uv(float& u, float& v) const
+{
+	if (this->atlas_page) {
+		u = this->atlas_uv[0] + u * (this->atlas_uv[2] - this->atlas_uv[0]);
+		v = this->atlas_uv[1] + v * (this->atlas_uv[3] - this->atlas_uv[1]);
+	}
+}
+
 bool VR_Draw::Texture::create_implementation()
 {
 	/* Generate from PNG blob. */
@@ -1372,6 +1573,26 @@ VR_Draw::Texture::TextureImplementation::TextureImplementation(const uchar* png_
 	glBindTexture(GL_TEXTURE_2D, bound_texture);
 }
 
+VR_Draw::Texture::TextureImplementation::TextureImplementation(const uchar* rgba, uint w, uint h)
+{
+	/* Save previous OpenGL state. */
+	GLboolean texture_enabled = glIsEnabled(GL_TEXTURE_2D);
+	if (!texture_enabled)
+		glEnable(GL_TEXTURE_2D);
+	GLint bound_texture;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &bound_texture);
+
+	createTextureFromRGBA(rgba, this->texture_id, w, h);
+	this->width = w;
+	this->height = h;
+	this->depth = 4;
+
+	/* Revert to previous OpenGL state. */
+	if (!texture_enabled)
+		glDisable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, bound_texture);
+}
+
 VR_Draw::Texture::TextureImplementation::~TextureImplementation()
 {
 	if (this->texture_id) {
@@ -1465,6 +1686,9 @@ VR_Draw::Model* VR_Draw::Model::create(float* verts, float* nrmls, float* uvs, u
 
 int VR_Draw::Model::render()
 {
+	/* Draw pending UI primitives first to keep the drawing order. */
+	VR_Draw::flush_batch();
+
 	/* Save previous OpenGL state */
 	GLint prior_program;
 	glGetIntegerv(GL_CURRENT_PROGRAM, &prior_program);
@@ -1542,8 +1766,612 @@ int VR_Draw::Model::render(const Mat44f& pos)
 	return e;
 }
 
+/***************************************************************************************************
+ * \class                                  VR_Draw::BufferBackend
+ ***************************************************************************************************
+ * Shared OpenGL part of the backends of retained geometry.
+ **************************************************************************************************/
+VR_Draw::BufferBackend::BufferBackend(uint stride)
+	: stride(stride), num_attributes(0), vertex_array(0), prior_saved_depth(false)
+{
+	//
+}
+
+VR_Draw::BufferBackend::~BufferBackend()
+{
+	//
+}
+
+void VR_Draw::BufferBackend::set_layout(const Attribute *attributes, uint num_attributes)
+{
+	this->num_attributes = (num_attributes < max_attributes) ? num_attributes : max_attributes;
+	memcpy(this->attributes, attributes, this->num_attributes * sizeof(Attribute));
+}
+
+uint VR_Draw::BufferBackend::create_buffer()
+{
+	GLuint buffer = 0;
+	glGenBuffers(1, &buffer);
+	if (buffer) {
+		this->buffers.push_back(buffer);
+	}
+	return buffer;
+}
+
+void VR_Draw::BufferBackend::delete_buffer(uint buffer)
+{
+	for (uint i = 0; i < this->buffers.size(); ++i) {
+		if (this->buffers[i] == buffer) {
+			this->buffers.erase(this->buffers.begin() + i);
+			glDeleteBuffers(1, &buffer);
+			return;
+		}
+	}
+}
+
+void VR_Draw::BufferBackend::allocate_buffer(uint buffer, uint num_verts, Usage usage, const void *verts)
+{
+	static const GLenum gl_usage[] = { GL_STATIC_DRAW, GL_DYNAMIC_DRAW, GL_STREAM_DRAW };
+
+	GLint prior_array_buffer;
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &prior_array_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferData(GL_ARRAY_BUFFER, num_verts * this->stride, verts, gl_usage[usage]);
+	glBindBuffer(GL_ARRAY_BUFFER, prior_array_buffer);
+}
+
+void VR_Draw::BufferBackend::update_buffer(uint buffer, uint first, const void *verts, uint num_verts)
+{
+	GLint prior_array_buffer;
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &prior_array_buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	glBufferSubData(GL_ARRAY_BUFFER, first * this->stride, num_verts * this->stride, verts);
+	glBindBuffer(GL_ARRAY_BUFFER, prior_array_buffer);
+}
+
+uint VR_Draw::BufferBackend::grow_buffer(uint buffer, uint num_verts, uint num_keep)
+{
+	const GLuint new_buffer = this->create_buffer();
+	if (!new_buffer) {
+		return 0;
+	}
+
+	/* The contents so far are copied on the GPU, rather than uploaded again. */
+	glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, num_verts * this->stride, 0, GL_DYNAMIC_DRAW);
+	if (buffer && num_keep) {
+		glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+		glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, num_keep * this->stride);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	}
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	if (buffer) {
+		this->delete_buffer(buffer);
+	}
+	return new_buffer;
+}
+
+bool VR_Draw::BufferBackend::bind_buffer(uint buffer)
+{
+	if (!this->vertex_array) {
+		glGenVertexArrays(1, &this->vertex_array);
+		if (!this->vertex_array) {
+			return false;
+		}
+	}
+
+	glBindVertexArray(this->vertex_array);
+	glBindBuffer(GL_ARRAY_BUFFER, buffer);
+	for (uint i = 0; i < this->num_attributes; ++i) {
+		const Attribute& a = this->attributes[i];
+		if (a.location < 0) {
+			continue;
+		}
+		glEnableVertexAttribArray(a.location);
+		glVertexAttribPointer(a.location, a.size, GL_FLOAT, GL_FALSE, this->stride, (void*)(size_t)a.offset);
+	}
+	return true;
+}
+
+void VR_Draw::BufferBackend::save_state(bool depth)
+{
+	glGetIntegerv(GL_CURRENT_PROGRAM, &this->prior_program);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &this->prior_vertex_array_binding);
+	glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &this->prior_array_buffer);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &this->prior_texture_binding_2d);
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &this->prior_texture_unit);
+	this->prior_backface_culling = glIsEnabled(GL_CULL_FACE);
+	this->prior_blend_enabled = glIsEnabled(GL_BLEND);
+	this->prior_texture_enabled = glIsEnabled(GL_TEXTURE_2D);
+
+	this->prior_saved_depth = depth;
+	if (depth) {
+		glGetIntegerv(GL_DEPTH_FUNC, &this->prior_depth_func);
+		glGetBooleanv(GL_DEPTH_WRITEMASK, &this->prior_depth_mask);
+		this->prior_depth_test = glIsEnabled(GL_DEPTH_TEST);
+	}
+}
+
+void VR_Draw::BufferBackend::set_ui_state()
+{
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_TEXTURE_2D);
+	glActiveTexture(GL_TEXTURE0);
+}
+
+void VR_Draw::BufferBackend::restore_state()
+{
+	glBindVertexArray(this->prior_vertex_array_binding);
+	glBindBuffer(GL_ARRAY_BUFFER, this->prior_array_buffer);
+	glBindTexture(GL_TEXTURE_2D, this->prior_texture_binding_2d);
+	glActiveTexture(this->prior_texture_unit);
+
+	glUseProgram(this->prior_program);
+	this->prior_backface_culling ? glEnable(GL_CULL_FACE) : glDisable(GL_CULL_FACE);
+	this->prior_blend_enabled ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+	this->prior_texture_enabled ? glEnable(GL_TEXTURE_2D) : glDisable(GL_TEXTURE_2D);
+
+	if (this->prior_saved_depth) {
+		glDepthFunc(this->prior_depth_func);
+		glDepthMask(this->prior_depth_mask);
+		this->prior_depth_test ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+	}
+}
+
+void VR_Draw::BufferBackend::release_buffers()
+{
+	if (!this->buffers.empty()) {
+		glDeleteBuffers((GLsizei)this->buffers.size(), &this->buffers[0]);
+		this->buffers.clear();
+	}
+	if (this->vertex_array) {
+		glDeleteVertexArrays(1, &this->vertex_array);
+		this->vertex_array = 0;
+	}
+}
+
+
+/***************************************************************************************************
+ * \class                                  VR_Draw::BatchBackend
+ ***************************************************************************************************
+ * OpenGL backend of the UI batch.
+ **************************************************************************************************/
+VR_Draw::BatchBackend::BatchBackend()
+	: BufferBackend(sizeof(VR_Draw_Batch::Vertex)), created(false), valid(false),
+	buffer(0), mapped(0), segment(0), base(0)
+{
+	for (uint i = 0; i < segments; ++i) {
+		fences[i] = 0;
+	}
+}
+
+VR_Draw::BatchBackend::~BatchBackend()
+{
+	this->release();
+}
+
+const char* const VR_Draw::BatchBackend::shader_vsource(STRING(#version 120\n
+	attribute vec3 position;
+	attribute vec2 uv;
+	attribute vec4 vcolor;
+	attribute float vtex;
+	varying vec2 texcoord;
+	varying vec4 color;
+	varying float tex_weight;
+	uniform mat4 projection;
+void main()
+{
+	gl_Position = projection * vec4(position, 1.0); /* position is already in eye-space */
+	texcoord = uv;
+	color = vcolor;
+	tex_weight = vtex;
+}
+));
+
+const char* const VR_Draw::BatchBackend::shader_fsource(STRING(#version 120\n
+	varying vec2 texcoord;
+	varying vec4 color;
+	varying float tex_weight;
+	uniform sampler2D tex;
+void main()
+{
+	gl_FragColor = mix(vec4(1.0), texture2D(tex, texcoord), tex_weight) * color;
+}
+));
+
+bool VR_Draw::BatchBackend::create()
+{
+	if (this->created) {
+		return this->valid;
+	}
+	this->created = true;
+
+	if (this->shader.create(shader_vsource, shader_fsource, true) != 0) {
+		this->shader.release();
+		return false;
+	}
+	const Attribute attributes[] = {
+		{ this->shader.position_location, 3, offsetof(VR_Draw_Batch::Vertex, pos) },
+		{ this->shader.uv_location, 2, offsetof(VR_Draw_Batch::Vertex, uv) },
+		{ glGetAttribLocation(this->shader.program, "vcolor"), 4, offsetof(VR_Draw_Batch::Vertex, color) },
+		{ glGetAttribLocation(this->shader.program, "vtex"), 1, offsetof(VR_Draw_Batch::Vertex, tex) }
+	};
+	this->set_layout(attributes, 4);
+
+	this->buffer = this->create_buffer();
+	if (GLEW_ARB_buffer_storage) {
+		GLint prior_array_buffer;
+		glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &prior_array_buffer);
+		const GLsizeiptr size = segments * segment_verts * sizeof(VR_Draw_Batch::Vertex);
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+		glBufferStorage(GL_ARRAY_BUFFER, size, 0, flags);
+		this->mapped = (VR_Draw_Batch::Vertex*)glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+		glBindBuffer(GL_ARRAY_BUFFER, prior_array_buffer);
+	}
+	if (!this->mapped) {
+		/* No persistent mapping: re-specify the (mutable) buffer on each upload instead. */
+		if (GLEW_ARB_buffer_storage) {
+			this->delete_buffer(this->buffer);
+			this->buffer = this->create_buffer();
+		}
+		this->allocate_buffer(this->buffer, segments * segment_verts, USAGE_STREAM);
+	}
+
+	this->valid = true;
+	return true;
+}
+
+void VR_Draw::BatchBackend::release()
+{
+	for (uint i = 0; i < segments; ++i) {
+		if (this->fences[i]) {
+			glDeleteSync(this->fences[i]);
+			this->fences[i] = 0;
+		}
+	}
+	if (this->mapped) {
+		GLint prior_array_buffer;
+		glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &prior_array_buffer);
+		glBindBuffer(GL_ARRAY_BUFFER, this->buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, prior_array_buffer);
+		this->mapped = 0;
+	}
+	this->release_buffers();
+	this->buffer = 0;
+	this->shader.release();
+	this->created = this->valid = false;
+}
+
+bool VR_Draw::BatchBackend::begin(const VR_Draw_Batch::Vertex *verts, uint num_verts, const float projection[4][4])
+{
+	if (!this->create() || num_verts > segment_verts) {
+		return false;
+	}
+
+	/* Save previous OpenGL state (once for the whole batch). */
+	this->save_state(true);
+
+	/* Upload the vertices. */
+	if (this->mapped) {
+		this->segment = (this->segment + 1) % segments;
+		GLsync& fence = this->fences[this->segment];
+		if (fence) {
+			/* Only blocks if the GPU is still reading the segment (i.e. more than two batches behind). */
+			GLenum ret = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			while (ret == GL_TIMEOUT_EXPIRED) {
+				ret = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			}
+			glDeleteSync(fence);
+			fence = 0;
+		}
+		this->base = this->segment * segment_verts;
+		memcpy(this->mapped + this->base, verts, num_verts * sizeof(VR_Draw_Batch::Vertex));
+	}
+	else {
+		/* Orphan the previous storage so the driver does not have to synchronize. */
+		this->allocate_buffer(this->buffer, segments * segment_verts, USAGE_STREAM);
+		this->update_buffer(this->buffer, 0, verts, num_verts);
+		this->base = 0;
+	}
+
+	this->set_ui_state();
+
+	glUseProgram(this->shader.program);
+	glUniform1i(this->shader.sampler_location, 0);
+	glUniformMatrix4fv(this->shader.projection_location, 1, false, (float*)projection);
+	this->bind_buffer(this->buffer);
+
+	return true;
+}
+
+void VR_Draw::BatchBackend::set_depth(const VR_Draw_Batch::DepthState& depth)
+{
+	depth.test ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+	glDepthFunc(depth.func);
+	glDepthMask(depth.write ? GL_TRUE : GL_FALSE);
+}
+
+void VR_Draw::BatchBackend::set_texture(const void *texture)
+{
+	((Texture*)texture)->bind();
+}
+
+void VR_Draw::BatchBackend::draw(VR_Draw_Batch::Primitive prim, uint first, uint count)
+{
+	glDrawArrays((prim == VR_Draw_Batch::PRIMITIVE_LINES) ? GL_LINES : GL_TRIANGLES, this->base + first, count);
+}
+
+void VR_Draw::BatchBackend::end()
+{
+	if (this->mapped) {
+		this->fences[this->segment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	/* Restore previous OpenGL state */
+	this->restore_state();
+}
+
+
+/***************************************************************************************************
+ * \class                                  VR_Draw::ListBackend
+ ***************************************************************************************************
+ * OpenGL backend of the display lists.
+ **************************************************************************************************/
+VR_Draw::ListBackend::ListBackend()
+	: BufferBackend(sizeof(VR_Draw_List::Vertex)), created(false), valid(false)
+{
+	//
+}
+
+VR_Draw::ListBackend::~ListBackend()
+{
+	this->release();
+}
+
+const char* const VR_Draw::ListBackend::shader_vsource(STRING(#version 120\n
+	attribute vec3 position;
+	attribute vec2 uv;
+	attribute vec4 normal;
+	attribute vec4 vcolor;
+	attribute float vtex;
+	varying vec2 texcoord;
+	varying vec4 color;
+	varying float tex_weight;
+	uniform mat4 modelview;
+	uniform mat4 projection;
+	uniform mat4 normal_matrix; /* normal_matrix = transpose(inverse(modelview)) */
+void main()
+{
+	gl_Position = projection * modelview * vec4(position, 1.0);
+	texcoord = uv;
+	/* View-angle shading of textured vertices (see VR_Draw_Batch::view_angle_shade()). */
+	vec4 n = normal_matrix * normal;
+	float shade = clamp(n.z / length(n), 0.1, 1.0);
+	color = vec4(vcolor.rgb * mix(1.0, shade, vtex), vcolor.a);
+	tex_weight = vtex;
+}
+));
+
+const char* const VR_Draw::ListBackend::shader_fsource(STRING(#version 120\n
+	varying vec2 texcoord;
+	varying vec4 color;
+	varying float tex_weight;
+	uniform sampler2D tex;
+void main()
+{
+	gl_FragColor = mix(vec4(1.0), texture2D(tex, texcoord), tex_weight) * color;
+}
+));
+
+bool VR_Draw::ListBackend::create()
+{
+	if (this->created) {
+		return this->valid;
+	}
+	this->created = true;
+
+	if (this->shader.create(shader_vsource, shader_fsource, true) != 0) {
+		this->shader.release();
+		return false;
+	}
+	const Attribute attributes[] = {
+		{ this->shader.position_location, 3, offsetof(VR_Draw_List::Vertex, pos) },
+		{ this->shader.uv_location, 2, offsetof(VR_Draw_List::Vertex, uv) },
+		{ this->shader.normal_location, 4, offsetof(VR_Draw_List::Vertex, normal) },
+		{ glGetAttribLocation(this->shader.program, "vcolor"), 4, offsetof(VR_Draw_List::Vertex, color) },
+		{ glGetAttribLocation(this->shader.program, "vtex"), 1, offsetof(VR_Draw_List::Vertex, tex) }
+	};
+	this->set_layout(attributes, 5);
+
+	this->valid = true;
+	return true;
+}
+
+void VR_Draw::ListBackend::release()
+{
+	this->release_buffers();
+	this->shader.release();
+	this->created = this->valid = false;
+}
+
+bool VR_Draw::ListBackend::upload(uint& buffer, const VR_Draw_List::Vertex *verts, uint num_verts)
+{
+	if (!this->create()) {
+		return false;
+	}
+
+	if (!buffer) {
+		buffer = this->create_buffer();
+		if (!buffer) {
+			return false;
+		}
+	}
+	this->allocate_buffer(buffer, num_verts, USAGE_STATIC, verts);
+
+	return true;
+}
+
+bool VR_Draw::ListBackend::begin(uint buffer, const float modelview[4][4], const float modelview_inv[4][4], const float projection[4][4])
+{
+	if (!this->create() || !buffer) {
+		return false;
+	}
+
+	/* Save previous OpenGL state (the depth state is used as it is). */
+	this->save_state(false);
+	this->set_ui_state();
+
+	glUseProgram(this->shader.program);
+	glUniform1i(this->shader.sampler_location, 0);
+	glUniformMatrix4fv(this->shader.modelview_location, 1, false, (float*)modelview);
+	glUniformMatrix4fv(this->shader.projection_location, 1, false, (float*)projection);
+	glUniformMatrix4fv(this->shader.normal_matrix_location, 1, true, (float*)modelview_inv);
+
+	/* Point the shared vertex array at the list's buffer. */
+	this->bind_buffer(buffer);
+
+	return true;
+}
+
+void VR_Draw::ListBackend::set_texture(const void *texture)
+{
+	((Texture*)texture)->bind();
+}
+
+void VR_Draw::ListBackend::draw(uint first, uint count)
+{
+	glDrawArrays(GL_TRIANGLES, first, count);
+}
+
+void VR_Draw::ListBackend::end()
+{
+	/* Restore previous OpenGL state */
+	this->restore_state();
+}
+
+void VR_Draw::begin_batch()
+{
+	if (!batch || !batch_enabled) {
+		return;
+	}
+	if (batch_level++ > 0) {
+		return;
+	}
+
+	/* The batch starts from the current depth state (set_depth_test() keeps it up to date). */
+	VR_Draw_Batch::DepthState depth;
+	GLint depth_func;
+	glGetIntegerv(GL_DEPTH_FUNC, &depth_func);
+	GLboolean depth_mask;
+	glGetBooleanv(GL_DEPTH_WRITEMASK, &depth_mask);
+	depth.func = (uint)depth_func;
+	depth.test = glIsEnabled(GL_DEPTH_TEST) ? true : false;
+	depth.write = depth_mask ? true : false;
+	batch->set_depth(depth);
+	batch->set_projection(projection_matrix.m);
+}
+
+void VR_Draw::end_batch()
+{
+	if (batch_level <= 0) {
+		return;
+	}
+	if (--batch_level == 0) {
+		batch->flush();
+	}
+}
+
+void VR_Draw::flush_batch()
+{
+	if (batch_level > 0) {
+		batch->flush();
+	}
+}
+
+bool VR_Draw::is_batching()
+{
+	return (batch_level > 0);
+}
+
+const VR_Draw_Batch* VR_Draw::get_batch()
+{
+	return batch;
+}
+
+void VR_Draw::begin_list(VR_Draw_List *list, const Mat44f& t)
+{
+	/* Record in the space of t: with inverse(t) as the view, the modelview of
+	 * m * t is (close enough to) m. */
+	list_view_matrix = view_matrix;
+	view_matrix = t.inverse();
+	list->begin();
+	VR_Draw::list = list;
+}
+
+void VR_Draw::end_list()
+{
+	if (!list) {
+		return;
+	}
+	list->end();
+	list = 0;
+	view_matrix = list_view_matrix;
+}
+
+void VR_Draw::render_list(VR_Draw_List *list, const Mat44f& t)
+{
+	if (!list_backend) {
+		return;
+	}
+	if (list->get_backend() != list_backend) {
+		list->set_backend(list_backend);
+	}
+	/* Keep the order with the primitives batched so far. */
+	flush_batch();
+	update_modelview_matrix(&t, 0);
+	list->draw(modelview_matrix, modelview_matrix_inv, projection_matrix.m);
+}
+
 void VR_Draw::render_rect(float left, float right, float top, float bottom, float z, float u, float v, Texture *tex)
 {
+	/* Texture coordinates (on the atlas page, if the texture is packed). */
+	float u0 = 0.0f, v0 = 0.0f, u1 = u, v1 = v;
+	if (tex) {
+		Texture* target = tex->resolve();
+		tex->map_uv(u0, v0);
+		tex->map_uv(u1, v1);
+		tex = target;
+	}
+
+	if (list) {
+		const float pos[4][3] = { { left, bottom, z }, { right, bottom, z }, { left, top, z }, { right, top, z } };
+		if (tex) {
+			const float uvs[4][2] = { { u0, v1 }, { u1, v1 }, { u0, v0 }, { u1, v0 } };
+			list->add_quad(modelview_matrix, modelview_matrix_inv, pos, color_vector, tex, uvs);
+		}
+		else {
+			list->add_quad(modelview_matrix, modelview_matrix_inv, pos, color_vector);
+		}
+		return;
+	}
+
+	if (batch_level > 0) {
+		const float pos[4][3] = { { left, bottom, z }, { right, bottom, z }, { left, top, z }, { right, top, z } };
+		if (tex) {
+			const float uvs[4][2] = { { u0, v1 }, { u1, v1 }, { u0, v0 }, { u1, v0 } };
+			batch->add_quad(modelview_matrix, pos, color_vector, tex, uvs, VR_Draw_Batch::view_angle_shade(modelview_matrix_inv));
+		}
+		else {
+			batch->add_quad(modelview_matrix, pos, color_vector);
+		}
+		return;
+	}
+
 	/* Save previous OpenGL state */
 	GLint prior_program;
 	glGetIntegerv(GL_CURRENT_PROGRAM, &prior_program);
@@ -1642,10 +2470,10 @@ void VR_Draw::render_rect(float left, float right, float top, float bottom, floa
 
 		/* Create uv buffer */
 		static GLfloat uv_data[4][2];
-		uv_data[0][0] = 0.0f; uv_data[0][1] = v;
-		uv_data[1][0] = u;    uv_data[1][1] = v;
-		uv_data[2][0] = 0.0f; uv_data[2][1] = 0.0f;
-		uv_data[3][0] = u;    uv_data[3][1] = 0.0f;
+		uv_data[0][0] = u0; uv_data[0][1] = v1;
+		uv_data[1][0] = u1; uv_data[1][1] = v1;
+		uv_data[2][0] = u0; uv_data[2][1] = v0;
+		uv_data[3][0] = u1; uv_data[3][1] = v0;
 
 		if (!uvs) {
 			glGenBuffers(1, &uvs);
@@ -1682,6 +2510,22 @@ void VR_Draw::render_rect(float left, float right, float top, float bottom, floa
 
 void VR_Draw::render_frame(float left, float right, float top, float bottom, float b, float z)
 {
+	if (list || batch_level > 0) {
+		const float pos[10][3] = {
+			{ left - b, top + b, z }, { left, top, z },
+			{ right + b, top + b, z }, { right, top, z },
+			{ right + b, bottom - b, z }, { right, bottom, z },
+			{ left - b, bottom - b, z }, { left, bottom, z },
+			{ left - b, top + b, z }, { left, top, z } };
+		if (list) {
+			list->add_strip(modelview_matrix, pos, 10, color_vector);
+		}
+		else {
+			batch->add_strip(modelview_matrix, pos, 10, color_vector);
+		}
+		return;
+	}
+
 	/* Save previous OpenGL state */
 	GLint prior_program;
 	glGetIntegerv(GL_CURRENT_PROGRAM, &prior_program);
@@ -1753,6 +2597,25 @@ void VR_Draw::render_frame(float left, float right, float top, float bottom, flo
 
 void VR_Draw::render_box(const Coord3Df& p0, const Coord3Df& p1, bool outline)
 {
+	if (batch_level > 0) {
+		/* Like the immediate path, leave depth writing disabled. */
+		glDepthMask(GL_FALSE);
+		VR_Draw_Batch::DepthState depth = batch->get_depth();
+		depth.write = false;
+		batch->set_depth(depth);
+		if (!outline) {
+			const float pos[14][3] = {
+				{ p0.x, p0.y, p0.z }, { p0.x, p0.y, p1.z }, { p0.x, p1.y, p0.z }, { p0.x, p1.y, p1.z },
+				{ p1.x, p1.y, p1.z }, { p0.x, p0.y, p1.z }, { p1.x, p0.y, p1.z }, { p0.x, p0.y, p0.z },
+				{ p1.x, p0.y, p0.z }, { p0.x, p1.y, p0.z }, { p1.x, p1.y, p0.z }, { p1.x, p1.y, p1.z },
+				{ p1.x, p0.y, p0.z }, { p1.x, p0.y, p1.z } };
+			batch->add_strip(modelview_matrix, pos, 14, color_vector);
+			return;
+		}
+		/* The stippled outline is drawn immediately. */
+		batch->flush();
+	}
+
 	/* Save previous OpenGL state */
 	GLint prior_program;
 	glGetIntegerv(GL_CURRENT_PROGRAM, &prior_program);
@@ -1874,6 +2737,9 @@ void VR_Draw::render_box(const Coord3Df& p0, const Coord3Df& p1, bool outline)
 
 void VR_Draw::render_ball(float r, bool golf)
 {
+	/* Draw pending UI primitives first to keep the drawing order. */
+	VR_Draw::flush_batch();
+
 	/* Save previous OpenGL state */
 	GLint prior_program;
 	glGetIntegerv(GL_CURRENT_PROGRAM, &prior_program);
@@ -1971,6 +2837,9 @@ void VR_Draw::render_ball(float r, bool golf)
 
 void VR_Draw::render_arrow(const Coord3Df& from, const Coord3Df& to, float width)
 {
+	/* Draw pending UI primitives first to keep the drawing order. */
+	VR_Draw::flush_batch();
+
 	/* Save previous OpenGL state */
 	GLint prior_program;
 	glGetIntegerv(GL_CURRENT_PROGRAM, &prior_program);
@@ -2039,6 +2908,37 @@ void VR_Draw::render_arrow(const Coord3Df& from, const Coord3Df& to, float width
 	prior_texture_enabled ? glEnable(GL_TEXTURE_2D) : glDisable(GL_TEXTURE_2D);
 }
 
+/* Advance to the next printable character of a string (skipping line breaks and tabs).
+ * x / y are updated to the top-left corner of the character, col / row to its cell in the 14x7 ascii texture.
+ * Returns false at the end of the string. */
+static bool string_next_glyph(const char* str, int& i, float w, float h, float x_offset, float& x, float& y, int& col, int& row)
+{
+	while (str[i]) {
+		int index = int(str[i]);
+		if (index == '\n') {
+			y -= h * 1.2f;
+			x = x_offset;
+			++i;
+			continue;
+		}
+		if (index == '\t') {
+			x += w * 4.0f;
+			++i;
+			continue;
+		}
+		index -= 32; /* based of first printable ascii character */
+		if (index < 0 || index>94) { /* invalid character: skip */
+			++i;
+			continue;
+		}
+		col = index % 14; /* row in 14x7 grid */
+		row = (index - col) / 14; /* col in 14x7 grid */
+		++i;
+		return true;
+	}
+	return false;
+}
+
 void VR_Draw::render_string(const char* str, float w, float h, VR_HAlign h_align, VR_VAlign v_align, float x_offset, float y_offset, float z_offset)
 {
 	/* 1: If not done yet: allocate image texture. */
@@ -2046,35 +2946,7 @@ void VR_Draw::render_string(const char* str, float w, float h, VR_HAlign h_align
 		ascii_tex = new Texture(ascii_png);
 	}
 
-	/* 2: Save previous OpenGL state. */
-	GLint prior_program;
-	glGetIntegerv(GL_CURRENT_PROGRAM, &prior_program);
-	GLboolean prior_backface_culling = glIsEnabled(GL_CULL_FACE);
-	GLboolean prior_blend_enabled = glIsEnabled(GL_BLEND);
-	GLboolean prior_depth_test = glIsEnabled(GL_DEPTH_TEST);
-	GLboolean prior_texture_enabled = glIsEnabled(GL_TEXTURE_2D);
-
-	glDisable(GL_CULL_FACE);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	glEnable(GL_TEXTURE_2D);
-
-	glUseProgram(VR_Draw::Shader::texture_shader());
-	GLint prior_vertex_array_binding;
-	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prior_vertex_array_binding);
-	GLint prior_array_buffer;
-	glGetIntegerv(GL_ARRAY_BUFFER, &prior_array_buffer);
-	GLint prior_texture_binding_2d;
-	glGetIntegerv(GL_TEXTURE_BINDING_2D, &prior_texture_binding_2d);
-	GLint prior_texture_unit;
-	glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&prior_texture_unit);
-
-	glActiveTexture(GL_TEXTURE0);
-
-	/* Bind the texture (and create the texture implementation if necessary). */
-	ascii_tex->bind();
-
-	/* 3: Walk over all characters and render them. */
+	/* 2: Measure the string. */
 	int i;
 	float full_height = h;
 	float full_width = 0.0f;
@@ -2117,6 +2989,60 @@ void VR_Draw::render_string(const char* str, float w, float h, VR_HAlign h_align
 
 	float x = x_offset;
 	float y = y_offset;
+	int col, row;
+	float u0, v0, u1, v1;
+
+	/* The ascii texture may be packed into the atlas. */
+	Texture* tex = ascii_tex->resolve();
+
+	if (list || batch_level > 0) {
+		const float shade = list ? 1.0f : VR_Draw_Batch::view_angle_shade(modelview_matrix_inv);
+		i = 0;
+		while (string_next_glyph(str, i, w, h, x_offset, x, y, col, row)) {
+			u0 = float(col + 0) / 14.0f; v0 = float(row + 0) / 7.0f;
+			u1 = float(col + 1) / 14.0f; v1 = float(row + 1) / 7.0f;
+			ascii_tex->map_uv(u0, v0);
+			ascii_tex->map_uv(u1, v1);
+			const float pos[4][3] = { { x, y - h, z_offset }, { x + w, y - h, z_offset }, { x, y, z_offset }, { x + w, y, z_offset } };
+			const float uvs[4][2] = { { u0, v1 }, { u1, v1 }, { u0, v0 }, { u1, v0 } };
+			if (list) {
+				list->add_quad(modelview_matrix, modelview_matrix_inv, pos, color_vector, tex, uvs);
+			}
+			else {
+				batch->add_quad(modelview_matrix, pos, color_vector, tex, uvs, shade);
+			}
+			x += w;
+		}
+		return;
+	}
+
+	/* 3: Save previous OpenGL state. */
+	GLint prior_program;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &prior_program);
+	GLboolean prior_backface_culling = glIsEnabled(GL_CULL_FACE);
+	GLboolean prior_blend_enabled = glIsEnabled(GL_BLEND);
+	GLboolean prior_depth_test = glIsEnabled(GL_DEPTH_TEST);
+	GLboolean prior_texture_enabled = glIsEnabled(GL_TEXTURE_2D);
+
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glEnable(GL_TEXTURE_2D);
+
+	glUseProgram(VR_Draw::Shader::texture_shader());
+	GLint prior_vertex_array_binding;
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &prior_vertex_array_binding);
+	GLint prior_array_buffer;
+	glGetIntegerv(GL_ARRAY_BUFFER, &prior_array_buffer);
+	GLint prior_texture_binding_2d;
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &prior_texture_binding_2d);
+	GLint prior_texture_unit;
+	glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&prior_texture_unit);
+
+	glActiveTexture(GL_TEXTURE0);
+
+	/* Bind the texture (and create the texture implementation if necessary). */
+	tex->bind();
 
 	/* Load uniforms */
 	glUniformMatrix4fv(VR_Draw::Shader::shader_tex.modelview_location, 1, false, (float*)VR_Draw::modelview_matrix.m);
@@ -2150,28 +3076,9 @@ void VR_Draw::render_string(const char* str, float w, float h, VR_HAlign h_align
 	glVertexAttribPointer(VR_Draw::Shader::shader_tex.normal_location, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
 	glEnableVertexAttribArray(VR_Draw::Shader::shader_tex.normal_location);
 
+	/* 4: Walk over all characters and render them. */
 	i = 0;
-	while (str[i]) {
-		int index = int(str[i]);
-		if (index == '\n') {
-			y -= h * 1.2f;
-			x = x_offset;
-			++i;
-			continue;
-		}
-		if (index == '\t') {
-			x += w * 4.0f;
-			++i;
-			continue;
-		}
-		index -= 32; /* based of first printable ascii character */
-		if (index < 0 || index>94) { /* invalid character: skip */
-			++i;
-			continue;
-		}
-		int col = index % 14; /* row in 14x7 grid */
-		int row = (index - col) / 14; /* col in 14x7 grid */
-
+	while (string_next_glyph(str, i, w, h, x_offset, x, y, col, row)) {
 		/* Create vertex buffer */
 		static GLfloat vertex_data[4][3];
 		vertex_data[0][0] = x;     vertex_data[0][1] = y - h; vertex_data[0][2] = z_offset; /* bottom-left */
@@ -2189,11 +3096,15 @@ void VR_Draw::render_string(const char* str, float w, float h, VR_HAlign h_align
 		glEnableVertexAttribArray(VR_Draw::Shader::shader_tex.position_location);
 
 		/* Create uv buffers */
+		u0 = float(col + 0) / 14.0f; v0 = float(row + 0) / 7.0f;
+		u1 = float(col + 1) / 14.0f; v1 = float(row + 1) / 7.0f;
+		ascii_tex->map_uv(u0, v0);
+		ascii_tex->map_uv(u1, v1);
 		static GLfloat uv_data[4][2];
-		uv_data[0][0] = float(col + 0) / 14.0f; uv_data[0][1] = float(row + 1) / 7.0f;
-		uv_data[1][0] = float(col + 1) / 14.0f; uv_data[1][1] = float(row + 1) / 7.0f;
-		uv_data[2][0] = float(col + 0) / 14.0f, uv_data[2][1] = float(row + 0) / 7.0f;
-		uv_data[3][0] = float(col + 1) / 14.0f; uv_data[3][1] = float(row + 0) / 7.0f;
+		uv_data[0][0] = u0; uv_data[0][1] = v1;
+		uv_data[1][0] = u1; uv_data[1][1] = v1;
+		uv_data[2][0] = u0; uv_data[2][1] = v0;
+		uv_data[3][0] = u1; uv_data[3][1] = v0;
 
 		static GLuint uvs = 0;
 		if (!uvs) {
@@ -2206,7 +3117,6 @@ void VR_Draw::render_string(const char* str, float w, float h, VR_HAlign h_align
 
 		glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
 
-		++i;
 		x += w;
 	}
 
@@ -2214,7 +3124,7 @@ void VR_Draw::render_string(const char* str, float w, float h, VR_HAlign h_align
 	glDisableVertexAttribArray(VR_Draw::Shader::shader_tex.normal_location);
 	glDisableVertexAttribArray(VR_Draw::Shader::shader_tex.uv_location);
 
-	/* 4: Restore previous OpenGL state */
+	/* 5: Restore previous OpenGL state */
 	glBindVertexArray(prior_vertex_array_binding);
 	glBindBuffer(GL_ARRAY_BUFFER, prior_array_buffer);
 	glBindTexture(GL_TEXTURE_2D, prior_texture_binding_2d);
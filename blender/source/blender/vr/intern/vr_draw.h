@@ -30,6 +30,11 @@
 #ifndef __VR_DRAW_H__
 #define __VR_DRAW_H__
 
+#include <vector>
+
+class VR_Draw_Batch;
+class VR_Draw_List;
+
 class VR_Draw
 {
 	VR_Draw();	/* Constructor. */
@@ -100,6 +105,7 @@ protected:
 			uint	height; /* Height of the texture in pixels. */
 			uint	depth;  /* Depth of the texture in bytes per pixel. */
 			TextureImplementation(const uchar* png_blob);	/* Create texture from PNG blob in memory. */
+			TextureImplementation(const uchar* rgba, uint w, uint h);	/* Create texture from RGBA pixels in memory. */
 			virtual ~TextureImplementation();	/* Destructor. */
 			virtual void bind();	/* Bind the texture instance for rendering. */
 			virtual void unbind();	/* Unbind last bound texture from the context. */
@@ -109,8 +115,15 @@ protected:
 		
 		TextureImplementation* implementation;	/* API dependent instance of this texture. */
 		bool create_implementation();	/* Internal helper function to generate the implementation object. */
+
+		bool		atlas;	/* Whether the texture is packed into the UI atlas (see VR_Draw::resolve_atlas()). */
+		Texture*	atlas_next;	/* Next texture packed into the UI atlas. */
+		Texture*	atlas_page;	/* Atlas page containing the texture (once the atlas has been resolved). */
+		float		atlas_uv[4];	/* Texture coordinates of the texture on its atlas page (u0, v0, u1, v1). */
+		uint		atlas_size[2];	/* Size of the texture (in pixels) when packed into the atlas. */
 	public:
-		Texture(const uchar* png_blob);	/* Create/get texture from PNG format block in memory. */
+		Texture(const uchar* png_blob, bool atlas = false);	/* Create/get texture from PNG format block in memory (optionally packed into the UI atlas). */
+		Texture(TextureImplementation* implementation);	/* Create texture from an implementation (taking ownership). */
 		Texture(const Texture& cpy);	/* Copy constructor. */
 		~Texture();	/* Destructor. */
 
@@ -121,8 +134,18 @@ protected:
 
 		void bind();	/* Bind the texture for rendering. */
 		void unbind();	/* Unbind currently bound texture. */
+
+		Texture* resolve();	/* Texture that is bound for this texture (its atlas page if packed, else this texture). */
+		void map_uv(float& u, float& v) const;	/* Map texture coordinates to the texture returned by resolve(). */
+
 	};
 
+	static Texture	*atlas_members;	/* Textures to pack into the UI atlas (linked by atlas_next). */
+	static Texture	**atlas_pages;	/* UI atlas pages. */
+	static uint		num_atlas_pages;	/* Number of UI atlas pages. */
+	static bool		atlas_resolved;	/* Whether resolve_atlas() has been called. */
+	static bool		resolve_atlas();	/* Load (or build and cache) the UI atlas and assign its pages to the member textures. */
+
 	/* 3D Model (vertex buffer) object. */
 	typedef struct Model {
 	private:
@@ -140,7 +163,80 @@ protected:
 		virtual int render();	/* Render the model. */
 		virtual int render(const Mat44f& pos);	/* Render the model at the given position. */
 	} Model;
+
+	class BatchBackend;	/* OpenGL backend of the UI batch (persistent mapped vertex buffer). */
+	static VR_Draw_Batch	*batch;	/* Batch collecting the UI primitives (if any). */
+	static BatchBackend	*batch_backend;	/* OpenGL backend of the UI batch. */
+	static int	batch_level;	/* Number of nested begin_batch() calls. */
+
+	class ListBackend;	/* OpenGL backend of the retained display lists. */
+	static ListBackend	*list_backend;	/* OpenGL backend of the display lists. */
+	static VR_Draw_List	*list;	/* Display list being recorded (if any). */
+	static Mat44f	list_view_matrix;	/* View matrix saved by begin_list(). */
 public:
+	/* Shared OpenGL part of the backends of retained geometry (UI batch, display lists, annotation
+	 * strokes): vertex buffers, the vertex array pointing into them, and the OpenGL state saved
+	 * around drawing. The backends add their shaders and draw calls. */
+	class BufferBackend
+	{
+	public:
+		/* Vertex attribute (float components). */
+		typedef struct Attribute {
+			int	location;	/* Shader attribute location (skipped if negative). */
+			uint	size;	/* Number of components. */
+			uint	offset;	/* Offset in the vertex (bytes). */
+		} Attribute;
+
+		/* Expected use of the contents of a buffer. */
+		typedef enum Usage {
+			USAGE_STATIC	/* Specified once, drawn many times. */
+			,
+			USAGE_DYNAMIC	/* Updated in parts, drawn many times. */
+			,
+			USAGE_STREAM	/* Specified again for each draw. */
+		} Usage;
+
+		static const uint max_attributes = 8;	/* Maximum number of vertex attributes. */
+
+		BufferBackend(uint stride);	/* Constructor (stride: size of a vertex in bytes). */
+		virtual ~BufferBackend();	/* Destructor. */
+
+		void set_layout(const Attribute *attributes, uint num_attributes);	/* Set the vertex attributes (applied by bind_buffer()). */
+
+		uint create_buffer();	/* Create a vertex buffer, owned by the backend (0 on failure). */
+		void delete_buffer(uint buffer);	/* Delete a buffer created by create_buffer(). */
+		void allocate_buffer(uint buffer, uint num_verts, Usage usage, const void *verts = 0);	/* (Re)specify the storage of a buffer, optionally with its contents. */
+		void update_buffer(uint buffer, uint first, const void *verts, uint num_verts);	/* Upload vertices into the storage of a buffer. */
+		uint grow_buffer(uint buffer, uint num_verts, uint num_keep);	/* Replace a buffer (if any) by a new one for num_verts vertices, copying its first num_keep vertices on the GPU. Returns the new buffer (0 on failure, the old one is kept). */
+		bool bind_buffer(uint buffer);	/* Bind the vertex array, with the attributes pointing into a buffer. */
+
+		void save_state(bool depth);	/* Save the OpenGL state changed by drawing (including the depth state if depth is set). */
+		void set_ui_state();	/* Set up alpha blending, no culling and texture unit 0 (the state of the UI shaders). */
+		void restore_state();	/* Restore the state saved by save_state(). */
+
+		void release_buffers();	/* Release the vertex array and all buffers. */
+	protected:
+		uint	stride;	/* Size of a vertex (bytes). */
+		Attribute	attributes[max_attributes];	/* Vertex attributes. */
+		uint	num_attributes;	/* Number of vertex attributes. */
+		uint	vertex_array;	/* Vertex array (0: not created). */
+		std::vector<uint>	buffers;	/* Buffers created by create_buffer(). */
+
+		/* OpenGL state saved by save_state(). */
+		bool	prior_saved_depth;
+		int		prior_program;
+		int		prior_vertex_array_binding;
+		int		prior_array_buffer;
+		int		prior_texture_binding_2d;
+		int		prior_texture_unit;
+		int		prior_depth_func;
+		uchar	prior_depth_mask;
+		uchar	prior_backface_culling;
+		uchar	prior_blend_enabled;
+		uchar	prior_depth_test;
+		uchar	prior_texture_enabled;
+	};
+
 	/* Controller models / textures. */
 	static Model *controller_model[VR_SIDES]; /* Controller models (left and right). */
 	static Texture *controller_tex;	/* Textures for the controller. */
@@ -275,6 +371,17 @@ public:
 	static void set_blend(bool on_off);	/* Enable/disable alpha blending. */
 	static void set_depth_test(bool on_off, bool write_depth);	/* Enable / disable depth testing. */
 	
+	static bool batch_enabled;	/* Whether UI primitives may be batched (see begin_batch()). */
+	static void begin_batch();	/* Start collecting rects, frames, boxes and strings into a batch instead of drawing them immediately. */
+	static void end_batch();	/* Draw the collected primitives and stop batching. */
+	static void flush_batch();	/* Draw the collected primitives (if any), e.g. before drawing with the OpenGL API directly. */
+	static bool is_batching();	/* Whether a batch is open. */
+	static const VR_Draw_Batch* get_batch();	/* Get the batch (for its draw call / state change counters). */
+
+	static void begin_list(VR_Draw_List *list, const Mat44f& t);	/* Start recording rects, frames and strings into a display list (in the space of t) instead of drawing them. */
+	static void end_list();	/* Stop recording into the display list. */
+	static void render_list(VR_Draw_List *list, const Mat44f& t);	/* Replay a display list at t with the current view and projection. */
+
 	static void render_rect(float left, float right, float top, float bottom, float z, float u=1.0f, float v=1.0f, Texture* tex=0);	/* Render a rectangle with currently set transformation. */
 	static void render_frame(float left, float right, float top, float bottom, float b, float z = 0);	/* Render a flat frame. */
 	static void render_box(const Coord3Df& p0, const Coord3Df& p1, bool outline=false);	/* Render an axis-aligned box. */
@@ -0,0 +1,352 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_draw_atlas.cpp
+*   \ingroup vr
+*
+* Texture atlas for the VR UI icons, menus and font.
+*/
+
+#include "vr_types.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vr_draw_atlas.h"
+
+#include "png.h"
+
+#define VR_ATLAS_CACHE_MAGIC	0x54415256	/* "VRAT" */
+#define VR_ATLAS_CACHE_VERSION	1
+
+/***************************************************************************************************
+ * \class                                  VR_Draw_Atlas
+ ***************************************************************************************************
+ * Texture atlas for the VR UI icons, menus and font.
+ **************************************************************************************************/
+VR_Draw_Atlas::VR_Draw_Atlas()
+	: key(0)
+{
+	//
+}
+
+static void Util_Image_decodePNGRGBA_readData(png_structp png_ptr, png_bytep data, png_uint_32 length)
+{
+	uchar** b = (uchar**)png_get_io_ptr(png_ptr);
+	std::memcpy(data, *b, length);
+	*b += length;
+}
+
+bool VR_Draw_Atlas::decode_png(const uchar* png_data, uchar*& img, uint& w, uint& h)
+{
+	png_structp png_ptr;
+	png_infop info_ptr;
+	uint sig_read = 0;
+	png_uint_32 width, height;
+	int bit_depth, color_type, interlace_type;
+
+	png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+	if (png_ptr == NULL) {
+		return false;
+	}
+
+	info_ptr = png_create_info_struct(png_ptr);
+	if (info_ptr == NULL) {
+		png_destroy_read_struct(&png_ptr, 0, 0);
+		return false;
+	}
+
+	png_set_read_fn(png_ptr, &png_data, (png_rw_ptr)Util_Image_decodePNGRGBA_readData);
+	png_read_info(png_ptr, info_ptr);
+	png_get_IHDR(png_ptr, info_ptr, &width, &height, &bit_depth, &color_type, &interlace_type, NULL, NULL);
+
+	w = width;
+	h = height;
+
+	img = (uchar*)malloc(sizeof(uchar)*w*h * 4);
+
+	png_set_sig_bytes(png_ptr, sig_read);
+	png_set_strip_16(png_ptr);
+	png_set_packing(png_ptr);
+	png_set_filler(png_ptr, 0xff, PNG_FILLER_AFTER);
+
+	for (uint y = 0; y < height; y++) {
+		png_read_row(png_ptr, img + (y*w * 4), 0);
+	}
+
+	png_read_end(png_ptr, info_ptr);
+	png_destroy_read_struct(&png_ptr, &info_ptr, 0);
+
+	return true;
+}
+
+/* FNV-1a (64 bit). */
+static inline ui64 hash_bytes(ui64 hash, const uchar* data, size_t len)
+{
+	for (size_t i = 0; i < len; ++i) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+ui64 VR_Draw_Atlas::fingerprint(const uchar* const* pngs, uint num_pngs)
+{
+	static const uchar signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+	ui64 hash = 0xcbf29ce484222325ULL;
+	const uint version = VR_ATLAS_CACHE_VERSION;
+	hash = hash_bytes(hash, (const uchar*)&version, sizeof(version));
+	hash = hash_bytes(hash, (const uchar*)&num_pngs, sizeof(num_pngs));
+	for (uint i = 0; i < num_pngs; ++i) {
+		const uchar* p = pngs[i];
+		if (!p || memcmp(p, signature, 8) != 0) {
+			hash = hash_bytes(hash, signature, 1);
+			continue;
+		}
+		/* Every chunk carries a CRC of its data, so (length, type, CRC) of all chunks
+		 * identifies the image without touching the compressed data. */
+		p += 8;
+		for (;;) {
+			const uint len = ((uint)p[0] << 24) | ((uint)p[1] << 16) | ((uint)p[2] << 8) | (uint)p[3];
+			hash = hash_bytes(hash, p, 8);
+			hash = hash_bytes(hash, p + 8 + len, 4);
+			if (memcmp(p + 4, "IEND", 4) == 0 || len > 0x7fffffff) {
+				break;
+			}
+			p += 12 + len;
+		}
+	}
+	return hash;
+}
+
+bool VR_Draw_Atlas::pack(const uint (*sizes)[2], uint num_images)
+{
+	clear();
+
+	/* Shelf packing, tallest images first. */
+	std::vector<uint> order(num_images);
+	for (uint i = 0; i < num_images; ++i) {
+		if (sizes[i][0] + 2 * padding > page_size || sizes[i][1] + 2 * padding > page_size) {
+			return false;
+		}
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [sizes](uint a, uint b) { return sizes[a][1] > sizes[b][1]; });
+
+	regions.resize(num_images);
+	uint page = 0, x = 0, y = 0, shelf_h = 0;
+	std::vector<uint> page_w(1, 0), page_h(1, 0);
+	for (uint k = 0; k < num_images; ++k) {
+		const uint i = order[k];
+		const uint w = sizes[i][0] + 2 * padding;
+		const uint h = sizes[i][1] + 2 * padding;
+		if (x + w > page_size) {
+			/* Next shelf. */
+			y += shelf_h;
+			x = shelf_h = 0;
+		}
+		if (y + h > page_size) {
+			/* Next page. */
+			++page;
+			x = y = shelf_h = 0;
+			page_w.push_back(0);
+			page_h.push_back(0);
+		}
+		Region& r = regions[i];
+		r.page = page;
+		r.x = x + padding;
+		r.y = y + padding;
+		r.w = sizes[i][0];
+		r.h = sizes[i][1];
+		x += w;
+		shelf_h = std::max(shelf_h, h);
+		page_w[page] = std::max(page_w[page], x);
+		page_h[page] = std::max(page_h[page], y + h);
+	}
+
+	pages.resize(page + 1);
+	for (uint p = 0; p <= page; ++p) {
+		pages[p].w = std::max(page_w[p], 1u);
+		pages[p].h = std::max(page_h[p], 1u);
+		pages[p].pixels.assign(pages[p].w * pages[p].h * 4, 0);
+	}
+	update_uvs();
+
+	return true;
+}
+
+void VR_Draw_Atlas::blit(uint index, const uchar* rgba)
+{
+	const Region& r = regions[index];
+	Page& page = pages[r.page];
+	const uint stride = page.w * 4;
+
+	/* Rows (extended left / right by the edge pixels). */
+	for (uint y = 0; y < r.h; ++y) {
+		uchar* dst = &page.pixels[(r.y + y) * stride + r.x * 4];
+		const uchar* src = rgba + y * r.w * 4;
+		memcpy(dst, src, r.w * 4);
+		for (uint p = 1; p <= padding; ++p) {
+			memcpy(dst - p * 4, src, 4);
+			memcpy(dst + (r.w - 1 + p) * 4, src + (r.w - 1) * 4, 4);
+		}
+	}
+	/* Top / bottom border rows (copies of the first / last padded row). */
+	const uint row_len = (r.w + 2 * padding) * 4;
+	const uchar* first = &page.pixels[r.y * stride + (r.x - padding) * 4];
+	const uchar* last = &page.pixels[(r.y + r.h - 1) * stride + (r.x - padding) * 4];
+	for (uint p = 1; p <= padding; ++p) {
+		memcpy(&page.pixels[(r.y - p) * stride + (r.x - padding) * 4], first, row_len);
+		memcpy(&page.pixels[(r.y + r.h - 1 + p) * stride + (r.x - padding) * 4], last, row_len);
+	}
+}
+
+bool VR_Draw_Atlas::build(const uchar* const* pngs, uint num_pngs)
+{
+	std::vector<uchar*> images(num_pngs, (uchar*)0);
+	std::vector<uint> sizes(num_pngs * 2, 0);
+	bool ok = true;
+	for (uint i = 0; i < num_pngs && ok; ++i) {
+		ok = (pngs[i] && decode_png(pngs[i], images[i], sizes[i * 2], sizes[i * 2 + 1]));
+	}
+	if (ok) {
+		ok = pack((const uint (*)[2])(num_pngs ? &sizes[0] : 0), num_pngs);
+	}
+	for (uint i = 0; i < num_pngs; ++i) {
+		if (ok) {
+			blit(i, images[i]);
+		}
+		if (images[i]) {
+			free(images[i]);
+		}
+	}
+	if (!ok) {
+		clear();
+		return false;
+	}
+	key = fingerprint(pngs, num_pngs);
+	return true;
+}
+
+bool VR_Draw_Atlas::save(const char* path) const
+{
+	FILE* f = fopen(path, "wb");
+	if (!f) {
+		return false;
+	}
+
+	const uint header[4] = { VR_ATLAS_CACHE_MAGIC, VR_ATLAS_CACHE_VERSION, (uint)regions.size(), (uint)pages.size() };
+	bool ok = (fwrite(header, sizeof(header), 1, f) == 1);
+	ok = ok && (fwrite(&key, sizeof(key), 1, f) == 1);
+	for (size_t i = 0; i < regions.size() && ok; ++i) {
+		const Region& r = regions[i];
+		const uint rect[5] = { r.page, r.x, r.y, r.w, r.h };
+		ok = (fwrite(rect, sizeof(rect), 1, f) == 1);
+	}
+	for (size_t i = 0; i < pages.size() && ok; ++i) {
+		const uint size[2] = { pages[i].w, pages[i].h };
+		ok = (fwrite(size, sizeof(size), 1, f) == 1);
+		ok = ok && (fwrite(&pages[i].pixels[0], pages[i].pixels.size(), 1, f) == 1);
+	}
+
+	if (fclose(f) != 0 || !ok) {
+		remove(path);
+		return false;
+	}
+	return true;
+}
+
+bool VR_Draw_Atlas::load(const char* path, ui64 key, uint num_images)
+{
+	clear();
+
+	FILE* f = fopen(path, "rb");
+	if (!f) {
+		return false;
+	}
+
+	uint header[4];
+	ui64 file_key;
+	bool ok = (fread(header, sizeof(header), 1, f) == 1) && (fread(&file_key, sizeof(file_key), 1, f) == 1);
+	ok = ok && header[0] == VR_ATLAS_CACHE_MAGIC && header[1] == VR_ATLAS_CACHE_VERSION &&
+		header[2] == num_images && file_key == key && header[3] >= 1 && header[3] <= 64;
+
+	if (ok) {
+		regions.resize(num_images);
+		for (uint i = 0; i < num_images && ok; ++i) {
+			uint rect[5];
+			ok = (fread(rect, sizeof(rect), 1, f) == 1);
+			Region& r = regions[i];
+			r.page = rect[0]; r.x = rect[1]; r.y = rect[2]; r.w = rect[3]; r.h = rect[4];
+		}
+		pages.resize(header[3]);
+		for (uint i = 0; i < header[3] && ok; ++i) {
+			uint size[2];
+			ok = (fread(size, sizeof(size), 1, f) == 1) && size[0] && size[1] && size[0] <= page_size && size[1] <= page_size;
+			if (ok) {
+				pages[i].w = size[0];
+				pages[i].h = size[1];
+				pages[i].pixels.resize(size[0] * size[1] * 4);
+				ok = (fread(&pages[i].pixels[0], pages[i].pixels.size(), 1, f) == 1);
+			}
+		}
+	}
+	fclose(f);
+
+	/* Validate the regions against the pages. */
+	for (uint i = 0; i < regions.size() && ok; ++i) {
+		const Region& r = regions[i];
+		ok = r.page < pages.size() && r.x + r.w <= pages[r.page].w && r.y + r.h <= pages[r.page].h;
+	}
+	if (!ok) {
+		clear();
+		return false;
+	}
+
+	this->key = key;
+	update_uvs();
+	return true;
+}
+
+void VR_Draw_Atlas::clear()
+{
+	pages.clear();
+	regions.clear();
+	key = 0;
+}
+
+void VR_Draw_Atlas::update_uvs()
+{
+	for (size_t i = 0; i < regions.size(); ++i) {
+		Region& r = regions[i];
+		const Page& page = pages[r.page];
+		r.uv[0] = (float)r.x / (float)page.w;
+		r.uv[1] = (float)r.y / (float)page.h;
+		r.uv[2] = (float)(r.x + r.w) / (float)page.w;
+		r.uv[3] = (float)(r.y + r.h) / (float)page.h;
+	}
+}
@@ -0,0 +1,88 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_draw_atlas.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_DRAW_ATLAS_H__
+#define __VR_DRAW_ATLAS_H__
+
+#include "vr_types.h"
+
+#include <vector>
+
+/* Texture atlas for the VR UI icons, menus and font.
+ * The embedded PNG images are decoded and packed into a few RGBA pages (with a UV table)
+ * the first time they are needed, and the result is cached on disk, so later sessions
+ * load the pages with a single read instead of decoding every PNG.
+ * The cache is keyed by a fingerprint of the PNG data (see fingerprint()).
+ * The atlas itself does not touch the graphics API (see VR_Draw::resolve_atlas()). */
+class VR_Draw_Atlas
+{
+public:
+	static const uint page_size = 2048;	/* Maximum width / height of a page (in pixels). */
+	static const uint padding = 2;	/* Border around each image (filled with its edge pixels, for filtering). */
+
+	/* Location of an image in the atlas. */
+	typedef struct Region {
+		uint	page;	/* Page index. */
+		uint	x;	/* Left edge on the page (in pixels). */
+		uint	y;	/* Top edge on the page (in pixels). */
+		uint	w;	/* Width of the image (in pixels). */
+		uint	h;	/* Height of the image (in pixels). */
+		float	uv[4];	/* Texture coordinates of the image on the page (u0, v0, u1, v1). */
+	} Region;
+
+	/* Atlas page (RGBA, top row first). */
+	typedef struct Page {
+		uint	w;	/* Width of the page (in pixels). */
+		uint	h;	/* Height of the page (in pixels). */
+		std::vector<uchar>	pixels;	/* Pixel data. */
+	} Page;
+
+	std::vector<Page>	pages;	/* Atlas pages. */
+	std::vector<Region>	regions;	/* Location of each image (in the order they were given). */
+	ui64	key;	/* Fingerprint of the source images. */
+
+	VR_Draw_Atlas();	/* Constructor. */
+
+	/* Decode an RGBA PNG from memory. img is allocated with malloc(). */
+	static bool decode_png(const uchar* png_data, uchar*& img, uint& w, uint& h);
+	/* Fingerprint of a set of PNG images (from their chunk headers and CRCs, without decoding). */
+	static ui64 fingerprint(const uchar* const* pngs, uint num_pngs);
+
+	bool pack(const uint (*sizes)[2], uint num_images);	/* Compute the regions (and allocate the pages) for images of the given sizes. */
+	void blit(uint index, const uchar* rgba);	/* Copy an image into its region (after pack()). */
+	bool build(const uchar* const* pngs, uint num_pngs);	/* Decode, pack and blit a set of PNG images. */
+
+	bool save(const char* path) const;	/* Write the atlas to a cache file. */
+	bool load(const char* path, ui64 key, uint num_images);	/* Read the atlas from a cache file, if it matches key / num_images. */
+	void clear();	/* Release the pages and regions. */
+protected:
+	void update_uvs();	/* Compute the region texture coordinates from the pixel rects. */
+};
+
+#endif /* __VR_DRAW_ATLAS_H__ */
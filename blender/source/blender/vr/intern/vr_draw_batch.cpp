@@ -0,0 +1,266 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_draw_batch.cpp
+*   \ingroup vr
+*
+* Retained batch for the VR UI primitives.
+*/
+
+#include "vr_types.h"
+
+#include <cmath>
+
+#include "vr_draw_batch.h"
+
+/***************************************************************************************************
+ * \class                                  VR_Draw_Batch
+ ***************************************************************************************************
+ * Retained batch for the VR UI primitives.
+ **************************************************************************************************/
+VR_Draw_Batch::VR_Draw_Batch()
+	: backend(0)
+	, capacity(0)
+{
+	depth.func = 0;
+	depth.test = true;
+	depth.write = true;
+	memset(projection, 0, sizeof(projection));
+	projection[0][0] = projection[1][1] = projection[2][2] = projection[3][3] = 1.0f;
+	reset_stats();
+}
+
+VR_Draw_Batch::~VR_Draw_Batch()
+{
+	//
+}
+
+void VR_Draw_Batch::set_backend(Backend *backend)
+{
+	this->backend = backend;
+}
+
+void VR_Draw_Batch::set_capacity(uint max_verts)
+{
+	capacity = max_verts;
+}
+
+void VR_Draw_Batch::set_projection(const float projection[4][4])
+{
+	if (memcmp(this->projection, projection, sizeof(this->projection)) == 0) {
+		return;
+	}
+	if (!empty()) {
+		flush();
+	}
+	memcpy(this->projection, projection, sizeof(this->projection));
+}
+
+void VR_Draw_Batch::set_depth(const DepthState& depth)
+{
+	this->depth = depth;
+}
+
+const VR_Draw_Batch::DepthState& VR_Draw_Batch::get_depth() const
+{
+	return depth;
+}
+
+VR_Draw_Batch::Vertex *VR_Draw_Batch::add(uint num_verts, Primitive prim, const void *texture)
+{
+	if (capacity && !ranges.empty() && verts.size() + num_verts > capacity) {
+		flush();
+	}
+
+	const uint first = (uint)verts.size();
+	verts.resize(first + num_verts);
+
+	/* Untextured vertices ignore the bound texture, so they can join any range. */
+	if (!ranges.empty()) {
+		Range& last = ranges.back();
+		if (last.prim == prim && last.depth == depth &&
+			(!texture || !last.texture || last.texture == texture)) {
+			if (texture) {
+				last.texture = texture;
+			}
+			last.count += num_verts;
+			++stats.commands;
+			stats.vertices += num_verts;
+			return &verts[first];
+		}
+	}
+
+	Range range;
+	range.first = first;
+	range.count = num_verts;
+	range.texture = texture;
+	range.depth = depth;
+	range.prim = prim;
+	ranges.push_back(range);
+
+	++stats.commands;
+	stats.vertices += num_verts;
+	return &verts[first];
+}
+
+/* Transform a position by a (row-vector convention, affine) matrix. */
+static inline void transform_position(float out[3], const Mat44f& m, const float p[3])
+{
+	for (int i = 0; i < 3; ++i) {
+		out[i] = p[0] * m.m[0][i] + p[1] * m.m[1][i] + p[2] * m.m[2][i] + m.m[3][i];
+	}
+}
+
+void VR_Draw_Batch::add_quad(const Mat44f& modelview, const float pos[4][3], const float color[4],
+	const void *texture, const float uvs[4][2], float shade)
+{
+	/* Two triangles: (bl, br, tl), (tl, br, tr) - same winding as the original triangle strip. */
+	static const int order[6] = { 0, 1, 2, 2, 1, 3 };
+
+	float pos_eye[4][3];
+	for (int i = 0; i < 4; ++i) {
+		transform_position(pos_eye[i], modelview, pos[i]);
+	}
+	float col[4];
+	if (texture) {
+		col[0] = color[0] * shade;
+		col[1] = color[1] * shade;
+		col[2] = color[2] * shade;
+	}
+	else {
+		col[0] = color[0];
+		col[1] = color[1];
+		col[2] = color[2];
+	}
+	col[3] = color[3];
+
+	Vertex *v = add(6, PRIMITIVE_TRIANGLES, texture);
+	for (int i = 0; i < 6; ++i, ++v) {
+		const int j = order[i];
+		memcpy(v->pos, pos_eye[j], sizeof(float) * 3);
+		if (texture && uvs) {
+			v->uv[0] = uvs[j][0];
+			v->uv[1] = uvs[j][1];
+		}
+		else {
+			v->uv[0] = v->uv[1] = 0.0f;
+		}
+		memcpy(v->color, col, sizeof(float) * 4);
+		v->tex = texture ? 1.0f : 0.0f;
+	}
+}
+
+void VR_Draw_Batch::add_strip(const Mat44f& modelview, const float (*pos)[3], uint num_verts, const float color[4])
+{
+	if (num_verts < 3) {
+		return;
+	}
+
+	const uint num_tris = num_verts - 2;
+	Vertex *v = add(num_tris * 3, PRIMITIVE_TRIANGLES, 0);
+	for (uint t = 0; t < num_tris; ++t) {
+		/* Keep the strip's alternating winding. */
+		const uint idx[3] = { t, (t & 1) ? t + 2 : t + 1, (t & 1) ? t + 1 : t + 2 };
+		for (int i = 0; i < 3; ++i, ++v) {
+			transform_position(v->pos, modelview, pos[idx[i]]);
+			v->uv[0] = v->uv[1] = 0.0f;
+			memcpy(v->color, color, sizeof(float) * 4);
+			v->tex = 0.0f;
+		}
+	}
+}
+
+bool VR_Draw_Batch::empty() const
+{
+	return ranges.empty();
+}
+
+void VR_Draw_Batch::flush()
+{
+	if (ranges.empty()) {
+		return;
+	}
+	if (!backend || !backend->begin(&verts[0], (uint)verts.size(), projection)) {
+		clear();
+		return;
+	}
+
+	++stats.flushes;
+	const void *texture = 0;
+	const DepthState *depth_current = 0;
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		const Range& range = ranges[i];
+		if (!depth_current || *depth_current != range.depth) {
+			backend->set_depth(range.depth);
+			depth_current = &range.depth;
+			++stats.state_changes;
+		}
+		if (range.texture && range.texture != texture) {
+			backend->set_texture(range.texture);
+			texture = range.texture;
+			++stats.state_changes;
+		}
+		backend->draw(range.prim, range.first, range.count);
+		++stats.draw_calls;
+	}
+	backend->end();
+
+	clear();
+}
+
+void VR_Draw_Batch::clear()
+{
+	verts.clear();
+	ranges.clear();
+}
+
+const VR_Draw_Batch::Stats& VR_Draw_Batch::get_stats() const
+{
+	return stats;
+}
+
+void VR_Draw_Batch::reset_stats()
+{
+	memset(&stats, 0, sizeof(stats));
+}
+
+float VR_Draw_Batch::view_angle_shade(const Mat44f& modelview_inv)
+{
+	/* Same as the fragment shader of VR_Draw::Shader::shader_tex with normal (0, 0, 1):
+	 * normalize(normal_matrix * vec4(normal, 0.0)).z, clamped to [0.1, 1]. */
+	const float x = modelview_inv.m[0][2];
+	const float y = modelview_inv.m[1][2];
+	const float z = modelview_inv.m[2][2];
+	const float w = modelview_inv.m[3][2];
+	const float len = sqrtf(x * x + y * y + z * z + w * w);
+	float shade = (len > 0.0f) ? z / len : 0.0f;
+	if (shade < 0.1f) {
+		shade = 0.1f;
+	}
+	else if (shade > 1.0f) {
+		shade = 1.0f;
+	}
+	return shade;
+}
@@ -0,0 +1,138 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_draw_batch.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_DRAW_BATCH_H__
+#define __VR_DRAW_BATCH_H__
+
+#include "vr_types.h"
+
+#include <vector>
+
+/* Retained batch for the VR UI primitives (rects, frames, boxes, glyphs).
+ * While a batch is open, VR_Draw appends the primitives here instead of drawing them,
+ * with positions already transformed to eye space and the color (and view-angle shading)
+ * baked into the vertices. On flush, consecutive commands with compatible state are merged
+ * into a single draw call, and the GL state is set up once for the whole batch.
+ * The batch itself does not touch the graphics API: drawing goes through a Backend,
+ * so it can be counted headless (see tests/gtests/vr). */
+class VR_Draw_Batch
+{
+public:
+	/* Batch vertex (interleaved). */
+	typedef struct Vertex {
+		float	pos[3];		/* Eye-space position. */
+		float	uv[2];		/* Texture coordinates. */
+		float	color[4];	/* Vertex color (RGBA). */
+		float	tex;		/* 1 if textured, 0 if untextured. */
+	} Vertex;
+
+	/* Primitive type of a command. */
+	typedef enum Primitive {
+		PRIMITIVE_TRIANGLES = 0	/* Triangle list. */
+		,
+		PRIMITIVE_LINES = 1	/* Line list. */
+	} Primitive;
+
+	/* Depth state of a command. */
+	typedef struct DepthState {
+		uint	func;	/* Depth function (API value, opaque to the batch). */
+		bool	test;	/* Whether depth testing is enabled. */
+		bool	write;	/* Whether depth writing is enabled. */
+		bool operator==(const DepthState& o) const { return func == o.func && test == o.test && write == o.write; };
+		bool operator!=(const DepthState& o) const { return !(*this == o); };
+	} DepthState;
+
+	/* Interface to the graphics API. */
+	class Backend
+	{
+	public:
+		virtual ~Backend() {};
+		virtual bool begin(const Vertex *verts, uint num_verts, const float projection[4][4]) = 0;	/* Upload the vertices and set up the common state. */
+		virtual void set_depth(const DepthState& depth) = 0;	/* Apply a depth state. */
+		virtual void set_texture(const void *texture) = 0;	/* Bind a texture. */
+		virtual void draw(Primitive prim, uint first, uint count) = 0;	/* Draw a range of the uploaded vertices. */
+		virtual void end() = 0;	/* Restore the state saved in begin(). */
+	};
+
+	/* Counters (accumulated until reset_stats()). */
+	typedef struct Stats {
+		uint	commands;	/* Number of primitives submitted (each one used to be a separate draw). */
+		uint	vertices;	/* Number of vertices submitted. */
+		uint	flushes;	/* Number of (non-empty) flushes. */
+		uint	draw_calls;	/* Number of draw calls issued to the backend. */
+		uint	state_changes;	/* Number of texture / depth state changes issued to the backend. */
+	} Stats;
+
+	VR_Draw_Batch();	/* Constructor. */
+	~VR_Draw_Batch();	/* Destructor. */
+
+	void set_backend(Backend *backend);	/* Set the backend used for flushing (not owned). */
+	void set_capacity(uint max_verts);	/* Flush automatically before exceeding max_verts pending vertices (0: unlimited). */
+	void set_projection(const float projection[4][4]);	/* Set the projection matrix (flushes pending commands if it changed). */
+	void set_depth(const DepthState& depth);	/* Set the depth state for subsequent commands. */
+	const DepthState& get_depth() const;	/* Get the depth state for subsequent commands. */
+
+	/* Add a quad (bottom-left, bottom-right, top-left, top-right) transformed by modelview.
+	 * If texture is non-null, uvs (same order) are used and color.rgb is multiplied by shade. */
+	void add_quad(const Mat44f& modelview, const float pos[4][3], const float color[4],
+		const void *texture = 0, const float uvs[4][2] = 0, float shade = 1.0f);
+	/* Add an untextured triangle strip transformed by modelview. */
+	void add_strip(const Mat44f& modelview, const float (*pos)[3], uint num_verts, const float color[4]);
+
+	bool empty() const;	/* Whether there are pending commands. */
+	void flush();	/* Draw all pending commands and clear the batch. */
+	void clear();	/* Discard all pending commands. */
+
+	const Stats& get_stats() const;	/* Get the counters. */
+	void reset_stats();	/* Reset the counters. */
+
+	/* View-angle shading factor of the default textured shader for a flat quad facing +z. */
+	static float view_angle_shade(const Mat44f& modelview_inv);
+protected:
+	/* Range of vertices drawn with the same state. */
+	typedef struct Range {
+		uint		first;	/* First vertex. */
+		uint		count;	/* Number of vertices. */
+		const void	*texture;	/* Texture (0 if the range is untextured so far). */
+		DepthState	depth;	/* Depth state. */
+		Primitive	prim;	/* Primitive type. */
+	} Range;
+
+	Backend	*backend;	/* Backend used for flushing. */
+	uint	capacity;	/* Maximum number of pending vertices (0: unlimited). */
+	std::vector<Vertex>	verts;	/* Pending vertices. */
+	std::vector<Range>	ranges;	/* Pending ranges. */
+	DepthState	depth;	/* Depth state for subsequent commands. */
+	float	projection[4][4];	/* Projection matrix of the pending commands. */
+	Stats	stats;	/* Counters. */
+
+	Vertex *add(uint num_verts, Primitive prim, const void *texture);	/* Reserve vertices for a command, merging it into the last range if possible. */
+};
+
+#endif /* __VR_DRAW_BATCH_H__ */
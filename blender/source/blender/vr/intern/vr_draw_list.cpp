@@ -0,0 +1,250 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_draw_list.cpp
+*   \ingroup vr
+*
+* Retained display list of VR UI primitives.
+*/
+
+#include "vr_types.h"
+
+#include "vr_draw_list.h"
+
+/***************************************************************************************************
+ * \class                                  VR_Draw_List
+ ***************************************************************************************************
+ * Retained display list of VR UI primitives.
+ **************************************************************************************************/
+VR_Draw_List::VR_Draw_List()
+	: backend(0)
+	, buffer(0)
+	, uploaded(false)
+	, dirty(true)
+{
+	reset_stats();
+}
+
+VR_Draw_List::~VR_Draw_List()
+{
+	//
+}
+
+void VR_Draw_List::set_backend(Backend *backend)
+{
+	if (this->backend == backend) {
+		return;
+	}
+	this->backend = backend;
+	buffer = 0;
+	uploaded = false;
+}
+
+VR_Draw_List::Backend *VR_Draw_List::get_backend() const
+{
+	return backend;
+}
+
+bool VR_Draw_List::update_state(const void *state, uint size)
+{
+	if (!dirty && this->state.size() == size && memcmp(&this->state[0], state, size) == 0) {
+		return false;
+	}
+	const uchar *bytes = (const uchar*)state;
+	this->state.assign(bytes, bytes + size);
+	dirty = false;
+	return true;
+}
+
+void VR_Draw_List::invalidate()
+{
+	dirty = true;
+}
+
+void VR_Draw_List::begin()
+{
+	verts.clear();
+	ranges.clear();
+	uploaded = false;
+	++stats.rebuilds;
+}
+
+VR_Draw_List::Vertex *VR_Draw_List::add(uint num_verts, const void *texture)
+{
+	const uint first = (uint)verts.size();
+	verts.resize(first + num_verts);
+	++stats.commands;
+	stats.vertices += num_verts;
+
+	/* Untextured vertices ignore the bound texture, so they can join any range. */
+	if (!ranges.empty()) {
+		Range& last = ranges.back();
+		if (!texture || !last.texture || last.texture == texture) {
+			if (texture) {
+				last.texture = texture;
+			}
+			last.count += num_verts;
+			return &verts[first];
+		}
+	}
+
+	Range range;
+	range.first = first;
+	range.count = num_verts;
+	range.texture = texture;
+	ranges.push_back(range);
+	return &verts[first];
+}
+
+/* Transform a position by a (row-vector convention, affine) matrix. */
+static inline void transform_position(float out[3], const Mat44f& m, const float p[3])
+{
+	for (int i = 0; i < 3; ++i) {
+		out[i] = p[0] * m.m[0][i] + p[1] * m.m[1][i] + p[2] * m.m[2][i] + m.m[3][i];
+	}
+}
+
+/* Shading column of untextured vertices (unused, but keeps the shader away from a zero vector). */
+static const float normal_untextured[4] = { 0.0f, 0.0f, 1.0f, 0.0f };
+
+void VR_Draw_List::add_quad(const Mat44f& model, const Mat44f& model_inv, const float pos[4][3], const float color[4],
+	const void *texture, const float uvs[4][2])
+{
+	/* Two triangles: (bl, br, tl), (tl, br, tr) - same winding as the original triangle strip. */
+	static const int order[6] = { 0, 1, 2, 2, 1, 3 };
+
+	float pos_list[4][3];
+	for (int i = 0; i < 4; ++i) {
+		transform_position(pos_list[i], model, pos[i]);
+	}
+	float normal[4];
+	if (texture) {
+		for (int i = 0; i < 4; ++i) {
+			normal[i] = model_inv.m[i][2];
+		}
+	}
+	else {
+		memcpy(normal, normal_untextured, sizeof(normal));
+	}
+
+	Vertex *v = add(6, texture);
+	for (int i = 0; i < 6; ++i, ++v) {
+		const int j = order[i];
+		memcpy(v->pos, pos_list[j], sizeof(float) * 3);
+		if (texture && uvs) {
+			v->uv[0] = uvs[j][0];
+			v->uv[1] = uvs[j][1];
+		}
+		else {
+			v->uv[0] = v->uv[1] = 0.0f;
+		}
+		memcpy(v->color, color, sizeof(float) * 4);
+		v->tex = texture ? 1.0f : 0.0f;
+		memcpy(v->normal, normal, sizeof(float) * 4);
+	}
+}
+
+void VR_Draw_List::add_strip(const Mat44f& model, const float (*pos)[3], uint num_verts, const float color[4])
+{
+	if (num_verts < 3) {
+		return;
+	}
+
+	const uint num_tris = num_verts - 2;
+	Vertex *v = add(num_tris * 3, 0);
+	for (uint t = 0; t < num_tris; ++t) {
+		/* Keep the strip's alternating winding. */
+		const uint idx[3] = { t, (t & 1) ? t + 2 : t + 1, (t & 1) ? t + 1 : t + 2 };
+		for (int i = 0; i < 3; ++i, ++v) {
+			transform_position(v->pos, model, pos[idx[i]]);
+			v->uv[0] = v->uv[1] = 0.0f;
+			memcpy(v->color, color, sizeof(float) * 4);
+			v->tex = 0.0f;
+			memcpy(v->normal, normal_untextured, sizeof(float) * 4);
+		}
+	}
+}
+
+void VR_Draw_List::end()
+{
+	uploaded = false;
+}
+
+bool VR_Draw_List::empty() const
+{
+	return ranges.empty();
+}
+
+uint VR_Draw_List::size() const
+{
+	return (uint)verts.size();
+}
+
+uint VR_Draw_List::num_ranges() const
+{
+	return (uint)ranges.size();
+}
+
+void VR_Draw_List::draw(const Mat44f& modelview, const Mat44f& modelview_inv, const float projection[4][4])
+{
+	if (ranges.empty() || !backend) {
+		return;
+	}
+	if (!uploaded) {
+		/* Retried on the next draw if it fails. */
+		if (!backend->upload(buffer, &verts[0], (uint)verts.size())) {
+			return;
+		}
+		uploaded = true;
+		++stats.uploads;
+	}
+	if (!backend->begin(buffer, modelview.m, modelview_inv.m, projection)) {
+		return;
+	}
+
+	++stats.replays;
+	const void *texture = 0;
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		const Range& range = ranges[i];
+		if (range.texture && range.texture != texture) {
+			backend->set_texture(range.texture);
+			texture = range.texture;
+			++stats.state_changes;
+		}
+		backend->draw(range.first, range.count);
+		++stats.draw_calls;
+	}
+	backend->end();
+}
+
+const VR_Draw_List::Stats& VR_Draw_List::get_stats() const
+{
+	return stats;
+}
+
+void VR_Draw_List::reset_stats()
+{
+	memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,131 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_draw_list.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_DRAW_LIST_H__
+#define __VR_DRAW_LIST_H__
+
+#include "vr_types.h"
+
+#include <vector>
+
+/* Retained display list of VR UI primitives (rects, frames, glyphs), i.e. for the pie menus.
+ * The primitives are recorded once in list space (relative to the transformation the list is
+ * drawn with) into a vertex buffer and draw ranges. The list is only rebuilt when the state it
+ * was built from changes (see update_state()); otherwise each eye just replays the uploaded
+ * ranges with its own modelview matrix.
+ * Since the view-angle shading of textured primitives depends on the eye, vertices keep the
+ * column of the inverse list-space modelview that the shading is computed from (see
+ * VR_Draw_Batch::view_angle_shade()) instead of a baked color.
+ * Drawing goes through a Backend, so it can be counted headless (see tests/gtests/vr). */
+class VR_Draw_List
+{
+public:
+	/* List vertex (interleaved). */
+	typedef struct Vertex {
+		float	pos[3];		/* List-space position. */
+		float	uv[2];		/* Texture coordinates. */
+		float	color[4];	/* Vertex color (RGBA, unshaded). */
+		float	tex;		/* 1 if textured, 0 if untextured. */
+		float	normal[4];	/* Third column of the inverse list-space modelview (view-angle shading). */
+	} Vertex;
+
+	/* Interface to the graphics API.
+	 * Buffers are created by upload() and owned by the backend (released together with it). */
+	class Backend
+	{
+	public:
+		virtual ~Backend() {};
+		virtual bool upload(uint& buffer, const Vertex *verts, uint num_verts) = 0;	/* Upload the vertices of a rebuilt list (creating the buffer if it is 0). */
+		virtual bool begin(uint buffer, const float modelview[4][4], const float modelview_inv[4][4], const float projection[4][4]) = 0;	/* Set up the common state for replaying a list. */
+		virtual void set_texture(const void *texture) = 0;	/* Bind a texture. */
+		virtual void draw(uint first, uint count) = 0;	/* Draw a range of the uploaded vertices (triangles). */
+		virtual void end() = 0;	/* Restore the state saved in begin(). */
+	};
+
+	/* Counters (accumulated until reset_stats()). */
+	typedef struct Stats {
+		uint	rebuilds;	/* Number of times the list was recorded. */
+		uint	uploads;	/* Number of uploads to the backend. */
+		uint	commands;	/* Number of primitives recorded. */
+		uint	vertices;	/* Number of vertices recorded. */
+		uint	replays;	/* Number of (non-empty) draw() calls. */
+		uint	draw_calls;	/* Number of draw calls issued to the backend. */
+		uint	state_changes;	/* Number of texture changes issued to the backend. */
+	} Stats;
+
+	VR_Draw_List();	/* Constructor. */
+	~VR_Draw_List();	/* Destructor. */
+
+	void set_backend(Backend *backend);	/* Set the backend used for drawing (not owned; forgets the buffer of the previous one). */
+	Backend *get_backend() const;	/* Get the backend used for drawing. */
+
+	/* Compare the state the list was built from (any POD, compared bytewise) with the current one.
+	 * Returns true (and stores the new state) if the list needs to be rebuilt. */
+	bool update_state(const void *state, uint size);
+	void invalidate();	/* Force a rebuild on the next update_state(). */
+
+	void begin();	/* Start recording (discards the previous contents). */
+	/* Add a quad (bottom-left, bottom-right, top-left, top-right) transformed by model (list space).
+	 * If texture is non-null, uvs (same order) are used and the quad is shaded by the view angle. */
+	void add_quad(const Mat44f& model, const Mat44f& model_inv, const float pos[4][3], const float color[4],
+		const void *texture = 0, const float uvs[4][2] = 0);
+	/* Add an untextured triangle strip transformed by model (list space). */
+	void add_strip(const Mat44f& model, const float (*pos)[3], uint num_verts, const float color[4]);
+	void end();	/* Stop recording (the list is uploaded on the next draw()). */
+
+	bool empty() const;	/* Whether the list has no primitives. */
+	uint size() const;	/* Number of vertices. */
+	uint num_ranges() const;	/* Number of draw ranges. */
+
+	/* Replay the list with a modelview matrix (list space to eye space). */
+	void draw(const Mat44f& modelview, const Mat44f& modelview_inv, const float projection[4][4]);
+
+	const Stats& get_stats() const;	/* Get the counters. */
+	void reset_stats();	/* Reset the counters. */
+protected:
+	/* Range of vertices drawn with the same texture. */
+	typedef struct Range {
+		uint		first;	/* First vertex. */
+		uint		count;	/* Number of vertices. */
+		const void	*texture;	/* Texture (0 if the range is untextured so far). */
+	} Range;
+
+	Backend	*backend;	/* Backend used for drawing. */
+	uint	buffer;	/* Backend buffer (0: not created). */
+	bool	uploaded;	/* Whether the backend buffer holds the current vertices. */
+	bool	dirty;	/* Whether the list needs to be rebuilt regardless of the state. */
+	std::vector<uchar>	state;	/* State the list was built from. */
+	std::vector<Vertex>	verts;	/* Vertices. */
+	std::vector<Range>	ranges;	/* Draw ranges. */
+	Stats	stats;	/* Counters. */
+
+	Vertex *add(uint num_verts, const void *texture);	/* Reserve vertices for a command, merging it into the last range if possible. */
+};
+
+#endif /* __VR_DRAW_LIST_H__ */
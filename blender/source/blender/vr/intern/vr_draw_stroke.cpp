@@ -0,0 +1,251 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_draw_stroke.cpp
+*   \ingroup vr
+*
+* Retained geometry of the stroke being drawn.
+*/
+
+#include "vr_types.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "vr_draw_stroke.h"
+
+/***************************************************************************************************
+ * \class                                  VR_Draw_Stroke
+ ***************************************************************************************************
+ * Retained geometry of the stroke being drawn.
+ **************************************************************************************************/
+const uint VR_Draw_Stroke::min_capacity(1024);
+const float VR_Draw_Stroke::width_step(0.5f);
+
+VR_Draw_Stroke::VR_Draw_Stroke()
+	: backend(0)
+	, thickness(1.0f)
+	, capacity(0)
+	, uploaded(0)
+	, valid(false)
+{
+	reset_stats();
+}
+
+VR_Draw_Stroke::~VR_Draw_Stroke()
+{
+	//
+}
+
+void VR_Draw_Stroke::set_backend(Backend *backend)
+{
+	this->backend = backend;
+	/* The new backend has no buffer yet. */
+	capacity = uploaded = 0;
+	valid = false;
+}
+
+void VR_Draw_Stroke::set_thickness(float thickness)
+{
+	this->thickness = thickness;
+}
+
+void VR_Draw_Stroke::clear()
+{
+	points.clear();
+	strips.clear();
+	uploaded = 0;
+}
+
+void VR_Draw_Stroke::add(const float pos[3], float pressure)
+{
+	/* Quantized, so strips of the same width can be drawn together. */
+	const float width = std::max(std::floor(pressure * thickness / width_step + 0.5f) * width_step, 1.0f);
+
+	const uint i = (uint)points.size();
+	points.push_back(Coord3Df(pos[0], pos[1], pos[2]));
+
+	if (strips.empty()) {
+		const Strip strip = { i, 1, width };
+		strips.push_back(strip);
+	}
+	else if (strips.back().width != width) {
+		/* Continue from the previous point, so there is no gap in the stroke. */
+		const Strip strip = { i - 1, 2, width };
+		strips.push_back(strip);
+	}
+	else {
+		++strips.back().count;
+	}
+}
+
+uint VR_Draw_Stroke::size() const
+{
+	return (uint)points.size();
+}
+
+uint VR_Draw_Stroke::num_strips() const
+{
+	return (uint)strips.size();
+}
+
+void VR_Draw_Stroke::draw(const float color[4])
+{
+	/* Need at least two points to draw a line. */
+	if (!backend || points.size() < 2) {
+		return;
+	}
+
+	/* Upload the points added since the last draw (the other eye draws without uploading). */
+	const uint num_points = (uint)points.size();
+	if (!valid || num_points > capacity) {
+		uint new_capacity = std::max(capacity, min_capacity);
+		while (new_capacity < num_points) {
+			new_capacity *= 2;
+		}
+		const uint num_keep = valid ? uploaded : 0;
+		valid = backend->reserve(new_capacity, num_keep);
+		++stats.reallocations;
+		if (!valid) {
+			capacity = uploaded = 0;
+			return;
+		}
+		capacity = new_capacity;
+		uploaded = num_keep;
+	}
+	if (uploaded < num_points) {
+		backend->upload(uploaded, &points[uploaded], num_points - uploaded);
+		++stats.uploads;
+		stats.points_uploaded += num_points - uploaded;
+		uploaded = num_points;
+	}
+
+	/* Group the strips by width. */
+	draw_first.clear();
+	draw_count.clear();
+	draw_width.clear();
+	for (size_t i = 0; i < strips.size(); ++i) {
+		if (strips[i].count >= 2) {
+			draw_width.push_back(strips[i].width);
+		}
+	}
+	std::sort(draw_width.begin(), draw_width.end());
+	draw_width.erase(std::unique(draw_width.begin(), draw_width.end()), draw_width.end());
+
+	if (!backend->begin(color)) {
+		return;
+	}
+	for (size_t w = 0; w < draw_width.size(); ++w) {
+		draw_first.clear();
+		draw_count.clear();
+		for (size_t i = 0; i < strips.size(); ++i) {
+			if (strips[i].count >= 2 && strips[i].width == draw_width[w]) {
+				draw_first.push_back((int)strips[i].first);
+				draw_count.push_back((int)strips[i].count);
+			}
+		}
+		backend->draw(&draw_first[0], &draw_count[0], (uint)draw_first.size(), draw_width[w]);
+		++stats.draw_calls;
+	}
+	backend->end();
+	++stats.draws;
+}
+
+void VR_Draw_Stroke::simplify(float tolerance, std::vector<uint>& r_keep) const
+{
+	if (points.empty()) {
+		return;
+	}
+	for (size_t i = 0; i < strips.size(); ++i) {
+		const Strip& strip = strips[i];
+		if (strip.count >= 2) {
+			simplify(&points[0], strip.first, strip.first + strip.count - 1, tolerance, r_keep);
+		}
+	}
+	r_keep.push_back((uint)points.size() - 1);
+}
+
+/* Squared distance of p to the segment [a, b]. */
+static float segment_distance_squared(const Coord3Df& p, const Coord3Df& a, const Coord3Df& b)
+{
+	const Coord3Df ab = b - a;
+	const Coord3Df ap = p - a;
+	const float len_squared = ab * ab;
+	float t = (len_squared > 0.0f) ? (ap * ab) / len_squared : 0.0f;
+	t = (t < 0.0f) ? 0.0f : ((t > 1.0f) ? 1.0f : t);
+	const Coord3Df d = ap - ab * t;
+	return d * d;
+}
+
+void VR_Draw_Stroke::simplify(const Coord3Df *points, uint first, uint last, float tolerance, std::vector<uint>& r_keep)
+{
+	if (last <= first) {
+		return;
+	}
+	const uint n = last - first + 1;
+	const float tolerance_squared = tolerance * tolerance;
+
+	/* Iterative (long strokes would overflow the stack), marking the points to keep. */
+	std::vector<uchar> keep(n, 0);
+	keep[0] = keep[n - 1] = 1;
+	std::vector<std::pair<uint, uint> > ranges;
+	ranges.push_back(std::make_pair(first, last));
+	while (!ranges.empty()) {
+		const uint a = ranges.back().first;
+		const uint b = ranges.back().second;
+		ranges.pop_back();
+
+		float max_distance = -1.0f;
+		uint max_i = a;
+		for (uint i = a + 1; i < b; ++i) {
+			const float distance = segment_distance_squared(points[i], points[a], points[b]);
+			if (distance > max_distance) {
+				max_distance = distance;
+				max_i = i;
+			}
+		}
+		if (max_i != a && max_distance > tolerance_squared) {
+			keep[max_i - first] = 1;
+			ranges.push_back(std::make_pair(a, max_i));
+			ranges.push_back(std::make_pair(max_i, b));
+		}
+	}
+
+	for (uint i = 0; i < n - 1; ++i) {
+		if (keep[i]) {
+			r_keep.push_back(first + i);
+		}
+	}
+}
+
+const VR_Draw_Stroke::Stats& VR_Draw_Stroke::get_stats() const
+{
+	return stats;
+}
+
+void VR_Draw_Stroke::reset_stats()
+{
+	memset(&stats, 0, sizeof(stats));
+}
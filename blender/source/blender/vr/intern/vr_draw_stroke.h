@@ -0,0 +1,115 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_draw_stroke.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_DRAW_STROKE_H__
+#define __VR_DRAW_STROKE_H__
+
+#include "vr_types.h"
+
+#include <vector>
+
+/* Retained geometry of a stroke that is being drawn (i.e. with the Annotate tool).
+ * Points are only appended: the GPU buffer grows geometrically (copying its contents on the GPU)
+ * and only the points added since the last draw are uploaded, so each point is uploaded once and
+ * both eyes draw the whole stroke without re-submitting it.
+ * Since the line width can't change within a line strip, the stroke is split into strips
+ * where the (quantized) width changes; strips of the same width are drawn together.
+ * Drawing goes through a Backend, so it can be counted headless (see tests/gtests/vr). */
+class VR_Draw_Stroke
+{
+public:
+	/* Interface to the graphics API. */
+	class Backend
+	{
+	public:
+		virtual ~Backend() {};
+		virtual bool reserve(uint capacity, uint num_keep) = 0;	/* (Re)allocate the buffer for capacity points, keeping its first num_keep points. */
+		virtual void upload(uint first, const Coord3Df *points, uint num_points) = 0;	/* Upload points into the allocated buffer. */
+		virtual bool begin(const float color[4]) = 0;	/* Set up the common state. */
+		virtual void draw(const int *first, const int *count, uint num_strips, float width) = 0;	/* Draw line strips of the same width. */
+		virtual void end() = 0;	/* Restore the state saved in begin(). */
+	};
+
+	/* Counters (accumulated until reset_stats()). */
+	typedef struct Stats {
+		uint	reallocations;	/* Number of buffer (re)allocations. */
+		uint	uploads;	/* Number of incremental uploads. */
+		uint	points_uploaded;	/* Number of points uploaded. */
+		uint	draws;	/* Number of draw() calls (strokes drawn). */
+		uint	draw_calls;	/* Number of draw calls issued to the backend. */
+	} Stats;
+
+	static const uint min_capacity;	/* Initial capacity of the buffer (in points). */
+	static const float width_step;	/* Quantization of the line width (pixels). */
+
+	VR_Draw_Stroke();	/* Constructor. */
+	~VR_Draw_Stroke();	/* Destructor. */
+
+	void set_backend(Backend *backend);	/* Set the backend used for drawing (not owned). */
+	void set_thickness(float thickness);	/* Line width at full pressure (applies to points added next). */
+
+	void clear();	/* Start a new stroke (keeps the buffer allocated). */
+	void add(const float pos[3], float pressure);	/* Append a point. */
+	uint size() const;	/* Number of points. */
+	uint num_strips() const;	/* Number of line strips of the stroke. */
+
+	void draw(const float color[4]);	/* Upload the new points and draw the stroke. */
+
+	/* Ramer-Douglas-Peucker simplification of each strip (keeping the strip ends, so the
+	 * width changes are kept too). Appends the indices of the points to keep, in order. */
+	void simplify(float tolerance, std::vector<uint>& r_keep) const;
+	/* Simplify points [first, last] (both kept) to the tolerance. Appends the kept indices
+	 * except last. */
+	static void simplify(const Coord3Df *points, uint first, uint last, float tolerance, std::vector<uint>& r_keep);
+
+	const Stats& get_stats() const;	/* Get the counters. */
+	void reset_stats();	/* Reset the counters. */
+protected:
+	/* Points drawn with the same line width. */
+	typedef struct Strip {
+		uint	first;	/* First point (the last point of the previous strip, so there is no gap). */
+		uint	count;	/* Number of points. */
+		float	width;	/* Line width (pixels). */
+	} Strip;
+
+	Backend	*backend;	/* Backend used for drawing. */
+	float	thickness;	/* Line width at full pressure. */
+	std::vector<Coord3Df>	points;	/* Points of the stroke. */
+	std::vector<Strip>	strips;	/* Strips of the stroke. */
+	uint	capacity;	/* Capacity of the backend buffer (0: not allocated). */
+	uint	uploaded;	/* Number of points in the backend buffer. */
+	bool	valid;	/* Whether the backend buffer was allocated successfully. */
+	Stats	stats;	/* Counters. */
+
+	std::vector<int>	draw_first;	/* Scratch arrays for drawing. */
+	std::vector<int>	draw_count;
+	std::vector<float>	draw_width;
+};
+
+#endif /* __VR_DRAW_STROKE_H__ */
@@ -34,24 +34,31 @@
 #include "vr_main.h"
 
 #include "BLI_math.h"
+#include "BLI_threads.h"
 
 #include "DNA_camera_types.h"
 #include "DNA_screen_types.h"
 #include "DNA_windowmanager_types.h"
 
 #include "BKE_camera.h"
+#include "BKE_context.h"
 #include "BKE_library.h"
 #include "BKE_library_query.h"
 #include "BKE_main.h"
 #include "BKE_object.h"
+#include "BKE_scene.h"
 
+#include "DEG_depsgraph.h"
 #include "DEG_depsgraph_build.h"
 
 #include "ED_object.h"
 
 #include "GPU_framebuffer.h"
+#include "GPU_state.h"
 #include "GPU_viewport.h"
 
+#include "PIL_time.h"
+
 #include "draw_manager.h"
 #include "wm_draw.h"
 
@@ -71,6 +78,7 @@
 #endif
 
 #include "vr_api.h"
+#include "vr_simulated.h"
 
 #ifndef WIN32
 /* Remove __stdcall for the dll imports. */
@@ -92,10 +100,13 @@ typedef int(__stdcall *c_updateTrackingVR)(void);	/* Update the t_eye positions
 typedef int(__stdcall *c_getEyePositions)(float t_eye[VR_SIDES][4][4]);	/* Last tracked position of the eyes. */
 typedef int(__stdcall *c_getHMDPosition)(float t_hmd[4][4]);	/* Last tracked position of the HMD. */
 typedef int(__stdcall *c_getControllerPositions)(float t_controller[VR_MAX_CONTROLLERS][4][4]);	/* Last tracked position of the controllers. */
+typedef int(__stdcall *c_sampleControllerPositions)(float t_controller[VR_MAX_CONTROLLERS][4][4]);	/* Position of the controllers from the latest tracking data (between two frames). */
 typedef int(__stdcall *c_getControllerStates)(void* controller_states[VR_MAX_CONTROLLERS]);	/* Last tracked button states of the controllers. */
 typedef int(__stdcall *c_blitEye)(int side, void* texture_resource, const float* aperture_u, const float* aperture_v);	/* Blit a rendered image into the internal eye texture. */
 typedef int(__stdcall *c_blitEyes)(void* texture_resource_left, void* texture_resource_right, const float* aperture_u, const float* aperture_v);	/* Blit rendered images into the internal eye textures. */
 typedef int(__stdcall *c_submitFrame)(void);	/* Submit frame to the HMD. */
+typedef int(__stdcall *c_getEyeImages)(int side, uint *images, int *count);	/* Get the device-owned eye images that can be rendered into directly (optional). */
+typedef int(__stdcall *c_acquireEyeImage)(int side, int *index);	/* Acquire the device-owned eye image to render the next frame into (optional). */
 typedef int(__stdcall *c_uninitVR)(void);	/* Un-initialize the internal object. */
 
 static c_createVR vr_dll_create_vr;
@@ -108,16 +119,55 @@ static c_updateTrackingVR vr_dll_update_tracking_vr;
 static c_getEyePositions vr_dll_get_eye_positions;
 static c_getHMDPosition vr_dll_get_hmd_position;
 static c_getControllerPositions vr_dll_get_controller_positions;
+static c_sampleControllerPositions vr_dll_sample_controller_positions;
 static c_getControllerStates vr_dll_get_controller_states;
 static c_blitEye vr_dll_blit_eye;
 static c_blitEyes vr_dll_blit_eyes;
 static c_submitFrame vr_dll_submit_frame;
+static c_getEyeImages vr_dll_get_eye_images;
+static c_acquireEyeImage vr_dll_acquire_eye_image;
 static c_uninitVR vr_dll_uninit_vr;
 
+/* Serializes the tracking calls into the VR dll (main thread and tracking sampler). */
+static ThreadMutex vr_dll_tracking_mutex = BLI_MUTEX_INITIALIZER;
+/* Whether the VR dll can be polled for tracking data (protected by vr_dll_tracking_mutex). */
+static int vr_dll_tracking_available = 0;
+
+/* Whether the tracking matrices are predicted to the display time of the frame
+ * (unless the VR dll already locates them at the predicted display time). */
+static int vr_predict_poses = 0;
+
+/* Maximum number of device-owned images per eye. */
+#define VR_MAX_EYE_IMAGES 8
+
+/* Device-owned eye images that are rendered into directly (see vr.direct_rendering). */
+static GPUTexture *vr_eye_images[VR_SIDES][VR_MAX_EYE_IMAGES];
+static int vr_eye_images_len[VR_SIDES];
+/* Whether the eye image for the current frame was acquired (until the frame is submitted). */
+static int vr_eye_image_acquired[VR_SIDES];
+
 /* VR module object (singleton). */
 static VR vr;
 VR *vr_get_obj() { return &vr; }
 
+/* Measure a stage of the VR frame (simulated VR only).
+ * GPU stages wait for the GPU, so their time is not attributed to the next stage. */
+static void vr_stage_begin(VR_Simulated_Stage stage)
+{
+  if (vr.type == VR_TYPE_SIMULATED) {
+    vr_simulated_stage_begin(stage);
+  }
+}
+static void vr_stage_end(VR_Simulated_Stage stage)
+{
+  if (vr.type == VR_TYPE_SIMULATED) {
+    if (stage >= VR_SIMULATED_STAGE_DRAW_LEFT && stage <= VR_SIMULATED_STAGE_BLIT) {
+      GPU_finish();
+    }
+    vr_simulated_stage_end(stage);
+  }
+}
+
 /* Temporary VR camera to use if scene does not contain a camera. */
 static Object *vr_temp_cam = NULL;
 
@@ -167,6 +217,32 @@ static int vr_load_dll_functions(VR_Type type)
   case VR_TYPE_MAGICLEAP: {
     return -1;
   }
+  case VR_TYPE_SIMULATED: {
+    /* Built-in, no shared library. */
+    if (!vr_simulated_trace_path()) {
+      return -1;
+    }
+    vr_dll_create_vr = vr_simulated_create_vr;
+    vr_dll_init_vr = vr_simulated_init_vr;
+    vr_dll_get_hmd_type = vr_simulated_get_hmd_type;
+    vr_dll_set_eye_params = vr_simulated_set_eye_params;
+    vr_dll_get_default_eye_params = vr_simulated_get_default_eye_params;
+    vr_dll_get_default_eye_tex_size = vr_simulated_get_default_eye_tex_size;
+    vr_dll_update_tracking_vr = vr_simulated_update_tracking;
+    vr_dll_get_eye_positions = vr_simulated_get_eye_positions;
+    vr_dll_get_hmd_position = vr_simulated_get_hmd_position;
+    vr_dll_get_controller_positions = vr_simulated_get_controller_positions;
+    vr_dll_get_controller_states = vr_simulated_get_controller_states;
+    vr_dll_blit_eye = vr_simulated_blit_eye;
+    vr_dll_blit_eyes = vr_simulated_blit_eyes;
+    vr_dll_submit_frame = vr_simulated_submit_frame;
+    vr_dll_get_eye_images = NULL;
+    vr_dll_acquire_eye_image = NULL;
+    vr_dll_sample_controller_positions = NULL;
+    vr_dll_uninit_vr = vr_simulated_uninit_vr;
+    vr.type = VR_TYPE_SIMULATED;
+    return 0;
+  }
   case VR_TYPE_OPENXR: {
 #ifdef WIN32
     vr_dll = LoadLibrary("BlenderXR_OpenXR.dll");
@@ -375,6 +451,11 @@ static int vr_load_dll_functions(VR_Type type)
 	if (!vr_dll_uninit_vr) {
 		return -1;
 	}
+	/* Optional, only some VR dlls support rendering into their images directly. */
+	vr_dll_get_eye_images = (c_getEyeImages)GetProcAddress(vr_dll, "c_getEyeImages");
+	vr_dll_acquire_eye_image = (c_acquireEyeImage)GetProcAddress(vr_dll, "c_acquireEyeImage");
+	/* Optional, only some VR dlls can query the controllers between two frames. */
+	vr_dll_sample_controller_positions = (c_sampleControllerPositions)GetProcAddress(vr_dll, "c_sampleControllerPositions");
 #else
 	vr_dll_create_vr = (c_createVR)dlsym(vr_dll, "c_createVR");
 	if (!vr_dll_create_vr) {
@@ -436,6 +517,11 @@ static int vr_load_dll_functions(VR_Type type)
 	if (!vr_dll_uninit_vr) {
 		return -1;
 	}
+	/* Optional, only some VR dlls support rendering into their images directly. */
+	vr_dll_get_eye_images = (c_getEyeImages)dlsym(vr_dll, "c_getEyeImages");
+	vr_dll_acquire_eye_image = (c_acquireEyeImage)dlsym(vr_dll, "c_acquireEyeImage");
+	/* Optional, only some VR dlls can query the controllers between two frames. */
+	vr_dll_sample_controller_positions = (c_sampleControllerPositions)dlsym(vr_dll, "c_sampleControllerPositions");
 #endif
 
 	return 0;
@@ -566,6 +652,84 @@ static void vr_draw_offscreen_texture_parameters(GPUOffScreen *offscreen)
 	glBindTexture(GL_TEXTURE_2D, 0);
 }
 
+/* Render the eye into a device-owned image (or back into its offscreen buffer, if NULL). */
+static void vr_eye_image_attach(int side, GPUTexture *image)
+{
+	GPUViewport *viewport = vr.viewport[side];
+	if (!image) {
+		image = GPU_offscreen_color_texture(vr.offscreen[side]);
+	}
+
+	GPU_framebuffer_texture_attach(viewport->fbl->default_fb, image, 0, 0);
+	GPU_framebuffer_texture_attach(viewport->fbl->color_only_fb, image, 0, 0);
+	viewport->txl->color = image;
+}
+
+/* Copy the frame rendered into the device-owned image back into the offscreen buffer and render
+ * into that again. The image is released when the frame is submitted, but the window mirror and the
+ * network capture read the viewport color texture afterwards. */
+static void vr_eye_image_detach(int side)
+{
+	GPUFrameBuffer *fb;
+	GPUTexture *color, *depth;
+	GPU_offscreen_viewport_data_get(vr.offscreen[side], &fb, &color, &depth);
+	GPU_framebuffer_blit(vr.viewport[side]->fbl->color_only_fb, 0, fb, 0, GPU_COLOR_BIT);
+
+	vr_eye_image_attach(side, NULL);
+	vr_eye_image_acquired[side] = 0;
+}
+
+/* Free the device-owned eye images (the images themselves are owned by the VR dll). */
+static void vr_eye_images_free(void)
+{
+	for (int side = 0; side < VR_SIDES; ++side) {
+		if (vr_eye_images_len[side] && vr.viewport[side]) {
+			vr_eye_image_attach(side, NULL);
+		}
+		for (int i = 0; i < vr_eye_images_len[side]; ++i) {
+			vr_eye_images[side][i]->bindcode = 0;
+			GPU_texture_free(vr_eye_images[side][i]);
+			vr_eye_images[side][i] = NULL;
+		}
+		vr_eye_images_len[side] = 0;
+		vr_eye_image_acquired[side] = 0;
+	}
+
+	vr.direct_rendering = 0;
+}
+
+/* Render the eyes into the device-owned images directly, if the VR dll supports it. */
+static void vr_eye_images_create(void)
+{
+	if (!vr_dll_get_eye_images || !vr_dll_acquire_eye_image) {
+		return;
+	}
+
+	for (int side = 0; side < VR_SIDES; ++side) {
+		uint images[VR_MAX_EYE_IMAGES];
+		int count = VR_MAX_EYE_IMAGES;
+		if (vr_dll_get_eye_images(side, images, &count) || count <= 0) {
+			vr_eye_images_free();
+			return;
+		}
+
+		for (int i = 0; i < count; ++i) {
+			GPUTexture *image = GPU_texture_from_bindcode(GL_TEXTURE_2D, images[i]);
+			vr_eye_images[side][vr_eye_images_len[side]++] = image;
+			if (image->w != vr.tex_width || image->h != vr.tex_height) {
+				vr_eye_images_free();
+				return;
+			}
+			/* Same format as the offscreen color texture, for attaching it instead. */
+			image->format = GPU_RGBA8;
+			image->format_flag = GPU_FORMAT_2D;
+			image->components = 4;
+		}
+	}
+
+	vr.direct_rendering = 1;
+}
+
 int vr_init(bContext *C)
 {
   memset(&vr, 0, sizeof(vr));
@@ -573,7 +737,12 @@ int vr_init(bContext *C)
   int type;
   int autodetect = (U.vr_device == 0);
 
-  if (U.vr_openxr) {
+  if (vr_simulated_trace_path()) {
+    /* Replay a recorded session instead of using the VR device. */
+    type = VR_TYPE_SIMULATED;
+    autodetect = 0;
+  }
+  else if (U.vr_openxr) {
     switch ((VR_Device_Type)U.vr_device) {
     case VR_DEVICE_TYPE_MAGICLEAP: {
       type = VR_TYPE_MAGICLEAP;
@@ -678,6 +847,15 @@ int vr_init(bContext *C)
 
         vr.ctx = C;
         vr.initialized = 1;
+
+        BLI_mutex_lock(&vr_dll_tracking_mutex);
+        vr_dll_tracking_available = 1;
+        BLI_mutex_unlock(&vr_dll_tracking_mutex);
+
+        /* OpenXR locates all poses at the predicted display time.
+         * Simulated poses are replayed as recorded. */
+        vr_predict_poses = (vr.type != VR_TYPE_OPENXR && vr.type != VR_TYPE_SIMULATED);
+        vr_api_predict_reset();
       }
       else {
         vr_dll_uninit_vr();
@@ -742,6 +920,11 @@ int vr_init_ui(void)
       vr_dll_get_controller_states(vr.controller);
     } 
 		vr.ui_initialized = 1;
+
+		if (vr.type != VR_TYPE_MAGICLEAP && vr.type != VR_TYPE_SIMULATED) {
+			/* Record the session for replaying it with the simulated VR device. */
+			vr_trace_record_begin();
+		}
 	}
 
 	if (!vr.ui_initialized) {
@@ -758,6 +941,7 @@ int vr_uninit(void)
 	BLI_assert(vr.initialized);
 
 	if (vr.ui_initialized) {
+		vr_trace_record_end();
 		vr_api_uninit_ui();
 		/* Free controller structs. */
 		for (int i = 0; i < VR_MAX_CONTROLLERS; ++i) {
@@ -773,7 +957,13 @@ int vr_uninit(void)
     vr_api_uninit_remote(0);
   }
   else {
+    /* The images are destroyed with the swapchains of the VR dll. */
+    vr_eye_images_free();
+
+    BLI_mutex_lock(&vr_dll_tracking_mutex);
+    vr_dll_tracking_available = 0;
     vr_dll_uninit_vr();
+    BLI_mutex_unlock(&vr_dll_tracking_mutex);
   }
 
   /* Free viewports. */
@@ -787,6 +977,7 @@ int vr_uninit(void)
   vr.ctx = NULL;
   vr.initialized = 0;
   vr.type = VR_TYPE_NULL;
+  vr_predict_poses = 0;
   vr.device_type = VR_DEVICE_TYPE_NULL;
 
 	int error = vr_unload_dll_functions();
@@ -816,6 +1007,8 @@ int vr_create_viewports(struct ARegion* ar)
 			vr.viewport[i] = ar->draw_buffer->viewport[i] = GPU_viewport_create_from_offscreen(vr.offscreen[i]);
 		}
 
+		vr_eye_images_create();
+
 		RegionView3D *rv3d = ar->regiondata;
 		if (!rv3d) {
 			return -1;
@@ -834,6 +1027,8 @@ int vr_create_viewports(struct ARegion* ar)
 void vr_free_viewports(ARegion *ar)
 {
 	if (ar->draw_buffer) {
+		vr_eye_images_free();
+
 		for (int side = 0; side < 2; ++side) {
 			if (vr.offscreen[side]) {
 				GPU_offscreen_free(vr.offscreen[side]);
@@ -865,6 +1060,20 @@ void vr_draw_region_bind(ARegion *ar, int side)
 	rect.ymin = 0;
 	rect.ymax = vr.tex_height;
 
+	vr_stage_begin((side == VR_SIDE_LEFT) ? VR_SIMULATED_STAGE_DRAW_LEFT : VR_SIMULATED_STAGE_DRAW_RIGHT);
+
+	if (vr.direct_rendering && !vr_eye_image_acquired[side]) {
+		/* Render into the image the VR dll presents next, instead of blitting into it. */
+		int index;
+		if (!vr_dll_acquire_eye_image(side, &index) && index >= 0 && index < vr_eye_images_len[side]) {
+			vr_eye_image_attach(side, vr_eye_images[side][index]);
+			vr_eye_image_acquired[side] = 1;
+		}
+		else {
+			vr_eye_image_attach(side, NULL);
+		}
+	}
+
 	GPU_viewport_bind(vr.viewport[side], &rect);
 
 	ar->draw_buffer->bound_view = side;
@@ -881,18 +1090,23 @@ void vr_draw_region_unbind(ARegion *ar, int side)
 	ar->draw_buffer->bound_view = -1;
 
 	GPU_viewport_unbind(vr.viewport[side]);
+
+	vr_stage_end((side == VR_SIDE_LEFT) ? VR_SIMULATED_STAGE_DRAW_LEFT : VR_SIMULATED_STAGE_DRAW_RIGHT);
 }
 
 int vr_update_tracking(void)
 {
 	BLI_assert(vr.initialized);
 
-  int error;
+  int error = 0;
+
+  vr_stage_begin(VR_SIMULATED_STAGE_TRACKING);
 
   if (vr.type == VR_TYPE_MAGICLEAP) {
     vr_api_get_transforms_remote();
   }
   else {
+    BLI_mutex_lock(&vr_dll_tracking_mutex);
     error = vr_dll_update_tracking_vr();
 
     /* Get hmd and eye positions. */
@@ -901,6 +1115,7 @@ int vr_update_tracking(void)
 
     /* Get controller positions. */
     vr_dll_get_controller_positions(vr.t_controller[VR_SPACE_REAL]);
+    BLI_mutex_unlock(&vr_dll_tracking_mutex);
   }
 
 	if (vr.ui_initialized) {
@@ -911,7 +1126,16 @@ int vr_update_tracking(void)
     else {
       vr_dll_get_controller_states(vr.controller);
     }
+    /* Record the tracked (not predicted) state. */
+    vr_trace_record_frame();
+	}
+
+  /* Predict the poses to when the frame is displayed. */
+  if (vr_predict_poses && !error) {
+    vr_api_predict_tracking(PIL_check_seconds_timer());
+  }
 
+	if (vr.ui_initialized) {
 		/* Update the UI. */
 		error = vr_api_update_tracking_ui();
 	}
@@ -923,6 +1147,38 @@ int vr_update_tracking(void)
 		vr.tracking = 1;
 	}
 
+	vr_stage_end(VR_SIMULATED_STAGE_TRACKING);
+
+	return error;
+}
+
+void vr_update_eye_tracking(int side)
+{
+	BLI_assert(vr.initialized);
+
+	if (!vr_predict_poses || !vr.tracking) {
+		return;
+	}
+
+	/* Late-latch: the time until the frame is submitted is known best right before drawing. */
+	vr_api_predict_eye(side, PIL_check_seconds_timer());
+}
+
+int vr_can_poll_controller_positions(void)
+{
+	return vr_dll_sample_controller_positions != NULL;
+}
+
+int vr_poll_controller_positions(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+	int error = -1;
+
+	BLI_mutex_lock(&vr_dll_tracking_mutex);
+	if (vr_dll_tracking_available && vr_dll_sample_controller_positions) {
+		error = vr_dll_sample_controller_positions(t_controller);
+	}
+	BLI_mutex_unlock(&vr_dll_tracking_mutex);
+
 	return error;
 }
 
@@ -936,12 +1192,27 @@ int vr_blit(void)
 
 	int error;
 
+	vr_stage_begin(VR_SIMULATED_STAGE_BLIT);
 #if WITH_VR
-	vr_dll_blit_eyes((void*)(&(vr.viewport[VR_SIDE_LEFT]->fbl->default_fb->attachments[2].tex->bindcode)),
-			     	 (void*)(&(vr.viewport[VR_SIDE_RIGHT]->fbl->default_fb->attachments[2].tex->bindcode)),
-					 &vr.aperture_u, &vr.aperture_v);
+	/* Nothing to blit if both eyes were rendered into the images of the VR dll. */
+	if (!vr_eye_image_acquired[VR_SIDE_LEFT] || !vr_eye_image_acquired[VR_SIDE_RIGHT]) {
+		vr_dll_blit_eyes((void*)(&(vr.viewport[VR_SIDE_LEFT]->fbl->default_fb->attachments[2].tex->bindcode)),
+				 (void*)(&(vr.viewport[VR_SIDE_RIGHT]->fbl->default_fb->attachments[2].tex->bindcode)),
+				 &vr.aperture_u, &vr.aperture_v);
+	}
 #endif
+	/* The images are released when submitting. */
+	for (int side = 0; side < VR_SIDES; ++side) {
+		if (vr_eye_image_acquired[side]) {
+			vr_eye_image_detach(side);
+		}
+	}
 	error = vr_dll_submit_frame();
+	vr_stage_end(VR_SIMULATED_STAGE_BLIT);
+
+	if (vr_predict_poses) {
+		vr_api_predict_submit(PIL_check_seconds_timer());
+	}
 
 	return error;
 }
@@ -963,7 +1234,9 @@ void vr_do_interaction(void)
 {
 	BLI_assert(vr.ui_initialized);
 
+	vr_stage_begin(VR_SIMULATED_STAGE_INTERACTION);
 	vr_api_execute_operations();
+	vr_stage_end(VR_SIMULATED_STAGE_INTERACTION);
 }
 
 void vr_do_post_render_interaction(void)
@@ -973,6 +1246,50 @@ void vr_do_post_render_interaction(void)
 	vr_api_execute_post_render_operations();
 }
 
+int vr_replay(bContext *C)
+{
+  if (vr.type != VR_TYPE_SIMULATED || !vr.ui_initialized) {
+    return 0;
+  }
+  const int num_frames = vr_simulated_replay_begin();
+  if (num_frames <= 0) {
+    return 0;
+  }
+
+  Main *bmain = CTX_data_main(C);
+  Depsgraph *depsgraph = CTX_data_depsgraph_pointer(C);
+  float viewmat[4][4], viewinv[4][4];
+
+  const double time_start = PIL_check_seconds_timer();
+  for (int i = 0; i < num_frames; ++i) {
+    vr_update_tracking();
+    vr_do_interaction();
+
+    vr_stage_begin(VR_SIMULATED_STAGE_UPDATE);
+    /* The eye matrices the draw manager would pass for each eye (the projections are the ones
+     * of the last drawn frame). */
+    for (int side = 0; side < VR_SIDES; ++side) {
+      vr_compute_viewmat(side, viewmat);
+      invert_m4_m4(viewinv, viewmat);
+      vr_update_view_matrix(side, viewinv);
+    }
+    vr_do_post_render_interaction();
+    /* Evaluate the changes, as the event loop does before the next redraw. */
+    BKE_scene_graph_update_tagged(depsgraph, bmain);
+    vr_stage_end(VR_SIMULATED_STAGE_UPDATE);
+
+    vr_simulated_frame_end();
+  }
+  const double duration = PIL_check_seconds_timer() - time_start;
+
+  vr_simulated_replay_end();
+  printf("VR replay: %d frames in %.3f s (%.1f frames/s)\n",
+         num_frames,
+         duration,
+         (duration > 0.0) ? num_frames / duration : 0.0);
+  return 1;
+}
+
 void vr_update_view_matrix(int side, const float view[4][4])
 {
 	BLI_assert(vr.ui_initialized);
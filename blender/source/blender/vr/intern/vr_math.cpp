@@ -113,22 +113,25 @@ void mat44_multiply(float R[4][4], const float A[4][4], const float B[4][4])
 static void mat44_multiply_unique(double R[4][4], const double A[4][4], const double B[4][4])
 {
 	/* matrix product: R[j][k] = A[j][i] . B[i][k] */
-	__m128d A0 = _mm_loadu_pd(A[0]);
-	__m128d A1 = _mm_loadu_pd(A[1]);
-	__m128d A2 = _mm_loadu_pd(A[2]);
-	__m128d A3 = _mm_loadu_pd(A[3]);
-
-	for (int i = 0; i < 4; i++) {
-		__m128d B0 = _mm_set1_pd(B[i][0]);
-		__m128d B1 = _mm_set1_pd(B[i][1]);
-		__m128d B2 = _mm_set1_pd(B[i][2]);
-		__m128d B3 = _mm_set1_pd(B[i][3]);
-
-		__m128d sum = _mm_add_pd(
-			_mm_add_pd(_mm_mul_pd(B0, A0), _mm_mul_pd(B1, A1)),
-			_mm_add_pd(_mm_mul_pd(B2, A2), _mm_mul_pd(B3, A3)));
-
-		_mm_storeu_pd(R[i], sum);
+	/* An SSE2 register holds two doubles: columns 0-1 and 2-3 separately. */
+	for (int c = 0; c < 4; c += 2) {
+		__m128d A0 = _mm_loadu_pd(&A[0][c]);
+		__m128d A1 = _mm_loadu_pd(&A[1][c]);
+		__m128d A2 = _mm_loadu_pd(&A[2][c]);
+		__m128d A3 = _mm_loadu_pd(&A[3][c]);
+
+		for (int i = 0; i < 4; i++) {
+			__m128d B0 = _mm_set1_pd(B[i][0]);
+			__m128d B1 = _mm_set1_pd(B[i][1]);
+			__m128d B2 = _mm_set1_pd(B[i][2]);
+			__m128d B3 = _mm_set1_pd(B[i][3]);
+
+			__m128d sum = _mm_add_pd(
+				_mm_add_pd(_mm_mul_pd(B0, A0), _mm_mul_pd(B1, A1)),
+				_mm_add_pd(_mm_mul_pd(B2, A2), _mm_mul_pd(B3, A3)));
+
+			_mm_storeu_pd(&R[i][c], sum);
+		}
 	}
 }
 static void mat44_pre_multiply(double R[4][4], const double A[4][4])
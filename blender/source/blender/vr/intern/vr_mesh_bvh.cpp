@@ -0,0 +1,389 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_mesh_bvh.cpp
+*   \ingroup vr
+*
+* Cache of the BVH trees of the edit meshes.
+*/
+
+#include "vr_types.h"
+#include <vector>
+
+#include "vr_mesh_bvh.h"
+#include "vr_util.h"
+
+#include "BLI_kdopbvh.h"
+#include "BLI_math.h"
+
+#include "BKE_editmesh.h"
+#include "BKE_editmesh_bvh.h"
+
+#include "DNA_object_types.h"
+#include "DNA_view3d_types.h"
+
+#include "ED_view3d.h"
+
+#include "bmesh.h"
+
+/* Maximum number of cached trees (edit meshes of multi-object editing). */
+#define VR_MESH_BVH_CACHE_SIZE	8
+
+/* Cached tree of an edit mesh. */
+typedef struct VR_Mesh_BVH_Entry {
+	BMEditMesh	*em;	/* Edit mesh of the tree (only compared, it may have been freed since). */
+	BMesh	*bm;	/* BMesh the tree was built for (only compared, a new edit mesh can reuse the address of a freed one). */
+	uint	geom_version;	/* Geometry version of the edit mesh the tree is up to date with. */
+	uint	last_used;	/* Counter value of the last use (to evict the least recently used tree). */
+	BMBVHTree	*tree;	/* Tree of the visible faces (NULL if there are none). */
+	std::vector<BMLoop*>	looptris;	/* Triangulation the tree was built for. */
+	std::vector<bool>	tri_visible;	/* Whether each triangle is in the tree. */
+	std::vector<BMVert*>	loose_verts;	/* Visible vertices without faces (not in the tree). */
+	std::vector<BMEdge*>	wire_edges;	/* Visible edges without faces (not in the tree). */
+} VR_Mesh_BVH_Entry;
+
+static std::vector<VR_Mesh_BVH_Entry*> cache;
+static uint cache_counter = 0;
+
+/* Bring the tree of an entry up to date with the geometry of its edit mesh. */
+static void entry_update(VR_Mesh_BVH_Entry *entry, BMEditMesh *em)
+{
+	const uint tottri = (uint)em->tottri;
+
+	/* If the triangles and their visibility didn't change, only vertices moved and refitting the
+	 * bounds of the tree is enough. The tree keeps a pointer to the BMesh, so a different BMesh
+	 * always needs a new tree. */
+	bool refit = (entry->tree != NULL) && (entry->bm == em->bm) && (entry->looptris.size() == 3 * tottri) &&
+		(memcmp(&entry->looptris[0], em->looptris, sizeof(BMLoop*) * 3 * tottri) == 0);
+	for (uint i = 0; refit && i < tottri; ++i) {
+		if (entry->tri_visible[i] == (bool)BM_elem_flag_test(em->looptris[i][0]->f, BM_ELEM_HIDDEN)) {
+			refit = false;
+		}
+	}
+
+	if (refit) {
+		BKE_bmbvh_refit(entry->tree, em->looptris, BMBVH_RESPECT_HIDDEN);
+	}
+	else {
+		if (entry->tree) {
+			BKE_bmbvh_free(entry->tree);
+			entry->tree = NULL;
+		}
+		if (tottri) {
+			entry->looptris.assign(&em->looptris[0][0], &em->looptris[0][0] + 3 * tottri);
+		}
+		else {
+			entry->looptris.clear();
+		}
+		entry->tri_visible.resize(tottri);
+		bool any_visible = false;
+		for (uint i = 0; i < tottri; ++i) {
+			entry->tri_visible[i] = !BM_elem_flag_test(em->looptris[i][0]->f, BM_ELEM_HIDDEN);
+			any_visible |= entry->tri_visible[i];
+		}
+		if (any_visible) {
+			entry->tree = BKE_bmbvh_new_from_editmesh(em, BMBVH_RESPECT_HIDDEN, NULL, false);
+		}
+	}
+
+	entry->loose_verts.clear();
+	entry->wire_edges.clear();
+	BMIter iter;
+	BMVert *v;
+	BM_ITER_MESH (v, &iter, em->bm, BM_VERTS_OF_MESH) {
+		if (!BM_elem_flag_test(v, BM_ELEM_HIDDEN) && (!v->e || BM_vert_is_wire(v))) {
+			entry->loose_verts.push_back(v);
+		}
+	}
+	BMEdge *e;
+	BM_ITER_MESH (e, &iter, em->bm, BM_EDGES_OF_MESH) {
+		if (!BM_elem_flag_test(e, BM_ELEM_HIDDEN) && !e->l) {
+			entry->wire_edges.push_back(e);
+		}
+	}
+
+	entry->bm = em->bm;
+	entry->geom_version = em->geom_version;
+}
+
+/* Get the (up to date) entry of an edit mesh. */
+static VR_Mesh_BVH_Entry *cache_get(BMEditMesh *em)
+{
+	VR_Mesh_BVH_Entry *entry = NULL;
+	for (uint i = 0; i < cache.size(); ++i) {
+		if (cache[i]->em == em) {
+			entry = cache[i];
+			break;
+		}
+	}
+
+	if (!entry) {
+		if (cache.size() < VR_MESH_BVH_CACHE_SIZE) {
+			entry = new VR_Mesh_BVH_Entry();
+			entry->bm = NULL;
+			entry->tree = NULL;
+			cache.push_back(entry);
+		}
+		else {
+			entry = cache[0];
+			for (uint i = 1; i < cache.size(); ++i) {
+				if (cache[i]->last_used < entry->last_used) {
+					entry = cache[i];
+				}
+			}
+			if (entry->tree) {
+				BKE_bmbvh_free(entry->tree);
+				entry->tree = NULL;
+			}
+		}
+		entry->em = em;
+		entry_update(entry, em);
+	}
+	else if ((entry->bm != em->bm) || (entry->geom_version != em->geom_version)) {
+		entry_update(entry, em);
+	}
+
+	entry->last_used = ++cache_counter;
+	return entry;
+}
+
+BMBVHTree *VR_Mesh_BVH::get(BMEditMesh *em)
+{
+	return cache_get(em)->tree;
+}
+
+void VR_Mesh_BVH::clear()
+{
+	for (uint i = 0; i < cache.size(); ++i) {
+		if (cache[i]->tree) {
+			BKE_bmbvh_free(cache[i]->tree);
+		}
+		delete cache[i];
+	}
+	cache.clear();
+}
+
+/* State of a nearest-element query. */
+typedef struct NearestData {
+	BMEditMesh	*em;	/* Edit mesh searched. */
+	VR_Mesh_BVH::NearestType	type;	/* Element searched. */
+	float	pmat[4][4];	/* Object space to clip space. */
+	float	winsize[2];	/* Size of the view (pixels). */
+	float	mval[2];	/* Location searched (pixels from the bottom left). */
+	const RegionView3D	*rv3d_clip;	/* View to test the clipping region of (NULL if the view isn't clipped). */
+	float	obmat[4][4];	/* Object space to world space (for the clipping test). */
+	BMBVHTree	*occlusion_tree;	/* Tree to test occlusion with (NULL to not test occlusion). */
+	bool	is_persp;	/* Whether the view is a perspective view. */
+	float	view_co[3];	/* View location (perspective) or direction towards the viewer (orthographic), in object space. */
+	BMElem	*elem;	/* Nearest element found so far. */
+	float	dist;	/* Distance of the nearest element found so far. */
+} NearestData;
+
+/* Project an object-space location to pixels (from the bottom left). Returns false if it's behind the near clipping. */
+static bool nearest_project(const NearestData *data, const float co[3], float r_co[2])
+{
+	float vec4[4] = { co[0], co[1], co[2], 1.0f };
+	mul_m4_v4(data->pmat, vec4);
+	if (vec4[3] <= WIDGET_SELECT_RAYCAST_NEAR_CLIP) {
+		return false;
+	}
+	r_co[0] = data->winsize[0] * (vec4[0] / vec4[3] + 1.0f) / 2.0f;
+	r_co[1] = data->winsize[1] * (vec4[1] / vec4[3] + 1.0f) / 2.0f;
+	return true;
+}
+
+/* Faces the occlusion ray of an element is tested against (all but those using the element). */
+static bool nearest_occlusion_filter(BMFace *f, void *userdata)
+{
+	BMElem *elem = (BMElem*)userdata;
+	switch (elem->head.htype) {
+	case BM_VERT:
+		return !BM_vert_in_face((BMVert*)elem, f);
+	case BM_EDGE:
+		return !BM_edge_in_face((BMEdge*)elem, f);
+	default:
+		return ((BMElem*)f != elem);
+	}
+}
+
+/* Whether the view to an element (at co) is blocked by a face. */
+static bool nearest_is_occluded(const NearestData *data, BMElem *elem, const float co[3])
+{
+	float dir[3], dist;
+	if (data->is_persp) {
+		sub_v3_v3v3(dir, data->view_co, co);
+		dist = normalize_v3(dir);
+	}
+	else {
+		copy_v3_v3(dir, data->view_co);
+		dist = FLT_MAX;
+	}
+	return BKE_bmbvh_ray_cast_filter(data->occlusion_tree, co, dir, 0.0f, &dist, NULL, NULL, nearest_occlusion_filter, elem) != NULL;
+}
+
+/* Test an element against the nearest element found so far. */
+static void nearest_test_elem(NearestData *data, BMElem *elem)
+{
+	if (BM_elem_flag_test(elem, BM_ELEM_HIDDEN)) {
+		return;
+	}
+
+	float co[3], co_px[2], dist;
+	switch (data->type) {
+	case VR_Mesh_BVH::NEAREST_VERT: {
+		copy_v3_v3(co, ((BMVert*)elem)->co);
+		break;
+	}
+	case VR_Mesh_BVH::NEAREST_EDGE_CENTER:
+	case VR_Mesh_BVH::NEAREST_EDGE: {
+		BMEdge *e = (BMEdge*)elem;
+		mid_v3_v3v3(co, e->v1->co, e->v2->co);
+		break;
+	}
+	case VR_Mesh_BVH::NEAREST_FACE_CENTER:
+	default: {
+		BM_face_calc_center_median((BMFace*)elem, co);
+		break;
+	}
+	}
+
+	if (data->type == VR_Mesh_BVH::NEAREST_EDGE) {
+		BMEdge *e = (BMEdge*)elem;
+		float co_a[2], co_b[2];
+		if (!nearest_project(data, e->v1->co, co_a) || !nearest_project(data, e->v2->co, co_b)) {
+			return;
+		}
+		dist = sqrtf(dist_squared_to_line_segment_v2(data->mval, co_a, co_b));
+	}
+	else {
+		if (!nearest_project(data, co, co_px)) {
+			return;
+		}
+		dist = len_manhattan_v2v2(data->mval, co_px);
+	}
+	if (dist >= data->dist) {
+		return;
+	}
+
+	if (data->rv3d_clip) {
+		float co_world[3];
+		mul_v3_m4v3(co_world, data->obmat, co);
+		if (ED_view3d_clipping_test(data->rv3d_clip, co_world, false)) {
+			return;
+		}
+	}
+	if (data->occlusion_tree && nearest_is_occluded(data, elem, co)) {
+		return;
+	}
+
+	data->elem = elem;
+	data->dist = dist;
+}
+
+static void nearest_projected_cb(void *userdata, int index, const DistProjectedAABBPrecalc *, const float (*)[4], const int, BVHTreeNearest *nearest)
+{
+	NearestData *data = (NearestData*)userdata;
+	BMLoop **ltri = data->em->looptris[index];
+
+	switch (data->type) {
+	case VR_Mesh_BVH::NEAREST_VERT: {
+		for (int i = 0; i < 3; ++i) {
+			nearest_test_elem(data, (BMElem*)ltri[i]->v);
+		}
+		break;
+	}
+	case VR_Mesh_BVH::NEAREST_EDGE_CENTER:
+	case VR_Mesh_BVH::NEAREST_EDGE: {
+		/* Only the edges of the face (not the diagonals of the triangulation),
+		 * this way every edge is tested with one triangle. */
+		for (int i = 0; i < 3; ++i) {
+			if (ltri[i]->next == ltri[(i + 1) % 3]) {
+				nearest_test_elem(data, (BMElem*)ltri[i]->e);
+			}
+		}
+		break;
+	}
+	case VR_Mesh_BVH::NEAREST_FACE_CENTER:
+	default: {
+		nearest_test_elem(data, (BMElem*)ltri[0]->f);
+		break;
+	}
+	}
+
+	/* Manhattan distances are never smaller than the distance of the node bounds, so this only
+	 * skips nodes that can't contain a nearer element. */
+	nearest->dist_sq = data->dist * data->dist;
+}
+
+BMElem *VR_Mesh_BVH::find_nearest(BMEditMesh *em, Object *obedit, const RegionView3D *rv3d, const float winsize[2], const float mval[2], NearestType type, bool use_occlusion, float *r_dist)
+{
+	VR_Mesh_BVH_Entry *entry = cache_get(em);
+
+	NearestData data;
+	data.em = em;
+	data.type = type;
+	mul_m4_m4m4(data.pmat, rv3d->persmat, obedit->obmat);
+	copy_v2_v2(data.winsize, winsize);
+	copy_v2_v2(data.mval, mval);
+	data.rv3d_clip = (rv3d->rflag & RV3D_CLIPPING) ? rv3d : NULL;
+	copy_m4_m4(data.obmat, obedit->obmat);
+	data.occlusion_tree = use_occlusion ? entry->tree : NULL;
+	data.is_persp = rv3d->is_persp;
+	float imat[4][4];
+	invert_m4_m4(imat, obedit->obmat);
+	if (data.is_persp) {
+		mul_v3_m4v3(data.view_co, imat, rv3d->viewinv[3]);
+	}
+	else {
+		mul_v3_mat3_m4v3(data.view_co, imat, rv3d->viewinv[2]);
+		normalize_v3(data.view_co);
+	}
+	data.elem = NULL;
+	data.dist = *r_dist;
+
+	if (entry->tree) {
+		BVHTreeNearest nearest;
+		nearest.index = -1;
+		nearest.dist_sq = data.dist * data.dist;
+		BLI_bvhtree_find_nearest_projected(BKE_bmbvh_tree_get(entry->tree), data.pmat, data.winsize, data.mval, NULL, 0, &nearest, nearest_projected_cb, &data);
+	}
+
+	/* Elements without faces aren't in the tree. */
+	if (type == NEAREST_VERT) {
+		for (uint i = 0; i < entry->loose_verts.size(); ++i) {
+			nearest_test_elem(&data, (BMElem*)entry->loose_verts[i]);
+		}
+	}
+	else if (type != NEAREST_FACE_CENTER) {
+		for (uint i = 0; i < entry->wire_edges.size(); ++i) {
+			nearest_test_elem(&data, (BMElem*)entry->wire_edges[i]);
+		}
+	}
+
+	if (data.elem) {
+		*r_dist = data.dist;
+	}
+	return data.elem;
+}
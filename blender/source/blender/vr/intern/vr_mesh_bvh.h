@@ -0,0 +1,66 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_mesh_bvh.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_MESH_BVH_H__
+#define __VR_MESH_BVH_H__
+
+#include "vr_types.h"
+
+struct BMBVHTree;
+struct BMEditMesh;
+struct BMElem;
+struct Object;
+struct RegionView3D;
+
+/* Cache of the (occlusion) BVH trees of the edit meshes, shared by the VR element selection,
+ * loop cut and edge slide. A tree is kept per edit mesh and keyed on its geometry version
+ * (see BKE_editmesh_geom_changed()): as long as the mesh doesn't change, every frame reuses the
+ * same tree, and when only the vertex positions changed (transform), the tree is refit instead
+ * of built again. */
+class VR_Mesh_BVH
+{
+public:
+	/* Element a nearest-element query looks for. */
+	typedef enum NearestType
+	{
+		NEAREST_VERT	/* Nearest vertex. */
+		,
+		NEAREST_EDGE_CENTER	/* Nearest edge (by its center). */
+		,
+		NEAREST_EDGE	/* Nearest edge (by its projected segment). */
+		,
+		NEAREST_FACE_CENTER	/* Nearest face (by its center). */
+	} NearestType;
+
+	static BMBVHTree *get(BMEditMesh *em);	/* Get the tree of the visible faces of an edit mesh (NULL if it has no faces). */
+	static BMElem *find_nearest(BMEditMesh *em, Object *obedit, const RegionView3D *rv3d, const float winsize[2], const float mval[2], NearestType type, bool use_occlusion, float *r_dist);	/* Find the visible element nearest to mval (pixels from the bottom left of winsize, using rv3d->persmat) closer than *r_dist (pixels, manhattan distance for vertices / centers), optionally skipping occluded elements. Sets *r_dist to the distance of the element found. */
+	static void clear();	/* Free all cached trees. */
+};
+
+#endif /* __VR_MESH_BVH_H__ */
@@ -0,0 +1,418 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_mesh_region.cpp
+*   \ingroup vr
+*
+* Local re-evaluation of an edit-mesh operator over a drag.
+*/
+
+#include "vr_types.h"
+
+#include "vr_mesh_region.h"
+
+#include "BKE_editmesh.h"
+
+#include "bmesh.h"
+
+/* Maximum size of the region (in percent of the faces of the mesh) to edit it locally.
+ * Above that, restoring the whole mesh is about as fast and doesn't need the extra copy. */
+#define VR_MESH_REGION_MAX_FACES_PERCENT	50
+
+VR_Mesh_Region::VR_Mesh_Region()
+	: em(0)
+	, bm_orig(0)
+	, bm_work(0)
+	, active(false)
+{
+	//
+}
+
+VR_Mesh_Region::~VR_Mesh_Region()
+{
+	end();
+}
+
+/* Whether all faces using a vertex are in the region (tagged). */
+static bool vert_is_inner(BMVert *v)
+{
+	BMIter iter;
+	BMEdge *e;
+	BM_ITER_ELEM (e, &iter, v, BM_EDGES_OF_VERT) {
+		if (BM_edge_is_wire(e)) {
+			return false;
+		}
+	}
+	BMFace *f;
+	BM_ITER_ELEM (f, &iter, v, BM_FACES_OF_VERT) {
+		if (!BM_elem_flag_test(f, BM_ELEM_TAG)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/* Whether all faces using an edge are in the region (tagged). */
+static bool edge_is_inner(BMEdge *e)
+{
+	BMLoop *l_iter = e->l;
+	do {
+		if (!BM_elem_flag_test(l_iter->f, BM_ELEM_TAG)) {
+			return false;
+		}
+	} while ((l_iter = l_iter->radial_next) != e->l);
+	return true;
+}
+
+bool VR_Mesh_Region::begin(BMEditMesh *em)
+{
+	end();
+
+	BMesh *bm = em->bm;
+	BMIter iter, iter_elem;
+	BMVert *v;
+	BMFace *f;
+	BMLoop *l_iter, *l_first;
+
+	/* Selected vertices (loose ones can't be part of a region). */
+	std::vector<BMVert*> sel_verts;
+	BM_ITER_MESH (v, &iter, bm, BM_VERTS_OF_MESH) {
+		if (!BM_elem_flag_test(v, BM_ELEM_SELECT)) {
+			continue;
+		}
+		if (!v->e) {
+			return false;
+		}
+		sel_verts.push_back(v);
+	}
+	if (sel_verts.empty()) {
+		return false;
+	}
+
+	/* Faces of the region: all faces using a selected vertex. */
+	for (uint i = 0; i < sel_verts.size(); ++i) {
+		BM_ITER_ELEM (f, &iter_elem, sel_verts[i], BM_FACES_OF_VERT) {
+			BM_elem_flag_disable(f, BM_ELEM_TAG);
+		}
+	}
+	std::vector<BMFace*> region_faces;
+	for (uint i = 0; i < sel_verts.size(); ++i) {
+		BM_ITER_ELEM (f, &iter_elem, sel_verts[i], BM_FACES_OF_VERT) {
+			if (!BM_elem_flag_test(f, BM_ELEM_TAG)) {
+				BM_elem_flag_enable(f, BM_ELEM_TAG);
+				region_faces.push_back(f);
+			}
+		}
+	}
+
+	/* Vertices and edges of the region. */
+	std::vector<BMVert*> region_verts;
+	std::vector<BMEdge*> region_edges;
+	int totloop = 0;
+	for (uint i = 0; i < region_faces.size(); ++i) {
+		l_iter = l_first = BM_FACE_FIRST_LOOP(region_faces[i]);
+		do {
+			BM_elem_flag_disable(l_iter->v, BM_ELEM_TAG);
+			BM_elem_flag_disable(l_iter->e, BM_ELEM_TAG);
+		} while ((l_iter = l_iter->next) != l_first);
+	}
+	for (uint i = 0; i < region_faces.size(); ++i) {
+		l_iter = l_first = BM_FACE_FIRST_LOOP(region_faces[i]);
+		do {
+			if (!BM_elem_flag_test(l_iter->v, BM_ELEM_TAG)) {
+				BM_elem_flag_enable(l_iter->v, BM_ELEM_TAG);
+				region_verts.push_back(l_iter->v);
+			}
+			if (!BM_elem_flag_test(l_iter->e, BM_ELEM_TAG)) {
+				BM_elem_flag_enable(l_iter->e, BM_ELEM_TAG);
+				region_edges.push_back(l_iter->e);
+			}
+		} while ((l_iter = l_iter->next) != l_first);
+		totloop += region_faces[i]->len;
+	}
+	for (uint i = 0; i < region_verts.size(); ++i) {
+		BM_elem_flag_disable(region_verts[i], BM_ELEM_TAG);
+	}
+	for (uint i = 0; i < region_edges.size(); ++i) {
+		BM_elem_flag_disable(region_edges[i], BM_ELEM_TAG);
+	}
+
+	/* Inner vertices and edges are replaced by apply(), the ones on the boundary are kept.
+	 * A wire edge on an inner (i.e. selected) vertex would be lost, so edit the whole mesh then. */
+	bool local = (region_faces.size() * 100 <= (size_t)bm->totface * VR_MESH_REGION_MAX_FACES_PERCENT);
+	std::vector<bool> vert_inner(region_verts.size());
+	std::vector<bool> edge_inner(region_edges.size());
+	for (uint i = 0; local && i < region_verts.size(); ++i) {
+		vert_inner[i] = vert_is_inner(region_verts[i]);
+		if (BM_elem_flag_test(region_verts[i], BM_ELEM_SELECT) && !vert_inner[i]) {
+			local = false;
+		}
+	}
+	for (uint i = 0; local && i < region_edges.size(); ++i) {
+		edge_inner[i] = edge_is_inner(region_edges[i]);
+	}
+	for (uint i = 0; i < region_faces.size(); ++i) {
+		BM_elem_flag_disable(region_faces[i], BM_ELEM_TAG);
+	}
+	if (!local) {
+		return false;
+	}
+
+	/* Copy the region. */
+	BMAllocTemplate allocsize;
+	allocsize.totvert = (int)region_verts.size();
+	allocsize.totedge = (int)region_edges.size();
+	allocsize.totloop = totloop;
+	allocsize.totface = (int)region_faces.size();
+	BMeshCreateParams params = { 0 };
+	params.use_toolflags = true;
+	bm_orig = BM_mesh_create(&allocsize, &params);
+	BM_mesh_copy_init_customdata(bm_orig, bm, &allocsize);
+	bm_orig->selectmode = bm->selectmode;
+
+	std::vector<BMVert*> vtable(region_verts.size());
+	orig_boundary.resize(region_verts.size());
+	for (uint i = 0; i < region_verts.size(); ++i) {
+		v = region_verts[i];
+		vtable[i] = BM_vert_create(bm_orig, v->co, NULL, BM_CREATE_SKIP_CD);
+		BM_elem_attrs_copy_ex(bm, bm_orig, v, vtable[i], BM_ELEM_TAG, 0x0);
+		BM_elem_index_set(v, i); /* set_dirty! */
+		if (vert_inner[i]) {
+			orig_boundary[i] = 0;
+			verts.push_back(v);
+		}
+		else {
+			orig_boundary[i] = v;
+		}
+	}
+	std::vector<BMEdge*> etable(region_edges.size());
+	for (uint i = 0; i < region_edges.size(); ++i) {
+		BMEdge *e = region_edges[i];
+		etable[i] = BM_edge_create(bm_orig, vtable[BM_elem_index_get(e->v1)], vtable[BM_elem_index_get(e->v2)], NULL, BM_CREATE_SKIP_CD);
+		BM_elem_attrs_copy_ex(bm, bm_orig, e, etable[i], BM_ELEM_TAG, 0x0);
+		BM_elem_index_set(e, i); /* set_dirty! */
+		if (edge_inner[i]) {
+			edges.push_back(e);
+		}
+	}
+	bm->elem_index_dirty |= BM_VERT | BM_EDGE;
+
+	std::vector<BMVert*> f_verts;
+	std::vector<BMEdge*> f_edges;
+	for (uint i = 0; i < region_faces.size(); ++i) {
+		f = region_faces[i];
+		f_verts.clear();
+		f_edges.clear();
+		l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+		do {
+			f_verts.push_back(vtable[BM_elem_index_get(l_iter->v)]);
+			f_edges.push_back(etable[BM_elem_index_get(l_iter->e)]);
+		} while ((l_iter = l_iter->next) != l_first);
+
+		BMFace *f_new = BM_face_create(bm_orig, &f_verts[0], &f_edges[0], f->len, NULL, BM_CREATE_SKIP_CD);
+		BM_elem_attrs_copy_ex(bm, bm_orig, f, f_new, BM_ELEM_TAG, 0x0);
+		BMLoop *l_new = BM_FACE_FIRST_LOOP(f_new);
+		l_iter = l_first;
+		do {
+			BM_elem_attrs_copy(bm, bm_orig, l_iter, l_new);
+			l_new = l_new->next;
+		} while ((l_iter = l_iter->next) != l_first);
+		if (f == bm->act_face) {
+			bm_orig->act_face = f_new;
+		}
+	}
+
+	faces.swap(region_faces);
+	this->em = em;
+	active = true;
+	return true;
+}
+
+void VR_Mesh_Region::end()
+{
+	if (bm_work) {
+		BM_mesh_free(bm_work);
+		bm_work = 0;
+	}
+	if (bm_orig) {
+		BM_mesh_free(bm_orig);
+		bm_orig = 0;
+	}
+	orig_boundary.clear();
+	work_boundary.clear();
+	faces.clear();
+	edges.clear();
+	verts.clear();
+	vert_map.clear();
+	em = 0;
+	active = false;
+}
+
+bool VR_Mesh_Region::is_active() const
+{
+	return active;
+}
+
+uint VR_Mesh_Region::size() const
+{
+	return (uint)faces.size();
+}
+
+BMesh *VR_Mesh_Region::restore()
+{
+	if (!active) {
+		return 0;
+	}
+	if (bm_work) {
+		BM_mesh_free(bm_work);
+	}
+	bm_work = BM_mesh_copy(bm_orig);
+	bm_work->selectmode = bm_orig->selectmode;
+
+	/* The copy has the same order of elements. */
+	work_boundary.clear();
+	BMIter iter;
+	BMVert *v;
+	int i;
+	BM_ITER_MESH_INDEX (v, &iter, bm_work, BM_VERTS_OF_MESH, i) {
+		if (orig_boundary[i]) {
+			work_boundary.push_back(std::make_pair(v, orig_boundary[i]));
+		}
+	}
+	return bm_work;
+}
+
+bool VR_Mesh_Region::apply()
+{
+	if (!active || !bm_work) {
+		return false;
+	}
+	BMesh *bm = em->bm;
+	BMIter iter;
+	BMLoop *l_iter, *l_first;
+
+	/* Remove the current region (the kill functions leave the selection counts to the caller). */
+	for (uint i = 0; i < faces.size(); ++i) {
+		if (BM_elem_flag_test(faces[i], BM_ELEM_SELECT)) {
+			bm->totfacesel -= 1;
+		}
+		BM_face_kill(bm, faces[i]);
+	}
+	for (uint i = 0; i < edges.size(); ++i) {
+		if (BM_elem_flag_test(edges[i], BM_ELEM_SELECT)) {
+			bm->totedgesel -= 1;
+		}
+		BM_edge_kill(bm, edges[i]);
+	}
+	for (uint i = 0; i < verts.size(); ++i) {
+		if (BM_elem_flag_test(verts[i], BM_ELEM_SELECT)) {
+			bm->totvertsel -= 1;
+		}
+		BM_vert_kill(bm, verts[i]);
+	}
+	faces.clear();
+	edges.clear();
+	verts.clear();
+
+	/* Vertices: keep the boundary, create the others. */
+	BM_mesh_elem_index_ensure(bm_work, BM_VERT);
+	vert_map.assign(bm_work->totvert, 0);
+	for (uint i = 0; i < work_boundary.size(); ++i) {
+		vert_map[BM_elem_index_get(work_boundary[i].first)] = work_boundary[i].second;
+		BM_elem_select_copy(bm, work_boundary[i].second, work_boundary[i].first);
+	}
+	BMVert *v;
+	int i;
+	BM_ITER_MESH_INDEX (v, &iter, bm_work, BM_VERTS_OF_MESH, i) {
+		if (vert_map[i]) {
+			continue;
+		}
+		BMVert *v_new = BM_vert_create(bm, v->co, NULL, BM_CREATE_SKIP_CD);
+		BM_elem_attrs_copy_ex(bm_work, bm, v, v_new, BM_ELEM_TAG, 0x0);
+		vert_map[i] = v_new;
+		verts.push_back(v_new);
+	}
+
+	/* Edges: edges between boundary vertices may still exist. */
+	BMEdge *e;
+	BM_ITER_MESH (e, &iter, bm_work, BM_EDGES_OF_MESH) {
+		BMVert *v1 = vert_map[BM_elem_index_get(e->v1)];
+		BMVert *v2 = vert_map[BM_elem_index_get(e->v2)];
+		BMEdge *e_new = BM_edge_exists(v1, v2);
+		if (e_new) {
+			BM_elem_select_copy(bm, e_new, e);
+		}
+		else {
+			e_new = BM_edge_create(bm, v1, v2, NULL, BM_CREATE_SKIP_CD);
+			BM_elem_attrs_copy_ex(bm_work, bm, e, e_new, BM_ELEM_TAG, 0x0);
+			edges.push_back(e_new);
+		}
+	}
+
+	/* Faces. */
+	std::vector<BMVert*> f_verts;
+	BMFace *f;
+	BM_ITER_MESH (f, &iter, bm_work, BM_FACES_OF_MESH) {
+		f_verts.clear();
+		l_iter = l_first = BM_FACE_FIRST_LOOP(f);
+		do {
+			f_verts.push_back(vert_map[BM_elem_index_get(l_iter->v)]);
+		} while ((l_iter = l_iter->next) != l_first);
+
+		BMFace *f_new = BM_face_create_verts(bm, &f_verts[0], f->len, NULL, BM_CREATE_SKIP_CD, false);
+		if (!f_new) {
+			/* The region can't be rebuilt (the elements created so far are replaced by the next apply()). */
+			return false;
+		}
+		BM_elem_attrs_copy_ex(bm_work, bm, f, f_new, BM_ELEM_TAG, 0x0);
+		BMLoop *l_new = BM_FACE_FIRST_LOOP(f_new);
+		l_iter = l_first;
+		do {
+			BM_elem_attrs_copy(bm_work, bm, l_iter, l_new);
+			l_new = l_new->next;
+		} while ((l_iter = l_iter->next) != l_first);
+		if (f == bm_work->act_face) {
+			bm->act_face = f_new;
+		}
+		faces.push_back(f_new);
+	}
+
+	/* Normals of the region (the ones of the faces around the boundary don't change). */
+	for (uint i = 0; i < faces.size(); ++i) {
+		BM_face_normal_update(faces[i]);
+	}
+	for (uint i = 0; i < verts.size(); ++i) {
+		BM_vert_normal_update(verts[i]);
+	}
+	for (uint i = 0; i < work_boundary.size(); ++i) {
+		BM_vert_normal_update(work_boundary[i].second);
+	}
+	return true;
+}
+
+bool VR_Mesh_Region::cancel()
+{
+	return (restore() && apply());
+}
@@ -0,0 +1,78 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_mesh_region.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_MESH_REGION_H__
+#define __VR_MESH_REGION_H__
+
+#include "vr_types.h"
+
+#include <utility>
+#include <vector>
+
+struct BMEditMesh;
+struct BMesh;
+struct BMVert;
+struct BMEdge;
+struct BMFace;
+
+/* Local re-evaluation of an edit-mesh operator over a drag (see Widget_Bevel / Widget_InsetFaces).
+ * On begin(), the region of the mesh around the selection (all faces using a selected vertex, i.e.
+ * the selection and its one-ring) is copied into a small BMesh. Each frame, restore() resets that
+ * sub-mesh to the copy so the operator can run on it, and apply() replaces the region of the edit
+ * mesh by the result, keeping the vertices / edges on the region boundary (shared with the rest of
+ * the mesh) untouched. This way a frame only costs as much as the selection, instead of restoring
+ * and re-evaluating the whole mesh. */
+class VR_Mesh_Region
+{
+public:
+	VR_Mesh_Region();	/* Constructor. */
+	~VR_Mesh_Region();	/* Destructor. */
+
+	bool begin(BMEditMesh *em);	/* Copy the region around the selection. Returns false if the selection can't be edited locally (loose / wire geometry, or most of the mesh), in which case the caller has to restore the whole mesh instead. */
+	void end();	/* End the session (the edit mesh keeps its current state). */
+	bool is_active() const;	/* Whether a session is active. */
+	uint size() const;	/* Number of faces of the region. */
+
+	BMesh *restore();	/* Reset the sub-mesh to the copy of the region and return it (to run an operator on). */
+	bool apply();	/* Replace the region of the edit mesh by the sub-mesh. Returns false if a face of the sub-mesh can't be created in the edit mesh, in which case the caller has to cancel() and edit the whole mesh instead. */
+	bool cancel();	/* Write the original region back to the edit mesh. */
+protected:
+	BMEditMesh	*em;	/* Edit mesh of the region. */
+	BMesh	*bm_orig;	/* Copy of the region at begin(). */
+	BMesh	*bm_work;	/* Sub-mesh the operator runs on (a copy of bm_orig). */
+	std::vector<BMVert*>	orig_boundary;	/* Edit-mesh vertex of each vertex of bm_orig on the region boundary (0 for inner vertices). */
+	std::vector<std::pair<BMVert*, BMVert*> >	work_boundary;	/* Boundary vertices of bm_work and their edit-mesh vertices. */
+	std::vector<BMFace*>	faces;	/* Faces of the edit mesh in the region (replaced by apply()). */
+	std::vector<BMEdge*>	edges;	/* Inner edges of the edit mesh in the region. */
+	std::vector<BMVert*>	verts;	/* Inner vertices of the edit mesh in the region. */
+	std::vector<BMVert*>	vert_map;	/* Edit-mesh vertex of each vertex of bm_work (used by apply()). */
+	bool	active;	/* Whether a session is active. */
+};
+
+#endif /* __VR_MESH_REGION_H__ */
@@ -31,9 +31,12 @@
 #include "vr_main.h"
 
 #include "vr_network.h"
+#include "vr_network_resample.h"
 
 #include "BLI_math.h"
 
+#include "PIL_time.h"
+
 #include "DNA_userdef_types.h"
 
 #include "vr_api.h"
@@ -66,9 +69,6 @@
 #endif
 #include <ctime>
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
-
 /***************************************************************************************************
  * \class										VR_Network
  ***************************************************************************************************
@@ -76,14 +76,15 @@
  **************************************************************************************************/
  /* Port number used for streaming data. */
 #define VR_NETWORK_PORT_NUM	"27010"
+/* Time (seconds) after which sending / receiving is given up. */
+#define VR_NETWORK_SOCKET_TIMEOUT	1.0
 
 char VR_Network::control_sequence[] = { (char)-1, (char)0, (char)-1, (char)0 };
 bool VR_Network::initialized(false);
-std::atomic<bool> VR_Network::data_new;
-std::atomic<bool> VR_Network::img_processed;
 
 char VR_Network::recv_buf[VR_NETWORK_RECV_BUF_SIZE] = { 0 };
-char VR_Network::send_buf[VR_NETWORK_SEND_BUF_SIZE] = { 0 };
+VR_Network_PoseBuffer VR_Network::pose_buffer;
+VR_Network_SpectatorServer VR_Network::spectators;
 
 VR_Network::NetworkStatus VR_Network::network_status(NETWORKSTATUS_INACTIVE);
 
@@ -93,8 +94,19 @@ VR_Network::Thread::Condition VR_Network::condition;
 void *VR_Network::img_thread(0);
 VR_Network::Thread::Runlevel VR_Network::img_runlvl;
 VR_Network::Thread::Condition VR_Network::img_condition;
+void *VR_Network::pose_thread(0);
+VR_Network::Thread::Runlevel VR_Network::pose_runlvl;
+VR_Network::Thread::Condition VR_Network::pose_condition;
 
-VR_Network::ImageData VR_Network::image_data[VR_SIDES];
+VR_Network_FrameRing VR_Network::frame_ring;
+VR_Network::Latency VR_Network::latency = { 0.0f, 0.0f, 0.0f, 0.0f, 0, 0 };
+
+uint VR_Network::stream_width(0);
+uint VR_Network::stream_height(0);
+uint VR_Network::stream_depth(0);
+uint VR_Network::stream_fps(VR_NETWORK_DEFAULT_FPS);
+VR_Network_Encoder::Type VR_Network::stream_codec(VR_Network_Encoder::TYPE_ZLIB);
+VR_Network_Encoder *VR_Network::encoder[VR_SIDES] = { 0, 0 };
 
 std::vector<VR_Network::NetworkAdapter> VR_Network::network_adapters;
 
@@ -182,96 +194,102 @@ bool VR_Network::update_network_adapters()
 	return true;
 }
 
-bool VR_Network::set_image_size(uint width, uint height, uint depth)
+bool VR_Network::set_stream_params(uint width, uint height, uint fps, VR_Network_Encoder::Type codec)
 {
-	if (width == 0 || height == 0 || depth == 0) {
+	const uint depth = 4;
+	if (width == 0 || height == 0 || fps == 0) {
 		return false;
 	}
 
-	VR_Network::condition.enter();
-
-	/* Allocate bitmap buffer */
+	/* Create the encoders first, so that a failure leaves the current stream untouched. */
+	VR_Network_Encoder *encoder_new[VR_SIDES] = { 0, 0 };
 	for (int i = 0; i < VR_SIDES; ++i) {
-		ImageData& data = VR_Network::image_data[i];
-		data.w = width;
-		data.h = height;
-		data.d = depth;
-		if (data.buf) {
-			free(data.buf);
-		}
-		data.compressed_size = 0;
-		data.buf = (uchar*)malloc(width * height * depth);
-		if (!data.buf) {
-			data.w = data.h = data.d = 0;
-			VR_Network::condition.leave_silent();
+		encoder_new[i] = VR_Network_Encoder::create(codec, width, height, depth, fps);
+		if (!encoder_new[i]) {
+			for (int j = 0; j < i; ++j) {
+				delete encoder_new[j];
+			}
 			return false;
 		}
 	}
 
+	/* The slots are resized by the render thread on the next capture. */
+	VR_Network::condition.enter();
+	for (int i = 0; i < VR_SIDES; ++i) {
+		if (VR_Network::encoder[i]) {
+			delete VR_Network::encoder[i];
+		}
+		VR_Network::encoder[i] = encoder_new[i];
+	}
+	VR_Network::stream_width = width;
+	VR_Network::stream_height = height;
+	VR_Network::stream_depth = depth;
+	VR_Network::stream_fps = fps;
+	VR_Network::stream_codec = codec;
 	VR_Network::condition.leave_silent();
+
 	return true;
 }
 
-bool VR_Network::resample_pixels(const uchar *pixels, uint w_old, uint h_old,
-											  uchar *pixels_new, uint w_new, uint h_new, uint depth,
-											  const uint *depth_buffer)
+bool VR_Network::update_stream_params()
 {
-	if (!pixels || !pixels_new) {
-		return false;
+	uint width = U.vr_network_width > 0 ? (uint)U.vr_network_width : VR_NETWORK_DEFAULT_WIDTH;
+	uint height = U.vr_network_height > 0 ? (uint)U.vr_network_height : VR_NETWORK_DEFAULT_HEIGHT;
+	uint fps = U.vr_network_fps > 0 ? (uint)U.vr_network_fps : VR_NETWORK_DEFAULT_FPS;
+	VR_Network_Encoder::Type codec = (VR_Network_Encoder::Type)U.vr_network_codec;
+	if (codec >= VR_Network_Encoder::TYPES) {
+		codec = VR_Network_Encoder::TYPE_ZLIB;
 	}
 
-	/* Set alpha channel (used for alpha blend) based on depth buffer
-	 * to remove viewport background for see-through displays. */
-	bool depth_to_alpha = depth_buffer ? true : false;
-	uchar *depth_buffer_u8 = depth_buffer ? (uchar*)depth_buffer : NULL;
+	if (VR_Network::encoder[VR_SIDE_LEFT] && VR_Network::stream_width == width && VR_Network::stream_height == height &&
+		VR_Network::stream_fps == fps && VR_Network::stream_codec == codec) {
+		return true;
+	}
 
-	int size_old = (int)(w_old * h_old * depth);
-	float w_scale = (float)w_new / (float)w_old;
-	float h_scale = (float)h_new / (float)h_old;
-#pragma omp parallel for
-	for (int y = 0; y < (int)h_new; ++y) {
-		for (int x = 0; x < (int)w_new; ++x) {
-			/* NOTE: Vertical flip */
-			int pixel = (y * (w_new * depth) + ((w_new - x) * depth)) - depth;
-			int closest_pixel = ((int)((float)y / h_scale) * (w_old * depth)) + ((int)((float)x / w_scale) * depth);
-			/* NOTE: Horizontal flip */
-			/* RGBA */
-			int offset = (size_old - 1) - closest_pixel;
-			pixels_new[pixel] = pixels[offset + 1];
-			pixels_new[pixel + 1] = pixels[offset + 2];
-			pixels_new[pixel + 2] = pixels[offset + 3];
-			if (depth_to_alpha) {
-				/* Depth buffer is in <depth 24, stencil 8> format */
-				uint d_u32 = *(uint*)(&depth_buffer_u8[offset]);
-				float d = (d_u32 >> 8) / 16777215.0f;
-				if (d == 1.0f) { //|| d < VR_CLIP_NEAR || d > VR_CLIP_FAR) {
-					pixels_new[pixel + 3] = 0;
-				}
-				else {
-					pixels_new[pixel + 3] = 255;
-				}
-			}
-			else {
-				pixels_new[pixel + 3] = 255;
-			}
-		}
+	if (VR_Network::set_stream_params(width, height, fps, codec)) {
+		return true;
 	}
+	/* Codec not available in this build (or not for this resolution): fall back to zlib. */
+	return VR_Network::set_stream_params(width, height, fps, VR_Network_Encoder::TYPE_ZLIB);
+}
 
-	return true;
+void VR_Network::update_latency(const VR_Network_FrameRing::Slot& slot, double time_sent)
+{
+	Latency& l = VR_Network::latency;
+	if (l.frames_sent > 0 && slot.seq == l.seq) {
+		return;	/* re-sent frame */
+	}
+	/* Exponential moving average, so the status display does not flicker. */
+	const float w = (l.frames_sent == 0) ? 1.0f : 0.1f;
+	l.capture += w * ((float)((slot.time_captured - slot.time_capture) * 1000.0) - l.capture);
+	l.encode += w * ((float)((slot.time_encoded - slot.time_captured) * 1000.0) - l.encode);
+	l.send += w * ((float)((time_sent - slot.time_encoded) * 1000.0) - l.send);
+	l.total += w * ((float)((time_sent - slot.time_capture) * 1000.0) - l.total);
+	l.seq = slot.seq;
+	++l.frames_sent;
+}
+
+bool VR_Network::resample_pixels(const uchar *pixels, uint w_old, uint h_old,
+											  uchar *pixels_new, uint w_new, uint h_new, uint depth,
+											  const uint *depth_buffer)
+{
+	/* Set alpha channel (used for alpha blend) based on depth buffer
+	 * to remove viewport background for see-through displays. */
+	return VR_Network_Resample::resample(pixels, w_old, h_old, pixels_new, w_new, h_new, depth, depth_buffer);
 }
 
 bool VR_Network::start()
 {
 	if (!VR_Network::thread) {
 		VR_Network::initialized = false;
-		VR_Network::data_new = false;
-		VR_Network::img_processed = false;
+		VR_Network::frame_ring.reset();
+		VR_Network::pose_buffer.reset();
+		memset(&VR_Network::latency, 0, sizeof(VR_Network::latency));
 
-		/* Intialize image data. */
-		if (!VR_Network::set_image_size(320, 240, 4)) { //480, 360, 4)) { //640, 480, 4)) { //1280, 960, 4)) {
+		/* Intialize image data and encoders. */
+		if (!VR_Network::update_stream_params()) {
 			return false;
 		}
-		VR_Network::image_data[0].quality = VR_Network::image_data[1].quality = 100;
 
 		VR_Network::runlvl = Thread::RUNLEVEL_UNSTARTED;
 #ifdef WIN32
@@ -310,6 +328,32 @@ bool VR_Network::start()
 		}
 	}
 
+	if (!VR_Network::spectators.is_running() && U.vr_network_spectators && U.vr_network_ipaddr[0]) {
+		/* Spectators are optional (the headset stream works without the port) and opt-in, since
+		 * anyone who can reach the address may connect. */
+		VR_Network::spectators.max_fps = VR_Network::stream_fps;
+		VR_Network::spectators.start(U.vr_network_ipaddr, VR_NETWORK_SPECTATOR_PORT_NUM);
+	}
+
+	if (!VR_Network::pose_thread) {
+		VR_Network::pose_runlvl = Thread::RUNLEVEL_UNSTARTED;
+#ifdef WIN32
+		VR_Network::pose_thread = (void *)_beginthreadex(0, 0, &VR_Network::pose_thread_func, 0, 0, NULL);
+#else
+		VR_Network::pose_thread = (void*)Thread::create(&VR_Network::pose_thread_func);
+#endif
+		if (!VR_Network::pose_thread) {
+			return false;
+		}
+		/* Wait a moment to see if the thread is actually running */
+		VR_Network::pose_condition.enter();
+		VR_Network::pose_condition.wait(100);
+		VR_Network::pose_condition.leave_silent();
+		if (VR_Network::pose_runlvl != Thread::RUNLEVEL_RUNNING) {
+			return false;
+		}
+	}
+
 	return true;
 }
 
@@ -318,6 +362,7 @@ bool VR_Network::stop()
 	if (VR_Network::thread) {
 		VR_Network::runlvl = Thread::RUNLEVEL_TERMINATING;
 		/* Wake the thread and give it some time to terminate */
+		VR_Network::frame_ring.wake_all();
 		VR_Network::condition.enter();
 		VR_Network::condition.wait(100);
 		VR_Network::condition.leave_silent();
@@ -329,6 +374,7 @@ bool VR_Network::stop()
 	if (VR_Network::img_thread) {
 		VR_Network::img_runlvl = Thread::RUNLEVEL_TERMINATING;
 		/* Wake the thread and give it some time to terminate */
+		VR_Network::frame_ring.wake_all();
 		VR_Network::img_condition.enter();
 		VR_Network::img_condition.wait(100);
 		VR_Network::img_condition.leave_silent();
@@ -337,6 +383,19 @@ bool VR_Network::stop()
 		}
 	}
 
+	if (VR_Network::pose_thread) {
+		VR_Network::pose_runlvl = Thread::RUNLEVEL_TERMINATING;
+		/* The thread wakes up at least every 100ms, give it some time to terminate */
+		VR_Network::pose_condition.enter();
+		VR_Network::pose_condition.wait(150);
+		VR_Network::pose_condition.leave_silent();
+		if (VR_Network::pose_runlvl == Thread::RUNLEVEL_TERMINATING) {
+			/* TODO_XR: the thread did not properly terminate - kill it forcefully */
+		}
+	}
+
+	VR_Network::spectators.stop();
+
 	return true;
 }
 
@@ -352,9 +411,9 @@ bool VR_Network::receive_data(unsigned long long& socket)
 	char *recv_buf_ptr = VR_Network::recv_buf;
 	int bytes_received = 0;
 
-	clock_t start = clock();
+	const double start = PIL_check_seconds_timer();
 
-	while (bytes_received < VR_NETWORK_RECV_BUF_SIZE && (clock() - start) < CLOCKS_PER_SEC) {
+	while (bytes_received < VR_NETWORK_RECV_BUF_SIZE && (PIL_check_seconds_timer() - start) < VR_NETWORK_SOCKET_TIMEOUT) {
 		int ret;
 		if (!control_sequence_received) {
 			ret = recv(socket, control_sequence_buf_ptr, control_sequence_length - control_bytes_received, 0);	/* ret receives the number of bytes received, 0, or SOCKET_ERROR */
@@ -434,9 +493,9 @@ bool VR_Network::receive_data(int& socket)
 	char *recv_buf_ptr = VR_Network::recv_buf;
 	int bytes_received = 0;
 
-	clock_t start = clock();
+	const double start = PIL_check_seconds_timer();
 
-	while (bytes_received < VR_NETWORK_RECV_BUF_SIZE && (clock() - start) < CLOCKS_PER_SEC) {
+	while (bytes_received < VR_NETWORK_RECV_BUF_SIZE && (PIL_check_seconds_timer() - start) < VR_NETWORK_SOCKET_TIMEOUT) {
 		int ret;
 		if (!control_sequence_received) {
 			ret = recv(socket, control_sequence_buf_ptr, control_sequence_length - control_bytes_received, 0);	/* ret receives the number of bytes received, 0, or SOCKET_ERROR */
@@ -506,23 +565,18 @@ bool VR_Network::receive_data(int& socket)
 #endif
 
 #ifdef WIN32
-bool VR_Network::send_data(unsigned long long& socket)
+bool VR_Network::send_data(unsigned long long& socket, const VR_Network_FrameRing::Slot *slot)
 {
 	const int control_sequence_length = sizeof(VR_Network::control_sequence);
 	char *control_sequence_buf_ptr = VR_Network::control_sequence;
 	bool control_sequence_sent = false;
 	uint control_bytes_sent = 0;
 
-	static char local_buf[VR_NETWORK_SEND_BUF_SIZE];
-	static uint size_l = 0;
-	static uint size_r = 0;
-	if (VR_Network::img_processed) {
-		size_l = VR_Network::image_data[VR_SIDE_LEFT].compressed_size;
-		size_r = VR_Network::image_data[VR_SIDE_RIGHT].compressed_size;
-		memcpy(local_buf, VR_Network::send_buf, size_l);
-		memcpy(&local_buf[size_l], &VR_Network::send_buf[size_l], size_r);
-		VR_Network::img_processed = false;
-	}
+	/* The slot is owned by the networking thread until it is released,
+	 * so the encoded images are sent directly from the slot buffers.
+	 * Without a slot (no new frame for a stateful codec) an empty frame is sent. */
+	uint size_l = slot ? (uint)slot->encoded[VR_SIDE_LEFT].size() : 0;
+	uint size_r = slot ? (uint)slot->encoded[VR_SIDE_RIGHT].size() : 0;
 
 	const int size_sequence_length_l = 4;
 	char *size_sequence_buf_ptr_l = (char*)&size_l;
@@ -539,12 +593,11 @@ bool VR_Network::send_data(unsigned long long& socket)
 #else
 	const uint send_buf_size = 4;
 #endif
-	char *send_buf_ptr = local_buf;
 	uint bytes_sent = 0;
 
-	clock_t start = clock();
+	const double start = PIL_check_seconds_timer();
 
-	while (bytes_sent < send_buf_size && (clock() - start) < CLOCKS_PER_SEC) {
+	while ((!size_sequence_sent_r || bytes_sent < send_buf_size) && (PIL_check_seconds_timer() - start) < VR_NETWORK_SOCKET_TIMEOUT) {
 		int ret;
 		if (!control_sequence_sent) {
 			/* First try to send control sequence */
@@ -606,12 +659,12 @@ bool VR_Network::send_data(unsigned long long& socket)
 		}
 		else {
 			/* Size sequence sent, now send data */
-			ret = send(socket, send_buf_ptr, send_buf_size - bytes_sent, 0);
+			/* The left image is followed by the right image. */
+			const bool left = bytes_sent < size_l;
+			const char *send_buf_ptr = (const char*)&slot->encoded[left ? VR_SIDE_LEFT : VR_SIDE_RIGHT][0] + (left ? bytes_sent : bytes_sent - size_l);
+			ret = send(socket, send_buf_ptr, (left ? size_l : send_buf_size) - bytes_sent, 0);
 			if (ret > 0) {
 				bytes_sent += ret;
-				if (bytes_sent < send_buf_size) {
-					send_buf_ptr += ret;
-				}
 				continue; /* continue sending */
 			}
 		}
@@ -653,35 +706,39 @@ bool VR_Network::send_data(unsigned long long& socket)
 	}
 }
 #else
-bool VR_Network::send_data(int& socket)
+bool VR_Network::send_data(int& socket, const VR_Network_FrameRing::Slot *slot)
 {
 	const int control_sequence_length = sizeof(VR_Network::control_sequence);
 	char *control_sequence_buf_ptr = VR_Network::control_sequence;
 	bool control_sequence_sent = false;
 	int control_bytes_sent = 0;
 
+	/* The slot is owned by the networking thread until it is released,
+	 * so the encoded images are sent directly from the slot buffers.
+	 * Without a slot (no new frame for a stateful codec) an empty frame is sent. */
+	uint size_l = slot ? (uint)slot->encoded[VR_SIDE_LEFT].size() : 0;
+	uint size_r = slot ? (uint)slot->encoded[VR_SIDE_RIGHT].size() : 0;
+
 	const int size_sequence_length_l = 4;
-	char *size_sequence_buf_ptr_l = (char*)& VR_Network::image_data[VR_SIDE_LEFT].compressed_size;
+	char *size_sequence_buf_ptr_l = (char*)&size_l;
 	bool size_sequence_sent_l = false;
 	int size_bytes_sent_l = 0;
 
 	const int size_sequence_length_r = 4;
-	char *size_sequence_buf_ptr_r = (char*)& VR_Network::image_data[VR_SIDE_RIGHT].compressed_size;
+	char *size_sequence_buf_ptr_r = (char*)&size_r;
 	bool size_sequence_sent_r = false;
 	int size_bytes_sent_r = 0;
 
 #if VR_NETWORK_IMAGE_STREAMING
-	const int send_buf_size = VR_Network::image_data[VR_SIDE_LEFT].compressed_size +
-							  VR_Network::image_data[VR_SIDE_RIGHT].compressed_size;
+	const int send_buf_size = (int)(size_l + size_r);
 #else
 	const int send_buf_size = 4;
 #endif
-	char *send_buf_ptr = VR_Network::send_buf;
 	int bytes_sent = 0;
 
-	clock_t start = clock();
+	const double start = PIL_check_seconds_timer();
 
-	while (bytes_sent < send_buf_size && (clock() - start) < CLOCKS_PER_SEC) {
+	while ((!size_sequence_sent_r || bytes_sent < send_buf_size) && (PIL_check_seconds_timer() - start) < VR_NETWORK_SOCKET_TIMEOUT) {
 		int ret;
 		if (!control_sequence_sent) {
 			/* First try to send control sequence */
@@ -743,12 +800,12 @@ bool VR_Network::send_data(int& socket)
 		}
 		else {
 			/* Control sequence sent, now send data */
-			ret = send(socket, send_buf_ptr, send_buf_size- bytes_sent, 0);
+			/* The left image is followed by the right image. */
+			const bool left = bytes_sent < (int)size_l;
+			const char *send_buf_ptr = (const char*)&slot->encoded[left ? VR_SIDE_LEFT : VR_SIDE_RIGHT][0] + (left ? bytes_sent : bytes_sent - (int)size_l);
+			ret = send(socket, send_buf_ptr, (left ? (int)size_l : send_buf_size) - bytes_sent, 0);
 			if (ret > 0) {
 				bytes_sent += ret;
-				if (bytes_sent < send_buf_size) {
-					send_buf_ptr += ret;
-				}
 				continue; /* continue sending */
 			}
 		}
@@ -887,6 +944,12 @@ uint __stdcall VR_Network::thread_func(void *data)
 
 		/* If we arrive here, the client successfully connected */
 		VR_Network::network_status = NETWORKSTATUS_CONNECTED;
+		VR_Network::pose_buffer.reset();
+		for (int i = 0; i < VR_SIDES; ++i) {
+			if (VR_Network::encoder[i]) {
+				VR_Network::encoder[i]->request_keyframe();
+			}
+		}
 
 		/* Enter the "wait-for-request-and-send-data" loop */
 		while (VR_Network::runlvl == Thread::RUNLEVEL_RUNNING && current_ip_address == U.vr_network_ipaddr) {
@@ -898,32 +961,22 @@ uint __stdcall VR_Network::thread_func(void *data)
 				VR_Network::initialized = true;
 			}
 
-			/* Get VR data and send to client */
-			VR_Network::condition.enter();	/* lock the data buffer */
-
+			/* Wait (a bit) for the next encoded frame.
+			 * The zlib codec is stateless, so the last frame is re-sent instead of an empty one. */
+			VR_Network_FrameRing::Slot *slot = NULL;
 #if VR_NETWORK_IMAGE_STREAMING
-			if (!VR_Network::img_processed) { /* wait a bit for the next update */
-				VR_Network::condition.wait(100);
-				if (!VR_Network::img_processed) {
-					//printf("timeout waiting for new data");
-				}
-			}
-#else
-			if (!VR_Network::data_new) { /* wait a bit for the next update */
-				VR_Network::condition.wait(100);
-				if (!VR_Network::data_new) {
-					//printf("timeout waiting for new data");
-				}
-			}
-			if (VR_Network::data_new) {
-				VR_Network::data_new = false;
-			}
+			slot = VR_Network::frame_ring.acquire_send(100, VR_Network::stream_codec == VR_Network_Encoder::TYPE_ZLIB);
 #endif
 
-			VR_Network::condition.leave_signal();	/* finished using the data buffer */
-
 			/* Send data */
-			if (!send_data(client_socket)) {
+			const bool sent = send_data(client_socket, slot);
+			if (slot) {
+				VR_Network::frame_ring.release_send(slot);
+				if (sent) {
+					VR_Network::update_latency(*slot, PIL_check_seconds_timer());
+				}
+			}
+			if (!sent) {
 				break; /*some problem sending the data (or: timeout) close and re-connect */
 			}
 		}
@@ -1052,6 +1105,12 @@ void VR_Network::thread_func()
 
 		/* If we arrive here, the client successfully connected */
 		VR_Network::network_status = NETWORKSTATUS_CONNECTED;
+		VR_Network::pose_buffer.reset();
+		for (int i = 0; i < VR_SIDES; ++i) {
+			if (VR_Network::encoder[i]) {
+				VR_Network::encoder[i]->request_keyframe();
+			}
+		}
 
 		/* Enter the "wait-for-request-and-send-data" loop */
 		while (VR_Network::runlvl == Thread::RUNLEVEL_RUNNING && current_ip_address == U.vr_network_ipaddr) {
@@ -1063,32 +1122,22 @@ void VR_Network::thread_func()
 				VR_Network::initialized = true;
 			}
 
-			/* Get VR data and send to client */
-			VR_Network::condition.enter();	/* lock the data buffer */
-
+			/* Wait (a bit) for the next encoded frame.
+			 * The zlib codec is stateless, so the last frame is re-sent instead of an empty one. */
+			VR_Network_FrameRing::Slot *slot = NULL;
 #if VR_NETWORK_IMAGE_STREAMING
-			if (!VR_Network::img_processed) { /* wait a bit for the next update */
-				VR_Network::condition.wait(100);
-				if (!VR_Network::img_processed) {
-					//printf("timeout waiting for new data");
-				}
-			}
-#else
-			if (!VR_Network::data_new) { /* wait a bit for the next update */
-				VR_Network::condition.wait(100);
-				if (!VR_Network::data_new) {
-					//printf("timeout waiting for new data");
-				}
-			}
-			if (VR_Network::data_new) {
-				VR_Network::data_new = false;
-			}
+			slot = VR_Network::frame_ring.acquire_send(100, VR_Network::stream_codec == VR_Network_Encoder::TYPE_ZLIB);
 #endif
 
-			VR_Network::condition.leave_signal();	/* finished using the data buffer */
-
 			/* Send data */
-			if (!send_data(client_socket)) {
+			const bool sent = send_data(client_socket, slot);
+			if (slot) {
+				VR_Network::frame_ring.release_send(slot);
+				if (sent) {
+					VR_Network::update_latency(*slot, PIL_check_seconds_timer());
+				}
+			}
+			if (!sent) {
 				break; /*some problem sending the data (or: timeout) close and re-connect */
 			}
 		}
@@ -1123,50 +1172,92 @@ void VR_Network::img_thread_func()
 	VR_Network::img_condition.leave_signal();
 
 	while (VR_Network::img_runlvl == Thread::RUNLEVEL_RUNNING) {
-		if (!VR_Network::data_new) {
-#ifdef WIN32
-			Sleep(100);
-#else
-			usleep(100000);
-#endif
+		/* Sleep until a new frame was captured and the previous one was handed to the sender
+		 * (inter-frame codecs must not drop encoded frames). */
+		VR_Network_FrameRing::Slot *slot = VR_Network::frame_ring.acquire_encode(100);
+		if (!slot) {
 			continue;
 		}
 
 		bool error[VR_SIDES] = { false, false };
-		uchar *out[VR_SIDES] = { 0, 0 };
-		int size[VR_SIDES] = { 0, 0 };
 
+		VR_Network::condition.enter();	/* lock the encoders */
+		const bool stream_zlib = (VR_Network::stream_codec == VR_Network_Encoder::TYPE_ZLIB);
 #pragma omp parallel for
 		for (int i = 0; i < VR_SIDES; ++i) {
-			ImageData& data = VR_Network::image_data[i];
-			out[i] = stbi_zlib_compress(data.buf, VR_NETWORK_SEND_BUF_SIZE_HALF, &size[i], data.quality);
+			VR_Network_Encoder *enc = VR_Network::encoder[i];
+			if (!enc || enc->width() != slot->w || enc->height() != slot->h || enc->depth() != slot->d) {
+				error[i] = true;
+				continue;
+			}
+			error[i] = !enc->encode(&slot->pixels[i][0], slot->encoded[i]);
 		}
-		if (error[VR_SIDE_LEFT] || error[VR_SIDE_RIGHT] ||
-			(size[VR_SIDE_LEFT] + size[VR_SIDE_RIGHT] > VR_NETWORK_SEND_BUF_SIZE)) {
-			goto loop_end;
+		if (error[VR_SIDE_LEFT] || error[VR_SIDE_RIGHT]) {
+			/* The client could not decode the next inter frame. */
+			for (int i = 0; i < VR_SIDES; ++i) {
+				if (VR_Network::encoder[i]) {
+					VR_Network::encoder[i]->request_keyframe();
+				}
+			}
 		}
-		if (!VR_Network::img_processed) {
-			ImageData& data_left = VR_Network::image_data[VR_SIDE_LEFT];
-			ImageData& data_right = VR_Network::image_data[VR_SIDE_RIGHT];
-			data_left.compressed_size = (uint)size[VR_SIDE_LEFT];
-			data_right.compressed_size = (uint)size[VR_SIDE_RIGHT];
-			memcpy(&VR_Network::send_buf, out[VR_SIDE_LEFT], data_left.compressed_size);
-			memcpy(&VR_Network::send_buf[data_left.compressed_size], out[VR_SIDE_RIGHT], data_right.compressed_size);
-			VR_Network::img_processed = true;
+		VR_Network::condition.leave_silent();
+
+		slot->time_encoded = PIL_check_seconds_timer();
+		/* Spectators get the same frame: it is handed to the spectator encoder thread, which encodes
+		 * each variant once for all spectators (the zlib images of the headset stream are re-used). */
+		if (VR_Network::spectators.wants_frame(slot->time_encoded)) {
+			VR_Network::spectators.submit(*slot, stream_zlib && !error[VR_SIDE_LEFT] && !error[VR_SIDE_RIGHT]);
 		}
+		VR_Network::frame_ring.publish_encode(slot, !error[VR_SIDE_LEFT] && !error[VR_SIDE_RIGHT]);
+	}
 
-loop_end:
-		for (int i = 0; i < VR_SIDES; ++i) {
-			if (out[i]) {
-				free(out[i]);
+	/* If we arrive here, runlevel was set to false */
+	VR_Network::img_thread = 0;
+#ifdef WIN32
+	return 0;
+#else
+	return;
+#endif
+}
+
+#ifdef WIN32
+uint __stdcall VR_Network::pose_thread_func(void *data)
+#else
+void VR_Network::pose_thread_func()
+#endif
+{
+	VR_Network::pose_runlvl = Thread::RUNLEVEL_RUNNING;
+	/* Wait for the creator thread to resume and notice that the current thread is running. */
+	VR_Network::pose_condition.enter();
+	VR_Network::pose_condition.wait(50);
+	VR_Network::pose_condition.leave_signal();
+
+	/* Poses arrive as datagrams, independently of the request / image stream (TCP), so a lost
+	 * packet doesn't stall tracking until it is re-sent. */
+	VR_Network_PoseChannel channel;
+	std::string current_ip_address;	/* the (local) IP address that we are currently using */
+
+	while (VR_Network::pose_runlvl == Thread::RUNLEVEL_RUNNING) {
+		if (!channel.is_open() || current_ip_address != U.vr_network_ipaddr) {
+			channel.close();
+			current_ip_address = U.vr_network_ipaddr;
+			if (current_ip_address.empty() || !channel.open(current_ip_address.c_str(), VR_NETWORK_POSE_PORT_NUM)) {
+				Thread::sleep(1000);
+				continue;
 			}
 		}
-
-		VR_Network::data_new = false;
+		/* Wake up regularly to notice termination and IP changes. */
+		if (channel.receive(VR_Network::pose_buffer, 100) < 0) {
+			channel.close();
+		}
 	}
 
 	/* If we arrive here, runlevel was set to false */
-	VR_Network::img_thread = 0;
+	channel.close();
+	VR_Network::pose_runlvl = Thread::RUNLEVEL_TERMINATED;
+	VR_Network::pose_thread = 0;
+	VR_Network::pose_condition.enter();
+	VR_Network::pose_condition.leave_signal();
 #ifdef WIN32
 	return 0;
 #else
@@ -1505,7 +1596,9 @@ int vr_api_get_params_remote()
 int vr_api_get_transforms_remote()
 {
 	VR& vr = *vr_get_obj();
-	VR_Network::NetworkData& data = *(VR_Network::NetworkData*)VR_Network::recv_buf;
+	VR_Network::NetworkData pose_data;
+	VR_Network::NetworkData& data = VR_Network::pose_buffer.sample(PIL_check_seconds_timer(), pose_data) ?
+		pose_data : *(VR_Network::NetworkData*)VR_Network::recv_buf;
 
 	memcpy(vr.t_eye[VR_SPACE_REAL], data.t_eye, sizeof(float) * 4 * 4 * 2);
 	memcpy(vr.t_hmd[VR_SPACE_REAL], data.t_hmd, sizeof(float) * 4 * 4);
@@ -1518,7 +1611,10 @@ int vr_api_get_transforms_remote()
 int vr_api_get_controller_states_remote()
 {
 	VR& vr = *vr_get_obj();
-	VR_Network::NetworkData& data = *(VR_Network::NetworkData*)VR_Network::recv_buf;
+	/* The latest states, so button presses aren't delayed by the playout delay of the poses. */
+	VR_Network::NetworkData pose_data;
+	VR_Network::NetworkData& data = VR_Network::pose_buffer.latest(pose_data) ?
+		pose_data : *(VR_Network::NetworkData*)VR_Network::recv_buf;
 
 	for (int i = 0; i < VR_MAX_CONTROLLERS; ++i) {
 		memcpy(vr.controller[i], &data.controller[i], sizeof(VR_Controller));
@@ -33,14 +33,17 @@
 #include "vr_types.h"
 #include "vr_main.h"
 
+#include "vr_network_codec.h"
+#include "vr_network_pose.h"
+#include "vr_network_ring.h"
+#include "vr_network_spectator.h"
+
 #include <string>
 #include <vector>
 #include <atomic>
 
-/* Size (bytes) of the VR data to send / receive. */
+/* Size (bytes) of the VR data to receive. */
 #define VR_NETWORK_RECV_BUF_SIZE	sizeof(VR_Network::NetworkData)
-#define VR_NETWORK_SEND_BUF_SIZE	614400 // 320*240*4*2 //1382400 // 480*360*4*2 //2457600 //640*480*4*2 //9830400 // 1280*960*4*2
-#define VR_NETWORK_SEND_BUF_SIZE_HALF 307200 // 320*240*4 //691200 // 480*360*4 //1228800 //640*480*4 //4915200 // 1280*960*4 
 
 /* Whether to enable image streaming. */
 #define VR_NETWORK_IMAGE_STREAMING 1
@@ -143,47 +146,42 @@ public:
   static std::vector<NetworkAdapter> network_adapters;	/* List of network adapters. */
   static bool update_network_adapters();	/* Update the current list of network adapters. */
 
- /* Network data to receive. */
-  typedef struct NetworkData {
-    VR_Device_Type device_type; /* Type of VR device used. */
-    int tracking;		/* Whether the VR tracking state is currently active/valid. */
-    float fx[VR_SIDES]; /* Horizontal focal length, in "image-width" - units(1 = image width). */
-    float fy[VR_SIDES]; /* Vertical focal length, in "image-height" - units(1 = image height). */
-    float cx[VR_SIDES]; /* Horizontal principal point, in "image-width" - units(0.5 = image center). */
-    float cy[VR_SIDES]; /* Vertical principal point, in "image-height" - units(0.5 = image center). */
-    int tex_width;		/* Default eye texture width. */
-    int tex_height;		/* Default eye texture height. */
-    float aperture_u;	/* The aperture of the texture(0~u) that contains the rendering. */
-    float aperture_v;	/* The aperture of the texture(0~v) that contains the rendering. */
-    float t_hmd[4][4];	/* Last tracked position of the HMD. */
-    float t_eye[VR_SIDES][4][4];	/* Last tracked position of the eyes. */
-    VR_Controller controller[VR_MAX_CONTROLLERS];		/* Controllers associated with the HMD device. */
-    float t_controller[VR_MAX_CONTROLLERS][4][4];	/* Last tracked positions of the controllers. */
-  } NetworkData;
-
-  /* Image data to send. */
-  typedef struct ImageData {
-    uint w;	/* Image width in pixels. */
-    uint h;	/* Image height in pixels. */
-    uint d; /* Image depth. */
-    uchar *buf;	/* Image buffer to receive the image pixel data to be sent. */
-    uint compressed_size;	/* Size of the encoded image buffer in bytes. */
-    uint quality; /* PNG compression quality. */
-  } ImageData;
-  static ImageData image_data[VR_SIDES];
-
-  static bool set_image_size(uint width, uint height, uint depth);	/* Set the desired image dimensions. */
+  /* Network data to receive. */
+  typedef VR_Network_TrackingData NetworkData;
+
+  /* Latency of the streaming pipeline (moving averages, in milliseconds). */
+  typedef struct Latency {
+    float capture;	/* Render thread: viewport readback and resampling. */
+    float encode;	/* Capture published -> encoding finished. */
+    float send;	/* Encoding finished -> frame sent to the client. */
+    float total;	/* Capture started -> frame sent to the client. */
+    uint frames_sent;	/* Number of frames sent since the stream was started. */
+    ui64 seq;	/* Sequence number of the last sent frame. */
+  } Latency;
+  static Latency latency;
+  static void update_latency(const VR_Network_FrameRing::Slot& slot, double time_sent);	/* Add a sent frame to the latency counters. */
+
+  static VR_Network_FrameRing frame_ring;	/* Frames handed from the render thread to the image and networking threads. */
+
+  static uint stream_width;	/* Width of the streamed eye images. */
+  static uint stream_height;	/* Height of the streamed eye images. */
+  static uint stream_depth;	/* Bytes per pixel of the streamed eye images. */
+  static uint stream_fps;	/* Maximum number of frames per second sent to the client. */
+  static VR_Network_Encoder::Type stream_codec;	/* Codec used for encoding the eye images. */
+  static VR_Network_Encoder *encoder[VR_SIDES];	/* Encoders (one per eye, since inter-frame codecs are stateful). */
+
+  static bool set_stream_params(uint width, uint height, uint fps, VR_Network_Encoder::Type codec);	/* Set image dimensions, frame rate and codec of the stream. */
+  static bool update_stream_params();	/* Apply the stream parameters from the user preferences (if changed). */
   static bool resample_pixels(const uchar *pixels, uint w_old, uint h_old,
     uchar *pixels_new, uint w_new, uint h_new, uint depth,
     const uint *depth_buffer = 0);	/* Image resampler helper function.*/
 
   static char recv_buf[VR_NETWORK_RECV_BUF_SIZE];	/* Buffer for receiving VR data. */
-  static char send_buf[VR_NETWORK_SEND_BUF_SIZE];	/* Buffer for sending VR data. */
+  static VR_Network_PoseBuffer pose_buffer;	/* Poses received over the pose channel (UDP), if the client sends them. */
+  static VR_Network_SpectatorServer spectators;	/* Streams of the captured frames to spectators (i.e. reviewers on laptops). */
 
   static char control_sequence[4];  /* Control sequence for sending / receiving network data. */
   static bool initialized;  /* Whether the VR params have been initialized / received from client device. */
-  static std::atomic<bool> data_new;	/* Whether the data is new / was already sent. */
-  static std::atomic<bool> img_processed; /* Whether the image data has been processed. */
 
   static NetworkStatus network_status;	/* Current status of networking. */
 
@@ -193,17 +191,22 @@ public:
   static void *img_thread;	/* Image processing thread handle. */
   static Thread::Runlevel	img_runlvl;	/* Image thread runlevel. */
   static Thread::Condition img_condition;	/* Condition variable for accessing the image data. */
+  static void *pose_thread;	/* Pose channel thread handle. */
+  static Thread::Runlevel	pose_runlvl;	/* Pose channel thread runlevel. */
+  static Thread::Condition pose_condition;	/* Condition variable for starting / stopping the pose channel thread. */
 
 #ifdef WIN32
   static bool receive_data(unsigned long long& socket); /* Receive data from client. */
-  static bool send_data(unsigned long long& socket);  /* Send data to client. */
+  static bool send_data(unsigned long long& socket, const VR_Network_FrameRing::Slot *slot);  /* Send data to client. */
   static uint __stdcall thread_func(void *data);	/* Thread function for the networking thread (to external machine via WiFi). */
   static uint __stdcall img_thread_func(void *data);	/* Thread function for the image processing thread. */
+  static uint __stdcall pose_thread_func(void *data);	/* Thread function for receiving the pose datagrams. */
 #else
   static bool receive_data(int& socket); /* Receive data from client. */
-  static bool send_data(int& socket); /* Send data to client. */
+  static bool send_data(int& socket, const VR_Network_FrameRing::Slot *slot); /* Send data to client. */
   static void thread_func();	/* Thread function for the networking thread (to external machine via WiFi). */
   static void img_thread_func();	/* Thread function for the image processing thread. */
+  static void pose_thread_func();	/* Thread function for receiving the pose datagrams. */
 #endif
 
   static bool start();	/* Start networking. */
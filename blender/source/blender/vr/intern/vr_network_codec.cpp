@@ -0,0 +1,443 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_network_codec.cpp
+*   \ingroup vr
+*/
+
+#include "vr_types.h"
+
+#include "vr_network_codec.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#ifdef WITH_FFMPEG
+extern "C" {
+#include "ffmpeg_compat.h"
+}
+#endif
+
+/***************************************************************************************************
+ * \class                                  VR_Network_Encoder
+ ***************************************************************************************************
+ * Encoder stage for VR remote streaming.
+ **************************************************************************************************/
+
+void VR_Network_Encoder::write_header(std::vector<uchar>& out, Type type, bool keyframe, uint w, uint h, uint d)
+{
+	FrameHeader header;
+	header.magic = VR_NETWORK_FRAME_MAGIC;
+	header.type = (uchar)type;
+	header.keyframe = keyframe ? 1 : 0;
+	header.depth = (ushort)d;
+	header.w = (ushort)w;
+	header.h = (ushort)h;
+	header.size = 0;
+
+	out.resize(sizeof(FrameHeader));
+	memcpy(&out[0], &header, sizeof(FrameHeader));
+}
+
+void VR_Network_Encoder::finalize_header(std::vector<uchar>& out)
+{
+	FrameHeader& header = *(FrameHeader*)&out[0];
+	header.size = (uint)(out.size() - sizeof(FrameHeader));
+}
+
+/* Legacy codec: one zlib stream per frame, no header (compatible with existing clients). */
+class VR_Network_Encoder_Zlib : public VR_Network_Encoder
+{
+public:
+	VR_Network_Encoder_Zlib(uint w, uint h, uint d, uint fps, int quality)
+		: VR_Network_Encoder(w, h, d, fps), quality(quality) {}
+
+	virtual Type type() const { return TYPE_ZLIB; }
+
+	virtual bool encode(const uchar *pixels, std::vector<uchar>& out)
+	{
+		int size = 0;
+		uchar *data = stbi_zlib_compress((uchar*)pixels, (int)(w * h * d), &size, quality);
+		if (!data) {
+			return false;
+		}
+		out.assign(data, data + size);
+		free(data);
+		return true;
+	}
+
+protected:
+	int quality;	/* zlib compression level. */
+};
+
+/* Intra/inter frame codec.
+ * Every frame is XOR'ed with the previously encoded frame (keyframes with zero),
+ * so unchanged pixels become zero, and the residual is run-length encoded per pixel.
+ * RLE control byte: c < 0x80 -> (c + 1) literal pixels follow,
+ *                   c >= 0x80 -> one pixel follows, repeated ((c & 0x7f) + 1) times. */
+class VR_Network_Encoder_DeltaRLE : public VR_Network_Encoder
+{
+public:
+	VR_Network_Encoder_DeltaRLE(uint w, uint h, uint d, uint fps)
+		: VR_Network_Encoder(w, h, d, fps), frames_since_key(0), force_key(true)
+	{
+		prev.resize(w * h * d);
+		residual.resize(w * h * d);
+	}
+
+	virtual Type type() const { return TYPE_DELTA_RLE; }
+	virtual void request_keyframe() { force_key = true; }
+
+	virtual bool encode(const uchar *pixels, std::vector<uchar>& out)
+	{
+		const uint size = w * h * d;
+		/* Keyframe once per second of stream, or on request. */
+		const bool keyframe = force_key || (frames_since_key >= (fps ? fps : VR_NETWORK_DEFAULT_FPS));
+
+		if (keyframe) {
+			memcpy(&residual[0], pixels, size);
+			frames_since_key = 0;
+			force_key = false;
+		}
+		else {
+			xor_bytes(pixels, &prev[0], &residual[0], size);
+			++frames_since_key;
+		}
+		memcpy(&prev[0], pixels, size);
+
+		write_header(out, TYPE_DELTA_RLE, keyframe, w, h, d);
+		/* Worst case: one control byte per 128 literal pixels. */
+		out.reserve(sizeof(FrameHeader) + size + (w * h) / 128 + 1);
+		rle_encode(&residual[0], w * h, d, out);
+		finalize_header(out);
+		return true;
+	}
+
+	static void xor_bytes(const uchar *a, const uchar *b, uchar *r, uint size)
+	{
+		uint i = 0;
+		for (; i + 8 <= size; i += 8) {
+			ui64 va, vb;
+			memcpy(&va, a + i, 8);
+			memcpy(&vb, b + i, 8);
+			va ^= vb;
+			memcpy(r + i, &va, 8);
+		}
+		for (; i < size; ++i) {
+			r[i] = a[i] ^ b[i];
+		}
+	}
+
+	static void rle_encode(const uchar *src, uint n, uint d, std::vector<uchar>& out)
+	{
+		uint i = 0;
+		while (i < n) {
+			/* Measure the run of identical pixels starting at i. */
+			uint run = 1;
+			while (i + run < n && run < 128 && memcmp(src + i * d, src + (i + run) * d, d) == 0) {
+				++run;
+			}
+			if (run >= 2) {
+				out.push_back((uchar)(0x80 | (run - 1)));
+				out.insert(out.end(), src + i * d, src + (i + 1) * d);
+				i += run;
+				continue;
+			}
+			/* Literal span until the next run of two or more. */
+			uint lit = 1;
+			while (i + lit < n && lit < 128) {
+				if (i + lit + 1 < n && memcmp(src + (i + lit) * d, src + (i + lit + 1) * d, d) == 0) {
+					break;
+				}
+				++lit;
+			}
+			out.push_back((uchar)(lit - 1));
+			out.insert(out.end(), src + i * d, src + (i + lit) * d);
+			i += lit;
+		}
+	}
+
+protected:
+	std::vector<uchar> prev;	/* Previously encoded frame. */
+	std::vector<uchar> residual;	/* Scratch buffer for the XOR residual. */
+	uint frames_since_key;	/* Number of inter frames since the last keyframe. */
+	bool force_key;	/* Whether the next frame must be a keyframe. */
+};
+
+#ifdef WITH_FFMPEG
+/* H.264 / HEVC software encode through libavcodec (low-latency settings, no B-frames). */
+class VR_Network_Encoder_FFmpeg : public VR_Network_Encoder
+{
+public:
+	static VR_Network_Encoder_FFmpeg *create(Type type, uint w, uint h, uint d, uint fps)
+	{
+		/* YUV 4:2:0 requires even dimensions. */
+		if ((w & 1) || (h & 1) || (d != 3 && d != 4)) {
+			return NULL;
+		}
+		VR_Network_Encoder_FFmpeg *encoder = new VR_Network_Encoder_FFmpeg(type, w, h, d, fps);
+		if (!encoder->open()) {
+			delete encoder;
+			return NULL;
+		}
+		return encoder;
+	}
+
+	virtual ~VR_Network_Encoder_FFmpeg()
+	{
+		if (sws) {
+			sws_freeContext(sws);
+		}
+		if (frame) {
+			av_frame_free(&frame);
+		}
+		if (ctx) {
+			avcodec_close(ctx);
+			av_free(ctx);
+		}
+	}
+
+	virtual Type type() const { return codec_type; }
+	virtual void request_keyframe() { force_key = true; }
+
+	virtual bool encode(const uchar *pixels, std::vector<uchar>& out)
+	{
+		const uint8_t *src[4] = { pixels, NULL, NULL, NULL };
+		int src_stride[4] = { (int)(w * d), 0, 0, 0 };
+		sws_scale(sws, src, src_stride, 0, (int)h, frame->data, frame->linesize);
+
+		frame->pts = pts++;
+		frame->pict_type = force_key ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+		force_key = false;
+
+		AVPacket packet = { 0 };
+		av_init_packet(&packet);
+		int got_output = 0;
+		if (avcodec_encode_video2(ctx, &packet, frame, &got_output) < 0) {
+			return false;
+		}
+
+		write_header(out, codec_type, got_output && (packet.flags & AV_PKT_FLAG_KEY), w, h, d);
+		if (got_output) {
+			out.insert(out.end(), packet.data, packet.data + packet.size);
+			av_free_packet(&packet);
+		}
+		finalize_header(out);
+		return true;
+	}
+
+protected:
+	VR_Network_Encoder_FFmpeg(Type type, uint w, uint h, uint d, uint fps)
+		: VR_Network_Encoder(w, h, d, fps), codec_type(type), ctx(NULL), frame(NULL), sws(NULL), pts(0), force_key(true) {}
+
+	bool open()
+	{
+		AVCodec *codec = avcodec_find_encoder(codec_type == TYPE_HEVC ? AV_CODEC_ID_HEVC : AV_CODEC_ID_H264);
+		if (!codec) {
+			return false;
+		}
+		ctx = avcodec_alloc_context3(codec);
+		if (!ctx) {
+			return false;
+		}
+		ctx->width = (int)w;
+		ctx->height = (int)h;
+		ctx->time_base.num = 1;
+		ctx->time_base.den = (int)(fps ? fps : VR_NETWORK_DEFAULT_FPS);
+		ctx->gop_size = ctx->time_base.den;
+		ctx->max_b_frames = 0;
+		ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+		ctx->thread_type = FF_THREAD_SLICE;
+		ctx->thread_count = 0;
+		/* Low-latency x264/x265 settings (ignored by other encoders). */
+		av_opt_set(ctx->priv_data, "preset", "ultrafast", 0);
+		av_opt_set(ctx->priv_data, "tune", "zerolatency", 0);
+		if (avcodec_open2(ctx, codec, NULL) < 0) {
+			return false;
+		}
+
+		frame = av_frame_alloc();
+		if (!frame) {
+			return false;
+		}
+		frame->format = AV_PIX_FMT_YUV420P;
+		frame->width = (int)w;
+		frame->height = (int)h;
+		if (av_frame_get_buffer(frame, 32) < 0) {
+			return false;
+		}
+
+		sws = sws_getContext((int)w, (int)h, (d == 4) ? AV_PIX_FMT_RGBA : AV_PIX_FMT_RGB24,
+							 (int)w, (int)h, AV_PIX_FMT_YUV420P,
+							 SWS_FAST_BILINEAR, NULL, NULL, NULL);
+		return sws != NULL;
+	}
+
+	Type codec_type;	/* TYPE_H264 or TYPE_HEVC. */
+	AVCodecContext *ctx;	/* Encoder context. */
+	AVFrame *frame;	/* YUV frame passed to the encoder. */
+	struct SwsContext *sws;	/* RGBA -> YUV conversion context. */
+	int64_t pts;	/* Presentation timestamp of the next frame. */
+	bool force_key;	/* Whether the next frame must be a keyframe. */
+};
+#endif
+
+VR_Network_Encoder *VR_Network_Encoder::create(Type type, uint w, uint h, uint d, uint fps)
+{
+	if (w == 0 || h == 0 || d == 0 || w > 0xffff || h > 0xffff) {
+		return NULL;
+	}
+
+	switch (type) {
+	case TYPE_ZLIB: {
+		return new VR_Network_Encoder_Zlib(w, h, d, fps, 100);
+	}
+	case TYPE_DELTA_RLE: {
+		return new VR_Network_Encoder_DeltaRLE(w, h, d, fps);
+	}
+	case TYPE_H264:
+	case TYPE_HEVC: {
+#ifdef WITH_FFMPEG
+		return VR_Network_Encoder_FFmpeg::create(type, w, h, d, fps);
+#else
+		return NULL;
+#endif
+	}
+	default: {
+		return NULL;
+	}
+	}
+}
+
+bool VR_Network_Encoder::is_available(Type type)
+{
+	switch (type) {
+	case TYPE_ZLIB:
+	case TYPE_DELTA_RLE: {
+		return true;
+	}
+	case TYPE_H264: {
+#ifdef WITH_FFMPEG
+		return avcodec_find_encoder(AV_CODEC_ID_H264) != NULL;
+#else
+		return false;
+#endif
+	}
+	case TYPE_HEVC: {
+#ifdef WITH_FFMPEG
+		return avcodec_find_encoder(AV_CODEC_ID_HEVC) != NULL;
+#else
+		return false;
+#endif
+	}
+	default: {
+		return false;
+	}
+	}
+}
+
+const char *VR_Network_Encoder::name(Type type)
+{
+	switch (type) {
+	case TYPE_ZLIB: { return "zlib"; }
+	case TYPE_DELTA_RLE: { return "delta-rle"; }
+	case TYPE_H264: { return "h264"; }
+	case TYPE_HEVC: { return "hevc"; }
+	default: { return "unknown"; }
+	}
+}
+
+/***************************************************************************************************
+ * \class                              VR_Network_Decoder_DeltaRLE
+ ***************************************************************************************************
+ * Decoder for the delta/RLE codec.
+ **************************************************************************************************/
+
+VR_Network_Decoder_DeltaRLE::VR_Network_Decoder_DeltaRLE()
+{
+	//
+}
+
+bool VR_Network_Decoder_DeltaRLE::decode(const uchar *data, uint size, std::vector<uchar>& pixels)
+{
+	typedef VR_Network_Encoder::FrameHeader FrameHeader;
+	if (size < sizeof(FrameHeader)) {
+		return false;
+	}
+	FrameHeader header;
+	memcpy(&header, data, sizeof(FrameHeader));
+	if (header.magic != VR_NETWORK_FRAME_MAGIC || header.type != VR_Network_Encoder::TYPE_DELTA_RLE ||
+		header.size != size - sizeof(FrameHeader) || header.depth == 0) {
+		return false;
+	}
+
+	const uint d = header.depth;
+	const uint n = (uint)header.w * (uint)header.h;
+	if (!header.keyframe && prev.size() != n * d) {
+		return false;	/* inter frame without matching reference */
+	}
+
+	pixels.resize(n * d);
+	const uchar *src = data + sizeof(FrameHeader);
+	const uchar *end = src + header.size;
+	uint i = 0;
+	while (i < n && src < end) {
+		const uchar c = *src++;
+		if (c & 0x80) {
+			const uint run = (uint)(c & 0x7f) + 1;
+			if (i + run > n || src + d > end) {
+				return false;
+			}
+			for (uint j = 0; j < run; ++j) {
+				memcpy(&pixels[(i + j) * d], src, d);
+			}
+			src += d;
+			i += run;
+		}
+		else {
+			const uint lit = (uint)c + 1;
+			if (i + lit > n || src + lit * d > end) {
+				return false;
+			}
+			memcpy(&pixels[i * d], src, lit * d);
+			src += lit * d;
+			i += lit;
+		}
+	}
+	if (i != n) {
+		return false;
+	}
+
+	if (!header.keyframe) {
+		for (uint k = 0; k < n * d; ++k) {
+			pixels[k] ^= prev[k];
+		}
+	}
+	prev = pixels;
+	return true;
+}
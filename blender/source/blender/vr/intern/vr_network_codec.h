@@ -0,0 +1,112 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_network_codec.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_NETWORK_CODEC_H__
+#define __VR_NETWORK_CODEC_H__
+
+#include "vr_types.h"
+
+#include <vector>
+
+/* Default stream parameters (used when the user preferences are zero / unset). */
+#define VR_NETWORK_DEFAULT_WIDTH	320
+#define VR_NETWORK_DEFAULT_HEIGHT	240
+#define VR_NETWORK_DEFAULT_FPS		30
+
+/* Magic number at the start of every frame header (not used by the zlib codec). */
+#define VR_NETWORK_FRAME_MAGIC		0x31525642 /* "BVR1" */
+
+/* Encoder stage for VR remote streaming.
+ * Takes one RGBA eye image and produces the byte stream that is sent to the client. */
+class VR_Network_Encoder
+{
+public:
+	/* Available codecs. */
+	typedef enum Type {
+		TYPE_ZLIB = 0	/* Raw zlib stream of the full frame (legacy, no frame header). */
+		,
+		TYPE_DELTA_RLE = 1	/* Intra/inter frame codec: XOR against previous frame + run-length encoding. */
+		,
+		TYPE_H264 = 2	/* H.264 software encode (requires ffmpeg). */
+		,
+		TYPE_HEVC = 3	/* HEVC software encode (requires ffmpeg). */
+		,
+		TYPES = 4	/* Number of codec types. */
+	} Type;
+
+	/* Header preceding every encoded frame of the non-legacy codecs. */
+	typedef struct FrameHeader {
+		uint magic;	/* VR_NETWORK_FRAME_MAGIC. */
+		uchar type;	/* Codec type (VR_Network_Encoder::Type). */
+		uchar keyframe;	/* Whether the frame can be decoded without the previous frame. */
+		ushort depth;	/* Bytes per pixel. */
+		ushort w;	/* Image width in pixels. */
+		ushort h;	/* Image height in pixels. */
+		uint size;	/* Size of the payload following the header in bytes. */
+	} FrameHeader;
+
+	static VR_Network_Encoder *create(Type type, uint w, uint h, uint d, uint fps);	/* Create an encoder (NULL if the codec is not available in this build). */
+	static bool is_available(Type type);	/* Whether the codec is available in this build. */
+	static const char *name(Type type);	/* Human-readable codec name. */
+
+	virtual ~VR_Network_Encoder() {}
+
+	virtual Type type() const = 0;	/* Codec type of this encoder. */
+	virtual bool encode(const uchar *pixels, std::vector<uchar>& out) = 0;	/* Encode one frame (w * h * d bytes) and replace the contents of out. */
+	virtual void request_keyframe() {}	/* Force the next frame to be independently decodable. */
+
+	uint width() const { return w; }	/* Image width in pixels. */
+	uint height() const { return h; }	/* Image height in pixels. */
+	uint depth() const { return d; }	/* Bytes per pixel. */
+	uint rate() const { return fps; }	/* Frame rate the encoder was configured for. */
+
+protected:
+	VR_Network_Encoder(uint w, uint h, uint d, uint fps) : w(w), h(h), d(d), fps(fps) {}
+	static void write_header(std::vector<uchar>& out, Type type, bool keyframe, uint w, uint h, uint d);	/* Write a frame header at the start of out. */
+	static void finalize_header(std::vector<uchar>& out);	/* Update the payload size of the header at the start of out. */
+
+	uint w;	/* Image width in pixels. */
+	uint h;	/* Image height in pixels. */
+	uint d;	/* Bytes per pixel. */
+	uint fps;	/* Frame rate. */
+};
+
+/* Decoder for the delta/RLE codec (used for loopback tests and by reference clients). */
+class VR_Network_Decoder_DeltaRLE
+{
+public:
+	VR_Network_Decoder_DeltaRLE();
+
+	bool decode(const uchar *data, uint size, std::vector<uchar>& pixels);	/* Decode one frame into pixels (keeps state for the next inter frame). */
+
+protected:
+	std::vector<uchar> prev;	/* Previously decoded frame. */
+};
+
+#endif /* __VR_NETWORK_CODEC_H__ */
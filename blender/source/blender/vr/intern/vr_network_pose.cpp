@@ -0,0 +1,473 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_network_pose.cpp
+*   \ingroup vr
+*
+* Pose / state channel of the remote streaming (UDP datagrams and jitter buffer).
+*/
+
+#include "vr_types.h"
+
+#include "vr_network_pose.h"
+
+#include "BLI_math.h"
+
+#include "PIL_time.h"
+
+#ifdef WIN32
+#include <WinSock2.h>
+#include <Ws2tcpip.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#endif
+
+#include <float.h>
+
+/* Packets this far (seconds) behind the playout time mean the client restarted. */
+#define VR_NETWORK_POSE_RESTART_TIME	1.0
+
+#ifdef WIN32
+typedef SOCKET vr_socket;
+#define VR_SOCKET_INVALID INVALID_SOCKET
+#define vr_socket_close closesocket
+#else
+typedef int vr_socket;
+#define VR_SOCKET_INVALID (-1)
+#define vr_socket_close ::close
+#endif
+
+/***************************************************************************************************
+ * \class                                   VR_Network_PoseBuffer
+ ***************************************************************************************************
+ * Jitter buffer of the received poses.
+ **************************************************************************************************/
+const char VR_Network_PoseBuffer::magic_sequence[4] = { 'B', 'X', 'R', 'P' };
+const double VR_Network_PoseBuffer::default_min_delay = 0.004;
+const double VR_Network_PoseBuffer::default_max_delay = 0.050;
+const double VR_Network_PoseBuffer::default_jitter_factor = 3.0;
+
+VR_Network_PoseBuffer::VR_Network_PoseBuffer()
+	: min_delay(default_min_delay)
+	, max_delay(default_max_delay)
+	, jitter_factor(default_jitter_factor)
+{
+	reset();
+}
+
+void VR_Network_PoseBuffer::reset()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	clear();
+	memset(&stats, 0, sizeof(stats));
+	stats.delay = min_delay;
+}
+
+void VR_Network_PoseBuffer::clear()
+{
+	memset(valid, 0, sizeof(valid));
+	have_packets = false;
+	seq_max = 0;
+	pose_time = -DBL_MAX;
+	last_transit = 0.0;
+}
+
+bool VR_Network_PoseBuffer::push(const VR_Network_PosePacket& packet, double time)
+{
+	if (memcmp(packet.magic, magic_sequence, sizeof(magic_sequence)) != 0) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	const uint seq = packet.seq;
+	const uint i = seq % capacity;
+	if (have_packets) {
+		/* Signed difference, so sequence numbers may wrap around. */
+		const int diff = (int)(seq - seq_max);
+		if (diff <= -(int)capacity || packet.time < pose_time - VR_NETWORK_POSE_RESTART_TIME) {
+			/* The client restarted (its sequence numbers and clock start over). */
+			clear();
+		}
+	}
+
+	if (have_packets) {
+		const int diff = (int)(seq - seq_max);
+		if (packet.time < pose_time) {
+			++stats.late;
+			return false;
+		}
+		if (diff == 0 || (diff < 0 && valid[i] && packets[i].seq == seq)) {
+			++stats.duplicates;
+			return false;
+		}
+		if (diff < 0) {
+			/* Fills a gap. */
+			++stats.reordered;
+			if (stats.lost > 0) {
+				--stats.lost;
+			}
+		}
+		else {
+			/* The entries of the skipped sequence numbers hold packets that are too old now. */
+			for (uint k = 1; k < (uint)diff && k < capacity; ++k) {
+				valid[(seq_max + k) % capacity] = false;
+			}
+			stats.lost += (uint)diff - 1;
+			/* Time between packets (the client clock is fine for that). */
+			const double interval = (packet.time - packets[seq_max % capacity].time) / diff;
+			stats.interval += (interval - stats.interval) / 16.0;
+			seq_max = seq;
+		}
+
+		/* Interarrival jitter (as in RFC 3550). */
+		stats.jitter += (fabs((time - packet.time) - last_transit) - stats.jitter) / 16.0;
+	}
+	else {
+		have_packets = true;
+		seq_max = seq;
+	}
+	last_transit = time - packet.time;
+
+	packets[i] = packet;
+	time_received[i] = time;
+	valid[i] = true;
+	++stats.received;
+	return true;
+}
+
+/* Copy the poses of a packet (but not the parameters and controller states). */
+static void copy_poses(const VR_Network_TrackingData& src, VR_Network_TrackingData& dst)
+{
+	memcpy(dst.t_hmd, src.t_hmd, sizeof(dst.t_hmd));
+	memcpy(dst.t_eye, src.t_eye, sizeof(dst.t_eye));
+	memcpy(dst.t_controller, src.t_controller, sizeof(dst.t_controller));
+}
+
+void VR_Network_PoseBuffer::interpolate(const VR_Network_TrackingData& a, const VR_Network_TrackingData& b, float t, VR_Network_TrackingData& r_data)
+{
+	r_data = b;
+	interp_m4_m4m4(r_data.t_hmd, a.t_hmd, b.t_hmd, t);
+	for (int i = 0; i < VR_SIDES; ++i) {
+		interp_m4_m4m4(r_data.t_eye[i], a.t_eye[i], b.t_eye[i], t);
+	}
+	for (int i = 0; i < VR_MAX_CONTROLLERS; ++i) {
+		interp_m4_m4m4(r_data.t_controller[i], a.t_controller[i], b.t_controller[i], t);
+	}
+}
+
+bool VR_Network_PoseBuffer::sample(double time, VR_Network_TrackingData& r_data, double *r_pose_time)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!have_packets) {
+		return false;
+	}
+
+	/* Smallest transit time of the buffered packets: the clock offset, plus the transit time
+	 * without queuing delays. */
+	double offset = DBL_MAX;
+	for (uint i = 0; i < capacity; ++i) {
+		if (valid[i]) {
+			offset = min_dd(offset, time_received[i] - packets[i].time);
+		}
+	}
+
+	/* The next packet has to be there to interpolate, so wait for it (and its jitter). */
+	stats.delay = min_dd(max_dd(stats.interval + jitter_factor * stats.jitter, min_delay), max_delay);
+	const double t = time - offset - stats.delay;
+
+	/* Packets around the playout time. */
+	int a = -1, b = -1;
+	for (uint i = 0; i < capacity; ++i) {
+		if (!valid[i]) {
+			continue;
+		}
+		const double t_i = packets[i].time;
+		if (t_i <= t) {
+			if (a < 0 || t_i > packets[a].time) {
+				a = (int)i;
+			}
+		}
+		else if (b < 0 || t_i < packets[b].time) {
+			b = (int)i;
+		}
+	}
+
+	VR_Network_TrackingData poses;
+	double t_pose;
+	if (a >= 0 && b >= 0) {
+		const double f = (t - packets[a].time) / (packets[b].time - packets[a].time);
+		interpolate(packets[a].data, packets[b].data, (float)f, poses);
+		t_pose = t;
+	}
+	else if (a >= 0) {
+		/* Nothing received after the playout time (yet), hold the newest pose. */
+		poses = packets[a].data;
+		t_pose = packets[a].time;
+		++stats.underruns;
+	}
+	else {
+		/* Only packets after the playout time (i.e. after a reset). */
+		poses = packets[b].data;
+		t_pose = packets[b].time;
+	}
+	pose_time = max_dd(pose_time, t_pose);
+
+	r_data = packets[seq_max % capacity].data;
+	copy_poses(poses, r_data);
+	if (r_pose_time) {
+		*r_pose_time = t_pose;
+	}
+	return true;
+}
+
+bool VR_Network_PoseBuffer::latest(VR_Network_TrackingData& r_data) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!have_packets) {
+		return false;
+	}
+	r_data = packets[seq_max % capacity].data;
+	return true;
+}
+
+VR_Network_PoseBuffer::Stats VR_Network_PoseBuffer::get_stats() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return stats;
+}
+
+/***************************************************************************************************
+ * \class                                   VR_Network_PoseChannel
+ ***************************************************************************************************
+ * UDP socket receiving the pose datagrams.
+ **************************************************************************************************/
+VR_Network_PoseChannel::VR_Network_PoseChannel()
+	: sock(-1)
+{
+	//
+}
+
+VR_Network_PoseChannel::~VR_Network_PoseChannel()
+{
+	close();
+}
+
+/* Create a UDP socket (initializing Winsock if required). */
+static long long socket_create()
+{
+#ifdef WIN32
+	WSADATA wsa_data;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+		return -1;
+	}
+#endif
+	vr_socket s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (s == VR_SOCKET_INVALID) {
+#ifdef WIN32
+		WSACleanup();
+#endif
+		return -1;
+	}
+	return (long long)s;
+}
+
+/* Close a socket made by socket_create(). */
+static void socket_destroy(long long s)
+{
+	vr_socket_close((vr_socket)s);
+#ifdef WIN32
+	WSACleanup();
+#endif
+}
+
+bool VR_Network_PoseChannel::open(const char *ip_address, ushort port)
+{
+	close();
+
+	long long s = socket_create();
+	if (s == -1) {
+		return false;
+	}
+
+	int yes = 1;
+	setsockopt((vr_socket)s, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+
+	struct sockaddr_in host_addr;
+	memset(&host_addr, 0, sizeof(host_addr));
+	host_addr.sin_family = AF_INET;
+	host_addr.sin_port = htons(port);
+	host_addr.sin_addr.s_addr = inet_addr(ip_address);
+	if (bind((vr_socket)s, (struct sockaddr*)&host_addr, sizeof(host_addr)) != 0) {
+		socket_destroy(s);
+		return false;
+	}
+
+	sock = s;
+	return true;
+}
+
+void VR_Network_PoseChannel::close()
+{
+	if (sock != -1) {
+		socket_destroy(sock);
+		sock = -1;
+	}
+}
+
+bool VR_Network_PoseChannel::is_open() const
+{
+	return (sock != -1);
+}
+
+int VR_Network_PoseChannel::receive(VR_Network_PoseBuffer& buffer, uint timeout_ms)
+{
+	if (sock == -1) {
+		return -1;
+	}
+
+	int added = 0;
+	/* Wait for the first datagram, then read all pending ones. */
+	for (uint wait_ms = timeout_ms;; wait_ms = 0) {
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET((vr_socket)sock, &fds);
+		struct timeval tv;
+		tv.tv_sec = wait_ms / 1000;
+		tv.tv_usec = (wait_ms % 1000) * 1000;
+		const int ret = select((int)sock + 1, &fds, NULL, NULL, &tv);
+		if (ret == 0) {
+			break;
+		}
+		else if (ret < 0) {
+#ifndef WIN32
+			if (errno == EINTR) {
+				continue;
+			}
+#endif
+			return -1;
+		}
+
+		VR_Network_PosePacket packet;
+		const int len = (int)recv((vr_socket)sock, (char*)&packet, sizeof(packet), 0);
+		const double time = PIL_check_seconds_timer();
+		if (len < 0) {
+#ifdef WIN32
+			/* Datagram too large (not a pose packet) or ICMP port unreachable. */
+			const int error = WSAGetLastError();
+			if (error == WSAEMSGSIZE || error == WSAECONNRESET) {
+				continue;
+			}
+#else
+			if (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK) {
+				continue;
+			}
+#endif
+			return -1;
+		}
+		if (len == (int)sizeof(packet) && buffer.push(packet, time)) {
+			++added;
+		}
+	}
+
+	return added;
+}
+
+/***************************************************************************************************
+ * \class                                   VR_Network_PoseClient
+ ***************************************************************************************************
+ * Client side of the pose channel.
+ **************************************************************************************************/
+VR_Network_PoseClient::VR_Network_PoseClient()
+	: sock(-1)
+	, addr_ip(0)
+	, addr_port(0)
+	, seq_next(0)
+{
+	//
+}
+
+VR_Network_PoseClient::~VR_Network_PoseClient()
+{
+	close();
+}
+
+bool VR_Network_PoseClient::open(const char *ip_address, ushort port)
+{
+	close();
+
+	sock = socket_create();
+	if (sock == -1) {
+		return false;
+	}
+	addr_ip = (uint)inet_addr(ip_address);
+	addr_port = htons(port);
+	return true;
+}
+
+void VR_Network_PoseClient::close()
+{
+	if (sock != -1) {
+		socket_destroy(sock);
+		sock = -1;
+	}
+}
+
+VR_Network_PosePacket VR_Network_PoseClient::make_packet(const VR_Network_TrackingData& data, double time)
+{
+	VR_Network_PosePacket packet;
+	memcpy(packet.magic, VR_Network_PoseBuffer::magic_sequence, sizeof(packet.magic));
+	packet.seq = seq_next++;
+	packet.time = time;
+	packet.data = data;
+	return packet;
+}
+
+bool VR_Network_PoseClient::send(const VR_Network_TrackingData& data, double time)
+{
+	return send(make_packet(data, time));
+}
+
+bool VR_Network_PoseClient::send(const VR_Network_PosePacket& packet)
+{
+	if (sock == -1) {
+		return false;
+	}
+
+	struct sockaddr_in host_addr;
+	memset(&host_addr, 0, sizeof(host_addr));
+	host_addr.sin_family = AF_INET;
+	host_addr.sin_port = addr_port;
+	host_addr.sin_addr.s_addr = addr_ip;
+	const int len = (int)sendto((vr_socket)sock, (const char*)&packet, sizeof(packet), 0, (struct sockaddr*)&host_addr, sizeof(host_addr));
+	return (len == (int)sizeof(packet));
+}
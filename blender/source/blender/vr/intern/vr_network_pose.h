@@ -0,0 +1,158 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_network_pose.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_NETWORK_POSE_H__
+#define __VR_NETWORK_POSE_H__
+
+#include "vr_types.h"
+#include "vr_main.h"
+
+#include <mutex>
+
+/* Port number used for the pose / state datagrams. */
+#define VR_NETWORK_POSE_PORT_NUM	27011
+
+/* Tracking data and parameters of the remote device. */
+typedef struct VR_Network_TrackingData {
+	VR_Device_Type device_type; /* Type of VR device used. */
+	int tracking;		/* Whether the VR tracking state is currently active/valid. */
+	float fx[VR_SIDES]; /* Horizontal focal length, in "image-width" - units(1 = image width). */
+	float fy[VR_SIDES]; /* Vertical focal length, in "image-height" - units(1 = image height). */
+	float cx[VR_SIDES]; /* Horizontal principal point, in "image-width" - units(0.5 = image center). */
+	float cy[VR_SIDES]; /* Vertical principal point, in "image-height" - units(0.5 = image center). */
+	int tex_width;		/* Default eye texture width. */
+	int tex_height;		/* Default eye texture height. */
+	float aperture_u;	/* The aperture of the texture(0~u) that contains the rendering. */
+	float aperture_v;	/* The aperture of the texture(0~v) that contains the rendering. */
+	float t_hmd[4][4];	/* Last tracked position of the HMD. */
+	float t_eye[VR_SIDES][4][4];	/* Last tracked position of the eyes. */
+	VR_Controller controller[VR_MAX_CONTROLLERS];		/* Controllers associated with the HMD device. */
+	float t_controller[VR_MAX_CONTROLLERS][4][4];	/* Last tracked positions of the controllers. */
+} VR_Network_TrackingData;
+
+/* Pose / state datagram, sent by the client for every tracked pose. */
+typedef struct VR_Network_PosePacket {
+	char magic[4];	/* VR_Network_PosePacket::magic_sequence. */
+	uint seq;	/* Sequence number (incremented by the client for every packet). */
+	double time;	/* Time the pose was tracked (seconds, client clock). */
+	VR_Network_TrackingData data;	/* Tracking data. */
+} VR_Network_PosePacket;
+
+/* Jitter buffer of the received poses.
+ * Datagrams may be lost, duplicated or arrive out of order, so instead of using the last received
+ * pose, the poses are played out with a small delay (the packet interval plus a multiple of the
+ * measured jitter) and interpolated between the two packets around the playout time. A lost packet only widens the
+ * interpolation interval, and a late one is used as long as its playout time didn't pass.
+ * The client clock is mapped to the receiver clock with the smallest transit time of the buffered
+ * packets, so the clocks don't need to be synchronized (and may drift). */
+class VR_Network_PoseBuffer
+{
+public:
+	/* Receive statistics. */
+	typedef struct Stats {
+		uint received;	/* Packets added to the buffer. */
+		uint lost;	/* Packets missing from the sequence (not received yet). */
+		uint reordered;	/* Packets received after a packet with a higher sequence number. */
+		uint duplicates;	/* Packets received more than once (dropped). */
+		uint late;	/* Packets received too late to be played out (dropped). */
+		uint underruns;	/* Samples taken past the newest packet (the newest pose was held). */
+		double interval;	/* Estimated time between packets (seconds). */
+		double jitter;	/* Estimated interarrival jitter (seconds). */
+		double delay;	/* Current playout delay (seconds). */
+	} Stats;
+
+	static const uint capacity = 64;	/* Number of packets kept (more than the playout delay at the tracking rate). */
+	static const char magic_sequence[4];	/* Magic of the pose packets. */
+	static const double default_min_delay;	/* Default minimum playout delay (seconds). */
+	static const double default_max_delay;	/* Default maximum playout delay (seconds). */
+	static const double default_jitter_factor;	/* Default playout delay (on top of the packet interval) in multiples of the jitter. */
+
+	VR_Network_PoseBuffer();	/* Constructor. */
+
+	void reset();	/* Discard all packets and statistics (i.e. for a new connection). */
+	bool push(const VR_Network_PosePacket& packet, double time_received);	/* Add a received packet (time in seconds, receiver clock). Returns false if the packet was dropped. */
+	bool sample(double time, VR_Network_TrackingData& r_data, double *r_pose_time = 0);	/* Get the poses to show at a time (receiver clock), the other data is from the newest packet. Returns false if there are no packets. r_pose_time receives the (client) time of the interpolated pose. */
+	bool latest(VR_Network_TrackingData& r_data) const;	/* Get the newest packet (i.e. for the button states). Returns false if there are no packets. */
+	Stats get_stats() const;	/* Get the receive statistics. */
+
+	static void interpolate(const VR_Network_TrackingData& a, const VR_Network_TrackingData& b, float t, VR_Network_TrackingData& r_data);	/* Interpolate the poses of two packets (other data from b). */
+
+	double min_delay;	/* Minimum playout delay (seconds). */
+	double max_delay;	/* Maximum playout delay (seconds). */
+	double jitter_factor;	/* Playout delay (on top of the packet interval) in multiples of the jitter. */
+protected:
+	void clear();	/* Discard all packets (but keep the statistics). */
+
+	VR_Network_PosePacket	packets[capacity];	/* Received packets, at seq % capacity. */
+	double	time_received[capacity];	/* Receive time of each packet. */
+	bool	valid[capacity];	/* Whether each entry holds a packet. */
+	bool	have_packets;	/* Whether any packet was received since the last reset. */
+	uint	seq_max;	/* Highest sequence number received. */
+	double	pose_time;	/* Client time of the last sampled pose (older packets are late). */
+	double	last_transit;	/* Receive time - send time of the previous packet (for the jitter). */
+	Stats	stats;	/* Receive statistics. */
+	mutable std::mutex	mutex;	/* Protects everything (packets are pushed from the networking thread). */
+};
+
+/* UDP socket receiving the pose datagrams into a jitter buffer. */
+class VR_Network_PoseChannel
+{
+public:
+	VR_Network_PoseChannel();	/* Constructor. */
+	~VR_Network_PoseChannel();	/* Destructor (closes the socket). */
+
+	bool open(const char *ip_address, ushort port);	/* Bind the socket to a local address. */
+	void close();	/* Close the socket. */
+	bool is_open() const;	/* Whether the socket is open. */
+	int receive(VR_Network_PoseBuffer& buffer, uint timeout_ms);	/* Wait for datagrams and add them to the buffer. Returns the number of packets added (-1 on socket error). */
+protected:
+	long long sock;	/* Socket handle (-1 if closed). */
+};
+
+/* Client side of the pose channel. This is what a remote device does, used as a loopback stand-in
+ * for tests and for debugging the remote path without a device. */
+class VR_Network_PoseClient
+{
+public:
+	VR_Network_PoseClient();	/* Constructor. */
+	~VR_Network_PoseClient();	/* Destructor (closes the socket). */
+
+	bool open(const char *ip_address, ushort port);	/* Set the receiver address. */
+	void close();	/* Close the socket. */
+	bool send(const VR_Network_TrackingData& data, double time);	/* Send a pose with the next sequence number. */
+	bool send(const VR_Network_PosePacket& packet);	/* Send a packet as is (i.e. to inject duplicates or reordering). */
+	VR_Network_PosePacket make_packet(const VR_Network_TrackingData& data, double time);	/* Make a packet with the next sequence number. */
+protected:
+	long long sock;	/* Socket handle (-1 if closed). */
+	uint addr_ip;	/* Receiver IPv4 address (network byte order). */
+	ushort addr_port;	/* Receiver port (network byte order). */
+	uint seq_next;	/* Sequence number of the next packet. */
+};
+
+#endif /* __VR_NETWORK_POSE_H__ */
@@ -0,0 +1,438 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_network_resample.cpp
+*   \ingroup vr
+*/
+
+#include "vr_types.h"
+
+#include "vr_network_resample.h"
+
+#include <string.h>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#  define VR_RESAMPLE_SSE2
+#  include <emmintrin.h>
+#endif
+
+/* AVX2 is compiled in whenever the compiler can emit it, and selected at runtime. */
+#if defined(__AVX2__)
+#  define VR_RESAMPLE_AVX2
+#  define VR_RESAMPLE_TARGET_AVX2
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#  define VR_RESAMPLE_AVX2
+#  define VR_RESAMPLE_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#  define VR_RESAMPLE_AVX2
+#  define VR_RESAMPLE_TARGET_AVX2
+#endif
+#ifdef VR_RESAMPLE_AVX2
+#  include <immintrin.h>
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  endif
+#endif
+
+/***************************************************************************************************
+ * \class                                  VR_Network_Resample
+ ***************************************************************************************************
+ * Resample kernel for VR remote streaming.
+ **************************************************************************************************/
+
+/* Whether a depth word marks the background.
+ * NOTE: The original implementation read the depth word one byte before the pixel (unaligned)
+ * and shifted it by 8, i.e. it compares the lower 24 bits of the <depth 24, stencil 8> word.
+ * This is kept as-is so the streamed images do not change. */
+#define VR_RESAMPLE_DEPTH_MASK 0x00FFFFFF
+
+/* Sub-pixel precision of the bilinear weights (8 bits). */
+#define VR_RESAMPLE_WEIGHT_ONE 256
+
+static inline bool depth_is_background(const uchar *d)
+{
+	return (d[0] == 0xFF && d[1] == 0xFF && d[2] == 0xFF);
+}
+
+/* Lookup tables for the nearest filter.
+ * The source pixel of the destination pixel (x, y) is row[y] - col[x] (in pixels).
+ * This reproduces the addressing of the original implementation:
+ * the source is flipped vertically and horizontally and the destination horizontally again. */
+typedef struct NearestLUT {
+	std::vector<int> row;	/* Per destination row: N - (source row * w_old). */
+	std::vector<int> col;	/* Per destination column: source column (of the flipped destination column). */
+	int cols_nonzero;	/* Number of leading destination columns with col[x] > 0. */
+} NearestLUT;
+
+static void nearest_lut_build(NearestLUT& lut, uint w_old, uint h_old, uint w_new, uint h_new)
+{
+	const int n = (int)(w_old * h_old);
+	const float w_scale = (float)w_new / (float)w_old;
+	const float h_scale = (float)h_new / (float)h_old;
+
+	lut.row.resize(h_new);
+	for (int y = 0; y < (int)h_new; ++y) {
+		int sy = (int)((float)y / h_scale);
+		if (sy > (int)h_old - 1) {
+			sy = (int)h_old - 1;
+		}
+		lut.row[y] = n - sy * (int)w_old;
+	}
+
+	lut.col.resize(w_new);
+	lut.cols_nonzero = 0;
+	for (int x = 0; x < (int)w_new; ++x) {
+		int sx = (int)((float)((int)w_new - 1 - x) / w_scale);
+		if (sx > (int)w_old - 1) {
+			sx = (int)w_old - 1;
+		}
+		lut.col[x] = sx;
+		if (sx > 0) {
+			lut.cols_nonzero = x + 1;
+		}
+	}
+}
+
+/* Lookup tables for the bilinear filter (pixel centers are aligned). */
+typedef struct BilinearLUT {
+	std::vector<int> x0, x1, wx;	/* Per destination column: left / right source column and weight of the right one. */
+	std::vector<int> y0, y1, wy;	/* Per destination row: first / second source row (flipped) and weight of the second one. */
+} BilinearLUT;
+
+static void bilinear_axis_build(std::vector<int>& i0, std::vector<int>& i1, std::vector<int>& w, uint size_old, uint size_new, bool flip)
+{
+	const float scale = (float)size_old / (float)size_new;
+	i0.resize(size_new);
+	i1.resize(size_new);
+	w.resize(size_new);
+	for (int i = 0; i < (int)size_new; ++i) {
+		float f = ((float)i + 0.5f) * scale - 0.5f;
+		if (f < 0.0f) {
+			f = 0.0f;
+		}
+		else if (f > (float)(size_old - 1)) {
+			f = (float)(size_old - 1);
+		}
+		const int a = (int)f;
+		const int b = (a + 1 < (int)size_old) ? a + 1 : a;
+		i0[i] = flip ? (int)size_old - 1 - a : a;
+		i1[i] = flip ? (int)size_old - 1 - b : b;
+		w[i] = (int)((f - (float)a) * (float)VR_RESAMPLE_WEIGHT_ONE + 0.5f);
+	}
+}
+
+/* Nearest filter (scalar), destination columns [x_begin, x_end) of one row. */
+static void nearest_row_scalar(const uchar *src, const uchar *depth, uchar *dst, const NearestLUT& lut, int y, int x_begin, int x_end, int n)
+{
+	const int row = lut.row[y];
+	for (int x = x_begin; x < x_end; ++x) {
+		int i = row - lut.col[x];
+		if (i > n - 1) {
+			/* The original implementation read one pixel past the end of the buffer here. */
+			i = n - 1;
+		}
+		const uchar *s = &src[i * 4];
+		uchar *d = &dst[x * 4];
+		d[0] = s[0];
+		d[1] = s[1];
+		d[2] = s[2];
+		d[3] = (depth && depth_is_background(&depth[i * 4])) ? 0 : 255;
+	}
+}
+
+#ifdef VR_RESAMPLE_SSE2
+static inline uint load_u32(const uchar *p)
+{
+	uint v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+/* Keep RGB and set alpha: 0 where the depth word is background, 255 otherwise. */
+static inline __m128i rgb_with_alpha_sse2(__m128i c, const __m128i *d)
+{
+	const __m128i rgb_mask = _mm_set1_epi32(VR_RESAMPLE_DEPTH_MASK);
+	const __m128i alpha_mask = _mm_set1_epi32((int)0xFF000000);
+	c = _mm_and_si128(c, rgb_mask);
+	if (!d) {
+		return _mm_or_si128(c, alpha_mask);
+	}
+	/* (d & 0x00FFFFFF) == 0x00FFFFFF  <=>  (d | 0xFF000000) == 0xFFFFFFFF */
+	const __m128i bg = _mm_cmpeq_epi32(_mm_or_si128(*d, alpha_mask), _mm_set1_epi32(-1));
+	return _mm_or_si128(c, _mm_andnot_si128(bg, alpha_mask));
+}
+
+/* Nearest filter (SSE2): 4 destination pixels per iteration. */
+static int nearest_row_sse2(const uchar *src, const uchar *depth, uchar *dst, const NearestLUT& lut, int y, int x_end)
+{
+	const int row = lut.row[y];
+	const int *col = &lut.col[0];
+	int x = 0;
+	for (; x + 4 <= x_end; x += 4) {
+		const int i0 = row - col[x], i1 = row - col[x + 1], i2 = row - col[x + 2], i3 = row - col[x + 3];
+		const __m128i c = _mm_set_epi32((int)load_u32(&src[i3 * 4]), (int)load_u32(&src[i2 * 4]),
+			(int)load_u32(&src[i1 * 4]), (int)load_u32(&src[i0 * 4]));
+		__m128i out;
+		if (depth) {
+			const __m128i d = _mm_set_epi32((int)load_u32(&depth[i3 * 4]), (int)load_u32(&depth[i2 * 4]),
+				(int)load_u32(&depth[i1 * 4]), (int)load_u32(&depth[i0 * 4]));
+			out = rgb_with_alpha_sse2(c, &d);
+		}
+		else {
+			out = rgb_with_alpha_sse2(c, NULL);
+		}
+		_mm_storeu_si128((__m128i*)&dst[x * 4], out);
+	}
+	return x;
+}
+
+/* Bilinear filter (SSE2): one destination pixel per iteration, all channels and taps in parallel. */
+static void bilinear_row_sse2(const uchar *src, const uchar *depth, uchar *dst, const BilinearLUT& lut, uint w_old, int y, uint w_new)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i round = _mm_set1_epi16(VR_RESAMPLE_WEIGHT_ONE / 2);
+	const uchar *row0 = &src[lut.y0[y] * w_old * 4];
+	const uchar *row1 = &src[lut.y1[y] * w_old * 4];
+	const short wy = (short)lut.wy[y];
+	const __m128i wv = _mm_set_epi16(0, 0, 0, 0, wy, wy, wy, wy);
+	const __m128i wv_inv = _mm_set_epi16(0, 0, 0, 0, VR_RESAMPLE_WEIGHT_ONE - wy, VR_RESAMPLE_WEIGHT_ONE - wy, VR_RESAMPLE_WEIGHT_ONE - wy, VR_RESAMPLE_WEIGHT_ONE - wy);
+	const int yn = (lut.wy[y] >= VR_RESAMPLE_WEIGHT_ONE / 2) ? lut.y1[y] : lut.y0[y];
+
+	for (int x = 0; x < (int)w_new; ++x) {
+		const int x0 = lut.x0[x], x1 = lut.x1[x];
+		const short wx = (short)lut.wx[x];
+		const short wx_inv = (short)(VR_RESAMPLE_WEIGHT_ONE - wx);
+		const __m128i wh = _mm_set_epi16(wx, wx, wx, wx, wx_inv, wx_inv, wx_inv, wx_inv);
+
+		/* [a b] of row 0 and [c d] of row 1, widened to 16 bits. */
+		const __m128i t0 = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, (int)load_u32(&row0[x1 * 4]), (int)load_u32(&row0[x0 * 4])), zero);
+		const __m128i t1 = _mm_unpacklo_epi8(_mm_set_epi32(0, 0, (int)load_u32(&row1[x1 * 4]), (int)load_u32(&row1[x0 * 4])), zero);
+		/* Horizontal: a * (1 - wx) + b * wx (fits in 16 bits). */
+		__m128i h0 = _mm_mullo_epi16(t0, wh);
+		__m128i h1 = _mm_mullo_epi16(t1, wh);
+		h0 = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(h0, _mm_srli_si128(h0, 8)), round), 8);
+		h1 = _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(h1, _mm_srli_si128(h1, 8)), round), 8);
+		/* Vertical. */
+		__m128i v = _mm_add_epi16(_mm_mullo_epi16(h0, wv_inv), _mm_mullo_epi16(h1, wv));
+		v = _mm_srli_epi16(_mm_add_epi16(v, round), 8);
+		uint c = (uint)_mm_cvtsi128_si32(_mm_packus_epi16(v, zero));
+
+		c &= VR_RESAMPLE_DEPTH_MASK;
+		if (depth) {
+			const int xn = (wx >= VR_RESAMPLE_WEIGHT_ONE / 2) ? x1 : x0;
+			if (!depth_is_background(&depth[(yn * w_old + xn) * 4])) {
+				c |= 0xFF000000;
+			}
+		}
+		else {
+			c |= 0xFF000000;
+		}
+		memcpy(&dst[x * 4], &c, sizeof(c));
+	}
+}
+#endif /* VR_RESAMPLE_SSE2 */
+
+#ifdef VR_RESAMPLE_AVX2
+/* Nearest filter (AVX2): 8 destination pixels per iteration with gather loads. */
+VR_RESAMPLE_TARGET_AVX2
+static int nearest_row_avx2(const uchar *src, const uchar *depth, uchar *dst, const NearestLUT& lut, int y, int x_end)
+{
+	const __m256i row = _mm256_set1_epi32(lut.row[y]);
+	const __m256i rgb_mask = _mm256_set1_epi32(VR_RESAMPLE_DEPTH_MASK);
+	const __m256i alpha_mask = _mm256_set1_epi32((int)0xFF000000);
+	const __m256i ones = _mm256_set1_epi32(-1);
+	const int *col = &lut.col[0];
+	int x = 0;
+	for (; x + 8 <= x_end; x += 8) {
+		const __m256i idx = _mm256_sub_epi32(row, _mm256_loadu_si256((const __m256i*)&col[x]));
+		__m256i c = _mm256_and_si256(_mm256_i32gather_epi32((const int*)src, idx, 4), rgb_mask);
+		if (depth) {
+			const __m256i d = _mm256_i32gather_epi32((const int*)depth, idx, 4);
+			const __m256i bg = _mm256_cmpeq_epi32(_mm256_or_si256(d, alpha_mask), ones);
+			c = _mm256_or_si256(c, _mm256_andnot_si256(bg, alpha_mask));
+		}
+		else {
+			c = _mm256_or_si256(c, alpha_mask);
+		}
+		_mm256_storeu_si256((__m256i*)&dst[x * 4], c);
+	}
+	return x;
+}
+#endif /* VR_RESAMPLE_AVX2 */
+
+/* Bilinear filter (scalar); same integer arithmetic as the SSE2 version. */
+static void bilinear_row_scalar(const uchar *src, const uchar *depth, uchar *dst, const BilinearLUT& lut, uint w_old, int y, uint w_new)
+{
+	const uchar *row0 = &src[lut.y0[y] * w_old * 4];
+	const uchar *row1 = &src[lut.y1[y] * w_old * 4];
+	const int wy = lut.wy[y];
+	const int yn = (wy >= VR_RESAMPLE_WEIGHT_ONE / 2) ? lut.y1[y] : lut.y0[y];
+	const int r = VR_RESAMPLE_WEIGHT_ONE / 2;
+
+	for (int x = 0; x < (int)w_new; ++x) {
+		const int x0 = lut.x0[x], x1 = lut.x1[x];
+		const int wx = lut.wx[x];
+		uchar *d = &dst[x * 4];
+		for (int k = 0; k < 3; ++k) {
+			const int h0 = (row0[x0 * 4 + k] * (VR_RESAMPLE_WEIGHT_ONE - wx) + row0[x1 * 4 + k] * wx + r) >> 8;
+			const int h1 = (row1[x0 * 4 + k] * (VR_RESAMPLE_WEIGHT_ONE - wx) + row1[x1 * 4 + k] * wx + r) >> 8;
+			d[k] = (uchar)((h0 * (VR_RESAMPLE_WEIGHT_ONE - wy) + h1 * wy + r) >> 8);
+		}
+		const int xn = (wx >= VR_RESAMPLE_WEIGHT_ONE / 2) ? x1 : x0;
+		d[3] = (depth && depth_is_background(&depth[(yn * w_old + xn) * 4])) ? 0 : 255;
+	}
+}
+
+bool VR_Network_Resample::is_supported(ISA isa)
+{
+	switch (isa) {
+	case ISA_SCALAR:
+	case ISA_AUTO: {
+		return true;
+	}
+	case ISA_SSE2: {
+#ifdef VR_RESAMPLE_SSE2
+		return true;
+#else
+		return false;
+#endif
+	}
+	case ISA_AVX2: {
+#if defined(__AVX2__)
+		return true;
+#elif defined(VR_RESAMPLE_AVX2) && defined(_MSC_VER)
+		static int supported = -1;
+		if (supported < 0) {
+			int info[4];
+			__cpuid(info, 1);
+			const bool avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && ((_xgetbv(0) & 0x6) == 0x6);
+			__cpuidex(info, 7, 0);
+			supported = (avx && (info[1] & (1 << 5))) ? 1 : 0;
+		}
+		return supported == 1;
+#elif defined(VR_RESAMPLE_AVX2)
+		return __builtin_cpu_supports("avx2") != 0;
+#else
+		return false;
+#endif
+	}
+	default: {
+		return false;
+	}
+	}
+}
+
+const char *VR_Network_Resample::name(ISA isa)
+{
+	switch (isa) {
+	case ISA_SCALAR: {
+		return "Scalar";
+	}
+	case ISA_SSE2: {
+		return "SSE2";
+	}
+	case ISA_AVX2: {
+		return "AVX2";
+	}
+	case ISA_AUTO: {
+		return "Auto";
+	}
+	default: {
+		return "";
+	}
+	}
+}
+
+bool VR_Network_Resample::resample(const uchar *pixels, uint w_old, uint h_old,
+	uchar *pixels_new, uint w_new, uint h_new, uint depth,
+	const uint *depth_buffer, Filter filter, ISA isa)
+{
+	if (!pixels || !pixels_new || depth != 4 ||
+		w_old == 0 || h_old == 0 || w_new == 0 || h_new == 0) {
+		return false;
+	}
+
+	if (isa == ISA_AUTO) {
+		isa = is_supported(ISA_AVX2) ? ISA_AVX2 : (is_supported(ISA_SSE2) ? ISA_SSE2 : ISA_SCALAR);
+	}
+	else if (!is_supported(isa)) {
+		return false;
+	}
+
+	const uchar *depth_u8 = (const uchar*)depth_buffer;
+
+	if (filter == FILTER_BILINEAR) {
+		BilinearLUT lut;
+		bilinear_axis_build(lut.x0, lut.x1, lut.wx, w_old, w_new, false);
+		bilinear_axis_build(lut.y0, lut.y1, lut.wy, h_old, h_new, true);
+#pragma omp parallel for
+		for (int y = 0; y < (int)h_new; ++y) {
+			uchar *dst = &pixels_new[y * w_new * 4];
+#ifdef VR_RESAMPLE_SSE2
+			/* NOTE: AVX2 has no benefit for one pixel per iteration. */
+			if (isa != ISA_SCALAR) {
+				bilinear_row_sse2(pixels, depth_u8, dst, lut, w_old, y, w_new);
+				continue;
+			}
+#endif
+			bilinear_row_scalar(pixels, depth_u8, dst, lut, w_old, y, w_new);
+		}
+		return true;
+	}
+
+	NearestLUT lut;
+	nearest_lut_build(lut, w_old, h_old, w_new, h_new);
+	const int n = (int)(w_old * h_old);
+
+#pragma omp parallel for
+	for (int y = 0; y < (int)h_new; ++y) {
+		uchar *dst = &pixels_new[y * w_new * 4];
+		/* Only the first source row can address past the end of the buffer (see nearest_row_scalar()),
+		 * leave those pixels to the scalar loop. */
+		const int x_end = (lut.row[y] == n) ? lut.cols_nonzero : (int)w_new;
+		int x = 0;
+		switch (isa) {
+#ifdef VR_RESAMPLE_AVX2
+		case ISA_AVX2: {
+			x = nearest_row_avx2(pixels, depth_u8, dst, lut, y, x_end);
+			break;
+		}
+#endif
+#ifdef VR_RESAMPLE_SSE2
+		case ISA_SSE2: {
+			x = nearest_row_sse2(pixels, depth_u8, dst, lut, y, x_end);
+			break;
+		}
+#endif
+		default: {
+			break;
+		}
+		}
+		nearest_row_scalar(pixels, depth_u8, dst, lut, y, x, (int)w_new, n);
+	}
+
+	return true;
+}
@@ -0,0 +1,73 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_network_resample.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_NETWORK_RESAMPLE_H__
+#define __VR_NETWORK_RESAMPLE_H__
+
+#include "vr_types.h"
+
+/* Resample kernel for VR remote streaming.
+ * Converts a viewport read-back (RGBA, bottom-up) into a streamed eye image in a single pass:
+ * downscale, vertical + horizontal flip, alpha from the depth buffer (for see-through displays).
+ * Source pixels are addressed through per-row / per-column lookup tables,
+ * so there is no per-pixel division in the inner loops. */
+class VR_Network_Resample
+{
+public:
+	/* Sampling filters. */
+	typedef enum Filter {
+		FILTER_NEAREST = 0	/* Nearest neighbour (identical to the original VR_Network::resample_pixels()). */
+		,
+		FILTER_BILINEAR = 1	/* Bilinear interpolation of the four closest pixels. */
+		,
+		FILTERS = 2	/* Number of filters. */
+	} Filter;
+
+	/* Instruction sets of the kernel. */
+	typedef enum ISA {
+		ISA_SCALAR = 0	/* Portable C++. */
+		,
+		ISA_SSE2 = 1	/* SSE2 (4 pixels per iteration). */
+		,
+		ISA_AVX2 = 2	/* AVX2 (8 pixels per iteration with gather loads). */
+		,
+		ISA_AUTO = 3	/* Best instruction set supported by the CPU. */
+	} ISA;
+
+	static bool is_supported(ISA isa);	/* Whether the instruction set is available in this build and on this CPU. */
+	static const char *name(ISA isa);	/* Human-readable instruction set name. */
+
+	/* Resample pixels (w_old x h_old, RGBA) into pixels_new (w_new x h_new, depth must be 4).
+	 * depth_buffer (optional) is the <depth 24, stencil 8> buffer matching pixels. */
+	static bool resample(const uchar *pixels, uint w_old, uint h_old,
+		uchar *pixels_new, uint w_new, uint h_new, uint depth,
+		const uint *depth_buffer = 0, Filter filter = FILTER_NEAREST, ISA isa = ISA_AUTO);
+};
+
+#endif /* __VR_NETWORK_RESAMPLE_H__ */
@@ -0,0 +1,206 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_network_ring.cpp
+*   \ingroup vr
+*/
+
+#include "vr_types.h"
+
+#include "vr_network_ring.h"
+
+#include <chrono>
+
+/***************************************************************************************************
+ * \class                                  VR_Network_FrameRing
+ ***************************************************************************************************
+ * Triple-buffered frame ring between the capture, encode and send stages.
+ **************************************************************************************************/
+
+bool VR_Network_FrameRing::Slot::resize(uint width, uint height, uint depth)
+{
+	if (w == width && h == height && d == depth) {
+		return true;
+	}
+	w = width;
+	h = height;
+	d = depth;
+	for (int i = 0; i < VR_SIDES; ++i) {
+		pixels[i].resize(width * height * depth);
+		encoded[i].clear();
+	}
+	return true;
+}
+
+VR_Network_FrameRing::VR_Network_FrameRing()
+	: seq_next(0), generation(0)
+{
+	for (int i = 0; i < VR_NETWORK_RING_SLOTS; ++i) {
+		Slot& slot = slots[i];
+		slot.w = slot.h = slot.d = 0;
+		slot.seq = 0;
+		slot.time_capture = slot.time_captured = slot.time_encoded = 0.0;
+		slots_state[i] = STATE_FREE;
+	}
+}
+
+VR_Network_FrameRing::~VR_Network_FrameRing()
+{
+	//
+}
+
+bool VR_Network_FrameRing::transition(int i, State from, State to)
+{
+	int expected = from;
+	return slots_state[i].compare_exchange_strong(expected, (int)to);
+}
+
+int VR_Network_FrameRing::find(State s) const
+{
+	for (int i = 0; i < VR_NETWORK_RING_SLOTS; ++i) {
+		if (slots_state[i].load() == s) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+void VR_Network_FrameRing::notify()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++generation;
+	}
+	condition.notify_all();
+}
+
+VR_Network_FrameRing::Slot *VR_Network_FrameRing::acquire_capture()
+{
+	/* The loop only repeats when a consumer changed a slot state concurrently. */
+	for (int attempt = 0; attempt < 4; ++attempt) {
+		/* Overwrite the captured frame the encoder did not pick up yet (latest frame wins). */
+		int i = find(STATE_CAPTURED);
+		if (i >= 0 && transition(i, STATE_CAPTURED, STATE_CAPTURING)) {
+			return &slots[i];
+		}
+		i = find(STATE_FREE);
+		if (i >= 0 && transition(i, STATE_FREE, STATE_CAPTURING)) {
+			return &slots[i];
+		}
+	}
+	return NULL;
+}
+
+void VR_Network_FrameRing::publish_capture(Slot *slot)
+{
+	const int i = (int)(slot - slots);
+	slot->seq = seq_next++;
+	transition(i, STATE_CAPTURING, STATE_CAPTURED);
+	notify();
+}
+
+void VR_Network_FrameRing::cancel_capture(Slot *slot)
+{
+	const int i = (int)(slot - slots);
+	transition(i, STATE_CAPTURING, STATE_FREE);
+}
+
+VR_Network_FrameRing::Slot *VR_Network_FrameRing::acquire_encode(uint timeout_ms)
+{
+	const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+	for (;;) {
+		std::unique_lock<std::mutex> lock(mutex);
+		const ui64 gen = generation;
+		/* Only start encoding once the previously encoded frame was taken by the sender. */
+		if (find(STATE_ENCODED) < 0) {
+			const int i = find(STATE_CAPTURED);
+			if (i >= 0 && transition(i, STATE_CAPTURED, STATE_ENCODING)) {
+				return &slots[i];
+			}
+		}
+		if (!condition.wait_until(lock, deadline, [&] { return generation != gen; })) {
+			return NULL;	/* timeout */
+		}
+	}
+}
+
+void VR_Network_FrameRing::publish_encode(Slot *slot, bool success)
+{
+	const int i = (int)(slot - slots);
+	transition(i, STATE_ENCODING, success ? STATE_ENCODED : STATE_FREE);
+	notify();
+}
+
+VR_Network_FrameRing::Slot *VR_Network_FrameRing::acquire_send(uint timeout_ms, bool allow_resend)
+{
+	const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+
+	for (;;) {
+		std::unique_lock<std::mutex> lock(mutex);
+		const ui64 gen = generation;
+		const int i = find(STATE_ENCODED);
+		if (i >= 0 && transition(i, STATE_ENCODED, STATE_SENDING)) {
+			/* The previously sent frame is no longer needed. */
+			const int j = find(STATE_SENT);
+			if (j >= 0) {
+				transition(j, STATE_SENT, STATE_FREE);
+			}
+			lock.unlock();
+			notify();	/* the encoder may continue */
+			return &slots[i];
+		}
+		if (!condition.wait_until(lock, deadline, [&] { return generation != gen; })) {
+			break;	/* timeout */
+		}
+	}
+
+	if (allow_resend) {
+		const int i = find(STATE_SENT);
+		if (i >= 0 && transition(i, STATE_SENT, STATE_SENDING)) {
+			return &slots[i];
+		}
+	}
+	return NULL;
+}
+
+void VR_Network_FrameRing::release_send(Slot *slot)
+{
+	const int i = (int)(slot - slots);
+	transition(i, STATE_SENDING, STATE_SENT);
+}
+
+void VR_Network_FrameRing::wake_all()
+{
+	notify();
+}
+
+void VR_Network_FrameRing::reset()
+{
+	for (int i = 0; i < VR_NETWORK_RING_SLOTS; ++i) {
+		slots_state[i] = STATE_FREE;
+	}
+	notify();
+}
@@ -0,0 +1,124 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_network_ring.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_NETWORK_RING_H__
+#define __VR_NETWORK_RING_H__
+
+#include "vr_types.h"
+#include "vr_main.h"
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+/* Number of frame slots (one per pipeline stage: capture, encode, send). */
+#define VR_NETWORK_RING_SLOTS 3
+
+/* Triple-buffered frame ring between the render thread (capture), the image thread (encode)
+ * and the networking thread (send).
+ * Every slot owns its pixel and encoded buffers and is owned by at most one stage at a time,
+ * so frames are never torn and never copied between stages.
+ * Slot ownership is transferred with atomic state transitions; the mutex / condition variable
+ * are only used to put idle consumers to sleep until a producer publishes a slot.
+ *
+ * Policy:
+ * - Capture never blocks: if the encoder has not picked up the last captured frame yet,
+ *   the capture overwrites it (latest frame wins).
+ * - Encode waits until the previously encoded frame was handed to the sender,
+ *   since inter-frame codecs must not drop encoded frames.
+ * - The last sent frame is retained, so it can be re-sent to clients that require a frame per request. */
+class VR_Network_FrameRing
+{
+public:
+	/* Slot states. */
+	typedef enum State {
+		STATE_FREE = 0	/* Unused. */
+		,
+		STATE_CAPTURING = 1	/* Owned by the render thread. */
+		,
+		STATE_CAPTURED = 2	/* Waiting for the encoder (may be overwritten by the next capture). */
+		,
+		STATE_ENCODING = 3	/* Owned by the image thread. */
+		,
+		STATE_ENCODED = 4	/* Waiting for the sender. */
+		,
+		STATE_SENDING = 5	/* Owned by the networking thread. */
+		,
+		STATE_SENT = 6	/* Last sent frame (retained for re-sending). */
+	} State;
+
+	/* Frame slot. */
+	typedef struct Slot {
+		uint w;	/* Image width in pixels. */
+		uint h;	/* Image height in pixels. */
+		uint d;	/* Image depth (bytes per pixel). */
+		std::vector<uchar> pixels[VR_SIDES];	/* Captured eye images. */
+		std::vector<uchar> encoded[VR_SIDES];	/* Encoded eye images. */
+		ui64 seq;	/* Sequence number of the captured frame. */
+		double time_capture;	/* Time when the capture started (seconds). */
+		double time_captured;	/* Time when the capture was published (seconds). */
+		double time_encoded;	/* Time when the encoding finished (seconds). */
+
+		bool resize(uint width, uint height, uint depth);	/* (Re-)allocate the pixel buffers. */
+	} Slot;
+
+	VR_Network_FrameRing();
+	~VR_Network_FrameRing();
+
+	Slot *acquire_capture();	/* Get a slot for capturing (never blocks; NULL only if all slots are in use downstream). */
+	void publish_capture(Slot *slot);	/* Hand a captured slot to the encoder. */
+	void cancel_capture(Slot *slot);	/* Release a slot without publishing it. */
+
+	Slot *acquire_encode(uint timeout_ms);	/* Wait for the newest captured slot (NULL on timeout / wake-up). */
+	void publish_encode(Slot *slot, bool success);	/* Hand an encoded slot to the sender (or drop it on failure). */
+
+	Slot *acquire_send(uint timeout_ms, bool allow_resend);	/* Wait for an encoded slot (or re-use the last sent one). */
+	void release_send(Slot *slot);	/* Mark a slot as sent. */
+
+	void wake_all();	/* Wake all waiting threads (i.e. for termination). */
+	void reset();	/* Return all slots to the free state (no slot may be owned by a thread). */
+
+	State state(int i) const { return (State)slots_state[i].load(); }	/* Current state of a slot. */
+
+protected:
+	bool transition(int i, State from, State to);	/* Atomically change the state of slot i. */
+	int find(State s) const;	/* Index of a slot in the given state (-1 if none). */
+	void notify();	/* Wake waiting consumers. */
+
+	Slot slots[VR_NETWORK_RING_SLOTS];	/* Frame slots. */
+	std::atomic<int> slots_state[VR_NETWORK_RING_SLOTS];	/* State of each slot (VR_Network_FrameRing::State). */
+	std::atomic<ui64> seq_next;	/* Next capture sequence number. */
+
+	std::mutex mutex;	/* Mutex for the condition variable. */
+	std::condition_variable condition;	/* Signaled whenever a slot is published or released. */
+	ui64 generation;	/* Incremented on every notify() (protected by mutex). */
+};
+
+#endif /* __VR_NETWORK_RING_H__ */
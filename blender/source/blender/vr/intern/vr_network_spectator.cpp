@@ -0,0 +1,890 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_network_spectator.cpp
+*   \ingroup vr
+*
+* Spectator streams of the remote streaming (fan-out of one encoded frame to many viewers).
+*/
+
+#include "vr_types.h"
+
+#include "vr_network_spectator.h"
+
+#include "PIL_time.h"
+
+#ifdef WIN32
+#include <WinSock2.h>
+#include <Ws2tcpip.h>
+#else
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+
+/* Time (seconds) after which sending to / receiving from a spectator is given up. */
+#define VR_NETWORK_SPECTATOR_TIMEOUT	1.0
+
+#ifdef WIN32
+typedef SOCKET vr_socket;
+#define VR_SOCKET_INVALID INVALID_SOCKET
+#define vr_socket_close closesocket
+#else
+typedef int vr_socket;
+#define VR_SOCKET_INVALID (-1)
+#define vr_socket_close ::close
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define VR_SOCKET_SEND_FLAGS MSG_NOSIGNAL
+#else
+#define VR_SOCKET_SEND_FLAGS 0
+#endif
+
+/* CPU time used by the calling thread (seconds). */
+static double thread_cpu_time()
+{
+#ifdef WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+		return 0.0;
+	}
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	return (double)(k.QuadPart + u.QuadPart) * 1e-7;
+#else
+	struct timespec ts;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) {
+		return 0.0;
+	}
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* Create a TCP socket (initializing Winsock if required). */
+static long long socket_create()
+{
+#ifdef WIN32
+	WSADATA wsa_data;
+	if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+		return -1;
+	}
+#endif
+	vr_socket s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	if (s == VR_SOCKET_INVALID) {
+#ifdef WIN32
+		WSACleanup();
+#endif
+		return -1;
+	}
+	return (long long)s;
+}
+
+/* Close a socket made by socket_create(). */
+static void socket_destroy(long long s)
+{
+	vr_socket_close((vr_socket)s);
+#ifdef WIN32
+	WSACleanup();
+#endif
+}
+
+/* Set the send / receive timeouts and disable Nagle's algorithm (frames are sent whole). */
+static void socket_setup_stream(long long s)
+{
+#ifdef WIN32
+	DWORD timeout = (DWORD)(VR_NETWORK_SPECTATOR_TIMEOUT * 1000.0);
+#else
+	struct timeval timeout;
+	timeout.tv_sec = (long)VR_NETWORK_SPECTATOR_TIMEOUT;
+	timeout.tv_usec = (long)((VR_NETWORK_SPECTATOR_TIMEOUT - (double)timeout.tv_sec) * 1e6);
+#endif
+	setsockopt((vr_socket)s, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout, sizeof(timeout));
+	setsockopt((vr_socket)s, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeout, sizeof(timeout));
+	int yes = 1;
+	setsockopt((vr_socket)s, IPPROTO_TCP, TCP_NODELAY, (const char*)&yes, sizeof(yes));
+#ifdef SO_NOSIGPIPE
+	setsockopt((vr_socket)s, SOL_SOCKET, SO_NOSIGPIPE, (const char*)&yes, sizeof(yes));
+#endif
+}
+
+/* Wait until a socket is readable (returns 1), or the timeout passed (returns 0). */
+static int socket_wait_readable(long long s, uint timeout_ms)
+{
+	for (;;) {
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET((vr_socket)s, &fds);
+		struct timeval tv;
+		tv.tv_sec = timeout_ms / 1000;
+		tv.tv_usec = (timeout_ms % 1000) * 1000;
+		const int ret = select((int)s + 1, &fds, NULL, NULL, &tv);
+#ifndef WIN32
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+#endif
+		return (ret > 0) ? 1 : ret;
+	}
+}
+
+/* Send all bytes (blocking, up to the send timeout of the socket). */
+static bool socket_send_all(long long s, const void *data, size_t size)
+{
+	const char *ptr = (const char*)data;
+	while (size > 0) {
+		const int len = (int)send((vr_socket)s, ptr, (int)std::min(size, (size_t)(1 << 30)), VR_SOCKET_SEND_FLAGS);
+		if (len <= 0) {
+#ifndef WIN32
+			if (len < 0 && errno == EINTR) {
+				continue;
+			}
+#endif
+			return false;
+		}
+		ptr += len;
+		size -= (size_t)len;
+	}
+	return true;
+}
+
+/* Receive all bytes (blocking, up to the receive timeout of the socket). */
+static bool socket_receive_all(long long s, void *data, size_t size)
+{
+	char *ptr = (char*)data;
+	while (size > 0) {
+		const int len = (int)recv((vr_socket)s, ptr, (int)std::min(size, (size_t)(1 << 30)), 0);
+		if (len <= 0) {
+#ifndef WIN32
+			if (len < 0 && errno == EINTR) {
+				continue;
+			}
+#endif
+			return false;
+		}
+		ptr += len;
+		size -= (size_t)len;
+	}
+	return true;
+}
+
+/* Halve an image with a 2x2 box filter (odd edges are clamped). */
+static void downsample_half(const uchar *pixels, uint w, uint h, uint d, uchar *pixels_new, uint w_new, uint h_new)
+{
+	const uint stride = w * d;
+	for (uint y = 0; y < h_new; ++y) {
+		const uchar *row0 = pixels + (2 * y) * stride;
+		const uchar *row1 = pixels + std::min(2 * y + 1, h - 1) * stride;
+		uchar *dst = pixels_new + y * w_new * d;
+		for (uint x = 0; x < w_new; ++x) {
+			const uint x0 = (2 * x) * d;
+			const uint x1 = std::min(2 * x + 1, w - 1) * d;
+			for (uint c = 0; c < d; ++c) {
+				*dst++ = (uchar)(((uint)row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+			}
+		}
+	}
+}
+
+/***************************************************************************************************
+ * \class                                   VR_Network_SpectatorQueue
+ ***************************************************************************************************
+ * Send queue of one spectator (drop-oldest).
+ **************************************************************************************************/
+VR_Network_SpectatorQueue::VR_Network_SpectatorQueue(uint capacity)
+	: capacity(std::max(capacity, 1u))
+	, num_dropped(0)
+	, closed(false)
+{
+	//
+}
+
+bool VR_Network_SpectatorQueue::push(const VR_Network_SpectatorFramePtr& frame)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	if (closed) {
+		return false;
+	}
+	bool dropped = false;
+	if (frames.size() >= capacity) {
+		frames.pop_front();
+		++num_dropped;
+		dropped = true;
+	}
+	frames.push_back(frame);
+	lock.unlock();
+	condition.notify_one();
+	return !dropped;
+}
+
+VR_Network_SpectatorFramePtr VR_Network_SpectatorQueue::pop(uint timeout_ms)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	if (frames.empty() && !closed) {
+		condition.wait_for(lock, std::chrono::milliseconds(timeout_ms));
+	}
+	if (frames.empty() || closed) {
+		return VR_Network_SpectatorFramePtr();
+	}
+	VR_Network_SpectatorFramePtr frame = frames.front();
+	frames.pop_front();
+	return frame;
+}
+
+void VR_Network_SpectatorQueue::close()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	closed = true;
+	frames.clear();
+	lock.unlock();
+	condition.notify_all();
+}
+
+uint VR_Network_SpectatorQueue::size() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return (uint)frames.size();
+}
+
+uint VR_Network_SpectatorQueue::dropped() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return num_dropped;
+}
+
+/***************************************************************************************************
+ * \class                                   VR_Network_SpectatorServer
+ ***************************************************************************************************
+ * Fan-out server of the spectator streams.
+ **************************************************************************************************/
+const char VR_Network_SpectatorServer::magic_sequence[4] = { 'B', 'X', 'R', 'S' };
+
+VR_Network_SpectatorServer::Spectator::Spectator(long long sock, VR_Network_SpectatorVariant variant, uint capacity, double time)
+	: sock(sock)
+	, variant(variant)
+	, queue(capacity)
+	, alive(true)
+	, frames_sent(0)
+	, bytes_sent(0)
+	, time_connected(time)
+{
+	//
+}
+
+VR_Network_SpectatorServer::VR_Network_SpectatorServer()
+	: max_fps(0)
+	, queue_capacity(VR_Network_SpectatorQueue::default_capacity)
+	, codec(VR_Network_Encoder::TYPE_DELTA_RLE)
+	, listen_sock(-1)
+	, running(false)
+	, variants(0)
+	, have_pending(false)
+	, time_next_submit(0.0)
+{
+	encoder[0] = encoder[1] = 0;
+	memset(&stats, 0, sizeof(stats));
+}
+
+VR_Network_SpectatorServer::~VR_Network_SpectatorServer()
+{
+	stop();
+}
+
+bool VR_Network_SpectatorServer::start(const char *ip_address, ushort port)
+{
+	stop();
+
+	/* Only listen on the given interface, never on all of them. */
+	const unsigned long addr = inet_addr(ip_address);
+	if (addr == INADDR_NONE || addr == INADDR_ANY) {
+		return false;
+	}
+
+	long long s = socket_create();
+	if (s == -1) {
+		return false;
+	}
+
+	int yes = 1;
+	setsockopt((vr_socket)s, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+
+	struct sockaddr_in host_addr;
+	memset(&host_addr, 0, sizeof(host_addr));
+	host_addr.sin_family = AF_INET;
+	host_addr.sin_port = htons(port);
+	host_addr.sin_addr.s_addr = addr;
+	if (bind((vr_socket)s, (struct sockaddr*)&host_addr, sizeof(host_addr)) != 0 ||
+		listen((vr_socket)s, SOMAXCONN) != 0) {
+		socket_destroy(s);
+		return false;
+	}
+
+	listen_sock = s;
+	memset(&stats, 0, sizeof(stats));
+	have_pending = false;
+	time_next_submit = 0.0;
+	running = true;
+	listen_thread = std::thread(&VR_Network_SpectatorServer::listen_thread_func, this);
+	encode_thread = std::thread(&VR_Network_SpectatorServer::encode_thread_func, this);
+	return true;
+}
+
+void VR_Network_SpectatorServer::stop()
+{
+	if (listen_sock == -1) {
+		return;
+	}
+
+	running = false;
+	pending_condition.notify_all();
+	if (encode_thread.joinable()) {
+		encode_thread.join();
+	}
+	if (listen_thread.joinable()) {
+		listen_thread.join();
+	}
+	remove_spectators(true);
+
+	socket_destroy(listen_sock);
+	listen_sock = -1;
+}
+
+bool VR_Network_SpectatorServer::is_running() const
+{
+	return running;
+}
+
+bool VR_Network_SpectatorServer::wants_frame(double time) const
+{
+	return (variants != 0 && time >= time_next_submit);
+}
+
+bool VR_Network_SpectatorServer::submit(const VR_Network_FrameRing::Slot& slot, bool reuse_encoded)
+{
+	const double time = PIL_check_seconds_timer();
+	const uint mask = variants;
+	if (!running || mask == 0 || time < time_next_submit) {
+		return false;
+	}
+	if (max_fps > 0) {
+		/* Keep the average rate when frames arrive slightly early. */
+		const double interval = 1.0 / (double)max_fps;
+		double next = time_next_submit + interval;
+		if (next <= time) {
+			next = time + interval;
+		}
+		time_next_submit = next;
+	}
+
+	/* Only copy what the requested variants are derived from. */
+	std::unique_lock<std::mutex> lock(pending_mutex);
+	const bool skipped = have_pending;
+	pending.seq = slot.seq;
+	pending.w = slot.w;
+	pending.h = slot.h;
+	pending.d = slot.d;
+	pending.variants = mask;
+	/* The encoded images are re-used for all full resolution eyes, or for none of them. */
+	const bool need_right = (mask & (1 << VR_NETWORK_SPECTATOR_STEREO)) != 0;
+	const bool need_left = need_right || (mask & (1 << VR_NETWORK_SPECTATOR_MONO));
+	const bool reuse = reuse_encoded && need_left &&
+		!slot.encoded[VR_SIDE_LEFT].empty() && (!need_right || !slot.encoded[VR_SIDE_RIGHT].empty());
+	pending.reused = reuse;
+	for (int i = 0; i < VR_SIDES; ++i) {
+		const bool full = (i == VR_SIDE_LEFT) ? need_left : need_right;
+		const bool half = (i == VR_SIDE_LEFT && (mask & (1 << VR_NETWORK_SPECTATOR_MONO_HALF)));
+		if (full && reuse) {
+			pending.encoded[i] = slot.encoded[i];
+		}
+		else {
+			pending.encoded[i].clear();
+		}
+		if ((full && !reuse) || half) {
+			pending.pixels[i] = slot.pixels[i];
+		}
+		else {
+			pending.pixels[i].clear();
+		}
+	}
+	have_pending = true;
+	lock.unlock();
+	pending_condition.notify_one();
+
+	std::lock_guard<std::mutex> stats_lock(stats_mutex);
+	++stats.frames_submitted;
+	if (skipped) {
+		++stats.frames_skipped;
+	}
+	return true;
+}
+
+VR_Network_SpectatorServer::Stats VR_Network_SpectatorServer::get_stats() const
+{
+	uint num_spectators;
+	{
+		std::lock_guard<std::mutex> lock(spectators_mutex);
+		num_spectators = (uint)spectators.size();
+	}
+	std::lock_guard<std::mutex> lock(stats_mutex);
+	Stats s = stats;
+	s.spectators = num_spectators;
+	return s;
+}
+
+void VR_Network_SpectatorServer::get_spectator_stats(std::vector<SpectatorStats>& r_stats) const
+{
+	std::lock_guard<std::mutex> lock(spectators_mutex);
+	r_stats.resize(spectators.size());
+	for (size_t i = 0; i < spectators.size(); ++i) {
+		const Spectator *spectator = spectators[i];
+		SpectatorStats& s = r_stats[i];
+		s.variant = spectator->variant;
+		s.frames_sent = spectator->frames_sent;
+		s.frames_dropped = spectator->queue.dropped();
+		s.bytes_sent = spectator->bytes_sent;
+		s.time_connected = spectator->time_connected;
+	}
+}
+
+void VR_Network_SpectatorServer::remove_spectators(bool all)
+{
+	std::vector<Spectator *> removed;
+	{
+		std::lock_guard<std::mutex> lock(spectators_mutex);
+		uint mask = 0;
+		for (size_t i = 0; i < spectators.size();) {
+			Spectator *spectator = spectators[i];
+			if (all || !spectator->alive) {
+				removed.push_back(spectator);
+				spectators.erase(spectators.begin() + i);
+				continue;
+			}
+			mask |= (1 << spectator->variant);
+			++i;
+		}
+		variants = mask;
+	}
+
+	for (size_t i = 0; i < removed.size(); ++i) {
+		Spectator *spectator = removed[i];
+		/* Unblock a sender waiting for the queue or for the socket. */
+		spectator->alive = false;
+		spectator->queue.close();
+#ifdef WIN32
+		shutdown((vr_socket)spectator->sock, SD_BOTH);
+#else
+		shutdown((vr_socket)spectator->sock, SHUT_RDWR);
+#endif
+		if (spectator->thread.joinable()) {
+			spectator->thread.join();
+		}
+		socket_destroy(spectator->sock);
+		delete spectator;
+	}
+}
+
+void VR_Network_SpectatorServer::listen_thread_func()
+{
+	double cpu_prev = thread_cpu_time();
+
+	while (running) {
+		remove_spectators(false);
+
+		if (socket_wait_readable(listen_sock, 100) <= 0) {
+			continue;
+		}
+		vr_socket s = accept((vr_socket)listen_sock, NULL, NULL);
+		if (s == VR_SOCKET_INVALID) {
+			continue;
+		}
+#ifdef WIN32
+		/* Balance the WSACleanup() of socket_destroy(). */
+		WSADATA wsa_data;
+		WSAStartup(MAKEWORD(2, 2), &wsa_data);
+#endif
+		socket_setup_stream((long long)s);
+
+		/* The spectator asks for a variant right after connecting. */
+		VR_Network_SpectatorHello hello;
+		const bool valid = socket_receive_all((long long)s, &hello, sizeof(hello)) &&
+			memcmp(hello.magic, magic_sequence, sizeof(hello.magic)) == 0 &&
+			hello.variant < VR_NETWORK_SPECTATOR_VARIANTS;
+		std::unique_lock<std::mutex> lock(spectators_mutex);
+		if (!valid || spectators.size() >= VR_NETWORK_SPECTATOR_MAX) {
+			lock.unlock();
+			socket_destroy((long long)s);
+			continue;
+		}
+		Spectator *spectator = new Spectator((long long)s, (VR_Network_SpectatorVariant)hello.variant,
+			queue_capacity, PIL_check_seconds_timer());
+		spectator->thread = std::thread(&VR_Network_SpectatorServer::send_thread_func, this, spectator);
+		spectators.push_back(spectator);
+		variants |= (1 << spectator->variant);
+		lock.unlock();
+
+		const double cpu = thread_cpu_time();
+		std::lock_guard<std::mutex> stats_lock(stats_mutex);
+		stats.cpu_send += cpu - cpu_prev;
+		cpu_prev = cpu;
+	}
+
+	const double cpu = thread_cpu_time();
+	std::lock_guard<std::mutex> stats_lock(stats_mutex);
+	stats.cpu_send += cpu - cpu_prev;
+}
+
+void VR_Network_SpectatorServer::send_thread_func(Spectator *spectator)
+{
+	double cpu_prev = thread_cpu_time();
+
+	while (running && spectator->alive) {
+		VR_Network_SpectatorFramePtr frame = spectator->queue.pop(100);
+		if (!frame) {
+			continue;
+		}
+
+		const VR_Network_SpectatorFrameHeader& header = frame->header;
+		bool success = socket_send_all(spectator->sock, &header, sizeof(header));
+		ui64 bytes = sizeof(header);
+		for (uint i = 0; success && i < header.num_images; ++i) {
+			if (header.size[i] == 0) {
+				continue;
+			}
+			success = socket_send_all(spectator->sock, &(*frame->images[i])[0], header.size[i]);
+			bytes += header.size[i];
+		}
+		if (!success) {
+			/* Disconnected, or didn't accept any data for the timeout: removed by the listener. */
+			spectator->alive = false;
+			break;
+		}
+		++spectator->frames_sent;
+		spectator->bytes_sent += bytes;
+
+		const double cpu = thread_cpu_time();
+		std::lock_guard<std::mutex> stats_lock(stats_mutex);
+		++stats.frames_sent;
+		stats.bytes_sent += bytes;
+		stats.cpu_send += cpu - cpu_prev;
+		cpu_prev = cpu;
+	}
+
+	const double cpu = thread_cpu_time();
+	std::lock_guard<std::mutex> stats_lock(stats_mutex);
+	stats.cpu_send += cpu - cpu_prev;
+}
+
+void VR_Network_SpectatorServer::encode_thread_func()
+{
+	double cpu_prev = thread_cpu_time();
+
+	while (running) {
+		{
+			std::unique_lock<std::mutex> lock(pending_mutex);
+			if (!have_pending) {
+				pending_condition.wait_for(lock, std::chrono::milliseconds(100));
+			}
+			if (!have_pending || !running) {
+				continue;
+			}
+			/* Take the frame, leaving the buffers of the previous one for the next submit. */
+			std::swap(pending, work);
+			have_pending = false;
+		}
+
+		encode(work);
+
+		const double cpu = thread_cpu_time();
+		std::lock_guard<std::mutex> stats_lock(stats_mutex);
+		stats.cpu_encode += cpu - cpu_prev;
+		cpu_prev = cpu;
+	}
+
+	for (int i = 0; i < 2; ++i) {
+		if (encoder[i]) {
+			delete encoder[i];
+			encoder[i] = 0;
+		}
+	}
+}
+
+VR_Network_Encoder *VR_Network_SpectatorServer::get_encoder(int i, uint w, uint h, uint d)
+{
+	VR_Network_Encoder *enc = encoder[i];
+	if (enc && enc->type() == codec && enc->width() == w && enc->height() == h && enc->depth() == d) {
+		return enc;
+	}
+	if (enc) {
+		delete enc;
+	}
+	encoder[i] = VR_Network_Encoder::create(codec, w, h, d, max_fps > 0 ? max_fps : VR_NETWORK_DEFAULT_FPS);
+	return encoder[i];
+}
+
+void VR_Network_SpectatorServer::encode(Pending& frame)
+{
+	typedef std::shared_ptr<const std::vector<uchar> > ImagePtr;
+
+	const uint mask = frame.variants;
+	const uint w = frame.w, h = frame.h, d = frame.d;
+	const VR_Network_Encoder::Type codec_full = frame.reused ? VR_Network_Encoder::TYPE_ZLIB : codec;
+	uint images_encoded = 0, images_reused = 0;
+
+	/* Every image is encoded once, no matter how many variants and spectators use it.
+	 * Frames of the send queues may be dropped, so every frame is a keyframe. */
+	ImagePtr full[VR_SIDES];
+	for (int i = 0; i < VR_SIDES; ++i) {
+		if (frame.reused) {
+			if (frame.encoded[i].empty()) {
+				continue;
+			}
+			full[i] = std::make_shared<const std::vector<uchar> >(std::move(frame.encoded[i]));
+			frame.encoded[i].clear();
+			++images_reused;
+			continue;
+		}
+		const bool needed = (mask & (1 << VR_NETWORK_SPECTATOR_STEREO)) ||
+			(i == VR_SIDE_LEFT && (mask & (1 << VR_NETWORK_SPECTATOR_MONO)));
+		if (!needed || frame.pixels[i].size() != (size_t)w * h * d) {
+			continue;
+		}
+		VR_Network_Encoder *enc = get_encoder(0, w, h, d);
+		if (!enc) {
+			continue;
+		}
+		std::shared_ptr<std::vector<uchar> > out = std::make_shared<std::vector<uchar> >();
+		enc->request_keyframe();
+		if (enc->encode(&frame.pixels[i][0], *out)) {
+			full[i] = out;
+			++images_encoded;
+		}
+	}
+
+	ImagePtr half;
+	const uint w_half = std::max(w / 2, 1u), h_half = std::max(h / 2, 1u);
+	if ((mask & (1 << VR_NETWORK_SPECTATOR_MONO_HALF)) &&
+		frame.pixels[VR_SIDE_LEFT].size() == (size_t)w * h * d) {
+		pixels_half.resize((size_t)w_half * h_half * d);
+		downsample_half(&frame.pixels[VR_SIDE_LEFT][0], w, h, d, &pixels_half[0], w_half, h_half);
+		VR_Network_Encoder *enc = get_encoder(1, w_half, h_half, d);
+		if (enc) {
+			std::shared_ptr<std::vector<uchar> > out = std::make_shared<std::vector<uchar> >();
+			enc->request_keyframe();
+			if (enc->encode(&pixels_half[0], *out)) {
+				half = out;
+				++images_encoded;
+			}
+		}
+	}
+
+	/* Assemble the frames of the variants. */
+	VR_Network_SpectatorFramePtr frames[VR_NETWORK_SPECTATOR_VARIANTS];
+	for (int v = 0; v < VR_NETWORK_SPECTATOR_VARIANTS; ++v) {
+		if (!(mask & (1 << v))) {
+			continue;
+		}
+		std::shared_ptr<VR_Network_SpectatorFrame> f = std::make_shared<VR_Network_SpectatorFrame>();
+		VR_Network_SpectatorFrameHeader& header = f->header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, magic_sequence, sizeof(header.magic));
+		header.variant = (uint)v;
+		header.seq = frame.seq;
+		header.codec = (uint)((v == VR_NETWORK_SPECTATOR_MONO_HALF) ? codec : codec_full);
+		switch (v) {
+		case VR_NETWORK_SPECTATOR_STEREO: {
+			if (!full[VR_SIDE_LEFT] || !full[VR_SIDE_RIGHT]) {
+				continue;
+			}
+			header.w = w;
+			header.h = h;
+			header.num_images = 2;
+			f->images[VR_SIDE_LEFT] = full[VR_SIDE_LEFT];
+			f->images[VR_SIDE_RIGHT] = full[VR_SIDE_RIGHT];
+			break;
+		}
+		case VR_NETWORK_SPECTATOR_MONO: {
+			if (!full[VR_SIDE_LEFT]) {
+				continue;
+			}
+			header.w = w;
+			header.h = h;
+			header.num_images = 1;
+			f->images[VR_SIDE_LEFT] = full[VR_SIDE_LEFT];
+			break;
+		}
+		case VR_NETWORK_SPECTATOR_MONO_HALF:
+		default: {
+			if (!half) {
+				continue;
+			}
+			header.w = w_half;
+			header.h = h_half;
+			header.num_images = 1;
+			f->images[VR_SIDE_LEFT] = half;
+			break;
+		}
+		}
+		for (uint i = 0; i < header.num_images; ++i) {
+			header.size[i] = (uint)f->images[i]->size();
+		}
+		frames[v] = f;
+	}
+
+	{
+		std::lock_guard<std::mutex> stats_lock(stats_mutex);
+		stats.images_encoded += images_encoded;
+		stats.images_reused += images_reused;
+	}
+
+	/* Fan out (spectators that don't keep up lose their oldest queued frame). */
+	uint dropped = 0;
+	bool queued = false;
+	{
+		std::lock_guard<std::mutex> lock(spectators_mutex);
+		for (size_t i = 0; i < spectators.size(); ++i) {
+			Spectator *spectator = spectators[i];
+			const VR_Network_SpectatorFramePtr& f = frames[spectator->variant];
+			if (!f || !spectator->alive) {
+				continue;
+			}
+			queued = true;
+			if (!spectator->queue.push(f)) {
+				++dropped;
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> stats_lock(stats_mutex);
+	if (queued) {
+		++stats.frames_encoded;
+	}
+	stats.frames_dropped += dropped;
+}
+
+/***************************************************************************************************
+ * \class                                   VR_Network_SpectatorClient
+ ***************************************************************************************************
+ * Spectator side of the stream.
+ **************************************************************************************************/
+VR_Network_SpectatorClient::VR_Network_SpectatorClient()
+	: sock(-1)
+{
+	//
+}
+
+VR_Network_SpectatorClient::~VR_Network_SpectatorClient()
+{
+	close();
+}
+
+bool VR_Network_SpectatorClient::open(const char *ip_address, ushort port, VR_Network_SpectatorVariant variant)
+{
+	close();
+
+	long long s = socket_create();
+	if (s == -1) {
+		return false;
+	}
+
+	struct sockaddr_in host_addr;
+	memset(&host_addr, 0, sizeof(host_addr));
+	host_addr.sin_family = AF_INET;
+	host_addr.sin_port = htons(port);
+	host_addr.sin_addr.s_addr = inet_addr(ip_address);
+	if (connect((vr_socket)s, (struct sockaddr*)&host_addr, sizeof(host_addr)) != 0) {
+		socket_destroy(s);
+		return false;
+	}
+	socket_setup_stream(s);
+
+	VR_Network_SpectatorHello hello;
+	memcpy(hello.magic, VR_Network_SpectatorServer::magic_sequence, sizeof(hello.magic));
+	hello.variant = (uint)variant;
+	if (!socket_send_all(s, &hello, sizeof(hello))) {
+		socket_destroy(s);
+		return false;
+	}
+
+	sock = s;
+	return true;
+}
+
+void VR_Network_SpectatorClient::close()
+{
+	if (sock != -1) {
+		socket_destroy(sock);
+		sock = -1;
+	}
+}
+
+bool VR_Network_SpectatorClient::is_open() const
+{
+	return (sock != -1);
+}
+
+bool VR_Network_SpectatorClient::receive_bytes(void *data, uint size)
+{
+	return socket_receive_all(sock, data, size);
+}
+
+int VR_Network_SpectatorClient::receive(VR_Network_SpectatorFrameHeader& r_header, std::vector<uchar> r_images[VR_SIDES], uint timeout_ms)
+{
+	if (sock == -1) {
+		return -1;
+	}
+
+	const int ret = socket_wait_readable(sock, timeout_ms);
+	if (ret <= 0) {
+		return ret;
+	}
+
+	/* The rest of the frame follows the header right away. */
+	if (!receive_bytes(&r_header, sizeof(r_header)) ||
+		memcmp(r_header.magic, VR_Network_SpectatorServer::magic_sequence, sizeof(r_header.magic)) != 0 ||
+		r_header.num_images > VR_SIDES) {
+		return -1;
+	}
+	for (uint i = 0; i < r_header.num_images; ++i) {
+		r_images[i].resize(r_header.size[i]);
+		if (r_header.size[i] > 0 && !receive_bytes(&r_images[i][0], r_header.size[i])) {
+			return -1;
+		}
+	}
+	return 1;
+}
@@ -0,0 +1,242 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_network_spectator.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_NETWORK_SPECTATOR_H__
+#define __VR_NETWORK_SPECTATOR_H__
+
+#include "vr_types.h"
+#include "vr_main.h"
+
+#include "vr_network_codec.h"
+#include "vr_network_ring.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Port number used for the spectator streams. */
+#define VR_NETWORK_SPECTATOR_PORT_NUM	27012
+
+/* Maximum number of spectators connected at the same time. */
+#define VR_NETWORK_SPECTATOR_MAX	32
+
+/* Spectator stream variants, all derived from the frame captured for the headset stream. */
+typedef enum VR_Network_SpectatorVariant {
+	VR_NETWORK_SPECTATOR_STEREO = 0	/* Both eyes at the stream resolution. */
+	,
+	VR_NETWORK_SPECTATOR_MONO = 1	/* Left eye at the stream resolution. */
+	,
+	VR_NETWORK_SPECTATOR_MONO_HALF = 2	/* Left eye at half the stream resolution. */
+	,
+	VR_NETWORK_SPECTATOR_VARIANTS = 3	/* Number of variants. */
+} VR_Network_SpectatorVariant;
+
+/* Request sent by a spectator after connecting. */
+typedef struct VR_Network_SpectatorHello {
+	char magic[4];	/* VR_Network_SpectatorServer::magic_sequence. */
+	uint variant;	/* Requested stream variant (VR_Network_SpectatorVariant). */
+} VR_Network_SpectatorHello;
+
+/* Header preceding every frame sent to a spectator, followed by the encoded images. */
+typedef struct VR_Network_SpectatorFrameHeader {
+	char magic[4];	/* VR_Network_SpectatorServer::magic_sequence. */
+	uint variant;	/* Stream variant (VR_Network_SpectatorVariant). */
+	ui64 seq;	/* Sequence number of the captured frame (frames may be skipped). */
+	uint codec;	/* Codec of the images (VR_Network_Encoder::Type, every frame is a keyframe). */
+	uint w;	/* Image width in pixels. */
+	uint h;	/* Image height in pixels. */
+	uint num_images;	/* Number of images (1: mono, 2: left and right eye). */
+	uint size[VR_SIDES];	/* Size of the encoded images in bytes. */
+} VR_Network_SpectatorFrameHeader;
+
+/* Encoded frame of one variant. Frames are immutable once queued and shared by the send queues
+ * of all spectators of the variant; the images are shared between variants (the left eye of the
+ * stereo and the mono stream are the same bytes). */
+typedef struct VR_Network_SpectatorFrame {
+	VR_Network_SpectatorFrameHeader header;	/* Header, as sent. */
+	std::shared_ptr<const std::vector<uchar> > images[VR_SIDES];	/* Encoded images. */
+} VR_Network_SpectatorFrame;
+
+typedef std::shared_ptr<const VR_Network_SpectatorFrame> VR_Network_SpectatorFramePtr;
+
+/* Send queue of one spectator.
+ * The queue is bounded: when a spectator doesn't keep up, the oldest queued frame is dropped,
+ * so a slow laptop only lowers its own frame rate and never holds back the encoder,
+ * the other spectators or the headset stream. */
+class VR_Network_SpectatorQueue
+{
+public:
+	static const uint default_capacity = 2;	/* Default number of queued frames (one being sent, one waiting). */
+
+	VR_Network_SpectatorQueue(uint capacity = default_capacity);	/* Constructor. */
+
+	bool push(const VR_Network_SpectatorFramePtr& frame);	/* Add a frame, dropping the oldest one if the queue is full. Returns false if a frame was dropped (or the queue is closed). */
+	VR_Network_SpectatorFramePtr pop(uint timeout_ms);	/* Wait for the oldest frame (NULL on timeout or when the queue was closed). */
+	void close();	/* Discard all frames and wake the consumer (further frames are rejected). */
+
+	uint size() const;	/* Number of queued frames. */
+	uint dropped() const;	/* Number of frames dropped so far. */
+protected:
+	std::deque<VR_Network_SpectatorFramePtr> frames;	/* Queued frames (oldest first). */
+	uint capacity;	/* Maximum number of queued frames. */
+	uint num_dropped;	/* Number of frames dropped so far. */
+	bool closed;	/* Whether the queue was closed. */
+	mutable std::mutex mutex;	/* Protects everything. */
+	std::condition_variable condition;	/* Signaled when a frame was pushed or the queue was closed. */
+};
+
+/* Fan-out server of the spectator streams.
+ * The image thread submits every frame captured for the headset stream; the server's encoder
+ * thread derives the variants the connected spectators asked for, encodes every image once
+ * (independently of the number of spectators) and pushes the shared frames into the send queue
+ * of each spectator, which is drained by a sender thread per spectator. */
+class VR_Network_SpectatorServer
+{
+public:
+	/* Server statistics. */
+	typedef struct Stats {
+		uint spectators;	/* Connected spectators. */
+		uint frames_submitted;	/* Frames handed to the encoder thread. */
+		uint frames_skipped;	/* Submitted frames replaced by a newer one before they were encoded. */
+		uint frames_encoded;	/* Frames encoded (once for all spectators). */
+		uint images_encoded;	/* Images encoded (at most one per eye and resolution per frame). */
+		uint images_reused;	/* Images re-used from the headset stream instead of being encoded. */
+		uint frames_sent;	/* Frames sent (sum over all spectators). */
+		uint frames_dropped;	/* Frames dropped from full send queues (sum over all spectators). */
+		ui64 bytes_sent;	/* Bytes sent (sum over all spectators). */
+		double cpu_encode;	/* CPU time of the encoder thread (seconds). */
+		double cpu_send;	/* CPU time of the listener and sender threads (seconds, including disconnected spectators). */
+	} Stats;
+
+	/* Statistics of one connected spectator. */
+	typedef struct SpectatorStats {
+		VR_Network_SpectatorVariant variant;	/* Stream variant. */
+		uint frames_sent;	/* Frames sent. */
+		uint frames_dropped;	/* Frames dropped from the send queue. */
+		ui64 bytes_sent;	/* Bytes sent. */
+		double time_connected;	/* Time of the connection (seconds). */
+	} SpectatorStats;
+
+	static const char magic_sequence[4];	/* Magic of the hello and frame headers. */
+
+	VR_Network_SpectatorServer();	/* Constructor. */
+	~VR_Network_SpectatorServer();	/* Destructor (stops the server). */
+
+	bool start(const char *ip_address, ushort port);	/* Listen for spectators on the interface of the (IPv4) address and start the encoder thread. Fails for wildcard addresses. */
+	void stop();	/* Disconnect all spectators and stop the threads. */
+	bool is_running() const;	/* Whether the server is listening. */
+
+	bool wants_frame(double time) const;	/* Whether a frame submitted at this time would be used (spectators are connected and the frame rate allows it). */
+	bool submit(const VR_Network_FrameRing::Slot& slot, bool reuse_encoded);	/* Hand a captured frame to the encoder thread (the newest frame wins). If reuse_encoded, the slot's encoded images (zlib, so independently decodable) are sent for the full resolution variants. Returns false if the frame is not needed. */
+	Stats get_stats() const;	/* Get the server statistics. */
+	void get_spectator_stats(std::vector<SpectatorStats>& r_stats) const;	/* Get the statistics of the connected spectators. */
+
+	uint max_fps;	/* Maximum frame rate of the spectator streams (0: every submitted frame). */
+	uint queue_capacity;	/* Send queue capacity of newly connected spectators. */
+	VR_Network_Encoder::Type codec;	/* Codec of the encoded spectator images (TYPE_DELTA_RLE or TYPE_ZLIB, keyframes only). */
+protected:
+	/* Connected spectator. */
+	typedef struct Spectator {
+		long long sock;	/* Socket handle. */
+		VR_Network_SpectatorVariant variant;	/* Stream variant. */
+		VR_Network_SpectatorQueue queue;	/* Send queue. */
+		std::thread thread;	/* Sender thread. */
+		std::atomic<bool> alive;	/* Cleared by the sender thread when the connection is lost. */
+		std::atomic<uint> frames_sent;	/* Frames sent. */
+		std::atomic<ui64> bytes_sent;	/* Bytes sent. */
+		double time_connected;	/* Time of the connection (seconds). */
+
+		Spectator(long long sock, VR_Network_SpectatorVariant variant, uint capacity, double time);	/* Constructor. */
+	} Spectator;
+
+	/* Frame waiting for the encoder thread. */
+	typedef struct Pending {
+		ui64 seq;	/* Sequence number of the captured frame. */
+		uint w;	/* Image width in pixels. */
+		uint h;	/* Image height in pixels. */
+		uint d;	/* Image depth (bytes per pixel). */
+		uint variants;	/* Variants to derive (bit mask of 1 << VR_Network_SpectatorVariant). */
+		bool reused;	/* Whether the full resolution images are the zlib images of the headset stream. */
+		std::vector<uchar> pixels[VR_SIDES];	/* Copied eye images (empty if not needed). */
+		std::vector<uchar> encoded[VR_SIDES];	/* Copied encoded eye images of the headset stream (empty if not re-used). */
+	} Pending;
+
+	void listen_thread_func();	/* Accept spectators and remove disconnected ones. */
+	void encode_thread_func();	/* Encode the submitted frames and queue them for the spectators. */
+	void send_thread_func(Spectator *spectator);	/* Send the queued frames to a spectator. */
+	void encode(Pending& frame);	/* Derive, encode and queue the variants of a frame. */
+	void remove_spectators(bool all);	/* Join and delete disconnected (or all) spectators. */
+	VR_Network_Encoder *get_encoder(int i, uint w, uint h, uint d);	/* Get the encoder for full (0) or half (1) resolution images. */
+
+	long long listen_sock;	/* Listening socket (-1 if not running). */
+	std::thread listen_thread;	/* Listener thread. */
+	std::thread encode_thread;	/* Encoder thread. */
+	std::atomic<bool> running;	/* Cleared to stop the threads. */
+
+	std::vector<Spectator *> spectators;	/* Connected spectators. */
+	std::atomic<uint> variants;	/* Variants requested by the connected spectators (bit mask). */
+	mutable std::mutex spectators_mutex;	/* Protects spectators. */
+
+	Pending pending;	/* Newest submitted frame (protected by pending_mutex). */
+	bool have_pending;	/* Whether pending holds a frame that wasn't encoded yet. */
+	Pending work;	/* Frame being encoded (swapped with pending, owned by the encoder thread). */
+	std::mutex pending_mutex;	/* Protects pending. */
+	std::condition_variable pending_condition;	/* Signaled when a frame was submitted. */
+	std::atomic<double> time_next_submit;	/* Earliest time of the next submitted frame (for the frame rate limit). */
+
+	VR_Network_Encoder *encoder[2];	/* Encoders of the full and half resolution images (owned by the encoder thread). */
+	std::vector<uchar> pixels_half;	/* Downsampled image (owned by the encoder thread). */
+
+	Stats stats;	/* Server statistics (protected by stats_mutex). */
+	mutable std::mutex stats_mutex;	/* Protects stats. */
+};
+
+/* Spectator side of the stream. This is what a spectator's viewer does, used as a loopback
+ * stand-in for tests and benchmarks. */
+class VR_Network_SpectatorClient
+{
+public:
+	VR_Network_SpectatorClient();	/* Constructor. */
+	~VR_Network_SpectatorClient();	/* Destructor (closes the connection). */
+
+	bool open(const char *ip_address, ushort port, VR_Network_SpectatorVariant variant);	/* Connect to the server and request a stream variant. */
+	void close();	/* Close the connection. */
+	bool is_open() const;	/* Whether the connection is open. */
+	int receive(VR_Network_SpectatorFrameHeader& r_header, std::vector<uchar> r_images[VR_SIDES], uint timeout_ms);	/* Receive the next frame. Returns 1 if a frame was received, 0 on timeout, -1 if the connection was lost. */
+protected:
+	bool receive_bytes(void *data, uint size);	/* Receive exactly size bytes (blocking). */
+
+	long long sock;	/* Socket handle (-1 if closed). */
+};
+
+#endif /* __VR_NETWORK_SPECTATOR_H__ */
@@ -0,0 +1,293 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_pose_predict.cpp
+*   \ingroup vr
+*
+* Prediction of tracked poses to the display time of a frame.
+*/
+
+#include "vr_types.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "vr_pose_predict.h"
+
+/***********************************************************************************************//**
+ * \class                               VR_Pose_Predictor
+ ***************************************************************************************************
+ * Extrapolation of a tracked pose.
+ **************************************************************************************************/
+const double VR_Pose_Predictor::default_smoothing = 0.5;
+const double VR_Pose_Predictor::default_max_horizon = 0.05;
+const double VR_Pose_Predictor::max_gap = 0.25;
+
+/* Rotation (row convention: x' = x * r) for a rotation vector w (axis * angle). */
+static void rotation_exp(const double w[3], double r[3][3])
+{
+	const double angle = sqrt(w[0] * w[0] + w[1] * w[1] + w[2] * w[2]);
+	if (angle < 1e-12) {
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				r[i][j] = (i == j) ? 1.0 : 0.0;
+			}
+		}
+		return;
+	}
+	const double k[3] = { w[0] / angle, w[1] / angle, w[2] / angle };
+	const double c = cos(angle), s = sin(angle), t = 1.0 - c;
+	r[0][0] = c + t * k[0] * k[0];
+	r[0][1] = t * k[0] * k[1] + s * k[2];
+	r[0][2] = t * k[0] * k[2] - s * k[1];
+	r[1][0] = t * k[1] * k[0] - s * k[2];
+	r[1][1] = c + t * k[1] * k[1];
+	r[1][2] = t * k[1] * k[2] + s * k[0];
+	r[2][0] = t * k[2] * k[0] + s * k[1];
+	r[2][1] = t * k[2] * k[1] - s * k[0];
+	r[2][2] = c + t * k[2] * k[2];
+}
+
+/* Rotation vector of a rotation (inverse of rotation_exp()).
+ * Returns false for (nearly) half turns, where the axis is unstable. */
+static bool rotation_log(const double r[3][3], double w[3])
+{
+	const double v[3] = { r[1][2] - r[2][1], r[2][0] - r[0][2], r[0][1] - r[1][0] };
+	const double sin2 = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+	const double cos2 = r[0][0] + r[1][1] + r[2][2] - 1.0;
+	if (cos2 < -1.99) {
+		return false;
+	}
+	const double angle = atan2(sin2, cos2);
+	/* angle / sin(angle), which tends to 1 for small angles. */
+	const double f = (sin2 > 1e-12) ? angle / sin2 : 0.5;
+	w[0] = v[0] * f;
+	w[1] = v[1] * f;
+	w[2] = v[2] * f;
+	return true;
+}
+
+static void rotation_multiply(const double a[3][3], const double b[3][3], double r[3][3])
+{
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			r[i][j] = a[i][0] * b[0][j] + a[i][1] * b[1][j] + a[i][2] * b[2][j];
+		}
+	}
+}
+
+/* Gram-Schmidt orthonormalization, so that tracking noise in the matrices does not accumulate. */
+static void rotation_orthonormalize(double r[3][3])
+{
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < i; ++j) {
+			const double d = r[i][0] * r[j][0] + r[i][1] * r[j][1] + r[i][2] * r[j][2];
+			r[i][0] -= d * r[j][0];
+			r[i][1] -= d * r[j][1];
+			r[i][2] -= d * r[j][2];
+		}
+		const double len = sqrt(r[i][0] * r[i][0] + r[i][1] * r[i][1] + r[i][2] * r[i][2]);
+		if (len > 1e-12) {
+			r[i][0] /= len;
+			r[i][1] /= len;
+			r[i][2] /= len;
+		}
+	}
+}
+
+VR_Pose_Predictor::VR_Pose_Predictor()
+	: smoothing(default_smoothing)
+	, max_horizon(default_max_horizon)
+{
+	reset();
+}
+
+void VR_Pose_Predictor::reset()
+{
+	time = 0.0;
+	num_samples = 0;
+	memset(rot, 0, sizeof(rot));
+	rot[0][0] = rot[1][1] = rot[2][2] = 1.0;
+	scale[0] = scale[1] = scale[2] = 1.0;
+	memset(pos, 0, sizeof(pos));
+	memset(vel, 0, sizeof(vel));
+	memset(ang_vel, 0, sizeof(ang_vel));
+}
+
+void VR_Pose_Predictor::push(double t, const float m[4][4])
+{
+	double r[3][3];
+	double s[3];
+	for (int i = 0; i < 3; ++i) {
+		s[i] = sqrt((double)m[i][0] * m[i][0] + (double)m[i][1] * m[i][1] + (double)m[i][2] * m[i][2]);
+		for (int j = 0; j < 3; ++j) {
+			r[i][j] = m[i][j];
+		}
+	}
+	rotation_orthonormalize(r);
+	const double p[3] = { m[3][0], m[3][1], m[3][2] };
+
+	const double dt = t - time;
+	if (num_samples > 0 && dt > max_gap) {
+		/* Tracking was interrupted, the motion before does not tell anything. */
+		num_samples = 0;
+	}
+	if (num_samples > 0 && dt > 1e-4) {
+		/* Rotation from the last sample to this one: rot * d = r. */
+		double rot_t[3][3], d[3][3], w[3];
+		for (int i = 0; i < 3; ++i) {
+			for (int j = 0; j < 3; ++j) {
+				rot_t[i][j] = rot[j][i];
+			}
+		}
+		rotation_multiply(rot_t, r, d);
+		if (!rotation_log(d, w)) {
+			w[0] = w[1] = w[2] = 0.0;
+		}
+
+		/* The first velocity is taken as-is, later ones are smoothed. */
+		const double a = (num_samples == 1) ? 1.0 : smoothing;
+		for (int i = 0; i < 3; ++i) {
+			vel[i] += a * ((p[i] - pos[i]) / dt - vel[i]);
+			ang_vel[i] += a * (w[i] / dt - ang_vel[i]);
+		}
+		num_samples = 2;
+	}
+	else if (num_samples == 0) {
+		memset(vel, 0, sizeof(vel));
+		memset(ang_vel, 0, sizeof(ang_vel));
+		num_samples = 1;
+	}
+
+	time = t;
+	memcpy(rot, r, sizeof(rot));
+	memcpy(scale, s, sizeof(scale));
+	memcpy(pos, p, sizeof(pos));
+}
+
+bool VR_Pose_Predictor::predict(double t, float r_m[4][4]) const
+{
+	if (num_samples == 0) {
+		return false;
+	}
+
+	double h = t - time;
+	if (h < 0.0) {
+		h = 0.0;
+	}
+	else if (h > max_horizon) {
+		h = max_horizon;
+	}
+
+	const double w[3] = { ang_vel[0] * h, ang_vel[1] * h, ang_vel[2] * h };
+	double d[3][3], r[3][3];
+	rotation_exp(w, d);
+	rotation_multiply(rot, d, r);
+
+	for (int i = 0; i < 3; ++i) {
+		for (int j = 0; j < 3; ++j) {
+			r_m[i][j] = (float)(r[i][j] * scale[i]);
+		}
+		r_m[i][3] = 0.0f;
+		r_m[3][i] = (float)(pos[i] + vel[i] * h);
+	}
+	r_m[3][3] = 1.0f;
+
+	return true;
+}
+
+bool VR_Pose_Predictor::is_valid() const
+{
+	return num_samples > 0;
+}
+
+double VR_Pose_Predictor::get_time() const
+{
+	return time;
+}
+
+const double *VR_Pose_Predictor::get_velocity() const
+{
+	return vel;
+}
+
+const double *VR_Pose_Predictor::get_angular_velocity() const
+{
+	return ang_vel;
+}
+
+/***********************************************************************************************//**
+ * \class                               VR_Latency_Estimator
+ ***************************************************************************************************
+ * Estimate of the submit time of a frame.
+ **************************************************************************************************/
+const double VR_Latency_Estimator::default_smoothing = 0.1;
+
+VR_Latency_Estimator::VR_Latency_Estimator()
+	: smoothing(default_smoothing)
+{
+	reset();
+}
+
+void VR_Latency_Estimator::reset()
+{
+	for (int i = 0; i < STAGES; ++i) {
+		latency[i] = 0.0;
+		latency_valid[i] = false;
+		marked[i] = 0.0;
+		marked_valid[i] = false;
+	}
+}
+
+void VR_Latency_Estimator::mark(Stage stage, double time)
+{
+	marked[stage] = time;
+	marked_valid[stage] = true;
+}
+
+void VR_Latency_Estimator::submit(double time)
+{
+	for (int i = 0; i < STAGES; ++i) {
+		if (!marked_valid[i]) {
+			continue;
+		}
+		const double l = time - marked[i];
+		if (l >= 0.0) {
+			latency[i] = latency_valid[i] ? latency[i] + smoothing * (l - latency[i]) : l;
+			latency_valid[i] = true;
+		}
+		marked_valid[i] = false;
+	}
+}
+
+double VR_Latency_Estimator::predict_submit(Stage stage, double time) const
+{
+	return time + latency[stage];
+}
+
+double VR_Latency_Estimator::get_latency(Stage stage) const
+{
+	return latency[stage];
+}
@@ -0,0 +1,105 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_pose_predict.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_POSE_PREDICT_H__
+#define __VR_POSE_PREDICT_H__
+
+#include "vr_types.h"
+
+/* Extrapolation of a tracked pose (HMD, eye or controller) to the time its frame is displayed.
+ * Linear and angular velocity are estimated from consecutive samples (smoothed, to suppress
+ * tracking noise), the pose is then advanced along them. Matrices are in the Blender convention
+ * (rows are the axes, the last row is the translation). */
+class VR_Pose_Predictor
+{
+public:
+	static const double default_smoothing;	/* Default weight of a new velocity estimate (1: no smoothing). */
+	static const double default_max_horizon;	/* Default maximum prediction time (seconds). */
+	static const double max_gap;	/* Time without samples (seconds) after which the velocity is discarded. */
+
+	VR_Pose_Predictor();	/* Constructor. */
+
+	void reset();	/* Discard all samples. */
+	void push(double time, const float m[4][4]);	/* Add a sample (time in seconds, see PIL_check_seconds_timer()). */
+	bool predict(double time, float r_m[4][4]) const;	/* Get the pose at a (later) time. Returns false if there are no samples. */
+
+	bool is_valid() const;	/* Whether there is at least one sample. */
+	double get_time() const;	/* Time of the last sample. */
+	const double *get_velocity() const;	/* Estimated linear velocity (units per second). */
+	const double *get_angular_velocity() const;	/* Estimated angular velocity (rotation axis * radians per second). */
+
+	double smoothing;	/* Weight of a new velocity estimate. */
+	double max_horizon;	/* Maximum prediction time (seconds). Limits the error when the velocity estimate is off. */
+protected:
+	double	time;	/* Time of the last sample. */
+	uint	num_samples;	/* Number of samples since the last reset (saturates at 2). */
+	double	rot[3][3];	/* Rotation of the last sample (orthonormal). */
+	double	scale[3];	/* Scale of the last sample. */
+	double	pos[3];	/* Translation of the last sample. */
+	double	vel[3];	/* Linear velocity. */
+	double	ang_vel[3];	/* Angular velocity. */
+};
+
+/* Estimate of when a frame is submitted to the VR device, as seen from the stages of drawing it.
+ * Each stage (tracking, drawing of each eye) measures the time until the submit, averaged over the
+ * previous frames. Estimates from later stages absorb the variable time spent before them
+ * (i.e. interaction or operators), so matrices refreshed right before drawing are more accurate. */
+class VR_Latency_Estimator
+{
+public:
+	/* Stages of a frame. */
+	typedef enum Stage {
+		STAGE_TRACKING = 0	/* vr_update_tracking(). */
+		,
+		STAGE_EYE_LEFT = 1	/* Drawing the left eye. */
+		,
+		STAGE_EYE_RIGHT = 2	/* Drawing the right eye. */
+		,
+		STAGES = 3	/* Number of stages. */
+	} Stage;
+
+	static const double default_smoothing;	/* Default weight of the latest frame. */
+
+	VR_Latency_Estimator();	/* Constructor. */
+
+	void reset();	/* Discard all measurements. */
+	void mark(Stage stage, double time);	/* A stage of the current frame was reached. */
+	void submit(double time);	/* The current frame was submitted. Updates the estimates of all stages reached. */
+	double predict_submit(Stage stage, double time) const;	/* Estimated submit time of the current frame, at a stage reached at time. */
+	double get_latency(Stage stage) const;	/* Estimated time from a stage to the submit (seconds, 0 if unknown). */
+
+	double smoothing;	/* Weight of the latest frame. */
+protected:
+	double	latency[STAGES];	/* Estimated time from each stage to the submit. */
+	bool	latency_valid[STAGES];	/* Whether the stage was measured at least once. */
+	double	marked[STAGES];	/* Time each stage was reached in the current frame. */
+	bool	marked_valid[STAGES];	/* Whether each stage was reached in the current frame. */
+};
+
+#endif /* __VR_POSE_PREDICT_H__ */
@@ -0,0 +1,461 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_select_index.cpp
+*   \ingroup vr
+*
+* Spatial index for box / frustum selection of edit-mesh elements.
+*/
+
+#include "vr_types.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "vr_select_index.h"
+
+#define VR_SELECT_INDEX_NONE	0xFFFFFFFF
+/* Maximum number of planes of a query. */
+#define VR_SELECT_INDEX_MAX_PLANES	16
+/* Number of points tested per batch. */
+#define VR_SELECT_INDEX_CHUNK	64
+/* Relative distance to a plane below which a point is reported as RESULT_BORDER.
+ * This is well above the rounding error of transforming / projecting the point in single precision,
+ * so RESULT_INSIDE / RESULT_OUTSIDE always agree with the exact tests of the caller. */
+#define VR_SELECT_INDEX_TOLERANCE	3e-5f
+
+/* Selection plane in object space. */
+typedef struct LocalPlane {
+	float	n[3];	/* Plane normal. */
+	float	d;	/* Plane offset. */
+	float	abs_n[3];	/* Magnitude of the terms contributing to n (for the rounding tolerance). */
+	float	abs_d;	/* Magnitude of the terms contributing to d (for the rounding tolerance). */
+} LocalPlane;
+
+/* Classify a batch of points (state: Result) against a set of planes. */
+static inline void classify_points(
+	const float *x, const float *y, const float *z, uint num_points,
+	const LocalPlane *planes, const uint *active, uint num_active, uchar *state)
+{
+	uchar inside[VR_SELECT_INDEX_CHUNK];
+	uchar outside[VR_SELECT_INDEX_CHUNK];
+	for (uint j = 0; j < num_points; ++j) {
+		inside[j] = 1;
+		outside[j] = 0;
+	}
+
+	for (uint k = 0; k < num_active; ++k) {
+		const LocalPlane& p = planes[active[k]];
+		/* Separate arrays and no branches: vectorized by the compiler. */
+		for (uint j = 0; j < num_points; ++j) {
+			const float d = p.n[0] * x[j] + p.n[1] * y[j] + p.n[2] * z[j] + p.d;
+			const float m = VR_SELECT_INDEX_TOLERANCE *
+				(p.abs_n[0] * fabsf(x[j]) + p.abs_n[1] * fabsf(y[j]) + p.abs_n[2] * fabsf(z[j]) + p.abs_d);
+			inside[j] &= (uchar)(d > m);
+			outside[j] |= (uchar)(d < -m);
+		}
+	}
+
+	for (uint j = 0; j < num_points; ++j) {
+		state[j] = outside[j] ? VR_Select_Index::RESULT_OUTSIDE :
+			(inside[j] ? VR_Select_Index::RESULT_INSIDE : VR_Select_Index::RESULT_BORDER);
+	}
+}
+
+/***************************************************************************************************
+ * \class                                  VR_Select_Index
+ ***************************************************************************************************
+ * Spatial index for box / frustum selection of edit-mesh elements.
+ **************************************************************************************************/
+VR_Select_Index::VR_Select_Index()
+{
+	clear();
+}
+
+void VR_Select_Index::clear()
+{
+	for (int i = 0; i < 3; ++i) {
+		bmin[i] = bmax[i] = 0.0f;
+		inv_cell_size[i] = 0.0f;
+		dims[i] = 0;
+	}
+	/* Swap with empty vectors so the memory is returned, not just the size reset. */
+	std::vector<Cell>().swap(cells);
+	std::vector<float>().swap(slot_x);
+	std::vector<float>().swap(slot_y);
+	std::vector<float>().swap(slot_z);
+	std::vector<uint>().swap(slot_point);
+	std::vector<uint>().swap(point_slot);
+	std::vector<float>().swap(points);
+	std::vector<uint>().swap(overflow);
+	memset(&stats, 0, sizeof(stats));
+}
+
+uint VR_Select_Index::size() const
+{
+	return (uint)point_slot.size();
+}
+
+uint VR_Select_Index::cell_of(const float co[3]) const
+{
+	uint c[3];
+	for (int i = 0; i < 3; ++i) {
+		/* (Also rejects NaN.) */
+		if (!(co[i] >= bmin[i] && co[i] <= bmax[i])) {
+			return VR_SELECT_INDEX_NONE;
+		}
+		c[i] = (uint)((co[i] - bmin[i]) * inv_cell_size[i]);
+		if (c[i] >= dims[i]) {
+			c[i] = dims[i] - 1;
+		}
+	}
+	return (c[2] * dims[1] + c[1]) * dims[0] + c[0];
+}
+
+void VR_Select_Index::build(const float (*co)[3], uint num_points)
+{
+	clear();
+	if (num_points == 0) {
+		return;
+	}
+
+	points.assign(&co[0][0], &co[0][0] + num_points * 3);
+
+	/* Bounds (ignoring NaN, those points go to the overflow list). */
+	for (int i = 0; i < 3; ++i) {
+		bmin[i] = FLT_MAX;
+		bmax[i] = -FLT_MAX;
+	}
+	for (uint p = 0; p < num_points; ++p) {
+		for (int i = 0; i < 3; ++i) {
+			bmin[i] = std::min(bmin[i], co[p][i]);
+			bmax[i] = std::max(bmax[i], co[p][i]);
+		}
+	}
+	if (bmin[0] > bmax[0]) {
+		bmin[0] = bmin[1] = bmin[2] = bmax[0] = bmax[1] = bmax[2] = 0.0f;
+	}
+
+	/* Roughly cubic cells, cell_points per cell on average.
+	 * Flat axes (planar meshes) get a single layer of cells. */
+	float extent[3];
+	float extent_max = 0.0f;
+	for (int i = 0; i < 3; ++i) {
+		extent[i] = bmax[i] - bmin[i];
+		extent_max = std::max(extent_max, extent[i]);
+	}
+	const float num_cells = (float)std::max(num_points / cell_points, 1u);
+	float volume = 1.0f;
+	int num_axes = 0;
+	for (int i = 0; i < 3; ++i) {
+		if (extent[i] > extent_max * 1e-4f) {
+			volume *= extent[i];
+			++num_axes;
+		}
+	}
+	const float cell_size = num_axes ? powf(volume / num_cells, 1.0f / (float)num_axes) : 1.0f;
+	for (int i = 0; i < 3; ++i) {
+		if (num_axes && extent[i] > extent_max * 1e-4f) {
+			dims[i] = (uint)std::min(std::max(ceilf(extent[i] / cell_size), 1.0f), 1024.0f);
+			inv_cell_size[i] = (float)dims[i] / extent[i];
+		}
+		else {
+			dims[i] = 1;
+			inv_cell_size[i] = 0.0f;
+		}
+	}
+
+	/* Counting sort of the points into the cells. */
+	cells.resize(dims[0] * dims[1] * dims[2]);
+	for (size_t c = 0; c < cells.size(); ++c) {
+		Cell& cell = cells[c];
+		cell.first = cell.count = 0;
+		for (int i = 0; i < 3; ++i) {
+			cell.bounds[0][i] = FLT_MAX;
+			cell.bounds[1][i] = -FLT_MAX;
+		}
+	}
+	std::vector<uint> point_cell(num_points);
+	uint num_binned = 0;
+	for (uint p = 0; p < num_points; ++p) {
+		point_cell[p] = cell_of(co[p]);
+		if (point_cell[p] != VR_SELECT_INDEX_NONE) {
+			++cells[point_cell[p]].count;
+			++num_binned;
+		}
+	}
+	uint first = 0;
+	for (size_t c = 0; c < cells.size(); ++c) {
+		cells[c].first = first;
+		first += cells[c].count;
+		cells[c].count = 0;
+	}
+
+	slot_x.resize(num_binned);
+	slot_y.resize(num_binned);
+	slot_z.resize(num_binned);
+	slot_point.resize(num_binned);
+	point_slot.resize(num_points);
+	for (uint p = 0; p < num_points; ++p) {
+		if (point_cell[p] == VR_SELECT_INDEX_NONE) {
+			point_slot[p] = VR_SELECT_INDEX_NONE;
+			overflow.push_back(p);
+			continue;
+		}
+		Cell& cell = cells[point_cell[p]];
+		const uint slot = cell.first + cell.count++;
+		slot_x[slot] = co[p][0];
+		slot_y[slot] = co[p][1];
+		slot_z[slot] = co[p][2];
+		slot_point[slot] = p;
+		point_slot[p] = slot;
+		for (int i = 0; i < 3; ++i) {
+			cell.bounds[0][i] = std::min(cell.bounds[0][i], co[p][i]);
+			cell.bounds[1][i] = std::max(cell.bounds[1][i], co[p][i]);
+		}
+	}
+}
+
+void VR_Select_Index::update(uint index, const float co[3])
+{
+	float *p = &points[index * 3];
+	const uint slot = point_slot[index];
+	if (slot != VR_SELECT_INDEX_NONE) {
+		const uint cell_old = cell_of(p);
+		const uint cell_new = cell_of(co);
+		if (cell_new == cell_old) {
+			/* Same cell: just extend its bounds. */
+			Cell& cell = cells[cell_new];
+			slot_x[slot] = co[0];
+			slot_y[slot] = co[1];
+			slot_z[slot] = co[2];
+			for (int i = 0; i < 3; ++i) {
+				cell.bounds[0][i] = std::min(cell.bounds[0][i], co[i]);
+				cell.bounds[1][i] = std::max(cell.bounds[1][i], co[i]);
+			}
+		}
+		else {
+			/* Vacate the slot, the point is tested individually until the next build. */
+			slot_point[slot] = VR_SELECT_INDEX_NONE;
+			point_slot[index] = VR_SELECT_INDEX_NONE;
+			overflow.push_back(index);
+		}
+	}
+	p[0] = co[0];
+	p[1] = co[1];
+	p[2] = co[2];
+}
+
+uint VR_Select_Index::refit(const float (*co)[3], uint num_points)
+{
+	if (num_points != size() || (num_points && cells.empty())) {
+		build(co, num_points);
+		return num_points;
+	}
+
+	uint moved = 0;
+	for (uint p = 0; p < num_points; ++p) {
+		if (memcmp(&points[p * 3], co[p], sizeof(float) * 3) != 0) {
+			update(p, co[p]);
+			++moved;
+		}
+	}
+
+	/* Too many points out of their cells: start over. */
+	if (overflow.size() > num_points / 8 + cell_points) {
+		build(co, num_points);
+	}
+	return moved;
+}
+
+uint VR_Select_Index::query(const Mat44f& obmat, const float (*planes)[4], uint num_planes, uchar *result)
+{
+	memset(&stats, 0, sizeof(stats));
+	const uint num_points = size();
+	if (num_points == 0) {
+		return 0;
+	}
+	memset(result, RESULT_OUTSIDE, num_points);
+	if (num_planes > VR_SELECT_INDEX_MAX_PLANES) {
+		/* Unsupported: leave everything to the exact test. */
+		memset(result, RESULT_BORDER, num_points);
+		stats.points_border = num_points;
+		return num_points;
+	}
+
+	/* Planes in object space (row-vector convention, as Mat44f). */
+	LocalPlane local[VR_SELECT_INDEX_MAX_PLANES];
+	uint all[VR_SELECT_INDEX_MAX_PLANES];
+	const float (*m)[4] = obmat.m;
+	for (uint k = 0; k < num_planes; ++k) {
+		const float *w = planes[k];
+		LocalPlane& p = local[k];
+		for (int i = 0; i < 3; ++i) {
+			p.n[i] = m[i][0] * w[0] + m[i][1] * w[1] + m[i][2] * w[2];
+			p.abs_n[i] = fabsf(m[i][0] * w[0]) + fabsf(m[i][1] * w[1]) + fabsf(m[i][2] * w[2]);
+		}
+		p.d = m[3][0] * w[0] + m[3][1] * w[1] + m[3][2] * w[2] + w[3];
+		p.abs_d = fabsf(m[3][0] * w[0]) + fabsf(m[3][1] * w[1]) + fabsf(m[3][2] * w[2]) + fabsf(w[3]);
+		all[k] = k;
+	}
+
+	int cells_outside = 0, cells_inside = 0, cells_border = 0, points_tested = 0, points_border = 0, hits = 0;
+	const int num_cells = (int)cells.size();
+
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:cells_outside, cells_inside, cells_border, points_tested, points_border, hits)
+	for (int c = 0; c < num_cells; ++c) {
+		const Cell& cell = cells[c];
+		if (cell.count == 0) {
+			continue;
+		}
+
+		/* Classify the cell bounds against each plane. */
+		uint active[VR_SELECT_INDEX_MAX_PLANES];
+		uint num_active = 0;
+		bool outside = false;
+		for (uint k = 0; k < num_planes && !outside; ++k) {
+			const LocalPlane& p = local[k];
+			float d_min = p.d, d_max = p.d, mag = p.abs_d;
+			for (int i = 0; i < 3; ++i) {
+				const float a = p.n[i] * cell.bounds[0][i];
+				const float b = p.n[i] * cell.bounds[1][i];
+				d_min += std::min(a, b);
+				d_max += std::max(a, b);
+				mag += p.abs_n[i] * std::max(fabsf(cell.bounds[0][i]), fabsf(cell.bounds[1][i]));
+			}
+			const float margin = VR_SELECT_INDEX_TOLERANCE * mag;
+			if (d_max < -margin) {
+				outside = true;
+			}
+			else if (!(d_min > margin)) {
+				active[num_active++] = k;
+			}
+		}
+		if (outside) {
+			++cells_outside;
+			continue;
+		}
+
+		const uint end = cell.first + cell.count;
+		if (num_active == 0) {
+			++cells_inside;
+			for (uint s = cell.first; s < end; ++s) {
+				const uint point = slot_point[s];
+				if (point != VR_SELECT_INDEX_NONE) {
+					result[point] = RESULT_INSIDE;
+					++hits;
+				}
+			}
+			continue;
+		}
+
+		/* Test the points of the cell against the planes it straddles. */
+		++cells_border;
+		uchar state[VR_SELECT_INDEX_CHUNK];
+		for (uint s = cell.first; s < end; s += VR_SELECT_INDEX_CHUNK) {
+			const uint n = std::min(end - s, (uint)VR_SELECT_INDEX_CHUNK);
+			classify_points(&slot_x[s], &slot_y[s], &slot_z[s], n, local, active, num_active, state);
+			points_tested += n;
+			for (uint j = 0; j < n; ++j) {
+				const uint point = slot_point[s + j];
+				if (point != VR_SELECT_INDEX_NONE && state[j] != RESULT_OUTSIDE) {
+					result[point] = state[j];
+					++hits;
+					points_border += (state[j] == RESULT_BORDER);
+				}
+			}
+		}
+	}
+
+	/* Points that left their cells. */
+	for (size_t o = 0; o < overflow.size(); o += VR_SELECT_INDEX_CHUNK) {
+		const uint n = (uint)std::min(overflow.size() - o, (size_t)VR_SELECT_INDEX_CHUNK);
+		float x[VR_SELECT_INDEX_CHUNK], y[VR_SELECT_INDEX_CHUNK], z[VR_SELECT_INDEX_CHUNK];
+		uchar state[VR_SELECT_INDEX_CHUNK];
+		for (uint j = 0; j < n; ++j) {
+			const float *p = &points[overflow[o + j] * 3];
+			x[j] = p[0];
+			y[j] = p[1];
+			z[j] = p[2];
+		}
+		classify_points(x, y, z, n, local, all, num_planes, state);
+		points_tested += n;
+		for (uint j = 0; j < n; ++j) {
+			/* NaN positions are neither inside nor outside: leave those to the exact test. */
+			result[overflow[o + j]] = state[j];
+			if (state[j] != RESULT_OUTSIDE) {
+				++hits;
+				points_border += (state[j] == RESULT_BORDER);
+			}
+		}
+	}
+
+	stats.cells_outside = cells_outside;
+	stats.cells_inside = cells_inside;
+	stats.cells_border = cells_border;
+	stats.points_tested = points_tested;
+	stats.points_border = points_border;
+	return (uint)hits;
+}
+
+const VR_Select_Index::Stats& VR_Select_Index::get_stats() const
+{
+	return stats;
+}
+
+uint VR_Select_Index::box_planes(const Coord3Df& p0, const Coord3Df& p1, float planes[6][4])
+{
+	const float lo[3] = { std::min(p0.x, p1.x), std::min(p0.y, p1.y), std::min(p0.z, p1.z) };
+	const float hi[3] = { std::max(p0.x, p1.x), std::max(p0.y, p1.y), std::max(p0.z, p1.z) };
+	memset(planes, 0, sizeof(float) * 6 * 4);
+	for (int i = 0; i < 3; ++i) {
+		/* x > lo, x < hi */
+		planes[i * 2][i] = 1.0f;
+		planes[i * 2][3] = -lo[i];
+		planes[i * 2 + 1][i] = -1.0f;
+		planes[i * 2 + 1][3] = hi[i];
+	}
+	return 6;
+}
+
+uint VR_Select_Index::rect_planes(const float persmat[4][4], float x0, float y0, float x1, float y1, float near_clip, float planes[5][4])
+{
+	/* Clip coordinates: clip[i] = sum_j co[j] * persmat[j][i] (co[3] = 1).
+	 * x / w > lo  <=>  x - lo * w > 0 (for w > 0, ensured by the near plane). */
+	const float lo[2] = { std::min(x0, x1), std::min(y0, y1) };
+	const float hi[2] = { std::max(x0, x1), std::max(y0, y1) };
+	for (int i = 0; i < 2; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			planes[i * 2][j] = persmat[j][i] - lo[i] * persmat[j][3];
+			planes[i * 2 + 1][j] = hi[i] * persmat[j][3] - persmat[j][i];
+		}
+	}
+	for (int j = 0; j < 4; ++j) {
+		planes[4][j] = persmat[j][3];
+	}
+	planes[4][3] -= near_clip;
+	return 5;
+}
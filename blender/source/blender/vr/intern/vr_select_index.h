@@ -0,0 +1,111 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_select_index.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_SELECT_INDEX_H__
+#define __VR_SELECT_INDEX_H__
+
+#include "vr_types.h"
+
+#include <vector>
+
+/* Spatial index for box / frustum selection of edit-mesh elements.
+ * The element positions (vertices, edge midpoints or face centers, in object space) are binned
+ * into a uniform grid, stored per cell as separate x / y / z arrays. A query classifies whole cells
+ * against the planes of the selection volume first, and only tests the points of the cells on its
+ * boundary, in batches. Points that are too close to a plane to be decided with the plane equations
+ * are reported as RESULT_BORDER, so the caller can run its exact test on them (see Widget_Select).
+ * Moved points are re-binned incrementally by refit() / update(). */
+class VR_Select_Index
+{
+public:
+	/* Classification of a point by query(). */
+	typedef enum Result {
+		RESULT_OUTSIDE = 0	/* Outside of the selection volume. */
+		,
+		RESULT_INSIDE = 1	/* Inside of the selection volume. */
+		,
+		RESULT_BORDER = 2	/* Within rounding distance of the boundary (needs an exact test). */
+	} Result;
+
+	/* Counters of the last query(). */
+	typedef struct Stats {
+		uint	cells_outside;	/* Number of cells rejected as a whole. */
+		uint	cells_inside;	/* Number of cells accepted as a whole. */
+		uint	cells_border;	/* Number of cells whose points were tested. */
+		uint	points_tested;	/* Number of points tested against the planes. */
+		uint	points_border;	/* Number of points reported as RESULT_BORDER. */
+	} Stats;
+
+	static const uint cell_points = 32;	/* Average number of points per grid cell. */
+
+	VR_Select_Index();	/* Constructor. */
+
+	void build(const float (*co)[3], uint num_points);	/* Index a set of points (object space). */
+	uint refit(const float (*co)[3], uint num_points);	/* Update the index to the given points (re-binning only those that moved). Returns the number of points that moved. */
+	void update(uint index, const float co[3]);	/* Move a single point. */
+	void clear();	/* Release the index. */
+	uint size() const;	/* Number of indexed points. */
+
+	/* Classify all points against a convex volume, given as planes (a, b, c, d) in world space
+	 * (inside: a*x + b*y + c*z + d > 0 for all planes). obmat is the object matrix (object to world).
+	 * result must hold size() entries. Returns the number of points that are not RESULT_OUTSIDE. */
+	uint query(const Mat44f& obmat, const float (*planes)[4], uint num_planes, uchar *result);
+	const Stats& get_stats() const;	/* Get the counters of the last query. */
+
+	/* Planes of a world-space box (strictly inside the box spanned by p0 and p1). */
+	static uint box_planes(const Coord3Df& p0, const Coord3Df& p1, float planes[6][4]);
+	/* Planes of a screen rectangle (normalized device coordinates), in front of near_clip.
+	 * persmat is a Blender (column-major) perspective matrix, as RegionView3D::persmat. */
+	static uint rect_planes(const float persmat[4][4], float x0, float y0, float x1, float y1, float near_clip, float planes[5][4]);
+protected:
+	/* Grid cell. */
+	typedef struct Cell {
+		uint	first;	/* First slot of the cell. */
+		uint	count;	/* Number of slots of the cell. */
+		float	bounds[2][3];	/* Bounds of the points of the cell (min, max). */
+	} Cell;
+
+	float	bmin[3];	/* Minimum corner of the grid. */
+	float	bmax[3];	/* Maximum corner of the grid. */
+	float	inv_cell_size[3];	/* Inverse cell size. */
+	uint	dims[3];	/* Number of cells along each axis. */
+	std::vector<Cell>	cells;	/* Grid cells. */
+	std::vector<float>	slot_x;	/* Point x coordinates (in cell order). */
+	std::vector<float>	slot_y;	/* Point y coordinates (in cell order). */
+	std::vector<float>	slot_z;	/* Point z coordinates (in cell order). */
+	std::vector<uint>	slot_point;	/* Point index of each slot (invalid for vacated slots). */
+	std::vector<uint>	point_slot;	/* Slot of each point (invalid for points in the overflow list). */
+	std::vector<float>	points;	/* Current point coordinates (x, y, z). */
+	std::vector<uint>	overflow;	/* Points that left their cell since the last build (tested individually). */
+	Stats	stats;	/* Counters of the last query. */
+
+	uint cell_of(const float co[3]) const;	/* Cell containing a position (or invalid if outside of the grid). */
+};
+
+#endif /* __VR_SELECT_INDEX_H__ */
@@ -0,0 +1,545 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_simulated.cpp
+*   \ingroup vr
+*
+* Built-in VR backend replaying recorded sessions, and recording of sessions from VR devices.
+*/
+
+#include "vr_types.h"
+#include "vr_main.h"
+
+#include <glew.h>
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <GL/glxew.h>
+#endif
+#include <GL/gl.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "vr_api.h"
+#include "vr_simulated.h"
+#include "vr_trace.h"
+
+#include "PIL_time.h"
+
+/* Eye texture size if the trace does not specify one (Vive / Rift). */
+#define VR_SIMULATED_DEFAULT_TEX_WIDTH 1080
+#define VR_SIMULATED_DEFAULT_TEX_HEIGHT 1200
+
+/* State of the simulated VR device. */
+typedef struct VR_Simulated {
+	VR_Trace_Map	trace;	/* The trace being replayed (memory-mapped). */
+	std::string	trace_path;	/* Path of the trace file. */
+	uint	frame;	/* Index of the next frame to replay. */
+
+	float	t_hmd[4][4];	/* Current HMD position. */
+	float	t_eye[VR_SIDES][4][4];	/* Current eye positions. */
+	float	t_controller[VR_MAX_CONTROLLERS][4][4];	/* Current controller positions. */
+	VR_Controller	controller[VR_MAX_CONTROLLERS];	/* Current controller states. */
+
+	float	eye_params[VR_SIDES][4];	/* Rendering parameters (fx, fy, cx, cy). */
+	int	tex_width;	/* Eye texture width. */
+	int	tex_height;	/* Eye texture height. */
+	GLuint	tex[VR_SIDES];	/* Eye textures (the "HMD display"). */
+	GLuint	fbo[VR_SIDES];	/* Framebuffers of the eye textures. */
+	GLuint	fbo_read;	/* Framebuffer to read the rendered images from. */
+
+	VR_Frame_Timings	timings;	/* Per-stage timings of the replayed frames. */
+	bool	timings_written;	/* Whether the timings were written to file. */
+
+	bool	replaying;	/* Whether the trace is replayed without drawing (see vr_replay()). */
+	bool	replayed;	/* Whether the trace was replayed without drawing. */
+	double	replay_pass_duration;	/* Duration of a pass over the trace, for the UI clock (seconds). */
+} VR_Simulated;
+
+static VR_Simulated *vr_simulated = 0;
+
+/* Write the frame timings to BLENDER_VR_SIMULATE_TIMINGS (or next to the trace). */
+static void vr_simulated_write_timings()
+{
+	if (vr_simulated->timings_written || vr_simulated->timings.num_frames() == 0) {
+		return;
+	}
+	vr_simulated->timings_written = true;
+
+	const char *path = getenv("BLENDER_VR_SIMULATE_TIMINGS");
+	const std::string json_path = (path && path[0]) ? std::string(path) : (vr_simulated->trace_path + ".json");
+	if (vr_simulated->timings.write_json(json_path.c_str(), vr_simulated->trace_path.c_str())) {
+		printf("VR simulation: wrote timings of %u frames to %s\n", vr_simulated->timings.num_frames(), json_path.c_str());
+	}
+	else {
+		printf("VR simulation: could not write timings to %s\n", json_path.c_str());
+	}
+}
+
+/* Set the tracking data to a frame of the trace. */
+static void vr_simulated_set_frame(const VR_Trace::Frame& frame)
+{
+	VR_Trace::pose_to_matrix(frame.hmd, vr_simulated->t_hmd);
+
+	/* The eyes have the orientation of the HMD and are offset along its axes. */
+	const VR_Trace::Header& header = vr_simulated->trace.header;
+	for (int side = 0; side < VR_SIDES; ++side) {
+		float (*t_eye)[4] = vr_simulated->t_eye[side];
+		memcpy(t_eye, vr_simulated->t_hmd, sizeof(float) * 16);
+		for (int i = 0; i < 3; ++i) {
+			t_eye[3][i] += header.eye_offset[side][0] * t_eye[0][i] +
+						   header.eye_offset[side][1] * t_eye[1][i] +
+						   header.eye_offset[side][2] * t_eye[2][i];
+		}
+	}
+
+	for (int i = 0; i < VR_MAX_CONTROLLERS; ++i) {
+		const VR_Trace::Controller& c = frame.controller[i];
+		VR_Trace::pose_to_matrix(c.pose, vr_simulated->t_controller[i]);
+		VR_Trace::controller_to_state(c, vr_simulated->controller[i]);
+		vr_simulated->controller[i].side = (i == VR_MAX_CONTROLLERS - 1) ? VR_SIDE_AUX : (VR_Side)i;
+	}
+}
+
+/* Free the eye textures and framebuffers. */
+static void vr_simulated_free_textures()
+{
+	if (vr_simulated->fbo_read) {
+		glDeleteFramebuffers(1, &vr_simulated->fbo_read);
+		vr_simulated->fbo_read = 0;
+	}
+	for (int side = 0; side < VR_SIDES; ++side) {
+		if (vr_simulated->fbo[side]) {
+			glDeleteFramebuffers(1, &vr_simulated->fbo[side]);
+			vr_simulated->fbo[side] = 0;
+		}
+		if (vr_simulated->tex[side]) {
+			glDeleteTextures(1, &vr_simulated->tex[side]);
+			vr_simulated->tex[side] = 0;
+		}
+	}
+}
+
+/***************************************************************************************************
+ *											 vr_api
+ ***************************************************************************************************/
+const char *vr_simulated_trace_path()
+{
+	const char *path = getenv("BLENDER_VR_SIMULATE");
+	if (!path || !path[0]) {
+		return 0;
+	}
+	return path;
+}
+
+int vr_simulated_create_vr()
+{
+	if (vr_simulated) {
+		delete vr_simulated;
+	}
+	vr_simulated = new VR_Simulated();
+	vr_simulated->frame = 0;
+	vr_simulated->tex_width = vr_simulated->tex_height = 0;
+	memset(vr_simulated->tex, 0, sizeof(vr_simulated->tex));
+	memset(vr_simulated->fbo, 0, sizeof(vr_simulated->fbo));
+	vr_simulated->fbo_read = 0;
+	vr_simulated->timings_written = false;
+	vr_simulated->replaying = vr_simulated->replayed = false;
+	vr_simulated->replay_pass_duration = 0.0;
+	memset(vr_simulated->controller, 0, sizeof(vr_simulated->controller));
+	return 0;
+}
+
+#ifdef WIN32
+int vr_simulated_init_vr(void *device, void *context)
+#else
+int vr_simulated_init_vr(void *display, void *drawable, void *context)
+#endif
+{
+	if (!vr_simulated) {
+		return -1;
+	}
+
+	const char *path = vr_simulated_trace_path();
+	if (!path) {
+		return -1;
+	}
+	vr_simulated->trace_path = path;
+	VR_Trace::Frame frame;
+	if (!vr_simulated->trace.open(path) || !vr_simulated->trace.frame(0, frame)) {
+		printf("VR simulation: could not read trace %s\n", path);
+		return -1;
+	}
+
+	const VR_Trace::Header& header = vr_simulated->trace.header;
+	memcpy(vr_simulated->eye_params, header.eye_params, sizeof(vr_simulated->eye_params));
+	vr_simulated->tex_width = header.tex_width ? (int)header.tex_width : VR_SIMULATED_DEFAULT_TEX_WIDTH;
+	vr_simulated->tex_height = header.tex_height ? (int)header.tex_height : VR_SIMULATED_DEFAULT_TEX_HEIGHT;
+
+	/* Eye textures, as the compositor of a VR device would have them. */
+	GLint fbo_draw_prev, fbo_read_prev;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo_draw_prev);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &fbo_read_prev);
+	glGenTextures(VR_SIDES, vr_simulated->tex);
+	glGenFramebuffers(VR_SIDES, vr_simulated->fbo);
+	glGenFramebuffers(1, &vr_simulated->fbo_read);
+	bool complete = true;
+	for (int side = 0; side < VR_SIDES; ++side) {
+		glBindTexture(GL_TEXTURE_2D, vr_simulated->tex[side]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, vr_simulated->tex_width, vr_simulated->tex_height, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, vr_simulated->fbo[side]);
+		glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, vr_simulated->tex[side], 0);
+		complete = complete && (glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_draw_prev);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_read_prev);
+	if (!complete) {
+		printf("VR simulation: could not create eye framebuffers\n");
+		vr_simulated_free_textures();
+		return -1;
+	}
+
+	vr_simulated_set_frame(frame);
+	vr_simulated->timings.clear();
+
+	printf("VR simulation: replaying %u frames from %s\n", vr_simulated->trace.num_frames(), path);
+	return 0;
+}
+
+int vr_simulated_get_hmd_type(int *type)
+{
+	if (!vr_simulated) {
+		return -1;
+	}
+	*type = (int)vr_simulated->trace.header.device_type;
+	return 0;
+}
+
+int vr_simulated_set_eye_params(int side, float fx, float fy, float cx, float cy)
+{
+	if (!vr_simulated || side < 0 || side >= VR_SIDES) {
+		return -1;
+	}
+	vr_simulated->eye_params[side][0] = fx;
+	vr_simulated->eye_params[side][1] = fy;
+	vr_simulated->eye_params[side][2] = cx;
+	vr_simulated->eye_params[side][3] = cy;
+	return 0;
+}
+
+int vr_simulated_get_default_eye_params(int side, float *fx, float *fy, float *cx, float *cy)
+{
+	if (!vr_simulated || side < 0 || side >= VR_SIDES) {
+		return -1;
+	}
+	const float *params = vr_simulated->trace.header.eye_params[side];
+	*fx = params[0];
+	*fy = params[1];
+	*cx = params[2];
+	*cy = params[3];
+	return 0;
+}
+
+int vr_simulated_get_default_eye_tex_size(int *w, int *h, int side)
+{
+	if (!vr_simulated) {
+		return -1;
+	}
+	*w = vr_simulated->tex_width;
+	*h = vr_simulated->tex_height;
+	return 0;
+}
+
+int vr_simulated_update_tracking()
+{
+	if (!vr_simulated || vr_simulated->trace.num_frames() == 0) {
+		return -1;
+	}
+	/* Frames are replayed one per VR frame (not by time), so runs are deterministic.
+	 * The trace is looped. */
+	const uint num_frames = vr_simulated->trace.num_frames();
+	VR_Trace::Frame frame;
+	vr_simulated->trace.frame(vr_simulated->frame % num_frames, frame);
+	vr_simulated_set_frame(frame);
+	if (vr_simulated->replaying) {
+		/* The UI sees the recorded time, however long the frames take to process. */
+		const uint pass = vr_simulated->frame / num_frames;
+		vr_api_set_replay_time(pass * vr_simulated->replay_pass_duration + frame.time);
+	}
+	++vr_simulated->frame;
+	return 0;
+}
+
+int vr_simulated_get_eye_positions(float t_eye[VR_SIDES][4][4])
+{
+	if (!vr_simulated) {
+		return -1;
+	}
+	memcpy(t_eye, vr_simulated->t_eye, sizeof(vr_simulated->t_eye));
+	return 0;
+}
+
+int vr_simulated_get_hmd_position(float t_hmd[4][4])
+{
+	if (!vr_simulated) {
+		return -1;
+	}
+	memcpy(t_hmd, vr_simulated->t_hmd, sizeof(vr_simulated->t_hmd));
+	return 0;
+}
+
+int vr_simulated_get_controller_positions(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+	if (!vr_simulated) {
+		return -1;
+	}
+	memcpy(t_controller, vr_simulated->t_controller, sizeof(vr_simulated->t_controller));
+	return 0;
+}
+
+int vr_simulated_get_controller_states(void *controller_states[VR_MAX_CONTROLLERS])
+{
+	if (!vr_simulated) {
+		return -1;
+	}
+	for (int i = 0; i < VR_MAX_CONTROLLERS; ++i) {
+		if (controller_states[i]) {
+			memcpy(controller_states[i], &vr_simulated->controller[i], sizeof(VR_Controller));
+		}
+	}
+	return 0;
+}
+
+int vr_simulated_blit_eye(int side, void *texture_resource, const float *aperture_u, const float *aperture_v)
+{
+	if (!vr_simulated || side < 0 || side >= VR_SIDES || !vr_simulated->fbo[side]) {
+		return -1;
+	}
+	const GLuint texture = *(const GLuint *)texture_resource;
+	const int w = vr_simulated->tex_width;
+	const int h = vr_simulated->tex_height;
+
+	GLint fbo_draw_prev, fbo_read_prev;
+	glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo_draw_prev);
+	glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &fbo_read_prev);
+
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, vr_simulated->fbo_read);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, vr_simulated->fbo[side]);
+	glBlitFramebuffer(0, 0, (GLint)(w * *aperture_u), (GLint)(h * *aperture_v), 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo_draw_prev);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo_read_prev);
+	return 0;
+}
+
+int vr_simulated_blit_eyes(void *texture_resource_left, void *texture_resource_right, const float *aperture_u, const float *aperture_v)
+{
+	int error = vr_simulated_blit_eye(VR_SIDE_LEFT, texture_resource_left, aperture_u, aperture_v);
+	error |= vr_simulated_blit_eye(VR_SIDE_RIGHT, texture_resource_right, aperture_u, aperture_v);
+	return error;
+}
+
+int vr_simulated_submit_frame()
+{
+	if (!vr_simulated) {
+		return -1;
+	}
+	/* There is no compositor: just make sure the blits are executed, like a submit would. */
+	glFlush();
+	return 0;
+}
+
+int vr_simulated_uninit_vr()
+{
+	if (!vr_simulated) {
+		return -1;
+	}
+	vr_simulated_write_timings();
+	vr_simulated_free_textures();
+	delete vr_simulated;
+	vr_simulated = 0;
+	return 0;
+}
+
+int vr_simulated_stage_begin(int stage)
+{
+	if (!vr_simulated || stage < 0 || stage >= VR_Frame_Timings::STAGES) {
+		return -1;
+	}
+	vr_simulated->timings.begin((VR_Frame_Timings::Stage)stage, PIL_check_seconds_timer());
+	return 0;
+}
+
+int vr_simulated_stage_end(int stage)
+{
+	if (!vr_simulated || stage < 0 || stage >= VR_Frame_Timings::STAGES) {
+		return -1;
+	}
+	vr_simulated->timings.end((VR_Frame_Timings::Stage)stage, PIL_check_seconds_timer());
+	if (stage == VR_SIMULATED_STAGE_BLIT) {
+		vr_simulated_frame_end();
+	}
+	return 0;
+}
+
+int vr_simulated_frame_end()
+{
+	if (!vr_simulated) {
+		return -1;
+	}
+	vr_simulated->timings.frame_end(PIL_check_seconds_timer());
+	/* Write the timings as soon as the whole trace was replayed once (replays write them when done). */
+	if (!vr_simulated->replaying && vr_simulated->timings.num_frames() >= vr_simulated->trace.num_frames()) {
+		vr_simulated_write_timings();
+	}
+	return 0;
+}
+
+int vr_simulated_replay_begin()
+{
+	if (!vr_simulated || vr_simulated->replayed || vr_simulated->trace.num_frames() == 0) {
+		return 0;
+	}
+	const char *passes = getenv("BLENDER_VR_REPLAY");
+	if (!passes || !passes[0]) {
+		return 0;
+	}
+	const int num_passes = std::max(atoi(passes), 1);
+	const uint num_frames = vr_simulated->trace.num_frames();
+
+	/* Passes follow each other on the UI clock, a frame interval apart. */
+	VR_Trace::Frame first, last;
+	vr_simulated->trace.frame(0, first);
+	vr_simulated->trace.frame(num_frames - 1, last);
+	const double interval = (num_frames > 1) ? (last.time - first.time) / (num_frames - 1) : 0.0;
+	vr_simulated->replay_pass_duration = (interval > 0.0) ? last.time - first.time + interval : 1.0 / 60.0;
+
+	/* Start over from the first frame, and only measure the replayed frames. */
+	vr_simulated->frame = 0;
+	vr_simulated->timings.clear();
+	vr_simulated->timings_written = false;
+	vr_simulated->replaying = vr_simulated->replayed = true;
+
+	printf("VR simulation: replaying %u frames (%d passes) without drawing\n", num_frames * num_passes, num_passes);
+	return (int)(num_frames * num_passes);
+}
+
+int vr_simulated_replay_end()
+{
+	if (!vr_simulated || !vr_simulated->replaying) {
+		return -1;
+	}
+	vr_simulated->replaying = false;
+	vr_api_set_replay_time(-1.0);
+	vr_simulated_write_timings();
+	return 0;
+}
+
+/* Trace being recorded from the VR device (if any). */
+static VR_Trace *vr_trace_recording = 0;
+static double vr_trace_record_start = 0.0;
+
+int vr_trace_record_begin()
+{
+	const char *path = getenv("BLENDER_VR_RECORD");
+	if (!path || !path[0]) {
+		return 0;
+	}
+	vr_trace_record_end();
+
+	const VR *vr = vr_get_obj();
+	vr_trace_recording = new VR_Trace();
+	VR_Trace::Header& header = vr_trace_recording->header;
+	header.device_type = (uint)vr->device_type;
+	header.tex_width = (uint)vr->tex_width;
+	header.tex_height = (uint)vr->tex_height;
+	for (int side = 0; side < VR_SIDES; ++side) {
+		header.eye_params[side][0] = vr->fx[side];
+		header.eye_params[side][1] = vr->fy[side];
+		header.eye_params[side][2] = vr->cx[side];
+		header.eye_params[side][3] = vr->cy[side];
+
+		/* Eye position in HMD coordinates (the HMD axes are orthonormal). */
+		const float (*t_hmd)[4] = vr->t_hmd[VR_SPACE_REAL];
+		const float (*t_eye)[4] = vr->t_eye[VR_SPACE_REAL][side];
+		for (int i = 0; i < 3; ++i) {
+			header.eye_offset[side][i] = (t_eye[3][0] - t_hmd[3][0]) * t_hmd[i][0] +
+										 (t_eye[3][1] - t_hmd[3][1]) * t_hmd[i][1] +
+										 (t_eye[3][2] - t_hmd[3][2]) * t_hmd[i][2];
+		}
+	}
+
+	if (!vr_trace_recording->record_begin(path)) {
+		printf("VR recording: could not open %s\n", path);
+		delete vr_trace_recording;
+		vr_trace_recording = 0;
+		return -1;
+	}
+	vr_trace_record_start = PIL_check_seconds_timer();
+	printf("VR recording: recording to %s\n", path);
+	return 0;
+}
+
+int vr_trace_record_frame()
+{
+	if (!vr_trace_recording) {
+		return 0;
+	}
+
+	const VR *vr = vr_get_obj();
+	VR_Trace::Frame frame;
+	memset(&frame, 0, sizeof(frame));
+	frame.time = (float)(PIL_check_seconds_timer() - vr_trace_record_start);
+	VR_Trace::matrix_to_pose(vr->t_hmd[VR_SPACE_REAL], frame.hmd);
+	for (int i = 0; i < VR_MAX_CONTROLLERS; ++i) {
+		if (vr->controller[i]) {
+			VR_Trace::state_to_controller(*vr->controller[i], frame.controller[i]);
+		}
+		VR_Trace::matrix_to_pose(vr->t_controller[VR_SPACE_REAL][i], frame.controller[i].pose);
+	}
+
+	return vr_trace_recording->record(frame) ? 0 : -1;
+}
+
+int vr_trace_record_end()
+{
+	if (!vr_trace_recording) {
+		return 0;
+	}
+	const bool ok = vr_trace_recording->record_end();
+	delete vr_trace_recording;
+	vr_trace_recording = 0;
+	return ok ? 0 : -1;
+}
@@ -0,0 +1,106 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_simulated.h
+*   \ingroup vr
+*
+* Built-in VR backend that replays a recorded session (see VR_Trace) instead of using a VR device.
+* It implements the same functions as the VR shared libraries, renders into its own offscreen
+* buffers and measures each stage of the VR frames, so the whole VR loop can be benchmarked
+* without a VR device (i.e. on a CI machine with a software OpenGL implementation).
+*
+* Environment variables:
+* - BLENDER_VR_SIMULATE: trace file to replay (selects the simulated backend).
+* - BLENDER_VR_SIMULATE_TIMINGS: JSON file for the frame timings (default: trace file + ".json"),
+*   written after the trace was replayed once and when VR is stopped.
+* - BLENDER_VR_REPLAY: number of times to replay the trace without drawing, as fast as possible
+*   (see vr_replay()). Blender quits when done, after writing the frame timings.
+* - BLENDER_VR_RECORD: trace file to record from the VR device.
+*/
+
+#ifndef __VR_SIMULATED_H__
+#define __VR_SIMULATED_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Stages of a VR frame (same order as VR_Frame_Timings::Stage). */
+typedef enum VR_Simulated_Stage {
+	VR_SIMULATED_STAGE_TRACKING = 0	/* vr_update_tracking(). */
+	,
+	VR_SIMULATED_STAGE_INTERACTION = 1	/* vr_do_interaction(). */
+	,
+	VR_SIMULATED_STAGE_DRAW_LEFT = 2	/* Drawing the left eye. */
+	,
+	VR_SIMULATED_STAGE_DRAW_RIGHT = 3	/* Drawing the right eye. */
+	,
+	VR_SIMULATED_STAGE_BLIT = 4	/* vr_blit() (ends the frame). */
+	,
+	VR_SIMULATED_STAGE_UPDATE = 5	/* Post-render interaction and scene update of replayed frames. */
+} VR_Simulated_Stage;
+
+const char *vr_simulated_trace_path(void);	/* Trace file to replay (NULL if the simulated backend is not requested). */
+
+/* VR shared library functions. */
+int vr_simulated_create_vr(void);	/* Create the internal VR object. Must be called before the functions below. */
+#ifdef WIN32
+int vr_simulated_init_vr(void *device, void *context);	/* Initialize the internal VR object (OpenGL). */
+#else
+int vr_simulated_init_vr(void *display, void *drawable, void *context);	/* Initialize the internal VR object (OpenGL). */
+#endif
+int vr_simulated_get_hmd_type(int *type);	/* Get the type of HMD of the recording. */
+int vr_simulated_set_eye_params(int side, float fx, float fy, float cx, float cy);	/* Set rendering parameters. */
+int vr_simulated_get_default_eye_params(int side, float *fx, float *fy, float *cx, float *cy);	/* Get the HMD's default parameters. */
+int vr_simulated_get_default_eye_tex_size(int *w, int *h, int side);	/* Get the default eye texture size. */
+int vr_simulated_update_tracking(void);	/* Advance to the next frame of the recording. */
+int vr_simulated_get_eye_positions(float t_eye[2][4][4]);	/* Last tracked position of the eyes. */
+int vr_simulated_get_hmd_position(float t_hmd[4][4]);	/* Last tracked position of the HMD. */
+int vr_simulated_get_controller_positions(float t_controller[3][4][4]);	/* Last tracked position of the controllers. */
+int vr_simulated_get_controller_states(void *controller_states[3]);	/* Last tracked button states of the controllers. */
+int vr_simulated_blit_eye(int side, void *texture_resource, const float *aperture_u, const float *aperture_v);	/* Blit a rendered image into the internal eye texture. */
+int vr_simulated_blit_eyes(void *texture_resource_left, void *texture_resource_right, const float *aperture_u, const float *aperture_v);	/* Blit rendered images into the internal eye textures. */
+int vr_simulated_submit_frame(void);	/* Submit frame (flush). */
+int vr_simulated_uninit_vr(void);	/* Un-initialize the internal object (writes the frame timings). */
+
+/* Frame timings. */
+int vr_simulated_stage_begin(int stage);	/* A stage of the current frame starts. */
+int vr_simulated_stage_end(int stage);	/* A stage of the current frame ends. */
+int vr_simulated_frame_end(void);	/* The current frame ends (at the end of the blit, or of a replayed frame). */
+
+/* Replay without drawing. */
+int vr_simulated_replay_begin(void);	/* Start replaying (once, if BLENDER_VR_REPLAY is set). Returns the number of frames to replay (0: no replay). */
+int vr_simulated_replay_end(void);	/* Finish replaying (writes the frame timings). */
+
+/* Recording of traces from a VR device. */
+int vr_trace_record_begin(void);	/* Start recording (if BLENDER_VR_RECORD is set), with the parameters of the VR module. */
+int vr_trace_record_frame(void);	/* Record the tracking data and controller states of the VR module. */
+int vr_trace_record_end(void);	/* Finish recording. */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __VR_SIMULATED_H__ */
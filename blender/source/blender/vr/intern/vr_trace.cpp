@@ -0,0 +1,693 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_trace.cpp
+*   \ingroup vr
+*
+* Recorded VR sessions and frame timings for benchmarking.
+*/
+
+#include "vr_types.h"
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "vr_trace.h"
+
+/***********************************************************************************************//**
+ * \class                                  VR_Trace
+ ***************************************************************************************************
+ * Recorded VR session.
+ **************************************************************************************************/
+const uint VR_Trace::magic = 0x54525842; /* "BXRT" */
+const uint VR_Trace::version = 1;
+
+/* Sizes in the file. */
+#define VR_TRACE_POSE_SIZE (7 * 4)
+#define VR_TRACE_CONTROLLER_SIZE (1 + 2 * 8 + 6 * 4 + VR_TRACE_POSE_SIZE)
+#define VR_TRACE_HEADER_SIZE (6 * 4 + VR_SIDES * 7 * 4)
+#define VR_TRACE_FRAME_SIZE (4 + VR_TRACE_POSE_SIZE + VR_MAX_CONTROLLERS * VR_TRACE_CONTROLLER_SIZE)
+#define VR_TRACE_NUM_FRAMES_OFFSET (3 * 4)
+
+const uint VR_Trace::frame_size = VR_TRACE_FRAME_SIZE;
+
+/* Little-endian serialization, independent of struct layout. */
+static uchar *put_u8(uchar *p, uchar v)
+{
+	*p = v;
+	return p + 1;
+}
+
+static uchar *put_u32(uchar *p, uint v)
+{
+	for (int i = 0; i < 4; ++i) {
+		p[i] = (uchar)(v >> (8 * i));
+	}
+	return p + 4;
+}
+
+static uchar *put_u64(uchar *p, ui64 v)
+{
+	for (int i = 0; i < 8; ++i) {
+		p[i] = (uchar)(v >> (8 * i));
+	}
+	return p + 8;
+}
+
+static uchar *put_f32(uchar *p, float v)
+{
+	uint u;
+	memcpy(&u, &v, sizeof(u));
+	return put_u32(p, u);
+}
+
+static const uchar *get_u8(const uchar *p, uchar& v)
+{
+	v = *p;
+	return p + 1;
+}
+
+static const uchar *get_u32(const uchar *p, uint& v)
+{
+	v = 0;
+	for (int i = 0; i < 4; ++i) {
+		v |= (uint)p[i] << (8 * i);
+	}
+	return p + 4;
+}
+
+static const uchar *get_u64(const uchar *p, ui64& v)
+{
+	v = 0;
+	for (int i = 0; i < 8; ++i) {
+		v |= (ui64)p[i] << (8 * i);
+	}
+	return p + 8;
+}
+
+static const uchar *get_f32(const uchar *p, float& v)
+{
+	uint u;
+	p = get_u32(p, u);
+	memcpy(&v, &u, sizeof(v));
+	return p;
+}
+
+static uchar *put_pose(uchar *p, const VR_Trace::Pose& pose)
+{
+	for (int i = 0; i < 3; ++i) {
+		p = put_f32(p, pose.pos[i]);
+	}
+	for (int i = 0; i < 4; ++i) {
+		p = put_f32(p, pose.rot[i]);
+	}
+	return p;
+}
+
+static const uchar *get_pose(const uchar *p, VR_Trace::Pose& pose)
+{
+	for (int i = 0; i < 3; ++i) {
+		p = get_f32(p, pose.pos[i]);
+	}
+	for (int i = 0; i < 4; ++i) {
+		p = get_f32(p, pose.rot[i]);
+	}
+	return p;
+}
+
+static void put_header(uchar *p, const VR_Trace::Header& header)
+{
+	p = put_u32(p, VR_Trace::magic);
+	p = put_u32(p, VR_Trace::version);
+	p = put_u32(p, header.device_type);
+	p = put_u32(p, header.num_frames);
+	p = put_u32(p, header.tex_width);
+	p = put_u32(p, header.tex_height);
+	for (int i = 0; i < VR_SIDES; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			p = put_f32(p, header.eye_params[i][j]);
+		}
+		for (int j = 0; j < 3; ++j) {
+			p = put_f32(p, header.eye_offset[i][j]);
+		}
+	}
+}
+
+static bool get_header(const uchar *p, VR_Trace::Header& header)
+{
+	uint m, v;
+	p = get_u32(p, m);
+	p = get_u32(p, v);
+	if (m != VR_Trace::magic || v != VR_Trace::version) {
+		return false;
+	}
+	p = get_u32(p, header.device_type);
+	p = get_u32(p, header.num_frames);
+	p = get_u32(p, header.tex_width);
+	p = get_u32(p, header.tex_height);
+	for (int i = 0; i < VR_SIDES; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			p = get_f32(p, header.eye_params[i][j]);
+		}
+		for (int j = 0; j < 3; ++j) {
+			p = get_f32(p, header.eye_offset[i][j]);
+		}
+	}
+	return true;
+}
+
+static void put_frame(uchar *p, const VR_Trace::Frame& frame)
+{
+	p = put_f32(p, frame.time);
+	p = put_pose(p, frame.hmd);
+	for (int i = 0; i < VR_MAX_CONTROLLERS; ++i) {
+		const VR_Trace::Controller& c = frame.controller[i];
+		p = put_u8(p, c.available);
+		p = put_u64(p, c.buttons);
+		p = put_u64(p, c.buttons_touched);
+		p = put_f32(p, c.dpad[0]);
+		p = put_f32(p, c.dpad[1]);
+		p = put_f32(p, c.stick[0]);
+		p = put_f32(p, c.stick[1]);
+		p = put_f32(p, c.trigger_pressure);
+		p = put_f32(p, c.grip_pressure);
+		p = put_pose(p, c.pose);
+	}
+}
+
+static void get_frame(const uchar *p, VR_Trace::Frame& frame)
+{
+	p = get_f32(p, frame.time);
+	p = get_pose(p, frame.hmd);
+	for (int i = 0; i < VR_MAX_CONTROLLERS; ++i) {
+		VR_Trace::Controller& c = frame.controller[i];
+		p = get_u8(p, c.available);
+		p = get_u64(p, c.buttons);
+		p = get_u64(p, c.buttons_touched);
+		p = get_f32(p, c.dpad[0]);
+		p = get_f32(p, c.dpad[1]);
+		p = get_f32(p, c.stick[0]);
+		p = get_f32(p, c.stick[1]);
+		p = get_f32(p, c.trigger_pressure);
+		p = get_f32(p, c.grip_pressure);
+		p = get_pose(p, c.pose);
+	}
+}
+
+VR_Trace::VR_Trace()
+	: record_file(0)
+	, record_frames(0)
+{
+	memset(&header, 0, sizeof(header));
+}
+
+VR_Trace::~VR_Trace()
+{
+	record_end();
+}
+
+bool VR_Trace::read(const char *path)
+{
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		return false;
+	}
+
+	uchar buf[VR_TRACE_HEADER_SIZE];
+	Header h;
+	if (fread(buf, 1, VR_TRACE_HEADER_SIZE, f) != VR_TRACE_HEADER_SIZE || !get_header(buf, h)) {
+		fclose(f);
+		return false;
+	}
+
+	/* Unfinished recordings have no number of frames: limit it by the file size. */
+	long frames_size = 0;
+	if (fseek(f, 0, SEEK_END) == 0) {
+		frames_size = ftell(f) - VR_TRACE_HEADER_SIZE;
+	}
+	fseek(f, VR_TRACE_HEADER_SIZE, SEEK_SET);
+	const uint num_frames = (frames_size > 0) ? std::min(h.num_frames, (uint)(frames_size / frame_size)) : 0;
+
+	std::vector<uchar> data(frame_size);
+	frames.clear();
+	frames.reserve(num_frames);
+	for (uint i = 0; i < num_frames; ++i) {
+		if (fread(&data[0], 1, frame_size, f) != frame_size) {
+			break;
+		}
+		Frame frame;
+		get_frame(&data[0], frame);
+		frames.push_back(frame);
+	}
+	fclose(f);
+
+	/* A recording that was not finished still contains all complete frames. */
+	header = h;
+	header.num_frames = (uint)frames.size();
+	return true;
+}
+
+bool VR_Trace::write(const char *path) const
+{
+	FILE *f = fopen(path, "wb");
+	if (!f) {
+		return false;
+	}
+
+	Header h = header;
+	h.num_frames = (uint)frames.size();
+	uchar buf[VR_TRACE_HEADER_SIZE];
+	put_header(buf, h);
+	bool ok = (fwrite(buf, 1, VR_TRACE_HEADER_SIZE, f) == VR_TRACE_HEADER_SIZE);
+
+	std::vector<uchar> data(frame_size);
+	for (size_t i = 0; ok && i < frames.size(); ++i) {
+		put_frame(&data[0], frames[i]);
+		ok = (fwrite(&data[0], 1, frame_size, f) == frame_size);
+	}
+
+	return (fclose(f) == 0) && ok;
+}
+
+bool VR_Trace::record_begin(const char *path)
+{
+	record_end();
+
+	record_file = fopen(path, "wb");
+	if (!record_file) {
+		return false;
+	}
+	record_frames = 0;
+
+	/* Written again with the number of frames by record_end(). */
+	Header h = header;
+	h.num_frames = 0xFFFFFFFF;
+	uchar buf[VR_TRACE_HEADER_SIZE];
+	put_header(buf, h);
+	if (fwrite(buf, 1, VR_TRACE_HEADER_SIZE, record_file) != VR_TRACE_HEADER_SIZE) {
+		fclose(record_file);
+		record_file = 0;
+		return false;
+	}
+	return true;
+}
+
+bool VR_Trace::record(const Frame& frame)
+{
+	if (!record_file) {
+		return false;
+	}
+	uchar data[VR_TRACE_FRAME_SIZE];
+	put_frame(data, frame);
+	if (fwrite(data, 1, frame_size, record_file) != frame_size) {
+		return false;
+	}
+	++record_frames;
+	return true;
+}
+
+bool VR_Trace::record_end()
+{
+	if (!record_file) {
+		return false;
+	}
+	uchar buf[4];
+	put_u32(buf, record_frames);
+	bool ok = (fseek(record_file, VR_TRACE_NUM_FRAMES_OFFSET, SEEK_SET) == 0) &&
+			  (fwrite(buf, 1, 4, record_file) == 4);
+	ok = (fclose(record_file) == 0) && ok;
+	record_file = 0;
+	return ok;
+}
+
+bool VR_Trace::is_recording() const
+{
+	return record_file != 0;
+}
+
+void VR_Trace::pose_to_matrix(const Pose& pose, float m[4][4])
+{
+	const float w = pose.rot[0], x = pose.rot[1], y = pose.rot[2], z = pose.rot[3];
+
+	/* Rows are the rotated axes (Blender convention). */
+	m[0][0] = 1.0f - 2.0f * (y * y + z * z);
+	m[0][1] = 2.0f * (x * y + w * z);
+	m[0][2] = 2.0f * (x * z - w * y);
+	m[1][0] = 2.0f * (x * y - w * z);
+	m[1][1] = 1.0f - 2.0f * (x * x + z * z);
+	m[1][2] = 2.0f * (y * z + w * x);
+	m[2][0] = 2.0f * (x * z + w * y);
+	m[2][1] = 2.0f * (y * z - w * x);
+	m[2][2] = 1.0f - 2.0f * (x * x + y * y);
+	m[0][3] = m[1][3] = m[2][3] = 0.0f;
+	m[3][0] = pose.pos[0];
+	m[3][1] = pose.pos[1];
+	m[3][2] = pose.pos[2];
+	m[3][3] = 1.0f;
+}
+
+void VR_Trace::matrix_to_pose(const float m[4][4], Pose& pose)
+{
+	/* Normalized axes (r[i][j]: component i of axis j). */
+	double r[3][3];
+	for (int j = 0; j < 3; ++j) {
+		double len = sqrt((double)m[j][0] * m[j][0] + (double)m[j][1] * m[j][1] + (double)m[j][2] * m[j][2]);
+		if (len < 1e-12) {
+			len = 1.0;
+		}
+		for (int i = 0; i < 3; ++i) {
+			r[i][j] = m[j][i] / len;
+		}
+	}
+
+	double q[4];
+	const double trace = r[0][0] + r[1][1] + r[2][2];
+	if (trace > 0.0) {
+		const double s = 2.0 * sqrt(trace + 1.0);
+		q[0] = 0.25 * s;
+		q[1] = (r[2][1] - r[1][2]) / s;
+		q[2] = (r[0][2] - r[2][0]) / s;
+		q[3] = (r[1][0] - r[0][1]) / s;
+	}
+	else if (r[0][0] > r[1][1] && r[0][0] > r[2][2]) {
+		const double s = 2.0 * sqrt(1.0 + r[0][0] - r[1][1] - r[2][2]);
+		q[0] = (r[2][1] - r[1][2]) / s;
+		q[1] = 0.25 * s;
+		q[2] = (r[0][1] + r[1][0]) / s;
+		q[3] = (r[0][2] + r[2][0]) / s;
+	}
+	else if (r[1][1] > r[2][2]) {
+		const double s = 2.0 * sqrt(1.0 + r[1][1] - r[0][0] - r[2][2]);
+		q[0] = (r[0][2] - r[2][0]) / s;
+		q[1] = (r[0][1] + r[1][0]) / s;
+		q[2] = 0.25 * s;
+		q[3] = (r[1][2] + r[2][1]) / s;
+	}
+	else {
+		const double s = 2.0 * sqrt(1.0 + r[2][2] - r[0][0] - r[1][1]);
+		q[0] = (r[1][0] - r[0][1]) / s;
+		q[1] = (r[0][2] + r[2][0]) / s;
+		q[2] = (r[1][2] + r[2][1]) / s;
+		q[3] = 0.25 * s;
+	}
+
+	const double len = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+	for (int i = 0; i < 4; ++i) {
+		pose.rot[i] = (float)(q[i] / len);
+	}
+	pose.pos[0] = m[3][0];
+	pose.pos[1] = m[3][1];
+	pose.pos[2] = m[3][2];
+}
+
+void VR_Trace::controller_to_state(const Controller& c, VR_Controller& state)
+{
+	state.available = c.available;
+	state.buttons = c.buttons;
+	state.buttons_touched = c.buttons_touched;
+	state.dpad[0] = c.dpad[0];
+	state.dpad[1] = c.dpad[1];
+	state.stick[0] = c.stick[0];
+	state.stick[1] = c.stick[1];
+	state.trigger_pressure = c.trigger_pressure;
+	state.grip_pressure = c.grip_pressure;
+}
+
+void VR_Trace::state_to_controller(const VR_Controller& state, Controller& c)
+{
+	c.available = state.available ? 1 : 0;
+	c.buttons = state.buttons;
+	c.buttons_touched = state.buttons_touched;
+	c.dpad[0] = state.dpad[0];
+	c.dpad[1] = state.dpad[1];
+	c.stick[0] = state.stick[0];
+	c.stick[1] = state.stick[1];
+	c.trigger_pressure = state.trigger_pressure;
+	c.grip_pressure = state.grip_pressure;
+}
+
+/***********************************************************************************************//**
+ * \class                                 VR_Trace_Map
+ ***************************************************************************************************
+ * Memory-mapped trace file.
+ **************************************************************************************************/
+VR_Trace_Map::VR_Trace_Map()
+	: data(0)
+	, size(0)
+#ifdef WIN32
+	, file(0)
+	, mapping(0)
+#endif
+{
+	memset(&header, 0, sizeof(header));
+}
+
+VR_Trace_Map::~VR_Trace_Map()
+{
+	close();
+}
+
+bool VR_Trace_Map::open(const char *path)
+{
+	close();
+
+#ifdef WIN32
+	/* Shared for writing, so a recording in progress can be mapped. */
+	HANDLE f = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (f == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(f, &file_size) || file_size.QuadPart < VR_TRACE_HEADER_SIZE) {
+		CloseHandle(f);
+		return false;
+	}
+	HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!m) {
+		CloseHandle(f);
+		return false;
+	}
+	void *p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+	if (!p) {
+		CloseHandle(m);
+		CloseHandle(f);
+		return false;
+	}
+	file = f;
+	mapping = m;
+	size = (size_t)file_size.QuadPart;
+#else
+	const int fd = ::open(path, O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < VR_TRACE_HEADER_SIZE) {
+		::close(fd);
+		return false;
+	}
+	void *p = mmap(0, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	/* The mapping keeps the file open. */
+	::close(fd);
+	if (p == MAP_FAILED) {
+		return false;
+	}
+	/* Frames are replayed in order. */
+	madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+	size = (size_t)st.st_size;
+#endif
+	data = (const uchar *)p;
+
+	VR_Trace::Header h;
+	if (!get_header(data, h)) {
+		close();
+		return false;
+	}
+	/* Unfinished recordings have no number of frames: limit it by the file size. */
+	header = h;
+	header.num_frames = (uint)std::min((size_t)h.num_frames, (size - VR_TRACE_HEADER_SIZE) / VR_TRACE_FRAME_SIZE);
+	return true;
+}
+
+void VR_Trace_Map::close()
+{
+	if (!data) {
+		return;
+	}
+#ifdef WIN32
+	UnmapViewOfFile(data);
+	CloseHandle((HANDLE)mapping);
+	CloseHandle((HANDLE)file);
+	file = mapping = 0;
+#else
+	munmap((void *)data, size);
+#endif
+	data = 0;
+	size = 0;
+	memset(&header, 0, sizeof(header));
+}
+
+bool VR_Trace_Map::is_open() const
+{
+	return data != 0;
+}
+
+uint VR_Trace_Map::num_frames() const
+{
+	return header.num_frames;
+}
+
+bool VR_Trace_Map::frame(uint i, VR_Trace::Frame& r_frame) const
+{
+	if (i >= header.num_frames) {
+		return false;
+	}
+	get_frame(data + VR_TRACE_HEADER_SIZE + (size_t)i * VR_TRACE_FRAME_SIZE, r_frame);
+	return true;
+}
+
+/***********************************************************************************************//**
+ * \class                               VR_Frame_Timings
+ ***************************************************************************************************
+ * Per-stage timings of VR frames.
+ **************************************************************************************************/
+const char *VR_Frame_Timings::stage_name(Stage stage)
+{
+	static const char *names[STAGES + 1] = { "tracking", "interaction", "draw_left", "draw_right", "blit", "update", "frame" };
+	return names[stage];
+}
+
+VR_Frame_Timings::VR_Frame_Timings()
+{
+	clear();
+}
+
+void VR_Frame_Timings::clear()
+{
+	frames.clear();
+	memset(&current, 0, sizeof(current));
+	memset(stage_start, 0, sizeof(stage_start));
+	last_frame_end = 0.0;
+}
+
+void VR_Frame_Timings::begin(Stage stage, double time)
+{
+	stage_start[stage] = time;
+}
+
+void VR_Frame_Timings::end(Stage stage, double time)
+{
+	current.duration[stage] += time - stage_start[stage];
+}
+
+void VR_Frame_Timings::frame_end(double time)
+{
+	current.duration[STAGES] = (last_frame_end > 0.0) ? time - last_frame_end : 0.0;
+	last_frame_end = time;
+	frames.push_back(current);
+	memset(&current, 0, sizeof(current));
+}
+
+uint VR_Frame_Timings::num_frames() const
+{
+	return (uint)frames.size();
+}
+
+double VR_Frame_Timings::get(uint frame, int stage) const
+{
+	return frames[frame].duration[stage];
+}
+
+bool VR_Frame_Timings::write_json(FILE *f, const char *trace_path) const
+{
+	fprintf(f, "{\n");
+	fprintf(f, "  \"trace\": \"");
+	for (const char *c = trace_path ? trace_path : ""; *c; ++c) {
+		if (*c == '"' || *c == '\\') {
+			fputc('\\', f);
+		}
+		fputc(*c, f);
+	}
+	fprintf(f, "\",\n");
+	fprintf(f, "  \"frames\": %u,\n", (uint)frames.size());
+
+	/* Summary per stage (milliseconds). The first frame interval is not measured. */
+	fprintf(f, "  \"summary_ms\": {\n");
+	std::vector<double> d;
+	for (int s = 0; s <= STAGES; ++s) {
+		d.clear();
+		for (size_t i = (s == STAGES) ? 1 : 0; i < frames.size(); ++i) {
+			d.push_back(frames[i].duration[s] * 1000.0);
+		}
+		double mean = 0.0, median = 0.0, p95 = 0.0, max = 0.0;
+		if (!d.empty()) {
+			std::sort(d.begin(), d.end());
+			for (size_t i = 0; i < d.size(); ++i) {
+				mean += d[i];
+			}
+			mean /= d.size();
+			median = d[d.size() / 2];
+			p95 = d[std::min(d.size() - 1, (size_t)(d.size() * 0.95))];
+			max = d.back();
+		}
+		fprintf(f, "    \"%s\": {\"mean\": %.4f, \"median\": %.4f, \"p95\": %.4f, \"max\": %.4f}%s\n",
+			stage_name((Stage)s), mean, median, p95, max, (s < STAGES) ? "," : "");
+	}
+	fprintf(f, "  },\n");
+
+	/* All frames, one array per stage. */
+	fprintf(f, "  \"frames_ms\": {\n");
+	for (int s = 0; s <= STAGES; ++s) {
+		fprintf(f, "    \"%s\": [", stage_name((Stage)s));
+		for (size_t i = 0; i < frames.size(); ++i) {
+			fprintf(f, "%s%.4f", i ? ", " : "", frames[i].duration[s] * 1000.0);
+		}
+		fprintf(f, "]%s\n", (s < STAGES) ? "," : "");
+	}
+	fprintf(f, "  }\n");
+	fprintf(f, "}\n");
+
+	return !ferror(f);
+}
+
+bool VR_Frame_Timings::write_json(const char *path, const char *trace_path) const
+{
+	FILE *f = fopen(path, "w");
+	if (!f) {
+		return false;
+	}
+	const bool ok = write_json(f, trace_path);
+	return (fclose(f) == 0) && ok;
+}
@@ -0,0 +1,180 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_trace.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_TRACE_H__
+#define __VR_TRACE_H__
+
+#include "vr_types.h"
+#include "vr_main.h"
+
+#include <stdio.h>
+#include <vector>
+
+/* Recorded VR session: HMD and controller poses and controller states of each frame.
+ * Stored in a compact binary file (little-endian): a header followed by fixed-size frames,
+ * with poses as position + rotation quaternion. */
+class VR_Trace
+{
+public:
+	static const uint magic;	/* File identifier ("BXRT"). */
+	static const uint version;	/* File format version. */
+
+	/* Tracked pose. */
+	typedef struct Pose {
+		float	pos[3];	/* Position (meters). */
+		float	rot[4];	/* Rotation quaternion (w, x, y, z). */
+	} Pose;
+
+	/* Controller of a frame. */
+	typedef struct Controller {
+		uchar	available;	/* Whether the controller is available. */
+		ui64	buttons;	/* Buttons pressed. */
+		ui64	buttons_touched;	/* Buttons touched. */
+		float	dpad[2];	/* Dpad / touchpad position. */
+		float	stick[2];	/* Thumbstick position. */
+		float	trigger_pressure;	/* Analog trigger pressure. */
+		float	grip_pressure;	/* Analog grip pressure. */
+		Pose	pose;	/* Controller pose (real space). */
+	} Controller;
+
+	/* Tracking data of a frame. */
+	typedef struct Frame {
+		float	time;	/* Time since the start of the recording (seconds). */
+		Pose	hmd;	/* HMD pose (real space). */
+		Controller	controller[VR_MAX_CONTROLLERS];	/* Controllers. */
+	} Frame;
+
+	/* Device parameters of the recording. */
+	typedef struct Header {
+		uint	device_type;	/* VR_Device_Type of the HMD. */
+		uint	num_frames;	/* Number of frames. */
+		uint	tex_width;	/* Eye texture width (pixels). */
+		uint	tex_height;	/* Eye texture height (pixels). */
+		float	eye_params[VR_SIDES][4];	/* Eye parameters (fx, fy, cx, cy, see VR). */
+		float	eye_offset[VR_SIDES][3];	/* Eye positions relative to the HMD. */
+	} Header;
+
+	static const uint frame_size;	/* Size of a frame in the file (bytes). */
+
+	Header	header;	/* Device parameters. */
+	std::vector<Frame>	frames;	/* Frames (read from the file or recorded). */
+
+	VR_Trace();	/* Constructor. */
+	~VR_Trace();	/* Destructor (finishes recording). */
+
+	bool read(const char *path);	/* Read a trace file. */
+	bool write(const char *path) const;	/* Write the trace to a file. */
+
+	/* Recording: frames are written as they are added. */
+	bool record_begin(const char *path);	/* Start recording into a file (with the current header). */
+	bool record(const Frame& frame);	/* Add a frame. */
+	bool record_end();	/* Finish the recording (updates the number of frames in the file). */
+	bool is_recording() const;	/* Whether a recording is in progress. */
+
+	static void pose_to_matrix(const Pose& pose, float m[4][4]);	/* Convert a pose to a transformation matrix. */
+	static void matrix_to_pose(const float m[4][4], Pose& pose);	/* Convert a transformation matrix to a pose. */
+	static void controller_to_state(const Controller& c, VR_Controller& state);	/* Convert a trace controller to the controller state of the VR module. */
+	static void state_to_controller(const VR_Controller& state, Controller& c);	/* Convert a controller state of the VR module to a trace controller. */
+protected:
+	FILE	*record_file;	/* File being recorded (if any). */
+	uint	record_frames;	/* Number of frames recorded. */
+};
+
+/* Read-only memory mapping of a trace file. Frames are decoded when they are accessed,
+ * so long recordings are replayed without loading (or copying) them first. */
+class VR_Trace_Map
+{
+public:
+	VR_Trace::Header	header;	/* Device parameters (num_frames: number of complete frames in the file). */
+
+	VR_Trace_Map();	/* Constructor. */
+	~VR_Trace_Map();	/* Destructor (unmaps the file). */
+
+	bool open(const char *path);	/* Map a trace file (also one that is still being recorded). */
+	void close();	/* Unmap the file. */
+	bool is_open() const;	/* Whether a file is mapped. */
+	uint num_frames() const;	/* Number of frames. */
+	bool frame(uint i, VR_Trace::Frame& r_frame) const;	/* Decode a frame. */
+protected:
+	const uchar	*data;	/* Mapped file. */
+	size_t	size;	/* Size of the mapped file (bytes). */
+#ifdef WIN32
+	void	*file;	/* File handle. */
+	void	*mapping;	/* File mapping handle. */
+#endif
+};
+
+/* Per-stage timings of VR frames (tracking, interaction, drawing of each eye, blit).
+ * Summarized and written as JSON for benchmarking. */
+class VR_Frame_Timings
+{
+public:
+	/* Stages of a frame. */
+	typedef enum Stage {
+		STAGE_TRACKING = 0	/* vr_update_tracking(). */
+		,
+		STAGE_INTERACTION = 1	/* vr_do_interaction(). */
+		,
+		STAGE_DRAW_LEFT = 2	/* Drawing the left eye. */
+		,
+		STAGE_DRAW_RIGHT = 3	/* Drawing the right eye. */
+		,
+		STAGE_BLIT = 4	/* vr_blit(). */
+		,
+		STAGE_UPDATE = 5	/* Post-render interaction and scene update of replayed frames (see vr_replay()). */
+		,
+		STAGES = 6	/* Number of stages. */
+	} Stage;
+
+	static const char *stage_name(Stage stage);	/* Name of a stage in the JSON output. */
+
+	VR_Frame_Timings();	/* Constructor. */
+
+	void clear();	/* Discard all frames. */
+	void begin(Stage stage, double time);	/* A stage of the current frame starts. */
+	void end(Stage stage, double time);	/* A stage of the current frame ends. */
+	void frame_end(double time);	/* The current frame was submitted. */
+	uint num_frames() const;	/* Number of frames measured. */
+	double get(uint frame, int stage) const;	/* Duration of a stage (seconds); stage STAGES is the frame interval. */
+
+	bool write_json(FILE *f, const char *trace_path) const;	/* Write the summary and all frames as JSON. */
+	bool write_json(const char *path, const char *trace_path) const;	/* Write the summary and all frames to a JSON file. */
+protected:
+	/* Durations of a frame (the last entry is the time since the previous frame). */
+	typedef struct Frame {
+		double	duration[STAGES + 1];
+	} Frame;
+
+	std::vector<Frame>	frames;	/* Measured frames. */
+	Frame	current;	/* Frame being measured. */
+	double	stage_start[STAGES];	/* Start time of the stages of the current frame. */
+	double	last_frame_end;	/* Time of the previous frame_end() (0 if none). */
+};
+
+#endif /* __VR_TRACE_H__ */
@@ -0,0 +1,179 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_tracking_sampler.cpp
+*   \ingroup vr
+*
+* High-rate controller sampling on a dedicated thread.
+*/
+
+#include "vr_types.h"
+
+#include <chrono>
+#include <cstring>
+
+#include "vr_tracking_sampler.h"
+
+#include "PIL_time.h"
+
+VR_Tracking_Sampler::VR_Tracking_Sampler()
+	: seq_next(0)
+	, thread(0)
+	, running(false)
+	, poll(0)
+	, rate(default_rate)
+{
+	memset(ring, 0, sizeof(ring));
+}
+
+VR_Tracking_Sampler::~VR_Tracking_Sampler()
+{
+	stop();
+}
+
+bool VR_Tracking_Sampler::start(PollFunc poll, uint rate)
+{
+	if (thread || !poll || rate == 0) {
+		return false;
+	}
+	this->poll = poll;
+	this->rate = rate;
+	running = true;
+	thread = new std::thread(thread_proc, this);
+	return true;
+}
+
+void VR_Tracking_Sampler::stop()
+{
+	if (!thread) {
+		return;
+	}
+	running = false;
+	thread->join();
+	delete thread;
+	thread = 0;
+}
+
+bool VR_Tracking_Sampler::is_running() const
+{
+	return thread != 0;
+}
+
+bool VR_Tracking_Sampler::push(double time, const float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (seq_next > 0) {
+		const Sample& last = ring[(seq_next - 1) % ring_size];
+		if (memcmp(last.t_controller, t_controller, sizeof(last.t_controller)) == 0) {
+			return false;
+		}
+	}
+	Sample& sample = ring[seq_next % ring_size];
+	sample.time = time;
+	memcpy(sample.t_controller, t_controller, sizeof(sample.t_controller));
+	++seq_next;
+	return true;
+}
+
+ui64 VR_Tracking_Sampler::head() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return seq_next;
+}
+
+uint VR_Tracking_Sampler::read(ui64& seq, Sample *samples, uint max_samples) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	/* Samples older than the ring were overwritten. */
+	ui64 first = seq;
+	if (seq_next > ring_size && first < seq_next - ring_size) {
+		first = seq_next - ring_size;
+	}
+	uint count = 0;
+	if (first < seq_next) {
+		count = (seq_next - first < (ui64)max_samples) ? (uint)(seq_next - first) : max_samples;
+	}
+	for (uint i = 0; i < count; ++i) {
+		samples[i] = ring[(first + i) % ring_size];
+	}
+	seq = first + count;
+	return count;
+}
+
+void VR_Tracking_Sampler::clear()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	seq_next = 0;
+}
+
+uint VR_Tracking_Sampler::space_points(const Coord3Df *points, uint num_points, float spacing, float& travel, std::vector<Coord3Df>& r_points)
+{
+	if (spacing <= 0.0f) {
+		return 0;
+	}
+	uint count = 0;
+	for (uint i = 1; i < num_points; ++i) {
+		const Coord3Df d = points[i] - points[i - 1];
+		const float len = d.length();
+		if (len <= 0.0f) {
+			continue;
+		}
+		/* Distance along the segment of the next point. */
+		float pos = spacing - travel;
+		if (pos < 0.0f) {
+			pos = 0.0f;
+		}
+		while (pos <= len) {
+			r_points.push_back(points[i - 1] + d * (pos / len));
+			++count;
+			pos += spacing;
+		}
+		travel = len - (pos - spacing);
+	}
+	return count;
+}
+
+void VR_Tracking_Sampler::thread_proc(VR_Tracking_Sampler *sampler)
+{
+	const std::chrono::microseconds period(1000000 / sampler->rate);
+	std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+	float t_controller[VR_MAX_CONTROLLERS][4][4];
+
+	while (sampler->running) {
+		/* The backend leaves untracked controllers unchanged, so these are reported as zero
+		 * matrices (and compare equal between polls). */
+		memset(t_controller, 0, sizeof(t_controller));
+		if (sampler->poll(t_controller) == 0) {
+			sampler->push(PIL_check_seconds_timer(), t_controller);
+		}
+		next += period;
+		std::this_thread::sleep_until(next);
+		/* Don't try to catch up after the thread was suspended. */
+		const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		if (next < now) {
+			next = now;
+		}
+	}
+}
@@ -0,0 +1,92 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_tracking_sampler.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_TRACKING_SAMPLER_H__
+#define __VR_TRACKING_SAMPLER_H__
+
+#include "vr_types.h"
+#include "vr_main.h"
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+/* Timestamped ring of controller positions, sampled at a fixed rate on a dedicated thread.
+ * The sampling thread polls the VR backend (see vr_poll_controller_positions()) and appends a
+ * sample whenever a controller moved. Controllers that the backend doesn't track have zero
+ * matrices in the sample. The consumer (i.e. Widget_Sculpt, once per frame) reads all
+ * samples since its last read, so fast motions between two frames are not lost. */
+class VR_Tracking_Sampler
+{
+public:
+	/* Function to get the latest controller positions (real space). Returns 0 on success. */
+	typedef int (*PollFunc)(float t_controller[VR_MAX_CONTROLLERS][4][4]);
+
+	/* Tracking sample. */
+	typedef struct Sample {
+		double	time;	/* Time of the sample (seconds, see PIL_check_seconds_timer()). */
+		float	t_controller[VR_MAX_CONTROLLERS][4][4];	/* Controller positions (real space). */
+	} Sample;
+
+	static const uint ring_size = 1024;	/* Number of samples in the ring (about one second at the default rate). */
+	static const uint default_rate = 1000;	/* Default sampling rate (Hz). */
+
+	VR_Tracking_Sampler();	/* Constructor. */
+	~VR_Tracking_Sampler();	/* Destructor (stops the sampling thread). */
+
+	bool start(PollFunc poll, uint rate = default_rate);	/* Start the sampling thread. */
+	void stop();	/* Stop the sampling thread. */
+	bool is_running() const;	/* Whether the sampling thread is running. */
+
+	bool push(double time, const float t_controller[VR_MAX_CONTROLLERS][4][4]);	/* Append a sample (unless no controller moved). Returns whether the sample was appended. */
+	ui64 head() const;	/* Sequence number of the next sample (the read position of a consumer that is up to date). */
+	/* Get the samples after the read position seq (at most max_samples, the oldest ones if the ring
+	 * was overrun) and advance seq. Returns the number of samples. */
+	uint read(ui64& seq, Sample *samples, uint max_samples) const;
+	void clear();	/* Remove all samples. */
+
+	/* Place points (dabs) at regular distances along a polyline.
+	 * travel is the distance since the last dab (carried over from the previous polyline, which
+	 * ended at points[0]) and is updated. Returns the number of points appended to r_points. */
+	static uint space_points(const Coord3Df *points, uint num_points, float spacing, float& travel, std::vector<Coord3Df>& r_points);
+protected:
+	Sample	ring[ring_size];	/* Sample ring buffer. */
+	ui64	seq_next;	/* Sequence number of the next sample. */
+	mutable std::mutex	mutex;	/* Protects the ring and seq_next. */
+
+	std::thread	*thread;	/* The sampling thread (if running). */
+	std::atomic<bool>	running;	/* Whether the sampling thread should keep running. */
+	PollFunc	poll;	/* Function called by the sampling thread. */
+	uint	rate;	/* Sampling rate (Hz). */
+
+	static void thread_proc(VR_Tracking_Sampler *sampler);	/* Sampling thread function. */
+};
+
+#endif /* __VR_TRACKING_SAMPLER_H__ */
@@ -0,0 +1,146 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_transform_session.cpp
+*   \ingroup vr
+*
+* Edit-mode transformation of a set of vertices over a drag.
+*/
+
+#include "vr_types.h"
+
+#include "vr_transform_session.h"
+
+/* Number of points transformed per batch. */
+#define VR_TRANSFORM_SESSION_CHUNK	64
+/* Minimum number of points per thread. */
+#define VR_TRANSFORM_SESSION_GRAIN	4096
+
+VR_Transform_Session::VR_Transform_Session()
+	: owner(0)
+	, active(false)
+{
+	matrix.set_to_identity();
+}
+
+void VR_Transform_Session::begin(float *const *co, uint num_verts, const void *owner)
+{
+	verts.assign(co, co + num_verts);
+	orig_x.resize(num_verts);
+	orig_y.resize(num_verts);
+	orig_z.resize(num_verts);
+	for (uint i = 0; i < num_verts; ++i) {
+		orig_x[i] = co[i][0];
+		orig_y[i] = co[i][1];
+		orig_z[i] = co[i][2];
+	}
+	matrix.set_to_identity();
+	this->owner = owner;
+	active = true;
+}
+
+void VR_Transform_Session::end()
+{
+	verts.clear();
+	orig_x.clear();
+	orig_y.clear();
+	orig_z.clear();
+	owner = 0;
+	active = false;
+}
+
+bool VR_Transform_Session::is_active(const void *owner) const
+{
+	return active && (!owner || owner == this->owner);
+}
+
+uint VR_Transform_Session::size() const
+{
+	return (uint)verts.size();
+}
+
+void VR_Transform_Session::accumulate(const Mat44f& delta)
+{
+	Mat44d d;
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			d.m[i][j] = delta.m[i][j];
+		}
+	}
+	/* Row vectors: co * matrix * delta. */
+	matrix = matrix * d;
+}
+
+void VR_Transform_Session::set_matrix(const Mat44f& m)
+{
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			matrix.m[i][j] = m.m[i][j];
+		}
+	}
+}
+
+Mat44f VR_Transform_Session::get_matrix() const
+{
+	Mat44f m;
+	for (int i = 0; i < 4; ++i) {
+		for (int j = 0; j < 4; ++j) {
+			m.m[i][j] = (float)matrix.m[i][j];
+		}
+	}
+	return m;
+}
+
+void VR_Transform_Session::apply() const
+{
+	if (verts.empty()) {
+		return;
+	}
+	transform_points(&orig_x[0], &orig_y[0], &orig_z[0], (uint)verts.size(), get_matrix(), &verts[0]);
+}
+
+void VR_Transform_Session::transform_points(const float *x, const float *y, const float *z, uint num_points, const Mat44f& m, float *const *dst)
+{
+	const int num_chunks = (int)((num_points + VR_TRANSFORM_SESSION_CHUNK - 1) / VR_TRANSFORM_SESSION_CHUNK);
+#pragma omp parallel for schedule(static) if (num_points >= 2 * VR_TRANSFORM_SESSION_GRAIN)
+	for (int chunk = 0; chunk < num_chunks; ++chunk) {
+		const uint first = (uint)chunk * VR_TRANSFORM_SESSION_CHUNK;
+		const uint count = (num_points - first < VR_TRANSFORM_SESSION_CHUNK) ? num_points - first : VR_TRANSFORM_SESSION_CHUNK;
+		const float *cx = x + first, *cy = y + first, *cz = z + first;
+		float rx[VR_TRANSFORM_SESSION_CHUNK], ry[VR_TRANSFORM_SESSION_CHUNK], rz[VR_TRANSFORM_SESSION_CHUNK];
+		/* Separate arrays and no branches: vectorized by the compiler. */
+		for (uint j = 0; j < count; ++j) {
+			rx[j] = cx[j] * m.m[0][0] + cy[j] * m.m[1][0] + cz[j] * m.m[2][0] + m.m[3][0];
+			ry[j] = cx[j] * m.m[0][1] + cy[j] * m.m[1][1] + cz[j] * m.m[2][1] + m.m[3][1];
+			rz[j] = cx[j] * m.m[0][2] + cy[j] * m.m[1][2] + cz[j] * m.m[2][2] + m.m[3][2];
+		}
+		float *const *d = dst + first;
+		for (uint j = 0; j < count; ++j) {
+			d[j][0] = rx[j];
+			d[j][1] = ry[j];
+			d[j][2] = rz[j];
+		}
+	}
+}
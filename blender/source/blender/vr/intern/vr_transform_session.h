@@ -0,0 +1,71 @@
+/*
+* ***** BEGIN GPL LICENSE BLOCK *****
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* as published by the Free Software Foundation; either version 2
+* of the License, or (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program; if not, write to the Free Software Foundation,
+* Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+*
+* The Original Code is Copyright (C) 2019 by Blender Foundation.
+* All rights reserved.
+*
+* Contributor(s): MARUI-PlugIn, Multiplexed Reality
+*
+* ***** END GPL LICENSE BLOCK *****
+*/
+
+/** \file blender/vr/intern/vr_transform_session.h
+*   \ingroup vr
+*/
+
+#ifndef __VR_TRANSFORM_SESSION_H__
+#define __VR_TRANSFORM_SESSION_H__
+
+#include "vr_types.h"
+
+#include <vector>
+
+/* Edit-mode transformation of a set of vertices over a drag (see Widget_Transform).
+ * The unique vertices of the selection and their original coordinates are cached on begin(), and
+ * the relative transformation of each frame is accumulated (in double precision) into an absolute
+ * one. apply() then writes the original coordinates transformed by the absolute transformation,
+ * so a frame only touches the transformed vertices, a vertex shared by several selected elements
+ * is transformed once, and rounding errors don't build up over a long drag. */
+class VR_Transform_Session
+{
+public:
+	VR_Transform_Session();	/* Constructor. */
+
+	void begin(float *const *co, uint num_verts, const void *owner = 0);	/* Start a session for a set of vertex coordinates (object space, as BMVert::co). */
+	void end();	/* End the session (the vertices keep their current coordinates). */
+	bool is_active(const void *owner = 0) const;	/* Whether a session (for the given owner, i.e. BMesh) is active. */
+	uint size() const;	/* Number of vertices of the session. */
+
+	void accumulate(const Mat44f& delta);	/* Add a relative transformation (applied after the current one). */
+	void set_matrix(const Mat44f& m);	/* Set the absolute transformation (relative to the original coordinates). */
+	Mat44f get_matrix() const;	/* Get the absolute transformation. */
+	void apply() const;	/* Write the transformed original coordinates to the vertices. */
+
+	/* Transform points given as separate x / y / z arrays by m (row-vector convention, as Mat44f)
+	 * and write them to dst. */
+	static void transform_points(const float *x, const float *y, const float *z, uint num_points, const Mat44f& m, float *const *dst);
+protected:
+	std::vector<float*>	verts;	/* Vertex coordinates written by apply(). */
+	std::vector<float>	orig_x;	/* Original x coordinates. */
+	std::vector<float>	orig_y;	/* Original y coordinates. */
+	std::vector<float>	orig_z;	/* Original z coordinates. */
+	Mat44d	matrix;	/* Absolute transformation. */
+	const void	*owner;	/* Owner of the vertices (to detect a changed mesh). */
+	bool	active;	/* Whether a session is active. */
+};
+
+#endif /* __VR_TRANSFORM_SESSION_H__ */
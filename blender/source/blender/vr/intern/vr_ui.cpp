@@ -37,14 +37,18 @@
 #include "vr_widget_transform.h"
 #include "vr_widget_navi.h"
 #include "vr_widget_animation.h"
+#include "vr_widget_annotate.h"
+#include "vr_widget_select.h"
 
 #include "vr_ui.h"
 
 #include "vr_layout.h"
 
 #include "vr_math.h"
+#include "vr_mesh_bvh.h"
 #include "vr_draw.h"
 #include "vr_network.h"
+#include "vr_pose_predict.h"
 
 #ifdef WIN32
 #include "BLI_winstuff.h"
@@ -54,6 +58,8 @@
 
 #include "BLI_math.h"
 
+#include "BKE_global.h"
+
 #include "DNA_vec_types.h"
 
 #include "DRW_engine.h"
@@ -70,6 +76,8 @@
 
 #include "MEM_guardedalloc.h"
 
+#include "PIL_time.h"
+
 #include "WM_types.h"
 #include "wm_window.h"
 
@@ -78,9 +86,17 @@
 /* Externed from vr_types.h. */
 ui64 VR_t_now(0);	/* Current (most recent) timestamp. This will be updated (1) when updating tracking (2) when starting rendering a new frame (3) before executing UI operations. */
 
+/* Clock of replayed sessions (see vr_api_set_replay_time()). */
+static bool replay_clock(false);
+static ui64 replay_clock_start(0);
+static ui64 replay_clock_now(0);
+
 /* Get the current timestamp in ms (system dependent). */
 static ui64 currentSystemTime()
 {
+	if (replay_clock) {
+		return replay_clock_now;
+	}
 #ifdef WIN32
 	SYSTEMTIME t;
 	GetSystemTime(&t);
@@ -808,6 +824,15 @@ VR_UI::Error VR_UI::shutdown()
 	/* Unbind any object bindings. */
 	Widget_Animation::clear_bindings();
 
+	/* Free the cached edit-mesh trees. */
+	VR_Mesh_BVH::clear();
+
+	/* Free the edit-mesh selection indices. */
+	Widget_Select::clear_index();
+
+	/* Free the geometry of the annotation stroke being drawn. */
+	Widget_Annotate::release();
+
 	/* If we have a UI implementation object, delete it. */
 	if (VR_UI::ui) {
 		delete VR_UI::ui;
@@ -1602,44 +1627,60 @@ VR_UI::Error VR_UI::execute_post_render_operations()
 {
 	if (VR_UI::ui_type == VR_DEVICE_TYPE_MAGICLEAP) {
 		/* Get viewport bitmap and send to client. */
+		/* Limit the capture rate to the stream frame rate. */
+		static double last_capture_time = 0.0;
+		const double time = PIL_check_seconds_timer();
 		if (VR_Network::network_status == VR_Network::NETWORKSTATUS_CONNECTED &&
-			!VR_Network::data_new) {
+			(time - last_capture_time) >= 1.0 / (double)VR_Network::stream_fps) {
+			last_capture_time = time;
 #if VR_NETWORK_IMAGE_STREAMING
-			for (int i = 0; i < VR_SIDES; ++i) {
-				GPUViewport *viewport = vr_get_obj()->viewport[i];
-				if (viewport) {
-					GPUTexture *color_tex = NULL;
-					GPUTexture *depth_tex = NULL;
-					DefaultFramebufferList *dfbl = viewport->fbl;
-					if (dfbl->default_fb) {
-						DefaultTextureList *dtxl = viewport->txl;
-						color_tex = dtxl->color;
-						depth_tex = dtxl->depth;
-					}
-					if (color_tex && depth_tex) {
-						uchar *color_data = (uchar*)GPU_texture_read(color_tex, GPU_DATA_UNSIGNED_BYTE, 0);
-						uint *depth_data = (uint*)GPU_texture_read(depth_tex, GPU_DATA_UNSIGNED_INT_24_8, 0);
-						if (color_data && depth_data) {
-							/* Resample */
-							/* TODO_XR: Do this on image processing thread. */
-							VR_Network::ImageData& data = VR_Network::image_data[i];
-							VR_Network::resample_pixels(color_data, color_tex->w, color_tex->h,
-								data.buf, data.w, data.h, data.d,
-								depth_data);
-
-							VR_Network::data_new = true;
-						}
-						if (color_data) {
-							MEM_freeN(color_data);
+			VR_Network::update_stream_params();
+			/* Capture into a free slot of the frame ring (never blocks). */
+			VR_Network_FrameRing::Slot *slot = VR_Network::frame_ring.acquire_capture();
+			if (slot) {
+				slot->time_capture = time;
+				slot->resize(VR_Network::stream_width, VR_Network::stream_height, VR_Network::stream_depth);
+				int captured = 0;
+				for (int i = 0; i < VR_SIDES; ++i) {
+					GPUViewport *viewport = vr_get_obj()->viewport[i];
+					if (viewport) {
+						GPUTexture *color_tex = NULL;
+						GPUTexture *depth_tex = NULL;
+						DefaultFramebufferList *dfbl = viewport->fbl;
+						if (dfbl->default_fb) {
+							DefaultTextureList *dtxl = viewport->txl;
+							color_tex = dtxl->color;
+							depth_tex = dtxl->depth;
 						}
-						if (depth_data) {
-							MEM_freeN(depth_data);
+						if (color_tex && depth_tex) {
+							uchar *color_data = (uchar*)GPU_texture_read(color_tex, GPU_DATA_UNSIGNED_BYTE, 0);
+							uint *depth_data = (uint*)GPU_texture_read(depth_tex, GPU_DATA_UNSIGNED_INT_24_8, 0);
+							if (color_data && depth_data) {
+								/* Resample */
+								/* TODO_XR: Do this on image processing thread. */
+								if (VR_Network::resample_pixels(color_data, color_tex->w, color_tex->h,
+									&slot->pixels[i][0], slot->w, slot->h, slot->d,
+									depth_data)) {
+									++captured;
+								}
+							}
+							if (color_data) {
+								MEM_freeN(color_data);
+							}
+							if (depth_data) {
+								MEM_freeN(depth_data);
+							}
 						}
 					}
 				}
+				if (captured == VR_SIDES) {
+					slot->time_captured = PIL_check_seconds_timer();
+					VR_Network::frame_ring.publish_capture(slot);
+				}
+				else {
+					VR_Network::frame_ring.cancel_capture(slot);
+				}
 			}
-#else
-			VR_Network::data_new = true;
 #endif
 		}
 	}
@@ -1647,6 +1688,8 @@ VR_UI::Error VR_UI::execute_post_render_operations()
 	if (editmode_exit) {
 		ED_object_editmode_exit(vr_get_obj()->ctx, EM_FREEDATA);
 		editmode_exit = false;
+		/* The edit-mesh is freed: drop its selection indices. */
+		Widget_Select::clear_index();
 		/* Update manipulators */
 		Widget_Transform::update_manipulator();
 		ED_undo_push(vr_get_obj()->ctx, "Selectmode");
@@ -1695,7 +1738,9 @@ VR_UI::Error VR_UI::post_render(VR_Side side)
 							*(Coord3Df*)(t_controller.m[3]) + Coord3Df(-1, -1, -1) * 0.02f);
 
 		const Mat44f& t_hmd = VR_UI::hmd_position_get(VR_SPACE_REAL);
+		VR_Draw::begin_batch();
 		VR_UI::render_widget_icons(VR_SIDE_MONO, t_hmd);
+		VR_Draw::end_batch();
 	}
 	else {
 		/* Create controllers if they haven't already been created. */
@@ -1873,8 +1918,11 @@ VR_UI::Error VR_UI::render_controller(VR_Side controller_side)
 			break;
 		}
 		}
+		/* Widget icons and pie menus are drawn in a single batch. */
+		VR_Draw::begin_batch();
 		render_widget_icons(VR_SIDE_LEFT, t_controller_left);
 		render_widget_icons(VR_SIDE_RIGHT, t_controller_right);
+		VR_Draw::end_batch();
 
 		return ERROR_NONE;
 	}
@@ -1934,7 +1982,9 @@ VR_UI::Error VR_UI::render_controller(VR_Side controller_side)
 	VR_Draw::render_rect(-0.005f, 0.005f, 0.005f, -0.005f, 0.001f, 1.0f, 1.0f, VR_Draw::cursor_tex);
 	VR_Draw::set_depth_test(true, true);
 	
+	VR_Draw::begin_batch();
 	render_widget_icons(controller_side, t_controller);
+	VR_Draw::end_batch();
 
 	return ERROR_NONE;
 }
@@ -2178,6 +2228,8 @@ VR_UI::Error VR_UI::render_menus(const Mat44f *_model, const Mat44f *_view)
 		VR_Draw::update_modelview_matrix(_model, _view);
 	}
 
+	VR_Draw::begin_batch();
+
 	/* Background */
 	VR_Draw::set_color(0.2f, 0.2f, 0.2f, 1.0f);
 	VR_Draw::set_blend(false);
@@ -2198,6 +2250,38 @@ VR_UI::Error VR_UI::render_menus(const Mat44f *_model, const Mat44f *_view)
 	}
 	VR_Draw::render_string(fps_str.c_str(), 0.03f, 0.03f, VR_HALIGN_CENTER, VR_VALIGN_TOP, 0.0f, 0.18f, 0.001f);
 
+	/* Remote streaming latency (capture / encode / send, in ms) */
+	if (VR_Network::network_status == VR_Network::NETWORKSTATUS_CONNECTED) {
+		static std::string latency_str;
+		if (counter == 0 || latency_str.empty()) {
+			const VR_Network::Latency& l = VR_Network::latency;
+			char buf[64];
+			sprintf(buf, "%.1f / %.1f / %.1f (%.1f)", l.capture, l.encode, l.send, l.total);
+			latency_str = buf;
+		}
+		VR_Draw::render_string(latency_str.c_str(), 0.015f, 0.015f, VR_HALIGN_CENTER, VR_VALIGN_TOP, 0.0f, 0.12f, 0.001f);
+	}
+
+	/* Pie menu display list rebuilds / replays per second (--debug only) */
+	if (G.debug & G_DEBUG) {
+		static ui64 menu_list_time = VR_t_now;
+		static VR_Draw_List::Stats menu_list_prev = { 0 };
+		static std::string menu_list_str;
+		if (VR_t_now - menu_list_time >= 1000 || menu_list_str.empty()) {
+			VR_Draw_List::Stats stats;
+			Widget_Menu::get_list_stats(stats);
+			const double dt = (VR_t_now > menu_list_time) ? (double)(VR_t_now - menu_list_time) / 1000.0 : 1.0;
+			char buf[64];
+			sprintf(buf, "menu %.0f rebuilds/s %.0f replays/s", (stats.rebuilds - menu_list_prev.rebuilds) / dt, (stats.replays - menu_list_prev.replays) / dt);
+			menu_list_str = buf;
+			menu_list_prev = stats;
+			menu_list_time = VR_t_now;
+		}
+		VR_Draw::render_string(menu_list_str.c_str(), 0.01f, 0.012f, VR_HALIGN_CENTER, VR_VALIGN_TOP, 0.0f, 0.09f, 0.001f);
+	}
+
+	VR_Draw::end_batch();
+
 	return ERROR_NONE;
 }
 
@@ -2252,6 +2336,22 @@ int vr_api_update_tracking_ui()
 	return 0;
 }
 
+/* Drive the UI clock from the timestamps of a replayed session. */
+int vr_api_set_replay_time(double time)
+{
+	if (time < 0.0) {
+		replay_clock = false;
+		return 0;
+	}
+	if (!replay_clock) {
+		/* Start a second after the last update, so the first replayed frame is never throttled. */
+		replay_clock_start = VR_t_now + 1000;
+		replay_clock = true;
+	}
+	replay_clock_now = replay_clock_start + (ui64)(time * 1000.0);
+	return 0;
+}
+
 /* Execute UI operations. */
 int vr_api_execute_operations()
 {
@@ -2327,3 +2427,69 @@ int vr_api_uninit_ui()
 	VR_UI::shutdown();
 	return 0;
 }
+
+static VR_Pose_Predictor vr_predict_hmd;
+static VR_Pose_Predictor vr_predict_eye[VR_SIDES];
+static VR_Pose_Predictor vr_predict_controller[VR_MAX_CONTROLLERS];
+static VR_Latency_Estimator vr_predict_latency;
+
+/* Add the tracking matrices (real space) as samples and predict them to the display time. */
+int vr_api_predict_tracking(double time)
+{
+	VR *vr = vr_get_obj();
+
+	vr_predict_latency.mark(VR_Latency_Estimator::STAGE_TRACKING, time);
+	const double target = vr_predict_latency.predict_submit(VR_Latency_Estimator::STAGE_TRACKING, time);
+
+	vr_predict_hmd.push(time, vr->t_hmd[VR_SPACE_REAL]);
+	vr_predict_hmd.predict(target, vr->t_hmd[VR_SPACE_REAL]);
+	for (int i = 0; i < VR_SIDES; ++i) {
+		vr_predict_eye[i].push(time, vr->t_eye[VR_SPACE_REAL][i]);
+		vr_predict_eye[i].predict(target, vr->t_eye[VR_SPACE_REAL][i]);
+	}
+	for (int i = 0; i < VR_MAX_CONTROLLERS; ++i) {
+		vr_predict_controller[i].push(time, vr->t_controller[VR_SPACE_REAL][i]);
+		vr_predict_controller[i].predict(target, vr->t_controller[VR_SPACE_REAL][i]);
+	}
+
+	return 0;
+}
+
+/* Predict an eye matrix (real space) again, right before the eye is drawn. */
+int vr_api_predict_eye(int side, double time)
+{
+	if (side != VR_SIDE_LEFT && side != VR_SIDE_RIGHT) {
+		return -1;
+	}
+	VR *vr = vr_get_obj();
+
+	const VR_Latency_Estimator::Stage stage = (side == VR_SIDE_LEFT) ? VR_Latency_Estimator::STAGE_EYE_LEFT : VR_Latency_Estimator::STAGE_EYE_RIGHT;
+	vr_predict_latency.mark(stage, time);
+	if (!vr_predict_eye[side].predict(vr_predict_latency.predict_submit(stage, time), vr->t_eye[VR_SPACE_REAL][side])) {
+		return -1;
+	}
+	invert_m4_m4(vr->t_eye_inv[VR_SPACE_REAL][side], vr->t_eye[VR_SPACE_REAL][side]);
+
+	return 0;
+}
+
+/* The frame was submitted to the VR device. */
+int vr_api_predict_submit(double time)
+{
+	vr_predict_latency.submit(time);
+	return 0;
+}
+
+/* Discard all samples and measurements. */
+int vr_api_predict_reset()
+{
+	vr_predict_hmd.reset();
+	for (int i = 0; i < VR_SIDES; ++i) {
+		vr_predict_eye[i].reset();
+	}
+	for (int i = 0; i < VR_MAX_CONTROLLERS; ++i) {
+		vr_predict_controller[i].reset();
+	}
+	vr_predict_latency.reset();
+	return 0;
+}
@@ -33,6 +33,7 @@
 
 #include "vr_main.h"
 #include "vr_math.h"
+#include "vr_mesh_bvh.h"
 #include "vr_ui.h"
 #include "vr_util.h"
 
@@ -168,46 +169,34 @@ void VR_Util::deselectall_edit(BMesh *bm, int mode)
 	}
 }
 
-/* Adapted from view3d_select.c */
-void VR_Util::raycast_select_single_vertex(const Coord3Df& p, ViewContext *vc, bool extend, bool deselect)
+/* Find the edit-mesh element nearest to the projection of p in the view of the dominant eye
+ * (using the BVH tree of the edit mesh, see VR_Mesh_BVH). */
+static BMElem *raycast_find_nearest_edit(const Coord3Df& p, ViewContext *vc, VR_Mesh_BVH::NearestType type)
 {
 	/* TODO_XR: Use rv3d->persmat of dominant eye. */
 	bContext *C = vr_get_obj()->ctx;
 	ARegion *ar = CTX_wm_region(C);
 	RegionView3D *rv3d = (RegionView3D*)ar->regiondata;
-	float dist = ED_view3d_select_dist_px() * 1.3333f;
+	/* Manhattan distance, at most 90% of the select distance (as when scanning all elements with a 10% bias). */
+	float dist = ED_view3d_select_dist_px() * 1.2f;
 	int mval[2];
 	VR_Side side = VR_UI::eye_dominance_get();
 	VR_UI::get_pixel_coordinates(p, mval[0], mval[1], side);
-	const float mval_fl[2] = { (float)mval[0], (float)mval[1] };
-	float screen_co[2];
-	bool is_inside = false;
 
-	BM_mesh_elem_table_ensure(vc->em->bm, BM_VERT);
-	BMVert *sv = NULL;
+	VR *vr = vr_get_obj();
+	const float winsize[2] = { (float)vr->tex_width, (float)vr->tex_height };
+	/* From the bottom left. */
+	const float mval_fl[2] = { (float)mval[0], winsize[1] - (float)mval[1] };
 
-	const Mat44f& offset = *(Mat44f*)vc->obedit->obmat;
-	static Coord3Df pos;
-	BMVert *v;
-	BMIter iter;
-	BMesh *bm = vc->em->bm;
-	BM_ITER_MESH(v, &iter, bm, BM_VERTS_OF_MESH) {
-		if (!BM_elem_flag_test(v, BM_ELEM_HIDDEN)) {
-			VR_Math::multiply_mat44_coord3D(pos, offset, *(Coord3Df*)v->co);
-			if (view3d_project(
-				ar, rv3d->persmat, false, (float*)&pos, screen_co,
-				(eV3DProjTest)(V3D_PROJ_TEST_CLIP_BB | V3D_PROJ_TEST_CLIP_NEAR)) == V3D_PROJ_RET_OK)
-			{
-				float dist_temp = len_manhattan_v2v2(mval_fl, screen_co);
-				dist_temp += (dist * 0.1f); //10.0f
-				if (dist_temp < dist) {
-					dist = dist_temp;
-					sv = v;
-					is_inside = true;
-				}
-			}
-		}
-	}
+	return VR_Mesh_BVH::find_nearest(vc->em, vc->obedit, rv3d, winsize, mval_fl, type, false, &dist);
+}
+
+/* Adapted from view3d_select.c */
+void VR_Util::raycast_select_single_vertex(const Coord3Df& p, ViewContext *vc, bool extend, bool deselect)
+{
+	bContext *C = vr_get_obj()->ctx;
+	BMVert *sv = (BMVert*)raycast_find_nearest_edit(p, vc, VR_Mesh_BVH::NEAREST_VERT);
+	const bool is_inside = (sv != NULL);
 
 	if (is_inside && sv) {
 		const bool is_select = BM_elem_flag_test(sv, BM_ELEM_SELECT);
@@ -220,7 +209,7 @@ void VR_Util::raycast_select_single_vertex(const Coord3Df& p, ViewContext *vc, b
 
 			DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 			WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-			ED_undo_push(C, "Select");
+			ED_mesh_undo_push_select(C, "Select");
 		}
 	}
 	else {
@@ -230,52 +219,16 @@ void VR_Util::raycast_select_single_vertex(const Coord3Df& p, ViewContext *vc, b
 
 			DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 			WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-			ED_undo_push(C, "Select");
+			ED_mesh_undo_push_select(C, "Select");
 		}
 	}
 }
 
 void VR_Util::raycast_select_single_edge(const Coord3Df& p, ViewContext *vc, bool extend, bool deselect)
 {
-	/* TODO_XR: Use rv3d->persmat of dominant eye. */
 	bContext *C = vr_get_obj()->ctx;
-	ARegion *ar = CTX_wm_region(C);
-	RegionView3D *rv3d = (RegionView3D*)ar->regiondata;
-	float dist = ED_view3d_select_dist_px() * 1.3333f;
-	int mval[2];
-	VR_Side side = VR_UI::eye_dominance_get();
-	VR_UI::get_pixel_coordinates(p, mval[0], mval[1], side);
-	const float mval_fl[2] = { (float)mval[0], (float)mval[1] };
-	float screen_co[2];
-	float med_co[3];
-	bool is_inside = false;
-
-	BM_mesh_elem_table_ensure(vc->em->bm, BM_EDGE);
-	BMEdge *se = NULL;
-
-	const Mat44f& offset = *(Mat44f*)vc->obedit->obmat;
-	static Coord3Df pos;
-	BMEdge *e;
-	BMIter iter;
-	BMesh *bm = vc->em->bm;
-	BM_ITER_MESH(e, &iter, bm, BM_EDGES_OF_MESH) {
-		if (!BM_elem_flag_test(e, BM_ELEM_HIDDEN)) {
-			*(Coord3Df*)med_co = (*(Coord3Df*)e->v1->co + *(Coord3Df*)e->v2->co) / 2.0f;
-			VR_Math::multiply_mat44_coord3D(pos, offset, *(Coord3Df*)med_co);
-			if (view3d_project(
-				ar, rv3d->persmat, false, (float*)&pos, screen_co,
-				(eV3DProjTest)(V3D_PROJ_TEST_CLIP_BB | V3D_PROJ_TEST_CLIP_NEAR)) == V3D_PROJ_RET_OK)
-			{
-				float dist_temp = len_manhattan_v2v2(mval_fl, screen_co);
-				dist_temp += (dist * 0.1f); //10.0f
-				if (dist_temp < dist) {
-					dist = dist_temp;
-					se = e;
-					is_inside = true;
-				}
-			}
-		}
-	}
+	BMEdge *se = (BMEdge*)raycast_find_nearest_edit(p, vc, VR_Mesh_BVH::NEAREST_EDGE_CENTER);
+	const bool is_inside = (se != NULL);
 
 	if (is_inside && se) {
 		const bool is_select = BM_elem_flag_test(se, BM_ELEM_SELECT);
@@ -288,7 +241,7 @@ void VR_Util::raycast_select_single_edge(const Coord3Df& p, ViewContext *vc, boo
 
 			DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 			WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-			ED_undo_push(C, "Select");
+			ED_mesh_undo_push_select(C, "Select");
 		}
 	}
 	else {
@@ -298,58 +251,16 @@ void VR_Util::raycast_select_single_edge(const Coord3Df& p, ViewContext *vc, boo
 
 			DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 			WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-			ED_undo_push(C, "Select");
+			ED_mesh_undo_push_select(C, "Select");
 		}
 	}
 }
 
 void VR_Util::raycast_select_single_face(const Coord3Df& p, ViewContext *vc, bool extend, bool deselect)
 {
-	/* TODO_XR: Use rv3d->persmat of dominant eye. */
 	bContext *C = vr_get_obj()->ctx;
-	ARegion *ar = CTX_wm_region(C);
-	RegionView3D *rv3d = (RegionView3D*)ar->regiondata;
-	float dist = ED_view3d_select_dist_px() * 1.3333f;
-	int mval[2];
-	VR_Side side = VR_UI::eye_dominance_get();
-	VR_UI::get_pixel_coordinates(p, mval[0], mval[1], side);
-	const float mval_fl[2] = { (float)mval[0], (float)mval[1] };
-	float screen_co[2];
-	bool is_inside = false;
-
-	BM_mesh_elem_table_ensure(vc->em->bm, BM_FACE);
-	BMFace *sf = NULL;
-
-	const Mat44f& offset = *(Mat44f*)vc->obedit->obmat;
-	static Coord3Df pos;
-	static Coord3Df cent;
-	BMFace *f;
-	BMLoop *l;
-	BMIter iter;
-	BMesh *bm = vc->em->bm;
-	BM_ITER_MESH(f, &iter, bm, BM_FACES_OF_MESH) {
-		l = f->l_first;
-		memset(&cent, 0, sizeof(float) * 3);
-		for (int i = 0; i < f->len; ++i, l = l->next) {
-			cent += *(Coord3Df*)l->v->co;
-		}
-		cent /= f->len;
-		if (!BM_elem_flag_test(f, BM_ELEM_HIDDEN)) {
-			VR_Math::multiply_mat44_coord3D(pos, offset, cent);
-			if (view3d_project(
-				ar, rv3d->persmat, false, (float*)&pos, screen_co,
-				(eV3DProjTest)(V3D_PROJ_TEST_CLIP_BB | V3D_PROJ_TEST_CLIP_NEAR)) == V3D_PROJ_RET_OK)
-			{
-				float dist_temp = len_manhattan_v2v2(mval_fl, screen_co);
-				dist_temp += (dist * 0.1f); //10.0f
-				if (dist_temp < dist) {
-					dist = dist_temp;
-					sf = f;
-					is_inside = true;
-				}
-			}
-		}
-	}
+	BMFace *sf = (BMFace*)raycast_find_nearest_edit(p, vc, VR_Mesh_BVH::NEAREST_FACE_CENTER);
+	const bool is_inside = (sf != NULL);
 
 	if (is_inside && sf) {
 		const bool is_select = BM_elem_flag_test(sf, BM_ELEM_SELECT);
@@ -362,7 +273,7 @@ void VR_Util::raycast_select_single_face(const Coord3Df& p, ViewContext *vc, boo
 
 			DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 			WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-			ED_undo_push(C, "Select");
+			ED_mesh_undo_push_select(C, "Select");
 		}
 	}
 	else {
@@ -372,7 +283,7 @@ void VR_Util::raycast_select_single_face(const Coord3Df& p, ViewContext *vc, boo
 
 			DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 			WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-			ED_undo_push(C, "Select");
+			ED_mesh_undo_push_select(C, "Select");
 		}
 	}
 }
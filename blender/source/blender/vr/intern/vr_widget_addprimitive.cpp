@@ -35,6 +35,7 @@
 #include "vr_ui.h"
 
 #include "vr_widget_addprimitive.h"
+#include "vr_widget_select.h"
 #include "vr_widget_transform.h"
 
 #include "vr_math.h"
@@ -129,6 +130,7 @@ static void make_prim_finish(bContext *C, Object *obedit, const MakePrimitiveDat
 	/* userdef */
 	if (exit_editmode) {
 		ED_object_editmode_exit(C, EM_FREEDATA);
+		Widget_Select::clear_index();
 	}
 	WM_event_add_notifier(C, NC_OBJECT | ND_DRAW, obedit);
 }
@@ -49,9 +49,101 @@
 
 #include "gpencil_intern.h"
 
-#include "GPU_immediate.h"
+#include "GPU_glew.h"
+#include "GPU_matrix.h"
+#include "GPU_shader.h"
 #include "GPU_state.h"
 
+/* OpenGL backend of the current stroke geometry.
+ * Draws with the builtin uniform color shader and the current matrices, like the immediate mode
+ * drawing of annotations, but from a vertex buffer that is only appended to. */
+class Widget_Annotate::StrokeBackend : public VR_Draw_Stroke::Backend, public VR_Draw::BufferBackend
+{
+public:
+	StrokeBackend();	/* Constructor. */
+	virtual ~StrokeBackend();	/* Destructor. */
+
+	virtual bool reserve(uint capacity, uint num_keep);	/* (Re)allocate the buffer for capacity points, keeping its first num_keep points. */
+	virtual void upload(uint first, const Coord3Df *points, uint num_points);	/* Upload points into the allocated buffer. */
+	virtual bool begin(const float color[4]);	/* Set up the common state. */
+	virtual void draw(const int *first, const int *count, uint num_strips, float width);	/* Draw line strips of the same width. */
+	virtual void end();	/* Restore the state saved in begin(). */
+
+	void release();	/* Release the OpenGL objects. */
+protected:
+	GLuint	buffer;	/* Vertex buffer. */
+};
+
+Widget_Annotate::StrokeBackend::StrokeBackend()
+	: BufferBackend(sizeof(Coord3Df)), buffer(0)
+{
+	//
+}
+
+Widget_Annotate::StrokeBackend::~StrokeBackend()
+{
+	//
+}
+
+bool Widget_Annotate::StrokeBackend::reserve(uint capacity, uint num_keep)
+{
+	const GLuint new_buffer = this->grow_buffer(this->buffer, capacity, num_keep);
+	if (!new_buffer) {
+		release();
+		return false;
+	}
+	this->buffer = new_buffer;
+	return true;
+}
+
+void Widget_Annotate::StrokeBackend::upload(uint first, const Coord3Df *points, uint num_points)
+{
+	this->update_buffer(this->buffer, first, points, num_points);
+}
+
+bool Widget_Annotate::StrokeBackend::begin(const float color[4])
+{
+	GPUShader *shader = GPU_shader_get_builtin_shader(GPU_SHADER_3D_UNIFORM_COLOR);
+	const int pos = GPU_shader_get_attribute(shader, "pos");
+	if (!this->buffer || pos < 0) {
+		return false;
+	}
+
+	this->save_state(false);
+
+	GPU_shader_bind(shader);
+	GPU_matrix_bind((const GPUShaderInterface *)GPU_shader_get_interface(shader));
+	GPU_shader_uniform_vector(shader, GPU_shader_get_uniform_ensure(shader, "color"), 4, 1, color);
+
+	const Attribute attribute = { pos, 3, 0 };
+	this->set_layout(&attribute, 1);
+	if (!this->bind_buffer(this->buffer)) {
+		this->restore_state();
+		return false;
+	}
+	return true;
+}
+
+void Widget_Annotate::StrokeBackend::draw(const int *first, const int *count, uint num_strips, float width)
+{
+	GPU_line_width(width);
+	glMultiDrawArrays(GL_LINE_STRIP, first, count, num_strips);
+}
+
+void Widget_Annotate::StrokeBackend::end()
+{
+	/* Restore previous OpenGL state */
+	this->restore_state();
+	GPU_shader_unbind();
+	GPU_line_width(1.0f);
+}
+
+void Widget_Annotate::StrokeBackend::release()
+{
+	this->release_buffers();
+	this->buffer = 0;
+}
+
 /***************************************************************************************************
  * \class                               Widget_Annotate
  ***************************************************************************************************
@@ -68,6 +160,9 @@ Main *Widget_Annotate::main(0);
 uint Widget_Annotate::active_layer(0);
 
 std::vector<bGPDspoint> Widget_Annotate::points;
+Widget_Annotate::StrokeBackend *Widget_Annotate::stroke_backend(0);
+VR_Draw_Stroke Widget_Annotate::stroke;
+float Widget_Annotate::simplify_tolerance(0.0005f);
 
 //float Widget_Annotate::point_thickness(40.0f);
 float Widget_Annotate::line_thickness(10.0f);
@@ -219,9 +314,9 @@ void Widget_Annotate::erase_stroke(bGPDstroke *gps, bGPDframe *gp_frame) {
 	} 
 }
 
-void Widget_Annotate::add_stroke(const std::vector<bGPDspoint>& pts, uint layer, bool set_active)
+void Widget_Annotate::add_stroke(const std::vector<bGPDspoint>& pts, uint layer, bool set_active, const std::vector<uint> *keep)
 {
-	int tot_points = pts.size();
+	int tot_points = keep ? keep->size() : pts.size();
 	if (tot_points < 1) {
 		return;
 	}
@@ -237,7 +332,14 @@ void Widget_Annotate::add_stroke(const std::vector<bGPDspoint>& pts, uint layer,
 	}
 
 	bGPDstroke *gps = BKE_gpencil_add_stroke(gpf[layer], 0, tot_points, line_thickness);
-	memcpy(gps->points, &pts[0], sizeof(bGPDspoint) * tot_points);
+	if (keep) {
+		for (int i = 0; i < tot_points; ++i) {
+			gps->points[i] = pts[(*keep)[i]];
+		}
+	}
+	else {
+		memcpy(gps->points, &pts[0], sizeof(bGPDspoint) * tot_points);
+	}
 
 	if (set_active) {
 		BKE_gpencil_layer_setactive(Widget_Annotate::gpd, Widget_Annotate::gpl[layer]);
@@ -334,6 +436,8 @@ void Widget_Annotate::drag_start(VR_UI::Cursor& c)
 		eraser = false;
 
 		points.clear();
+		stroke.clear();
+		stroke.set_thickness(line_thickness);
 
 		bGPDspoint pt;
 
@@ -345,6 +449,7 @@ void Widget_Annotate::drag_start(VR_UI::Cursor& c)
 		//pt.flag = GP_SPOINT_SELECT;
 
 		points.push_back(pt);
+		stroke.add(&pt.x, pt.pressure);
 	}
 
 	for (int i = 0; i < VR_SIDES; ++i) {
@@ -382,6 +487,7 @@ void Widget_Annotate::drag_contd(VR_UI::Cursor& c)
 		//pt.flag = GP_SPOINT_SELECT;
 
 		points.push_back(pt);
+		stroke.add(&pt.x, pt.pressure);
 	}
 
 	for (int i = 0; i < VR_SIDES; ++i) {
@@ -408,98 +514,39 @@ void Widget_Annotate::drag_stop(VR_UI::Cursor& c)
 	/* TODO_XR: Find a way to "coexist" with any existing scene gpd. */
 	//BKE_gpencil_layer_setactive(gpd, gpl);
 
-	/* Add new stroke */
-	Widget_Annotate::add_stroke(points, active_layer, true);
+	/* Add new stroke (simplified, the points were sampled every frame). */
+	if (simplify_tolerance > 0.0f) {
+		std::vector<uint> keep;
+		stroke.simplify(simplify_tolerance * VR_UI::navigation_scale_get(), keep);
+		Widget_Annotate::add_stroke(points, active_layer, true, &keep);
+	}
+	else {
+		Widget_Annotate::add_stroke(points, active_layer, true);
+	}
 
 	for (int i = 0; i < VR_SIDES; ++i) {
 		Widget_Annotate::obj.do_render[i] = false;
 	}
 }
 
-void Widget_Annotate::render_points(const std::vector<bGPDspoint>& pts, uint layer)
+void Widget_Annotate::render_stroke(uint layer)
 {
-	/* Adapted from gp_draw_stroke_3d() in annotate_draw.c. */
-
-	int tot_points = pts.size();
-
-	if (tot_points <= 1) {
-		/* If click, point will already be finalized and drawn.
-		 * If drag, need at least two points to draw a line. */
+	/* Like gp_draw_stroke_3d() in annotate_draw.c, but the stroke is only uploaded where it grew,
+	 * and drawn with one call per line width. */
+	if (!stroke_backend) {
+		stroke_backend = new StrokeBackend();
+		stroke.set_backend(stroke_backend);
 	}
-	else {
-		/* if cyclic needs one vertex more */
-		bool cyclic = false;
-		if ((*(Coord3Df*)&pts[0] == *(Coord3Df*)&pts[tot_points - 1])) {
-			cyclic = true;
-		}
-		int cyclic_add = 0;
-		if (cyclic) {
-			++cyclic_add;
-		}
-
-		float cyclic_fpt[3];
-		int draw_points = 0;
-
-		float cur_pressure = pts[0].pressure;
-
-		GPUVertFormat *format = immVertexFormat();
-		uint pos = GPU_vertformat_attr_add(format, "pos", GPU_COMP_F32, 3, GPU_FETCH_FLOAT);
-
-		immBindBuiltinProgram(GPU_SHADER_3D_UNIFORM_COLOR);
-		immUniformColor4fv(colors[layer]);
-
-		/* TODO: implement this with a geometry shader to draw one continuous tapered stroke */
-
-		/* draw stroke curve */
-		GPU_line_width(max_ff(cur_pressure * line_thickness, 1.0f));
-		immBeginAtMost(GPU_PRIM_LINE_STRIP, tot_points + cyclic_add);
-		for (int i = 0; i < tot_points; ++i) {
-			/* if there was a significant pressure change, stop the curve, change the thickness of the stroke,
-			 * and continue drawing again (since line-width cannot change in middle of GL_LINE_STRIP)
-			 * Note: we want more visible levels of pressures when thickness is bigger.
-			 */
-			if (fabsf(pts[i].pressure - cur_pressure) > 0.2f / (float)line_thickness) {
-				/* if the pressure changes before get at least 2 vertices, need to repeat last point to avoid assert in immEnd() */
-				if (draw_points < 2) {
-					immVertex3fv(pos, &pts[i - 1].x);
-				}
-				immEnd();
-				draw_points = 0;
-
-				cur_pressure = pts[i].pressure;
-				GPU_line_width(max_ff(cur_pressure * line_thickness, 1.0f));
-				immBeginAtMost(GPU_PRIM_LINE_STRIP, tot_points - i + 1 + cyclic_add);
-
-				/* need to roll-back one point to ensure that there are no gaps in the stroke */
-				if (i != 0) {
-					immVertex3fv(pos, &pts[i - 1].x);
-					++draw_points;
-				}
-			}
-
-			/* now the point we want */
-			immVertex3fv(pos, &pts[i].x);
-			++draw_points;
-
-			if (cyclic && i == 0) {
-				/* save first point to use in cyclic */
-				copy_v3_v3(cyclic_fpt, &pts[i].x);
-			}
-		}
-
-		if (cyclic) {
-			/* draw line to first point to complete the cycle */
-			immVertex3fv(pos, cyclic_fpt);
-			++draw_points;
-		}
-
-		/* if less of two points, need to repeat last point to avoid assert in immEnd() */
-		if (draw_points < 2) {
-			immVertex3fv(pos, &pts[tot_points - 1].x);
-		}
+	stroke.draw(colors[layer]);
+}
 
-		immEnd();
-		immUnbindProgram();
+void Widget_Annotate::release()
+{
+	if (stroke_backend) {
+		stroke.set_backend(0);
+		stroke_backend->release();
+		delete stroke_backend;
+		stroke_backend = 0;
 	}
 }
 
@@ -524,7 +571,7 @@ void Widget_Annotate::render(VR_Side side)
 		return;
 	}
 	
-	render_points(points, active_layer);
+	render_stroke(active_layer);
 
 	Widget_Annotate::obj.do_render[side] = false;
 }
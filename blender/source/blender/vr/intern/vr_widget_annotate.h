@@ -31,6 +31,7 @@
 #define __VR_WIDGET_ANNOTATE_H__
 
 #include "vr_widget.h"
+#include "vr_draw_stroke.h"
 
 struct bGPDspoint;
 struct bGPdata;
@@ -58,6 +59,10 @@ class Widget_Annotate : public VR_Widget
 	static int init(bool new_scene); /* Initialize the VR gpencil structs. */
 
 	static std::vector<bGPDspoint> points;	/* The 3D points associated with the current stroke. */
+	class StrokeBackend;
+	static StrokeBackend *stroke_backend;	/* OpenGL backend of the current stroke geometry. */
+	static VR_Draw_Stroke stroke;	/* GPU geometry of the current stroke (appended to as it is drawn). */
+	static float simplify_tolerance;	/* Tolerance for simplifying finished strokes (meters, real space; 0 to keep all points). */
 
 	//static float point_thickness;	/* Stroke thickness for points. */
 	static float line_thickness;	/* Stroke thickness for lines. */
@@ -68,8 +73,9 @@ class Widget_Annotate : public VR_Widget
 	static float eraser_radius;	/* Radius of the eraser ball. */
 	static void erase_stroke(bGPDstroke *gps, bGPDframe *gp_frame);	/*	Helper function to erase a stroke. */
 public:
-  static void add_stroke(const std::vector<bGPDspoint>& ptrs, uint layer, bool set_active); /* Helper function to add a stroke. */
-  static void render_points(const std::vector<bGPDspoint>& pts, uint layer);  /* Helper function to render annotation points. */
+  static void add_stroke(const std::vector<bGPDspoint>& ptrs, uint layer, bool set_active, const std::vector<uint> *keep = 0); /* Helper function to add a stroke (only the points in keep, if given). */
+  static void render_stroke(uint layer);  /* Helper function to render the current stroke. */
+  static void release();  /* Free the GPU geometry of the current stroke. */
 public:
 	static Widget_Annotate obj;	/* Singleton implementation object. */
 	virtual std::string name() override { return "ANNOTATE"; };	/* Get the name of this widget. */
@@ -34,6 +34,7 @@
 #include "vr_main.h"
 #include "vr_ui.h"
 
+#include "vr_mesh_region.h"
 #include "vr_widget_bevel.h"
 #include "vr_widget_transform.h"
 
@@ -120,9 +121,17 @@ static const float value_clamp_max[NUM_VALUE_KINDS] = { 1e6, 100.0f, 1.0f, SEGME
 static const float value_start[NUM_VALUE_KINDS] = { 0.0f, 0.0f, 0.5f, 1.0f };
 static const float value_scale_per_inch[NUM_VALUE_KINDS] = { 0.0f, 100.0f, 1.0f, 4.0f };
 
+/* Bevel operator (for the edit mesh or the region around the selection). */
+static const char *bevel_op_fmt =
+	"bevel geom=%hev offset=%f segments=%i vertex_only=%b offset_type=%i profile=%f "
+	"clamp_overlap=%b material=%i loop_slide=%b mark_seam=%b mark_sharp=%b "
+	"harden_normals=%b face_strength_mode=%i "
+	"miter_outer=%i miter_inner=%i spread=%f smoothresh=%f";
+
 typedef struct {
 	BMEditMesh *em;
-	BMBackup mesh_backup;
+	BMBackup mesh_backup;	/* Whole mesh, when the selection can't be beveled locally. */
+	VR_Mesh_Region *region;	/* Region around the selection (or 0). */
 } BevelObjectStore;
 
 typedef struct {
@@ -311,7 +320,14 @@ static bool edbm_bevel_init(bContext *C, wmOperator *op, const bool is_modal)
 	//if (is_modal) {
 		View3D *v3d = CTX_wm_view3d(C);
 		for (uint ob_index = 0; ob_index < opdata->ob_store_len; ob_index++) {
-			opdata->ob_store[ob_index].mesh_backup = EDBM_redo_state_store(opdata->ob_store[ob_index].em);
+			BevelObjectStore& store = opdata->ob_store[ob_index];
+			/* Only re-evaluate the selection and its one-ring each frame where possible. */
+			store.region = new VR_Mesh_Region();
+			if (!store.region->begin(store.em)) {
+				delete store.region;
+				store.region = 0;
+				store.mesh_backup = EDBM_redo_state_store(store.em);
+			}
 		}
 		G.moving = G_TRANSFORM_EDIT;
 		if (v3d) {
@@ -349,10 +365,13 @@ static bool edbm_bevel_calc(wmOperator *op)
 
 	for (uint ob_index = 0; ob_index < opdata->ob_store_len; ob_index++) {
 		em = opdata->ob_store[ob_index].em;
+		VR_Mesh_Region *region = opdata->ob_store[ob_index].region;
 
 		/* revert to original mesh */
 		//if (opdata->is_modal) {
+		if (!region) {
 			EDBM_redo_state_restore(opdata->ob_store[ob_index].mesh_backup, em, false);
+		}
 		//}
 
 		Mesh *me = (Mesh*)em->ob->data;
@@ -366,12 +385,48 @@ static bool edbm_bevel_calc(wmOperator *op)
 			material = CLAMPIS(material, -1, em->ob->totcol - 1);
 		}
 
+		if (region) {
+			/* Bevel the copy of the region and replace the region of the edit mesh by the result. */
+			BMesh *bm = region->restore();
+			BMO_op_initf(
+				bm, &bmop, BMO_FLAG_DEFAULTS,
+				bevel_op_fmt,
+				BM_ELEM_SELECT, Widget_Bevel::offset, Widget_Bevel::segments, Widget_Bevel::vertex_only, offset_type, profile,
+				clamp_overlap, material, loop_slide, mark_seam, mark_sharp, harden_normals, face_strength_mode,
+				miter_outer, miter_inner, spread, me->smoothresh);
+
+			BMO_op_exec(bm, &bmop);
+
+			if (Widget_Bevel::offset != 0.0f) {
+				/* The rest of the mesh has no selection. */
+				BM_mesh_elem_hflag_disable_all(bm, BM_VERT | BM_EDGE | BM_FACE, BM_ELEM_SELECT, false);
+				BMO_slot_buffer_hflag_enable(bm, bmop.slots_out, "faces.out", BM_FACE, BM_ELEM_SELECT, true);
+			}
+
+			BMO_op_finish(bm, &bmop);
+			if (BMO_error_occurred(bm)) {
+				/* Keep the result of the last frame. */
+				BMO_error_clear(bm);
+				continue;
+			}
+
+			if (region->apply()) {
+				EDBM_update_generic(em, true, true);
+				changed = true;
+				continue;
+			}
+
+			/* The result can't replace the region: write the original region back
+			 * and evaluate the whole mesh from now on. */
+			region->cancel();
+			delete region;
+			opdata->ob_store[ob_index].region = 0;
+			opdata->ob_store[ob_index].mesh_backup = EDBM_redo_state_store(em);
+		}
+
 		EDBM_op_init(
 			em, &bmop, op,
-			"bevel geom=%hev offset=%f segments=%i vertex_only=%b offset_type=%i profile=%f "
-			"clamp_overlap=%b material=%i loop_slide=%b mark_seam=%b mark_sharp=%b "
-			"harden_normals=%b face_strength_mode=%i "
-			"miter_outer=%i miter_inner=%i spread=%f smoothresh=%f",
+			bevel_op_fmt,
 			BM_ELEM_SELECT, Widget_Bevel::offset, Widget_Bevel::segments, Widget_Bevel::vertex_only, offset_type, profile,
 			clamp_overlap, material, loop_slide, mark_seam, mark_sharp, harden_normals, face_strength_mode,
 			miter_outer, miter_inner, spread, me->smoothresh);
@@ -413,7 +468,13 @@ static void edbm_bevel_exit(bContext *C, wmOperator *op)
 	//if (opdata->is_modal) {
 		View3D *v3d = CTX_wm_view3d(C);
 		for (uint ob_index = 0; ob_index < opdata->ob_store_len; ob_index++) {
-			EDBM_redo_state_free(&opdata->ob_store[ob_index].mesh_backup, NULL, false);
+			BevelObjectStore& store = opdata->ob_store[ob_index];
+			if (store.region) {
+				delete store.region;
+			}
+			else {
+				EDBM_redo_state_free(&store.mesh_backup, NULL, false);
+			}
 		}
 		if (v3d) {
 			v3d->gizmo_flag = opdata->gizmo_flag;
@@ -433,8 +494,14 @@ static void edbm_bevel_cancel(bContext *C, wmOperator *op)
 	}
 	//if (opdata->is_modal) {
 		for (uint ob_index = 0; ob_index < opdata->ob_store_len; ob_index++) {
-			EDBM_redo_state_free(&opdata->ob_store[ob_index].mesh_backup, opdata->ob_store[ob_index].em, true);
-			EDBM_update_generic(opdata->ob_store[ob_index].em, false, true);
+			BevelObjectStore& store = opdata->ob_store[ob_index];
+			if (store.region) {
+				store.region->cancel();
+				EDBM_update_generic(store.em, true, true);
+				continue;
+			}
+			EDBM_redo_state_free(&store.mesh_backup, store.em, true);
+			EDBM_update_generic(store.em, false, true);
 		}
 	//}
 
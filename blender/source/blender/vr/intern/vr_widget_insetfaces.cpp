@@ -34,6 +34,7 @@
 #include "vr_main.h"
 #include "vr_ui.h"
 
+#include "vr_mesh_region.h"
 #include "vr_widget_insetfaces.h"
 #include "vr_widget_transform.h"
 
@@ -106,9 +107,18 @@ static wmOperator inset_dummy_op;
 /* From editmesh_inset.c */
 typedef struct {
 	BMEditMesh *em;
-	BMBackup mesh_backup;
+	BMBackup mesh_backup;	/* Whole mesh, when the selection can't be inset locally. */
+	VR_Mesh_Region *region;	/* Region around the selection (or 0). */
 } InsetObjectStore;
 
+/* Inset operators (for the edit mesh or the region around the selection). */
+static const char *inset_individual_op_fmt =
+	"inset_individual faces=%hf use_even_offset=%b  use_relative_offset=%b "
+	"use_interpolate=%b thickness=%f depth=%f";
+static const char *inset_region_op_fmt =
+	"inset_region faces=%hf use_boundary=%b use_even_offset=%b use_relative_offset=%b "
+	"use_interpolate=%b thickness=%f depth=%f use_outset=%b use_edge_rail=%b";
+
 typedef struct {
 	float old_thickness;
 	float old_depth;
@@ -177,7 +187,14 @@ static bool edbm_inset_init(bContext *C, wmOperator *op, const bool is_modal)
 	//if (is_modal) {
 		View3D *v3d = CTX_wm_view3d(C);
 		for (uint ob_index = 0; ob_index < opdata->ob_store_len; ob_index++) {
-			opdata->ob_store[ob_index].mesh_backup = EDBM_redo_state_store(opdata->ob_store[ob_index].em);
+			InsetObjectStore& store = opdata->ob_store[ob_index];
+			/* Only re-evaluate the selection and its one-ring each frame where possible. */
+			store.region = new VR_Mesh_Region();
+			if (!store.region->begin(store.em)) {
+				delete store.region;
+				store.region = 0;
+				store.mesh_backup = EDBM_redo_state_store(store.em);
+			}
 		}
 		G.moving = G_TRANSFORM_EDIT;
 		if (v3d) {
@@ -206,6 +223,55 @@ static bool edbm_inset_calc(wmOperator *op)
 
 	for (uint ob_index = 0; ob_index < opdata->ob_store_len; ob_index++) {
 		em = opdata->ob_store[ob_index].em;
+		VR_Mesh_Region *region = opdata->ob_store[ob_index].region;
+
+		if (region) {
+			/* Inset the copy of the region and replace the region of the edit mesh by the result. */
+			BMesh *bm = region->restore();
+			if (Widget_InsetFaces::use_individual) {
+				BMO_op_initf(
+					bm, &bmop, BMO_FLAG_DEFAULTS,
+					inset_individual_op_fmt,
+					BM_ELEM_SELECT, Widget_InsetFaces::use_even_offset, Widget_InsetFaces::use_relative_offset, use_interpolate,
+					Widget_InsetFaces::thickness, Widget_InsetFaces::depth);
+			}
+			else {
+				BMO_op_initf(
+					bm, &bmop, BMO_FLAG_DEFAULTS,
+					inset_region_op_fmt,
+					BM_ELEM_SELECT, Widget_InsetFaces::use_boundary, Widget_InsetFaces::use_even_offset, Widget_InsetFaces::use_relative_offset, use_interpolate,
+					Widget_InsetFaces::thickness, Widget_InsetFaces::depth, Widget_InsetFaces::use_outset, use_edge_rail);
+
+				if (Widget_InsetFaces::use_outset) {
+					BMO_slot_buffer_from_enabled_hflag(bm, &bmop, bmop.slots_in, "faces_exclude", BM_FACE, BM_ELEM_HIDDEN);
+				}
+			}
+			BMO_op_exec(bm, &bmop);
+
+			/* The rest of the mesh has no selection. */
+			BM_mesh_elem_hflag_disable_all(bm, BM_VERT | BM_EDGE | BM_FACE, BM_ELEM_SELECT, false);
+			BMO_slot_buffer_hflag_enable(bm, bmop.slots_out, use_select_inset ? "faces.out" : "faces", BM_FACE, BM_ELEM_SELECT, true);
+
+			BMO_op_finish(bm, &bmop);
+			if (BMO_error_occurred(bm)) {
+				/* Keep the result of the last frame. */
+				BMO_error_clear(bm);
+				continue;
+			}
+
+			if (region->apply()) {
+				EDBM_update_generic(em, true, true);
+				changed = true;
+				continue;
+			}
+
+			/* The result can't replace the region: write the original region back
+			 * and evaluate the whole mesh from now on. */
+			region->cancel();
+			delete region;
+			opdata->ob_store[ob_index].region = 0;
+			opdata->ob_store[ob_index].mesh_backup = EDBM_redo_state_store(em);
+		}
 
 		//if (opdata->is_modal) {
 			EDBM_redo_state_restore(opdata->ob_store[ob_index].mesh_backup, em, false);
@@ -214,16 +280,14 @@ static bool edbm_inset_calc(wmOperator *op)
 		if (Widget_InsetFaces::use_individual) {
 			EDBM_op_init(
 				em, &bmop, op,
-				"inset_individual faces=%hf use_even_offset=%b  use_relative_offset=%b "
-				"use_interpolate=%b thickness=%f depth=%f",
+				inset_individual_op_fmt,
 				BM_ELEM_SELECT, Widget_InsetFaces::use_even_offset, Widget_InsetFaces::use_relative_offset, use_interpolate,
 				Widget_InsetFaces::thickness, Widget_InsetFaces::depth);
 		}
 		else {
 			EDBM_op_init(
 				em, &bmop, op,
-				"inset_region faces=%hf use_boundary=%b use_even_offset=%b use_relative_offset=%b "
-				"use_interpolate=%b thickness=%f depth=%f use_outset=%b use_edge_rail=%b",
+				inset_region_op_fmt,
 				BM_ELEM_SELECT, Widget_InsetFaces::use_boundary, Widget_InsetFaces::use_even_offset, Widget_InsetFaces::use_relative_offset, use_interpolate,
 				Widget_InsetFaces::thickness, Widget_InsetFaces::depth, Widget_InsetFaces::use_outset, use_edge_rail);
 
@@ -269,7 +333,13 @@ static void edbm_inset_exit(bContext *C, wmOperator *op)
 	//if (opdata->is_modal) {
 		View3D *v3d = CTX_wm_view3d(C);
 		for (uint ob_index = 0; ob_index < opdata->ob_store_len; ob_index++) {
-			EDBM_redo_state_free(&opdata->ob_store[ob_index].mesh_backup, NULL, false);
+			InsetObjectStore& store = opdata->ob_store[ob_index];
+			if (store.region) {
+				delete store.region;
+			}
+			else {
+				EDBM_redo_state_free(&store.mesh_backup, NULL, false);
+			}
 		}
 		if (v3d) {
 			v3d->gizmo_flag = opdata->gizmo_flag;
@@ -290,8 +360,14 @@ static void edbm_inset_cancel(bContext *C, wmOperator *op)
 	}
 	//if (opdata->is_modal) {
 	for (uint ob_index = 0; ob_index < opdata->ob_store_len; ob_index++) {
-		EDBM_redo_state_free(&opdata->ob_store[ob_index].mesh_backup, opdata->ob_store[ob_index].em, true);
-		EDBM_update_generic(opdata->ob_store[ob_index].em, false, true);
+		InsetObjectStore& store = opdata->ob_store[ob_index];
+		if (store.region) {
+			store.region->cancel();
+			EDBM_update_generic(store.em, true, true);
+			continue;
+		}
+		EDBM_redo_state_free(&store.mesh_backup, store.em, true);
+		EDBM_update_generic(store.em, false, true);
 	}
 	//}
 
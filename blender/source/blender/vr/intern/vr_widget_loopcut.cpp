@@ -38,6 +38,7 @@
 #include "vr_widget_transform.h"
 
 #include "vr_math.h"
+#include "vr_mesh_bvh.h"
 #include "vr_draw.h"
 
 #include "BLI_alloca.h"
@@ -399,14 +400,28 @@ static void loopcut_mouse_move(RingSelOpData *lcd, const int previewlines)
   best = { 0 };
   best.dist = ED_view3d_select_dist_px();
 
-  uint base_index;
-  BMEdge *eed_test = EDBM_edge_find_nearest_ex(
-      &lcd->vc, &best.dist, NULL, false, false, NULL, lcd->bases, lcd->bases_len, &base_index);
+  /* Nearest visible edge of the cached BVH trees (instead of drawing the selection buffer). */
+  ARegion *ar = lcd->vc.ar;
+  const float winsize[2] = {(float)ar->winx, (float)ar->winy};
+  const float mval[2] = {(float)lcd->vc.mval[0], (float)lcd->vc.mval[1]};
+  const bool use_occlusion = !XRAY_FLAG_ENABLED(lcd->vc.v3d);
 
-  if (eed_test) {
-    best.ob = lcd->bases[base_index]->object;
-    best.eed = eed_test;
-    best.base_index = base_index;
+  for (uint base_index = 0; base_index < lcd->bases_len; base_index++) {
+    Object *ob_iter = lcd->bases[base_index]->object;
+    BMEditMesh *em = BKE_editmesh_from_object(ob_iter);
+    BMEdge *eed_test = (BMEdge *)VR_Mesh_BVH::find_nearest(em,
+                                                          ob_iter,
+                                                          lcd->vc.rv3d,
+                                                          winsize,
+                                                          mval,
+                                                          VR_Mesh_BVH::NEAREST_EDGE,
+                                                          use_occlusion,
+                                                          &best.dist);
+    if (eed_test) {
+      best.ob = ob_iter;
+      best.eed = eed_test;
+      best.base_index = base_index;
+    }
   }
 
   if (best.eed) {
@@ -973,6 +988,7 @@ static void calcEdgeSlide_mval_range(TransInfo *t,
   RegionView3D *rv3d = NULL;
   float projectMat[4][4];
   BMBVHTree *bmbvh;
+  bool use_occlude_bvh = use_occlude_geometry;
 
   /* only for use_calc_direction */
   float(*loop_dir)[3] = NULL, *loop_maxdist = NULL;
@@ -997,7 +1013,9 @@ static void calcEdgeSlide_mval_range(TransInfo *t,
   }
 
   if (use_occlude_geometry) {
-    bmbvh = BKE_bmbvh_new_from_editmesh(em, BMBVH_RESPECT_HIDDEN, NULL, false);
+    /* Shared with the loop cut preview, owned by the cache. */
+    bmbvh = VR_Mesh_BVH::get(em);
+    use_occlude_bvh = (bmbvh != NULL);
   }
   else {
     bmbvh = NULL;
@@ -1035,7 +1053,7 @@ static void calcEdgeSlide_mval_range(TransInfo *t,
             continue;
 
           /* This test is only relevant if object is not wire-drawn! See [#32068]. */
-          if (use_occlude_geometry &&
+          if (use_occlude_bvh &&
               !BMBVH_EdgeVisible(bmbvh, e_other, t->depsgraph, ar, v3d, tc->obedit)) {
             continue;
           }
@@ -1115,10 +1133,6 @@ static void calcEdgeSlide_mval_range(TransInfo *t,
 
   sld->mval_end[0] = t->mval[0] + mval_end[0];
   sld->mval_end[1] = t->mval[1] + mval_end[1];
-
-  if (bmbvh) {
-    BKE_bmbvh_free(bmbvh);
-  }
 }
 
 static void calcEdgeSlide_even(TransInfo *t,
@@ -97,6 +97,8 @@ int Widget_Menu::highlight_index[VR_SIDES] = {-1,-1};
 VR_Widget::MenuType Widget_Menu::menu_type[VR_SIDES] = { MENUTYPE_TS_SELECT, MENUTYPE_TS_TRANSFORM };
 bool Widget_Menu::action_settings[VR_SIDES] = { false };
 
+VR_Draw_List Widget_Menu::display_list[VR_SIDES];
+
 /* Highlight colors */
 static const float c_menu_white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
 static const float c_menu_red[4] = { 0.926f, 0.337f, 0.337f, 1.0f };
@@ -2063,6 +2065,102 @@ void Widget_Menu::drag_stop(VR_UI::Cursor& c)
 	}
 }
 
+/* State the menu items are drawn from (compared bytewise, so it must be cleared before it is set). */
+struct Widget_Menu::ListState {
+	int		ui_type;	/* VR_UI::ui_type */
+	int		type;	/* menu_type */
+	uint	depth;	/* depth */
+	int		highlight_index;	/* highlight_index */
+	bool	action_settings;	/* action_settings */
+	bool	center_touched;	/* Whether the stick / dpad center is touched (action settings menus). */
+	bool	mouse_cursor_enabled;	/* VR_UI::mouse_cursor_enabled */
+	int		selection_mode;	/* VR_UI::selection_mode */
+	const void	*tool;	/* VR_UI::get_current_tool() */
+	int		nav_lock[3];	/* Widget_Navi::nav_lock */
+	int		transform_mode;	/* Widget_Transform::transform_mode */
+	int		constraint_mode;	/* Widget_Transform::constraint_mode */
+	int		transform_space;	/* Widget_Transform::transform_space */
+	bool	manipulator;	/* Widget_Transform::manipulator */
+	int		primitive;	/* Widget_AddPrimitive::primitive */
+	int		extrude_mode;	/* Widget_Extrude::extrude_mode */
+	bool	extrude_transform;	/* Widget_Extrude::transform */
+	bool	extrude_flip_normals;	/* Widget_Extrude::flip_normals */
+	bool	inset[5];	/* Widget_InsetFaces options */
+	bool	bevel_vertex_only;	/* Widget_Bevel::vertex_only */
+	bool	loopcut[3];	/* Widget_LoopCut options */
+	int		sculpt_brush;	/* Widget_Sculpt::brush */
+	int		sculpt_mode_orig;	/* Widget_Sculpt::mode_orig */
+	float	sculpt_strength;	/* Widget_Sculpt::sculpt_strength */
+	char	sculpt_symmetry;	/* Widget_Sculpt::symmetry */
+	bool	sculpt[3];	/* Widget_Sculpt options */
+	int		anim_bind_type;	/* Widget_Animation::bind_type */
+	int		anim_transform_space;	/* Widget_Animation::transform_space */
+	int		anim_constraint_flag[3][3];	/* Widget_Animation::constraint_flag */
+};
+
+void Widget_Menu::get_list_state(VR_Side controller_side, ListState& r_state)
+{
+	memset(&r_state, 0, sizeof(r_state));
+	r_state.ui_type = VR_UI::ui_type;
+	r_state.type = menu_type[controller_side];
+	r_state.depth = depth[controller_side];
+	r_state.highlight_index = highlight_index[controller_side];
+	r_state.action_settings = action_settings[controller_side];
+	if (r_state.action_settings) {
+		const bool center_use_stick = (VR_UI::ui_type == VR_DEVICE_TYPE_OCULUS) || (VR_UI::ui_type == VR_DEVICE_TYPE_INDEX);
+		VR_Layout::ButtonBit btnbit = center_use_stick ? VR_Layout::BUTTONBITS_STICKS : VR_Layout::BUTTONBITS_DPADS;
+		r_state.center_touched = ((vr_get_obj()->controller[controller_side]->buttons_touched & btnbit) != 0);
+	}
+	r_state.mouse_cursor_enabled = VR_UI::mouse_cursor_enabled;
+	r_state.selection_mode = VR_UI::selection_mode;
+	r_state.tool = VR_UI::get_current_tool(controller_side);
+	for (int i = 0; i < 3; ++i) {
+		r_state.nav_lock[i] = Widget_Navi::nav_lock[i];
+	}
+	r_state.transform_mode = Widget_Transform::transform_mode;
+	r_state.constraint_mode = Widget_Transform::constraint_mode;
+	r_state.transform_space = Widget_Transform::transform_space;
+	r_state.manipulator = Widget_Transform::manipulator;
+	r_state.primitive = Widget_AddPrimitive::primitive;
+	r_state.extrude_mode = Widget_Extrude::extrude_mode;
+	r_state.extrude_transform = Widget_Extrude::transform;
+	r_state.extrude_flip_normals = Widget_Extrude::flip_normals;
+	r_state.inset[0] = Widget_InsetFaces::use_individual;
+	r_state.inset[1] = Widget_InsetFaces::use_boundary;
+	r_state.inset[2] = Widget_InsetFaces::use_even_offset;
+	r_state.inset[3] = Widget_InsetFaces::use_relative_offset;
+	r_state.inset[4] = Widget_InsetFaces::use_outset;
+	r_state.bevel_vertex_only = Widget_Bevel::vertex_only;
+	r_state.loopcut[0] = Widget_LoopCut::edge_slide;
+	r_state.loopcut[1] = Widget_LoopCut::flipped;
+	r_state.loopcut[2] = Widget_LoopCut::clamp;
+	r_state.sculpt_brush = Widget_Sculpt::brush;
+	r_state.sculpt_mode_orig = Widget_Sculpt::mode_orig;
+	r_state.sculpt_strength = Widget_Sculpt::sculpt_strength;
+	r_state.sculpt_symmetry = Widget_Sculpt::symmetry;
+	r_state.sculpt[0] = Widget_Sculpt::use_trigger_pressure;
+	r_state.sculpt[1] = Widget_Sculpt::raycast;
+	r_state.sculpt[2] = Widget_Sculpt::dyntopo;
+	r_state.anim_bind_type = Widget_Animation::bind_type;
+	r_state.anim_transform_space = Widget_Animation::transform_space;
+	memcpy(r_state.anim_constraint_flag, Widget_Animation::constraint_flag, sizeof(r_state.anim_constraint_flag));
+}
+
+void Widget_Menu::get_list_stats(VR_Draw_List::Stats& r_stats)
+{
+	memset(&r_stats, 0, sizeof(r_stats));
+	for (int i = 0; i < VR_SIDES; ++i) {
+		const VR_Draw_List::Stats& stats = display_list[i].get_stats();
+		r_stats.rebuilds += stats.rebuilds;
+		r_stats.uploads += stats.uploads;
+		r_stats.commands += stats.commands;
+		r_stats.vertices += stats.vertices;
+		r_stats.replays += stats.replays;
+		r_stats.draw_calls += stats.draw_calls;
+		r_stats.state_changes += stats.state_changes;
+	}
+}
+
 void Widget_Menu::render_icon(const Mat44f& t, VR_Side controller_side, bool active, bool touched)
 {
 	if (!VR_UI::pie_menu_active[controller_side]) {
@@ -2089,6 +2187,32 @@ void Widget_Menu::render_icon(const Mat44f& t, VR_Side controller_side, bool act
 		return;
 	}
 
+	/* The menu items are recorded into a display list (relative to t), which is only rebuilt
+	 * when the menu state or one of the displayed values changed. */
+	VR_Draw_List& list = display_list[controller_side];
+	ListState state;
+	get_list_state(controller_side, state);
+	if (list.update_state(&state, sizeof(state))) {
+		VR_Draw::begin_list(&list, t);
+		render_items(t, controller_side);
+		VR_Draw::end_list();
+	}
+	VR_Draw::render_list(&list, t);
+
+	if (touched && !action_settings[controller_side]) {
+		/* Render sphere to represent stick direction. */
+		static Mat44f m = VR_Math::identity_f;
+		Coord3Df temp = (*(Coord3Df*)t.m[1]).normalize();
+		temp *= 0.06f;
+		rotate_v3_v3v3fl(m.m[3], (float*)&temp, t.m[2], -angle[controller_side]);
+		*(Coord3Df*)m.m[3] += *(Coord3Df*)t.m[3];
+		VR_Draw::update_modelview_matrix(&m, 0);
+		VR_Draw::render_ball(0.005f, false);
+	}
+}
+
+void Widget_Menu::render_items(const Mat44f& t, VR_Side controller_side)
+{
 	const MenuType& type = menu_type[controller_side];
 
 	VR_Draw::update_modelview_matrix(&t, 0);
@@ -3037,16 +3161,6 @@ void Widget_Menu::render_icon(const Mat44f& t, VR_Side controller_side, bool act
 		}
 	}
 	else {
-		if (touched) {
-			/* Render sphere to represent stick direction. */
-			static Mat44f m = VR_Math::identity_f;
-			Coord3Df temp = (*(Coord3Df*)t.m[1]).normalize();
-			temp *= 0.06f;
-			rotate_v3_v3v3fl(m.m[3], (float*)&temp, t.m[2], -angle[controller_side]);
-			*(Coord3Df*)m.m[3] += *(Coord3Df*)t.m[3];
-			VR_Draw::update_modelview_matrix(&m, 0);
-			VR_Draw::render_ball(0.005f, false);
-		}
 		menu_str = "";
 
 		switch (menu_type[controller_side]) {
@@ -31,6 +31,7 @@
 #define __VR_WIDGET_MENU_H__
 
 #include "vr_widget.h"
+#include "vr_draw_list.h"
 
 /* Interaction widget for a VR pie menu. */
 class Widget_Menu : public VR_Widget
@@ -44,6 +45,11 @@ class Widget_Menu : public VR_Widget
 
 	static Coord2Df stick[VR_SIDES];	/* The uv coordinates of the stick/dpad (-1 ~ 1). */
 	static float angle[VR_SIDES]; /* The stick/dpad angle (angle from (0,1)). */
+
+	struct ListState;	/* State the menu items are drawn from. */
+	static VR_Draw_List display_list[VR_SIDES];	/* Retained display lists of the menu items. */
+	static void get_list_state(VR_Side controller_side, ListState& r_state);	/* Get the state the menu items are drawn from. */
+	static void render_items(const Mat44f& t, VR_Side controller_side);	/* Render the menu items (recorded into the display list). */
 public:
 	static int highlight_index[VR_SIDES];	/* The currently highlighted menu item. */
 public:
@@ -51,6 +57,7 @@ public:
 	static bool action_settings[VR_SIDES];	/* Whether the current menu is an action settings menu. */
 
 	static void stick_center_click(VR_UI::Cursor& c);	/* Execute operation on stick/dpad center click. */
+	static void get_list_stats(VR_Draw_List::Stats& r_stats);	/* Get the counters of the display lists (both sides). */
 
 	static Widget_Menu obj;	/* Singleton implementation object. */
 	virtual std::string name() override { return "MENU"; };	/* Get the name of this widget. */
@@ -41,6 +41,7 @@
 
 #include "vr_draw.h"
 #include "vr_math.h"
+#include "vr_tracking_sampler.h"
 
 #include "MEM_guardedalloc.h"
 
@@ -548,12 +549,18 @@ bool Widget_Sculpt::param_mode(false);
 bool Widget_Sculpt::stroke_started(false);
 bool Widget_Sculpt::is_dragging(false);
 
+VR_Tracking_Sampler Widget_Sculpt::sampler;
+ui64 Widget_Sculpt::sample_seq(0);
+Coord3Df Widget_Sculpt::stroke_last;
+float Widget_Sculpt::stroke_travel(0.0f);
+
 VR_Side Widget_Sculpt::cursor_side;
 
 int Widget_Sculpt::mode(BRUSH_STROKE_NORMAL);
 int Widget_Sculpt::mode_orig(BRUSH_STROKE_NORMAL);
 int Widget_Sculpt::brush(SCULPT_TOOL_DRAW);
 float Widget_Sculpt::location[3];
+bool Widget_Sculpt::location_is_dab(false);
 float Widget_Sculpt::mouse[2];
 float Widget_Sculpt::pressure(1.0f);
 bool Widget_Sculpt::use_trigger_pressure(true);
@@ -2449,6 +2456,67 @@ static PBVHNode **sculpt_pbvh_gather_cursor_update(Object *ob,
   return nodes;
 }
 
+/* Nodes within reach of all dabs of a stroke segment (see Widget_Sculpt::stroke_contd()).
+ * Gathered once per segment, so the dabs only test these nodes instead of searching the PBVH. */
+typedef struct SculptSegmentNodes {
+  PBVHNode **nodes;
+  int totnode;
+  float bb_min[3]; /* Bounds of the segment, including the brush radius (object space). */
+  float bb_max[3];
+} SculptSegmentNodes;
+
+static SculptSegmentNodes sculpt_segment_nodes = {NULL, 0};
+
+/* Test AABB (original or current) against the segment bounds. */
+static bool sculpt_search_segment_cb(PBVHNode *node, void *data_v)
+{
+  const SculptSegmentNodes *data = (const SculptSegmentNodes *)data_v;
+  float bb_min[3], bb_max[3], orig_min[3], orig_max[3];
+
+  BKE_pbvh_node_get_BB(node, bb_min, bb_max);
+  BKE_pbvh_node_get_original_BB(node, orig_min, orig_max);
+  for (int i = 0; i < 3; i++) {
+    if (min_ff(bb_min[i], orig_min[i]) > data->bb_max[i] ||
+        max_ff(bb_max[i], orig_max[i]) < data->bb_min[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/* Gather the nodes of a sphere search from the segment nodes (if they cover the sphere). */
+static bool sculpt_segment_nodes_gather(SculptSearchSphereData *data,
+                                        PBVHNode ***r_nodes,
+                                        int *r_totnode)
+{
+  const SculptSegmentNodes *segment = &sculpt_segment_nodes;
+  if (!segment->nodes) {
+    return false;
+  }
+  const float *center = data->ss->cache->location;
+  const float radius = sqrtf(data->radius_squared);
+  for (int i = 0; i < 3; i++) {
+    if (center[i] - radius < segment->bb_min[i] || center[i] + radius > segment->bb_max[i]) {
+      return false;
+    }
+  }
+
+  PBVHNode **nodes = (PBVHNode **)MEM_mallocN(sizeof(*nodes) * segment->totnode, __func__);
+  int totnode = 0;
+  for (int n = 0; n < segment->totnode; n++) {
+    if (sculpt_search_sphere_cb(segment->nodes[n], data)) {
+      nodes[totnode++] = segment->nodes[n];
+    }
+  }
+  if (totnode == 0) {
+    MEM_freeN(nodes);
+    nodes = NULL;
+  }
+  *r_nodes = nodes;
+  *r_totnode = totnode;
+  return true;
+}
+
 static PBVHNode **sculpt_pbvh_gather_generic(Object *ob,
                                              Sculpt *sd,
                                              const Brush *brush,
@@ -2469,7 +2537,9 @@ static PBVHNode **sculpt_pbvh_gather_generic(Object *ob,
     data.original = use_original;
     data.ignore_fully_masked = brush->sculpt_tool != SCULPT_TOOL_MASK;
     data.center = NULL;
-    BKE_pbvh_search_gather(ss->pbvh, sculpt_search_sphere_cb, &data, &nodes, r_totnode);
+    if (!sculpt_segment_nodes_gather(&data, &nodes, r_totnode)) {
+      BKE_pbvh_search_gather(ss->pbvh, sculpt_search_sphere_cb, &data, &nodes, r_totnode);
+    }
   }
   else {
     struct DistRayAABB_Precalc dist_ray_to_aabb_precalc;
@@ -6722,10 +6792,12 @@ static void sculpt_update_cache_variants(bContext *C, Sculpt *sd, Object *ob, Po
   StrokeCache *cache = ss->cache;
   Brush *brush = BKE_paint_brush(&sd->paint);
 
-  /* Get the 3d position and 2d-projected position of the VR cursor. */
-  memcpy(Widget_Sculpt::location,
-         VR_UI::cursor_position_get(VR_SPACE_BLENDER, Widget_Sculpt::cursor_side).m[3],
-         sizeof(float) * 3);
+  /* Get the 3d position and 2d-projected position of the VR cursor (or the current dab). */
+  if (!Widget_Sculpt::location_is_dab) {
+    memcpy(Widget_Sculpt::location,
+           VR_UI::cursor_position_get(VR_SPACE_BLENDER, Widget_Sculpt::cursor_side).m[3],
+           sizeof(float) * 3);
+  }
   if (Widget_Sculpt::raycast) {
     ARegion *ar = CTX_wm_region(C);
     RegionView3D *rv3d = (RegionView3D *)ar->regiondata;
@@ -9317,6 +9389,104 @@ void Widget_Sculpt::update_brush(int new_brush)
   brush = new_brush;
 }
 
+void Widget_Sculpt::stroke_contd(bContext *C, Object *ob)
+{
+  Sculpt *sd = CTX_data_tool_settings(C)->sculpt;
+  Brush *brush = BKE_paint_brush(&sd->paint);
+  SculptSession *ss = ob->sculpt;
+  const Coord3Df &p_cursor = *(Coord3Df *)VR_UI::cursor_position_get(VR_SPACE_BLENDER,
+                                                                     cursor_side).m[3];
+
+  /* Brushes without spacing (grab, snake hook, anchored, ...): one dab per frame. */
+  const float spacing = 2.0f * sculpt_radius * VR_UI::navigation_scale_get() *
+                        (float)brush->spacing / 100.0f;
+  if (!ss || !ss->cache || !paint_space_stroke_enabled(brush, PAINT_MODE_SCULPT) ||
+      spacing <= 0.0f) {
+    stroke_last = p_cursor;
+    stroke_travel = 0.0f;
+    sculpt_brush_stroke_exec(C, &sculpt_dummy_op);
+    return;
+  }
+
+  /* Stroke since the last frame: the cursor positions of the controller samples (with the current
+   * cursor offset), or the current cursor position if there are none (i.e. the backend can't be
+   * sampled between frames, so the dabs are spaced along the straight line since the last frame). */
+  static std::vector<VR_Tracking_Sampler::Sample> samples(VR_Tracking_Sampler::ring_size);
+  static std::vector<Coord3Df> path;
+  static std::vector<Coord3Df> dabs;
+  path.clear();
+  dabs.clear();
+  path.push_back(stroke_last);
+
+  const uint num_samples = sampler.is_running() ?
+                               sampler.read(sample_seq, &samples[0], (uint)samples.size()) :
+                               0;
+  if (num_samples > 0) {
+    const Coord3Df offset = *(Coord3Df *)VR_UI::cursor_position_get(VR_SPACE_REAL, cursor_side).m[3] -
+                            *(Coord3Df *)VR_UI::controller_position_get(VR_SPACE_REAL, cursor_side).m[3];
+    const Mat44f &nav = VR_UI::navigation_matrix_get();
+    for (uint i = 0; i < num_samples; ++i) {
+      if (samples[i].t_controller[cursor_side][3][3] == 0.0f) {
+        /* Controller not tracked. */
+        continue;
+      }
+      const Coord3Df p = *(Coord3Df *)samples[i].t_controller[cursor_side][3] + offset;
+      path.push_back(Coord3Df());
+      VR_Math::multiply_mat44_coord3D(path.back(), nav, p);
+    }
+  }
+  if (path.size() == 1) {
+    path.push_back(p_cursor);
+  }
+  VR_Tracking_Sampler::space_points(&path[0], (uint)path.size(), spacing, stroke_travel, dabs);
+  stroke_last = path.back();
+
+  if (dabs.empty()) {
+    /* Keep applying the brush while the cursor moves less than the spacing. */
+    sculpt_brush_stroke_exec(C, &sculpt_dummy_op);
+    return;
+  }
+
+  /* Gather the PBVH nodes within reach of all dabs at once (not with symmetry, whose dabs are
+   * elsewhere, or dynamic topology, which changes the nodes). */
+  const bool use_segment_nodes = dabs.size() > 1 &&
+                                 !(sd->paint.symmetry_flags &
+                                   (PAINT_SYMM_AXIS_ALL | PAINT_TILE_X | PAINT_TILE_Y |
+                                    PAINT_TILE_Z)) &&
+                                 sd->radial_symm[0] <= 1 && sd->radial_symm[1] <= 1 &&
+                                 sd->radial_symm[2] <= 1 &&
+                                 BKE_pbvh_type(ss->pbvh) != PBVH_BMESH;
+  if (use_segment_nodes) {
+    float obimat[4][4];
+    invert_m4_m4(obimat, ob->obmat);
+    INIT_MINMAX(sculpt_segment_nodes.bb_min, sculpt_segment_nodes.bb_max);
+    for (size_t i = 0; i < dabs.size(); ++i) {
+      float co[3];
+      mul_v3_m4v3(co, obimat, &dabs[i].x);
+      minmax_v3v3_v3(sculpt_segment_nodes.bb_min, sculpt_segment_nodes.bb_max, co);
+    }
+    /* Largest search radius of a dab (see do_brush_action()). */
+    const float margin = 2.0f * sculpt_radius * VR_UI::navigation_scale_get();
+    add_v3_fl(sculpt_segment_nodes.bb_max, margin);
+    add_v3_fl(sculpt_segment_nodes.bb_min, -margin);
+    BKE_pbvh_search_gather(ss->pbvh,
+                           sculpt_search_segment_cb,
+                           &sculpt_segment_nodes,
+                           &sculpt_segment_nodes.nodes,
+                           &sculpt_segment_nodes.totnode);
+  }
+
+  location_is_dab = true;
+  for (size_t i = 0; i < dabs.size(); ++i) {
+    copy_v3_v3(location, &dabs[i].x);
+    sculpt_brush_stroke_exec(C, &sculpt_dummy_op);
+  }
+  location_is_dab = false;
+
+  MEM_SAFE_FREE(sculpt_segment_nodes.nodes);
+  sculpt_segment_nodes.totnode = 0;
+}
+
 void Widget_Sculpt::drag_start(VR_UI::Cursor &c)
 {
   if (c.bimanual) {
@@ -9394,6 +9564,14 @@ void Widget_Sculpt::drag_start(VR_UI::Cursor &c)
       stroke_started = true;
       /* Perform stroke */
       sculpt_brush_stroke_invoke(C, &sculpt_dummy_op, &sculpt_dummy_event);
+
+      /* Sample the controller between frames for the rest of the stroke (if the backend can). */
+      if (vr_can_poll_controller_positions()) {
+        sampler.start(vr_poll_controller_positions);
+      }
+      sample_seq = sampler.head();
+      stroke_last = *(Coord3Df *)VR_UI::cursor_position_get(VR_SPACE_BLENDER, cursor_side).m[3];
+      stroke_travel = 0.0f;
     }
   }
 
@@ -9438,8 +9616,9 @@ void Widget_Sculpt::drag_contd(VR_UI::Cursor &c)
   }
   else if (!param_mode) {
     bContext *C = vr_get_obj()->ctx;
-    if (CTX_data_active_object(C)) {
-      sculpt_brush_stroke_exec(C, &sculpt_dummy_op);
+    Object *ob = CTX_data_active_object(C);
+    if (ob) {
+      stroke_contd(C, ob);
     }
   }
 
@@ -9457,6 +9636,7 @@ void Widget_Sculpt::drag_stop(VR_UI::Cursor &c)
   }
 
   is_dragging = false;
+  sampler.stop();
 
   bContext *C = vr_get_obj()->ctx;
   Object *obedit = CTX_data_edit_object(C);
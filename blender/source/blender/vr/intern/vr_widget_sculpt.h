@@ -32,6 +32,8 @@
 
 #include "vr_widget.h"
 
+class VR_Tracking_Sampler;
+
 /* Interaction widget for the Sculpt tool. */
 class Widget_Sculpt : public VR_Widget
 {
@@ -54,6 +56,13 @@ protected:
 
 	static bool stroke_started;	/* Whether a sculpt stroke was started on drag_start(). */
 	static bool is_dragging; /* Whether the Sculpt tool is currently dragging. */
+
+	static VR_Tracking_Sampler sampler;	/* High-rate controller sampler (running during a stroke). */
+	static ui64 sample_seq;	/* Read position in the sampler. */
+	static Coord3Df stroke_last;	/* The last sampled stroke position (Blender space). */
+	static float stroke_travel;	/* Distance of the stroke since the last dab (Blender space). */
+
+	static void stroke_contd(struct bContext *C, struct Object *ob);	/* Apply the dabs of the stroke since the last frame. */
 public:
 	static VR_Side cursor_side;	/* Side of the current interaction cursor. */
 public:
@@ -61,6 +70,7 @@ public:
 	static int mode_orig;	/* The original sculpt mode on drag_start(). */
 	static int brush;	/* The current sculpt brush. */
 	static float location[3];	/* The 3D location of the sculpt cursor. */
+	static bool location_is_dab;	/* Whether location was set to an interpolated dab (instead of the cursor position). */
 	static float mouse[2];	/* The 2D-projected location of the sculpt cursor. */
 	static float pressure;	/* The sculpt trigger pressure. */
 	static bool use_trigger_pressure;	/* Whether to use trigger pressure (or sculpt strength). */
@@ -29,6 +29,7 @@
 
 #include "vr_types.h"
 #include <list>
+#include <vector>
 
 #include "vr_main.h"
 #include "vr_ui.h"
@@ -41,6 +42,7 @@
 
 #include "vr_math.h"
 #include "vr_draw.h"
+#include "vr_select_index.h"
 
 #include "BKE_context.h"
 #include "BKE_editmesh.h"
@@ -717,6 +719,85 @@ static void raycast_select_multiple(
 }
 
 
+/* Spatial index of the edit-mesh elements, per select mode (0: vertices, 1: edges, 2: faces).
+ * Kept between selections of the same mesh and refit to the current element positions (see VR_Select_Index). */
+static struct SelectIndexCache {
+	const BMesh *bm;	/* Mesh the index was built for. */
+	VR_Select_Index index;	/* Element index. */
+	std::vector<Coord3Df> co;	/* Element positions (object space). */
+	std::vector<uchar> result;	/* Classification of the last query (VR_Select_Index::Result). */
+} select_index_cache[3];
+
+void Widget_Select::clear_index()
+{
+	for (int i = 0; i < 3; ++i) {
+		SelectIndexCache& cache = select_index_cache[i];
+		cache.bm = NULL;
+		cache.index.clear();
+		std::vector<Coord3Df>().swap(cache.co);
+		std::vector<uchar>().swap(cache.result);
+	}
+}
+
+/* Classify the edit-mesh elements of a select mode against a selection volume (planes in world space).
+ * The element table must be ensured. co / result of the returned cache are indexed like the element table. */
+static const SelectIndexCache& select_index_query(
+	BMesh *bm, int mode,
+	const Mat44f& obmat, const float (*planes)[4], uint num_planes)
+{
+	SelectIndexCache& cache = select_index_cache[mode];
+	if (cache.bm != bm) {
+		/* Different edit-mesh: don't refit the index of another mesh. */
+		cache.index.clear();
+		cache.bm = bm;
+	}
+
+	/* Element positions (same as the per-element tests). */
+	const int num = (mode == 0) ? bm->totvert : ((mode == 1) ? bm->totedge : bm->totface);
+	cache.co.resize(num);
+	cache.result.resize(num);
+	if (num == 0) {
+		cache.index.clear();
+		return cache;
+	}
+	Coord3Df *co = &cache.co[0];
+	switch (mode) {
+	case 0: { /* Vertex */
+#pragma omp parallel for schedule(static, 4096)
+		for (int i = 0; i < num; ++i) {
+			co[i] = *(Coord3Df*)bm->vtable[i]->co;
+		}
+		break;
+	}
+	case 1: { /* Edge */
+#pragma omp parallel for schedule(static, 4096)
+		for (int i = 0; i < num; ++i) {
+			const BMEdge *e = bm->etable[i];
+			co[i] = (*(Coord3Df*)e->v1->co + *(Coord3Df*)e->v2->co) / 2.0f;
+		}
+		break;
+	}
+	default: { /* Face */
+#pragma omp parallel for schedule(static, 4096)
+		for (int i = 0; i < num; ++i) {
+			const BMFace *f = bm->ftable[i];
+			const BMLoop *l = f->l_first;
+			Coord3Df cent(0.0f, 0.0f, 0.0f);
+			for (int j = 0; j < f->len; ++j, l = l->next) {
+				cent += *(Coord3Df*)l->v->co;
+			}
+			cent /= f->len;
+			co[i] = cent;
+		}
+		break;
+	}
+	}
+
+	cache.index.refit((const float (*)[3])co, num);
+	cache.index.query(obmat, planes, num_planes, &cache.result[0]);
+	return cache;
+}
+
 /* Adapted from view3d_select.c */
 static void raycast_select_multiple_vertex(
 	const float& x0, const float& y0,
@@ -747,42 +828,53 @@ static void raycast_select_multiple_vertex(
 
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 
 	BM_mesh_elem_table_ensure(vc->em->bm, BM_VERT);
 	BMVert *sv = NULL;
 
 	const Mat44f& offset = *(Mat44f*)vc->obedit->obmat;
+	BMesh *bm = vc->em->bm;
+	float planes[5][4];
+	const uint num_planes = VR_Select_Index::rect_planes(rv3d->persmat, x0, y0, x1, y1, WIDGET_SELECT_RAYCAST_NEAR_CLIP, planes);
+	const SelectIndexCache& cache = select_index_query(bm, 0, offset, planes, num_planes);
+	/* The index doesn't know about the clipping region. */
+	const bool exact = (rv3d->rflag & RV3D_CLIPPING) != 0;
 	static Coord3Df pos;
 	BMVert *v;
-	BMIter iter;
-	BMesh *bm = vc->em->bm;
-	BM_ITER_MESH(v, &iter, bm, BM_VERTS_OF_MESH) {
+	for (int i = 0; i < bm->totvert; ++i) {
+		if (cache.result[i] == VR_Select_Index::RESULT_OUTSIDE) {
+			continue;
+		}
+		v = BM_vert_at_index(bm, i);
 		if (!BM_elem_flag_test(v, BM_ELEM_HIDDEN)) {
-			VR_Math::multiply_mat44_coord3D(pos, offset, *(Coord3Df*)v->co);
-			if (VR_Util::view3d_project(
-				ar, rv3d->persmat, false, (float*)&pos, screen_co,
-				(eV3DProjTest)(V3D_PROJ_TEST_CLIP_BB | V3D_PROJ_TEST_CLIP_NEAR)) == V3D_PROJ_RET_OK)
-			{
-				if (fabsf(screen_co[0] - center_x) < bounds_x &&
-					fabsf(screen_co[1] - center_y) < bounds_y) {
-					sv = v;
-					is_inside = true;
-					const bool is_select = BM_elem_flag_test(sv, BM_ELEM_SELECT);
-					const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
-					if (sel_op_result != -1) {
-						BM_vert_select_set(vc->em->bm, sv, sel_op_result);
-					}
+			if (exact || cache.result[i] == VR_Select_Index::RESULT_BORDER) {
+				/* Too close to the selection boundary for the index. */
+				VR_Math::multiply_mat44_coord3D(pos, offset, cache.co[i]);
+				if (VR_Util::view3d_project(
+					ar, rv3d->persmat, false, (float*)&pos, screen_co,
+					(eV3DProjTest)(V3D_PROJ_TEST_CLIP_BB | V3D_PROJ_TEST_CLIP_NEAR)) != V3D_PROJ_RET_OK ||
+					!(fabsf(screen_co[0] - center_x) < bounds_x &&
+					fabsf(screen_co[1] - center_y) < bounds_y))
+				{
+					continue;
 				}
 			}
+			sv = v;
+			is_inside = true;
+			const bool is_select = BM_elem_flag_test(sv, BM_ELEM_SELECT);
+			const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
+			if (sel_op_result != -1) {
+				BM_vert_select_set(vc->em->bm, sv, sel_op_result);
+			}
 		}
 	}
 
 	if (is_inside) {
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 }
 
@@ -806,7 +898,6 @@ static void raycast_select_multiple_edge(
 	center_x = (float)vr->tex_width * (center_x + 1.0f) / 2.0f;
 	center_y = (float)vr->tex_height * (1.0f - center_y) / 2.0f;
 	float screen_co[2];
-	float med_co[3];
 	bool is_inside = false;
 
 	if (!extend && !deselect) {
@@ -816,43 +907,53 @@ static void raycast_select_multiple_edge(
 
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 
 	BM_mesh_elem_table_ensure(vc->em->bm, BM_EDGE);
 	BMEdge *se = NULL;
 
 	const Mat44f& offset = *(Mat44f*)vc->obedit->obmat;
+	BMesh *bm = vc->em->bm;
+	float planes[5][4];
+	const uint num_planes = VR_Select_Index::rect_planes(rv3d->persmat, x0, y0, x1, y1, WIDGET_SELECT_RAYCAST_NEAR_CLIP, planes);
+	const SelectIndexCache& cache = select_index_query(bm, 1, offset, planes, num_planes);
+	/* The index doesn't know about the clipping region. */
+	const bool exact = (rv3d->rflag & RV3D_CLIPPING) != 0;
 	static Coord3Df pos;
 	BMEdge *e;
-	BMIter iter;
-	BMesh *bm = vc->em->bm;
-	BM_ITER_MESH(e, &iter, bm, BM_EDGES_OF_MESH) {
+	for (int i = 0; i < bm->totedge; ++i) {
+		if (cache.result[i] == VR_Select_Index::RESULT_OUTSIDE) {
+			continue;
+		}
+		e = BM_edge_at_index(bm, i);
 		if (!BM_elem_flag_test(e, BM_ELEM_HIDDEN)) {
-			*(Coord3Df*)med_co = (*(Coord3Df*)e->v1->co + *(Coord3Df*)e->v2->co) / 2.0f;
-			VR_Math::multiply_mat44_coord3D(pos, offset, *(Coord3Df*)med_co);
-			if (VR_Util::view3d_project(
-				ar, rv3d->persmat, false, (float*)&pos, screen_co,
-				(eV3DProjTest)(V3D_PROJ_TEST_CLIP_BB | V3D_PROJ_TEST_CLIP_NEAR)) == V3D_PROJ_RET_OK)
-			{
-				if (fabsf(screen_co[0] - center_x) < bounds_x &&
-					fabsf(screen_co[1] - center_y) < bounds_y) {
-					se = e;
-					is_inside = true;
-					const bool is_select = BM_elem_flag_test(se, BM_ELEM_SELECT);
-					const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
-					if (sel_op_result != -1) {
-						BM_edge_select_set(vc->em->bm, se, sel_op_result);
-					}
+			if (exact || cache.result[i] == VR_Select_Index::RESULT_BORDER) {
+				/* Too close to the selection boundary for the index. */
+				VR_Math::multiply_mat44_coord3D(pos, offset, cache.co[i]);
+				if (VR_Util::view3d_project(
+					ar, rv3d->persmat, false, (float*)&pos, screen_co,
+					(eV3DProjTest)(V3D_PROJ_TEST_CLIP_BB | V3D_PROJ_TEST_CLIP_NEAR)) != V3D_PROJ_RET_OK ||
+					!(fabsf(screen_co[0] - center_x) < bounds_x &&
+					fabsf(screen_co[1] - center_y) < bounds_y))
+				{
+					continue;
 				}
 			}
+			se = e;
+			is_inside = true;
+			const bool is_select = BM_elem_flag_test(se, BM_ELEM_SELECT);
+			const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
+			if (sel_op_result != -1) {
+				BM_edge_select_set(vc->em->bm, se, sel_op_result);
+			}
 		}
 	}
 
 	if (is_inside) {
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 }
 
@@ -885,50 +986,53 @@ static void raycast_select_multiple_face(
 
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 
 	BM_mesh_elem_table_ensure(vc->em->bm, BM_FACE);
 	BMFace *sf = NULL;
 
 	const Mat44f& offset = *(Mat44f*)vc->obedit->obmat;
+	BMesh *bm = vc->em->bm;
+	float planes[5][4];
+	const uint num_planes = VR_Select_Index::rect_planes(rv3d->persmat, x0, y0, x1, y1, WIDGET_SELECT_RAYCAST_NEAR_CLIP, planes);
+	const SelectIndexCache& cache = select_index_query(bm, 2, offset, planes, num_planes);
+	/* The index doesn't know about the clipping region. */
+	const bool exact = (rv3d->rflag & RV3D_CLIPPING) != 0;
 	static Coord3Df pos;
-	static Coord3Df cent;
 	BMFace *f;
-	BMLoop *l;
-	BMIter iter;
-	BMesh *bm = vc->em->bm;
-	BM_ITER_MESH(f, &iter, bm, BM_FACES_OF_MESH) {
-		l = f->l_first;
-		memset(&cent, 0, sizeof(float) * 3);
-		for (int i = 0; i < f->len; ++i, l = l->next) {
-			cent += *(Coord3Df*)l->v->co;
+	for (int i = 0; i < bm->totface; ++i) {
+		if (cache.result[i] == VR_Select_Index::RESULT_OUTSIDE) {
+			continue;
 		}
-		cent /= f->len;
+		f = BM_face_at_index(bm, i);
 		if (!BM_elem_flag_test(f, BM_ELEM_HIDDEN)) {
-			VR_Math::multiply_mat44_coord3D(pos, offset, cent);
-			if (VR_Util::view3d_project(
-				ar, rv3d->persmat, false, (float*)&pos, screen_co,
-				(eV3DProjTest)(V3D_PROJ_TEST_CLIP_BB | V3D_PROJ_TEST_CLIP_NEAR)) == V3D_PROJ_RET_OK)
-			{
-				if (fabsf(screen_co[0] - center_x) < bounds_x &&
-					fabsf(screen_co[1] - center_y) < bounds_y) {
-					sf = f;
-					is_inside = true;
-					const bool is_select = BM_elem_flag_test(sf, BM_ELEM_SELECT);
-					const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
-					if (sel_op_result != -1) {
-						BM_face_select_set(vc->em->bm, sf, sel_op_result);
-					}
+			if (exact || cache.result[i] == VR_Select_Index::RESULT_BORDER) {
+				/* Too close to the selection boundary for the index. */
+				VR_Math::multiply_mat44_coord3D(pos, offset, cache.co[i]);
+				if (VR_Util::view3d_project(
+					ar, rv3d->persmat, false, (float*)&pos, screen_co,
+					(eV3DProjTest)(V3D_PROJ_TEST_CLIP_BB | V3D_PROJ_TEST_CLIP_NEAR)) != V3D_PROJ_RET_OK ||
+					!(fabsf(screen_co[0] - center_x) < bounds_x &&
+					fabsf(screen_co[1] - center_y) < bounds_y))
+				{
+					continue;
 				}
 			}
+			sf = f;
+			is_inside = true;
+			const bool is_select = BM_elem_flag_test(sf, BM_ELEM_SELECT);
+			const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
+			if (sel_op_result != -1) {
+				BM_face_select_set(vc->em->bm, sf, sel_op_result);
+			}
 		}
 	}
 
 	if (is_inside) {
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 }
 
@@ -1408,39 +1512,49 @@ static void proximity_select_multiple_vertex(
 
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 
 	BM_mesh_elem_table_ensure(vc->em->bm, BM_VERT);
 	BMVert *sv = NULL;
 
 	const Mat44f& offset = *(Mat44f*)vc->obedit->obmat;
+	BMesh *bm = vc->em->bm;
+	float planes[6][4];
+	const uint num_planes = VR_Select_Index::box_planes(p0, p1, planes);
+	const SelectIndexCache& cache = select_index_query(bm, 0, offset, planes, num_planes);
 	static Coord3Df pos;
 	BMVert *v;
-	BMIter iter;
-	BMesh *bm = vc->em->bm;
-	BM_ITER_MESH(v, &iter, bm, BM_VERTS_OF_MESH) {
+	for (int i = 0; i < bm->totvert; ++i) {
+		if (cache.result[i] == VR_Select_Index::RESULT_OUTSIDE) {
+			continue;
+		}
+		v = BM_vert_at_index(bm, i);
 		if (!BM_elem_flag_test(v, BM_ELEM_HIDDEN)) {
-			VR_Math::multiply_mat44_coord3D(pos, offset, *(Coord3Df*)v->co);
-			if (fabs(pos.x - center.x) < bounds_x &&
-				fabs(pos.y - center.y) < bounds_y &&
-				fabs(pos.z - center.z) < bounds_z)
-			{
-				sv = v;
-				is_inside = true;
-				const bool is_select = BM_elem_flag_test(sv, BM_ELEM_SELECT);
-				const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
-				if (sel_op_result != -1) {
-					BM_vert_select_set(vc->em->bm, sv, sel_op_result);
+			if (cache.result[i] == VR_Select_Index::RESULT_BORDER) {
+				/* Too close to the selection boundary for the index. */
+				VR_Math::multiply_mat44_coord3D(pos, offset, cache.co[i]);
+				if (!(fabs(pos.x - center.x) < bounds_x &&
+					fabs(pos.y - center.y) < bounds_y &&
+					fabs(pos.z - center.z) < bounds_z))
+				{
+					continue;
 				}
 			}
+			sv = v;
+			is_inside = true;
+			const bool is_select = BM_elem_flag_test(sv, BM_ELEM_SELECT);
+			const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
+			if (sel_op_result != -1) {
+				BM_vert_select_set(vc->em->bm, sv, sel_op_result);
+			}
 		}
 	}
 
 	if (is_inside) {
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 }
 
@@ -1455,7 +1569,6 @@ static void proximity_select_multiple_edge(
 	float bounds_y = fabsf(p1.y - p0.y) / 2.0f;
 	float bounds_z = fabsf(p1.z - p0.z) / 2.0f;
 	Coord3Df center = p0 + (p1 - p0) / 2.0f;
-	float med_co[3];
 	bool is_inside = false;
 
 	if (!extend && !deselect) {
@@ -1465,40 +1578,49 @@ static void proximity_select_multiple_edge(
 
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 
 	BM_mesh_elem_table_ensure(vc->em->bm, BM_EDGE);
 	BMEdge *se = NULL;
 
 	const Mat44f& offset = *(Mat44f*)vc->obedit->obmat;
+	BMesh *bm = vc->em->bm;
+	float planes[6][4];
+	const uint num_planes = VR_Select_Index::box_planes(p0, p1, planes);
+	const SelectIndexCache& cache = select_index_query(bm, 1, offset, planes, num_planes);
 	static Coord3Df pos;
 	BMEdge *e;
-	BMIter iter;
-	BMesh *bm = vc->em->bm;
-	BM_ITER_MESH(e, &iter, bm, BM_EDGES_OF_MESH) {
+	for (int i = 0; i < bm->totedge; ++i) {
+		if (cache.result[i] == VR_Select_Index::RESULT_OUTSIDE) {
+			continue;
+		}
+		e = BM_edge_at_index(bm, i);
 		if (!BM_elem_flag_test(e, BM_ELEM_HIDDEN)) {
-			*(Coord3Df*)med_co = (*(Coord3Df*)e->v1->co + *(Coord3Df*)e->v2->co) / 2.0f;
-			VR_Math::multiply_mat44_coord3D(pos, offset, *(Coord3Df*)med_co);
-			if (fabs(pos.x - center.x) < bounds_x &&
-				fabs(pos.y - center.y) < bounds_y &&
-				fabs(pos.z - center.z) < bounds_z)
-			{
-				se = e;
-				is_inside = true;
-				const bool is_select = BM_elem_flag_test(se, BM_ELEM_SELECT);
-				const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
-				if (sel_op_result != -1) {
-					BM_edge_select_set(vc->em->bm, se, sel_op_result);
+			if (cache.result[i] == VR_Select_Index::RESULT_BORDER) {
+				/* Too close to the selection boundary for the index. */
+				VR_Math::multiply_mat44_coord3D(pos, offset, cache.co[i]);
+				if (!(fabs(pos.x - center.x) < bounds_x &&
+					fabs(pos.y - center.y) < bounds_y &&
+					fabs(pos.z - center.z) < bounds_z))
+				{
+					continue;
 				}
 			}
+			se = e;
+			is_inside = true;
+			const bool is_select = BM_elem_flag_test(se, BM_ELEM_SELECT);
+			const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
+			if (sel_op_result != -1) {
+				BM_edge_select_set(vc->em->bm, se, sel_op_result);
+			}
 		}
 	}
 
 	if (is_inside) {
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 }
 
@@ -1522,47 +1644,49 @@ static void proximity_select_multiple_face(
 
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 
 	BM_mesh_elem_table_ensure(vc->em->bm, BM_FACE);
 	BMFace *sf = NULL;
 
 	const Mat44f& offset = *(Mat44f*)vc->obedit->obmat;
+	BMesh *bm = vc->em->bm;
+	float planes[6][4];
+	const uint num_planes = VR_Select_Index::box_planes(p0, p1, planes);
+	const SelectIndexCache& cache = select_index_query(bm, 2, offset, planes, num_planes);
 	static Coord3Df pos;
-	static Coord3Df cent;
 	BMFace *f;
-	BMLoop *l;
-	BMIter iter;
-	BMesh *bm = vc->em->bm;
-	BM_ITER_MESH(f, &iter, bm, BM_FACES_OF_MESH) {
-		l = f->l_first;
-		memset(&cent, 0, sizeof(float) * 3);
-		for (int i = 0; i < f->len; ++i, l = l->next) {
-			cent += *(Coord3Df*)l->v->co;
+	for (int i = 0; i < bm->totface; ++i) {
+		if (cache.result[i] == VR_Select_Index::RESULT_OUTSIDE) {
+			continue;
 		}
-		cent /= f->len;
+		f = BM_face_at_index(bm, i);
 		if (!BM_elem_flag_test(f, BM_ELEM_HIDDEN)) {
-			VR_Math::multiply_mat44_coord3D(pos, offset, cent);
-			if (fabs(pos.x - center.x) < bounds_x &&
-				fabs(pos.y - center.y) < bounds_y &&
-				fabs(pos.z - center.z) < bounds_z)
-			{
-				sf = f;
-				is_inside = true;
-				const bool is_select = BM_elem_flag_test(sf, BM_ELEM_SELECT);
-				const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
-				if (sel_op_result != -1) {
-					BM_face_select_set(vc->em->bm, sf, sel_op_result);
+			if (cache.result[i] == VR_Select_Index::RESULT_BORDER) {
+				/* Too close to the selection boundary for the index. */
+				VR_Math::multiply_mat44_coord3D(pos, offset, cache.co[i]);
+				if (!(fabs(pos.x - center.x) < bounds_x &&
+					fabs(pos.y - center.y) < bounds_y &&
+					fabs(pos.z - center.z) < bounds_z))
+				{
+					continue;
 				}
 			}
+			sf = f;
+			is_inside = true;
+			const bool is_select = BM_elem_flag_test(sf, BM_ELEM_SELECT);
+			const int sel_op_result = ED_select_op_action_deselected(deselect ? SEL_OP_SUB : SEL_OP_ADD, is_select, is_inside);
+			if (sel_op_result != -1) {
+				BM_face_select_set(vc->em->bm, sf, sel_op_result);
+			}
 		}
 	}
 
 	if (is_inside) {
 		DEG_id_tag_update((ID*)vc->obedit->data, ID_RECALC_SELECT);
 		WM_event_add_notifier(C, NC_GEOM | ND_SELECT, vc->obedit->data);
-		ED_undo_push(C, "Select");
+		ED_mesh_undo_push_select(C, "Select");
 	}
 }
 
@@ -1650,7 +1774,7 @@ void Widget_Select::Proximity::click(VR_UI::Cursor& c)
 	}
 	/* Update manipulators */
 	Widget_Transform::update_manipulator();
-	ED_undo_push(C, "Select");
+	ED_mesh_undo_push_select(C, "Select");
 }
 
 void Widget_Select::Proximity::drag_start(VR_UI::Cursor& c)
@@ -48,6 +48,8 @@ public:
 
 	virtual void render(VR_Side side) override;	/* Apply the widget's custom render function (if any). */
 
+	static void clear_index();	/* Free the spatial indices of the edit-mesh elements. */
+
 	/* Interaction widget for object selection: Cursor ray-casting mode (default). */
 	class Raycast : public VR_Widget
 	{
@@ -33,6 +33,7 @@
 #include "vr_main.h"
 #include "vr_ui.h"
 
+#include "vr_widget_select.h"
 #include "vr_widget_switchlayout.h"
 #include "vr_widget_transform.h"
 #include "vr_widget_sculpt.h"
@@ -68,6 +69,7 @@ void Widget_SwitchLayout::click(VR_UI::Cursor& c)
 	bContext *C = vr_get_obj()->ctx;
 	if (CTX_data_edit_object(C)) {
 		ED_object_editmode_exit(C, EM_FREEDATA);
+		Widget_Select::clear_index();
 		/* Set transform space to normal by default. */
 		Widget_Transform::transform_space = VR_UI::TRANSFORMSPACE_NORMAL;
 	}
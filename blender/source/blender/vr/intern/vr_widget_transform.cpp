@@ -40,6 +40,7 @@
 
 #include "vr_math.h"
 #include "vr_draw.h"
+#include "vr_transform_session.h"
 
 #include "BLI_math.h"
 
@@ -108,6 +109,7 @@ float Widget_Transform::manip_scale_factor(0.2f);
 #endif
 
 Mat44f Widget_Transform::obmat_inv;
+VR_Transform_Session Widget_Transform::edit_session;
 
 /* Manipulator colors. */
 static const float c_manip[4][4] = { 1.0f, 0.2f, 0.322f, 0.4f,
@@ -669,6 +671,55 @@ void Widget_Transform::click(VR_UI::Cursor& c)
 	}
 }	
 
+void Widget_Transform::edit_session_begin(BMesh *bm, short selectmode)
+{
+	static std::vector<float*> co;
+	co.clear();
+
+	/* Collect each vertex once (shared by several selected edges / faces). */
+	BM_mesh_elem_hflag_disable_all(bm, BM_VERT, BM_ELEM_TAG, false);
+	BMIter iter;
+	if (selectmode & SCE_SELECT_VERTEX) {
+		BMVert *v;
+		BM_ITER_MESH(v, &iter, bm, BM_VERTS_OF_MESH) {
+			if (BM_elem_flag_test(v, BM_ELEM_SELECT)) {
+				co.push_back(v->co);
+			}
+		}
+	}
+	else if (selectmode & SCE_SELECT_EDGE) {
+		BMEdge *e;
+		BM_ITER_MESH(e, &iter, bm, BM_EDGES_OF_MESH) {
+			if (BM_elem_flag_test(e, BM_ELEM_SELECT)) {
+				BMVert *v[2] = { e->v1, e->v2 };
+				for (int i = 0; i < 2; ++i) {
+					if (!BM_elem_flag_test(v[i], BM_ELEM_TAG)) {
+						BM_elem_flag_enable(v[i], BM_ELEM_TAG);
+						co.push_back(v[i]->co);
+					}
+				}
+			}
+		}
+	}
+	else if (selectmode & SCE_SELECT_FACE) {
+		BMFace *f;
+		BMLoop *l;
+		BM_ITER_MESH(f, &iter, bm, BM_FACES_OF_MESH) {
+			if (BM_elem_flag_test(f, BM_ELEM_SELECT)) {
+				l = f->l_first;
+				for (int i = 0; i < f->len; ++i, l = l->next) {
+					if (!BM_elem_flag_test(l->v, BM_ELEM_TAG)) {
+						BM_elem_flag_enable(l->v, BM_ELEM_TAG);
+						co.push_back(l->v->co);
+					}
+				}
+			}
+		}
+	}
+
+	edit_session.begin(co.empty() ? NULL : &co[0], (uint)co.size(), bm);
+}
+
 void Widget_Transform::drag_start(VR_UI::Cursor& c)
 {
 	/* If other hand is already dragging, don't change the current state of the Transform tool. */
@@ -827,6 +878,9 @@ void Widget_Transform::drag_start(VR_UI::Cursor& c)
 
 	//is_dragging = true;
 
+	/* The edit session is started with the first transformation. */
+	edit_session.end();
+
 	/* Call drag_contd() immediately? */
 	Widget_Transform::obj.drag_contd(c);
 }
@@ -1465,48 +1519,14 @@ void Widget_Transform::drag_contd(VR_UI::Cursor& c)
 				if (snap_mode == VR_UI::SNAPMODE_ROTATION) {
 					memset(delta.m[3], 0, sizeof(float) * 3);
 				}
-				BMIter iter;
-
-				if (ts->selectmode & SCE_SELECT_VERTEX) {
-					BMVert *v;
-					BM_ITER_MESH(v, &iter, bm, BM_VERTS_OF_MESH) {
-						if (BM_elem_flag_test(v, BM_ELEM_SELECT)) {
-							float *co = v->co;
-							memcpy((float*)&temp1, co, sizeof(float) * 3);
-							mul_v3_m4v3(co, delta.m, (float*)&temp1);
-						}
-					}
-				}
-				else if (ts->selectmode & SCE_SELECT_EDGE) {
-					BMEdge *e;
-					BM_ITER_MESH(e, &iter, bm, BM_EDGES_OF_MESH) {
-						if (BM_elem_flag_test(e, BM_ELEM_SELECT)) {
-							float *co1 = e->v1->co;
-							float *co2 = e->v2->co;
-							memcpy((float*)&temp1, co1, sizeof(float) * 3);
-							memcpy((float*)&temp2, co2, sizeof(float) * 3);
-							mul_v3_m4v3(co1, delta.m, (float*)&temp1);
-							mul_v3_m4v3(co2, delta.m, (float*)&temp2);
-						}
-					}
-				}
-				else if (ts->selectmode & SCE_SELECT_FACE) {
-					BMFace *f;
-					BMLoop *l;
-					BM_ITER_MESH(f, &iter, bm, BM_FACES_OF_MESH) {
-						if (BM_elem_flag_test(f, BM_ELEM_SELECT)) {
-							l = f->l_first;
-							for (int i = 0; i < f->len; ++i, l = l->next) {
-								float *co = l->v->co;
-								memcpy((float*)&temp1, co, sizeof(float) * 3);
-								mul_v3_m4v3(co, delta.m, (float*)&temp1);
-							}
-						}
-					}
+				if (!edit_session.is_active(bm)) {
+					edit_session_begin(bm, ts->selectmode);
 				}
+				edit_session.accumulate(delta);
+				edit_session.apply();
 
-				/* Set recalc flags. */
-				DEG_id_tag_update((ID*)obedit->data, 0);
+				/* Set recalc flags (only the vertex positions changed). */
+				DEG_id_tag_update((ID*)obedit->data, ID_RECALC_GEOMETRY);
 				/* Exit object iteration loop. */
 				break;
 			}
@@ -1721,47 +1741,14 @@ void Widget_Transform::drag_contd(VR_UI::Cursor& c)
 				}
 				}
 
-				BMIter iter;
-				if (ts->selectmode & SCE_SELECT_VERTEX) {
-					BMVert *v;
-					BM_ITER_MESH(v, &iter, bm, BM_VERTS_OF_MESH) {
-						if (BM_elem_flag_test(v, BM_ELEM_SELECT)) {
-							float *co = v->co;
-							memcpy((float*)&temp1, co, sizeof(float) * 3);
-							mul_v3_m4v3(co, delta.m, (float*)&temp1);
-						}
-					}
-				}
-				else if (ts->selectmode & SCE_SELECT_EDGE) {
-					BMEdge *e;
-					BM_ITER_MESH(e, &iter, bm, BM_EDGES_OF_MESH) {
-						if (BM_elem_flag_test(e, BM_ELEM_SELECT)) {
-							float *co1 = e->v1->co;
-							float *co2 = e->v2->co;
-							memcpy((float*)&temp1, co1, sizeof(float) * 3);
-							memcpy((float*)&temp2, co2, sizeof(float) * 3);
-							mul_v3_m4v3(co1, delta.m, (float*)&temp1);
-							mul_v3_m4v3(co2, delta.m, (float*)&temp2);
-						}
-					}
-				}
-				else if (ts->selectmode & SCE_SELECT_FACE) {
-					BMFace *f;
-					BMLoop *l;
-					BM_ITER_MESH(f, &iter, bm, BM_FACES_OF_MESH) {
-						if (BM_elem_flag_test(f, BM_ELEM_SELECT)) {
-							l = f->l_first;
-							for (int i = 0; i < f->len; ++i, l = l->next) {
-								float *co = l->v->co;
-								memcpy((float*)&temp1, co, sizeof(float) * 3);
-								mul_v3_m4v3(co, delta.m, (float*)&temp1);
-							}
-						}
-					}
+				if (!edit_session.is_active(bm)) {
+					edit_session_begin(bm, ts->selectmode);
 				}
+				edit_session.accumulate(delta);
+				edit_session.apply();
 
-				/* Set recalc flags. */
-				DEG_id_tag_update((ID*)obedit->data, 0);
+				/* Set recalc flags (only the vertex positions changed). */
+				DEG_id_tag_update((ID*)obedit->data, ID_RECALC_GEOMETRY);
 				/* Exit object iteration loop. */
 				break;
 			}
@@ -1882,6 +1869,7 @@ void Widget_Transform::drag_stop(VR_UI::Cursor& c)
 	}
 
 	is_dragging = false;
+	edit_session.end();
 
 	if (Widget_Sculpt::is_dragging) {
 		return;
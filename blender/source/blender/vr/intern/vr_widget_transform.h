@@ -35,6 +35,8 @@
 /* Whether to scale the manipulator to the selected object(s). */
 #define WIDGET_TRANSFORM_SCALE_MANIP_TO_SELECTION 0
 
+class VR_Transform_Session;
+
 /* Interaction widget for the Transform tool. */
 class Widget_Transform : public VR_Widget
 {
@@ -81,6 +83,9 @@ class Widget_Transform : public VR_Widget
 	static float manip_scale_factor;	/* Scale factor for the manipulator (relative to longest selected object axis). */
 
 	static Mat44f obmat_inv;	/* The inverse of the selected object's transformation (edit mode). */
+	static VR_Transform_Session edit_session;	/* The vertices transformed by the current drag (edit mode). */
+
+	static void edit_session_begin(struct BMesh *bm, short selectmode);	/* Start the edit session with the vertices of the selected elements. */
 
 	static void raycast_select_manipulator(const Coord3Df& p, bool *extrude=0);	/* Select a manipulator component with raycast selection. */
 public:
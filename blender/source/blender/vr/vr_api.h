@@ -43,6 +43,7 @@ int vr_api_init_ui(void* device, void* context);	/* Initialize the internal obje
 int vr_api_init_ui(void* display, void* drawable, void* context);	/* Initialize the internal object (OpenGL). */
 #endif
 int vr_api_update_tracking_ui();	/* Update VR tracking including UI button states. */
+int vr_api_set_replay_time(double time);	/* Drive the UI clock from a replayed session (seconds since its start; negative: use the system time again). */
 int vr_api_execute_operations();	/* Execute UI operations. */
 int vr_api_execute_post_render_operations();	/* Execute post-render UI operations. */
 const float *vr_api_get_navigation_matrix(int inverse);	/* Get the navigation matrix (or inverse navigation matrix) from the UI module. */
@@ -60,6 +61,11 @@ int vr_api_get_transforms_remote(); /* Transfer remote tracking transforms to VR
 int vr_api_get_controller_states_remote(); /* Transfer remote controller states to VR module. */
 int vr_api_uninit_remote(int timeout_sec); /* Stop remote device stream. */
 
+int vr_api_predict_tracking(double time); /* Add the tracking matrices as samples and predict them to the display time. */
+int vr_api_predict_eye(int side, double time); /* Predict an eye matrix again, right before the eye is drawn. */
+int vr_api_predict_submit(double time); /* The frame was submitted to the VR device. */
+int vr_api_predict_reset(); /* Discard all tracking samples and latency measurements. */
+
 #ifdef __cplusplus
 }
 #endif
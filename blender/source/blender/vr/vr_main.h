@@ -83,7 +83,9 @@ typedef enum VR_Type
   ,
   VR_TYPE_MAGICLEAP = 5 /* Magic Leap API was used for implementation. */
   ,
-	VR_TYPES = 6 /* Number of VR types. */
+	VR_TYPE_SIMULATED = 6	/* Built-in replay of a recorded session (see vr_simulated.h). */
+	,
+	VR_TYPES = 7 /* Number of VR types. */
 } VR_Type; 
 
 /* Simple struct for 3D input device information. */
@@ -112,6 +114,7 @@ typedef struct VR {
 	int ui_initialized; /* Whether the VR UI module was successfully initialized and currently active. */
 
 	int tracking;		/* Whether the VR tracking state is currently active/valid. */
+	int direct_rendering;	/* Whether the eyes are rendered into the images of the VR device directly (instead of being blitted into them). */
 
 	float fx[VR_SIDES]; /* Horizontal focal length, in "image-width" - units(1 = image width). */
 	float fy[VR_SIDES]; /* Vertical focal length, in "image-height" - units(1 = image height). */
@@ -157,11 +160,15 @@ void vr_draw_region_unbind(struct ARegion *ar, int side);	/* Unbind the VR offsc
 
 /* VR module functions. */
 int vr_update_tracking(void);	/* Update tracking. */
+void vr_update_eye_tracking(int side);	/* Refresh the eye matrix (predicted to the display time) right before drawing the eye. */
+int vr_can_poll_controller_positions(void);	/* Whether the VR dll can report the controller positions between two frames. */
+int vr_poll_controller_positions(float t_controller[VR_MAX_CONTROLLERS][4][4]);	/* Query the controller positions (real space) from the latest tracking data of the VR dll (untracked controllers are left unchanged). Can be called from any thread. */
 int vr_blit(void);	/* Blit the hmd. */
 
 /* Interaction/execution function. */
 void vr_do_interaction(void);	/* Interaction update/execution where the VR module may alter scene data. */
 void vr_do_post_render_interaction(void);	/* Interaction update/execution for special operations (i.e. undo/redo) that need to be called after the scene is rendered.	*/
+int vr_replay(struct bContext *C);	/* Replay the simulated VR session as fast as possible, without drawing (if requested, see vr_simulated.h). Returns 1 if it was replayed. */
 
 /* Drawing functions. */
 void vr_pre_scene_render(int side);	/* Pre-scene rendering call. */
@@ -179,6 +179,8 @@ enum {
   OPTYPE_LOCK_BYPASS = (1 << 9),
   /** Special type of undo which doesn't store itself multiple times. */
   OPTYPE_UNDO_GROUPED = (1 << 10),
+  /** The operator only changes the selection, its undo push (#OPTYPE_UNDO) can store less. */
+  OPTYPE_UNDO_SELECT = (1 << 11),
 };
 
 /** For #WM_cursor_grab_enable wrap axis. */
@@ -674,6 +674,7 @@ static void wm_draw_window_offscreen(bContext *C, wmWindow *win, bool stereo)
         for (int view = 0; view < 2; ++view) {
 #endif
           wm_draw_region_stereo_set(bmain, sa, ar, view);
+          vr_update_eye_tracking(view);
           vr_draw_region_bind(ar, view);
           ED_region_do_draw(C, ar);
           vr_draw_region_unbind(ar, view);
@@ -682,6 +683,11 @@ static void wm_draw_window_offscreen(bContext *C, wmWindow *win, bool stereo)
         /* Perform post-render interactions. */
         vr_do_post_render_interaction();
 
+        /* Replay a simulated session without drawing, once the viewports exist (benchmarking). */
+        if (vr_replay(C)) {
+          wm_exit_schedule_delayed(C);
+        }
+
         ar->do_draw = false;
         CTX_wm_region_set(C, NULL);
         continue;
@@ -1417,6 +1417,7 @@ static bool wm_file_write(bContext *C, const char *filepath, int fileflags, Repo
     }
 
     SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS, G_FILE_COMPRESS);
+    SET_FLAG_FROM_TEST(G.fileflags, fileflags & G_FILE_COMPRESS_FRAMES, G_FILE_COMPRESS_FRAMES);
 
     /* prevent background mode scripts from clobbering history */
     if (do_history) {
@@ -2550,6 +2551,13 @@ static void save_set_compress(wmOperator *op)
       RNA_property_boolean_set(op->ptr, prop, (U.flag & USER_FILECOMPRESS) != 0);
     }
   }
+
+  prop = RNA_struct_find_property(op->ptr, "compress_frames");
+  if (!RNA_property_is_set(op->ptr, prop)) {
+    if (G.save_over) { /* keep flag for existing file */
+      RNA_property_boolean_set(op->ptr, prop, (G.fileflags & G_FILE_COMPRESS_FRAMES) != 0);
+    }
+  }
 }
 
 static void save_set_filepath(bContext *C, wmOperator *op)
@@ -2618,6 +2626,8 @@ static int wm_save_as_mainfile_exec(bContext *C, wmOperator *op)
 
   /* set compression flag */
   SET_FLAG_FROM_TEST(fileflags, RNA_boolean_get(op->ptr, "compress"), G_FILE_COMPRESS);
+  SET_FLAG_FROM_TEST(
+      fileflags, RNA_boolean_get(op->ptr, "compress_frames"), G_FILE_COMPRESS_FRAMES);
   SET_FLAG_FROM_TEST(fileflags, RNA_boolean_get(op->ptr, "relative_remap"), G_FILE_RELATIVE_REMAP);
   SET_FLAG_FROM_TEST(
       fileflags,
@@ -2682,6 +2692,12 @@ void WM_OT_save_as_mainfile(wmOperatorType *ot)
                                  FILE_DEFAULTDISPLAY,
                                  FILE_SORT_ALPHA);
   RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+  RNA_def_boolean(ot->srna,
+                  "compress_frames",
+                  false,
+                  "Compress in Frames",
+                  "Compress in independent frames, faster to save and load "
+                  "(not readable by older versions of Blender)");
   RNA_def_boolean(ot->srna,
                   "relative_remap",
                   true,
@@ -2754,6 +2770,12 @@ void WM_OT_save_mainfile(wmOperatorType *ot)
                                  FILE_DEFAULTDISPLAY,
                                  FILE_SORT_ALPHA);
   RNA_def_boolean(ot->srna, "compress", false, "Compress", "Write compressed .blend file");
+  RNA_def_boolean(ot->srna,
+                  "compress_frames",
+                  false,
+                  "Compress in Frames",
+                  "Compress in independent frames, faster to save and load "
+                  "(not readable by older versions of Blender)");
   RNA_def_boolean(ot->srna,
                   "relative_remap",
                   false,
@@ -0,0 +1,181 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include <string.h>
+#include <vector>
+
+extern "C" {
+#include "BLI_bitmap.h"
+#include "BLI_utildefines.h"
+#include "DNA_meshdata_types.h"
+#include "MEM_guardedalloc.h"
+#include "PIL_time.h"
+}
+
+/* Selection undo on a benchmark mesh: a grid of GRID_SIZE x GRID_SIZE quads, with a sequence of
+ * box selections. Compares storing the select bits of each step as run-length encoded changes
+ * (selection undo steps) with copying the mesh arrays (edit-mesh undo steps). */
+#define GRID_SIZE 1000
+#define NUM_STEPS 32
+/* Every n-th selection step stores absolute select bits instead of changes. */
+#define ABSOLUTE_INTERVAL 16
+/* Chunk size of the array store used by edit-mesh undo (see ARRAY_CHUNK_SIZE). */
+#define ARRAY_CHUNK_SIZE 256
+
+/* Stand-in for BMVert / BMEdge / BMFace, so reading the flags has the same memory stride. */
+typedef struct BenchElem {
+  char hflag;
+  char pad[63];
+} BenchElem;
+
+typedef struct BenchGrid {
+  std::vector<BenchElem> elems[3]; /* Vertices, edges, faces. */
+} BenchGrid;
+
+static void grid_select_box(BenchGrid &grid, int x0, int y0, int x1, int y1, bool select)
+{
+  const int n = GRID_SIZE;
+  for (int y = y0; y <= y1; y++) {
+    for (int x = x0; x <= x1; x++) {
+      grid.elems[0][y * (n + 1) + x].hflag = select;
+      if (x < x1) {
+        grid.elems[1][y * n + x].hflag = select;
+      }
+      if (y < y1) {
+        grid.elems[1][n * (n + 1) + x * n + y].hflag = select;
+      }
+      if (x < x1 && y < y1) {
+        grid.elems[2][y * n + x].hflag = select;
+      }
+    }
+  }
+}
+
+TEST(bitmap, SelectUndoPerformance)
+{
+  const int n = GRID_SIZE;
+  BenchGrid grid;
+  BenchElem zero = {0};
+  grid.elems[0].resize((n + 1) * (n + 1), zero);
+  grid.elems[1].resize(2 * n * (n + 1), zero);
+  grid.elems[2].resize(n * n, zero);
+
+  size_t totelem[3];
+  BLI_bitmap *prev[3], *curr[3], *delta[3];
+  for (int t = 0; t < 3; t++) {
+    totelem[t] = grid.elems[t].size();
+    prev[t] = BLI_BITMAP_NEW(totelem[t], __func__);
+    curr[t] = BLI_BITMAP_NEW(totelem[t], __func__);
+    delta[t] = BLI_BITMAP_NEW(totelem[t], __func__);
+  }
+
+  /* Arrays copied by an edit-mesh undo step (vertices, edges, faces and quad corners). */
+  const size_t mesh_size[3] = {totelem[0] * sizeof(MVert),
+                               totelem[1] * sizeof(MEdge),
+                               totelem[2] * (sizeof(MPoly) + 4 * sizeof(MLoop))};
+  const size_t mesh_step_size = mesh_size[0] + mesh_size[1] + mesh_size[2];
+  std::vector<char> mesh_data(mesh_step_size);
+
+  size_t size_mesh = 0, size_mesh_chunks = 0, size_select = 0;
+  double time_mesh = 0.0, time_select = 0.0, time_select_decode = 0.0;
+
+  srand(0);
+  for (int step = 0; step < NUM_STEPS; step++) {
+    /* Mostly hand-sized boxes, some large ones, and clearing the selection now and then. */
+    if (step % 8 == 7) {
+      grid_select_box(grid, 0, 0, n, n, false);
+    }
+    else {
+      const int size = (step % 4 == 3) ? n / 2 : n / 20;
+      const int x0 = rand() % (n - size), y0 = rand() % (n - size);
+      grid_select_box(grid, x0, y0, x0 + size, y0 + size, step % 3 != 2);
+    }
+
+    /* Edit-mesh step: every element written to the mesh arrays (a lower bound for converting
+     * the BMesh, without custom-data and the array store). */
+    double time = PIL_check_seconds_timer();
+    char *mesh_data_iter = &mesh_data[0];
+    for (int t = 0; t < 3; t++) {
+      const size_t elem_size = mesh_size[t] / totelem[t];
+      const BenchElem *elem = &grid.elems[t][0];
+      for (size_t i = 0; i < totelem[t]; i++, mesh_data_iter += elem_size) {
+        memcpy(mesh_data_iter, &elem[i], elem_size);
+      }
+    }
+    time_mesh += PIL_check_seconds_timer() - time;
+    size_mesh += mesh_step_size;
+
+    const bool is_absolute = (step % ABSOLUTE_INTERVAL) == 0;
+    for (int t = 0; t < 3; t++) {
+      /* Selection step: the select bits, as changes to the previous step. */
+      time = PIL_check_seconds_timer();
+      BLI_bitmap_set_all(curr[t], false, totelem[t]);
+      const BenchElem *elem = &grid.elems[t][0];
+      for (size_t i = 0; i < totelem[t]; i++) {
+        if (elem[i].hflag) {
+          BLI_BITMAP_ENABLE(curr[t], i);
+        }
+      }
+      BLI_bitmap_copy_all(delta[t], curr[t], totelem[t]);
+      BLI_bitmap_xor_all(delta[t], prev[t], totelem[t]);
+      uint runs_len;
+      uint *runs = BLI_bitmap_rle_encode(is_absolute ? curr[t] : delta[t], totelem[t], &runs_len);
+      size_select += sizeof(*runs) * runs_len;
+      time_select += PIL_check_seconds_timer() - time;
+
+      /* Restoring: apply the changes and write back the flags that differ. */
+      time = PIL_check_seconds_timer();
+      if (is_absolute) {
+        BLI_bitmap_set_all(prev[t], false, totelem[t]);
+      }
+      BLI_bitmap_rle_xor(prev[t], runs, runs_len);
+      BenchElem *elem_write = &grid.elems[t][0];
+      for (size_t i = 0; i < totelem[t]; i++) {
+        const char hflag = BLI_BITMAP_TEST_BOOL(prev[t], i);
+        if (elem_write[i].hflag != hflag) {
+          elem_write[i].hflag = hflag;
+        }
+      }
+      time_select_decode += PIL_check_seconds_timer() - time;
+      EXPECT_EQ(memcmp(prev[t], curr[t], BLI_BITMAP_SIZE(totelem[t])), 0);
+
+      /* With the array store, edit-mesh undo only stores the chunks that changed. */
+      for (size_t chunk = 0; chunk < totelem[t]; chunk += ARRAY_CHUNK_SIZE) {
+        const size_t chunk_end = MIN2(chunk + ARRAY_CHUNK_SIZE, totelem[t]);
+        for (size_t i = chunk; i < chunk_end; i++) {
+          if (BLI_BITMAP_TEST(delta[t], i)) {
+            size_mesh_chunks += (chunk_end - chunk) * mesh_size[t] / totelem[t];
+            break;
+          }
+        }
+      }
+
+      MEM_freeN(runs);
+    }
+  }
+
+  for (int t = 0; t < 3; t++) {
+    MEM_freeN(prev[t]);
+    MEM_freeN(curr[t]);
+    MEM_freeN(delta[t]);
+  }
+
+  EXPECT_LT(size_select, size_mesh_chunks);
+
+  printf("%d selection steps on a %dx%d grid (%zu vertices, %zu edges, %zu faces):\n",
+         NUM_STEPS,
+         n,
+         n,
+         totelem[0],
+         totelem[1],
+         totelem[2]);
+  printf("  Edit-mesh steps: %.2f MB (%.2f MB in changed chunks), %f ms per step\n",
+         size_mesh / (1024.0 * 1024.0),
+         size_mesh_chunks / (1024.0 * 1024.0),
+         time_mesh * 1000.0 / NUM_STEPS);
+  printf("  Selection steps: %.2f MB, encode %f ms per step, decode %f ms per step\n",
+         size_select / (1024.0 * 1024.0),
+         time_select * 1000.0 / NUM_STEPS,
+         time_select_decode * 1000.0 / NUM_STEPS);
+}
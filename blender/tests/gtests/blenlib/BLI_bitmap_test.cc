@@ -0,0 +1,127 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+extern "C" {
+#include "BLI_bitmap.h"
+#include "BLI_utildefines.h"
+#include "MEM_guardedalloc.h"
+}
+
+static void bitmap_expect_eq(const BLI_bitmap *a, const BLI_bitmap *b, size_t bits)
+{
+  for (size_t i = 0; i < bits; i++) {
+    EXPECT_EQ(BLI_BITMAP_TEST_BOOL(a, i), BLI_BITMAP_TEST_BOOL(b, i)) << i;
+  }
+}
+
+/* Encode and decode into a cleared bitmap, returns the number of runs. */
+static uint bitmap_rle_round_trip(const BLI_bitmap *bitmap, size_t bits)
+{
+  uint runs_len;
+  uint *runs = BLI_bitmap_rle_encode(bitmap, bits, &runs_len);
+
+  size_t sum = 0;
+  for (uint i = 0; i < runs_len; i++) {
+    sum += runs[i];
+    /* Only the first run may be empty. */
+    if (i > 0) {
+      EXPECT_GT(runs[i], 0u);
+    }
+  }
+  EXPECT_EQ(sum, bits);
+
+  BLI_bitmap *decoded = BLI_BITMAP_NEW(bits, __func__);
+  BLI_bitmap_rle_xor(decoded, runs, runs_len);
+  bitmap_expect_eq(decoded, bitmap, bits);
+
+  MEM_freeN(decoded);
+  MEM_freeN(runs);
+  return runs_len;
+}
+
+TEST(bitmap, RLEEmptyAndFull)
+{
+  const size_t bits = 100;
+  BLI_bitmap *bitmap = BLI_BITMAP_NEW(bits, __func__);
+  EXPECT_EQ(bitmap_rle_round_trip(bitmap, bits), 1u);
+  EXPECT_EQ(bitmap_rle_round_trip(bitmap, 0), 1u);
+
+  /* The unused bits of the last block are ignored. */
+  BLI_bitmap_set_all(bitmap, true, bits);
+  EXPECT_EQ(bitmap_rle_round_trip(bitmap, bits), 2u);
+  EXPECT_EQ(bitmap_rle_round_trip(bitmap, 64), 2u);
+
+  MEM_freeN(bitmap);
+}
+
+TEST(bitmap, RLERanges)
+{
+  const size_t bits = 1000;
+  BLI_bitmap *bitmap = BLI_BITMAP_NEW(bits, __func__);
+  /* Runs that start and end within, at and across block boundaries. */
+  const size_t ranges[][2] = {{0, 1}, {5, 31}, {32, 64}, {70, 71}, {95, 200}, {640, 999}};
+  for (size_t r = 0; r < ARRAY_SIZE(ranges); r++) {
+    for (size_t i = ranges[r][0]; i < ranges[r][1]; i++) {
+      BLI_BITMAP_ENABLE(bitmap, i);
+    }
+  }
+  EXPECT_EQ(bitmap_rle_round_trip(bitmap, bits), 2u * ARRAY_SIZE(ranges) + 1);
+
+  /* No empty first run and a set last bit. */
+  BLI_bitmap_flip_all(bitmap, bits);
+  EXPECT_EQ(bitmap_rle_round_trip(bitmap, bits), 2u * ARRAY_SIZE(ranges));
+
+  MEM_freeN(bitmap);
+}
+
+TEST(bitmap, RLERandom)
+{
+  srand(1);
+  for (int iter = 0; iter < 20; iter++) {
+    const size_t bits = 1 + (size_t)(rand() % 3000);
+    BLI_bitmap *bitmap = BLI_BITMAP_NEW(bits, __func__);
+    /* From scattered bits to long runs. */
+    const int density = 1 + iter % 5;
+    for (size_t i = 0; i < bits; i++) {
+      if (rand() % (density * density) == 0) {
+        BLI_BITMAP_FLIP(bitmap, i);
+      }
+    }
+    bitmap_rle_round_trip(bitmap, bits);
+    MEM_freeN(bitmap);
+  }
+}
+
+TEST(bitmap, RLEXorDelta)
+{
+  const size_t bits = 5000;
+  BLI_bitmap *state_a = BLI_BITMAP_NEW(bits, __func__);
+  BLI_bitmap *state_b = BLI_BITMAP_NEW(bits, __func__);
+  for (size_t i = 0; i < bits; i++) {
+    BLI_BITMAP_SET(state_a, i, (i / 7) % 3 == 0);
+    BLI_BITMAP_SET(state_b, i, (i / 7) % 3 == 0 || (i > 1000 && i < 1500));
+  }
+
+  /* Store b as its difference to a. */
+  BLI_bitmap *delta = BLI_BITMAP_NEW(bits, __func__);
+  BLI_bitmap_copy_all(delta, state_b, bits);
+  BLI_bitmap_xor_all(delta, state_a, bits);
+  uint runs_len;
+  uint *runs = BLI_bitmap_rle_encode(delta, bits, &runs_len);
+  EXPECT_LE(runs_len, 2u * 500u / 21u + 5u);
+
+  /* Applying the delta goes from a to b and back. */
+  BLI_bitmap *state = BLI_BITMAP_NEW(bits, __func__);
+  BLI_bitmap_copy_all(state, state_a, bits);
+  BLI_bitmap_rle_xor(state, runs, runs_len);
+  bitmap_expect_eq(state, state_b, bits);
+  BLI_bitmap_rle_xor(state, runs, runs_len);
+  bitmap_expect_eq(state, state_a, bits);
+
+  MEM_freeN(runs);
+  MEM_freeN(state);
+  MEM_freeN(delta);
+  MEM_freeN(state_b);
+  MEM_freeN(state_a);
+}
@@ -13,6 +13,7 @@ extern "C" {
 #include "BLI_listbase.h"
 #include "BLI_mempool.h"
 #include "BLI_task.h"
+#include "BLI_threads.h"
 
 #include "PIL_time.h"
 
@@ -190,3 +191,83 @@ TEST(task, ListBaseIter100k)
 {
   task_listbase_test("ListBase parallel iteration - Threaded - 100000 items", 100000, true);
 }
+
+/* *** Task scheduler overhead. *** */
+
+#define NUM_EMPTY_TASKS 1000000
+#define NUM_FAN_OUT_RUNS 10000
+
+static void task_empty_func(TaskPool *UNUSED(pool), void *UNUSED(taskdata), int UNUSED(thread_id))
+{
+}
+
+/* Pushes half of the tasks, the other half is pushed from within them. */
+static void task_push_empty_func(TaskPool *pool, void *UNUSED(taskdata), int thread_id)
+{
+  BLI_task_pool_push_from_thread(pool, task_empty_func, NULL, false, TASK_PRIORITY_LOW, thread_id);
+}
+
+static void task_count_func(TaskPool *pool, void *UNUSED(taskdata), int UNUSED(thread_id))
+{
+  uint32_t *count = (uint32_t *)BLI_task_pool_userdata(pool);
+  atomic_add_and_fetch_uint32(count, 1);
+}
+
+static void task_scheduler_test(const int num_threads)
+{
+  TaskScheduler *scheduler = BLI_task_scheduler_create(num_threads);
+  printf("\n========== %d threads ==========\n", BLI_task_scheduler_num_threads(scheduler));
+
+  /* Throughput of tasks which do nothing, pushed from the main thread. */
+  TaskPool *pool = BLI_task_pool_create(scheduler, NULL);
+  double init_time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_EMPTY_TASKS; i++) {
+    BLI_task_pool_push(pool, task_empty_func, NULL, false, TASK_PRIORITY_LOW);
+  }
+  BLI_task_pool_work_and_wait(pool);
+  double time = PIL_check_seconds_timer() - init_time;
+  printf("\tEmpty tasks from main thread: %.2f million tasks/s\n", NUM_EMPTY_TASKS / time * 1e-6);
+
+  /* Same, with half of the tasks pushed from the worker threads. */
+  init_time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_EMPTY_TASKS / 2; i++) {
+    BLI_task_pool_push(pool, task_push_empty_func, NULL, false, TASK_PRIORITY_LOW);
+  }
+  BLI_task_pool_work_and_wait(pool);
+  time = PIL_check_seconds_timer() - init_time;
+  printf("\tEmpty tasks from task threads: %.2f million tasks/s\n", NUM_EMPTY_TASKS / time * 1e-6);
+  BLI_task_pool_free(pool);
+
+  /* Latency of a fan-out to one tiny task per thread and waiting for all of them. */
+  uint32_t count = 0;
+  const int num_tasks = BLI_task_scheduler_num_threads(scheduler);
+  pool = BLI_task_pool_create(scheduler, &count);
+  init_time = PIL_check_seconds_timer();
+  for (int run = 0; run < NUM_FAN_OUT_RUNS; run++) {
+    for (int i = 0; i < num_tasks; i++) {
+      BLI_task_pool_push(pool, task_count_func, NULL, false, TASK_PRIORITY_HIGH);
+    }
+    BLI_task_pool_work_and_wait(pool);
+  }
+  time = PIL_check_seconds_timer() - init_time;
+  EXPECT_EQ(count, NUM_FAN_OUT_RUNS * num_tasks);
+  printf("\tFan-out/fan-in of %d tasks: %.2f us on average over %d runs\n",
+         num_tasks,
+         time / NUM_FAN_OUT_RUNS * 1e6,
+         NUM_FAN_OUT_RUNS);
+  BLI_task_pool_free(pool);
+
+  BLI_task_scheduler_free(scheduler);
+}
+
+TEST(task, Scheduler)
+{
+  BLI_threadapi_init();
+
+  const int num_threads[3] = {2, 4, BLI_system_thread_count()};
+  for (int i = 0; i < ARRAY_SIZE(num_threads); i++) {
+    task_scheduler_test(num_threads[i]);
+  }
+
+  BLI_threadapi_exit();
+}
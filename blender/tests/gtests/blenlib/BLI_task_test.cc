@@ -2,6 +2,8 @@
 
 #include "testing/testing.h"
 #include <string.h>
+#include <thread>
+#include <vector>
 
 #include "atomic_ops.h"
 
@@ -11,6 +13,9 @@ extern "C" {
 #include "BLI_listbase.h"
 #include "BLI_mempool.h"
 #include "BLI_task.h"
+#include "BLI_threads.h"
+
+#include "PIL_time.h"
 
 #include "MEM_guardedalloc.h"
 };
@@ -127,3 +132,247 @@ TEST(task, ListBaseIter)
   MEM_freeN(items_buffer);
   BLI_threadapi_exit();
 }
+
+/* *** Task pools. *** */
+
+/* Number of threads of the schedulers the pools are tested with, one means there only is the
+ * background fallback thread. */
+static const int num_scheduler_threads[3] = {1, 2, 8};
+
+#define TREE_FANOUT 4
+#define TREE_DEPTH 6
+
+typedef struct TaskTreeData {
+  uint32_t num_leaves;
+  uint32_t num_nodes;
+} TaskTreeData;
+
+/* Pushes its children from the worker thread, the way the dependency graph evaluation does. */
+static void task_tree_func(TaskPool *pool, void *taskdata, int thread_id)
+{
+  TaskTreeData *data = (TaskTreeData *)BLI_task_pool_userdata(pool);
+  const int depth = POINTER_AS_INT(taskdata);
+
+  atomic_add_and_fetch_uint32(&data->num_nodes, 1);
+  if (depth == TREE_DEPTH) {
+    atomic_add_and_fetch_uint32(&data->num_leaves, 1);
+    return;
+  }
+  BLI_task_pool_delayed_push_begin(pool, thread_id);
+  for (int i = 0; i < TREE_FANOUT; i++) {
+    BLI_task_pool_push_from_thread(
+        pool, task_tree_func, POINTER_FROM_INT(depth + 1), false, TASK_PRIORITY_HIGH, thread_id);
+  }
+  BLI_task_pool_delayed_push_end(pool, thread_id);
+}
+
+TEST(task, PoolTree)
+{
+  BLI_threadapi_init();
+
+  int num_leaves = 1;
+  for (int i = 0; i < TREE_DEPTH; i++) {
+    num_leaves *= TREE_FANOUT;
+  }
+
+  for (int t = 0; t < ARRAY_SIZE(num_scheduler_threads); t++) {
+    TaskScheduler *scheduler = BLI_task_scheduler_create(num_scheduler_threads[t]);
+    TaskTreeData data = {0, 0};
+
+    /* Suspended pool, used twice. */
+    TaskPool *pool = BLI_task_pool_create_suspended(scheduler, &data);
+    for (int run = 0; run < 2; run++) {
+      for (int i = 0; i < TREE_FANOUT; i++) {
+        BLI_task_pool_push(pool, task_tree_func, POINTER_FROM_INT(1), false, TASK_PRIORITY_LOW);
+      }
+      BLI_task_pool_work_wait_and_reset(pool);
+      EXPECT_EQ(data.num_leaves, (run + 1) * num_leaves);
+    }
+    BLI_task_pool_free(pool);
+
+    /* Regular pool, with tasks being run while the main thread is still pushing. */
+    data.num_leaves = data.num_nodes = 0;
+    pool = BLI_task_pool_create(scheduler, &data);
+    for (int i = 0; i < TREE_FANOUT; i++) {
+      BLI_task_pool_push(pool, task_tree_func, POINTER_FROM_INT(1), false, TASK_PRIORITY_HIGH);
+    }
+    BLI_task_pool_work_and_wait(pool);
+    EXPECT_EQ(data.num_leaves, num_leaves);
+    EXPECT_EQ(data.num_nodes, (num_leaves * TREE_FANOUT - 1) / (TREE_FANOUT - 1) - 1);
+    BLI_task_pool_free(pool);
+
+    BLI_task_scheduler_free(scheduler);
+  }
+
+  BLI_threadapi_exit();
+}
+
+/* Tasks which wait for a pool of their own, in which only the inner tasks may be run. */
+static void task_inner_func(TaskPool *pool, void *UNUSED(taskdata), int UNUSED(thread_id))
+{
+  uint32_t *count = (uint32_t *)BLI_task_pool_userdata(pool);
+  atomic_add_and_fetch_uint32(count, 1);
+}
+
+static void task_outer_func(TaskPool *pool, void *UNUSED(taskdata), int thread_id)
+{
+  TaskScheduler *scheduler = (TaskScheduler *)BLI_task_pool_userdata(pool);
+  uint32_t count = 0;
+
+  TaskPool *inner_pool = BLI_task_pool_create(scheduler, &count);
+  for (int i = 0; i < 100; i++) {
+    BLI_task_pool_push_from_thread(
+        inner_pool, task_inner_func, NULL, false, TASK_PRIORITY_LOW, thread_id);
+  }
+  BLI_task_pool_work_and_wait(inner_pool);
+  EXPECT_EQ(count, 100);
+  BLI_task_pool_free(inner_pool);
+}
+
+TEST(task, PoolNested)
+{
+  BLI_threadapi_init();
+
+  for (int t = 0; t < ARRAY_SIZE(num_scheduler_threads); t++) {
+    TaskScheduler *scheduler = BLI_task_scheduler_create(num_scheduler_threads[t]);
+    TaskPool *pool = BLI_task_pool_create(scheduler, scheduler);
+    for (int i = 0; i < 100; i++) {
+      BLI_task_pool_push(pool, task_outer_func, NULL, false, TASK_PRIORITY_LOW);
+    }
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+    BLI_task_scheduler_free(scheduler);
+  }
+
+  BLI_threadapi_exit();
+}
+
+/* Pools used at the same time from threads which are not scheduler threads. */
+static void task_foreign_thread_func(TaskScheduler *scheduler, uint32_t *count)
+{
+  for (int run = 0; run < 10; run++) {
+    TaskPool *pool = BLI_task_pool_create(scheduler, count);
+    for (int i = 0; i < 100; i++) {
+      BLI_task_pool_push(pool, task_inner_func, NULL, false, TASK_PRIORITY_LOW);
+    }
+    BLI_task_pool_work_and_wait(pool);
+    BLI_task_pool_free(pool);
+  }
+}
+
+TEST(task, PoolForeignThreads)
+{
+  BLI_threadapi_init();
+
+  for (int t = 0; t < ARRAY_SIZE(num_scheduler_threads); t++) {
+    TaskScheduler *scheduler = BLI_task_scheduler_create(num_scheduler_threads[t]);
+    uint32_t counts[5] = {0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; i++) {
+      threads.push_back(std::thread(task_foreign_thread_func, scheduler, &counts[i]));
+    }
+    task_foreign_thread_func(scheduler, &counts[4]);
+    for (size_t i = 0; i < threads.size(); i++) {
+      threads[i].join();
+    }
+    for (int i = 0; i < 5; i++) {
+      EXPECT_EQ(counts[i], 1000);
+    }
+    BLI_task_scheduler_free(scheduler);
+  }
+
+  BLI_threadapi_exit();
+}
+
+/* Tasks pushed from a thread which is not a scheduler thread, and only run by
+ * that thread (there are no workers besides the background fallback thread):
+ * high priority tasks first, each priority in push order. */
+static void task_order_func(TaskPool *pool, void *taskdata, int UNUSED(thread_id))
+{
+  std::vector<int> *order = (std::vector<int> *)BLI_task_pool_userdata(pool);
+  order->push_back(*(int *)taskdata);
+}
+
+static void task_order_thread_func(TaskScheduler *scheduler, std::vector<int> *order)
+{
+  static int numbers[100];
+  TaskPool *pool = BLI_task_pool_create(scheduler, order);
+  for (int i = 0; i < 100; i++) {
+    numbers[i] = i;
+    BLI_task_pool_push(pool,
+                       task_order_func,
+                       &numbers[i],
+                       false,
+                       (i < 50) ? TASK_PRIORITY_LOW : TASK_PRIORITY_HIGH);
+  }
+  BLI_task_pool_work_and_wait(pool);
+  BLI_task_pool_free(pool);
+}
+
+TEST(task, PoolForeignThreadOrder)
+{
+  BLI_threadapi_init();
+
+  TaskScheduler *scheduler = BLI_task_scheduler_create(1);
+  std::vector<int> order;
+  std::thread thread(task_order_thread_func, scheduler, &order);
+  thread.join();
+  ASSERT_EQ(order.size(), 100);
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(order[i], (i < 50) ? 50 + i : i - 50);
+  }
+  BLI_task_scheduler_free(scheduler);
+
+  BLI_threadapi_exit();
+}
+
+/* Background pools are run without anyone waiting for them, and can be canceled. */
+static void task_background_func(TaskPool *pool, void *taskdata, int UNUSED(thread_id))
+{
+  uint32_t *count = (uint32_t *)BLI_task_pool_userdata(pool);
+  const int sleep_ms = *(int *)taskdata;
+  if (!BLI_task_pool_canceled(pool)) {
+    PIL_sleep_ms(sleep_ms);
+  }
+  atomic_add_and_fetch_uint32(count, 1);
+}
+
+TEST(task, PoolBackground)
+{
+  BLI_threadapi_init();
+
+  for (int t = 0; t < ARRAY_SIZE(num_scheduler_threads); t++) {
+    TaskScheduler *scheduler = BLI_task_scheduler_create(num_scheduler_threads[t]);
+    uint32_t count = 0;
+
+    TaskPool *pool = BLI_task_pool_create_background(scheduler, &count);
+    for (int i = 0; i < 10; i++) {
+      int *sleep_ms = (int *)MEM_mallocN(sizeof(int), __func__);
+      *sleep_ms = 0;
+      BLI_task_pool_push(pool, task_background_func, sleep_ms, true, TASK_PRIORITY_LOW);
+    }
+    for (int i = 0; i < 1000 && count < 10; i++) {
+      PIL_sleep_ms(1);
+    }
+    EXPECT_EQ(count, 10);
+
+    /* Tasks which didn't start are freed without being run. */
+    count = 0;
+    const int num_tasks = 1000;
+    for (int i = 0; i < num_tasks; i++) {
+      int *sleep_ms = (int *)MEM_mallocN(sizeof(int), __func__);
+      *sleep_ms = 1;
+      BLI_task_pool_push(pool, task_background_func, sleep_ms, true, TASK_PRIORITY_LOW);
+    }
+    BLI_task_pool_cancel(pool);
+    EXPECT_LT(count, num_tasks);
+    const uint32_t num_run = count;
+    PIL_sleep_ms(10);
+    EXPECT_EQ(count, num_run);
+
+    BLI_task_pool_free(pool);
+    BLI_task_scheduler_free(scheduler);
+  }
+
+  BLI_threadapi_exit();
+}
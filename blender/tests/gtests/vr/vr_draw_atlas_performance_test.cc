@@ -0,0 +1,273 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_draw_atlas.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+extern "C" {
+#include "PIL_time.h"
+}
+
+/* The images VR_Draw::init() registers with the atlas (see vr_draw.cpp). */
+#include "icon_cursor.png.h"
+#include "icon_mouse_cursor.png.h"
+#include "icon_nav_grabair.png.h"
+#include "icon_nav_joystick.png.h"
+#include "icon_nav_teleport.png.h"
+#include "icon_nav_locktrans.png.h"
+#include "icon_nav_locktransup.png.h"
+#include "icon_nav_lockrot.png.h"
+#include "icon_nav_lockrotup.png.h"
+#include "icon_nav_lockscale.png.h"
+#include "icon_nav_lockscalereal.png.h"
+#include "icon_ctrl.png.h"
+#include "icon_shift.png.h"
+#include "icon_alt.png.h"
+#include "icon_select.png.h"
+#include "icon_select_raycast.png.h"
+#include "icon_select_proximity.png.h"
+#include "icon_cursor_teleport.png.h"
+#include "icon_cursor_worldorigin.png.h"
+#include "icon_cursor_objorigin.png.h"
+#include "icon_transform.png.h"
+#include "icon_move.png.h"
+#include "icon_rotate.png.h"
+#include "icon_scale.png.h"
+#include "icon_annotate.png.h"
+#include "icon_measure.png.h"
+#include "icon_mesh.png.h"
+#include "icon_mesh_plane.png.h"
+#include "icon_mesh_cube.png.h"
+#include "icon_mesh_circle.png.h"
+#include "icon_mesh_cylinder.png.h"
+#include "icon_mesh_cone.png.h"
+#include "icon_mesh_grid.png.h"
+#include "icon_mesh_monkey.png.h"
+#include "icon_mesh_uvsphere.png.h"
+#include "icon_mesh_icosphere.png.h"
+#include "icon_extrude.png.h"
+#include "icon_extrude_individual.png.h"
+#include "icon_extrude_normals.png.h"
+#include "icon_insetfaces.png.h"
+#include "icon_bevel.png.h"
+#include "icon_loopcut.png.h"
+#include "icon_knife.png.h"
+#include "icon_sculpt.png.h"
+#include "icon_sculpt_draw.png.h"
+#include "icon_sculpt_clay.png.h"
+#include "icon_sculpt_claystrips.png.h"
+#include "icon_sculpt_layer.png.h"
+#include "icon_sculpt_inflate.png.h"
+#include "icon_sculpt_blob.png.h"
+#include "icon_sculpt_crease.png.h"
+#include "icon_sculpt_smooth.png.h"
+#include "icon_sculpt_flatten.png.h"
+#include "icon_sculpt_fill.png.h"
+#include "icon_sculpt_scrape.png.h"
+#include "icon_sculpt_pinch.png.h"
+#include "icon_sculpt_grab.png.h"
+#include "icon_sculpt_snakehook.png.h"
+#include "icon_sculpt_thumb.png.h"
+#include "icon_sculpt_nudge.png.h"
+#include "icon_sculpt_rotate.png.h"
+#include "icon_sculpt_mask.png.h"
+#include "icon_sculpt_simplify.png.h"
+#include "icon_animation.png.h"
+#include "icon_delete.png.h"
+#include "icon_duplicate.png.h"
+#include "icon_join.png.h"
+#include "icon_separate.png.h"
+#include "icon_undo.png.h"
+#include "icon_redo.png.h"
+#include "icon_manip_global.png.h"
+#include "icon_manip_local.png.h"
+#include "icon_manip_normal.png.h"
+#include "icon_manip_plus.png.h"
+#include "icon_manip_minus.png.h"
+#include "icon_objectmode.png.h"
+#include "icon_editmode.png.h"
+#include "icon_object.png.h"
+#include "icon_vertex.png.h"
+#include "icon_edge.png.h"
+#include "icon_face.png.h"
+#include "icon_toolsettings.png.h"
+#include "icon_box_empty.png.h"
+#include "icon_box_filled.png.h"
+#include "icon_plus.png.h"
+#include "icon_minus.png.h"
+#include "icon_reset.png.h"
+#include "menu_background.png.h"
+#include "menu_colorwheel.png.h"
+#include "ascii.png.h"
+#include "str_on.png.h"
+#include "str_off.png.h"
+#include "str_x.png.h"
+#include "str_y.png.h"
+#include "str_z.png.h"
+#include "str_xy.png.h"
+#include "str_yz.png.h"
+#include "str_zx.png.h"
+
+static const uchar *const ui_pngs[] = {
+    icon_cursor_png,
+    icon_mouse_cursor_png,
+    icon_nav_grabair_png,
+    icon_nav_joystick_png,
+    icon_nav_teleport_png,
+    icon_nav_locktrans_png,
+    icon_nav_locktransup_png,
+    icon_nav_lockrot_png,
+    icon_nav_lockrotup_png,
+    icon_nav_lockscale_png,
+    icon_nav_lockscalereal_png,
+    icon_ctrl_png,
+    icon_shift_png,
+    icon_alt_png,
+    icon_select_png,
+    icon_select_raycast_png,
+    icon_select_proximity_png,
+    icon_cursor_teleport_png,
+    icon_cursor_worldorigin_png,
+    icon_cursor_objorigin_png,
+    icon_transform_png,
+    icon_move_png,
+    icon_rotate_png,
+    icon_scale_png,
+    icon_annotate_png,
+    icon_measure_png,
+    icon_mesh_png,
+    icon_mesh_plane_png,
+    icon_mesh_cube_png,
+    icon_mesh_circle_png,
+    icon_mesh_cylinder_png,
+    icon_mesh_cone_png,
+    icon_mesh_grid_png,
+    icon_mesh_monkey_png,
+    icon_mesh_uvsphere_png,
+    icon_mesh_icosphere_png,
+    icon_extrude_png,
+    icon_extrude_individual_png,
+    icon_extrude_normals_png,
+    icon_insetfaces_png,
+    icon_bevel_png,
+    icon_loopcut_png,
+    icon_knife_png,
+    icon_sculpt_png,
+    icon_sculpt_draw_png,
+    icon_sculpt_clay_png,
+    icon_sculpt_claystrips_png,
+    icon_sculpt_layer_png,
+    icon_sculpt_inflate_png,
+    icon_sculpt_blob_png,
+    icon_sculpt_crease_png,
+    icon_sculpt_smooth_png,
+    icon_sculpt_flatten_png,
+    icon_sculpt_fill_png,
+    icon_sculpt_scrape_png,
+    icon_sculpt_pinch_png,
+    icon_sculpt_grab_png,
+    icon_sculpt_snakehook_png,
+    icon_sculpt_thumb_png,
+    icon_sculpt_nudge_png,
+    icon_sculpt_rotate_png,
+    icon_sculpt_mask_png,
+    icon_sculpt_simplify_png,
+    icon_animation_png,
+    icon_delete_png,
+    icon_duplicate_png,
+    icon_join_png,
+    icon_separate_png,
+    icon_undo_png,
+    icon_redo_png,
+    icon_manip_global_png,
+    icon_manip_local_png,
+    icon_manip_normal_png,
+    icon_manip_plus_png,
+    icon_manip_minus_png,
+    icon_objectmode_png,
+    icon_editmode_png,
+    icon_object_png,
+    icon_vertex_png,
+    icon_edge_png,
+    icon_face_png,
+    icon_toolsettings_png,
+    icon_box_empty_png,
+    icon_box_filled_png,
+    icon_plus_png,
+    icon_minus_png,
+    icon_reset_png,
+    menu_background_png,
+    menu_colorwheel_png,
+    ascii_png,
+    str_on_png,
+    str_off_png,
+    str_x_png,
+    str_y_png,
+    str_z_png,
+    str_xy_png,
+    str_yz_png,
+    str_zx_png,
+};
+static const uint num_ui_pngs = sizeof(ui_pngs) / sizeof(*ui_pngs);
+
+#define NUM_ITERATIONS 10
+
+/* CPU side of the VR UI texture startup (vr_init_ui() and the first frames after it).
+ * The upload to the graphics API is the same for both paths, apart from the number of
+ * textures created (one per image before, one per atlas page now), and is not measured. */
+TEST(vr_draw_atlas, StartupTime)
+{
+  const std::string path = ::testing::internal::TempDir() + "vr_draw_atlas_performance.cache";
+
+  /* Previously: every texture decoded its PNG on first bind. */
+  double time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    for (uint j = 0; j < num_ui_pngs; j++) {
+      uchar *img;
+      uint w, h;
+      ASSERT_TRUE(VR_Draw_Atlas::decode_png(ui_pngs[j], img, w, h));
+      free(img);
+    }
+  }
+  const double time_decode = (PIL_check_seconds_timer() - time) / NUM_ITERATIONS;
+
+  /* First run: decode, pack and write the cache. */
+  VR_Draw_Atlas atlas;
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    ASSERT_TRUE(atlas.build(ui_pngs, num_ui_pngs));
+  }
+  const double time_build = (PIL_check_seconds_timer() - time) / NUM_ITERATIONS;
+
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    ASSERT_TRUE(atlas.save(path.c_str()));
+  }
+  const double time_save = (PIL_check_seconds_timer() - time) / NUM_ITERATIONS;
+
+  /* Later runs: validate the key and read the cache. */
+  VR_Draw_Atlas cached;
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    const ui64 key = VR_Draw_Atlas::fingerprint(ui_pngs, num_ui_pngs);
+    ASSERT_TRUE(cached.load(path.c_str(), key, num_ui_pngs));
+  }
+  const double time_load = (PIL_check_seconds_timer() - time) / NUM_ITERATIONS;
+  remove(path.c_str());
+
+  size_t bytes = 0;
+  for (size_t i = 0; i < atlas.pages.size(); i++) {
+    bytes += atlas.pages[i].pixels.size();
+  }
+  printf("%u images -> %u atlas pages (%.1f MB)\n",
+         num_ui_pngs,
+         (uint)atlas.pages.size(),
+         (double)bytes / (1024.0 * 1024.0));
+  printf("Decode all images: %f ms\n", time_decode * 1000.0);
+  printf("Atlas build (first run): %f ms (+ %f ms save)\n", time_build * 1000.0, time_save * 1000.0);
+  printf("Atlas load (cached): %f ms (%.1fx)\n", time_load * 1000.0, time_decode / time_load);
+}
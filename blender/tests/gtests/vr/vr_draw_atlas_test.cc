@@ -0,0 +1,182 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_draw_atlas.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "icon_alt.png.h"
+#include "icon_ctrl.png.h"
+#include "ascii.png.h"
+
+/* Copies, so the gtest macros don't need the class constants' addresses. */
+static const uint padding = VR_Draw_Atlas::padding;
+static const uint page_size = VR_Draw_Atlas::page_size;
+
+static std::string cache_path(const char *name)
+{
+  return ::testing::internal::TempDir() + name;
+}
+
+static bool overlaps(const VR_Draw_Atlas::Region &a, const VR_Draw_Atlas::Region &b)
+{
+  const uint p = padding;
+  return a.page == b.page && a.x < b.x + b.w + 2 * p && b.x < a.x + a.w + 2 * p &&
+         a.y < b.y + b.h + 2 * p && b.y < a.y + a.h + 2 * p;
+}
+
+TEST(vr_draw_atlas, PackNoOverlap)
+{
+  /* Roughly the mix of VR UI images: many small icons, a few wide menu strips. */
+  std::vector<uint> sizes;
+  for (uint i = 0; i < 120; i++) {
+    sizes.push_back(64 + (i * 37) % 96);
+    sizes.push_back(64 + (i * 53) % 64);
+  }
+  sizes.push_back(1024);
+  sizes.push_back(512);
+  const uint n = (uint)sizes.size() / 2;
+
+  VR_Draw_Atlas atlas;
+  ASSERT_TRUE(atlas.pack((const uint(*)[2]) & sizes[0], n));
+  ASSERT_EQ(atlas.regions.size(), (size_t)n);
+  ASSERT_GE(atlas.pages.size(), 1u);
+
+  for (uint i = 0; i < n; i++) {
+    const VR_Draw_Atlas::Region &r = atlas.regions[i];
+    EXPECT_EQ(r.w, sizes[i * 2]);
+    EXPECT_EQ(r.h, sizes[i * 2 + 1]);
+    ASSERT_LT(r.page, atlas.pages.size());
+    const VR_Draw_Atlas::Page &page = atlas.pages[r.page];
+    EXPECT_GE(r.x, padding);
+    EXPECT_GE(r.y, padding);
+    EXPECT_LE(r.x + r.w + padding, page.w);
+    EXPECT_LE(r.y + r.h + padding, page.h);
+    EXPECT_FLOAT_EQ(r.uv[0], (float)r.x / page.w);
+    EXPECT_FLOAT_EQ(r.uv[3], (float)(r.y + r.h) / page.h);
+    for (uint j = 0; j < i; j++) {
+      EXPECT_FALSE(overlaps(r, atlas.regions[j])) << i << " overlaps " << j;
+    }
+  }
+}
+
+TEST(vr_draw_atlas, PackMultiplePages)
+{
+  const uint s = page_size / 2;
+  const uint sizes[5][2] = {{s, s}, {s, s}, {s, s}, {s, s}, {16, 16}};
+  VR_Draw_Atlas atlas;
+  ASSERT_TRUE(atlas.pack(sizes, 5));
+  EXPECT_GT(atlas.pages.size(), 1u);
+  for (size_t i = 0; i < atlas.pages.size(); i++) {
+    EXPECT_LE(atlas.pages[i].w, page_size);
+    EXPECT_LE(atlas.pages[i].h, page_size);
+  }
+
+  /* Too large for a page. */
+  const uint huge[1][2] = {{page_size, 8}};
+  EXPECT_FALSE(atlas.pack(huge, 1));
+}
+
+TEST(vr_draw_atlas, BlitPadding)
+{
+  const uint sizes[2][2] = {{2, 2}, {3, 1}};
+  VR_Draw_Atlas atlas;
+  ASSERT_TRUE(atlas.pack(sizes, 2));
+
+  const uchar img[2 * 2 * 4] = {1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4};
+  atlas.blit(0, img);
+
+  const VR_Draw_Atlas::Region &r = atlas.regions[0];
+  const VR_Draw_Atlas::Page &page = atlas.pages[r.page];
+  const int p = (int)padding;
+  /* Every pixel of the padded rect equals the nearest image pixel. */
+  for (int y = -p; y < (int)r.h + p; y++) {
+    for (int x = -p; x < (int)r.w + p; x++) {
+      const int ix = x < 0 ? 0 : (x >= (int)r.w ? r.w - 1 : x);
+      const int iy = y < 0 ? 0 : (y >= (int)r.h ? r.h - 1 : y);
+      const uchar *px = &page.pixels[((r.y + y) * page.w + (r.x + x)) * 4];
+      EXPECT_EQ(px[0], img[(iy * r.w + ix) * 4]) << x << "," << y;
+    }
+  }
+}
+
+TEST(vr_draw_atlas, BuildAndCache)
+{
+  const uchar *pngs[3] = {icon_alt_png, icon_ctrl_png, ascii_png};
+  VR_Draw_Atlas atlas;
+  ASSERT_TRUE(atlas.build(pngs, 3));
+  const ui64 key = VR_Draw_Atlas::fingerprint(pngs, 3);
+  EXPECT_EQ(atlas.key, key);
+
+  /* The image pixels end up in their regions. */
+  uchar *img;
+  uint w, h;
+  ASSERT_TRUE(VR_Draw_Atlas::decode_png(ascii_png, img, w, h));
+  const VR_Draw_Atlas::Region &r = atlas.regions[2];
+  EXPECT_EQ(r.w, w);
+  EXPECT_EQ(r.h, h);
+  const VR_Draw_Atlas::Page &page = atlas.pages[r.page];
+  for (uint y = 0; y < h; y += 7) {
+    EXPECT_EQ(memcmp(&page.pixels[((r.y + y) * page.w + r.x) * 4], img + y * w * 4, w * 4), 0);
+  }
+  free(img);
+
+  /* Round trip. */
+  const std::string path = cache_path("vr_draw_atlas_test.cache");
+  ASSERT_TRUE(atlas.save(path.c_str()));
+  VR_Draw_Atlas loaded;
+  ASSERT_TRUE(loaded.load(path.c_str(), key, 3));
+  EXPECT_EQ(loaded.key, key);
+  ASSERT_EQ(loaded.pages.size(), atlas.pages.size());
+  ASSERT_EQ(loaded.regions.size(), atlas.regions.size());
+  for (size_t i = 0; i < atlas.pages.size(); i++) {
+    EXPECT_EQ(loaded.pages[i].w, atlas.pages[i].w);
+    EXPECT_EQ(loaded.pages[i].h, atlas.pages[i].h);
+    EXPECT_TRUE(loaded.pages[i].pixels == atlas.pages[i].pixels);
+  }
+  for (size_t i = 0; i < atlas.regions.size(); i++) {
+    EXPECT_EQ(loaded.regions[i].x, atlas.regions[i].x);
+    EXPECT_EQ(loaded.regions[i].y, atlas.regions[i].y);
+    EXPECT_FLOAT_EQ(loaded.regions[i].uv[2], atlas.regions[i].uv[2]);
+  }
+
+  /* Stale caches are rejected. */
+  EXPECT_FALSE(loaded.load(path.c_str(), key + 1, 3));
+  EXPECT_TRUE(loaded.pages.empty());
+  EXPECT_FALSE(loaded.load(path.c_str(), key, 2));
+  EXPECT_FALSE(loaded.load(cache_path("vr_draw_atlas_test.missing").c_str(), key, 3));
+
+  /* Truncated files are rejected. */
+  std::vector<uchar> head(64);
+  FILE *f = fopen(path.c_str(), "rb");
+  ASSERT_TRUE(f != NULL);
+  ASSERT_EQ(fread(&head[0], head.size(), 1, f), 1u);
+  fclose(f);
+  f = fopen(path.c_str(), "wb");
+  ASSERT_TRUE(f != NULL);
+  fwrite(&head[0], head.size(), 1, f);
+  fclose(f);
+  EXPECT_FALSE(loaded.load(path.c_str(), key, 3));
+
+  remove(path.c_str());
+}
+
+TEST(vr_draw_atlas, Fingerprint)
+{
+  const uchar *pngs[2] = {icon_alt_png, icon_ctrl_png};
+  const uchar *swapped[2] = {icon_ctrl_png, icon_alt_png};
+  const ui64 key = VR_Draw_Atlas::fingerprint(pngs, 2);
+  EXPECT_EQ(key, VR_Draw_Atlas::fingerprint(pngs, 2));
+  EXPECT_NE(key, VR_Draw_Atlas::fingerprint(swapped, 2));
+  EXPECT_NE(key, VR_Draw_Atlas::fingerprint(pngs, 1));
+
+  /* A change in the image data changes its chunk CRC. */
+  std::vector<uchar> copy(icon_alt_png, icon_alt_png + sizeof(icon_alt_png));
+  /* CRC of the IHDR chunk: signature (8) + length (4) + type (4) + data (13). */
+  copy[8 + 8 + 13] ^= 0xff;
+  const uchar *modified[2] = {&copy[0], icon_ctrl_png};
+  EXPECT_NE(key, VR_Draw_Atlas::fingerprint(modified, 2));
+}
@@ -0,0 +1,206 @@
+/* Apache License, Version 2.0 */
+
+#include "vr_draw_testing.h"
+
+static VR_Draw_Batch::DepthState depth_state(bool test, bool write)
+{
+  VR_Draw_Batch::DepthState d;
+  d.func = test ? 1 : 2;
+  d.test = true;
+  d.write = write;
+  return d;
+}
+
+/* Roughly what Widget_Menu::render_icon() draws for an 8-item pie menu:
+ * a background, a frame, and for each item a highlight, an icon and a label. */
+static void add_pie_menu(VR_Draw_Batch &batch, const int *icons, const int *ascii)
+{
+  const Mat44f m = identity();
+  const float frame[10][3] = {{0}};
+  batch.add_quad(m, quad, white);
+  batch.add_strip(m, frame, 10, white);
+  for (int i = 0; i < 8; i++) {
+    batch.add_quad(m, quad, white);
+    batch.add_quad(m, quad, white, &icons[i], quad_uvs, 0.5f);
+    for (int c = 0; c < 6; c++) {
+      batch.add_quad(m, quad, white, ascii, quad_uvs, 0.5f);
+    }
+  }
+}
+
+TEST(vr_draw_batch, PieMenuDrawCalls)
+{
+  VR_Draw_Batch batch;
+  CountingBatchBackend backend;
+  batch.set_backend(&backend);
+  batch.set_depth(depth_state(true, false));
+
+  int icons[8];
+  int ascii;
+  add_pie_menu(batch, icons, &ascii);
+  batch.flush();
+
+  const VR_Draw_Batch::Stats &stats = batch.get_stats();
+  EXPECT_EQ(stats.commands, 2u + 8u * 8u);
+  EXPECT_EQ(stats.flushes, 1u);
+  EXPECT_EQ(backend.begins, 1);
+  EXPECT_EQ(backend.ends, 1);
+
+  /* One draw per texture switch (icon / font) instead of one per primitive. */
+  EXPECT_EQ(stats.draw_calls, 16u);
+  EXPECT_EQ(stats.state_changes, 1u + 16u);
+  EXPECT_LT(stats.draw_calls * 4, stats.commands);
+
+  /* The ranges cover all the vertices, in submission order. */
+  uint next = 0;
+  for (size_t i = 0; i < backend.draws.size(); i++) {
+    EXPECT_EQ(backend.draws[i].first, next);
+    next += backend.draws[i].count;
+  }
+  EXPECT_EQ(next, stats.vertices);
+  EXPECT_EQ(next, (uint)backend.verts.size());
+  EXPECT_TRUE(batch.empty());
+}
+
+TEST(vr_draw_batch, SharedTextureSingleDraw)
+{
+  /* Once icons and glyphs come from the same texture, the whole menu is a single draw. */
+  VR_Draw_Batch batch;
+  CountingBatchBackend backend;
+  batch.set_backend(&backend);
+
+  int atlas;
+  const Mat44f m = identity();
+  for (int i = 0; i < 100; i++) {
+    batch.add_quad(m, quad, white);
+    batch.add_quad(m, quad, white, &atlas, quad_uvs);
+  }
+  batch.flush();
+
+  EXPECT_EQ(batch.get_stats().commands, 200u);
+  EXPECT_EQ(batch.get_stats().draw_calls, 1u);
+  EXPECT_EQ(batch.get_stats().state_changes, 2u);
+  ASSERT_EQ(backend.draws.size(), 1u);
+  EXPECT_EQ(backend.draws[0].texture, (const void *)&atlas);
+}
+
+TEST(vr_draw_batch, DepthStateSplitsRanges)
+{
+  VR_Draw_Batch batch;
+  CountingBatchBackend backend;
+  batch.set_backend(&backend);
+  const Mat44f m = identity();
+
+  batch.set_depth(depth_state(true, false));
+  batch.add_quad(m, quad, white);
+  batch.add_quad(m, quad, white);
+  batch.set_depth(depth_state(true, true));
+  batch.add_quad(m, quad, white);
+  batch.set_depth(depth_state(true, false));
+  batch.add_quad(m, quad, white);
+  batch.flush();
+
+  ASSERT_EQ(backend.draws.size(), 3u);
+  EXPECT_EQ(backend.draws[0].count, 12u);
+  EXPECT_FALSE(backend.draws[0].depth.write);
+  EXPECT_TRUE(backend.draws[1].depth.write);
+  EXPECT_FALSE(backend.draws[2].depth.write);
+  EXPECT_EQ(batch.get_stats().state_changes, 3u);
+}
+
+TEST(vr_draw_batch, Vertices)
+{
+  VR_Draw_Batch batch;
+  CountingBatchBackend backend;
+  batch.set_backend(&backend);
+
+  /* Translation (row-vector convention, as Mat44f). */
+  Mat44f m = identity();
+  m.m[3][0] = 10.0f;
+  m.m[3][1] = 20.0f;
+  m.m[3][2] = 30.0f;
+  const float color[4] = {1.0f, 0.5f, 0.25f, 0.8f};
+  int tex;
+  batch.add_quad(m, quad, color, &tex, quad_uvs, 0.5f);
+  const float strip[4][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}};
+  batch.add_strip(m, strip, 4, color);
+  batch.flush();
+
+  ASSERT_EQ(backend.verts.size(), 12u);
+  /* Quad: (bl, br, tl), (tl, br, tr). */
+  const VR_Draw_Batch::Vertex &tr = backend.verts[5];
+  EXPECT_FLOAT_EQ(tr.pos[0], 11.0f);
+  EXPECT_FLOAT_EQ(tr.pos[1], 21.0f);
+  EXPECT_FLOAT_EQ(tr.pos[2], 30.0f);
+  EXPECT_FLOAT_EQ(tr.uv[0], 1.0f);
+  EXPECT_FLOAT_EQ(tr.uv[1], 0.0f);
+  EXPECT_FLOAT_EQ(tr.tex, 1.0f);
+  /* Shading applies to rgb only. */
+  EXPECT_FLOAT_EQ(tr.color[0], 0.5f);
+  EXPECT_FLOAT_EQ(tr.color[1], 0.25f);
+  EXPECT_FLOAT_EQ(tr.color[2], 0.125f);
+  EXPECT_FLOAT_EQ(tr.color[3], 0.8f);
+
+  /* Strip: untextured, unshaded, two triangles. */
+  const VR_Draw_Batch::Vertex &s = backend.verts[11];
+  EXPECT_FLOAT_EQ(s.tex, 0.0f);
+  EXPECT_FLOAT_EQ(s.color[0], 1.0f);
+  EXPECT_FLOAT_EQ(s.color[2], 0.25f);
+  /* Second triangle of the strip is (1, 3, 2), keeping the winding of (0, 1, 2). */
+  EXPECT_FLOAT_EQ(backend.verts[6].pos[0], 10.0f);
+  EXPECT_FLOAT_EQ(backend.verts[9].pos[0], 11.0f);
+  EXPECT_FLOAT_EQ(backend.verts[9].pos[1], 20.0f);
+  EXPECT_FLOAT_EQ(backend.verts[10].pos[1], 21.0f);
+  EXPECT_FLOAT_EQ(backend.verts[11].pos[0], 10.0f);
+}
+
+TEST(vr_draw_batch, FlushTriggers)
+{
+  VR_Draw_Batch batch;
+  CountingBatchBackend backend;
+  batch.set_backend(&backend);
+  const Mat44f m = identity();
+
+  /* Capacity. */
+  batch.set_capacity(12);
+  batch.add_quad(m, quad, white);
+  batch.add_quad(m, quad, white);
+  EXPECT_EQ(backend.begins, 0);
+  batch.add_quad(m, quad, white);
+  EXPECT_EQ(backend.begins, 1);
+  EXPECT_EQ(backend.verts.size(), 12u);
+
+  /* Projection change. */
+  float projection[4][4] = {{2, 0, 0, 0}, {0, 2, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}};
+  batch.set_projection(projection);
+  EXPECT_EQ(backend.begins, 2);
+  batch.add_quad(m, quad, white);
+  batch.set_projection(projection);
+  EXPECT_EQ(backend.begins, 2);
+  batch.flush();
+  EXPECT_EQ(backend.begins, 3);
+
+  /* Empty flush. */
+  batch.flush();
+  EXPECT_EQ(backend.begins, 3);
+  EXPECT_EQ(batch.get_stats().flushes, 3u);
+
+  batch.reset_stats();
+  EXPECT_EQ(batch.get_stats().commands, 0u);
+}
+
+TEST(vr_draw_batch, ViewAngleShade)
+{
+  Mat44f m = identity();
+  EXPECT_FLOAT_EQ(VR_Draw_Batch::view_angle_shade(m), 1.0f);
+
+  /* Facing away: clamped. */
+  m.m[2][2] = -1.0f;
+  EXPECT_FLOAT_EQ(VR_Draw_Batch::view_angle_shade(m), 0.1f);
+
+  /* Rotated by 60 degrees around x. */
+  m = identity();
+  m.m[1][1] = m.m[2][2] = 0.5f;
+  m.m[1][2] = -(m.m[2][1] = 0.8660254f);
+  EXPECT_NEAR(VR_Draw_Batch::view_angle_shade(m), 0.5f, 1e-5f);
+}
@@ -0,0 +1,138 @@
+/* Apache License, Version 2.0 */
+
+#include "vr_draw_testing.h"
+
+/* A small menu: background, three icons (two textures) and a frame. */
+static void record_menu(VR_Draw_List &list, int highlight)
+{
+  static int tex_background, tex_icon;
+  list.begin();
+  list.add_quad(identity(), identity(), quad, white, &tex_background, quad_uvs);
+  for (int i = 0; i < 3; i++) {
+    const float color[4] = {1.0f, (i == highlight) ? 0.5f : 1.0f, 1.0f, 1.0f};
+    list.add_quad(translation((float)i, 0, 0), translation((float)-i, 0, 0), quad, color, &tex_icon, quad_uvs);
+  }
+  const float frame[4][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}};
+  list.add_strip(identity(), frame, 4, white);
+  list.end();
+}
+
+TEST(vr_draw_list, RebuildOnlyOnChange)
+{
+  CountingListBackend backend;
+  VR_Draw_List list;
+  list.set_backend(&backend);
+  const Mat44f eye[2] = {translation(-0.03f, 0, 0), translation(0.03f, 0, 0)};
+
+  /* 100 frames, two eyes, the highlight changes twice. */
+  int highlight = -1;
+  for (int f = 0; f < 100; f++) {
+    if (f == 40) {
+      highlight = 1;
+    }
+    else if (f == 70) {
+      highlight = 2;
+    }
+    if (list.update_state(&highlight, sizeof(highlight))) {
+      record_menu(list, highlight);
+    }
+    for (int i = 0; i < 2; i++) {
+      list.draw(eye[i], eye[i], identity().m);
+    }
+  }
+
+  const VR_Draw_List::Stats &stats = list.get_stats();
+  EXPECT_EQ(stats.rebuilds, 3);
+  EXPECT_EQ(stats.uploads, 3);
+  EXPECT_EQ(backend.uploads, 3);
+  EXPECT_EQ(stats.replays, 200);
+  EXPECT_EQ(backend.begins, 200);
+  /* Background, then the icons (and the untextured frame): one texture change each. */
+  EXPECT_EQ(list.num_ranges(), 2);
+  EXPECT_EQ(stats.draw_calls, 400);
+  EXPECT_EQ(stats.state_changes, 400);
+  EXPECT_EQ(list.size(), 4 * 6 + 2 * 3);
+  EXPECT_EQ(stats.commands, 3 * 5);
+
+  /* The buffer is reused by the rebuilds. */
+  EXPECT_EQ(backend.buffer, 1);
+  ASSERT_EQ(backend.draws.size(), 400);
+  EXPECT_EQ(backend.draws[0].first, 0);
+  EXPECT_EQ(backend.draws[0].count, 6);
+  EXPECT_EQ(backend.draws[1].first, 6);
+  EXPECT_EQ(backend.draws[1].count, 3 * 6 + 2 * 3);
+  EXPECT_NE(backend.draws[0].texture, backend.draws[1].texture);
+
+  /* List-space positions (the icons are moved by their model matrix). */
+  EXPECT_EQ(backend.verts[6 * 2].pos[0], 1.0f + 0.0f);
+  EXPECT_EQ(backend.verts[6 * 3 + 5].pos[0], 2.0f + 1.0f);
+  /* The last highlight is recorded. */
+  EXPECT_EQ(backend.verts[6 * 3].color[1], 0.5f);
+  EXPECT_EQ(backend.verts[6 * 2].color[1], 1.0f);
+  EXPECT_EQ(backend.verts[6 * 4].tex, 0.0f);
+
+  /* Forced rebuild. */
+  list.invalidate();
+  EXPECT_TRUE(list.update_state(&highlight, sizeof(highlight)));
+  EXPECT_FALSE(list.update_state(&highlight, sizeof(highlight)));
+}
+
+TEST(vr_draw_list, ViewAngleShade)
+{
+  CountingListBackend backend;
+  VR_Draw_List list;
+  list.set_backend(&backend);
+
+  /* A quad tilted in list space, replayed with two different views. */
+  static int tex;
+  const float a = 0.4f;
+  list.begin();
+  list.add_quad(rotation(a), rotation(-a), quad, white, &tex, quad_uvs);
+  list.add_quad(identity(), identity(), quad, white);
+  list.end();
+
+  const float views[2] = {0.3f, -1.2f};
+  for (int i = 0; i < 2; i++) {
+    const float b = views[i];
+    list.draw(rotation(b), rotation(-b), identity().m);
+    /* Same as drawing the quad directly with the combined modelview. */
+    const float expected = VR_Draw_Batch::view_angle_shade(rotation(-(a + b)));
+    EXPECT_NEAR(backend.shade(backend.verts[0]), expected, 1e-6f);
+    EXPECT_NEAR(backend.shade(backend.verts[0]), (cosf(a + b) < 0.1f) ? 0.1f : cosf(a + b), 1e-6f);
+  }
+  /* Untextured vertices are not shaded (but get a usable column). */
+  EXPECT_EQ(backend.verts[6].tex, 0.0f);
+  EXPECT_EQ(backend.verts[6].normal[2], 1.0f);
+}
+
+TEST(vr_draw_list, BackendFailure)
+{
+  CountingListBackend backend;
+  backend.fail = true;
+  VR_Draw_List list;
+
+  /* Nothing is drawn without a backend, or with an empty list. */
+  list.begin();
+  list.end();
+  list.set_backend(&backend);
+  list.draw(identity(), identity(), identity().m);
+  EXPECT_EQ(backend.begins, 0);
+
+  record_menu(list, 0);
+  list.draw(identity(), identity(), identity().m);
+  EXPECT_EQ(backend.begins, 0);
+
+  /* Retried on the next draw. */
+  backend.fail = false;
+  list.draw(identity(), identity(), identity().m);
+  EXPECT_EQ(backend.uploads, 1);
+  EXPECT_EQ(backend.begins, 1);
+
+  /* A new backend doesn't know the buffer of the previous one. */
+  CountingListBackend other;
+  other.next_buffer = 7;
+  list.set_backend(&other);
+  list.draw(identity(), identity(), identity().m);
+  EXPECT_EQ(other.uploads, 1);
+  EXPECT_EQ(other.buffer, 7);
+}
@@ -0,0 +1,209 @@
+/* Apache License, Version 2.0 */
+
+#include "vr_draw_testing.h"
+
+static void add_point(VR_Draw_Stroke &stroke, float x, float y, float pressure)
+{
+  const float pos[3] = {x, y, 0.0f};
+  stroke.add(pos, pressure);
+}
+
+TEST(vr_draw_stroke, IncrementalUpload)
+{
+  CountingStrokeBackend backend;
+  VR_Draw_Stroke stroke;
+  stroke.set_backend(&backend);
+  stroke.set_thickness(10.0f);
+
+  /* A single point is not drawn. */
+  add_point(stroke, 0.0f, 0.0f, 1.0f);
+  stroke.draw(white);
+  EXPECT_EQ(backend.reserves, 0);
+  EXPECT_TRUE(backend.draws.empty());
+
+  /* A long stroke at constant pressure, drawn for both eyes every frame. */
+  const uint num_points = 10000;
+  for (uint i = 1; i < num_points; i++) {
+    add_point(stroke, 0.001f * i, sinf(0.01f * i), 1.0f);
+    stroke.draw(white);
+    stroke.draw(white);
+  }
+  EXPECT_EQ(stroke.size(), num_points);
+  EXPECT_EQ(stroke.num_strips(), 1);
+
+  /* Geometric growth: 1024 .. 16384 points. */
+  const VR_Draw_Stroke::Stats &stats = stroke.get_stats();
+  EXPECT_EQ(stats.reallocations, 5);
+  EXPECT_EQ(backend.reserves, 5);
+  EXPECT_EQ(backend.buffer.size(), 16384);
+  /* Each point is uploaded once (the buffer is copied when it grows). */
+  EXPECT_EQ(stats.points_uploaded, num_points);
+  EXPECT_EQ(stats.uploads, num_points - 1);
+  EXPECT_EQ(backend.uploads, num_points - 1);
+  /* One draw call per eye and frame. */
+  EXPECT_EQ(stats.draws, 2 * (num_points - 1));
+  EXPECT_EQ(stats.draw_calls, 2 * (num_points - 1));
+
+  /* The buffer holds the whole stroke. */
+  for (uint i = 0; i < num_points; i++) {
+    EXPECT_EQ(backend.buffer[i].x, 0.001f * i);
+  }
+  const StrokeDraw &d = backend.draws.back();
+  ASSERT_EQ(d.first.size(), 1);
+  EXPECT_EQ(d.first[0], 0);
+  EXPECT_EQ(d.count[0], (int)num_points);
+  EXPECT_EQ(d.width, 10.0f);
+
+  /* A new stroke reuses the buffer. */
+  stroke.clear();
+  add_point(stroke, 1.0f, 0.0f, 1.0f);
+  add_point(stroke, 2.0f, 0.0f, 1.0f);
+  stroke.draw(white);
+  EXPECT_EQ(backend.reserves, 5);
+  EXPECT_EQ(backend.buffer[0].x, 1.0f);
+  EXPECT_EQ(backend.buffer[1].x, 2.0f);
+}
+
+TEST(vr_draw_stroke, PressureStrips)
+{
+  CountingStrokeBackend backend;
+  VR_Draw_Stroke stroke;
+  stroke.set_backend(&backend);
+  stroke.set_thickness(10.0f);
+
+  /* Width 10, 5, 10, 5 (four strips, two widths), then jitter below the width step. */
+  const float pressures[10] = {1.0f, 1.0f, 0.5f, 0.5f, 1.0f, 1.0f, 0.5f, 0.51f, 0.49f, 0.52f};
+  for (int i = 0; i < 10; i++) {
+    add_point(stroke, (float)i, 0.0f, pressures[i]);
+  }
+  EXPECT_EQ(stroke.num_strips(), 4);
+  stroke.draw(white);
+
+  /* One call per width, each strip starting at the last point of the previous one. */
+  ASSERT_EQ(backend.draws.size(), 2);
+  const StrokeDraw &thin = backend.draws[0];
+  const StrokeDraw &thick = backend.draws[1];
+  EXPECT_EQ(thin.width, 5.0f);
+  EXPECT_EQ(thick.width, 10.0f);
+  ASSERT_EQ(thick.first.size(), 2);
+  EXPECT_EQ(thick.first[0], 0);
+  EXPECT_EQ(thick.count[0], 2);
+  EXPECT_EQ(thick.first[1], 3);
+  EXPECT_EQ(thick.count[1], 3);
+  ASSERT_EQ(thin.first.size(), 2);
+  EXPECT_EQ(thin.first[0], 1);
+  EXPECT_EQ(thin.count[0], 3);
+  EXPECT_EQ(thin.first[1], 5);
+  EXPECT_EQ(thin.count[1], 5);
+
+  /* Very low pressure is still drawn one pixel wide. */
+  stroke.clear();
+  add_point(stroke, 0.0f, 0.0f, 0.01f);
+  add_point(stroke, 1.0f, 0.0f, 0.0f);
+  backend.draws.clear();
+  stroke.draw(white);
+  ASSERT_EQ(backend.draws.size(), 1);
+  EXPECT_EQ(backend.draws[0].width, 1.0f);
+}
+
+TEST(vr_draw_stroke, BackendFailure)
+{
+  CountingStrokeBackend backend;
+  backend.fail = true;
+  VR_Draw_Stroke stroke;
+  stroke.set_backend(&backend);
+  add_point(stroke, 0.0f, 0.0f, 1.0f);
+  add_point(stroke, 1.0f, 0.0f, 1.0f);
+  stroke.draw(white);
+  EXPECT_TRUE(backend.draws.empty());
+
+  /* Retried (with everything uploaded) on the next draw. */
+  backend.fail = false;
+  stroke.draw(white);
+  EXPECT_EQ(backend.reserves, 2);
+  EXPECT_EQ(backend.uploads, 1);
+  EXPECT_EQ(backend.draws.size(), 1);
+  EXPECT_EQ(backend.buffer[1].x, 1.0f);
+}
+
+TEST(vr_draw_stroke, Simplify)
+{
+  VR_Draw_Stroke stroke;
+  stroke.set_thickness(10.0f);
+
+  /* A straight line, a right angle, another straight line. */
+  for (int i = 0; i <= 100; i++) {
+    add_point(stroke, 0.01f * i, 0.0f, 1.0f);
+  }
+  for (int i = 1; i <= 100; i++) {
+    add_point(stroke, 1.0f, 0.01f * i, 1.0f);
+  }
+  std::vector<uint> keep;
+  stroke.simplify(0.001f, keep);
+  ASSERT_EQ(keep.size(), 3);
+  EXPECT_EQ(keep[0], 0);
+  EXPECT_EQ(keep[1], 100);
+  EXPECT_EQ(keep[2], 200);
+
+  /* No tolerance: only exactly collinear points are removed. */
+  keep.clear();
+  stroke.simplify(0.0f, keep);
+  EXPECT_EQ(keep.size(), 3);
+
+  /* Noise above the tolerance is kept. */
+  stroke.clear();
+  for (int i = 0; i < 50; i++) {
+    add_point(stroke, 0.01f * i, (i % 2) ? 0.01f : 0.0f, 1.0f);
+  }
+  keep.clear();
+  stroke.simplify(0.001f, keep);
+  EXPECT_EQ(keep.size(), 50);
+  keep.clear();
+  stroke.simplify(0.02f, keep);
+  EXPECT_EQ(keep.size(), 2);
+
+  /* Within the tolerance of the original everywhere (a quarter circle). */
+  stroke.clear();
+  const int num_points = 1000;
+  for (int i = 0; i < num_points; i++) {
+    const float a = (float)M_PI_2 * i / (num_points - 1);
+    add_point(stroke, cosf(a), sinf(a), 1.0f);
+  }
+  keep.clear();
+  stroke.simplify(0.001f, keep);
+  EXPECT_LT(keep.size(), 40);
+  EXPECT_EQ(keep.front(), 0);
+  EXPECT_EQ(keep.back(), num_points - 1);
+  for (size_t k = 0; k + 1 < keep.size(); k++) {
+    EXPECT_LT(keep[k], keep[k + 1]);
+    /* The chord's distance to the arc. */
+    const float a = (float)M_PI_2 * (keep[k + 1] - keep[k]) / (num_points - 1);
+    EXPECT_LE(1.0f - cosf(a / 2.0f), 0.001f);
+  }
+}
+
+TEST(vr_draw_stroke, SimplifyKeepsWidthChanges)
+{
+  VR_Draw_Stroke stroke;
+  stroke.set_thickness(10.0f);
+  /* A straight line with a thinner middle part. */
+  for (int i = 0; i <= 30; i++) {
+    add_point(stroke, 0.01f * i, 0.0f, (i >= 10 && i < 20) ? 0.5f : 1.0f);
+  }
+  EXPECT_EQ(stroke.num_strips(), 3);
+  std::vector<uint> keep;
+  stroke.simplify(0.001f, keep);
+  ASSERT_EQ(keep.size(), 4);
+  EXPECT_EQ(keep[0], 0);
+  EXPECT_EQ(keep[1], 9);
+  EXPECT_EQ(keep[2], 19);
+  EXPECT_EQ(keep[3], 30);
+
+  /* A single point. */
+  stroke.clear();
+  add_point(stroke, 0.0f, 0.0f, 1.0f);
+  keep.clear();
+  stroke.simplify(0.001f, keep);
+  ASSERT_EQ(keep.size(), 1);
+  EXPECT_EQ(keep[0], 0);
+}
@@ -0,0 +1,240 @@
+/* Apache License, Version 2.0 */
+
+/* Shared fixtures of the VR drawing tests: headless backends of the retained drawing helpers
+ * (UI batch, display lists, strokes) and common geometry. */
+
+#ifndef __VR_DRAW_TESTING_H__
+#define __VR_DRAW_TESTING_H__
+
+#include "testing/testing.h"
+
+#include "vr_draw_batch.h"
+#include "vr_draw_list.h"
+#include "vr_draw_stroke.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+/* Headless backend: instead of calling the graphics API, keeps a copy of what would have been
+ * uploaded and records the draw calls. */
+template<typename Backend, typename Draw> class CountingBackend : public Backend {
+ public:
+  std::vector<Draw> draws;
+  int begins;
+  int ends;
+  bool fail; /* Whether uploads / allocations fail. */
+
+  CountingBackend() : begins(0), ends(0), fail(false)
+  {
+  }
+};
+
+/* Draw call of the UI batch. */
+struct BatchDraw {
+  uint first;
+  uint count;
+  const void *texture;
+  VR_Draw_Batch::DepthState depth;
+};
+
+class CountingBatchBackend : public CountingBackend<VR_Draw_Batch::Backend, BatchDraw> {
+ public:
+  std::vector<VR_Draw_Batch::Vertex> verts;
+
+  CountingBatchBackend() : texture(0)
+  {
+    depth.func = 0;
+    depth.test = depth.write = false;
+  }
+
+  bool begin(const VR_Draw_Batch::Vertex *v, uint num_verts, const float /*projection*/[4][4])
+  {
+    verts.assign(v, v + num_verts);
+    begins++;
+    return true;
+  }
+  void set_depth(const VR_Draw_Batch::DepthState &d)
+  {
+    depth = d;
+  }
+  void set_texture(const void *t)
+  {
+    texture = t;
+  }
+  void draw(VR_Draw_Batch::Primitive /*prim*/, uint first, uint count)
+  {
+    BatchDraw d = {first, count, texture, depth};
+    draws.push_back(d);
+  }
+  void end()
+  {
+    ends++;
+  }
+
+ private:
+  const void *texture;
+  VR_Draw_Batch::DepthState depth;
+};
+
+/* Draw call of a display list. */
+struct ListDraw {
+  uint first;
+  uint count;
+  const void *texture;
+};
+
+class CountingListBackend : public CountingBackend<VR_Draw_List::Backend, ListDraw> {
+ public:
+  std::vector<VR_Draw_List::Vertex> verts;
+  float modelview_inv[4][4];
+  uint next_buffer;
+  uint buffer;
+  int uploads;
+
+  CountingListBackend() : next_buffer(1), buffer(0), uploads(0), texture(0)
+  {
+  }
+
+  bool upload(uint &buffer, const VR_Draw_List::Vertex *v, uint num_verts)
+  {
+    if (fail) {
+      return false;
+    }
+    if (!buffer) {
+      buffer = next_buffer++;
+    }
+    verts.assign(v, v + num_verts);
+    uploads++;
+    return true;
+  }
+  bool begin(uint buffer,
+             const float /*modelview*/[4][4],
+             const float modelview_inv[4][4],
+             const float /*projection*/[4][4])
+  {
+    this->buffer = buffer;
+    memcpy(this->modelview_inv, modelview_inv, sizeof(this->modelview_inv));
+    begins++;
+    return true;
+  }
+  void set_texture(const void *t)
+  {
+    texture = t;
+  }
+  void draw(uint first, uint count)
+  {
+    ListDraw d = {first, count, texture};
+    draws.push_back(d);
+  }
+  void end()
+  {
+    ends++;
+  }
+
+  /* Shading of a vertex, as computed by the list shader. */
+  float shade(const VR_Draw_List::Vertex &v) const
+  {
+    float n[4];
+    for (int r = 0; r < 4; r++) {
+      n[r] = 0.0f;
+      for (int k = 0; k < 4; k++) {
+        n[r] += modelview_inv[r][k] * v.normal[k];
+      }
+    }
+    const float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2] + n[3] * n[3]);
+    const float s = n[2] / len;
+    return (s < 0.1f) ? 0.1f : (s > 1.0f) ? 1.0f : s;
+  }
+
+ private:
+  const void *texture;
+};
+
+/* Draw call of a stroke (line strips of the same width). */
+struct StrokeDraw {
+  std::vector<int> first;
+  std::vector<int> count;
+  float width;
+};
+
+class CountingStrokeBackend : public CountingBackend<VR_Draw_Stroke::Backend, StrokeDraw> {
+ public:
+  std::vector<Coord3Df> buffer;
+  uint reserves;
+  uint uploads;
+
+  CountingStrokeBackend() : reserves(0), uploads(0)
+  {
+  }
+
+  bool reserve(uint capacity, uint num_keep)
+  {
+    reserves++;
+    if (fail) {
+      buffer.clear();
+      return false;
+    }
+    EXPECT_LE(num_keep, buffer.size());
+    buffer.resize(num_keep);
+    buffer.resize(capacity, Coord3Df(-1, -1, -1));
+    return true;
+  }
+  void upload(uint first, const Coord3Df *points, uint num_points)
+  {
+    uploads++;
+    EXPECT_LE(first + num_points, buffer.size());
+    std::copy(points, points + num_points, buffer.begin() + first);
+  }
+  bool begin(const float /*color*/[4])
+  {
+    begins++;
+    return true;
+  }
+  void draw(const int *first, const int *count, uint num_strips, float width)
+  {
+    StrokeDraw d;
+    d.first.assign(first, first + num_strips);
+    d.count.assign(count, count + num_strips);
+    d.width = width;
+    draws.push_back(d);
+  }
+  void end()
+  {
+    ends++;
+  }
+};
+
+static const float white[4] = {1.0f, 1.0f, 1.0f, 1.0f};
+/* Unit quad (bottom-left, bottom-right, top-left, top-right) and its texture coordinates. */
+static const float quad[4][3] = {{0, 0, 0}, {1, 0, 0}, {0, 1, 0}, {1, 1, 0}};
+static const float quad_uvs[4][2] = {{0, 1}, {1, 1}, {0, 0}, {1, 0}};
+
+inline Mat44f identity()
+{
+  Mat44f m;
+  m.set_to_identity();
+  return m;
+}
+
+inline Mat44f translation(float x, float y, float z)
+{
+  Mat44f m = identity();
+  m.m[3][0] = x;
+  m.m[3][1] = y;
+  m.m[3][2] = z;
+  return m;
+}
+
+/* Rotation about the x axis (row-vector convention, so the inverse is rotation(-a)). */
+inline Mat44f rotation(float a)
+{
+  Mat44f m = identity();
+  m.m[1][1] = m.m[2][2] = cosf(a);
+  m.m[1][2] = sinf(a);
+  m.m[2][1] = -sinf(a);
+  return m;
+}
+
+#endif /* __VR_DRAW_TESTING_H__ */
@@ -0,0 +1,316 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_mesh_bvh.h"
+
+#include "MEM_guardedalloc.h"
+
+#include "BLI_math.h"
+
+#include "DNA_object_types.h"
+#include "DNA_view3d_types.h"
+
+#include "BKE_editmesh.h"
+#include "BKE_editmesh_bvh.h"
+
+#include "bmesh.h"
+
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+/* Bumpy grid with some hidden faces, visible and hidden loose vertices and a wire edge. */
+static BMEditMesh *editmesh_create()
+{
+  BMeshCreateParams params = {0};
+  params.use_toolflags = true;
+  BMesh *bm = BM_mesh_create(&bm_mesh_allocsize_default, &params);
+
+  float mat[4][4];
+  unit_m4(mat);
+  BMO_op_callf(bm,
+               BMO_FLAG_DEFAULTS,
+               "create_grid x_segments=%i y_segments=%i size=%f matrix=%m4 calc_uvs=%b",
+               12,
+               12,
+               1.0f,
+               mat,
+               false);
+
+  BMIter iter;
+  BMFace *f;
+  BM_ITER_MESH (f, &iter, bm, BM_FACES_OF_MESH) {
+    float cent[3];
+    BM_face_calc_center_median(f, cent);
+    if (cent[0] > 0.4f && cent[1] > 0.4f) {
+      BM_face_hide_set(f, true);
+    }
+  }
+
+  const float co_loose[3] = {-0.3f, 0.2f, 0.5f};
+  BM_vert_create(bm, co_loose, NULL, BM_CREATE_NOP);
+  const float co_hidden[3] = {0.3f, -0.2f, 0.5f};
+  BMVert *v_hidden = BM_vert_create(bm, co_hidden, NULL, BM_CREATE_NOP);
+  BM_vert_hide_set(v_hidden, true);
+  const float co_wire[2][3] = {{-0.8f, -0.7f, 0.4f}, {-0.2f, -0.9f, 0.6f}};
+  BMVert *v_wire[2];
+  for (int i = 0; i < 2; i++) {
+    v_wire[i] = BM_vert_create(bm, co_wire[i], NULL, BM_CREATE_NOP);
+  }
+  BM_edge_create(bm, v_wire[0], v_wire[1], NULL, BM_CREATE_NOP);
+
+  return BKE_editmesh_create(bm, true);
+}
+
+static void editmesh_free(BMEditMesh *em)
+{
+  BKE_editmesh_free(em);
+  MEM_freeN(em);
+}
+
+/* Move the vertices (far enough to leave the bounds of the tree they were built with). */
+static void editmesh_deform(BMEditMesh *em, float amount)
+{
+  BMIter iter;
+  BMVert *v;
+  int i;
+  BM_ITER_MESH_INDEX (v, &iter, em->bm, BM_VERTS_OF_MESH, i) {
+    v->co[0] += amount * 0.01f * sinf(i * 1.7f);
+    v->co[1] += amount * 0.01f * cosf(i * 2.3f);
+    v->co[2] += amount * 0.3f * sinf(v->co[0] * 3.0f) * cosf(v->co[1] * 2.0f) + amount * 0.2f;
+  }
+  BKE_editmesh_geom_changed(em);
+}
+
+/* Distance from a location to a face (through the triangles of the edit mesh). */
+static float face_dist(BMEditMesh *em, BMFace *f, const float co[3])
+{
+  float dist_sq = FLT_MAX;
+  for (int i = 0; i < em->tottri; i++) {
+    BMLoop **ltri = em->looptris[i];
+    if (ltri[0]->f == f) {
+      float co_tri[3];
+      closest_on_tri_to_point_v3(co_tri, co, ltri[0]->v->co, ltri[1]->v->co, ltri[2]->v->co);
+      dist_sq = min_ff(dist_sq, len_squared_v3v3(co, co_tri));
+    }
+  }
+  return sqrtf(dist_sq);
+}
+
+static void expect_trees_eq(BMEditMesh *em, BMBVHTree *tree_a, BMBVHTree *tree_b)
+{
+  for (int x = -12; x <= 12; x++) {
+    for (int y = -12; y <= 12; y++) {
+      const float co[3] = {x * 0.1f + 0.013f, y * 0.1f + 0.007f, 2.0f};
+      const float co_near[3] = {co[0], co[1], 0.3f};
+      float dir[3] = {0.1f * x, -0.05f * y, -1.0f};
+      normalize_v3(dir);
+
+      float dist_a = FLT_MAX, dist_b = FLT_MAX;
+      float hit_a[3], hit_b[3];
+      BMFace *f_a = BKE_bmbvh_ray_cast(tree_a, co, dir, 0.0f, &dist_a, hit_a, NULL);
+      BMFace *f_b = BKE_bmbvh_ray_cast(tree_b, co, dir, 0.0f, &dist_b, hit_b, NULL);
+      EXPECT_EQ(f_a, f_b);
+      if (f_a && f_b) {
+        EXPECT_FLOAT_EQ(dist_a, dist_b);
+        EXPECT_V3_NEAR(hit_a, hit_b, 1e-6f);
+        EXPECT_FALSE(BM_elem_flag_test(f_a, BM_ELEM_HIDDEN));
+      }
+
+      /* The closest point can be on an edge of two faces, so only the distances are equal. */
+      f_a = BKE_bmbvh_find_face_closest(tree_a, co_near, 0.5f);
+      f_b = BKE_bmbvh_find_face_closest(tree_b, co_near, 0.5f);
+      ASSERT_EQ(f_a == NULL, f_b == NULL);
+      if (f_a && f_b) {
+        EXPECT_NEAR(face_dist(em, f_a, co_near), face_dist(em, f_b, co_near), 1e-6f);
+      }
+      EXPECT_EQ(BKE_bmbvh_find_vert_closest(tree_a, co_near, 0.5f),
+                BKE_bmbvh_find_vert_closest(tree_b, co_near, 0.5f));
+    }
+  }
+}
+
+TEST(vr_mesh_bvh, RefitMatchesNewTree)
+{
+  BMEditMesh *em = editmesh_create();
+  BMBVHTree *tree = BKE_bmbvh_new_from_editmesh(em, BMBVH_RESPECT_HIDDEN, NULL, false);
+
+  for (int i = 1; i <= 3; i++) {
+    editmesh_deform(em, (float)i);
+    BKE_bmbvh_refit(tree, em->looptris, BMBVH_RESPECT_HIDDEN);
+
+    BMBVHTree *tree_new = BKE_bmbvh_new_from_editmesh(em, BMBVH_RESPECT_HIDDEN, NULL, false);
+    expect_trees_eq(em, tree, tree_new);
+    BKE_bmbvh_free(tree_new);
+  }
+
+  BKE_bmbvh_free(tree);
+  editmesh_free(em);
+}
+
+/* Top view of the object, orthographic or from (0, 0, 3) in perspective. */
+static void view_init(RegionView3D *rv3d, Object *ob, bool is_persp)
+{
+  memset(rv3d, 0, sizeof(*rv3d));
+  memset(ob, 0, sizeof(*ob));
+  unit_m4(ob->obmat);
+  unit_m4(rv3d->viewinv);
+  rv3d->is_persp = is_persp;
+  if (is_persp) {
+    float winmat[4][4], viewmat[4][4];
+    perspective_m4(winmat, -0.5f, 0.5f, -0.5f, 0.5f, 1.0f, 100.0f);
+    unit_m4(viewmat);
+    viewmat[3][2] = -3.0f;
+    mul_m4_m4m4(rv3d->persmat, winmat, viewmat);
+    rv3d->viewinv[3][2] = 3.0f;
+  }
+  else {
+    unit_m4(rv3d->persmat);
+    rv3d->persmat[0][0] = rv3d->persmat[1][1] = 0.7f;
+    rv3d->persmat[2][2] = -0.1f;
+  }
+}
+
+/* Nearest visible vertex without a tree (manhattan distance, no occlusion). */
+static BMVert *find_nearest_vert_all(BMEditMesh *em,
+                                     const RegionView3D *rv3d,
+                                     const float winsize[2],
+                                     const float mval[2],
+                                     float *r_dist)
+{
+  BMVert *v_nearest = NULL;
+  BMIter iter;
+  BMVert *v;
+  BM_ITER_MESH (v, &iter, em->bm, BM_VERTS_OF_MESH) {
+    if (BM_elem_flag_test(v, BM_ELEM_HIDDEN)) {
+      continue;
+    }
+    float vec4[4] = {v->co[0], v->co[1], v->co[2], 1.0f};
+    mul_m4_v4(rv3d->persmat, vec4);
+    const float co_px[2] = {winsize[0] * (vec4[0] / vec4[3] + 1.0f) / 2.0f,
+                            winsize[1] * (vec4[1] / vec4[3] + 1.0f) / 2.0f};
+    const float dist = len_manhattan_v2v2(mval, co_px);
+    if (dist < *r_dist) {
+      *r_dist = dist;
+      v_nearest = v;
+    }
+  }
+  return v_nearest;
+}
+
+typedef struct NearestResult {
+  VR_Mesh_BVH::NearestType type;
+  BMElem *elem;
+  float dist;
+} NearestResult;
+
+/* Query every element type, with and without occlusion, over the view. */
+static std::vector<NearestResult> find_nearest_all(BMEditMesh *em,
+                                                   Object *ob,
+                                                   const RegionView3D *rv3d,
+                                                   const float winsize[2])
+{
+  const VR_Mesh_BVH::NearestType types[] = {VR_Mesh_BVH::NEAREST_VERT,
+                                            VR_Mesh_BVH::NEAREST_EDGE_CENTER,
+                                            VR_Mesh_BVH::NEAREST_EDGE,
+                                            VR_Mesh_BVH::NEAREST_FACE_CENTER};
+  std::vector<NearestResult> results;
+  for (int x = 0; x < winsize[0]; x += 9) {
+    for (int y = 0; y < winsize[1]; y += 11) {
+      const float mval[2] = {(float)x, (float)y};
+      for (int t = 0; t < 4; t++) {
+        for (int use_occlusion = 0; use_occlusion < 2; use_occlusion++) {
+          NearestResult result;
+          result.type = types[t];
+          result.dist = 20.0f;
+          result.elem = VR_Mesh_BVH::find_nearest(
+              em, ob, rv3d, winsize, mval, types[t], use_occlusion, &result.dist);
+          results.push_back(result);
+          if (result.elem) {
+            EXPECT_FALSE(BM_elem_flag_test(result.elem, BM_ELEM_HIDDEN));
+          }
+
+          if (types[t] == VR_Mesh_BVH::NEAREST_VERT && !use_occlusion) {
+            /* Pruning by the node bounds doesn't skip the nearest vertex. */
+            float dist_all = 20.0f;
+            BMVert *v_all = find_nearest_vert_all(em, rv3d, winsize, mval, &dist_all);
+            EXPECT_EQ(result.elem, (BMElem *)v_all);
+            EXPECT_NEAR(result.dist, dist_all, 1e-4f);
+          }
+        }
+      }
+    }
+  }
+  return results;
+}
+
+TEST(vr_mesh_bvh, FindNearestAfterRefit)
+{
+  const float winsize[2] = {200.0f, 200.0f};
+
+  BMEditMesh *em = editmesh_create();
+
+  for (int is_persp = 0; is_persp < 2; is_persp++) {
+    RegionView3D rv3d;
+    Object ob;
+    view_init(&rv3d, &ob, is_persp);
+
+    BMBVHTree *tree = VR_Mesh_BVH::get(em);
+    ASSERT_NE(tree, (BMBVHTree *)NULL);
+    editmesh_deform(em, 1.0f);
+    /* Only vertices moved: the tree is refit, not built again. */
+    EXPECT_EQ(VR_Mesh_BVH::get(em), tree);
+    const std::vector<NearestResult> results_refit = find_nearest_all(em, &ob, &rv3d, winsize);
+
+    VR_Mesh_BVH::clear();
+    const std::vector<NearestResult> results_new = find_nearest_all(em, &ob, &rv3d, winsize);
+
+    ASSERT_EQ(results_refit.size(), results_new.size());
+    int found = 0;
+    for (size_t i = 0; i < results_refit.size(); i++) {
+      /* Edges sharing the vertex nearest to mval are at the same distance. */
+      if (results_refit[i].type != VR_Mesh_BVH::NEAREST_EDGE) {
+        EXPECT_EQ(results_refit[i].elem, results_new[i].elem);
+      }
+      EXPECT_FLOAT_EQ(results_refit[i].dist, results_new[i].dist);
+      found += (results_refit[i].elem != NULL);
+    }
+    EXPECT_GT(found, (int)results_refit.size() / 2);
+  }
+
+  VR_Mesh_BVH::clear();
+  editmesh_free(em);
+}
+
+TEST(vr_mesh_bvh, Rebuild)
+{
+  BMEditMesh *em = editmesh_create();
+  BMBVHTree *tree = VR_Mesh_BVH::get(em);
+  ASSERT_NE(tree, (BMBVHTree *)NULL);
+
+  /* Unchanged geometry reuses the tree. */
+  EXPECT_EQ(VR_Mesh_BVH::get(em), tree);
+
+  /* Hiding a face changes the faces in the tree. */
+  BM_face_hide_set(BM_face_at_index_find(em->bm, 0), true);
+  BKE_editmesh_geom_changed(em);
+  tree = VR_Mesh_BVH::get(em);
+  BMBVHTree *tree_new = BKE_bmbvh_new_from_editmesh(em, BMBVH_RESPECT_HIDDEN, NULL, false);
+  expect_trees_eq(em, tree, tree_new);
+  BKE_bmbvh_free(tree_new);
+
+  /* Another BMesh for the same edit mesh (as when an edit mesh is freed and another one is
+   * allocated at its address) never refits the tree of the old one. */
+  BMesh *bm_old = em->bm;
+  em->bm = BM_mesh_copy(bm_old);
+  BM_mesh_free(bm_old);
+  BKE_editmesh_looptri_calc(em);
+  tree = VR_Mesh_BVH::get(em);
+  tree_new = BKE_bmbvh_new_from_editmesh(em, BMBVH_RESPECT_HIDDEN, NULL, false);
+  expect_trees_eq(em, tree, tree_new);
+  BKE_bmbvh_free(tree_new);
+
+  VR_Mesh_BVH::clear();
+  editmesh_free(em);
+}
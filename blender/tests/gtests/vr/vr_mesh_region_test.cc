@@ -0,0 +1,311 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_mesh_region.h"
+
+#include "BLI_math.h"
+
+#include "DNA_scene_types.h"
+
+#include "BKE_editmesh.h"
+
+#include "bmesh.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+/* Grid in the XY plane, with the faces within radius of the center selected. */
+static BMesh *grid_create(int segments, float radius)
+{
+  BMeshCreateParams params = {0};
+  params.use_toolflags = true;
+  BMesh *bm = BM_mesh_create(&bm_mesh_allocsize_default, &params);
+  bm->selectmode = SCE_SELECT_FACE;
+
+  float mat[4][4];
+  unit_m4(mat);
+  BMO_op_callf(bm,
+               BMO_FLAG_DEFAULTS,
+               "create_grid x_segments=%i y_segments=%i size=%f matrix=%m4 calc_uvs=%b",
+               segments,
+               segments,
+               1.0f,
+               mat,
+               false);
+
+  BMIter iter;
+  BMFace *f;
+  BM_ITER_MESH (f, &iter, bm, BM_FACES_OF_MESH) {
+    float cent[3];
+    BM_face_calc_center_median(f, cent);
+    if (len_v3(cent) < radius) {
+      BM_face_select_set(bm, f, true);
+    }
+  }
+  BM_mesh_normals_update(bm);
+  return bm;
+}
+
+static void editmesh_init(BMEditMesh *em, BMesh *bm)
+{
+  memset(em, 0, sizeof(*em));
+  em->bm = bm;
+}
+
+/* As Widget_Bevel, selecting the new faces. */
+static void bevel(BMesh *bm, float offset)
+{
+  BMOperator bmop;
+  BMO_op_initf(bm,
+               &bmop,
+               BMO_FLAG_DEFAULTS,
+               "bevel geom=%hev offset=%f segments=%i vertex_only=%b offset_type=%i profile=%f "
+               "clamp_overlap=%b material=%i loop_slide=%b mark_seam=%b mark_sharp=%b "
+               "harden_normals=%b face_strength_mode=%i "
+               "miter_outer=%i miter_inner=%i spread=%f smoothresh=%f",
+               BM_ELEM_SELECT,
+               offset,
+               2,
+               false,
+               0,
+               0.5f,
+               false,
+               -1,
+               true,
+               false,
+               false,
+               false,
+               0,
+               0,
+               0,
+               0.1f,
+               0.0f);
+  BMO_op_exec(bm, &bmop);
+  BM_mesh_elem_hflag_disable_all(bm, BM_VERT | BM_EDGE | BM_FACE, BM_ELEM_SELECT, false);
+  BMO_slot_buffer_hflag_enable(bm, bmop.slots_out, "faces.out", BM_FACE, BM_ELEM_SELECT, true);
+  BMO_op_finish(bm, &bmop);
+}
+
+/* As Widget_InsetFaces, selecting the inset faces. */
+static void inset(BMesh *bm, bool use_individual, float thickness, float depth)
+{
+  BMOperator bmop;
+  if (use_individual) {
+    BMO_op_initf(bm,
+                 &bmop,
+                 BMO_FLAG_DEFAULTS,
+                 "inset_individual faces=%hf use_even_offset=%b use_relative_offset=%b "
+                 "use_interpolate=%b thickness=%f depth=%f",
+                 BM_ELEM_SELECT,
+                 true,
+                 false,
+                 true,
+                 thickness,
+                 depth);
+  }
+  else {
+    BMO_op_initf(bm,
+                 &bmop,
+                 BMO_FLAG_DEFAULTS,
+                 "inset_region faces=%hf use_boundary=%b use_even_offset=%b "
+                 "use_relative_offset=%b use_interpolate=%b thickness=%f depth=%f "
+                 "use_outset=%b use_edge_rail=%b",
+                 BM_ELEM_SELECT,
+                 true,
+                 true,
+                 false,
+                 true,
+                 thickness,
+                 depth,
+                 false,
+                 false);
+  }
+  BMO_op_exec(bm, &bmop);
+  BM_mesh_elem_hflag_disable_all(bm, BM_VERT | BM_EDGE | BM_FACE, BM_ELEM_SELECT, false);
+  BMO_slot_buffer_hflag_enable(bm, bmop.slots_out, "faces.out", BM_FACE, BM_ELEM_SELECT, true);
+  BMO_op_finish(bm, &bmop);
+}
+
+/* A face by its vertex coordinates (starting from the smallest one) and selection,
+ * to compare meshes independently of the order of their elements. */
+struct FaceKey {
+  long key[3];
+  bool select;
+  std::vector<float> co;
+
+  bool operator<(const FaceKey &other) const
+  {
+    return std::lexicographical_compare(key, key + 3, other.key, other.key + 3);
+  }
+};
+
+static std::vector<FaceKey> mesh_faces(BMesh *bm)
+{
+  std::vector<FaceKey> faces;
+  BMIter iter;
+  BMFace *f;
+  BM_ITER_MESH (f, &iter, bm, BM_FACES_OF_MESH) {
+    FaceKey face;
+    float cent[3];
+    BM_face_calc_center_median(f, cent);
+    for (int k = 0; k < 3; k++) {
+      face.key[k] = lroundf(cent[k] * 1000.0f);
+    }
+    face.select = BM_elem_flag_test_bool(f, BM_ELEM_SELECT);
+
+    BMLoop *l_first = BM_FACE_FIRST_LOOP(f), *l_iter = l_first, *l_min = l_first;
+    do {
+      const float *co = l_iter->v->co, *co_min = l_min->v->co;
+      if (std::lexicographical_compare(co, co + 3, co_min, co_min + 3)) {
+        l_min = l_iter;
+      }
+    } while ((l_iter = l_iter->next) != l_first);
+    l_iter = l_min;
+    do {
+      face.co.insert(face.co.end(), l_iter->v->co, l_iter->v->co + 3);
+    } while ((l_iter = l_iter->next) != l_min);
+    faces.push_back(face);
+  }
+  std::sort(faces.begin(), faces.end());
+  return faces;
+}
+
+static void expect_mesh_eq(BMesh *bm_a, BMesh *bm_b)
+{
+  EXPECT_EQ(bm_a->totvert, bm_b->totvert);
+  EXPECT_EQ(bm_a->totedge, bm_b->totedge);
+  EXPECT_EQ(bm_a->totface, bm_b->totface);
+  EXPECT_EQ(bm_a->totfacesel, bm_b->totfacesel);
+
+  const std::vector<FaceKey> faces_a = mesh_faces(bm_a);
+  const std::vector<FaceKey> faces_b = mesh_faces(bm_b);
+  ASSERT_EQ(faces_a.size(), faces_b.size());
+  for (size_t i = 0; i < faces_a.size(); i++) {
+    EXPECT_EQ(faces_a[i].select, faces_b[i].select);
+    ASSERT_EQ(faces_a[i].co.size(), faces_b[i].co.size());
+    for (size_t j = 0; j < faces_a[i].co.size(); j++) {
+      EXPECT_NEAR(faces_a[i].co[j], faces_b[i].co[j], 1e-5f);
+    }
+  }
+}
+
+TEST(vr_mesh_region, BevelMatchesFullMesh)
+{
+  BMesh *bm = grid_create(16, 0.3f);
+  BMesh *bm_full = BM_mesh_copy(bm);
+  bevel(bm_full, 0.05f);
+
+  BMEditMesh em;
+  editmesh_init(&em, bm);
+  VR_Mesh_Region region;
+  ASSERT_TRUE(region.begin(&em));
+  EXPECT_LT(region.size(), (uint)bm->totface / 2);
+
+  bevel(region.restore(), 0.05f);
+  EXPECT_TRUE(region.apply());
+  expect_mesh_eq(bm, bm_full);
+
+  region.end();
+  BM_mesh_free(bm_full);
+  BM_mesh_free(bm);
+}
+
+TEST(vr_mesh_region, InsetMatchesFullMesh)
+{
+  for (int use_individual = 0; use_individual < 2; use_individual++) {
+    BMesh *bm = grid_create(16, 0.3f);
+    BMesh *bm_full = BM_mesh_copy(bm);
+    inset(bm_full, use_individual, 0.02f, 0.01f);
+
+    BMEditMesh em;
+    editmesh_init(&em, bm);
+    VR_Mesh_Region region;
+    ASSERT_TRUE(region.begin(&em));
+
+    inset(region.restore(), use_individual, 0.02f, 0.01f);
+    EXPECT_TRUE(region.apply());
+    expect_mesh_eq(bm, bm_full);
+
+    region.end();
+    BM_mesh_free(bm_full);
+    BM_mesh_free(bm);
+  }
+}
+
+TEST(vr_mesh_region, Restore)
+{
+  /* Each frame of a drag re-evaluates the operator from the original region. */
+  BMesh *bm = grid_create(16, 0.3f);
+  BMesh *bm_full = BM_mesh_copy(bm);
+  bevel(bm_full, 0.03f);
+
+  BMEditMesh em;
+  editmesh_init(&em, bm);
+  VR_Mesh_Region region;
+  ASSERT_TRUE(region.begin(&em));
+
+  const float offsets[] = {0.05f, 0.01f, 0.08f, 0.03f};
+  for (int i = 0; i < 4; i++) {
+    bevel(region.restore(), offsets[i]);
+    EXPECT_TRUE(region.apply());
+  }
+  expect_mesh_eq(bm, bm_full);
+
+  region.end();
+  BM_mesh_free(bm_full);
+  BM_mesh_free(bm);
+}
+
+TEST(vr_mesh_region, Cancel)
+{
+  BMesh *bm = grid_create(16, 0.3f);
+  BMesh *bm_orig = BM_mesh_copy(bm);
+
+  BMEditMesh em;
+  editmesh_init(&em, bm);
+  VR_Mesh_Region region;
+  ASSERT_TRUE(region.begin(&em));
+
+  inset(region.restore(), false, 0.02f, 0.01f);
+  EXPECT_TRUE(region.apply());
+  EXPECT_NE(bm->totface, bm_orig->totface);
+
+  EXPECT_TRUE(region.cancel());
+  expect_mesh_eq(bm, bm_orig);
+
+  region.end();
+  EXPECT_FALSE(region.is_active());
+  BM_mesh_free(bm_orig);
+  BM_mesh_free(bm);
+}
+
+TEST(vr_mesh_region, FullMeshFallback)
+{
+  BMEditMesh em;
+  VR_Mesh_Region region;
+
+  /* Most of the mesh selected. */
+  BMesh *bm = grid_create(8, 10.0f);
+  editmesh_init(&em, bm);
+  EXPECT_FALSE(region.begin(&em));
+  EXPECT_FALSE(region.is_active());
+  BM_mesh_free(bm);
+
+  /* Nothing selected. */
+  bm = grid_create(8, 0.0f);
+  editmesh_init(&em, bm);
+  EXPECT_FALSE(region.begin(&em));
+  BM_mesh_free(bm);
+
+  /* A loose vertex selected. */
+  bm = grid_create(8, 0.3f);
+  const float co[3] = {0.0f, 0.0f, 1.0f};
+  BMVert *v = BM_vert_create(bm, co, NULL, BM_CREATE_NOP);
+  BM_vert_select_set(bm, v, true);
+  editmesh_init(&em, bm);
+  EXPECT_FALSE(region.begin(&em));
+  BM_mesh_free(bm);
+}
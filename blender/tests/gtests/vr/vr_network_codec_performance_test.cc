@@ -0,0 +1,132 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_network_codec.h"
+
+#include <stdio.h>
+
+extern "C" {
+#include "PIL_time.h"
+}
+
+/* Raw RGBA frames (VR_RECORDED_FRAMES_W * VR_RECORDED_FRAMES_H * 4 bytes each, back to back),
+ * as read back from the VR viewport by VR_UI::execute_post_render_operations(). */
+#if 0
+#  define VR_RECORDED_FRAMES_PATH "/path/to/vr_frames.rgba"
+#  define VR_RECORDED_FRAMES_W 320
+#  define VR_RECORDED_FRAMES_H 240
+#endif
+
+#define NUM_FRAMES 300
+#define FRAME_D 4
+
+/* Synthetic viewport: grid floor, flat background and a few moving objects. */
+static void synthetic_frames(std::vector<std::vector<uchar>> &frames, uint w, uint h)
+{
+  frames.resize(NUM_FRAMES);
+  for (int f = 0; f < NUM_FRAMES; f++) {
+    std::vector<uchar> &pixels = frames[f];
+    pixels.resize(w * h * FRAME_D);
+    for (uint y = 0; y < h; y++) {
+      for (uint x = 0; x < w; x++) {
+        uchar *p = &pixels[(y * w + x) * FRAME_D];
+        const bool floor = (y > h / 2);
+        const bool grid = floor && (((x + f) % 32) == 0 || (y % 16) == 0);
+        const int cx = (int)(w / 4 + (f * 2) % (w / 2));
+        const int dx = (int)x - cx, dy = (int)y - (int)(h / 2);
+        const bool object = (dx * dx + dy * dy) < (int)(h * h / 36);
+        p[0] = object ? (uchar)(200 - dy) : grid ? 90 : 57;
+        p[1] = object ? (uchar)(120 + dx) : grid ? 90 : 57;
+        p[2] = object ? 60 : grid ? 90 : 57;
+        p[3] = (object || floor) ? 255 : 0;
+      }
+    }
+  }
+}
+
+#ifdef VR_RECORDED_FRAMES_PATH
+static bool recorded_frames(std::vector<std::vector<uchar>> &frames, uint w, uint h)
+{
+  FILE *f = fopen(VR_RECORDED_FRAMES_PATH, "rb");
+  if (!f) {
+    return false;
+  }
+  std::vector<uchar> pixels(w * h * FRAME_D);
+  while (fread(&pixels[0], 1, pixels.size(), f) == pixels.size()) {
+    frames.push_back(pixels);
+  }
+  fclose(f);
+  return !frames.empty();
+}
+#endif
+
+static void codec_benchmark(VR_Network_Encoder::Type type, uint w, uint h, uint fps)
+{
+  std::vector<std::vector<uchar>> frames;
+#ifdef VR_RECORDED_FRAMES_PATH
+  w = VR_RECORDED_FRAMES_W;
+  h = VR_RECORDED_FRAMES_H;
+  if (!recorded_frames(frames, w, h))
+#endif
+  {
+    synthetic_frames(frames, w, h);
+  }
+
+  VR_Network_Encoder *encoder = VR_Network_Encoder::create(type, w, h, FRAME_D, fps);
+  if (!encoder) {
+    printf("%-10s %4ux%-4u : not available\n", VR_Network_Encoder::name(type), w, h);
+    return;
+  }
+
+  VR_Network_Decoder_DeltaRLE decoder;
+  std::vector<uchar> encoded, decoded;
+  size_t bytes = 0;
+  double time_encode = 0.0;
+
+  for (size_t i = 0; i < frames.size(); i++) {
+    const double start = PIL_check_seconds_timer();
+    EXPECT_TRUE(encoder->encode(&frames[i][0], encoded));
+    time_encode += PIL_check_seconds_timer() - start;
+    bytes += encoded.size();
+
+    /* Loopback: verify the lossless codec. */
+    if (type == VR_Network_Encoder::TYPE_DELTA_RLE) {
+      EXPECT_TRUE(decoder.decode(&encoded[0], (uint)encoded.size(), decoded));
+      EXPECT_EQ(frames[i], decoded);
+    }
+  }
+
+  const double n = (double)frames.size();
+  printf("%-10s %4ux%-4u : %8.3f ms/frame, %10.1f bytes/frame (%5.2f%% of raw)\n",
+         VR_Network_Encoder::name(type),
+         w,
+         h,
+         time_encode * 1000.0 / n,
+         (double)bytes / n,
+         100.0 * (double)bytes / (n * w * h * FRAME_D));
+
+  delete encoder;
+}
+
+static void codec_benchmark_all(uint w, uint h)
+{
+  for (int type = 0; type < VR_Network_Encoder::TYPES; type++) {
+    codec_benchmark((VR_Network_Encoder::Type)type, w, h, 30);
+  }
+}
+
+TEST(vr_network_codec, Loopback_320x240)
+{
+  codec_benchmark_all(320, 240);
+}
+
+TEST(vr_network_codec, Loopback_640x480)
+{
+  codec_benchmark_all(640, 480);
+}
+
+TEST(vr_network_codec, Loopback_1280x960)
+{
+  codec_benchmark_all(1280, 960);
+}
@@ -0,0 +1,114 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_network_codec.h"
+
+#define TEST_W 64
+#define TEST_H 48
+#define TEST_D 4
+
+static void fill_frame(std::vector<uchar> &pixels, int frame)
+{
+  pixels.resize(TEST_W * TEST_H * TEST_D);
+  for (int y = 0; y < TEST_H; y++) {
+    for (int x = 0; x < TEST_W; x++) {
+      uchar *p = &pixels[(y * TEST_W + x) * TEST_D];
+      /* Flat background with a moving square. */
+      const bool inside = (x >= frame && x < frame + 8 && y >= 10 && y < 18);
+      p[0] = inside ? 255 : 40;
+      p[1] = inside ? (uchar)(x * 3) : 40;
+      p[2] = inside ? (uchar)(y * 5) : 50;
+      p[3] = 255;
+    }
+  }
+}
+
+TEST(vr_network_codec, DeltaRLERoundTrip)
+{
+  VR_Network_Encoder *encoder = VR_Network_Encoder::create(
+      VR_Network_Encoder::TYPE_DELTA_RLE, TEST_W, TEST_H, TEST_D, 30);
+  ASSERT_TRUE(encoder != NULL);
+
+  VR_Network_Decoder_DeltaRLE decoder;
+  std::vector<uchar> pixels, encoded, decoded;
+
+  for (int frame = 0; frame < 40; frame++) {
+    fill_frame(pixels, frame);
+    EXPECT_TRUE(encoder->encode(&pixels[0], encoded));
+    EXPECT_TRUE(decoder.decode(&encoded[0], (uint)encoded.size(), decoded));
+    EXPECT_EQ(pixels, decoded);
+  }
+
+  delete encoder;
+}
+
+TEST(vr_network_codec, DeltaRLEKeyframes)
+{
+  VR_Network_Encoder *encoder = VR_Network_Encoder::create(
+      VR_Network_Encoder::TYPE_DELTA_RLE, TEST_W, TEST_H, TEST_D, 30);
+  std::vector<uchar> pixels, encoded;
+  VR_Network_Encoder::FrameHeader header;
+
+  fill_frame(pixels, 0);
+  encoder->encode(&pixels[0], encoded);
+  memcpy(&header, &encoded[0], sizeof(header));
+  EXPECT_EQ(header.magic, VR_NETWORK_FRAME_MAGIC);
+  EXPECT_EQ(header.keyframe, 1);
+  EXPECT_EQ(header.size, encoded.size() - sizeof(header));
+
+  /* Unchanged frame: a single zero residual, a few bytes of RLE. */
+  encoder->encode(&pixels[0], encoded);
+  memcpy(&header, &encoded[0], sizeof(header));
+  EXPECT_EQ(header.keyframe, 0);
+  EXPECT_LT(encoded.size(), sizeof(header) + (TEST_W * TEST_H / 128 + 1) * (1 + TEST_D));
+
+  encoder->request_keyframe();
+  encoder->encode(&pixels[0], encoded);
+  memcpy(&header, &encoded[0], sizeof(header));
+  EXPECT_EQ(header.keyframe, 1);
+
+  delete encoder;
+}
+
+TEST(vr_network_codec, DecoderRejectsInterFrameWithoutReference)
+{
+  VR_Network_Encoder *encoder = VR_Network_Encoder::create(
+      VR_Network_Encoder::TYPE_DELTA_RLE, TEST_W, TEST_H, TEST_D, 30);
+  std::vector<uchar> pixels, encoded, decoded;
+
+  fill_frame(pixels, 0);
+  encoder->encode(&pixels[0], encoded);
+  fill_frame(pixels, 1);
+  encoder->encode(&pixels[0], encoded);
+
+  VR_Network_Decoder_DeltaRLE decoder;
+  EXPECT_FALSE(decoder.decode(&encoded[0], (uint)encoded.size(), decoded));
+  /* Truncated data. */
+  EXPECT_FALSE(decoder.decode(&encoded[0], (uint)encoded.size() - 1, decoded));
+
+  delete encoder;
+}
+
+TEST(vr_network_codec, Zlib)
+{
+  VR_Network_Encoder *encoder = VR_Network_Encoder::create(
+      VR_Network_Encoder::TYPE_ZLIB, TEST_W, TEST_H, TEST_D, 30);
+  ASSERT_TRUE(encoder != NULL);
+  std::vector<uchar> pixels, encoded;
+  fill_frame(pixels, 0);
+  EXPECT_TRUE(encoder->encode(&pixels[0], encoded));
+  EXPECT_GT(encoded.size(), 0u);
+  EXPECT_LT(encoded.size(), pixels.size());
+  /* Legacy stream: zlib header, no frame header. */
+  EXPECT_EQ(encoded[0], 0x78);
+  delete encoder;
+}
+
+TEST(vr_network_codec, InvalidParams)
+{
+  EXPECT_TRUE(VR_Network_Encoder::create(VR_Network_Encoder::TYPE_ZLIB, 0, TEST_H, TEST_D, 30) ==
+              NULL);
+  EXPECT_TRUE(VR_Network_Encoder::create(VR_Network_Encoder::TYPES, TEST_W, TEST_H, TEST_D, 30) ==
+              NULL);
+}
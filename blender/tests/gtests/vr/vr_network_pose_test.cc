@@ -0,0 +1,259 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_network_pose.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/* Port of the loopback test (not the one used by Blender, so a running session doesn't interfere). */
+#define TEST_PORT 27211
+
+/* Tracking data with all poses at x (and a rotation of x radians around z). */
+static void make_data(double x, VR_Network_TrackingData &r_data)
+{
+  memset(&r_data, 0, sizeof(r_data));
+  float m[4][4];
+  memset(m, 0, sizeof(m));
+  m[0][0] = (float)cos(x);
+  m[0][1] = (float)sin(x);
+  m[1][0] = (float)-sin(x);
+  m[1][1] = (float)cos(x);
+  m[2][2] = 1.0f;
+  m[3][0] = (float)x;
+  m[3][3] = 1.0f;
+  memcpy(r_data.t_hmd, m, sizeof(m));
+  for (int i = 0; i < VR_SIDES; i++) {
+    memcpy(r_data.t_eye[i], m, sizeof(m));
+  }
+  for (int i = 0; i < VR_MAX_CONTROLLERS; i++) {
+    memcpy(r_data.t_controller[i], m, sizeof(m));
+  }
+}
+
+static VR_Network_PosePacket make_packet(uint seq, double time, double x)
+{
+  VR_Network_PosePacket packet;
+  memcpy(packet.magic, VR_Network_PoseBuffer::magic_sequence, sizeof(packet.magic));
+  packet.seq = seq;
+  packet.time = time;
+  make_data(x, packet.data);
+  return packet;
+}
+
+TEST(vr_network_pose, Sequence)
+{
+  VR_Network_PoseBuffer buffer;
+  VR_Network_TrackingData data;
+  EXPECT_FALSE(buffer.sample(0.0, data));
+  EXPECT_FALSE(buffer.latest(data));
+
+  EXPECT_TRUE(buffer.push(make_packet(0, 0.00, 0.0), 0.001));
+  EXPECT_TRUE(buffer.push(make_packet(1, 0.01, 1.0), 0.011));
+  EXPECT_TRUE(buffer.push(make_packet(3, 0.03, 3.0), 0.031));
+  EXPECT_TRUE(buffer.push(make_packet(4, 0.04, 4.0), 0.041));
+  /* Reordered. */
+  EXPECT_TRUE(buffer.push(make_packet(2, 0.02, 2.0), 0.042));
+  /* Duplicates. */
+  EXPECT_FALSE(buffer.push(make_packet(2, 0.02, 2.0), 0.043));
+  EXPECT_FALSE(buffer.push(make_packet(4, 0.04, 4.0), 0.044));
+  /* Lost. */
+  EXPECT_TRUE(buffer.push(make_packet(7, 0.07, 7.0), 0.071));
+  /* Not a pose packet. */
+  VR_Network_PosePacket packet = make_packet(8, 0.08, 8.0);
+  packet.magic[0] = 0;
+  EXPECT_FALSE(buffer.push(packet, 0.081));
+
+  VR_Network_PoseBuffer::Stats stats = buffer.get_stats();
+  EXPECT_EQ(stats.received, 6);
+  EXPECT_EQ(stats.reordered, 1);
+  EXPECT_EQ(stats.duplicates, 2);
+  EXPECT_EQ(stats.lost, 2);
+  EXPECT_EQ(stats.late, 0);
+
+  EXPECT_TRUE(buffer.latest(data));
+  EXPECT_FLOAT_EQ(data.t_hmd[3][0], 7.0f);
+}
+
+TEST(vr_network_pose, Interpolation)
+{
+  VR_Network_PoseBuffer buffer;
+  buffer.min_delay = buffer.max_delay = 0.002;
+
+  /* The client clock is way off, only the difference matters. */
+  const double offset = 100.0;
+  buffer.push(make_packet(0, offset + 0.00, 0.0), 0.001);
+  buffer.push(make_packet(1, offset + 0.01, 1.0), 0.011);
+  buffer.push(make_packet(3, offset + 0.03, 3.0), 0.031);
+
+  VR_Network_TrackingData data;
+  double pose_time;
+  /* 0.008 - 0.001 (transit) - 0.002 (delay). */
+  EXPECT_TRUE(buffer.sample(0.008, data, &pose_time));
+  EXPECT_NEAR(pose_time, offset + 0.005, 1e-9);
+  EXPECT_NEAR(data.t_hmd[3][0], 0.5f, 1e-4f);
+  EXPECT_NEAR(data.t_controller[VR_MAX_CONTROLLERS - 1][3][0], 0.5f, 1e-4f);
+  EXPECT_NEAR(data.t_eye[VR_SIDE_RIGHT][0][0], (float)cos(0.5), 1e-4f);
+  EXPECT_NEAR(data.t_eye[VR_SIDE_RIGHT][0][1], (float)sin(0.5), 1e-4f);
+
+  /* Across the lost packet. */
+  EXPECT_TRUE(buffer.sample(0.023, data, &pose_time));
+  EXPECT_NEAR(data.t_hmd[3][0], 2.0f, 1e-4f);
+
+  /* Past the newest packet: the newest pose is held. */
+  EXPECT_TRUE(buffer.sample(0.050, data, &pose_time));
+  EXPECT_NEAR(pose_time, offset + 0.03, 1e-9);
+  EXPECT_NEAR(data.t_hmd[3][0], 3.0f, 1e-4f);
+  EXPECT_EQ(buffer.get_stats().underruns, 1);
+
+  /* The lost packet arrives after its playout time. */
+  EXPECT_FALSE(buffer.push(make_packet(2, offset + 0.02, 2.0), 0.051));
+  EXPECT_EQ(buffer.get_stats().late, 1);
+
+  /* A restarted client starts over. */
+  EXPECT_TRUE(buffer.push(make_packet(0, 0.0, 0.0), 0.052));
+  EXPECT_TRUE(buffer.latest(data));
+  EXPECT_FLOAT_EQ(data.t_hmd[3][0], 0.0f);
+}
+
+/* Packet on the (simulated) network. */
+typedef struct SimPacket {
+  double time_arrival;
+  VR_Network_PosePacket packet;
+} SimPacket;
+
+static bool sim_packet_cmp(const SimPacket &a, const SimPacket &b)
+{
+  return a.time_arrival < b.time_arrival;
+}
+
+/* Poses at 90 Hz over a network that loses, duplicates and reorders packets, played out at 60 Hz.
+ * The pose moves at 1 unit / second, so the position error is the time error of the pose. */
+static void test_lossy_stream(const char *name,
+                              double transit,
+                              double jitter,
+                              double loss,
+                              double reorder,
+                              double duplicate)
+{
+  const double duration = 20.0;
+  const double rate = 90.0, display_rate = 60.0;
+  const double clock_offset = -1000.0;
+
+  srand(0);
+  std::vector<SimPacket> network;
+  for (uint seq = 0; seq < (uint)(duration * rate); seq++) {
+    const double time = seq / rate;
+    if (rand() < loss * RAND_MAX) {
+      continue;
+    }
+    SimPacket p;
+    p.time_arrival = time + transit + jitter * rand() / RAND_MAX;
+    if (rand() < reorder * RAND_MAX) {
+      /* Held back behind the next packet(s). */
+      p.time_arrival += 1.5 / rate;
+    }
+    p.packet = make_packet(seq, time + clock_offset, time);
+    network.push_back(p);
+    if (rand() < duplicate * RAND_MAX) {
+      p.time_arrival += 0.5 / rate;
+      network.push_back(p);
+    }
+  }
+  std::stable_sort(network.begin(), network.end(), sim_packet_cmp);
+
+  VR_Network_PoseBuffer buffer;
+  VR_Network_TrackingData data;
+  double latency_sum = 0.0, latency_max = 0.0, error_max = 0.0;
+  uint samples = 0;
+  size_t next = 0;
+  for (double time = 1.0; time < duration; time += 1.0 / display_rate) {
+    for (; next < network.size() && network[next].time_arrival <= time; next++) {
+      buffer.push(network[next].packet, network[next].time_arrival);
+    }
+    double pose_time;
+    ASSERT_TRUE(buffer.sample(time, data, &pose_time));
+    const double latency = time - (pose_time - clock_offset);
+    latency_sum += latency;
+    latency_max = std::max(latency_max, latency);
+    /* Linear motion, so the interpolated pose is exact at its time. */
+    error_max = std::max(error_max, fabs(data.t_hmd[3][0] - (pose_time - clock_offset)));
+    samples++;
+  }
+
+  const VR_Network_PoseBuffer::Stats stats = buffer.get_stats();
+  EXPECT_LT(error_max, 1e-3);
+  /* The playout delay covers the jitter: hardly any pose is held, or dropped as too late. */
+  EXPECT_LT(stats.underruns, samples / 20);
+  EXPECT_LT(stats.late, stats.received / 20);
+  EXPECT_LT(latency_max, transit + jitter + VR_Network_PoseBuffer::default_max_delay + 1.0 / rate);
+
+  printf("%s: %u packets, %u lost, %u reordered, %u duplicates, %u late\n",
+         name,
+         stats.received,
+         stats.lost,
+         stats.reordered,
+         stats.duplicates,
+         stats.late);
+  printf("  Jitter %.2f ms, playout delay %.2f ms, pose latency %.2f ms (max %.2f), %u of %u held\n",
+         stats.jitter * 1000.0,
+         stats.delay * 1000.0,
+         latency_sum * 1000.0 / samples,
+         latency_max * 1000.0,
+         stats.underruns,
+         samples);
+}
+
+TEST(vr_network_pose, LossyStream)
+{
+  test_lossy_stream("Clean", 0.002, 0.001, 0.0, 0.0, 0.0);
+  test_lossy_stream("WiFi", 0.003, 0.006, 0.02, 0.02, 0.0);
+  test_lossy_stream("Bad WiFi", 0.005, 0.012, 0.10, 0.10, 0.02);
+}
+
+TEST(vr_network_pose, Loopback)
+{
+  VR_Network_PoseChannel channel;
+  if (!channel.open("127.0.0.1", TEST_PORT)) {
+    printf("Loopback: can't bind to port %d, skipped\n", TEST_PORT);
+    return;
+  }
+  VR_Network_PoseClient client;
+  ASSERT_TRUE(client.open("127.0.0.1", TEST_PORT));
+
+  VR_Network_PoseBuffer buffer;
+  VR_Network_TrackingData data;
+  std::vector<VR_Network_PosePacket> packets;
+  for (int i = 0; i < 20; i++) {
+    make_data(i, data);
+    packets.push_back(client.make_packet(data, i * 0.01));
+  }
+  /* Lose 5, swap 10 and 11, duplicate 15. */
+  packets.erase(packets.begin() + 5);
+  std::swap(packets[9], packets[10]);
+  packets.insert(packets.begin() + 15, packets[14]);
+  for (size_t i = 0; i < packets.size(); i++) {
+    EXPECT_TRUE(client.send(packets[i]));
+  }
+
+  int received = 0;
+  for (int i = 0; i < 10 && received < 19; i++) {
+    const int ret = channel.receive(buffer, 100);
+    ASSERT_GE(ret, 0);
+    received += ret;
+  }
+  EXPECT_EQ(received, 19);
+
+  const VR_Network_PoseBuffer::Stats stats = buffer.get_stats();
+  EXPECT_EQ(stats.lost, 1);
+  EXPECT_EQ(stats.reordered, 1);
+  EXPECT_EQ(stats.duplicates, 1);
+
+  EXPECT_TRUE(buffer.latest(data));
+  EXPECT_FLOAT_EQ(data.t_hmd[3][0], 19.0f);
+}
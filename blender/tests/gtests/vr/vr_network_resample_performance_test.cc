@@ -0,0 +1,115 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_network_resample.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+extern "C" {
+#include "PIL_time.h"
+}
+
+#define NUM_ITERATIONS 100
+
+/* Original VR_Network::resample_pixels() (without OpenMP), for comparison. */
+static void resample_reference(const uchar *pixels,
+                               uint w_old,
+                               uint h_old,
+                               uchar *pixels_new,
+                               uint w_new,
+                               uint h_new,
+                               uint depth,
+                               const uint *depth_buffer)
+{
+  uchar *depth_buffer_u8 = (uchar *)depth_buffer;
+  int size_old = (int)(w_old * h_old * depth);
+  float w_scale = (float)w_new / (float)w_old;
+  float h_scale = (float)h_new / (float)h_old;
+  for (int y = 0; y < (int)h_new; ++y) {
+    for (int x = 0; x < (int)w_new; ++x) {
+      int pixel = (y * (w_new * depth) + ((w_new - x) * depth)) - depth;
+      int closest_pixel = ((int)((float)y / h_scale) * (w_old * depth)) +
+                          ((int)((float)x / w_scale) * depth);
+      int offset = (size_old - 1) - closest_pixel;
+      pixels_new[pixel] = pixels[offset + 1];
+      pixels_new[pixel + 1] = pixels[offset + 2];
+      pixels_new[pixel + 2] = pixels[offset + 3];
+      uint d_u32 = *(uint *)(&depth_buffer_u8[offset]);
+      float d = (d_u32 >> 8) / 16777215.0f;
+      pixels_new[pixel + 3] = (d == 1.0f) ? 0 : 255;
+    }
+  }
+}
+
+static void resample_benchmark(uint w_old, uint h_old, uint w_new, uint h_new)
+{
+  /* One pixel of padding for the reference (see vr_network_resample_test.cc). */
+  std::vector<uchar> pixels((w_old * h_old + 1) * 4);
+  std::vector<uint> depth(w_old * h_old + 1);
+  for (size_t i = 0; i < pixels.size(); i++) {
+    pixels[i] = (uchar)(rand() & 0xFF);
+  }
+  for (size_t i = 0; i < depth.size(); i++) {
+    depth[i] = (i % 3) ? 0xFFFFFFFF : (uint)rand();
+  }
+  std::vector<uchar> pixels_new(w_new * h_new * 4);
+
+  double time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    resample_reference(&pixels[0], w_old, h_old, &pixels_new[0], w_new, h_new, 4, &depth[0]);
+  }
+  time = PIL_check_seconds_timer() - time;
+  printf("%4ux%-4u -> %4ux%-4u %-8s %-9s: %8.3f ms/frame\n",
+         w_old,
+         h_old,
+         w_new,
+         h_new,
+         "Nearest",
+         "Original",
+         time * 1000.0 / NUM_ITERATIONS);
+
+  const VR_Network_Resample::ISA isas[] = {
+      VR_Network_Resample::ISA_SCALAR,
+      VR_Network_Resample::ISA_SSE2,
+      VR_Network_Resample::ISA_AVX2,
+  };
+  for (int filter = 0; filter < VR_Network_Resample::FILTERS; filter++) {
+    for (int i = 0; i < 3; i++) {
+      if (!VR_Network_Resample::is_supported(isas[i])) {
+        continue;
+      }
+      time = PIL_check_seconds_timer();
+      for (int j = 0; j < NUM_ITERATIONS; j++) {
+        VR_Network_Resample::resample(&pixels[0],
+                                      w_old,
+                                      h_old,
+                                      &pixels_new[0],
+                                      w_new,
+                                      h_new,
+                                      4,
+                                      &depth[0],
+                                      (VR_Network_Resample::Filter)filter,
+                                      isas[i]);
+      }
+      time = PIL_check_seconds_timer() - time;
+      printf("%4ux%-4u -> %4ux%-4u %-8s %-9s: %8.3f ms/frame\n",
+             w_old,
+             h_old,
+             w_new,
+             h_new,
+             (filter == VR_Network_Resample::FILTER_NEAREST) ? "Nearest" : "Bilinear",
+             VR_Network_Resample::name(isas[i]),
+             time * 1000.0 / NUM_ITERATIONS);
+    }
+  }
+}
+
+TEST(vr_network_resample, Performance)
+{
+  srand(0);
+  resample_benchmark(1920, 1080, 320, 240);
+  resample_benchmark(1440, 1600, 640, 480);
+  resample_benchmark(1440, 1600, 1440, 1600);
+}
@@ -0,0 +1,199 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_network_resample.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Original VR_Network::resample_pixels(), kept verbatim as the reference. */
+static void resample_reference(const uchar *pixels,
+                               uint w_old,
+                               uint h_old,
+                               uchar *pixels_new,
+                               uint w_new,
+                               uint h_new,
+                               uint depth,
+                               const uint *depth_buffer)
+{
+  bool depth_to_alpha = depth_buffer ? true : false;
+  uchar *depth_buffer_u8 = depth_buffer ? (uchar *)depth_buffer : NULL;
+
+  int size_old = (int)(w_old * h_old * depth);
+  float w_scale = (float)w_new / (float)w_old;
+  float h_scale = (float)h_new / (float)h_old;
+  for (int y = 0; y < (int)h_new; ++y) {
+    for (int x = 0; x < (int)w_new; ++x) {
+      int pixel = (y * (w_new * depth) + ((w_new - x) * depth)) - depth;
+      int closest_pixel = ((int)((float)y / h_scale) * (w_old * depth)) +
+                          ((int)((float)x / w_scale) * depth);
+      int offset = (size_old - 1) - closest_pixel;
+      pixels_new[pixel] = pixels[offset + 1];
+      pixels_new[pixel + 1] = pixels[offset + 2];
+      pixels_new[pixel + 2] = pixels[offset + 3];
+      if (depth_to_alpha) {
+        uint d_u32 = *(uint *)(&depth_buffer_u8[offset]);
+        float d = (d_u32 >> 8) / 16777215.0f;
+        if (d == 1.0f) {
+          pixels_new[pixel + 3] = 0;
+        }
+        else {
+          pixels_new[pixel + 3] = 255;
+        }
+      }
+      else {
+        pixels_new[pixel + 3] = 255;
+      }
+    }
+  }
+}
+
+/* Random image and depth buffer. The reference reads one pixel past the end of both buffers,
+ * so they are padded with a copy of the last pixel (which is what the kernel reads instead). */
+static void random_input(std::vector<uchar> &pixels, std::vector<uint> &depth, uint w, uint h)
+{
+  const uint n = w * h;
+  pixels.resize((n + 1) * 4);
+  depth.resize(n + 1);
+  for (uint i = 0; i < n * 4; i++) {
+    pixels[i] = (uchar)(rand() & 0xFF);
+  }
+  for (uint i = 0; i < n; i++) {
+    /* Plenty of background, plus values that differ from it in a single byte. */
+    const int r = rand() % 4;
+    depth[i] = (r == 0) ? 0xFFFFFFFF : (r == 1) ? 0x00FFFFFF : (r == 2) ? 0xFFFFFF00 : (uint)rand();
+  }
+  memcpy(&pixels[n * 4], &pixels[(n - 1) * 4], 4);
+  depth[n] = depth[n - 1];
+}
+
+static const VR_Network_Resample::ISA isas[] = {
+    VR_Network_Resample::ISA_SCALAR,
+    VR_Network_Resample::ISA_SSE2,
+    VR_Network_Resample::ISA_AVX2,
+};
+
+static void test_nearest(uint w_old, uint h_old, uint w_new, uint h_new)
+{
+  std::vector<uchar> pixels;
+  std::vector<uint> depth;
+  random_input(pixels, depth, w_old, h_old);
+
+  for (int with_depth = 0; with_depth < 2; with_depth++) {
+    const uint *depth_buffer = with_depth ? &depth[0] : NULL;
+    std::vector<uchar> expected(w_new * h_new * 4);
+    resample_reference(&pixels[0], w_old, h_old, &expected[0], w_new, h_new, 4, depth_buffer);
+
+    for (int i = 0; i < (int)(sizeof(isas) / sizeof(*isas)); i++) {
+      if (!VR_Network_Resample::is_supported(isas[i])) {
+        continue;
+      }
+      std::vector<uchar> result(w_new * h_new * 4, 0x55);
+      EXPECT_TRUE(VR_Network_Resample::resample(&pixels[0],
+                                                w_old,
+                                                h_old,
+                                                &result[0],
+                                                w_new,
+                                                h_new,
+                                                4,
+                                                depth_buffer,
+                                                VR_Network_Resample::FILTER_NEAREST,
+                                                isas[i]));
+      EXPECT_TRUE(result == expected)
+          << VR_Network_Resample::name(isas[i]) << " " << w_old << "x" << h_old << " -> "
+          << w_new << "x" << h_new << (with_depth ? " (depth)" : "");
+    }
+  }
+}
+
+TEST(vr_network_resample, NearestBitExact)
+{
+  srand(0);
+  test_nearest(1920, 1080, 320, 240);
+  test_nearest(1440, 1600, 320, 240);
+  test_nearest(640, 480, 320, 240);
+  test_nearest(333, 217, 101, 67);
+  test_nearest(320, 240, 320, 240);
+  test_nearest(61, 37, 160, 90);
+  test_nearest(7, 5, 3, 2);
+  test_nearest(1, 1, 9, 9);
+}
+
+TEST(vr_network_resample, BilinearISAsMatch)
+{
+  srand(1);
+  const uint w_old = 517, h_old = 311, w_new = 160, h_new = 120;
+  std::vector<uchar> pixels;
+  std::vector<uint> depth;
+  random_input(pixels, depth, w_old, h_old);
+
+  std::vector<uchar> expected(w_new * h_new * 4);
+  EXPECT_TRUE(VR_Network_Resample::resample(&pixels[0],
+                                            w_old,
+                                            h_old,
+                                            &expected[0],
+                                            w_new,
+                                            h_new,
+                                            4,
+                                            &depth[0],
+                                            VR_Network_Resample::FILTER_BILINEAR,
+                                            VR_Network_Resample::ISA_SCALAR));
+  for (int i = 1; i < (int)(sizeof(isas) / sizeof(*isas)); i++) {
+    if (!VR_Network_Resample::is_supported(isas[i])) {
+      continue;
+    }
+    std::vector<uchar> result(w_new * h_new * 4);
+    EXPECT_TRUE(VR_Network_Resample::resample(&pixels[0],
+                                              w_old,
+                                              h_old,
+                                              &result[0],
+                                              w_new,
+                                              h_new,
+                                              4,
+                                              &depth[0],
+                                              VR_Network_Resample::FILTER_BILINEAR,
+                                              isas[i]));
+    EXPECT_TRUE(result == expected) << VR_Network_Resample::name(isas[i]);
+  }
+}
+
+TEST(vr_network_resample, BilinearIdentity)
+{
+  /* Same size: the image is only flipped vertically. */
+  srand(2);
+  const uint w = 64, h = 48;
+  std::vector<uchar> pixels;
+  std::vector<uint> depth;
+  random_input(pixels, depth, w, h);
+
+  std::vector<uchar> result(w * h * 4);
+  EXPECT_TRUE(VR_Network_Resample::resample(&pixels[0],
+                                            w,
+                                            h,
+                                            &result[0],
+                                            w,
+                                            h,
+                                            4,
+                                            NULL,
+                                            VR_Network_Resample::FILTER_BILINEAR));
+  for (uint y = 0; y < h; y++) {
+    for (uint x = 0; x < w; x++) {
+      const uchar *s = &pixels[((h - 1 - y) * w + x) * 4];
+      const uchar *d = &result[(y * w + x) * 4];
+      EXPECT_EQ(s[0], d[0]);
+      EXPECT_EQ(s[1], d[1]);
+      EXPECT_EQ(s[2], d[2]);
+      EXPECT_EQ(255, d[3]);
+    }
+  }
+}
+
+TEST(vr_network_resample, InvalidArguments)
+{
+  uchar pixels[4 * 4], pixels_new[4 * 4];
+  EXPECT_FALSE(VR_Network_Resample::resample(NULL, 2, 2, pixels_new, 2, 2, 4));
+  EXPECT_FALSE(VR_Network_Resample::resample(pixels, 2, 2, NULL, 2, 2, 4));
+  EXPECT_FALSE(VR_Network_Resample::resample(pixels, 2, 2, pixels_new, 2, 2, 3));
+  EXPECT_FALSE(VR_Network_Resample::resample(pixels, 0, 2, pixels_new, 2, 2, 4));
+}
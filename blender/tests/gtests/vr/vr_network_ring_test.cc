@@ -0,0 +1,158 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_network_ring.h"
+
+#include <chrono>
+#include <thread>
+
+#define TEST_W 16
+#define TEST_H 8
+#define TEST_D 4
+
+static void fill_slot(VR_Network_FrameRing::Slot *slot, uchar value)
+{
+  slot->resize(TEST_W, TEST_H, TEST_D);
+  for (int i = 0; i < VR_SIDES; i++) {
+    std::fill(slot->pixels[i].begin(), slot->pixels[i].end(), value);
+  }
+}
+
+TEST(vr_network_ring, SingleThreaded)
+{
+  VR_Network_FrameRing ring;
+
+  /* Nothing captured yet. */
+  EXPECT_EQ(ring.acquire_encode(0), (VR_Network_FrameRing::Slot *)NULL);
+  EXPECT_EQ(ring.acquire_send(0, true), (VR_Network_FrameRing::Slot *)NULL);
+
+  VR_Network_FrameRing::Slot *capture = ring.acquire_capture();
+  ASSERT_TRUE(capture != NULL);
+  fill_slot(capture, 1);
+  ring.publish_capture(capture);
+
+  /* A newer capture replaces the one the encoder did not pick up yet. */
+  VR_Network_FrameRing::Slot *capture2 = ring.acquire_capture();
+  EXPECT_EQ(capture, capture2);
+  fill_slot(capture2, 2);
+  ring.publish_capture(capture2);
+
+  VR_Network_FrameRing::Slot *encode = ring.acquire_encode(0);
+  ASSERT_TRUE(encode != NULL);
+  EXPECT_EQ(encode->pixels[VR_SIDE_LEFT][0], 2);
+  encode->encoded[VR_SIDE_LEFT] = encode->pixels[VR_SIDE_LEFT];
+  ring.publish_encode(encode, true);
+
+  /* The encoder waits for the sender before taking the next frame. */
+  capture = ring.acquire_capture();
+  ASSERT_TRUE(capture != NULL);
+  EXPECT_NE(capture, encode);
+  fill_slot(capture, 3);
+  ring.publish_capture(capture);
+  EXPECT_EQ(ring.acquire_encode(0), (VR_Network_FrameRing::Slot *)NULL);
+
+  VR_Network_FrameRing::Slot *send = ring.acquire_send(0, false);
+  EXPECT_EQ(send, encode);
+  ring.release_send(send);
+
+  /* The last sent frame can be re-sent, but only if requested. */
+  EXPECT_EQ(ring.acquire_send(0, false), (VR_Network_FrameRing::Slot *)NULL);
+  send = ring.acquire_send(0, true);
+  EXPECT_EQ(send, encode);
+  ring.release_send(send);
+
+  /* All three slots are in use: captured, (empty) capturing and sent. */
+  encode = ring.acquire_encode(0);
+  ASSERT_TRUE(encode != NULL);
+  EXPECT_EQ(encode->pixels[VR_SIDE_RIGHT][0], 3);
+  capture = ring.acquire_capture();
+  ASSERT_TRUE(capture != NULL);
+  EXPECT_EQ(ring.acquire_capture(), (VR_Network_FrameRing::Slot *)NULL);
+  ring.cancel_capture(capture);
+  ring.publish_encode(encode, false);
+  EXPECT_EQ(ring.acquire_send(0, false), (VR_Network_FrameRing::Slot *)NULL);
+}
+
+TEST(vr_network_ring, Threaded)
+{
+  VR_Network_FrameRing ring;
+  const int frames = 2000;
+  std::atomic<bool> done(false);
+  int torn = 0;
+  int sent = 0;
+  int out_of_order = 0;
+  int capture_failed = 0;
+
+  /* Encoder: "encodes" by copying, so the sender can detect torn frames. */
+  std::thread encoder([&] {
+    while (!done) {
+      VR_Network_FrameRing::Slot *slot = ring.acquire_encode(10);
+      if (!slot) {
+        continue;
+      }
+      for (int i = 0; i < VR_SIDES; i++) {
+        slot->encoded[i] = slot->pixels[i];
+      }
+      ring.publish_encode(slot, true);
+    }
+  });
+
+  std::thread sender([&] {
+    ui64 seq_last = 0;
+    bool first = true;
+    while (!done) {
+      VR_Network_FrameRing::Slot *slot = ring.acquire_send(10, false);
+      if (!slot) {
+        continue;
+      }
+      const uchar value = slot->encoded[VR_SIDE_LEFT][0];
+      for (int i = 0; i < VR_SIDES; i++) {
+        for (size_t j = 0; j < slot->encoded[i].size(); j++) {
+          if (slot->encoded[i][j] != value || slot->pixels[i][j] != value) {
+            torn++;
+            break;
+          }
+        }
+      }
+      if (!first && slot->seq <= seq_last) {
+        out_of_order++;
+      }
+      first = false;
+      seq_last = slot->seq;
+      sent++;
+      ring.release_send(slot);
+    }
+  });
+
+  for (int frame = 0; frame < frames; frame++) {
+    VR_Network_FrameRing::Slot *slot = ring.acquire_capture();
+    if (!slot) {
+      capture_failed++;
+      continue;
+    }
+    fill_slot(slot, (uchar)frame);
+    ring.publish_capture(slot);
+    if (frame % 64 == 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  /* Let the pipeline drain. */
+  for (int i = 0; i < 100 && ring.state(0) != VR_Network_FrameRing::STATE_FREE &&
+                  ring.state(0) != VR_Network_FrameRing::STATE_SENT;
+       i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+
+  done = true;
+  ring.wake_all();
+  encoder.join();
+  sender.join();
+
+  EXPECT_EQ(capture_failed, 0);
+  EXPECT_EQ(torn, 0);
+  EXPECT_EQ(out_of_order, 0);
+  EXPECT_GT(sent, 0);
+  EXPECT_LE(sent, frames);
+}
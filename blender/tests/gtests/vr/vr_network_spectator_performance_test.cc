@@ -0,0 +1,178 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_network_spectator.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+extern "C" {
+#include "PIL_time.h"
+}
+
+/* Port of the benchmark (not the one used by Blender, so a running session doesn't interfere). */
+#define TEST_PORT 27213
+#define FRAME_W 640
+#define FRAME_H 480
+#define FRAME_D 4
+/* Capture rate of the headset stream and length of each run. */
+#define CAPTURE_FPS 60
+#define NUM_FRAMES 180
+
+/* Dummy spectator: receives frames as fast as it can and counts them. */
+typedef struct BenchClient {
+  VR_Network_SpectatorVariant variant;
+  std::atomic<uint> frames;
+  double time_first;
+  double time_last;
+} BenchClient;
+
+static void bench_client_func(BenchClient *bench, std::atomic<bool> *running)
+{
+  VR_Network_SpectatorClient client;
+  if (!client.open("127.0.0.1", TEST_PORT, bench->variant)) {
+    return;
+  }
+  VR_Network_SpectatorFrameHeader header;
+  std::vector<uchar> images[VR_SIDES];
+  while (*running) {
+    const int ret = client.receive(header, images, 100);
+    if (ret < 0) {
+      break;
+    }
+    if (ret > 0) {
+      const double time = PIL_check_seconds_timer();
+      if (bench->frames++ == 0) {
+        bench->time_first = time;
+      }
+      bench->time_last = time;
+    }
+  }
+}
+
+/* Synthetic viewport: grid floor, flat background and a moving object. */
+static void synthetic_frame(VR_Network_FrameRing::Slot &slot, int f)
+{
+  for (int i = 0; i < VR_SIDES; i++) {
+    for (uint y = 0; y < FRAME_H; y++) {
+      for (uint x = 0; x < FRAME_W; x++) {
+        uchar *p = &slot.pixels[i][(y * FRAME_W + x) * FRAME_D];
+        const bool floor = (y > FRAME_H / 2);
+        const bool grid = floor && (((x + f) % 32) == 0 || (y % 16) == 0);
+        const int cx = FRAME_W / 4 + (f * 2 + i * 8) % (FRAME_W / 2);
+        const int dx = (int)x - cx, dy = (int)y - FRAME_H / 2;
+        const bool object = (dx * dx + dy * dy) < FRAME_H * FRAME_H / 36;
+        p[0] = object ? (uchar)(200 - dy) : grid ? 90 : 57;
+        p[1] = object ? (uchar)(120 + dx) : grid ? 90 : 57;
+        p[2] = object ? 60 : grid ? 90 : 57;
+        p[3] = (object || floor) ? 255 : 0;
+      }
+    }
+  }
+}
+
+static void spectator_benchmark(VR_Network_Encoder::Type codec, int num_clients, bool mixed)
+{
+  VR_Network_SpectatorServer server;
+  server.codec = codec;
+  if (!server.start("127.0.0.1", TEST_PORT)) {
+    printf("can't bind to port %d, skipped\n", TEST_PORT);
+    return;
+  }
+
+  std::atomic<bool> running(true);
+  std::vector<BenchClient> clients(num_clients);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < num_clients; c++) {
+    clients[c].variant = mixed ? (VR_Network_SpectatorVariant)(c % VR_NETWORK_SPECTATOR_VARIANTS) :
+                                 VR_NETWORK_SPECTATOR_STEREO;
+    clients[c].frames = 0;
+    clients[c].time_first = clients[c].time_last = 0.0;
+    threads.push_back(std::thread(bench_client_func, &clients[c], &running));
+  }
+  for (int i = 0; i < 200 && server.get_stats().spectators < (uint)num_clients; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+
+  std::vector<VR_Network_FrameRing::Slot> frames(8);
+  for (size_t f = 0; f < frames.size(); f++) {
+    frames[f].w = frames[f].h = frames[f].d = 0;
+    frames[f].resize(FRAME_W, FRAME_H, FRAME_D);
+    synthetic_frame(frames[f], (int)f * 4);
+  }
+
+  /* Act as the image thread of the headset stream. */
+  const double time_start = PIL_check_seconds_timer();
+  for (int f = 0; f < NUM_FRAMES; f++) {
+    VR_Network_FrameRing::Slot &slot = frames[f % frames.size()];
+    slot.seq = f;
+    server.submit(slot, false);
+    const double time_next = time_start + (double)(f + 1) / CAPTURE_FPS;
+    const double wait = time_next - PIL_check_seconds_timer();
+    if (wait > 0.0) {
+      std::this_thread::sleep_for(std::chrono::microseconds((long long)(wait * 1e6)));
+    }
+  }
+  const double duration = PIL_check_seconds_timer() - time_start;
+  /* Let the queues drain. */
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+  const VR_Network_SpectatorServer::Stats stats = server.get_stats();
+  running = false;
+  for (size_t t = 0; t < threads.size(); t++) {
+    threads[t].join();
+  }
+  server.stop();
+
+  double fps_min = 1e10, fps_max = 0.0, fps_sum = 0.0;
+  for (int c = 0; c < num_clients; c++) {
+    const double fps = (double)clients[c].frames / duration;
+    fps_min = std::min(fps_min, fps);
+    fps_max = std::max(fps_max, fps);
+    fps_sum += fps;
+  }
+  EXPECT_GT(fps_min, 0.0);
+
+  printf("%-9s %2d %s : %5.1f%% CPU (encode %6.2f ms, send %5.2f ms per frame), "
+         "%4.1f images/frame, client fps %5.1f min %5.1f avg %5.1f max, %u dropped\n",
+         VR_Network_Encoder::name(codec),
+         num_clients,
+         mixed ? "mixed " : "stereo",
+         100.0 * (stats.cpu_encode + stats.cpu_send) / duration,
+         stats.cpu_encode * 1000.0 / std::max(stats.frames_encoded, 1u),
+         stats.cpu_send * 1000.0 / std::max(stats.frames_encoded, 1u),
+         (double)stats.images_encoded / std::max(stats.frames_encoded, 1u),
+         fps_min,
+         fps_sum / num_clients,
+         fps_max,
+         stats.frames_dropped);
+}
+
+static void spectator_benchmark_all(VR_Network_Encoder::Type codec, bool mixed)
+{
+  printf("%d frames %dx%d at %d fps:\n", NUM_FRAMES, FRAME_W, FRAME_H, CAPTURE_FPS);
+  const int num_clients[4] = {1, 4, 16, 32};
+  for (int i = 0; i < 4; i++) {
+    spectator_benchmark(codec, num_clients[i], mixed);
+  }
+}
+
+TEST(vr_network_spectator, FanOut_DeltaRLE_Stereo)
+{
+  spectator_benchmark_all(VR_Network_Encoder::TYPE_DELTA_RLE, false);
+}
+
+TEST(vr_network_spectator, FanOut_DeltaRLE_Mixed)
+{
+  spectator_benchmark_all(VR_Network_Encoder::TYPE_DELTA_RLE, true);
+}
+
+TEST(vr_network_spectator, FanOut_Zlib_Mixed)
+{
+  spectator_benchmark_all(VR_Network_Encoder::TYPE_ZLIB, true);
+}
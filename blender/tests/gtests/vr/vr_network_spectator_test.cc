@@ -0,0 +1,258 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_network_spectator.h"
+
+#include <chrono>
+#include <limits>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+/* Port of the loopback tests (not the one used by Blender, so a running session doesn't interfere). */
+#define TEST_PORT 27212
+#define TEST_W 64
+#define TEST_H 32
+#define TEST_D 4
+
+/* Eye images made of uniform 2x2 blocks, so the half resolution image is exact. */
+static void fill_slot(VR_Network_FrameRing::Slot &slot, uint w, uint h, ui64 seq)
+{
+  slot.w = slot.h = slot.d = 0;
+  slot.resize(w, h, TEST_D);
+  slot.seq = seq;
+  for (int i = 0; i < VR_SIDES; i++) {
+    for (uint y = 0; y < h; y++) {
+      for (uint x = 0; x < w; x++) {
+        uchar *p = &slot.pixels[i][(y * w + x) * TEST_D];
+        p[0] = (uchar)(x / 2 + seq);
+        p[1] = (uchar)(y / 2);
+        p[2] = (uchar)(i * 100);
+        p[3] = 255;
+      }
+    }
+  }
+}
+
+static VR_Network_SpectatorFramePtr make_frame(ui64 seq)
+{
+  std::shared_ptr<VR_Network_SpectatorFrame> frame = std::make_shared<VR_Network_SpectatorFrame>();
+  memset(&frame->header, 0, sizeof(frame->header));
+  frame->header.seq = seq;
+  return frame;
+}
+
+/* Wait until the server accepted a number of spectators. */
+static bool wait_for_spectators(const VR_Network_SpectatorServer &server, uint num)
+{
+  for (int i = 0; i < 200; i++) {
+    if (server.get_stats().spectators == num &&
+        server.wants_frame(std::numeric_limits<double>::max()) == (num > 0)) {
+      return true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  return false;
+}
+
+TEST(vr_network_spectator, QueueDropOldest)
+{
+  VR_Network_SpectatorQueue queue(2);
+  EXPECT_TRUE(queue.pop(0) == NULL);
+
+  EXPECT_TRUE(queue.push(make_frame(1)));
+  EXPECT_TRUE(queue.push(make_frame(2)));
+  /* Full: the oldest frame makes room for the newest one. */
+  EXPECT_FALSE(queue.push(make_frame(3)));
+  EXPECT_EQ(queue.size(), 2);
+  EXPECT_EQ(queue.dropped(), 1);
+
+  EXPECT_EQ(queue.pop(0)->header.seq, 2);
+  EXPECT_EQ(queue.pop(0)->header.seq, 3);
+  EXPECT_TRUE(queue.pop(0) == NULL);
+
+  /* Closing wakes the consumer and rejects further frames. */
+  EXPECT_TRUE(queue.push(make_frame(4)));
+  queue.close();
+  EXPECT_TRUE(queue.pop(100) == NULL);
+  EXPECT_FALSE(queue.push(make_frame(5)));
+}
+
+TEST(vr_network_spectator, ListenAddress)
+{
+  /* Only a specific interface, never all of them (or none, for invalid addresses). */
+  VR_Network_SpectatorServer server;
+  EXPECT_FALSE(server.start("0.0.0.0", TEST_PORT));
+  EXPECT_FALSE(server.start("", TEST_PORT));
+  EXPECT_FALSE(server.start("not an address", TEST_PORT));
+  EXPECT_FALSE(server.is_running());
+
+  if (!server.start("127.0.0.1", TEST_PORT)) {
+    printf("ListenAddress: can't bind to port %d, skipped\n", TEST_PORT);
+    return;
+  }
+  EXPECT_TRUE(server.is_running());
+  server.stop();
+  EXPECT_FALSE(server.is_running());
+}
+
+TEST(vr_network_spectator, Variants)
+{
+  VR_Network_SpectatorServer server;
+  server.codec = VR_Network_Encoder::TYPE_DELTA_RLE;
+  if (!server.start("127.0.0.1", TEST_PORT)) {
+    printf("Variants: can't bind to port %d, skipped\n", TEST_PORT);
+    return;
+  }
+  EXPECT_FALSE(server.wants_frame(0.0));
+
+  const VR_Network_SpectatorVariant variants[4] = {VR_NETWORK_SPECTATOR_STEREO,
+                                                   VR_NETWORK_SPECTATOR_MONO,
+                                                   VR_NETWORK_SPECTATOR_MONO,
+                                                   VR_NETWORK_SPECTATOR_MONO_HALF};
+  VR_Network_SpectatorClient clients[4];
+  for (int c = 0; c < 4; c++) {
+    ASSERT_TRUE(clients[c].open("127.0.0.1", TEST_PORT, variants[c]));
+  }
+  ASSERT_TRUE(wait_for_spectators(server, 4));
+
+  VR_Network_FrameRing::Slot slot;
+  fill_slot(slot, TEST_W, TEST_H, 7);
+  EXPECT_TRUE(server.submit(slot, false));
+
+  for (int c = 0; c < 4; c++) {
+    VR_Network_SpectatorFrameHeader header;
+    std::vector<uchar> images[VR_SIDES];
+    ASSERT_EQ(clients[c].receive(header, images, 1000), 1);
+    EXPECT_EQ(header.variant, (uint)variants[c]);
+    EXPECT_EQ(header.seq, 7);
+    EXPECT_EQ(header.codec, (uint)VR_Network_Encoder::TYPE_DELTA_RLE);
+
+    const bool half = (variants[c] == VR_NETWORK_SPECTATOR_MONO_HALF);
+    const uint w = half ? TEST_W / 2 : TEST_W, h = half ? TEST_H / 2 : TEST_H;
+    EXPECT_EQ(header.w, w);
+    EXPECT_EQ(header.h, h);
+    EXPECT_EQ(header.num_images, (variants[c] == VR_NETWORK_SPECTATOR_STEREO) ? 2 : 1);
+
+    for (uint i = 0; i < header.num_images; i++) {
+      VR_Network_Decoder_DeltaRLE decoder;
+      std::vector<uchar> pixels;
+      ASSERT_TRUE(decoder.decode(&images[i][0], header.size[i], pixels));
+      if (half) {
+        ASSERT_EQ(pixels.size(), w * h * TEST_D);
+        for (uint y = 0; y < h; y++) {
+          for (uint x = 0; x < w; x++) {
+            EXPECT_EQ(memcmp(&pixels[(y * w + x) * TEST_D],
+                             &slot.pixels[i][(2 * y * TEST_W + 2 * x) * TEST_D],
+                             TEST_D),
+                      0);
+          }
+        }
+      }
+      else {
+        EXPECT_EQ(pixels, slot.pixels[i]);
+      }
+    }
+  }
+
+  /* Both eyes and the half image, encoded once for the four spectators. */
+  const VR_Network_SpectatorServer::Stats stats = server.get_stats();
+  EXPECT_EQ(stats.frames_encoded, 1);
+  EXPECT_EQ(stats.images_encoded, 3);
+  EXPECT_EQ(stats.frames_sent, 4);
+  EXPECT_EQ(stats.frames_dropped, 0);
+
+  /* Disconnected spectators are removed (when sending to them fails). */
+  for (int c = 0; c < 4; c++) {
+    clients[c].close();
+  }
+  for (int i = 0; i < 100 && server.get_stats().spectators > 0; i++) {
+    fill_slot(slot, TEST_W, TEST_H, 8 + i);
+    server.submit(slot, false);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_TRUE(wait_for_spectators(server, 0));
+  server.stop();
+  EXPECT_FALSE(server.is_running());
+}
+
+TEST(vr_network_spectator, ReuseEncoded)
+{
+  VR_Network_SpectatorServer server;
+  if (!server.start("127.0.0.1", TEST_PORT)) {
+    printf("ReuseEncoded: can't bind to port %d, skipped\n", TEST_PORT);
+    return;
+  }
+  VR_Network_SpectatorClient client;
+  ASSERT_TRUE(client.open("127.0.0.1", TEST_PORT, VR_NETWORK_SPECTATOR_STEREO));
+  ASSERT_TRUE(wait_for_spectators(server, 1));
+
+  /* The zlib images of the headset stream are sent as they are. */
+  VR_Network_FrameRing::Slot slot;
+  fill_slot(slot, TEST_W, TEST_H, 1);
+  slot.encoded[VR_SIDE_LEFT].assign(10, 1);
+  slot.encoded[VR_SIDE_RIGHT].assign(20, 2);
+  EXPECT_TRUE(server.submit(slot, true));
+
+  VR_Network_SpectatorFrameHeader header;
+  std::vector<uchar> images[VR_SIDES];
+  ASSERT_EQ(client.receive(header, images, 1000), 1);
+  EXPECT_EQ(header.num_images, 2);
+  EXPECT_EQ(header.codec, (uint)VR_Network_Encoder::TYPE_ZLIB);
+  EXPECT_EQ(images[VR_SIDE_LEFT], slot.encoded[VR_SIDE_LEFT]);
+  EXPECT_EQ(images[VR_SIDE_RIGHT], slot.encoded[VR_SIDE_RIGHT]);
+
+  const VR_Network_SpectatorServer::Stats stats = server.get_stats();
+  EXPECT_EQ(stats.images_encoded, 0);
+  EXPECT_EQ(stats.images_reused, 2);
+}
+
+TEST(vr_network_spectator, SlowSpectator)
+{
+  VR_Network_SpectatorServer server;
+  server.codec = VR_Network_Encoder::TYPE_DELTA_RLE;
+  if (!server.start("127.0.0.1", TEST_PORT)) {
+    printf("SlowSpectator: can't bind to port %d, skipped\n", TEST_PORT);
+    return;
+  }
+  VR_Network_SpectatorClient fast, slow;
+  ASSERT_TRUE(fast.open("127.0.0.1", TEST_PORT, VR_NETWORK_SPECTATOR_STEREO));
+  ASSERT_TRUE(slow.open("127.0.0.1", TEST_PORT, VR_NETWORK_SPECTATOR_STEREO));
+  ASSERT_TRUE(wait_for_spectators(server, 2));
+
+  /* Noise doesn't compress, so the slow spectator's socket buffers fill up quickly. */
+  const uint w = 512, h = 512;
+  VR_Network_FrameRing::Slot slot;
+  fill_slot(slot, w, h, 0);
+  srand(0);
+  for (int i = 0; i < VR_SIDES; i++) {
+    for (size_t j = 0; j < slot.pixels[i].size(); j++) {
+      slot.pixels[i][j] = (uchar)rand();
+    }
+  }
+
+  /* The slow spectator never reads; the fast one gets every frame. */
+  const int num_frames = 40;
+  VR_Network_SpectatorFrameHeader header;
+  std::vector<uchar> images[VR_SIDES];
+  for (int f = 0; f < num_frames; f++) {
+    slot.seq = f;
+    slot.pixels[VR_SIDE_LEFT][0] = (uchar)f;
+    ASSERT_TRUE(server.submit(slot, false));
+    ASSERT_EQ(fast.receive(header, images, 1000), 1);
+    EXPECT_EQ(header.seq, (ui64)f);
+  }
+
+  /* The statistics are updated after the frame was queued. */
+  VR_Network_SpectatorServer::Stats stats = server.get_stats();
+  for (int i = 0; i < 100 && stats.frames_encoded < num_frames; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    stats = server.get_stats();
+  }
+  EXPECT_EQ(stats.frames_encoded, num_frames);
+  EXPECT_EQ(stats.images_encoded, 2 * num_frames);
+  EXPECT_GT(stats.frames_dropped, 0);
+}
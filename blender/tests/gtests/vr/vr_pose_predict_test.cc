@@ -0,0 +1,362 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_pose_predict.h"
+
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/* Pose stream, as recorded from vr_update_tracking(). */
+typedef struct PoseSample {
+  double time;
+  float m[4][4];
+} PoseSample;
+
+/* Rotation around a coordinate axis (row convention, as the Blender matrices). */
+static void axis_rotation(int axis, double angle, double r[3][3])
+{
+  memset(r, 0, sizeof(double[3][3]));
+  const int a = (axis + 1) % 3, b = (axis + 2) % 3;
+  r[axis][axis] = 1.0;
+  r[a][a] = cos(angle);
+  r[a][b] = sin(angle);
+  r[b][a] = -sin(angle);
+  r[b][b] = cos(angle);
+}
+
+static void pose_from(
+    double yaw, double pitch, double roll, double x, double y, double z, float r_m[4][4])
+{
+  double rz[3][3], rx[3][3], ry[3][3], t[3][3], r[3][3];
+  axis_rotation(2, yaw, rz);
+  axis_rotation(0, pitch, rx);
+  axis_rotation(1, roll, ry);
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      t[i][j] = ry[i][0] * rx[0][j] + ry[i][1] * rx[1][j] + ry[i][2] * rx[2][j];
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      r[i][j] = t[i][0] * rz[0][j] + t[i][1] * rz[1][j] + t[i][2] * rz[2][j];
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      r_m[i][j] = (float)r[i][j];
+    }
+    r_m[i][3] = 0.0f;
+  }
+  r_m[3][0] = (float)x;
+  r_m[3][1] = (float)y;
+  r_m[3][2] = (float)z;
+  r_m[3][3] = 1.0f;
+}
+
+/* Head looking around while standing. */
+static void head_motion(double t, float r_m[4][4])
+{
+  const double w = 2.0 * M_PI;
+  pose_from(0.8 * sin(w * 0.4 * t),
+            0.2 * sin(w * 0.9 * t),
+            0.05 * sin(w * 0.3 * t),
+            0.1 * sin(w * 0.5 * t),
+            0.05 * sin(w * 0.7 * t),
+            1.6 + 0.02 * sin(w * 1.3 * t),
+            r_m);
+}
+
+/* Controller drawing strokes. */
+static void controller_motion(double t, float r_m[4][4])
+{
+  const double w = 2.0 * M_PI;
+  pose_from(1.2 * sin(w * 1.1 * t),
+            0.6 * sin(w * 0.8 * t),
+            0.4 * sin(w * 1.7 * t),
+            0.3 * sin(w * 1.5 * t),
+            0.4 + 0.1 * sin(w * 1.2 * t),
+            1.2 + 0.2 * sin(w * 0.9 * t),
+            r_m);
+}
+
+static double noise(double amplitude)
+{
+  /* Roughly normal distribution. */
+  double sum = 0.0;
+  for (int i = 0; i < 4; i++) {
+    sum += (double)rand() / (double)RAND_MAX - 0.5;
+  }
+  return sum * amplitude;
+}
+
+/* Simulated recording: 90 Hz with timing jitter and tracking noise. */
+static std::vector<PoseSample> record(void (*motion)(double, float[4][4]), double duration)
+{
+  std::vector<PoseSample> stream;
+  for (double t = 0.0; t < duration; t += 1.0 / 90.0) {
+    PoseSample s;
+    s.time = t + noise(0.002);
+    motion(s.time, s.m);
+    for (int i = 0; i < 3; i++) {
+      s.m[3][i] += (float)noise(0.0004);
+    }
+    float n[4][4];
+    pose_from(noise(0.0004), noise(0.0004), noise(0.0004), 0, 0, 0, n);
+    float r[3][3];
+    for (int i = 0; i < 3; i++) {
+      for (int j = 0; j < 3; j++) {
+        r[i][j] = s.m[i][0] * n[0][j] + s.m[i][1] * n[1][j] + s.m[i][2] * n[2][j];
+      }
+    }
+    for (int i = 0; i < 3; i++) {
+      memcpy(s.m[i], r[i], sizeof(r[i]));
+    }
+    stream.push_back(s);
+  }
+  return stream;
+}
+
+/* Recorded stream from a text file (one sample per line: time, then the 16 matrix values). */
+static std::vector<PoseSample> load(const char *path)
+{
+  std::vector<PoseSample> stream;
+  FILE *f = fopen(path, "r");
+  if (!f) {
+    return stream;
+  }
+  PoseSample s;
+  float *m = &s.m[0][0];
+  while (fscanf(f, "%lf", &s.time) == 1) {
+    int n = 0;
+    while (n < 16 && fscanf(f, "%f", &m[n]) == 1) {
+      n++;
+    }
+    if (n < 16) {
+      break;
+    }
+    stream.push_back(s);
+  }
+  fclose(f);
+  return stream;
+}
+
+/* Pose of the stream at time t (interpolated between the samples). */
+static bool stream_pose(const std::vector<PoseSample> &stream, double t, float r_m[4][4])
+{
+  size_t i = 1;
+  while (i < stream.size() && stream[i].time < t) {
+    i++;
+  }
+  if (i >= stream.size()) {
+    return false;
+  }
+  const PoseSample &a = stream[i - 1], &b = stream[i];
+  const float f = (float)((t - a.time) / (b.time - a.time));
+  for (int j = 0; j < 4; j++) {
+    for (int k = 0; k < 4; k++) {
+      r_m[j][k] = a.m[j][k] + f * (b.m[j][k] - a.m[j][k]);
+    }
+  }
+  return true;
+}
+
+static double position_error(const float a[4][4], const float b[4][4])
+{
+  const double d[3] = {a[3][0] - b[3][0], a[3][1] - b[3][1], a[3][2] - b[3][2]};
+  return sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+static double rotation_error(const float a[4][4], const float b[4][4])
+{
+  /* Angle of a * b^T, from the trace (rows of both are normalized first). */
+  double trace = 0.0;
+  for (int i = 0; i < 3; i++) {
+    const double la = sqrt(a[i][0] * a[i][0] + a[i][1] * a[i][1] + a[i][2] * a[i][2]);
+    const double lb = sqrt(b[i][0] * b[i][0] + b[i][1] * b[i][1] + b[i][2] * b[i][2]);
+    trace += (a[i][0] * b[i][0] + a[i][1] * b[i][1] + a[i][2] * b[i][2]) / (la * lb);
+  }
+  const double c = (trace - 1.0) / 2.0;
+  return acos(c > 1.0 ? 1.0 : (c < -1.0 ? -1.0 : c));
+}
+
+typedef struct ReplayError {
+  double pos_rms, pos_max;
+  double rot_rms, rot_max;
+} ReplayError;
+
+/* Feed a recorded stream, predicting each sample to latency later and comparing with the stream.
+ * held is the error without prediction (the pose of the last sample). */
+static void replay(const std::vector<PoseSample> &stream,
+                   double latency,
+                   ReplayError &predicted,
+                   ReplayError &held)
+{
+  VR_Pose_Predictor predictor;
+  memset(&predicted, 0, sizeof(predicted));
+  memset(&held, 0, sizeof(held));
+  uint n = 0;
+  for (size_t i = 0; i < stream.size(); i++) {
+    predictor.push(stream[i].time, stream[i].m);
+    float truth[4][4], m[4][4];
+    if (i < 10 || !stream_pose(stream, stream[i].time + latency, truth)) {
+      continue;
+    }
+    predictor.predict(stream[i].time + latency, m);
+
+    const double e_pos[2] = {position_error(m, truth), position_error(stream[i].m, truth)};
+    const double e_rot[2] = {rotation_error(m, truth), rotation_error(stream[i].m, truth)};
+    ReplayError *e[2] = {&predicted, &held};
+    for (int k = 0; k < 2; k++) {
+      e[k]->pos_rms += e_pos[k] * e_pos[k];
+      e[k]->rot_rms += e_rot[k] * e_rot[k];
+      e[k]->pos_max = std::max(e[k]->pos_max, e_pos[k]);
+      e[k]->rot_max = std::max(e[k]->rot_max, e_rot[k]);
+    }
+    n++;
+  }
+  ReplayError *e[2] = {&predicted, &held};
+  for (int k = 0; k < 2 && n; k++) {
+    e[k]->pos_rms = sqrt(e[k]->pos_rms / n);
+    e[k]->rot_rms = sqrt(e[k]->rot_rms / n);
+  }
+}
+
+static void replay_report(const char *name, const std::vector<PoseSample> &stream, double latency)
+{
+  ReplayError predicted, held;
+  replay(stream, latency, predicted, held);
+  printf("%s, %u samples, %.0f ms ahead:\n", name, (uint)stream.size(), latency * 1000.0);
+  printf("  Predicted: position %.2f mm (max %.2f), rotation %.3f deg (max %.3f)\n",
+         predicted.pos_rms * 1000.0,
+         predicted.pos_max * 1000.0,
+         predicted.rot_rms * 180.0 / M_PI,
+         predicted.rot_max * 180.0 / M_PI);
+  printf("  Held:      position %.2f mm (max %.2f), rotation %.3f deg (max %.3f)\n",
+         held.pos_rms * 1000.0,
+         held.pos_max * 1000.0,
+         held.rot_rms * 180.0 / M_PI,
+         held.rot_max * 180.0 / M_PI);
+}
+
+TEST(vr_pose_predict, Static)
+{
+  VR_Pose_Predictor predictor;
+  float m[4][4], r[4][4];
+  EXPECT_FALSE(predictor.predict(0.0, r));
+
+  pose_from(0.3, -0.2, 0.1, 1, 2, 3, m);
+  for (int i = 0; i < 10; i++) {
+    predictor.push(i * 0.011, m);
+  }
+  EXPECT_TRUE(predictor.predict(1.0, r));
+  EXPECT_M4_NEAR(r, m, 1e-5f);
+  EXPECT_NEAR(predictor.get_velocity()[0], 0.0, 1e-9);
+  EXPECT_NEAR(predictor.get_angular_velocity()[2], 0.0, 1e-9);
+}
+
+TEST(vr_pose_predict, ConstantVelocity)
+{
+  VR_Pose_Predictor predictor;
+  predictor.max_horizon = 1.0;
+  /* 1 m/s along x, 2 rad/s yaw (around z). */
+  float m[4][4], r[4][4];
+  for (int i = 0; i < 10; i++) {
+    const double t = i * 0.011;
+    pose_from(2.0 * t, 0.3, 0, t, 0, 1.5, m);
+    predictor.push(t, m);
+  }
+  EXPECT_NEAR(predictor.get_velocity()[0], 1.0, 1e-4);
+  const double t = 9 * 0.011 + 0.1;
+  pose_from(2.0 * t, 0.3, 0, t, 0, 1.5, m);
+  EXPECT_TRUE(predictor.predict(t, r));
+  EXPECT_M4_NEAR(r, m, 1e-4f);
+
+  /* Scale is kept. */
+  for (int i = 0; i < 3; i++) {
+    for (int j = 0; j < 3; j++) {
+      m[i][j] *= 2.0f;
+    }
+  }
+  predictor.push(t, m);
+  predictor.predict(t, r);
+  EXPECT_M4_NEAR(r, m, 1e-4f);
+}
+
+TEST(vr_pose_predict, Horizon)
+{
+  VR_Pose_Predictor predictor;
+  float m[4][4], r[4][4];
+  for (int i = 0; i < 10; i++) {
+    pose_from(0, 0, 0, i * 0.01, 0, 0, m);
+    predictor.push(i * 0.01, m);
+  }
+  /* 1 m/s, at most max_horizon ahead and never back in time. */
+  predictor.predict(10.0, r);
+  EXPECT_NEAR(r[3][0], 0.09 + predictor.max_horizon, 1e-5);
+  predictor.predict(0.0, r);
+  EXPECT_NEAR(r[3][0], 0.09, 1e-5);
+
+  /* Tracking lost: the velocity before is discarded. */
+  pose_from(0, 0, 0, 5.0, 0, 0, m);
+  predictor.push(0.09 + 2.0 * VR_Pose_Predictor::max_gap, m);
+  EXPECT_EQ(predictor.get_velocity()[0], 0.0);
+  predictor.predict(10.0, r);
+  EXPECT_NEAR(r[3][0], 5.0, 1e-5);
+}
+
+TEST(vr_pose_predict, Latency)
+{
+  VR_Latency_Estimator latency;
+  EXPECT_EQ(latency.predict_submit(VR_Latency_Estimator::STAGE_TRACKING, 1.0), 1.0);
+
+  latency.mark(VR_Latency_Estimator::STAGE_TRACKING, 0.0);
+  latency.mark(VR_Latency_Estimator::STAGE_EYE_LEFT, 0.010);
+  latency.mark(VR_Latency_Estimator::STAGE_EYE_RIGHT, 0.015);
+  latency.submit(0.020);
+  EXPECT_NEAR(latency.get_latency(VR_Latency_Estimator::STAGE_TRACKING), 0.020, 1e-9);
+  EXPECT_NEAR(latency.get_latency(VR_Latency_Estimator::STAGE_EYE_LEFT), 0.010, 1e-9);
+  EXPECT_NEAR(latency.get_latency(VR_Latency_Estimator::STAGE_EYE_RIGHT), 0.005, 1e-9);
+
+  /* Smoothed over frames; stages not reached in a frame are not updated. */
+  latency.mark(VR_Latency_Estimator::STAGE_TRACKING, 1.0);
+  latency.submit(1.030);
+  EXPECT_NEAR(latency.get_latency(VR_Latency_Estimator::STAGE_TRACKING),
+              0.020 + latency.smoothing * 0.010,
+              1e-9);
+  EXPECT_NEAR(latency.get_latency(VR_Latency_Estimator::STAGE_EYE_LEFT), 0.010, 1e-9);
+  EXPECT_NEAR(latency.predict_submit(VR_Latency_Estimator::STAGE_EYE_LEFT, 2.0), 2.010, 1e-9);
+}
+
+TEST(vr_pose_predict, Replay)
+{
+  srand(0);
+  const double latency = 0.025;
+  const std::vector<PoseSample> head = record(head_motion, 20.0);
+  const std::vector<PoseSample> controller = record(controller_motion, 20.0);
+
+  ReplayError predicted, held;
+  replay(head, latency, predicted, held);
+  EXPECT_LT(predicted.pos_rms, 0.5 * held.pos_rms);
+  EXPECT_LT(predicted.rot_rms, 0.5 * held.rot_rms);
+  replay(controller, latency, predicted, held);
+  EXPECT_LT(predicted.pos_rms, 0.5 * held.pos_rms);
+  EXPECT_LT(predicted.rot_rms, 0.5 * held.rot_rms);
+
+  replay_report("Head", head, latency);
+  replay_report("Controller", controller, latency);
+
+  /* Recorded stream (optional). */
+  const char *path = getenv("VR_POSE_STREAM");
+  if (path) {
+    const std::vector<PoseSample> recorded = load(path);
+    EXPECT_GT(recorded.size(), 10u) << path;
+    for (int ms = 10; ms <= 40; ms += 10) {
+      replay_report(path, recorded, ms / 1000.0);
+    }
+  }
+}
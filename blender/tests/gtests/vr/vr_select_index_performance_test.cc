@@ -0,0 +1,188 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_select_index.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+extern "C" {
+#include "PIL_time.h"
+}
+
+#define NUM_ITERATIONS 10
+
+/* Vertices of a subdivided UV sphere (radius 1) with some noise, as a sculpted mesh. */
+static std::vector<Coord3Df> sphere_points(uint num_points)
+{
+  std::vector<Coord3Df> co(num_points);
+  const uint rings = (uint)sqrtf((float)num_points / 2.0f);
+  const uint segments = num_points / rings + 1;
+  srand(0);
+  for (uint i = 0; i < num_points; i++) {
+    const float u = 6.2831853f * (float)(i % segments) / (float)segments;
+    const float v = 3.1415926f * ((float)(i / segments) + 0.5f) / (float)rings;
+    const float r = 1.0f + 0.01f * ((float)rand() / (float)RAND_MAX);
+    co[i] = Coord3Df(r * sinf(v) * cosf(u), r * sinf(v) * sinf(u), r * cosf(v));
+  }
+  return co;
+}
+
+static Coord3Df transform(const Mat44f &m, const Coord3Df &v)
+{
+  return Coord3Df(v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + m.m[3][0],
+                  v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + m.m[3][1],
+                  v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + m.m[3][2]);
+}
+
+/* Per-element loop of the original proximity_select_multiple_vertex(). */
+static uint box_reference(const std::vector<Coord3Df> &co,
+                          const Mat44f &m,
+                          const Coord3Df &p0,
+                          const Coord3Df &p1)
+{
+  const float bounds_x = fabsf(p1.x - p0.x) / 2.0f;
+  const float bounds_y = fabsf(p1.y - p0.y) / 2.0f;
+  const float bounds_z = fabsf(p1.z - p0.z) / 2.0f;
+  const Coord3Df center = p0 + (p1 - p0) / 2.0f;
+  uint hits = 0;
+  for (size_t i = 0; i < co.size(); i++) {
+    const Coord3Df pos = transform(m, co[i]);
+    hits += (fabsf(pos.x - center.x) < bounds_x && fabsf(pos.y - center.y) < bounds_y &&
+             fabsf(pos.z - center.z) < bounds_z);
+  }
+  return hits;
+}
+
+/* Per-element loop of the original raycast_select_multiple_vertex() (VR_Util::view3d_project()). */
+static uint rect_reference(const std::vector<Coord3Df> &co,
+                           const Mat44f &m,
+                           const float persmat[4][4],
+                           float x0,
+                           float y0,
+                           float x1,
+                           float y1)
+{
+  const float w = 1920.0f, h = 1080.0f;
+  const float bounds_x = fabsf(x1 - x0) / 2.0f * w / 2.0f;
+  const float bounds_y = fabsf(y1 - y0) / 2.0f * h / 2.0f;
+  const float center_x = w * ((x0 + x1) / 2.0f + 1.0f) / 2.0f;
+  const float center_y = h * (1.0f - (y0 + y1) / 2.0f) / 2.0f;
+  uint hits = 0;
+  for (size_t i = 0; i < co.size(); i++) {
+    const Coord3Df p = transform(m, co[i]);
+    float v[4];
+    for (int k = 0; k < 4; k++) {
+      v[k] = p.x * persmat[0][k] + p.y * persmat[1][k] + p.z * persmat[2][k] + persmat[3][k];
+    }
+    if (v[3] > 0.0001f) {
+      const float sx = w * (v[0] / v[3] + 1.0f) / 2.0f;
+      const float sy = h * (1.0f - v[1] / v[3]) / 2.0f;
+      hits += (fabsf(sx - center_x) < bounds_x && fabsf(sy - center_y) < bounds_y);
+    }
+  }
+  return hits;
+}
+
+static void select_benchmark(uint num_points)
+{
+  const std::vector<Coord3Df> co = sphere_points(num_points);
+  const float(*co_f)[3] = (const float(*)[3]) & co[0];
+  std::vector<uchar> result(num_points);
+
+  Mat44f m;
+  m.set_to_identity();
+  m.m[3][2] = -0.5f;
+
+  /* Camera at z = 3 looking down -z (Blender column-major persmat). */
+  const float n = 0.1f, f = 100.0f;
+  float persmat[4][4] = {{0}};
+  persmat[0][0] = 1.0f;
+  persmat[1][1] = 1.7777f;
+  persmat[2][2] = -(f + n) / (f - n);
+  persmat[2][3] = -1.0f;
+  persmat[3][2] = -2.0f * f * n / (f - n) + 3.0f * (f + n) / (f - n);
+  persmat[3][3] = 3.0f;
+
+  /* A hand-sized box on the surface, and a quarter of the screen. */
+  const Coord3Df p0(0.5f, -0.2f, 0.2f), p1(0.9f, 0.2f, 0.5f);
+  const float x0 = -0.1f, y0 = -0.1f, x1 = 0.4f, y1 = 0.4f;
+
+  double time = PIL_check_seconds_timer();
+  uint hits_box_ref = 0, hits_rect_ref = 0;
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    hits_box_ref = box_reference(co, m, p0, p1);
+  }
+  const double time_box_ref = (PIL_check_seconds_timer() - time) / NUM_ITERATIONS;
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    hits_rect_ref = rect_reference(co, m, persmat, x0, y0, x1, y1);
+  }
+  const double time_rect_ref = (PIL_check_seconds_timer() - time) / NUM_ITERATIONS;
+
+  VR_Select_Index index;
+  time = PIL_check_seconds_timer();
+  index.build(co_f, num_points);
+  const double time_build = PIL_check_seconds_timer() - time;
+
+  /* Unchanged geometry (every selection refits the index first). */
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    index.refit(co_f, num_points);
+  }
+  const double time_refit = (PIL_check_seconds_timer() - time) / NUM_ITERATIONS;
+
+  float planes[6][4];
+  uint num_planes = VR_Select_Index::box_planes(p0, p1, planes);
+  uint hits_box = 0;
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    hits_box = index.query(m, planes, num_planes, &result[0]);
+  }
+  const double time_box = (PIL_check_seconds_timer() - time) / NUM_ITERATIONS;
+  const uint border_box = index.get_stats().points_border;
+
+  num_planes = VR_Select_Index::rect_planes(persmat, x0, y0, x1, y1, 0.0001f, planes);
+  uint hits_rect = 0;
+  time = PIL_check_seconds_timer();
+  for (int i = 0; i < NUM_ITERATIONS; i++) {
+    hits_rect = index.query(m, planes, num_planes, &result[0]);
+  }
+  const double time_rect = (PIL_check_seconds_timer() - time) / NUM_ITERATIONS;
+  const uint border_rect = index.get_stats().points_border;
+
+  EXPECT_LE(hits_box - border_box, hits_box_ref);
+  EXPECT_GE(hits_box, hits_box_ref);
+  EXPECT_LE(hits_rect - border_rect, hits_rect_ref);
+  EXPECT_GE(hits_rect, hits_rect_ref);
+
+  printf("%u vertices (build: %f ms, refit unchanged: %f ms)\n",
+         num_points,
+         time_build * 1000.0,
+         time_refit * 1000.0);
+  printf("  Box:  per-element %f ms, index %f ms (%.1fx), %u hits, %u border\n",
+         time_box_ref * 1000.0,
+         time_box * 1000.0,
+         time_box_ref / time_box,
+         hits_box,
+         border_box);
+  printf("  Rect: per-element %f ms, index %f ms (%.1fx), %u hits, %u border\n",
+         time_rect_ref * 1000.0,
+         time_rect * 1000.0,
+         time_rect_ref / time_rect,
+         hits_rect,
+         border_rect);
+}
+
+TEST(vr_select_index, Performance_1M)
+{
+  select_benchmark(1000000);
+}
+
+TEST(vr_select_index, Performance_5M)
+{
+  select_benchmark(5000000);
+}
@@ -0,0 +1,273 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_select_index.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+static float frand(float lo, float hi)
+{
+  return lo + (hi - lo) * ((float)rand() / (float)RAND_MAX);
+}
+
+static std::vector<Coord3Df> random_points(uint n, float extent)
+{
+  std::vector<Coord3Df> co(n);
+  for (uint i = 0; i < n; i++) {
+    co[i] = Coord3Df(frand(-extent, extent), frand(-extent, extent), frand(-extent, extent));
+  }
+  return co;
+}
+
+/* Rotation around z, scale and translation (row-vector convention, as Mat44f). */
+static Mat44f object_matrix(float angle, float scale, float tx, float ty, float tz)
+{
+  Mat44f m;
+  m.set_to_identity();
+  m.m[0][0] = cosf(angle) * scale;
+  m.m[0][1] = sinf(angle) * scale;
+  m.m[1][0] = -sinf(angle) * scale;
+  m.m[1][1] = cosf(angle) * scale;
+  m.m[2][2] = scale;
+  m.m[3][0] = tx;
+  m.m[3][1] = ty;
+  m.m[3][2] = tz;
+  return m;
+}
+
+static Coord3Df transform(const Mat44f &m, const Coord3Df &v)
+{
+  return Coord3Df(v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0] + m.m[3][0],
+                  v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1] + m.m[3][1],
+                  v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2] + m.m[3][2]);
+}
+
+/* Same test as proximity_select_multiple_vertex(). */
+static bool in_box(const Mat44f &m, const Coord3Df &co, const Coord3Df &p0, const Coord3Df &p1)
+{
+  const Coord3Df pos = transform(m, co);
+  const Coord3Df center = p0 + (p1 - p0) / 2.0f;
+  return fabsf(pos.x - center.x) < fabsf(p1.x - p0.x) / 2.0f &&
+         fabsf(pos.y - center.y) < fabsf(p1.y - p0.y) / 2.0f &&
+         fabsf(pos.z - center.z) < fabsf(p1.z - p0.z) / 2.0f;
+}
+
+/* Checks a query result against the exact test; returns the number of border points. */
+static uint check_box(const VR_Select_Index &index,
+                      const std::vector<Coord3Df> &co,
+                      const Mat44f &m,
+                      const Coord3Df &p0,
+                      const Coord3Df &p1,
+                      const std::vector<uchar> &result)
+{
+  uint border = 0;
+  for (size_t i = 0; i < co.size(); i++) {
+    const bool inside = in_box(m, co[i], p0, p1);
+    if (result[i] == VR_Select_Index::RESULT_INSIDE) {
+      EXPECT_TRUE(inside) << i;
+    }
+    else if (result[i] == VR_Select_Index::RESULT_OUTSIDE) {
+      EXPECT_FALSE(inside) << i;
+    }
+    else {
+      border++;
+    }
+  }
+  return border;
+}
+
+TEST(vr_select_index, BoxQuery)
+{
+  srand(1);
+  const std::vector<Coord3Df> co = random_points(20000, 1.0f);
+  VR_Select_Index index;
+  index.build((const float(*)[3]) & co[0], (uint)co.size());
+  EXPECT_EQ(index.size(), 20000u);
+
+  std::vector<uchar> result(co.size());
+  for (int q = 0; q < 20; q++) {
+    const Mat44f m = object_matrix(frand(0, 6), frand(0.5f, 3.0f), frand(-5, 5), frand(-5, 5), 0);
+    const Coord3Df c = transform(m, Coord3Df(frand(-1, 1), frand(-1, 1), frand(-1, 1)));
+    const Coord3Df p0 = c - Coord3Df(frand(0, 1), frand(0, 1), frand(0, 1));
+    const Coord3Df p1 = c + Coord3Df(frand(0, 1), frand(0, 1), frand(0, 1));
+    float planes[6][4];
+    const uint num_planes = VR_Select_Index::box_planes(p1, p0, planes);
+
+    const uint hits = index.query(m, planes, num_planes, &result[0]);
+    const uint border = check_box(index, co, m, p0, p1, result);
+    EXPECT_EQ(border, index.get_stats().points_border);
+    EXPECT_LT(border, 20u);
+
+    uint expected = 0;
+    for (size_t i = 0; i < co.size(); i++) {
+      expected += in_box(m, co[i], p0, p1);
+    }
+    EXPECT_LE(hits - border, expected);
+    EXPECT_GE(hits, expected);
+  }
+}
+
+TEST(vr_select_index, CellCulling)
+{
+  srand(2);
+  const std::vector<Coord3Df> co = random_points(100000, 1.0f);
+  VR_Select_Index index;
+  index.build((const float(*)[3]) & co[0], (uint)co.size());
+
+  Mat44f m;
+  m.set_to_identity();
+  float planes[6][4];
+  VR_Select_Index::box_planes(Coord3Df(-0.1f, -0.1f, -0.1f), Coord3Df(0.1f, 0.1f, 0.1f), planes);
+  std::vector<uchar> result(co.size());
+  index.query(m, planes, 6, &result[0]);
+
+  /* A small box only tests the points of a few cells. */
+  const VR_Select_Index::Stats &stats = index.get_stats();
+  EXPECT_GT(stats.cells_outside, 10 * (stats.cells_inside + stats.cells_border));
+  EXPECT_LT(stats.points_tested, co.size() / 50);
+
+  /* A box around everything accepts whole cells. */
+  VR_Select_Index::box_planes(Coord3Df(-2, -2, -2), Coord3Df(2, 2, 2), planes);
+  EXPECT_EQ(index.query(m, planes, 6, &result[0]), (uint)co.size());
+  EXPECT_EQ(index.get_stats().points_tested, 0u);
+  EXPECT_EQ(index.get_stats().cells_outside + index.get_stats().cells_border, 0u);
+}
+
+TEST(vr_select_index, RectQuery)
+{
+  srand(3);
+  const std::vector<Coord3Df> co = random_points(20000, 1.0f);
+  VR_Select_Index index;
+  index.build((const float(*)[3]) & co[0], (uint)co.size());
+
+  /* Perspective camera at z = 3 looking down -z (Blender column-major persmat). */
+  const float n = 0.1f, f = 100.0f;
+  float persmat[4][4] = {{0}};
+  persmat[0][0] = 1.5f;
+  persmat[1][1] = 1.5f;
+  persmat[2][2] = -(f + n) / (f - n);
+  persmat[2][3] = -1.0f;
+  persmat[3][2] = -2.0f * f * n / (f - n) + 3.0f * (f + n) / (f - n);
+  persmat[3][3] = 3.0f;
+
+  const Mat44f m = object_matrix(0.3f, 1.2f, 0.1f, -0.2f, 0.5f);
+  std::vector<uchar> result(co.size());
+  for (int q = 0; q < 20; q++) {
+    const float x0 = frand(-1, 1), y0 = frand(-1, 1), x1 = frand(-1, 1), y1 = frand(-1, 1);
+    float planes[5][4];
+    const uint num_planes = VR_Select_Index::rect_planes(persmat, x0, y0, x1, y1, 0.0001f, planes);
+    index.query(m, planes, num_planes, &result[0]);
+
+    /* Same test as raycast_select_multiple_vertex() (VR_Util::view3d_project()). */
+    uint border = 0;
+    for (size_t i = 0; i < co.size(); i++) {
+      const Coord3Df p = transform(m, co[i]);
+      float v[4];
+      for (int k = 0; k < 4; k++) {
+        v[k] = p.x * persmat[0][k] + p.y * persmat[1][k] + p.z * persmat[2][k] + persmat[3][k];
+      }
+      bool inside = false;
+      if (v[3] > 0.0001f) {
+        const float sx = 1000.0f * (v[0] / v[3] + 1.0f) / 2.0f;
+        const float sy = 800.0f * (1.0f - v[1] / v[3]) / 2.0f;
+        inside = fabsf(sx - 1000.0f * ((x0 + x1) / 2.0f + 1.0f) / 2.0f) <
+                     fabsf(x1 - x0) / 2.0f * 1000.0f / 2.0f &&
+                 fabsf(sy - 800.0f * (1.0f - (y0 + y1) / 2.0f) / 2.0f) <
+                     fabsf(y1 - y0) / 2.0f * 800.0f / 2.0f;
+      }
+      if (result[i] == VR_Select_Index::RESULT_INSIDE) {
+        EXPECT_TRUE(inside) << i;
+      }
+      else if (result[i] == VR_Select_Index::RESULT_OUTSIDE) {
+        EXPECT_FALSE(inside) << i;
+      }
+      else {
+        border++;
+      }
+    }
+    EXPECT_LT(border, 20u);
+  }
+}
+
+TEST(vr_select_index, Refit)
+{
+  srand(4);
+  std::vector<Coord3Df> co = random_points(10000, 1.0f);
+  VR_Select_Index index;
+  EXPECT_EQ(index.refit((const float(*)[3]) & co[0], (uint)co.size()), 10000u);
+  EXPECT_EQ(index.refit((const float(*)[3]) & co[0], (uint)co.size()), 0u);
+
+  /* Small moves (mostly within the cells), large moves and points leaving the grid. */
+  for (uint i = 0; i < 500; i++) {
+    co[i] += Coord3Df(0.001f, -0.001f, 0.0f);
+  }
+  for (uint i = 500; i < 800; i++) {
+    co[i] = Coord3Df(frand(-1, 1), frand(-1, 1), frand(-1, 1));
+  }
+  for (uint i = 800; i < 900; i++) {
+    co[i] = co[i] * 3.0f;
+  }
+  EXPECT_EQ(index.refit((const float(*)[3]) & co[0], (uint)co.size()), 900u);
+
+  Mat44f m;
+  m.set_to_identity();
+  std::vector<uchar> result(co.size());
+  for (int q = 0; q < 10; q++) {
+    const Coord3Df p0(frand(-3, 3), frand(-3, 3), frand(-3, 3));
+    const Coord3Df p1(frand(-3, 3), frand(-3, 3), frand(-3, 3));
+    float planes[6][4];
+    VR_Select_Index::box_planes(p0, p1, planes);
+    index.query(m, planes, 6, &result[0]);
+    check_box(index, co, m, p0, p1, result);
+  }
+
+  /* Single point update. */
+  const Coord3Df far_away(10.0f, 10.0f, 10.0f);
+  index.update(0, &far_away.x);
+  co[0] = far_away;
+  float planes[6][4];
+  VR_Select_Index::box_planes(Coord3Df(9, 9, 9), Coord3Df(11, 11, 11), planes);
+  EXPECT_EQ(index.query(m, planes, 6, &result[0]), 1u);
+  EXPECT_EQ(result[0], VR_Select_Index::RESULT_INSIDE);
+
+  /* Different number of points: rebuilt. */
+  co.pop_back();
+  EXPECT_EQ(index.refit((const float(*)[3]) & co[0], (uint)co.size()), (uint)co.size());
+  EXPECT_EQ(index.size(), (uint)co.size());
+}
+
+TEST(vr_select_index, Degenerate)
+{
+  Mat44f m;
+  m.set_to_identity();
+  float planes[6][4];
+  VR_Select_Index::box_planes(Coord3Df(-1, -1, -1), Coord3Df(1, 1, 1), planes);
+
+  /* Empty. */
+  VR_Select_Index index;
+  index.build(NULL, 0);
+  EXPECT_EQ(index.query(m, planes, 6, NULL), 0u);
+
+  /* Planar grid (as a subdivided plane). */
+  std::vector<Coord3Df> co;
+  for (int y = 0; y < 100; y++) {
+    for (int x = 0; x < 100; x++) {
+      co.push_back(Coord3Df(x * 0.01f, y * 0.01f, 0.0f));
+    }
+  }
+  index.build((const float(*)[3]) & co[0], (uint)co.size());
+  std::vector<uchar> result(co.size());
+  VR_Select_Index::box_planes(Coord3Df(0.205f, 0.205f, -1), Coord3Df(0.495f, 0.395f, 1), planes);
+  EXPECT_EQ(index.query(m, planes, 6, &result[0]), 29u * 19u);
+  EXPECT_EQ(index.get_stats().points_border, 0u);
+
+  /* Coincident points. */
+  std::vector<Coord3Df> same(100, Coord3Df(1, 2, 3));
+  index.build((const float(*)[3]) & same[0], (uint)same.size());
+  result.resize(same.size());
+  VR_Select_Index::box_planes(Coord3Df(0, 0, 0), Coord3Df(2, 3, 4), planes);
+  EXPECT_EQ(index.query(m, planes, 6, &result[0]), 100u);
+}
@@ -0,0 +1,299 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_trace.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+extern "C" {
+#include "BLI_utildefines.h"
+}
+
+static std::string temp_path(const char *name)
+{
+  const char *dir = getenv("TMPDIR");
+  return std::string((dir && dir[0]) ? dir : "/tmp") + "/" + name;
+}
+
+static std::string file_read(const std::string &path)
+{
+  std::string data;
+  FILE *f = fopen(path.c_str(), "rb");
+  if (f) {
+    char buf[4096];
+    size_t len;
+    while ((len = fread(buf, 1, sizeof(buf), f)) > 0) {
+      data.append(buf, len);
+    }
+    fclose(f);
+  }
+  return data;
+}
+
+static VR_Trace::Frame trace_frame(int i)
+{
+  VR_Trace::Frame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.time = 0.011f * i;
+  frame.hmd.pos[0] = 0.01f * i;
+  frame.hmd.pos[1] = 1.6f;
+  frame.hmd.pos[2] = -0.5f;
+  const float angle = 0.05f * i;
+  frame.hmd.rot[0] = cosf(angle / 2.0f);
+  frame.hmd.rot[3] = sinf(angle / 2.0f);
+  for (int c = 0; c < VR_MAX_CONTROLLERS; c++) {
+    VR_Trace::Controller &controller = frame.controller[c];
+    controller.available = (c < 2);
+    controller.buttons = (ui64)i << (8 * c);
+    controller.buttons_touched = 0xFF00000000000000ull | (ui64)c;
+    controller.dpad[0] = 0.1f * c;
+    controller.stick[1] = -0.2f * c;
+    controller.trigger_pressure = (i % 10) / 10.0f;
+    controller.grip_pressure = 1.0f;
+    controller.pose.pos[0] = (float)c;
+    controller.pose.rot[0] = 1.0f;
+  }
+  return frame;
+}
+
+static void expect_frame_eq(const VR_Trace::Frame &a, const VR_Trace::Frame &b)
+{
+  EXPECT_EQ(a.time, b.time);
+  EXPECT_EQ(memcmp(&a.hmd, &b.hmd, sizeof(a.hmd)), 0);
+  for (int c = 0; c < VR_MAX_CONTROLLERS; c++) {
+    const VR_Trace::Controller &ca = a.controller[c], &cb = b.controller[c];
+    EXPECT_EQ(ca.available, cb.available);
+    EXPECT_EQ(ca.buttons, cb.buttons);
+    EXPECT_EQ(ca.buttons_touched, cb.buttons_touched);
+    EXPECT_EQ(ca.dpad[0], cb.dpad[0]);
+    EXPECT_EQ(ca.stick[1], cb.stick[1]);
+    EXPECT_EQ(ca.trigger_pressure, cb.trigger_pressure);
+    EXPECT_EQ(ca.grip_pressure, cb.grip_pressure);
+    EXPECT_EQ(memcmp(&ca.pose, &cb.pose, sizeof(ca.pose)), 0);
+  }
+}
+
+TEST(vr_trace, WriteRead)
+{
+  VR_Trace trace;
+  memset(&trace.header, 0, sizeof(trace.header));
+  trace.header.device_type = 3;
+  trace.header.tex_width = 1440;
+  trace.header.tex_height = 1600;
+  trace.header.eye_params[1][2] = 0.45f;
+  trace.header.eye_offset[0][0] = -0.032f;
+  for (int i = 0; i < 50; i++) {
+    trace.frames.push_back(trace_frame(i));
+  }
+  const std::string path = temp_path("vr_trace_test_write.bxrt");
+  ASSERT_TRUE(trace.write(path.c_str()));
+
+  /* Fixed size: an 80 byte header and the frames. */
+  EXPECT_EQ(file_read(path).size(), 80 + 50 * VR_Trace::frame_size);
+
+  VR_Trace read;
+  ASSERT_TRUE(read.read(path.c_str()));
+  EXPECT_EQ(read.header.device_type, 3u);
+  EXPECT_EQ(read.header.num_frames, 50u);
+  EXPECT_EQ(read.header.tex_width, 1440u);
+  EXPECT_EQ(read.header.tex_height, 1600u);
+  EXPECT_EQ(read.header.eye_params[1][2], 0.45f);
+  EXPECT_EQ(read.header.eye_offset[0][0], -0.032f);
+  ASSERT_EQ(read.frames.size(), 50u);
+  for (int i = 0; i < 50; i++) {
+    expect_frame_eq(read.frames[i], trace.frames[i]);
+  }
+  remove(path.c_str());
+
+  /* Not a trace. */
+  EXPECT_FALSE(read.read(temp_path("vr_trace_test_missing.bxrt").c_str()));
+}
+
+TEST(vr_trace, Record)
+{
+  const std::string path = temp_path("vr_trace_test_record.bxrt");
+  VR_Trace trace;
+  memset(&trace.header, 0, sizeof(trace.header));
+  trace.header.tex_width = 1080;
+  EXPECT_FALSE(trace.is_recording());
+  ASSERT_TRUE(trace.record_begin(path.c_str()));
+  EXPECT_TRUE(trace.is_recording());
+  for (int i = 0; i < 20; i++) {
+    EXPECT_TRUE(trace.record(trace_frame(i)));
+  }
+  EXPECT_TRUE(trace.record_end());
+  EXPECT_FALSE(trace.is_recording());
+  EXPECT_FALSE(trace.record(trace_frame(0)));
+
+  VR_Trace read;
+  ASSERT_TRUE(read.read(path.c_str()));
+  EXPECT_EQ(read.header.num_frames, 20u);
+  EXPECT_EQ(read.header.tex_width, 1080u);
+  ASSERT_EQ(read.frames.size(), 20u);
+  expect_frame_eq(read.frames[19], trace_frame(19));
+
+  /* A recording that was not finished (i.e. Blender crashed) keeps its complete frames. */
+  ASSERT_TRUE(trace.record_begin(path.c_str()));
+  for (int i = 0; i < 5; i++) {
+    trace.record(trace_frame(i));
+  }
+  trace.record_end();
+  /* Unfinished header (number of frames unknown), half a frame at the end. */
+  std::string data = file_read(path);
+  data.replace(12, 4, 4, '\xFF');
+  data.resize(data.size() - VR_Trace::frame_size / 2);
+  FILE *f = fopen(path.c_str(), "wb");
+  ASSERT_TRUE(f != NULL);
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+  ASSERT_TRUE(read.read(path.c_str()));
+  ASSERT_EQ(read.frames.size(), 4u);
+  expect_frame_eq(read.frames[3], trace_frame(3));
+  remove(path.c_str());
+}
+
+TEST(vr_trace, Map)
+{
+  VR_Trace trace;
+  memset(&trace.header, 0, sizeof(trace.header));
+  trace.header.device_type = 2;
+  trace.header.eye_offset[1][0] = 0.032f;
+  for (int i = 0; i < 100; i++) {
+    trace.frames.push_back(trace_frame(i));
+  }
+  const std::string path = temp_path("vr_trace_test_map.bxrt");
+  ASSERT_TRUE(trace.write(path.c_str()));
+
+  VR_Trace_Map map;
+  EXPECT_FALSE(map.is_open());
+  ASSERT_TRUE(map.open(path.c_str()));
+  EXPECT_TRUE(map.is_open());
+  EXPECT_EQ(map.header.device_type, 2u);
+  EXPECT_EQ(map.header.eye_offset[1][0], 0.032f);
+  ASSERT_EQ(map.num_frames(), 100u);
+  VR_Trace::Frame frame;
+  for (int i = 99; i >= 0; i--) {
+    ASSERT_TRUE(map.frame(i, frame));
+    expect_frame_eq(frame, trace.frames[i]);
+  }
+  EXPECT_FALSE(map.frame(100, frame));
+  map.close();
+  EXPECT_FALSE(map.is_open());
+  EXPECT_EQ(map.num_frames(), 0u);
+
+  /* An unfinished recording: only its complete frames. */
+  std::string data = file_read(path);
+  data.replace(12, 4, 4, '\xFF');
+  data.resize(80 + 10 * VR_Trace::frame_size + 7);
+  FILE *f = fopen(path.c_str(), "wb");
+  ASSERT_TRUE(f != NULL);
+  fwrite(data.data(), 1, data.size(), f);
+  fclose(f);
+  ASSERT_TRUE(map.open(path.c_str()));
+  ASSERT_EQ(map.num_frames(), 10u);
+  ASSERT_TRUE(map.frame(9, frame));
+  expect_frame_eq(frame, trace.frames[9]);
+  EXPECT_FALSE(map.frame(10, frame));
+
+  /* Remapping replaces the previous file. */
+  EXPECT_FALSE(map.open(temp_path("vr_trace_test_missing.bxrt").c_str()));
+  EXPECT_FALSE(map.is_open());
+  remove(path.c_str());
+}
+
+TEST(vr_trace, PoseMatrix)
+{
+  /* 90 degrees about z: the x axis becomes y. */
+  VR_Trace::Pose pose = {{1.0f, 2.0f, 3.0f}, {(float)M_SQRT1_2, 0.0f, 0.0f, (float)M_SQRT1_2}};
+  float m[4][4];
+  VR_Trace::pose_to_matrix(pose, m);
+  const float expected[4][4] = {
+      {0.0f, 1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f, 0.0f}, {1.0f, 2.0f, 3.0f, 1.0f}};
+  EXPECT_M4_NEAR(m, expected, 1e-6f);
+
+  /* Round trip for rotations of all kinds (including 180 degrees). */
+  const float axes[][3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}, {1, 1, 0}, {-1, 2, 3}};
+  const float angles[] = {0.0f, 0.3f, 1.5f, 2.9f, (float)M_PI};
+  for (size_t a = 0; a < ARRAY_SIZE(axes); a++) {
+    const float len = sqrtf(axes[a][0] * axes[a][0] + axes[a][1] * axes[a][1] + axes[a][2] * axes[a][2]);
+    for (size_t b = 0; b < ARRAY_SIZE(angles); b++) {
+      const float s = sinf(angles[b] / 2.0f) / len;
+      VR_Trace::Pose p = {{-0.5f, 0.25f, 1.0f},
+                          {cosf(angles[b] / 2.0f), axes[a][0] * s, axes[a][1] * s, axes[a][2] * s}};
+      VR_Trace::pose_to_matrix(p, m);
+      VR_Trace::Pose q;
+      VR_Trace::matrix_to_pose(m, q);
+      float m_q[4][4];
+      VR_Trace::pose_to_matrix(q, m_q);
+      EXPECT_M4_NEAR(m, m_q, 1e-5f);
+      EXPECT_V3_NEAR(q.pos, p.pos, 0.0f);
+      /* Either sign describes the rotation. */
+      const float dot = p.rot[0] * q.rot[0] + p.rot[1] * q.rot[1] + p.rot[2] * q.rot[2] + p.rot[3] * q.rot[3];
+      EXPECT_NEAR(fabsf(dot), 1.0f, 1e-5f);
+    }
+  }
+}
+
+TEST(vr_trace, Controller)
+{
+  const VR_Trace::Frame frame = trace_frame(7);
+  VR_Controller state;
+  memset(&state, 0, sizeof(state));
+  state.side = VR_SIDE_RIGHT;
+  VR_Trace::controller_to_state(frame.controller[1], state);
+  EXPECT_EQ(state.side, VR_SIDE_RIGHT);
+  EXPECT_EQ(state.available, 1);
+  EXPECT_EQ(state.buttons, 7ull << 8);
+  EXPECT_EQ(state.dpad[0], 0.1f);
+  EXPECT_EQ(state.stick[1], -0.2f);
+  EXPECT_EQ(state.grip_pressure, 1.0f);
+
+  VR_Trace::Controller c;
+  memset(&c, 0, sizeof(c));
+  VR_Trace::state_to_controller(state, c);
+  EXPECT_EQ(c.available, 1);
+  EXPECT_EQ(c.buttons, frame.controller[1].buttons);
+  EXPECT_EQ(c.buttons_touched, frame.controller[1].buttons_touched);
+  EXPECT_EQ(c.trigger_pressure, frame.controller[1].trigger_pressure);
+}
+
+TEST(vr_trace, Timings)
+{
+  VR_Frame_Timings timings;
+  EXPECT_EQ(timings.num_frames(), 0u);
+  double t = 10.0;
+  for (int i = 0; i < 10; i++) {
+    for (int s = 0; s < VR_Frame_Timings::STAGES; s++) {
+      timings.begin((VR_Frame_Timings::Stage)s, t);
+      t += 0.001 * (s + 1);
+      timings.end((VR_Frame_Timings::Stage)s, t);
+    }
+    timings.frame_end(t);
+    t += 0.001;
+  }
+  ASSERT_EQ(timings.num_frames(), 10u);
+  for (int s = 0; s < VR_Frame_Timings::STAGES; s++) {
+    EXPECT_NEAR(timings.get(5, s), 0.001 * (s + 1), 1e-9);
+  }
+  /* Frame interval: all stages and the gap. */
+  EXPECT_NEAR(timings.get(5, VR_Frame_Timings::STAGES), 0.022, 1e-9);
+
+  const std::string path = temp_path("vr_trace_test_timings.json");
+  ASSERT_TRUE(timings.write_json(path.c_str(), "test.bxrt"));
+  const std::string json = file_read(path);
+  remove(path.c_str());
+  EXPECT_NE(json.find("\"trace\": \"test.bxrt\""), std::string::npos);
+  EXPECT_NE(json.find("\"frames\": 10"), std::string::npos);
+  for (int s = 0; s < VR_Frame_Timings::STAGES; s++) {
+    EXPECT_NE(json.find(std::string("\"") + VR_Frame_Timings::stage_name((VR_Frame_Timings::Stage)s) + "\""),
+              std::string::npos);
+  }
+
+  timings.clear();
+  EXPECT_EQ(timings.num_frames(), 0u);
+}
@@ -0,0 +1,198 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_tracking_sampler.h"
+
+#include <chrono>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+static void controller_poses(float x, float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+  memset(t_controller, 0, sizeof(float) * VR_MAX_CONTROLLERS * 16);
+  for (int c = 0; c < VR_MAX_CONTROLLERS; c++) {
+    for (int i = 0; i < 4; i++) {
+      t_controller[c][i][i] = 1.0f;
+    }
+    t_controller[c][3][0] = x;
+  }
+}
+
+TEST(vr_tracking_sampler, PushRead)
+{
+  VR_Tracking_Sampler sampler;
+  float t[VR_MAX_CONTROLLERS][4][4];
+  std::vector<VR_Tracking_Sampler::Sample> samples(VR_Tracking_Sampler::ring_size);
+  ui64 seq = sampler.head();
+  EXPECT_EQ(sampler.read(seq, &samples[0], 10), 0u);
+
+  /* Unchanged positions are not sampled. */
+  controller_poses(1.0f, t);
+  EXPECT_TRUE(sampler.push(0.1, t));
+  EXPECT_FALSE(sampler.push(0.2, t));
+  controller_poses(2.0f, t);
+  EXPECT_TRUE(sampler.push(0.3, t));
+  EXPECT_EQ(sampler.head(), 2u);
+
+  EXPECT_EQ(sampler.read(seq, &samples[0], 10), 2u);
+  EXPECT_EQ(seq, 2u);
+  EXPECT_EQ(samples[0].time, 0.1);
+  EXPECT_EQ(samples[1].time, 0.3);
+  EXPECT_EQ(samples[1].t_controller[1][3][0], 2.0f);
+  EXPECT_EQ(sampler.read(seq, &samples[0], 10), 0u);
+
+  /* Limited number of samples per read. */
+  for (int i = 0; i < 5; i++) {
+    controller_poses(3.0f + i, t);
+    sampler.push(1.0 + i, t);
+  }
+  EXPECT_EQ(sampler.read(seq, &samples[0], 3), 3u);
+  EXPECT_EQ(samples[0].time, 1.0);
+  EXPECT_EQ(sampler.read(seq, &samples[0], 3), 2u);
+  EXPECT_EQ(samples[1].time, 5.0);
+
+  /* Overrun: the oldest samples are lost. */
+  const uint ring_size = VR_Tracking_Sampler::ring_size;
+  const uint n = ring_size + 100;
+  for (uint i = 0; i < n; i++) {
+    controller_poses(100.0f + i, t);
+    sampler.push(100.0 + i, t);
+  }
+  EXPECT_EQ(sampler.read(seq, &samples[0], (uint)samples.size()), ring_size);
+  EXPECT_EQ(samples[0].time, 100.0 + n - ring_size);
+  EXPECT_EQ(samples[ring_size - 1].time, 100.0 + n - 1);
+  EXPECT_EQ(seq, sampler.head());
+
+  sampler.clear();
+  EXPECT_EQ(sampler.head(), 0u);
+}
+
+TEST(vr_tracking_sampler, SpacePoints)
+{
+  std::vector<Coord3Df> path;
+  path.push_back(Coord3Df(0, 0, 0));
+  path.push_back(Coord3Df(1, 0, 0));
+  path.push_back(Coord3Df(1, 0.5f, 0));
+  path.push_back(Coord3Df(1, 0.5f, 0)); /* Repeated point. */
+  path.push_back(Coord3Df(1, 2, 0));
+
+  std::vector<Coord3Df> dabs;
+  float travel = 0.0f;
+  EXPECT_EQ(VR_Tracking_Sampler::space_points(&path[0], (uint)path.size(), 0.25f, travel, dabs),
+            12u);
+  ASSERT_EQ(dabs.size(), 12u);
+  EXPECT_NEAR(dabs[0].x, 0.25f, 1e-6f);
+  EXPECT_NEAR(dabs[3].x, 1.0f, 1e-6f);
+  EXPECT_NEAR(dabs[3].y, 0.0f, 1e-6f);
+  EXPECT_NEAR(dabs[5].y, 0.5f, 1e-6f);
+  EXPECT_NEAR(dabs[11].y, 2.0f, 1e-6f);
+  EXPECT_NEAR(travel, 0.0f, 1e-6f);
+
+  /* The distance carries over to the next path (ending at the start of the next one). */
+  dabs.clear();
+  travel = 0.0f;
+  const Coord3Df a[2] = {Coord3Df(0, 0, 0), Coord3Df(0, 0, 0.3f)};
+  EXPECT_EQ(VR_Tracking_Sampler::space_points(a, 2, 0.5f, travel, dabs), 0u);
+  EXPECT_NEAR(travel, 0.3f, 1e-6f);
+  const Coord3Df b[2] = {Coord3Df(0, 0, 0.3f), Coord3Df(0, 0, 1.4f)};
+  EXPECT_EQ(VR_Tracking_Sampler::space_points(b, 2, 0.5f, travel, dabs), 2u);
+  EXPECT_NEAR(dabs[0].z, 0.5f, 1e-6f);
+  EXPECT_NEAR(dabs[1].z, 1.0f, 1e-6f);
+  EXPECT_NEAR(travel, 0.4f, 1e-6f);
+
+  /* Fewer dabs per frame at a lower frame rate, but at the same places. */
+  std::vector<Coord3Df> dabs_fine, dabs_coarse;
+  float travel_fine = 0.0f, travel_coarse = 0.0f;
+  for (int i = 0; i < 90; i++) {
+    const Coord3Df p[2] = {Coord3Df(0.1f * i, 0, 0), Coord3Df(0.1f * (i + 1), 0, 0)};
+    VR_Tracking_Sampler::space_points(p, 2, 0.35f, travel_fine, dabs_fine);
+  }
+  for (int i = 0; i < 90; i += 9) {
+    const Coord3Df p[2] = {Coord3Df(0.1f * i, 0, 0), Coord3Df(0.1f * (i + 9), 0, 0)};
+    VR_Tracking_Sampler::space_points(p, 2, 0.35f, travel_coarse, dabs_coarse);
+  }
+  ASSERT_EQ(dabs_fine.size(), dabs_coarse.size());
+  for (size_t i = 0; i < dabs_fine.size(); i++) {
+    EXPECT_NEAR(dabs_fine[i].x, dabs_coarse[i].x, 1e-4f);
+  }
+}
+
+static std::atomic<int> poll_count(0);
+
+/* A controller moving along x with every poll. */
+static int poll_moving(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+  controller_poses((float)(++poll_count), t_controller);
+  return 0;
+}
+
+/* Only the first controller is tracked (moving along x), the others are left unchanged. */
+static int poll_first(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+  static int count = 0;
+  for (int i = 0; i < 4; i++) {
+    t_controller[0][i][i] = 1.0f;
+  }
+  t_controller[0][3][0] = (float)(++count);
+  return 0;
+}
+
+static int poll_error(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+  controller_poses(0.0f, t_controller);
+  return -1;
+}
+
+TEST(vr_tracking_sampler, Thread)
+{
+  VR_Tracking_Sampler sampler;
+  EXPECT_FALSE(sampler.is_running());
+  EXPECT_TRUE(sampler.start(poll_moving, 1000));
+  EXPECT_FALSE(sampler.start(poll_moving, 1000));
+  EXPECT_TRUE(sampler.is_running());
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  sampler.stop();
+  EXPECT_FALSE(sampler.is_running());
+
+  /* Samples in order (at most the rate). */
+  std::vector<VR_Tracking_Sampler::Sample> samples(VR_Tracking_Sampler::ring_size);
+  ui64 seq = 0;
+  const uint n = sampler.read(seq, &samples[0], (uint)samples.size());
+  EXPECT_GT(n, 5u);
+  EXPECT_LE(n, 150u);
+  EXPECT_EQ(n, (uint)poll_count);
+  for (uint i = 1; i < n; i++) {
+    EXPECT_GE(samples[i].time, samples[i - 1].time);
+    EXPECT_EQ(samples[i].t_controller[0][3][0], samples[i - 1].t_controller[0][3][0] + 1.0f);
+  }
+
+  /* Failed polls are not sampled. */
+  sampler.clear();
+  EXPECT_TRUE(sampler.start(poll_error, 1000));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  sampler.stop();
+  EXPECT_EQ(sampler.head(), 0u);
+}
+
+TEST(vr_tracking_sampler, Untracked)
+{
+  /* Controllers that the backend doesn't report are zero in every sample. */
+  VR_Tracking_Sampler sampler;
+  EXPECT_TRUE(sampler.start(poll_first, 1000));
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  sampler.stop();
+
+  std::vector<VR_Tracking_Sampler::Sample> samples(VR_Tracking_Sampler::ring_size);
+  ui64 seq = 0;
+  const uint n = sampler.read(seq, &samples[0], (uint)samples.size());
+  EXPECT_GT(n, 1u);
+  const float zero[4][4] = {{0}};
+  for (uint i = 0; i < n; i++) {
+    EXPECT_EQ(samples[i].t_controller[0][3][3], 1.0f);
+    for (int c = 1; c < VR_MAX_CONTROLLERS; c++) {
+      EXPECT_EQ(memcmp(samples[i].t_controller[c], zero, sizeof(zero)), 0);
+    }
+  }
+}
@@ -0,0 +1,94 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_transform_session.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+extern "C" {
+#include "PIL_time.h"
+}
+
+#define NUM_FRAMES 20
+
+/* Stand-in for BMVert, so iterating the mesh has the same memory stride. */
+typedef struct BenchVert {
+  float co[3];
+  char hflag;
+  char pad[47];
+} BenchVert;
+
+/* Per-frame cost of transforming a selection of a mesh: iterating all vertices and transforming
+ * the selected ones in place (the previous loop of Widget_Transform::drag_contd()) against the
+ * transform session (only the selected vertices, from their original coordinates). */
+static void transform_benchmark(uint num_verts, uint select_interval)
+{
+  std::vector<BenchVert> verts(num_verts);
+  srand(0);
+  for (uint i = 0; i < num_verts; i++) {
+    verts[i].co[0] = (float)rand() / (float)RAND_MAX;
+    verts[i].co[1] = (float)rand() / (float)RAND_MAX;
+    verts[i].co[2] = (float)rand() / (float)RAND_MAX;
+    verts[i].hflag = (i % select_interval) == 0;
+  }
+
+  Mat44f delta;
+  delta.set_to_identity();
+  delta.m[3][0] = 0.001f;
+
+  double time = PIL_check_seconds_timer();
+  for (int f = 0; f < NUM_FRAMES; f++) {
+    for (uint i = 0; i < num_verts; i++) {
+      if (verts[i].hflag) {
+        float *co = verts[i].co;
+        const float x = co[0], y = co[1], z = co[2];
+        for (int k = 0; k < 3; k++) {
+          co[k] = x * delta.m[0][k] + y * delta.m[1][k] + z * delta.m[2][k] + delta.m[3][k];
+        }
+      }
+    }
+  }
+  const double time_ref = (PIL_check_seconds_timer() - time) / NUM_FRAMES;
+
+  time = PIL_check_seconds_timer();
+  std::vector<float *> co;
+  for (uint i = 0; i < num_verts; i++) {
+    if (verts[i].hflag) {
+      co.push_back(verts[i].co);
+    }
+  }
+  VR_Transform_Session session;
+  session.begin(&co[0], (uint)co.size());
+  const double time_begin = PIL_check_seconds_timer() - time;
+
+  time = PIL_check_seconds_timer();
+  for (int f = 0; f < NUM_FRAMES; f++) {
+    session.accumulate(delta);
+    session.apply();
+  }
+  const double time_session = (PIL_check_seconds_timer() - time) / NUM_FRAMES;
+
+  printf("%u vertices, %u selected (begin: %f ms):\n", num_verts, session.size(), time_begin * 1000.0);
+  printf("  Per frame: mesh loop %f ms, session %f ms (%.1fx)\n",
+         time_ref * 1000.0,
+         time_session * 1000.0,
+         time_ref / time_session);
+}
+
+TEST(vr_transform_session, Performance_1M_All)
+{
+  transform_benchmark(1000000, 1);
+}
+
+TEST(vr_transform_session, Performance_1M_Tenth)
+{
+  transform_benchmark(1000000, 10);
+}
+
+TEST(vr_transform_session, Performance_5M_Hundredth)
+{
+  transform_benchmark(5000000, 100);
+}
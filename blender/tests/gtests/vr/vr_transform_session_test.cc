@@ -0,0 +1,170 @@
+/* Apache License, Version 2.0 */
+
+#include "testing/testing.h"
+
+#include "vr_transform_session.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+
+static float frand(float lo, float hi)
+{
+  return lo + (hi - lo) * ((float)rand() / (float)RAND_MAX);
+}
+
+/* Rotation around z and translation (row-vector convention, as Mat44f). */
+static Mat44f rotation_z(double angle, float tx, float ty, float tz)
+{
+  Mat44f m;
+  m.set_to_identity();
+  m.m[0][0] = (float)cos(angle);
+  m.m[0][1] = (float)sin(angle);
+  m.m[1][0] = -(float)sin(angle);
+  m.m[1][1] = (float)cos(angle);
+  m.m[3][0] = tx;
+  m.m[3][1] = ty;
+  m.m[3][2] = tz;
+  return m;
+}
+
+/* As mul_v3_m4v3() (the previous in-place update of Widget_Transform). */
+static void transform_in_place(const Mat44f &m, float co[3])
+{
+  const float x = co[0], y = co[1], z = co[2];
+  for (int k = 0; k < 3; k++) {
+    co[k] = x * m.m[0][k] + y * m.m[1][k] + z * m.m[2][k] + m.m[3][k];
+  }
+}
+
+static std::vector<float *> coord_pointers(std::vector<Coord3Df> &co)
+{
+  std::vector<float *> ptr(co.size());
+  for (size_t i = 0; i < co.size(); i++) {
+    ptr[i] = &co[i].x;
+  }
+  return ptr;
+}
+
+TEST(vr_transform_session, TransformPoints)
+{
+  srand(1);
+  /* Not a multiple of the batch size. */
+  const uint n = 10007;
+  std::vector<float> x(n), y(n), z(n);
+  std::vector<Coord3Df> co(n);
+  for (uint i = 0; i < n; i++) {
+    x[i] = frand(-1, 1);
+    y[i] = frand(-1, 1);
+    z[i] = frand(-1, 1);
+  }
+  Mat44f m = rotation_z(0.7, 1.0f, -2.0f, 3.0f);
+  m.m[0][2] = 0.5f;
+  m.m[2][0] = -0.25f;
+  m.m[1][1] *= 2.0f;
+  std::vector<float *> ptr = coord_pointers(co);
+  VR_Transform_Session::transform_points(&x[0], &y[0], &z[0], n, m, &ptr[0]);
+
+  for (uint i = 0; i < n; i++) {
+    float expected[3] = {x[i], y[i], z[i]};
+    transform_in_place(m, expected);
+    EXPECT_FLOAT_EQ(co[i].x, expected[0]) << i;
+    EXPECT_FLOAT_EQ(co[i].y, expected[1]) << i;
+    EXPECT_FLOAT_EQ(co[i].z, expected[2]) << i;
+  }
+}
+
+TEST(vr_transform_session, Session)
+{
+  std::vector<Coord3Df> co(100);
+  for (size_t i = 0; i < co.size(); i++) {
+    co[i] = Coord3Df((float)i, 0.0f, 0.0f);
+  }
+
+  /* Every other vertex. */
+  std::vector<float *> ptr;
+  for (size_t i = 0; i < co.size(); i += 2) {
+    ptr.push_back(&co[i].x);
+  }
+  int owner, other;
+  VR_Transform_Session session;
+  EXPECT_FALSE(session.is_active());
+  session.begin(&ptr[0], (uint)ptr.size(), &owner);
+  EXPECT_TRUE(session.is_active());
+  EXPECT_TRUE(session.is_active(&owner));
+  EXPECT_FALSE(session.is_active(&other));
+  EXPECT_EQ(session.size(), 50u);
+
+  /* Relative transformations add up. */
+  for (int i = 0; i < 4; i++) {
+    session.accumulate(rotation_z(0.0, 0.0f, 1.0f, 0.5f));
+    session.apply();
+  }
+  for (size_t i = 0; i < co.size(); i++) {
+    EXPECT_EQ(co[i].x, (float)i);
+    EXPECT_EQ(co[i].y, (i % 2) ? 0.0f : 4.0f);
+    EXPECT_EQ(co[i].z, (i % 2) ? 0.0f : 2.0f);
+  }
+
+  /* Rotation after translation (not around the translated position). */
+  session.accumulate(rotation_z(M_PI / 2.0, 0.0f, 0.0f, 0.0f));
+  session.apply();
+  EXPECT_NEAR(co[2].x, -4.0f, 1e-5f);
+  EXPECT_NEAR(co[2].y, 2.0f, 1e-5f);
+
+  /* Absolute transformation. */
+  session.set_matrix(rotation_z(0.0, 1.0f, 0.0f, 0.0f));
+  session.apply();
+  EXPECT_EQ(co[2].x, 3.0f);
+  EXPECT_EQ(co[2].y, 0.0f);
+  EXPECT_EQ(session.get_matrix().m[3][0], 1.0f);
+
+  /* The vertices keep their coordinates. */
+  session.end();
+  EXPECT_FALSE(session.is_active());
+  EXPECT_EQ(session.size(), 0u);
+  session.apply();
+  EXPECT_EQ(co[2].x, 3.0f);
+
+  session.begin(NULL, 0, &owner);
+  session.accumulate(rotation_z(1.0, 1.0f, 1.0f, 1.0f));
+  session.apply();
+  EXPECT_EQ(session.size(), 0u);
+}
+
+TEST(vr_transform_session, NoDrift)
+{
+  srand(2);
+  const uint n = 1000;
+  std::vector<Coord3Df> co(n), co_incremental(n), co_orig(n);
+  for (uint i = 0; i < n; i++) {
+    co[i] = co_orig[i] = co_incremental[i] = Coord3Df(frand(-1, 1), frand(-1, 1), frand(-1, 1));
+  }
+  std::vector<float *> ptr = coord_pointers(co);
+  VR_Transform_Session session;
+  session.begin(&ptr[0], n);
+
+  /* A slow turn over a long drag (10 seconds at 90 Hz), as small relative transformations. */
+  const int frames = 900;
+  const double step = 2.0 * M_PI / frames;
+  const Mat44f delta = rotation_z(step, 0.0f, 0.0f, 0.0f);
+  for (int f = 0; f < frames; f++) {
+    session.accumulate(delta);
+    session.apply();
+    for (uint i = 0; i < n; i++) {
+      transform_in_place(delta, &co_incremental[i].x);
+    }
+  }
+
+  /* A full turn: back to the original coordinates (up to the rounding of the rotation step). */
+  float error = 0.0f, error_incremental = 0.0f;
+  for (uint i = 0; i < n; i++) {
+    for (int k = 0; k < 3; k++) {
+      error = fmaxf(error, fabsf((&co[i].x)[k] - (&co_orig[i].x)[k]));
+      error_incremental = fmaxf(error_incremental,
+                                fabsf((&co_incremental[i].x)[k] - (&co_orig[i].x)[k]));
+    }
+  }
+  EXPECT_LT(error, 1e-5f);
+  EXPECT_LT(error, error_incremental);
+}
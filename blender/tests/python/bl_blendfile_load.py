@@ -0,0 +1,213 @@
+# Apache License, Version 2.0
+
+# Load synthetic files, checking the data read doesn't depend on the number of threads,
+# and printing the load times (use a larger --scale to benchmark).
+#
+# ./blender.bin --background -noaudio --factory-startup \
+#     --python tests/python/bl_blendfile_load.py -- --verbose --scale 10
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+import unittest
+
+import bpy
+
+# Number of meshes and vertices of each mesh, multiplied by --scale.
+MESH_NUM = 20
+MESH_VERTS = 20000
+
+# Debug value making Blender reconstruct all structs as if they changed since the file was written,
+# see DEBUG_VALUE_RECONSTRUCT_ALL in readfile.c.
+DEBUG_VALUE_RECONSTRUCT_ALL = 1841
+
+args = None
+
+
+def mesh_data_digest():
+    import hashlib
+    import array
+
+    digest = hashlib.sha1()
+    for me in sorted(bpy.data.meshes, key=lambda me: me.name):
+        co = array.array('f', [0.0]) * (len(me.vertices) * 3)
+        me.vertices.foreach_get("co", co)
+        vertices = array.array('i', [0]) * len(me.loops)
+        me.loops.foreach_get("vertex_index", vertices)
+        edges = array.array('i', [0]) * (len(me.edges) * 2)
+        me.edges.foreach_get("vertices", edges)
+        loop_start = array.array('i', [0]) * len(me.polygons)
+        me.polygons.foreach_get("loop_start", loop_start)
+        digest.update(me.name.encode())
+        digest.update(co.tobytes())
+        digest.update(vertices.tobytes())
+        digest.update(edges.tobytes())
+        digest.update(loop_start.tobytes())
+    for ob in sorted(bpy.data.objects, key=lambda ob: ob.name):
+        digest.update(ob.name.encode())
+        digest.update((ob.data.name if ob.data else "").encode())
+        digest.update(array.array('f', ob.location).tobytes())
+    return digest.hexdigest()
+
+
+def mesh_data_create(scale):
+    import bmesh
+
+    bpy.ops.wm.read_factory_settings(use_empty=True)
+    scene = bpy.context.scene
+    size = int(MESH_VERTS ** 0.5)
+    for i in range(MESH_NUM * scale):
+        bm = bmesh.new()
+        bmesh.ops.create_grid(bm, x_segments=size, y_segments=size, size=1.0 + i)
+        me = bpy.data.meshes.new("Mesh.%05d" % i)
+        bm.to_mesh(me)
+        bm.free()
+        ob = bpy.data.objects.new("Object.%05d" % i, me)
+        ob.location.x = float(i)
+        scene.collection.objects.link(ob)
+
+
+def load_digest_subprocess(filepath, threads, reconstruct_all=False):
+    """
+    Load in a new Blender process, to change the number of threads.
+
+    :return: The digest of the data read, and the number of blocks reconstructed
+       and of those, on threads (as printed with --debug-io).
+    """
+    import re
+
+    command = [
+        bpy.app.binary_path,
+        "--background", "-noaudio", "--factory-startup", "--debug-io",
+        "-t", str(threads),
+    ]
+    if reconstruct_all:
+        command += ["--debug-value", str(DEBUG_VALUE_RECONSTRUCT_ALL)]
+    command += [
+        filepath,
+        "--python-expr",
+        "import sys\n"
+        "sys.path.append(%r)\n"
+        "import bl_blendfile_load\n"
+        "print('DIGEST', bl_blendfile_load.mesh_data_digest())\n" % os.path.dirname(__file__),
+    ]
+    output = subprocess.check_output(command)
+
+    digest = None
+    reconstruct = None
+    for line in output.decode().splitlines():
+        if line.startswith("DIGEST "):
+            digest = line.split()[1]
+        elif line.startswith("blo_read_file_internal: ") and os.path.basename(filepath) in line:
+            match = re.search(r"(\d+) blocks reconstructed, (\d+) on threads", line)
+            reconstruct = int(match.group(1)), int(match.group(2))
+    return digest, reconstruct
+
+
+class TestBlendFileLoad(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.tempdir = tempfile.TemporaryDirectory()
+        mesh_data_create(args.scale)
+        cls.digest = mesh_data_digest()
+        cls.mesh_verts_len = len(bpy.data.meshes[0].vertices)
+        cls.filepaths = {}
+        for compress in ("plain", "compressed", "compressed_frames"):
+            filepath = os.path.join(cls.tempdir.name, "load_%s.blend" % compress)
+            bpy.ops.wm.save_as_mainfile(
+                filepath=filepath,
+                compress=(compress != "plain"),
+                compress_frames=(compress == "compressed_frames"),
+                copy=True,
+            )
+            cls.filepaths[compress] = filepath
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.tempdir.cleanup()
+
+    def load(self, compress):
+        filepath = self.filepaths[compress]
+        time_best = None
+        for _ in range(args.repeat):
+            time_start = time.perf_counter()
+            bpy.ops.wm.open_mainfile(filepath=filepath, load_ui=False)
+            time_load = time.perf_counter() - time_start
+            time_best = time_load if time_best is None else min(time_best, time_load)
+        print("\n%s: %.1f MB, best load time %.3f s" % (
+            os.path.basename(filepath), os.path.getsize(filepath) / (1 << 20), time_best))
+        self.assertEqual(mesh_data_digest(), self.digest)
+
+    def test_load_plain(self):
+        self.load("plain")
+
+    def test_load_compressed(self):
+        self.load("compressed")
+
+    def test_load_compressed_frames(self):
+        self.load("compressed_frames")
+
+    def link(self, compress):
+        # Linking an object reads only its blocks and the blocks of its mesh,
+        # looked up in the index saved at the end of the file (seeking in the frames).
+        bpy.ops.wm.read_factory_settings(use_empty=True)
+        index = MESH_NUM * args.scale // 2
+        with bpy.data.libraries.load(self.filepaths[compress], link=True) as (src, dst):
+            self.assertEqual(len(src.objects), MESH_NUM * args.scale)
+            dst.objects = ["Object.%05d" % index]
+        ob = bpy.data.objects["Object.%05d" % index]
+        self.assertEqual(ob.data.name, "Mesh.%05d" % index)
+        self.assertEqual(len(ob.data.vertices), self.mesh_verts_len)
+        self.assertIsNotNone(ob.data.library)
+
+    def test_link_plain(self):
+        self.link("plain")
+
+    def test_link_compressed_frames(self):
+        self.link("compressed_frames")
+
+    def test_load_threads(self):
+        # Decompressing ahead must not change the result.
+        for filepath in self.filepaths.values():
+            self.assertEqual(load_digest_subprocess(filepath, 1)[0], self.digest)
+            self.assertEqual(load_digest_subprocess(filepath, 0)[0], self.digest)
+
+    def test_reconstruct_threads(self):
+        # The files are saved by this build so no struct changed, reconstruct them all anyway.
+        # With one thread the blocks are reconstructed one by one, as they are read:
+        # reconstructing them on threads must give the same result.
+        for filepath in self.filepaths.values():
+            digest, (reconstruct_len, threaded_len) = load_digest_subprocess(
+                filepath, 1, reconstruct_all=True)
+            self.assertEqual(digest, self.digest)
+            self.assertGreater(reconstruct_len, 0)
+            self.assertEqual(threaded_len, 0)
+
+            digest, (reconstruct_len_threads, threaded_len) = load_digest_subprocess(
+                filepath, 4, reconstruct_all=True)
+            self.assertEqual(digest, self.digest)
+            self.assertEqual(reconstruct_len_threads, reconstruct_len)
+            self.assertGreater(threaded_len, 0)
+
+            # Without forcing it, there is nothing to reconstruct.
+            self.assertEqual(load_digest_subprocess(filepath, 4)[1], (0, 0))
+
+
+def main():
+    global args
+    import argparse
+
+    argv = sys.argv[sys.argv.index("--") + 1:] if "--" in sys.argv else []
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--scale", type=int, default=1, help="Multiply the number of meshes")
+    parser.add_argument("--repeat", type=int, default=3, help="Number of loads timed")
+    args, remaining = parser.parse_known_args(argv)
+
+    sys.argv = [__file__] + remaining
+    unittest.main()
+
+
+if __name__ == '__main__':
+    main()
@@ -160,11 +160,15 @@ public:
 	virtual int setEyeOffset(Side side, float x, float y, float z); //!< Override the offset of the eyes (camera positions) relative to the HMD.
 
 	virtual int updateTracking();      //!< Update the HMD/Eye/Controller positions based on latest tracking data.
+	virtual int sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4]); //!< Get the controller positions from the latest tracking data, between two frames (if available).
 
 	virtual int blitEye(Side side, void* texture_resource, const float& aperture_u, const float& aperture_v); //!< Blit a rendered image into the internal eye texture.
 	virtual int blitEyes(void* texture_resource_left, void* texture_resource_right, const float& aperture_u, const float& aperture_v); //!< Blit rendered images into the internal eye textures.
 	virtual int submitFrame();         //!< Submit frame to the HMD.
 
+	virtual int getEyeImages(Side side, uint* images, uint& count); //!< Get the device-owned eye images that can be rendered into directly (if available).
+	virtual int acquireEyeImage(Side side, uint& index); //!< Acquire the device-owned eye image to render the next frame into.
+
 	virtual int getTrackerPosition(uint i, float t[4][4]) const; //!< Get the position of a tracking camera / device (if available).
 };
 
@@ -312,6 +316,21 @@ inline int VR::updateTracking()
 	return VR::Error_NotAvailable; // Dummy implementation.
 }
 
+//                                                                          ________________________
+//_________________________________________________________________________/ sampleControllerPositions()
+/**
+ * Get the controller positions from the latest tracking data of the runtime, instead of the ones
+ * of the last updateTracking() call (which are only updated once per frame).
+ * Controllers that are not tracked are left unchanged.
+ * Can be called from another thread, but not at the same time as updateTracking().
+ * \param   t_controller    [OUT] Transformation matrices of the controllers.
+ * \return  Zero on success, an error code on failure.
+ */
+inline int VR::sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+	return VR::Error_NotAvailable; // Dummy implementation.
+}
+
 //                                                                          ________________________
 //_________________________________________________________________________/    submitFrame()
 /**
@@ -351,6 +370,35 @@ inline int VR::blitEyes(void* texture_resource_left, void* texture_resource_righ
 	return VR::Error_NotAvailable; // Dummy implementation.
 }
 
+//                                                                          ________________________
+//_________________________________________________________________________/    getEyeImages()
+/**
+ * Get the device-owned eye images that can be rendered into directly (if available).
+ * Rendering into these images replaces blitting: submitFrame() presents the acquired images as they are.
+ * \param   side    Which eye to get the images for.
+ * \param   images  [OUT] Array to receive the images (OpenGL texture IDs).
+ * \param   count   [IN/OUT] Capacity of images, receives the number of images.
+ * \return  Zero on success, an error code on failure.
+ */
+inline int VR::getEyeImages(Side side, uint* images, uint& count)
+{
+	return VR::Error_NotAvailable; // Dummy implementation.
+}
+
+//                                                                          ________________________
+//_________________________________________________________________________/   acquireEyeImage()
+/**
+ * Acquire the device-owned eye image to render the next frame into (see getEyeImages()).
+ * The image is released by submitFrame(). Acquiring again before that returns the same image.
+ * \param   side    Which eye to acquire the image for.
+ * \param   index   [OUT] Index of the acquired image, in the images of getEyeImages().
+ * \return  Zero on success, an error code on failure.
+ */
+inline int VR::acquireEyeImage(Side side, uint& index)
+{
+	return VR::Error_NotAvailable; // Dummy implementation.
+}
+
 //                                                                          ________________________
 //_________________________________________________________________________/  getTrackerPosition()
 /**
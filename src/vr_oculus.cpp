@@ -70,6 +70,7 @@ VR_Oculus::VR_Oculus()
 	, hmd(0)
 	, hmd_type(HMDType_Oculus)
 	, frame_index(0)
+	, tracking_prediction(0)
 	, initialized(false)
 {
 	this->eye[0] = Eye();
@@ -465,6 +466,7 @@ int VR_Oculus::updateTracking()
 	}
 	float ftiming = ovr_GetPredictedDisplayTime(this->hmd, 0);
 	ovrTrackingState tracking_state = ovr_GetTrackingState(this->hmd, ftiming, ovrTrue);
+	this->tracking_prediction = ftiming - ovr_GetTimeInSeconds();
 	ovrPosef offset[2];
 	offset[ovrEye_Left] = this->eye[Side_Left].offset;
 	offset[ovrEye_Right] = this->eye[Side_Right].offset;
@@ -667,6 +669,29 @@ int VR_Oculus::updateTracking()
 	return VR::Error_None;
 }
 
+//                                                                      ____________________________
+//_____________________________________________________________________/ sampleControllerPositions()
+/**
+ * Get the controller positions from the latest tracking data, between two frames.
+ * The controllers are predicted as far ahead of the current time as updateTracking() predicts them.
+ * \param   t_controller    [OUT] Transformation matrices of the tracked controllers.
+ * \return  Zero on success, an error code on failure.
+ */
+int VR_Oculus::sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+	if (!this->initialized) {
+		return VR_Oculus::Error_NotInitialized;
+	}
+	ovrTrackingState tracking_state = ovr_GetTrackingState(this->hmd, ovr_GetTimeInSeconds() + this->tracking_prediction, ovrTrue);
+	if (tracking_state.HandStatusFlags[ovrHand_Left] & ovrStatus_PositionTracked) {
+		transferControllerTransformation(tracking_state.HandPoses[ovrHand_Left].ThePose, t_controller[Side_Left]);
+	}
+	if (tracking_state.HandStatusFlags[ovrHand_Right] & ovrStatus_PositionTracked) {
+		transferControllerTransformation(tracking_state.HandPoses[ovrHand_Right].ThePose, t_controller[Side_Right]);
+	}
+	return VR::Error_None;
+}
+
 //                                                                          ________________________
 //_________________________________________________________________________/     blitEye()
 /**
@@ -1082,6 +1107,14 @@ int c_getControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4])
 	return 0;
 }
 
+/**
+ * Position of the controllers from the latest tracking data (between two frames).
+ */
+int c_sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+	return c_obj->sampleControllerPositions(t_controller);
+}
+
 /**
  * Last tracked button state of the controller.
  */
@@ -57,6 +57,7 @@ extern "C" __declspec(dllexport) int c_updateTrackingVR();	//!< Update the t_eye
 extern "C" __declspec(dllexport) int c_getEyePositions(float t_eye[VR::Sides][4][4]);	//!< Last tracked position of the eyes.
 extern "C" __declspec(dllexport) int c_getHMDPosition(float t_hmd[4][4]);	//!< Last tracked position of the HMD.
 extern "C" __declspec(dllexport) int c_getControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4]);	//!< Last tracked position of the controllers.
+extern "C" __declspec(dllexport) int c_sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4]);	//!< Position of the controllers from the latest tracking data (between two frames).
 extern "C" __declspec(dllexport) int c_getControllerStates(void* controller_states[VR_MAX_CONTROLLERS]);	//!< Last tracked button states of the controller.
 extern "C" __declspec(dllexport) int c_blitEye(int side, void* texture_resource, const float* aperture_u, const float* aperture_v);	//!< Blit a rendered image into the internal eye texture.
 extern "C" __declspec(dllexport) int c_blitEyes(void* texture_resource_left, void* texture_resource_right, const float* aperture_u, const float* aperture_v);	//!< Blit rendered images into the internal eye textures.
@@ -130,6 +131,7 @@ public:
 protected:
 	long long           frame_index;        //!< Frame index counter.
 	double				sensor_sample_time; //!< Time of last sensor sampling.
+	double				tracking_prediction; //!< How far ahead of the current time the tracking was last predicted (seconds).
 	ovrGraphicsLuid		luid;				//!< Oculus luid.
 	ovrSession          hmd;                //!< Rift HMD identifier.
 	ovrHmdDesc          hmd_desc;           //!< Descriptor of the HMD.
@@ -150,6 +152,7 @@ public:
 	virtual int getDefaultEyeTexSize(uint& w, uint& h, Side side = Side_Both);	//!< Get the default eye texture size.
 
 	virtual int updateTracking();	//!< Update the t_eye positions based on latest tracking data.
+	virtual int sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4]);	//!< Get the controller positions from the latest tracking data, between two frames.
 
 	virtual int blitEye(Side side, void* texture_resource, const float& aperture_u, const float& aperture_v);	//!< Blit a rendered image into the internal eye texture.
 	virtual int blitEyes(void* texture_resource_left, void* texture_resource_right, const float& aperture_u, const float& aperture_v);	//!< Blit rendered images into the internal eye textures.
@@ -33,6 +33,7 @@
 #include <algorithm>
 #endif
 #include <ctime>
+#include <string>
 
 /***********************************************************************************************//**
  * \class                                  VR_OpenXR
@@ -152,10 +153,13 @@ VR_OpenXR::VR_OpenXR()
 	, initialized(false)
 {
 	m_frameState = { XR_TYPE_FRAME_STATE };
+	m_trackingDisplayTime = 0;
 
 	eye_offset_override[Side_Left] = false;
 	eye_offset_override[Side_Right] = false;
 
+	m_acquiredImage.fill(-1);
+
 	memset(&this->gl, 0, sizeof(this->gl));
 #ifdef _WIN32
 	memset(&this->d3d, 0, sizeof(this->d3d));
@@ -1099,6 +1103,7 @@ int VR_OpenXR::init(void* display, void* drawable, void* context)
 		Swapchain swapchain;
 		swapchain.width = swapchainCreateInfo.width;
 		swapchain.height = swapchainCreateInfo.height;
+		swapchain.sampleCount = swapchainCreateInfo.sampleCount;
 		if (XR_FAILED(xrCreateSwapchain(m_session, &swapchainCreateInfo, &swapchain.handle))) {
 			releaseHMD();
 			return VR::Error_InternalFailure;
@@ -2072,7 +2077,9 @@ int VR_OpenXR::uninit()
 		xrDestroySwapchain(swapchain.handle);
 	}
 	m_swapchains.clear();
+	m_swapchainImages.clear();
 	m_swapchainImageBuffers.clear();
+	m_acquiredImage.fill(-1);
 
 	if (m_appSpace != XR_NULL_HANDLE) {
 		xrDestroySpace(m_appSpace);
@@ -2190,6 +2197,8 @@ int VR_OpenXR::updateTracking()
 	if (XR_FAILED(xrLocateViews(m_session, &viewLocateInfo, &viewState, viewCapacityInput, &viewCountOutput, m_views.data()))) {
 		return VR::Error_InternalFailure;
 	}
+	m_trackingDisplayTime = m_frameState.predictedDisplayTime;
+	m_trackingTime = std::chrono::steady_clock::now();
 
 	// Sync action data
 	XrActiveActionSet activeActionSet{ m_inputState.actionSet, XR_NULL_PATH };
@@ -2248,6 +2257,41 @@ int VR_OpenXR::updateTracking()
 	return VR::Error_None;
 }
 
+//                                                                      ____________________________
+//_____________________________________________________________________/ sampleControllerPositions()
+/**
+ * Get the controller positions from the latest tracking data, between two frames.
+ * The controllers are located as far ahead of the current time as updateTracking() locates them
+ * ahead of the time it was called (its predicted display time).
+ * \param   t_controller    [OUT] Transformation matrices of the tracked controllers.
+ * \return  Zero on success, an error code on failure.
+ */
+int VR_OpenXR::sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+	if (!m_instance || !m_session || !m_trackingDisplayTime) {
+		return VR::Error_NotInitialized;
+	}
+
+	const XrTime time = m_trackingDisplayTime + (XrTime)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_trackingTime).count();
+	for (int i = 0; i < Sides; ++i) {
+		if (!this->controller[i].available) {
+			continue;
+		}
+		XrSpaceLocation spaceLocation{ XR_TYPE_SPACE_LOCATION };
+		if (XR_FAILED(xrLocateSpace(m_inputState.handSpace[i], m_appSpace, time, &spaceLocation))) {
+			continue;
+		}
+		if ((spaceLocation.locationFlags & (XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT)) !=
+			(XR_SPACE_LOCATION_POSITION_VALID_BIT | XR_SPACE_LOCATION_ORIENTATION_VALID_BIT)) {
+			continue;
+		}
+		transferControllerTransformation(spaceLocation.pose, t_controller[i]);
+		this->offsetControllerTransformation(t_controller[i]);
+	}
+
+	return VR::Error_None;
+}
+
 //                                                                          ________________________
 //_________________________________________________________________________/  getTrackerPosition()
 /**
@@ -2265,15 +2309,13 @@ int VR_OpenXR::getTrackerPosition(uint i, float t[4][4]) const
 	return VR_OpenXR::Error_None;
 }
 
-//                                                                      ____________________________
-//_____________________________________________________________________/ interpretControllerState()
+//                                                                 _________________________________
+//________________________________________________________________/ offsetControllerTransformation()
 /**
- * Helper function to deal with VR controller data.
+ * Move the controller transformation ahead of the controller (cursor position).
  */
-void VR_OpenXR::interpretControllerState( float t_controller[4][4], Controller& c)
+void VR_OpenXR::offsetControllerTransformation(float t_controller[4][4]) const
 {
-	c.available = 1;
-	
 	// offset, so that the cursor is ahead of the controller
 	// for HTC Vive contollers, the offset should be 60.0 mm
 	// for WindowsMR controllers, the offset should be 30.0 mm
@@ -2296,6 +2338,18 @@ void VR_OpenXR::interpretControllerState( float t_controller[4][4], Controller&
 	t_controller[3][0] += t_controller[1][0] * controller_offset;
 	t_controller[3][1] += t_controller[1][1] * controller_offset;
 	t_controller[3][2] += t_controller[1][2] * controller_offset;
+}
+
+//                                                                      ____________________________
+//_____________________________________________________________________/ interpretControllerState()
+/**
+ * Helper function to deal with VR controller data.
+ */
+void VR_OpenXR::interpretControllerState( float t_controller[4][4], Controller& c)
+{
+	c.available = 1;
+	
+	this->offsetControllerTransformation(t_controller);
 
 	clock_t now = clock();
 
@@ -3234,16 +3288,24 @@ bool VR_OpenXR::renderLayer(XrTime predictedDisplayTime, std::vector<XrCompositi
 			// Each view has a separate swapchain which is acquired, rendered to, and released.
 			const Swapchain viewSwapchain = m_swapchains[i];
 
-			XrSwapchainImageAcquireInfo acquireInfo{ XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
+			// Rendered directly into the swapchain image (see acquireEyeImage()): nothing to copy.
+			const bool direct = (i < Sides && m_acquiredImage[i] >= 0);
+
 			uint32_t swapchainImageIndex;
-			if (XR_FAILED(xrAcquireSwapchainImage(viewSwapchain.handle, &acquireInfo, &swapchainImageIndex))) {
-				return false;
+			if (direct) {
+				swapchainImageIndex = (uint32_t)m_acquiredImage[i];
 			}
+			else {
+				XrSwapchainImageAcquireInfo acquireInfo{ XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
+				if (XR_FAILED(xrAcquireSwapchainImage(viewSwapchain.handle, &acquireInfo, &swapchainImageIndex))) {
+					return false;
+				}
 
-			XrSwapchainImageWaitInfo waitInfo{ XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
-			waitInfo.timeout = XR_INFINITE_DURATION;
-			if (XR_FAILED(xrWaitSwapchainImage(viewSwapchain.handle, &waitInfo))) {
-				return false;
+				XrSwapchainImageWaitInfo waitInfo{ XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
+				waitInfo.timeout = XR_INFINITE_DURATION;
+				if (XR_FAILED(xrWaitSwapchainImage(viewSwapchain.handle, &waitInfo))) {
+					return false;
+				}
 			}
 
 			projectionLayerViews[i] = { XR_TYPE_COMPOSITION_LAYER_PROJECTION_VIEW };
@@ -3253,6 +3315,11 @@ bool VR_OpenXR::renderLayer(XrTime predictedDisplayTime, std::vector<XrCompositi
 			projectionLayerViews[i].subImage.imageRect.offset = { 0, 0 };
 			projectionLayerViews[i].subImage.imageRect.extent = { viewSwapchain.width, viewSwapchain.height };
 
+			if (direct) {
+				// Released with the other directly rendered images (see releaseEyeImages()).
+				continue;
+			}
+
 			XrSwapchainImageBaseHeader* const swapchainImage =
 				m_swapchainImages[viewSwapchain.handle][swapchainImageIndex];
 
@@ -3266,14 +3333,16 @@ bool VR_OpenXR::renderLayer(XrTime predictedDisplayTime, std::vector<XrCompositi
 				d3d.context->CopyResource(output_texture, input_texture);
 			}
 #else
-			GLenum input_texture = (GLenum)gl.texture[i];
-			GLenum output_texture = (GLenum)reinterpret_cast<XrSwapchainImageOpenGLKHR*>(swapchainImage)->image;
-			glCopyBufferSubData(input_texture, output_texture, 0, 0, sizeof(GLubyte) * texture_width * texture_height * 4);
+			GLuint input_texture = gl.texture[i];
+			GLuint output_texture = reinterpret_cast<XrSwapchainImageOpenGLKHR*>(swapchainImage)->image;
+			glCopyImageSubData(input_texture, GL_TEXTURE_2D, 0, 0, 0, 0, output_texture, GL_TEXTURE_2D, 0, 0, 0, 0,
+				viewSwapchain.width, viewSwapchain.height, 1);
 #endif
 #else
-			GLenum input_texture = (GLenum)gl.texture[i];
-			GLenum output_texture = (GLenum)reinterpret_cast<XrSwapchainImageOpenGLKHR*>(swapchainImage)->image;
-			glCopyBufferSubData(input_texture, output_texture, 0, 0, sizeof(GLubyte) * texture_width * texture_height * 4);
+			GLuint input_texture = gl.texture[i];
+			GLuint output_texture = reinterpret_cast<XrSwapchainImageOpenGLKHR*>(swapchainImage)->image;
+			glCopyImageSubData(input_texture, GL_TEXTURE_2D, 0, 0, 0, 0, output_texture, GL_TEXTURE_2D, 0, 0, 0, 0,
+				viewSwapchain.width, viewSwapchain.height, 1);
 #endif
 			XrSwapchainImageReleaseInfo releaseInfo{ XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
 			if (XR_FAILED(xrReleaseSwapchainImage(viewSwapchain.handle, &releaseInfo))) {
@@ -3323,6 +3392,8 @@ int VR_OpenXR::submitFrame()
 	if (renderLayer(m_frameState.predictedDisplayTime, projectionLayerViews, layer)) {
 		layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&layer));
 	}
+	// Images must be released before the frame ends (even if the layer could not be submitted).
+	releaseEyeImages();
 
 	XrFrameEndInfo frameEndInfo{ XR_TYPE_FRAME_END_INFO };
 	frameEndInfo.displayTime = m_frameState.predictedDisplayTime;
@@ -3336,6 +3407,106 @@ int VR_OpenXR::submitFrame()
 	return VR::Error_None;
 }
 
+//                                                                          ________________________
+//_________________________________________________________________________/    getEyeImages()
+/**
+ * Get the swapchain images of an eye, to be rendered into directly instead of blitting.
+ * Only available for OpenGL swapchains with single-sample images.
+ */
+int VR_OpenXR::getEyeImages(Side side, uint* images, uint& count)
+{
+	if (!this->initialized) {
+		return VR::Error_NotInitialized;
+	}
+	if (side != Side_Left && side != Side_Right) {
+		return VR::Error_InvalidParameter;
+	}
+	if ((uint)side >= m_swapchains.size()) {
+		return VR::Error_NotInitialized;
+	}
+
+#if defined(_WIN32) && XR_USE_GRAPHICS_API_D3D11
+	// D3D11 images can't be rendered into by Blender (OpenGL) without interop.
+	return VR::Error_NotAvailable;
+#else
+	const Swapchain& swapchain = m_swapchains[side];
+	// The blit shader applies the gamma correction, and Blender renders single-sample textures.
+	if (this->gamma != 1.0f || swapchain.sampleCount > 1) {
+		return VR::Error_NotAvailable;
+	}
+
+	const std::vector<XrSwapchainImageBaseHeader*>& swapchainImages = m_swapchainImages[swapchain.handle];
+	if (swapchainImages.size() > count) {
+		return VR::Error_InvalidParameter;
+	}
+	count = (uint)swapchainImages.size();
+	for (uint i = 0; i < count; ++i) {
+		images[i] = reinterpret_cast<XrSwapchainImageOpenGLKHR*>(swapchainImages[i])->image;
+	}
+
+	return VR::Error_None;
+#endif
+}
+
+//                                                                          ________________________
+//_________________________________________________________________________/   acquireEyeImage()
+/**
+ * Acquire the swapchain image of an eye for rendering the next frame into it directly.
+ * The image is released (and presented without copying) by submitFrame().
+ */
+int VR_OpenXR::acquireEyeImage(Side side, uint& index)
+{
+	if (!this->initialized) {
+		return VR::Error_NotInitialized;
+	}
+	if (side != Side_Left && side != Side_Right) {
+		return VR::Error_InvalidParameter;
+	}
+	if ((uint)side >= m_swapchains.size()) {
+		return VR::Error_NotInitialized;
+	}
+
+	if (m_acquiredImage[side] < 0) {
+		const Swapchain& swapchain = m_swapchains[side];
+
+		XrSwapchainImageAcquireInfo acquireInfo{ XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
+		uint32_t swapchainImageIndex;
+		if (XR_FAILED(xrAcquireSwapchainImage(swapchain.handle, &acquireInfo, &swapchainImageIndex))) {
+			return VR::Error_InternalFailure;
+		}
+
+		XrSwapchainImageWaitInfo waitInfo{ XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
+		waitInfo.timeout = XR_INFINITE_DURATION;
+		if (XR_FAILED(xrWaitSwapchainImage(swapchain.handle, &waitInfo))) {
+			XrSwapchainImageReleaseInfo releaseInfo{ XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
+			xrReleaseSwapchainImage(swapchain.handle, &releaseInfo);
+			return VR::Error_InternalFailure;
+		}
+
+		m_acquiredImage[side] = (int32_t)swapchainImageIndex;
+	}
+
+	index = (uint)m_acquiredImage[side];
+
+	return VR::Error_None;
+}
+
+//                                                                          ________________________
+//_________________________________________________________________________/  releaseEyeImages()
+/**
+ * Release the swapchain images acquired for direct rendering.
+ */
+void VR_OpenXR::releaseEyeImages()
+{
+	for (uint i = 0; i < Sides && i < m_swapchains.size(); ++i) {
+		if (m_acquiredImage[i] >= 0) {
+			XrSwapchainImageReleaseInfo releaseInfo{ XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
+			xrReleaseSwapchainImage(m_swapchains[i].handle, &releaseInfo);
+			m_acquiredImage[i] = -1;
+		}
+	}
+}
+
 //                                                                          ________________________
 //_________________________________________________________________________/  getDefaultEyeTexSize
 /**
@@ -3547,6 +3718,14 @@ int c_getControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4])
 	return 0;
 }
 
+/**
+ * Position of the controllers from the latest tracking data (between two frames).
+ */
+int c_sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+	return c_obj->sampleControllerPositions(t_controller);
+}
+
 /**
  * Last tracked button state of the controllers.
  */
@@ -3590,6 +3769,25 @@ int c_submitFrame()
 	return c_obj->submitFrame();
 }
 
+/**
+ * Get the device-owned eye images that can be rendered into directly.
+ * \param side      Zero for left, one for right.
+ * \param count     Capacity of images, receives the number of images.
+ */
+int c_getEyeImages(int side, uint* images, int* count)
+{
+	return c_obj->getEyeImages((VR::Side)side, images, *(uint*)count);
+}
+
+/**
+ * Acquire the device-owned eye image to render the next frame into.
+ * \param side      Zero for left, one for right.
+ */
+int c_acquireEyeImage(int side, int* index)
+{
+	return c_obj->acquireEyeImage((VR::Side)side, *(uint*)index);
+}
+
 /**
  * Un-initialize the internal object.
  */
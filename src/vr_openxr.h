@@ -35,6 +35,7 @@
 #include <map>
 #include <array>
 #include <list>
+#include <chrono>
 
 #define VR_OPENXR_DEBOUNCEPERIOD                 200	//!< Debounce period to avoid jumpy/slacky touchpad touches.
 #define VR_OPENXR_BUTTONPRESSURETHRESHOLD        0.3f	//!< Threshold for general button pressure to be registered as "pressed".
@@ -95,10 +96,13 @@ extern "C" __declspec(dllexport) int c_updateTrackingVR(); //!< Update the t_eye
 extern "C" __declspec(dllexport) int c_getEyePositions(float t_eye[VR::Sides][4][4]); //!< Last tracked position of the eyes.
 extern "C" __declspec(dllexport) int c_getHMDPosition(float t_hmd[4][4]);      //!< Last tracked position of the HMD.
 extern "C" __declspec(dllexport) int c_getControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4]); //!< Last tracked position of the controller.
+extern "C" __declspec(dllexport) int c_sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4]); //!< Position of the controllers from the latest tracking data (between two frames).
 extern "C" __declspec(dllexport) int c_getControllerStates(void* controller_states[VR_MAX_CONTROLLERS]); //!< Last tracked button states of the controllers.
 extern "C" __declspec(dllexport) int c_blitEye(int side, void* texture_resource, const float* aperture_u, const float* aperture_v); //!< Blit a rendered image into the internal eye texture.
 extern "C" __declspec(dllexport) int c_blitEyes(void* texture_resource_left, void* texture_resource_right, const float* aperture_u, const float* aperture_v); //!< Blit rendered images into the internal eye textures.
 extern "C" __declspec(dllexport) int c_submitFrame(); //!< Submit frame to the HMD.
+extern "C" __declspec(dllexport) int c_getEyeImages(int side, uint* images, int* count); //!< Get the device-owned eye images that can be rendered into directly.
+extern "C" __declspec(dllexport) int c_acquireEyeImage(int side, int* index); //!< Acquire the device-owned eye image to render the next frame into.
 extern "C" __declspec(dllexport) int c_uninitVR(); //!< Un-initialize the internal object.
 
 // OpenXR VR module.
@@ -118,6 +122,7 @@ protected:
 		XrSwapchain handle;
 		int32_t width;
 		int32_t height;
+		uint32_t sampleCount;
 	};
 	XrViewConfigurationProperties m_viewConfig{};
 	std::vector<XrViewConfigurationView> m_configViews;
@@ -125,6 +130,7 @@ protected:
 	std::map<XrSwapchain, std::vector<XrSwapchainImageBaseHeader*>> m_swapchainImages;
 	std::vector<XrView> m_views;
 	int64_t m_colorSwapchainFormat;
+	std::array<int32_t, Sides> m_acquiredImage; //!< Swapchain image acquired for direct rendering (per eye), -1 if none.
 #ifdef _WIN32
 #if XR_USE_GRAPHICS_API_D3D11
 	std::list<std::vector<XrSwapchainImageD3D11KHR>> m_swapchainImageBuffers;
@@ -136,6 +142,8 @@ protected:
 #endif
 
 	XrFrameState m_frameState;
+	XrTime m_trackingDisplayTime; //!< Display time the tracking was last updated for (see updateTracking()).
+	std::chrono::steady_clock::time_point m_trackingTime; //!< When the tracking was last updated.
 	XrSessionState m_sessionState;
 
 	struct InputState {
@@ -262,9 +270,11 @@ protected:
 	int acquireHMD(); //!< Initialize basic VR operation and acquire the HMD object.
 	int releaseHMD(); //!< Delete the HMD object and uninitialize basic VR operation.
 
+	void offsetControllerTransformation(float t_controller[4][4]) const; //!< Move the controller transformation ahead of the controller (cursor position).
 	void interpretControllerState(float t_controller[4][4], Controller& c); //!< Helper function to deal with VR controller data.
 	bool renderLayer(XrTime predictedDisplayTime, std::vector<XrCompositionLayerProjectionView>& projectionLayerViews,
 					 XrCompositionLayerProjection& layer); //!< Helper function to render compositor layer.
+	void releaseEyeImages(); //!< Release the swapchain images acquired for direct rendering.
 public:
 	virtual Type type(); //<! Get which API was used in this implementation.
 	virtual HMDType hmdType(); //<! Get which HMD was used in this implementation.
@@ -282,11 +292,15 @@ public:
 	virtual int setEyeOffset(Side side, float x, float y, float z); //!< Override the offset of the eyes (camera positions) relative to the HMD.
 
 	virtual int updateTracking();      //!< Update the t_eye positions based on latest tracking data.
+	virtual int sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4]); //!< Get the controller positions from the latest tracking data, between two frames.
 
 	virtual int blitEye(Side side, void* texture_resource, const float& aperture_u, const float& aperture_v); //!< Blit a rendered image into the internal eye texture.
 	virtual int blitEyes(void* texture_resource_left, void* texture_resource_right, const float& aperture_u, const float& aperture_v); //!< Blit rendered images into the internal eye textures.
 	virtual int submitFrame();         //!< Submit frame to the HMD.
 
+	virtual int getEyeImages(Side side, uint* images, uint& count); //!< Get the device-owned eye images that can be rendered into directly.
+	virtual int acquireEyeImage(Side side, uint& index); //!< Acquire the device-owned eye image to render the next frame into.
+
 	virtual int getTrackerPosition(uint i, float t[4][4]) const override; //!< Get the position of a tracking camera / device (if available).
 
 	float t_basestation[VR_OPENXR_NUMBASESTATIONS][4][4]; //!< Transformation matrix for basestation position.
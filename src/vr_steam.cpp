@@ -88,6 +88,12 @@ VR_Steam::VR_Steam()
 
 	memset(&this->gl, 0, sizeof(this->gl));
 
+	this->pacer.thread = 0;
+	this->pacer.requested = false;
+	this->pacer.done = false;
+	this->pacer.quit = false;
+	this->vsync_to_photons = 0;
+
 	SET4X4IDENTITY(t_basestation[0]);
 	SET4X4IDENTITY(t_basestation[1]);
 }
@@ -575,6 +581,10 @@ int VR_Steam::init(void* display, void* drawable, void* context)
 	this->input.active_action_set.ulSecondaryActionSet = 0; // ignored because of ulRestrictedToDevice is for all devices
 	this->input.active_action_set.unPadding = 0; // ignored
 
+	// Tracking data is predicted to when a frame submitted "now" would be displayed
+	this->vsync_to_photons = this->hmd->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
+	this->startFramePacer();
+
 	this->initialized = true;
 
 	return VR::Error_None;
@@ -591,6 +601,8 @@ int VR_Steam::uninit()
 		return VR::Error_NotInitialized;
 	}
 
+	this->stopFramePacer();
+
 	// save current context so that we can return
 #ifdef _WIN32
 	HDC   dc = wglGetCurrentDC();
@@ -716,7 +728,13 @@ int VR_Steam::updateTracking()
 		return VR::Error_NotInitialized;
 	}
 	vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount];
-	compositor->WaitGetPoses(poses, vr::k_unMaxTrackedDeviceCount, NULL, 0);
+	if (this->pacer.thread) {
+		// Non-blocking: WaitGetPoses() is called by the frame pacing thread
+		this->hmd->GetDeviceToAbsoluteTrackingPose(compositor->GetTrackingSpace(), this->vsync_to_photons, poses, vr::k_unMaxTrackedDeviceCount);
+	}
+	else {
+		compositor->WaitGetPoses(poses, vr::k_unMaxTrackedDeviceCount, NULL, 0);
+	}
 
 	// Assume tracking was lost
 	this->tracking = false;
@@ -796,6 +814,41 @@ int VR_Steam::updateTracking()
 	return VR::Error_None;
 }
 
+//                                                                      ____________________________
+//_____________________________________________________________________/ sampleControllerPositions()
+/**
+ * Get the controller positions from the latest tracking data, between two frames.
+ * The controllers are predicted as far ahead of the current time as updateTracking() predicts them.
+ * \param   t_controller    [OUT] Transformation matrices of the tracked controllers.
+ * \return  Zero on success, an error code on failure.
+ */
+int VR_Steam::sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+	if (!this->hmd) {
+		return VR::Error_NotInitialized;
+	}
+
+	vr::IVRCompositor* compositor = vr::VRCompositor();
+	if (!compositor) {
+		return VR::Error_NotInitialized;
+	}
+	vr::TrackedDevicePose_t poses[vr::k_unMaxTrackedDeviceCount];
+	this->hmd->GetDeviceToAbsoluteTrackingPose(compositor->GetTrackingSpace(), this->vsync_to_photons, poses, vr::k_unMaxTrackedDeviceCount);
+
+	const vr::TrackedDeviceIndex_t index[Sides] = {
+		this->hmd->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_LeftHand),
+		this->hmd->GetTrackedDeviceIndexForControllerRole(vr::TrackedControllerRole_RightHand)
+	};
+	for (int i = 0; i < Sides; ++i) {
+		if (index[i] >= vr::k_unMaxTrackedDeviceCount || !poses[index[i]].bPoseIsValid) {
+			continue;
+		}
+		this->transferControllerTransformation(poses[index[i]].mDeviceToAbsoluteTracking.m, t_controller[i]);
+	}
+
+	return VR::Error_None;
+}
+
 //                                                                          ________________________
 //_________________________________________________________________________/  getTrackerPosition()
 /**
@@ -813,15 +866,100 @@ int VR_Steam::getTrackerPosition(uint i, float t[4][4]) const
 	return VR_Steam::Error_None;
 }
 
-//                                                                      ____________________________
-//_____________________________________________________________________/ interpretControllerState()
+//                                                                          ________________________
+//_________________________________________________________________________/  startFramePacer()
 /**
- * Helper function to deal with Vive controller data.
+ * Start the frame pacing thread, which calls WaitGetPoses() for each frame.
+ * \return      True on success, false if tracking has to block on WaitGetPoses().
  */
-void VR_Steam::interpretControllerState(const vr::VRControllerState_t& s, const float m[3][4], float t_controller[4][4], Controller& c, const Input::ActionHandles *input_handles)
+bool VR_Steam::startFramePacer()
 {
-	c.available = 1;
+	if (this->pacer.thread) {
+		return true;
+	}
+	this->pacer.requested = true;
+	this->pacer.done = false;
+	this->pacer.quit = false;
+	try {
+		this->pacer.thread = new std::thread(VR_Steam::framePacerThread, this);
+	}
+	catch (...) {
+		this->pacer.thread = 0;
+		return false;
+	}
+	return true;
+}
+
+//                                                                          ________________________
+//_________________________________________________________________________/  stopFramePacer()
+/**
+ * Stop the frame pacing thread (after its pending WaitGetPoses() call returned).
+ */
+void VR_Steam::stopFramePacer()
+{
+	if (!this->pacer.thread) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(this->pacer.mutex);
+		this->pacer.quit = true;
+		this->pacer.cv.notify_all();
+	}
+	this->pacer.thread->join();
+	delete this->pacer.thread;
+	this->pacer.thread = 0;
+}
+
+//                                                                          ________________________
+//_________________________________________________________________________/  waitFramePacer()
+/**
+ * Wait until WaitGetPoses() returned for the next frame.
+ * Usually it already returned while Blender was rendering, so this does not block.
+ */
+void VR_Steam::waitFramePacer()
+{
+	if (!this->pacer.thread) {
+		return;
+	}
+	std::unique_lock<std::mutex> lock(this->pacer.mutex);
+	while (this->pacer.requested && !this->pacer.done) {
+		this->pacer.cv.wait(lock);
+	}
+}
+
+//                                                                          ________________________
+//_________________________________________________________________________/  framePacerThread()
+/**
+ * Frame pacing thread function.
+ * \obj         The VR module object.
+ */
+void VR_Steam::framePacerThread(VR_Steam* obj)
+{
+	FramePacer& pacer = obj->pacer;
+	std::unique_lock<std::mutex> lock(pacer.mutex);
+	while (!pacer.quit) {
+		if (!pacer.requested || pacer.done) {
+			pacer.cv.wait(lock);
+			continue;
+		}
+		lock.unlock();
+		vr::IVRCompositor* compositor = vr::VRCompositor();
+		if (compositor) {
+			compositor->WaitGetPoses(NULL, 0, NULL, 0);
+		}
+		lock.lock();
+		pacer.done = true;
+		pacer.cv.notify_all();
+	}
+}
 
+//                                                                 _________________________________
+//________________________________________________________________/ transferControllerTransformation()
+/**
+ * Convert a controller pose, moved ahead of the controller (cursor position).
+ */
+void VR_Steam::transferControllerTransformation(const float m[3][4], float t_controller[4][4]) const
+{
 	t_controller[0][0] = m[0][0];      t_controller[1][0] = -m[0][2];      t_controller[2][0] = m[0][1];      t_controller[3][0] = m[0][3];
 	t_controller[0][1] = -m[2][0];     t_controller[1][1] = m[2][2];       t_controller[2][1] = -m[2][1];     t_controller[3][1] = -m[2][3];
 	t_controller[0][2] = m[1][0];      t_controller[1][2] = -m[1][2];      t_controller[2][2] = m[1][1];      t_controller[3][2] = m[1][3];
@@ -849,6 +987,18 @@ void VR_Steam::interpretControllerState(const vr::VRControllerState_t& s, const
 	t_controller[3][0] += t_controller[1][0] * controller_offset;
 	t_controller[3][1] += t_controller[1][1] * controller_offset;
 	t_controller[3][2] += t_controller[1][2] * controller_offset;
+}
+
+//                                                                      ____________________________
+//_____________________________________________________________________/ interpretControllerState()
+/**
+ * Helper function to deal with Vive controller data.
+ */
+void VR_Steam::interpretControllerState(const vr::VRControllerState_t& s, const float m[3][4], float t_controller[4][4], Controller& c, const Input::ActionHandles *input_handles)
+{
+	c.available = 1;
+
+	this->transferControllerTransformation(m, t_controller);
 
 	uint64_t prior_touchpad_pressed = c.buttons & VR_STEAM_BTNBITS_DPADANY;
 	uint64_t prior_thumbstick_pressed = c.buttons & VR_STEAM_BTNBITS_STICKANY;
@@ -1354,12 +1504,23 @@ int VR_Steam::submitFrame()
 		return VR::Error_NotInitialized;
 	}
 
+	// The compositor requires WaitGetPoses() before Submit()
+	this->waitFramePacer();
+
 	vr::Texture_t leftEyeTexture = { (void*)this->gl.texture[Side_Left], vr::TextureType_OpenGL,vr::ColorSpace_Gamma };
 	compositor->Submit(vr::Eye_Left, &leftEyeTexture, 0);
 	vr::Texture_t rightEyeTexture = { (void*)this->gl.texture[Side_Right], vr::TextureType_OpenGL,vr::ColorSpace_Gamma };
 	compositor->Submit(vr::Eye_Right, &rightEyeTexture, 0);
 	compositor->PostPresentHandoff();
 
+	// Start waiting for the next frame
+	if (this->pacer.thread) {
+		std::lock_guard<std::mutex> lock(this->pacer.mutex);
+		this->pacer.requested = true;
+		this->pacer.done = false;
+		this->pacer.cv.notify_all();
+	}
+
 	return VR::Error_None;
 }
 
@@ -2398,6 +2559,14 @@ int c_getControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4])
 	return 0;
 }
 
+/**
+ * Position of the controllers from the latest tracking data (between two frames).
+ */
+int c_sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4])
+{
+	return c_obj->sampleControllerPositions(t_controller);
+}
+
 /**
  * Last tracked button state of the controllers.
  */
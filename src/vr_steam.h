@@ -13,6 +13,10 @@
 
 #include "vr.h"
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #define VR_STEAM_DEBOUNCEPERIOD                 200		//!< Debounce period to avoid jumpy/slacky touchpad touches.
 #define VR_STEAM_TRIGGERPRESSURETHRESHOLD       0.3f	//!< Threshold for trigger pressure to be registered as "pressed".
 #define VR_STEAM_GRIPPRESSURETHRESHOLD			0.4f	//!< Threshold for grip pressure to be registered as "pressed".
@@ -70,6 +74,7 @@ extern "C" __declspec(dllexport) int c_updateTrackingVR(); //!< Update the t_eye
 extern "C" __declspec(dllexport) int c_getEyePositions(float t_eye[VR::Sides][4][4]); //!< Last tracked position of the eyes.
 extern "C" __declspec(dllexport) int c_getHMDPosition(float t_hmd[4][4]);      //!< Last tracked position of the HMD.
 extern "C" __declspec(dllexport) int c_getControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4]); //!< Last tracked position of the controller.
+extern "C" __declspec(dllexport) int c_sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4]); //!< Position of the controllers from the latest tracking data (between two frames).
 extern "C" __declspec(dllexport) int c_getControllerStates(void* controller_states[VR_MAX_CONTROLLERS]); //!< Last tracked button states of the controllers.
 extern "C" __declspec(dllexport) int c_blitEye(int side, void* texture_resource, const float* aperture_u, const float* aperture_v); //!< Blit a rendered image into the internal eye texture.
 extern "C" __declspec(dllexport) int c_blitEyes(void* texture_resource_left, void* texture_resource_right, const float* aperture_u, const float* aperture_v); //!< Blit rendered images into the internal eye textures.
@@ -157,6 +162,18 @@ protected:
 
 	bool   eye_offset_override[2]; //!< Whether the user defined the offset manually.
 
+	// Frame pacing: the (blocking) WaitGetPoses() call runs on its own thread, so that tracking can be queried without blocking.
+	typedef struct FramePacer {
+		std::thread*            thread;      //!< Thread calling WaitGetPoses() (if running).
+		std::mutex              mutex;       //!< Protects the flags below.
+		std::condition_variable cv;          //!< Signals changes of the flags below.
+		bool                    requested;   //!< Whether the thread should call WaitGetPoses() for the next frame.
+		bool                    done;        //!< Whether WaitGetPoses() returned for the next frame.
+		bool                    quit;        //!< Whether the thread should exit.
+	} FramePacer; //!< Frame pacing thread and state.
+	FramePacer pacer; //!< Frame pacing thread and state.
+	float   vsync_to_photons; //!< Time from vsync to photons (seconds), the prediction time of the tracking data.
+
 public:
 	VR_Steam();           //!< Class constructor
 	virtual ~VR_Steam();  //!< Class destructor
@@ -167,6 +184,12 @@ protected:
 	int acquireHMD(); //!< Initialize basic VR operation and acquire the HMD object.
 	int releaseHMD(); //!< Delete the HMD object and uninitialize basic VR operation.
 
+	bool startFramePacer(); //!< Start the frame pacing thread.
+	void stopFramePacer();  //!< Stop the frame pacing thread.
+	void waitFramePacer();  //!< Wait until WaitGetPoses() returned for the next frame.
+	static void framePacerThread(VR_Steam* obj); //!< Frame pacing thread function.
+
+	void transferControllerTransformation(const float m[3][4], float t_controller[4][4]) const; //!< Convert a controller pose, moved ahead of the controller (cursor position).
 	void interpretControllerState(const vr::VRControllerState_t& s, const float m[3][4], float t_controller[4][4], Controller& c, const Input::ActionHandles *input_handles); //!< Helper function to deal with Vive controller data.
 
 public:
@@ -186,6 +209,7 @@ public:
 	virtual int setEyeOffset(Side side, float x, float y, float z); //!< Override the offset of the eyes (camera positions) relative to the HMD.
 
 	virtual int updateTracking();      //!< Update the t_eye positions based on latest tracking data.
+	virtual int sampleControllerPositions(float t_controller[VR_MAX_CONTROLLERS][4][4]); //!< Get the controller positions from the latest tracking data, between two frames.
 
 	virtual int blitEye(Side side, void* texture_resource, const float& aperture_u, const float& aperture_v); //!< Blit a rendered image into the internal eye texture.
 	virtual int blitEyes(void* texture_resource_left, void* texture_resource_right, const float& aperture_u, const float& aperture_v); //!< Blit rendered images into the internal eye textures.